@@ -157,6 +157,20 @@ void PitchDetector::updateFiltersAndBlockSizes()
     
     buffer1.setSizeQuick (numSamplesNeededForDetection);
     buffer2.setSizeQuick (numSamplesNeededForDetection);
+    
+   #if DROWAUDIO_PITCHDETECTOR_USE_FFT
+    // zero padded to twice the block so that no lag wraps around
+    int fftSizeLog2 = 1;
+    while ((1 << fftSizeLog2) < numSamplesNeededForDetection * 2)
+        ++fftSizeLog2;
+    
+    if (fft == nullptr)
+        fft = new FFT (fftSizeLog2);
+    else
+        fft->setFFTSizeLog2 (fftSizeLog2);
+    
+    fftSamples.malloc (1 << fftSizeLog2);
+   #endif
 }
 
 //==============================================================================
@@ -180,7 +194,7 @@ double PitchDetector::detectAcfPitchForBlock (float* samples, int numSamples)
     lowFilter.processSamples (samples, numSamples);
     highFilter.processSamples (samples, numSamples);
     
-    autocorrelate (samples, numSamples, buffer1.getData());
+    correlate (samples, numSamples, buffer1.getData());
     normalise (buffer1.getData(), buffer1.getSize());
 
 //    float max = 0.0f;
@@ -282,7 +296,23 @@ double PitchDetector::detectSdfPitchForBlock (float* samples, int numSamples)
     lowFilter.processSamples (samples, numSamples);
     highFilter.processSamples (samples, numSamples);
     
-    sdfAutocorrelate (samples, numSamples, buffer1.getData());
+    // the sum of (x[j] - x[j + lag])^2 is the energy of the two overlapping
+    // parts less twice the auto correlation
+    float* sdfOutput = buffer1.getData();
+    correlate (samples, numSamples, sdfOutput);
+    
+    double headEnergy = 0.0;
+    for (int i = 0; i < numSamples; ++i)
+        headEnergy += squareNumber (samples[i]);
+    
+    double tailEnergy = headEnergy;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        sdfOutput[i] = (float) jmax (0.0, headEnergy + tailEnergy - 2.0 * sdfOutput[i]);
+        headEnergy -= squareNumber (samples[numSamples - 1 - i]);
+        tailEnergy -= squareNumber (samples[i]);
+    }
+    
     normalise (buffer1.getData(), buffer1.getSize());
     
     // find first minimum that is below a threshold
@@ -316,3 +346,46 @@ double PitchDetector::detectSdfPitchForBlock (float* samples, int numSamples)
     
     return 0.0;
 }
+
+void PitchDetector::correlate (const float* samples, int numSamples, float* output)
+{
+   #if DROWAUDIO_PITCHDETECTOR_USE_FFT
+    const FFT::Properties properties (fft->getProperties());
+    
+    if (numSamples * 2 <= properties.fftSize)
+    {
+        const int fftSizeHalved = properties.fftSizeHalved;
+        float* padded = fftSamples.getData();
+        FloatVectorOperations::copy (padded, samples, numSamples);
+        FloatVectorOperations::clear (padded + numSamples, properties.fftSize - numSamples);
+        fft->performFFT (padded);
+        
+        // power spectrum in the layout of the FFT, [0] = DC & [fftSize / 2] = Nyquist
+        const SplitComplex& spectrum = fft->getFFTBuffer();
+        float* power = padded;
+        power[0] = squareNumber (spectrum.realp[0]);
+        power[fftSizeHalved] = squareNumber (spectrum.imagp[0]);
+        
+        for (int i = 1; i < fftSizeHalved; ++i)
+        {
+            power[i] = squareNumber (spectrum.realp[i]) + squareNumber (spectrum.imagp[i]);
+            power[fftSizeHalved + i] = 0.0f;
+        }
+        
+        fft->performIFFT (power);
+        
+        // the FFT scales differently on each platform, lag 0 is the energy of the block
+        const float* correlation = fft->getBuffer();
+        double energy = 0.0;
+        for (int i = 0; i < numSamples; ++i)
+            energy += squareNumber (samples[i]);
+        
+        const float scale = correlation[0] > 0.0f ? (float) (energy / correlation[0]) : 0.0f;
+        FloatVectorOperations::copyWithMultiply (output, correlation, scale, numSamples);
+        return;
+    }
+   #endif
+    
+    autocorrelate (samples, numSamples, output);
+    FloatVectorOperations::multiply (output, (float) numSamples, numSamples);
+}
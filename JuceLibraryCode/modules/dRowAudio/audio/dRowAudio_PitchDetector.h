@@ -35,6 +35,11 @@
 #include "dRowAudio_Buffer.h"
 #include "dRowAudio_FifoBuffer.h"
 
+#if JUCE_MAC || JUCE_IOS || DROWAUDIO_USE_FFTREAL
+ #define DROWAUDIO_PITCHDETECTOR_USE_FFT 1
+ class FFT;
+#endif
+
 //==============================================================================
 /**
     Auto correlation based pitch detector class.
@@ -43,6 +48,10 @@
     be slower than an FFT approach it is much more accurate, especially at low
     frequencies (due to not having to lie on a bin boundry).
  
+    Where an FFT is available the auto correlation and square difference
+    functions are computed from the power spectrum of the zero padded block
+    (Wiener-Khinchin), in O(n log n) rather than O(n^2) per block.
+ 
     The number of samples required to calculate a pitch will vary depending on
     the minimum frequency set. This will also determine the number of calculations
     required so set these to some sensible estimates first. Internally this uses a
@@ -164,6 +173,11 @@ private:
     FifoBuffer<float> inputFifoBuffer;
     double mostRecentPitch;
 
+   #if DROWAUDIO_PITCHDETECTOR_USE_FFT
+    ScopedPointer<FFT> fft;
+    HeapBlock<float> fftSamples;
+   #endif
+
     //==============================================================================
     void updateFiltersAndBlockSizes();
 
@@ -172,6 +186,11 @@ private:
     double detectAcfPitchForBlock (float* samples, int numSamples);
     double detectSdfPitchForBlock (float* samples, int numSamples);
     
+    /** Finds the unnormalised auto correlation of a block, the sum of
+        samples[j] * samples[j + lag] for every lag < numSamples.
+     */
+    void correlate (const float* samples, int numSamples, float* output);
+    
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PitchDetector);
 };
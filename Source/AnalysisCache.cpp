@@ -0,0 +1,479 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+
+#include "AnalysisCache.h"
+
+#include "SdifFile.h"
+
+#include <memory>
+
+// Change this when analysis changes, so old results are not used.
+static const int kAnalysisCacheVersion = 2;
+
+//==============================================================================
+/** 64-bit FNV-1a hash of file content. */
+static bool hashFileContent(const File &file, uint64 &hash)
+{
+    FileInputStream stream(file);
+    if (stream.failedToOpen())
+        return false;
+    
+    HeapBlock<uint8> block(65536);
+    hash = 14695981039346656037ULL;
+    
+    for (;;)
+    {
+        const int numRead = stream.read(block, 65536);
+        if (numRead <= 0)
+            break;
+        
+        for (int i = 0; i < numRead; i++)
+        {
+            hash ^= block[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    
+    return true;
+}
+
+//==============================================================================
+String AnalysisCache::Source::toString() const
+{
+    // loris_batch_analyze writes the same fields
+    return String(pitchHz, 17) + "\t" + String(resolutionHz, 17) + "\t" + String((int) reverse) + "\t"
+           + String(downmix) + "\t" + String(ceilingHz) + "\t" + String(regionStart, 3) + "\t"
+           + String(regionEnd, 3) + "\t" + String(shortWindowHz) + "\t" + String(transientHop, 4) + "\t"
+           + String((int) harmonic) + "\t" + samplePath;
+}
+
+//==============================================================================
+bool AnalysisCache::Source::fromString(const String &text)
+{
+    StringArray fields;
+    fields.addTokens(text, "\t", String::empty);
+    if ( fields.size() != 11 || fields[0].getDoubleValue() <= 0 || fields[1].getDoubleValue() <= 0 )
+        return false;
+    
+    pitchHz = fields[0].getDoubleValue();
+    resolutionHz = fields[1].getDoubleValue();
+    reverse = fields[2].getIntValue() != 0;
+    downmix = fields[3].getIntValue();
+    ceilingHz = fields[4].getIntValue();
+    regionStart = fields[5].getDoubleValue();
+    regionEnd = fields[6].getDoubleValue();
+    shortWindowHz = fields[7].getIntValue();
+    transientHop = fields[8].getDoubleValue();
+    harmonic = fields[9].getIntValue() != 0;
+    samplePath = fields[10];
+    return true;
+}
+
+//==============================================================================
+AnalysisCache::AnalysisCache(const File &directory) : directory(directory)
+{
+    
+}
+
+//==============================================================================
+File AnalysisCache::getDefaultDirectory()
+{
+    File dataDirectory = File::getSpecialLocation(File::userApplicationDataDirectory);
+    
+#if JUCE_MAC
+    dataDirectory = dataDirectory.getChildFile("Application Support");
+#endif
+    
+    return dataDirectory.getChildFile("Paraphrasis").getChildFile("AnalysisCache");
+}
+
+//==============================================================================
+String AnalysisCache::createKey(const File &sample, double resolutionHz, double pitchHz, bool reverse, int downmix,
+                                int ceilingHz, double regionStart, double regionEnd, int shortWindowHz,
+                                double transientHop, bool harmonic)
+{
+    const String contentKey = createContentKey(sample);
+    if ( contentKey.isEmpty() )
+        return String::empty;
+    
+    return createKey(contentKey, resolutionHz, pitchHz, reverse, downmix, ceilingHz, regionStart, regionEnd,
+                     shortWindowHz, transientHop, harmonic);
+}
+
+//==============================================================================
+String AnalysisCache::createKey(const String &contentKey, double resolutionHz, double pitchHz, bool reverse, int downmix,
+                                int ceilingHz, double regionStart, double regionEnd, int shortWindowHz,
+                                double transientHop, bool harmonic)
+{
+    // loris_batch_analyze creates the same keys, change it with this
+    String parameters = String(kAnalysisCacheVersion) + ";" + String(resolutionHz, 3) + ";"
+                        + String(pitchHz, 3) + ";" + (reverse ? "r" : "f");
+    
+    // keys of the default downmix, of analyses at the sample rate and of whole samples are
+    // kept, so samples cached before are found
+    if ( downmix != 0 )
+        parameters += ";d" + String(downmix);
+    if ( ceilingHz != 0 )
+        parameters += ";c" + String(ceilingHz);
+    if ( regionStart > 0 || regionEnd > 0 )
+        parameters += ";s" + String(regionStart, 3) + "-" + String(regionEnd, 3);
+    if ( shortWindowHz != 0 )
+        parameters += ";w" + String(shortWindowHz);
+    if ( transientHop > 0 )
+        parameters += ";t" + String(transientHop, 4);
+    if ( harmonic )
+        parameters += ";h";
+    
+    return contentKey + "-" + String::toHexString(parameters.hashCode64());
+}
+
+//==============================================================================
+String AnalysisCache::createContentKey(const File &sample)
+{
+    uint64 contentHash;
+    if ( !hashFileContent(sample, contentHash) )
+        return String::empty;
+    
+    return String::toHexString((int64) contentHash) + "-" + String::toHexString(sample.getSize());
+}
+
+//==============================================================================
+bool AnalysisCache::hasIndex() const
+{
+    return indexFile().existsAsFile();
+}
+
+//==============================================================================
+bool AnalysisCache::readIndexedPitch(const String &contentKey, int downmix, double &pitchHz, double &resolutionHz) const noexcept
+{
+    // lines of content key, pitch, resolution and downmix separated by tabs
+    StringArray lines;
+    indexFile().readLines(lines);
+    
+    for (const String &line : lines)
+    {
+        if ( !line.startsWith(contentKey + "\t") )
+            continue;
+        
+        StringArray fields;
+        fields.addTokens(line, "\t", String::empty);
+        if ( fields.size() < 4 || fields[3].getIntValue() != downmix )
+            continue;
+        
+        const double pitch = fields[1].getDoubleValue();
+        const double resolution = fields[2].getDoubleValue();
+        if ( pitch <= 0 || resolution <= 0 )
+            continue;
+        
+        pitchHz = pitch;
+        resolutionHz = resolution;
+        return true;
+    }
+    
+    return false;
+}
+
+//==============================================================================
+bool AnalysisCache::read(const String &key, Loris::PartialList &partials) const noexcept
+{
+    File file(fileForKey(key));
+    if ( !file.existsAsFile() )
+        return false;
+    
+    try
+    {
+        Loris::SdifFile sdifFile(file.getFullPathName().toStdString(), 0); // partials are built on all cores
+        
+        partials.clear();
+        partials = std::move(sdifFile.partials());
+        
+        return true;
+    }
+    catch (...)
+    {
+        // broken file, analyze again and overwrite it
+        file.deleteFile();
+    }
+    
+    return false;
+}
+
+//==============================================================================
+void AnalysisCache::write(const String &key, const Loris::PartialList &partials) const noexcept
+{
+    if ( !directory.createDirectory() )
+        return;
+    
+    try
+    {
+        // other instances may read the file, so write it aside first
+        TemporaryFile temp(fileForKey(key));
+        
+        Loris::SdifFile sdifFile(partials.begin(), partials.end());
+        sdifFile.write(temp.getFile().getFullPathName().toStdString());
+        
+        temp.overwriteTargetFileWithTemporary();
+    }
+    catch (...) { }
+}
+
+//==============================================================================
+Loris::NoiseBands::Ptr AnalysisCache::readNoiseBands(const String &key) const noexcept
+{
+    File file(noiseFileForKey(key));
+    FileInputStream in(file);
+    if ( in.failedToOpen() )
+        return nullptr;
+    
+    try
+    {
+        // frames of band energies, written by writeNoiseBands()
+        const int numBands = in.readInt();
+        const int numFrames = in.readInt();
+        if ( numBands == Loris::NoiseBands::NumBands && numFrames > 0
+             && in.getTotalLength() == 8 + (int64) numFrames * (8 + 4 * numBands) )
+        {
+            std::shared_ptr<Loris::NoiseBands> noiseBands = std::make_shared<Loris::NoiseBands>();
+            float energies[Loris::NoiseBands::NumBands];
+            for (int f = 0; f < numFrames; f++)
+            {
+                const double time = in.readDouble();
+                for (int b = 0; b < numBands; b++)
+                    energies[b] = in.readFloat();
+                noiseBands->addFrame(time, energies);
+            }
+            return noiseBands;
+        }
+    }
+    catch (...) { }
+    
+    // broken file, it is written again by the next analysis
+    file.deleteFile();
+    
+    return nullptr;
+}
+
+//==============================================================================
+void AnalysisCache::writeNoiseBands(const String &key, const Loris::NoiseBands &noiseBands) const noexcept
+{
+    if ( !directory.createDirectory() )
+        return;
+    
+    MemoryOutputStream out;
+    out.writeInt(Loris::NoiseBands::NumBands);
+    out.writeInt((int) noiseBands.numFrames());
+    for (size_t f = 0; f < noiseBands.numFrames(); f++)
+    {
+        out.writeDouble(noiseBands.frameTime(f));
+        for (int b = 0; b < Loris::NoiseBands::NumBands; b++)
+            out.writeFloat(noiseBands.frameEnergies(f)[b]);
+    }
+    
+    // other instances may read the file, so write it aside first
+    TemporaryFile temp(noiseFileForKey(key));
+    if ( temp.getFile().replaceWithData(out.getData(), out.getDataSize()) )
+        temp.overwriteTargetFileWithTemporary();
+}
+
+//==============================================================================
+Loris::PartialBank::Ptr AnalysisCache::readBank(const String &key, double sampleRate) const noexcept
+{
+    File file(bankFileForKey(key, sampleRate));
+    if ( !file.existsAsFile() )
+        return nullptr;
+    
+    Loris::PartialBank::Ptr bank = readBankFile(file);
+    if ( bank && bank->sampleRate() == sampleRate )
+        return bank;
+    
+    // broken file, prepare bank again and overwrite it
+    file.deleteFile();
+    
+    return nullptr;
+}
+
+//==============================================================================
+Loris::PartialBank::Ptr AnalysisCache::readBankFile(const File &file) noexcept
+{
+    try
+    {
+        // the bank keeps the mapping alive, its arrays point into the file
+        std::shared_ptr<MemoryMappedFile> mapped = std::make_shared<MemoryMappedFile>(file, MemoryMappedFile::readOnly);
+        if ( mapped->getData() == nullptr )
+            return nullptr;
+        
+        return Loris::PartialBank::fromImage(mapped->getData(), mapped->getSize(), mapped);
+    }
+    catch (...) { }
+    
+    return nullptr;
+}
+
+//==============================================================================
+void AnalysisCache::writeBank(const String &key, const Loris::PartialBank &bank) const noexcept
+{
+    if ( !directory.createDirectory() )
+        return;
+    
+    try
+    {
+        // mapped files must not change, so write it aside and replace it
+        TemporaryFile temp(bankFileForKey(key, bank.sampleRate()));
+        
+        MemoryBlock image(bank.imageSize());
+        bank.writeImage(image.getData());
+        
+        if ( temp.getFile().replaceWithData(image.getData(), image.getSize()) )
+            temp.overwriteTargetFileWithTemporary();
+    }
+    catch (...) { }
+}
+
+//==============================================================================
+bool AnalysisCache::readSource(const String &key, Source &source) const noexcept
+{
+    Source read;
+    if ( !read.fromString(sourceFileForKey(key).loadFileAsString().trimEnd()) )
+        return false;
+    
+    source = read;
+    return true;
+}
+
+//==============================================================================
+void AnalysisCache::writeSource(const String &key, const Source &source) const noexcept
+{
+    if ( !directory.createDirectory() )
+        return;
+    
+    // other instances may read the file, so write it aside first
+    TemporaryFile temp(sourceFileForKey(key));
+    if ( temp.getFile().replaceWithText(source.toString() + "\n") )
+        temp.overwriteTargetFileWithTemporary();
+}
+
+//==============================================================================
+File AnalysisCache::fileForKey(const String &key) const
+{
+    return directory.getChildFile(key + ".sdif");
+}
+
+//==============================================================================
+File AnalysisCache::bankFileForKey(const String &key, double sampleRate) const
+{
+    return directory.getChildFile(key + "-" + String(roundToInt(sampleRate)) + ".bank");
+}
+
+//==============================================================================
+File AnalysisCache::noiseFileForKey(const String &key) const
+{
+    return directory.getChildFile(key + ".noise");
+}
+
+//==============================================================================
+File AnalysisCache::sourceFileForKey(const String &key) const
+{
+    return directory.getChildFile(key + ".source");
+}
+
+//==============================================================================
+File AnalysisCache::indexFile() const
+{
+    return directory.getChildFile("BatchIndex.txt");
+}
+
+//==============================================================================
+bool AnalysisRegistry::join(const String &key, const ThreadPoolJob &job, Loris::PartialList &partials)
+{
+    std::shared_ptr<Analysis> analysis;
+    {
+        const ScopedLock sl(lock);
+        std::shared_ptr<Analysis> &running = analyses[key];
+        if ( !running )
+        {
+            // nobody analyses the sample, caller does
+            running = std::make_shared<Analysis>();
+            running->job = &job;
+            return false;
+        }
+        analysis = running;
+    }
+    
+    // the analysis is kept alive by this pointer after it is published
+    while ( !analysis->finished.wait(50) )
+        if ( job.shouldExit() )
+            return false;
+    
+    if ( analysis->partials.empty() )
+        return false;
+    
+    partials = analysis->partials;
+    return true;
+}
+
+//==============================================================================
+void AnalysisRegistry::publish(const String &key, const ThreadPoolJob &job, const Loris::PartialList &partials)
+{
+    std::shared_ptr<Analysis> analysis;
+    {
+        const ScopedLock sl(lock);
+        auto it = analyses.find(key);
+        if ( it == analyses.end() || it->second->job != &job )
+            return; // analysed by a job which gave up waiting, nobody waits for it
+        
+        analysis = it->second;
+        analyses.erase(it);
+    }
+    
+    // nobody else touches the partials until the event is signalled
+    if ( analysis.use_count() > 1 )
+        analysis->partials = partials;
+    analysis->finished.signal();
+}
+
+//==============================================================================
+Loris::PartialBank::Ptr AnalysisRegistry::findBank(const String &key, double sampleRate)
+{
+    const ScopedLock sl(lock);
+    
+    auto it = banks.find(key + "-" + String(sampleRate));
+    if ( it == banks.end() )
+        return nullptr;
+    
+    Loris::PartialBank::Ptr bank = it->second.lock();
+    if ( !bank )
+        banks.erase(it); // nobody plays it anymore
+    return bank;
+}
+
+//==============================================================================
+void AnalysisRegistry::addBank(const String &key, const Loris::PartialBank::Ptr &bank)
+{
+    const ScopedLock sl(lock);
+    
+    banks[key + "-" + String(bank->sampleRate())] = bank;
+    
+    // forget banks nobody plays, so keys of old sounds do not pile up
+    for (auto it = banks.begin(); it != banks.end(); )
+        it = it->second.expired() ? banks.erase(it) : ++it;
+}
@@ -0,0 +1,206 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef ANALYSIS_CACHE_H_INCLUDED
+#define ANALYSIS_CACHE_H_INCLUDED
+
+#include "JuceHeader.h"
+#include "PartialList.h"
+#include "PartialBank.h"
+#include "NoiseBands.h"
+
+#include <map>
+#include <memory>
+
+/**
+ On-disk cache of analysis results. Partials are stored as SDIF files named by a content
+ hash of the sample and by the analysis parameters, so reopening a project reads partials
+ from a file instead of analyzing the sample again.
+ 
+ Partials prepared for synthesis at a sample rate are stored beside them as
+ Loris::PartialBank images. Bank files are memory mapped and used in place, so they load
+ without parsing or resampling and their pages are shared by all plugin instances playing
+ the same sound. The settings of each analysis are stored beside its partials, so the banks
+ can be browsed and loaded again (see BankLibrary).
+ */
+class AnalysisCache
+{
+public:
+    /** Sample and settings of a cached analysis, the arguments of createKey(). */
+    struct Source
+    {
+        String samplePath;
+        double pitchHz = 0;
+        double resolutionHz = 0;
+        bool reverse = false;
+        int downmix = 0;
+        int ceilingHz = 0;
+        double regionStart = 0;
+        double regionEnd = 0;
+        int shortWindowHz = 0;
+        double transientHop = 0;
+        bool harmonic = false;
+        
+        /** Fields separated by tabs, the path last. */
+        String toString() const;
+        
+        /** Parse toString(). @return false if the text is not a source. */
+        bool fromString(const String &text);
+    };
+    
+    /** Create cache stored in given directory. */
+    AnalysisCache(const File &directory = getDefaultDirectory());
+    
+    /** Default cache directory in user's application data. */
+    static File getDefaultDirectory();
+    
+    /**
+     Create key of analysis results.
+     @param sample analysed audio file, its content is hashed (so its sample rate too).
+     @param resolutionHz frequency resolution of analysis.
+     @param pitchHz pitch of the sample.
+     @param reverse is sample reversed before analysis?
+     @param downmix how stereo sample is mixed down before analysis (SampleAnalyzer::Downmix).
+     @param ceilingHz frequency ceiling of decimated analysis, 0 if it was not decimated.
+     @param regionStart start of the region of the sample analysed, seconds.
+     @param regionEnd end of the region of the sample analysed, seconds, 0 for its end.
+     @param shortWindowHz partials above it are analysed with a shorter window, 0 for none.
+     @param transientHop seconds between frames around transients, 0 for the hop of the resolution.
+     @param harmonic only the spectrum around the harmonics of the pitch was analysed.
+     @return key or empty string if the sample can not be read.
+     */
+    static String createKey(const File &sample, double resolutionHz, double pitchHz, bool reverse, int downmix = 0,
+                            int ceilingHz = 0, double regionStart = 0, double regionEnd = 0,
+                            int shortWindowHz = 0, double transientHop = 0, bool harmonic = false);
+    
+    /** Create key of analysis results from key of the sample content (see createContentKey()). */
+    static String createKey(const String &contentKey, double resolutionHz, double pitchHz, bool reverse, int downmix = 0,
+                            int ceilingHz = 0, double regionStart = 0, double regionEnd = 0,
+                            int shortWindowHz = 0, double transientHop = 0, bool harmonic = false);
+    
+    /** Create key of the content of audio file, the part of analysis key telling the sample.
+        @return key or empty string if the sample can not be read. */
+    static String createContentKey(const File &sample);
+    
+    /** Is there an index of samples analysed in batch? Samples of a library can be analysed
+        ahead by loris_batch_analyze (see ThirdParty/Loris/utils), it writes their partials and
+        banks here and indexes the pitch it analysed them at by content of the sample. */
+    bool hasIndex() const;
+    
+    /** Read pitch and frequency resolution a sample was analysed at in batch, with downmix
+        and not reversed, so the key of its partials can be created without detecting pitch.
+        @return true if the sample is indexed, false otherwise (arguments are not changed then). */
+    bool readIndexedPitch(const String &contentKey, int downmix, double &pitchHz, double &resolutionHz) const noexcept;
+    
+    /** Read cached partials.
+        @return true if partials were found, false otherwise (partials are not changed then). */
+    bool read(const String &key, Loris::PartialList &partials) const noexcept;
+    
+    /** Store partials in cache. Failure is ignored, partials will be analyzed next time. */
+    void write(const String &key, const Loris::PartialList &partials) const noexcept;
+    
+    /** Read cached residual of the analysis, stored apart from its partials.
+        @return noise bands or empty pointer if they are not found. */
+    Loris::NoiseBands::Ptr readNoiseBands(const String &key) const noexcept;
+    
+    /** Store residual of the analysis in cache. Failure is ignored, partials read from the
+        cache are played without it then. */
+    void writeNoiseBands(const String &key, const Loris::NoiseBands &noiseBands) const noexcept;
+    
+    /** Map cached bank of partials prepared for synthesis at given sample rate.
+        @return bank or empty pointer if it is not found. */
+    Loris::PartialBank::Ptr readBank(const String &key, double sampleRate) const noexcept;
+    
+    /** Store bank of partials in cache. Failure is ignored, bank will be prepared next time. */
+    void writeBank(const String &key, const Loris::PartialBank &bank) const noexcept;
+    
+    /** Map a bank file of the cache, at any sample rate.
+        @return bank or empty pointer if the file is not a valid bank. */
+    static Loris::PartialBank::Ptr readBankFile(const File &file) noexcept;
+    
+    /** Read the sample and settings of cached analysis of key.
+        @return true if they were found, false otherwise (source is not changed then). */
+    bool readSource(const String &key, Source &source) const noexcept;
+    
+    /** Store the sample and settings of analysis of key. Failure is ignored, banks of the
+        analysis can not be loaded from BankLibrary then. */
+    void writeSource(const String &key, const Source &source) const noexcept;
+    
+private:
+    File fileForKey(const String &key) const;
+    File bankFileForKey(const String &key, double sampleRate) const;
+    File noiseFileForKey(const String &key) const;
+    File sourceFileForKey(const String &key) const;
+    File indexFile() const;
+    
+    File directory;
+};
+
+/**
+ Process-wide registry of analyses in memory, keyed like AnalysisCache. All plugin instances
+ in the host process share it (through SharedResourcePointer).
+ 
+ Instances analysing the same sample with the same parameters at once coalesce into one
+ analysis: the first one analyses it, the others wait for it and take its partials. Banks
+ prepared for synthesis are registered too, so instances playing the same sound at the same
+ sample rate share one immutable bank. Banks are held only while some instance plays them.
+ */
+class AnalysisRegistry
+{
+public:
+    AnalysisRegistry() {}
+    
+    /**
+     Take partials of analysis of key running in other job. If there is one, wait until it is
+     finished (or job is asked to exit) and copy its partials.
+     @return true if partials were taken. Otherwise the caller analyses the sample itself and
+             must call publish() when it is finished, other jobs asking for key wait for it.
+     */
+    bool join(const String &key, const ThreadPoolJob &job, Loris::PartialList &partials);
+    
+    /** Give partials analysed by job after join() to jobs waiting for them, empty list if the
+        analysis failed or was stopped (waiting jobs analyse the sample then). */
+    void publish(const String &key, const ThreadPoolJob &job, const Loris::PartialList &partials);
+    
+    /** Return registered bank of key prepared at given sample rate, empty pointer if no
+        instance plays it. */
+    Loris::PartialBank::Ptr findBank(const String &key, double sampleRate);
+    
+    /** Register bank of key, instances preparing the same key and sample rate get it. */
+    void addBank(const String &key, const Loris::PartialBank::Ptr &bank);
+    
+private:
+    struct Analysis
+    {
+        const ThreadPoolJob *job;       // job analysing the sample
+        WaitableEvent finished { true };// signalled by publish()
+        Loris::PartialList partials;    // empty if analysis failed
+    };
+    
+    std::map<String, std::shared_ptr<Analysis>> analyses;         // running analyses
+    std::map<String, std::weak_ptr<const Loris::PartialBank>> banks;// by key and sample rate
+    CriticalSection lock;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisRegistry)
+};
+
+#endif  // ANALYSIS_CACHE_H_INCLUDED
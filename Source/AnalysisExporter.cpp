@@ -0,0 +1,138 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "AnalysisExporter.h"
+
+#include "ScopedNoDenormals.h"
+#include "SdifFile.h"
+
+//==============================================================================
+AnalysisExporter::AnalysisExporter(Listener &l) : Thread("Paraphrasis export"), listener(l)
+{
+}
+
+//==============================================================================
+AnalysisExporter::~AnalysisExporter()
+{
+    stopThread(-1);
+    cancelPendingUpdate();
+}
+
+//==============================================================================
+bool AnalysisExporter::start(Loris::PartialBank::Ptr newBank, const File &newFile)
+{
+    if (isThreadRunning() || ! newBank || newBank->empty())
+        return false;
+
+    // the thread finished before may not have been joined yet
+    stopThread(-1);
+
+    bank = newBank;
+    file = newFile;
+    progress = 0;
+    startThread(3);
+    return true;
+}
+
+//==============================================================================
+void AnalysisExporter::run()
+{
+    const ScopedNoDenormals noDenormals;
+
+    succeeded = file.hasFileExtension("sdif") ? writeSdif(*bank, file) : writeBank(*bank, file);
+    bank = nullptr;
+
+    if ( ! threadShouldExit())
+        triggerAsyncUpdate();
+}
+
+//==============================================================================
+void AnalysisExporter::handleAsyncUpdate()
+{
+    listener.exportFinished(file, succeeded);
+}
+
+//==============================================================================
+bool AnalysisExporter::writeBank(const Loris::PartialBank &bank, const File &file)
+{
+    try
+    {
+        MemoryBlock image(bank.imageSize());
+        bank.writeImage(image.getData());
+
+        // the file may be mapped by a cache, so write it aside and replace it
+        TemporaryFile temp(file);
+        {
+            FileOutputStream out(temp.getFile());
+            if (out.failedToOpen())
+                return false;
+
+            const char *data = static_cast<const char *>(image.getData());
+            for (size_t written = 0; written < image.getSize(); written += kChunkBytes)
+            {
+                if (threadShouldExit())
+                    return false;
+
+                const size_t bytes = jmin((size_t) kChunkBytes, image.getSize() - written);
+                if ( ! out.write(data + written, bytes))
+                    return false;
+
+                setProgress((double) (written + bytes) / image.getSize());
+            }
+            out.flush();
+        }
+
+        return temp.overwriteTargetFileWithTemporary();
+    }
+    catch (...) { }
+
+    return false;
+}
+
+//==============================================================================
+bool AnalysisExporter::writeSdif(const Loris::PartialBank &bank, const File &file)
+{
+    try
+    {
+        // SdifFile writes the file at once, the progress is the part of the work before it
+        Loris::PartialList partials = bank.toPartials();
+        setProgress(0.25);
+        if (threadShouldExit())
+            return false;
+
+        Loris::SdifFile sdifFile(partials.begin(), partials.end());
+        Loris::PartialList().swap(partials);
+        setProgress(0.5);
+        if (threadShouldExit())
+            return false;
+
+        TemporaryFile temp(file);
+        sdifFile.write(temp.getFile().getFullPathName().toStdString());
+        setProgress(1.);
+
+        return ! threadShouldExit() && temp.overwriteTargetFileWithTemporary();
+    }
+    catch (...) { }
+
+    return false;
+}
@@ -0,0 +1,95 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef ANALYSIS_EXPORTER_H_INCLUDED
+#define ANALYSIS_EXPORTER_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include "PartialBank.h"
+
+/**
+ Exports the bank of partials the voices play into a file on a background thread, so an
+ analysis can be taken to another machine and played there without analysing the sample
+ again. Banks are immutable and shared, the export holds the bank it was given and never
+ stops the synthesis or the editor. A file ending with .sdif gets the partials of the bank
+ (see Loris::PartialBank::toPartials()), any other one the bank image the analysis cache
+ maps (see AnalysisCache::readBankFile()). The file is written aside and replaced when it
+ is complete, a failed or stopped export leaves the file as it was.
+ */
+class AnalysisExporter : private Thread,
+                         private AsyncUpdater
+{
+public:
+    /** Told on the message thread when an export is finished. */
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+
+        /** The export into file is finished, succeeded is false if it failed. */
+        virtual void exportFinished(const File &file, bool succeeded) = 0;
+    };
+
+    AnalysisExporter(Listener &listener);
+
+    /** Stop the export running, its file is left as it was. */
+    ~AnalysisExporter();
+
+    /** Start exporting bank into file.
+        @return false if an export is running or the bank is empty, nothing is started then. */
+    bool start(Loris::PartialBank::Ptr bank, const File &file);
+
+    /** Is an export running? */
+    bool isExporting() const                        { return isThreadRunning(); }
+
+    /** Return the part of the running export done, from 0 to 1. */
+    double getProgress() const noexcept             { return progress.get() * (1. / kProgressSteps); }
+
+private:
+    enum
+    {
+        kProgressSteps = 1000,
+        kChunkBytes = 1 << 20       // Bytes of a bank image written at once
+    };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    /** Write the bank image into file. @return false if it failed or the thread should exit. */
+    bool writeBank(const Loris::PartialBank &bank, const File &file);
+
+    /** Write the partials of the bank into file. @return false if it failed or the thread should exit. */
+    bool writeSdif(const Loris::PartialBank &bank, const File &file);
+
+    void setProgress(double done) noexcept          { progress = roundToInt(done * kProgressSteps); }
+
+    Listener &listener;
+    Loris::PartialBank::Ptr bank;   // Set by start() before the thread starts
+    File file;
+    bool succeeded = false;         // Result of the last export, read by handleAsyncUpdate()
+    Atomic<int> progress;           // Steps of kProgressSteps done
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisExporter)
+};
+
+#endif  // ANALYSIS_EXPORTER_H_INCLUDED
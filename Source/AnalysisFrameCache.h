@@ -0,0 +1,78 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef ANALYSIS_FRAME_CACHE_H_INCLUDED
+#define ANALYSIS_FRAME_CACHE_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include "FrameCache.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ In-memory cache of the spectral peaks of the short-time frames of analysed samples (see
+ Loris::FrameCache), shared by all instances. Analysis of the sample trimmed differently
+ transforms only the frames the analysis before did not, and analysis at another pitch (the
+ same resolution) transforms none, peaks are thinned and partials are formed from all of
+ them again. So editing the region or the pitch of a long sample takes a fraction of the
+ time of its first analysis.
+ 
+ Frames of a sample are taken by the job analysing it and put back when it is finished, so
+ no two jobs write the same frames at once (the later job gets empty frames). Entries are
+ keyed by file path, modification time, direction and the downmix of the analysis pass, the
+ least recently used one is dropped when the cache is full.
+ */
+class AnalysisFrameCache
+{
+public:
+    typedef std::shared_ptr<Loris::FrameCache> Frames;
+    
+    /** Create cache keeping frames of given number of analysis passes. */
+    AnalysisFrameCache(int maxEntries = 2);
+    
+    /** Take frames of a sample out of the cache, or new empty ones if they are not cached,
+        the file was modified or another job took them. */
+    Frames take(const File &sample, bool reverse, int downmix);
+    
+    /** Put frames taken by take() back, replacing older ones. */
+    void put(const File &sample, bool reverse, int downmix, const Frames &frames);
+    
+private:
+    struct Entry
+    {
+        String path;
+        Time modified;
+        bool reverse;
+        int downmix;
+        Frames frames;
+    };
+    
+    std::vector<Entry> entries;     // most recently used first
+    int maxEntries;
+    CriticalSection lock;           // guards entries, jobs run in parallel
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisFrameCache)
+};
+
+#endif  // ANALYSIS_FRAME_CACHE_H_INCLUDED
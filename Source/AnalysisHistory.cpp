@@ -0,0 +1,104 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+
+#include "AnalysisHistory.h"
+
+//==============================================================================
+AnalysisHistory::AnalysisHistory(int64 maxBytes)
+    : maxBytes(maxBytes)
+{
+}
+
+//==============================================================================
+AnalysisHistory::Ptr AnalysisHistory::find(const String &key)
+{
+    const ScopedLock sl(lock);
+    
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].key != key)
+            continue;
+        
+        // move to front, it is the most recently used now
+        std::rotate(entries.begin(), entries.begin() + i, entries.begin() + i + 1);
+        return entries.front().analysis;
+    }
+    
+    return Ptr();
+}
+
+//==============================================================================
+void AnalysisHistory::add(const String &key, const Ptr &analysis)
+{
+    Entry entry;
+    entry.key = key;
+    entry.analysis = analysis;
+    entry.bytes = sizeOf(*analysis);
+    
+    const ScopedLock sl(lock);
+    
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].key == key)
+        {
+            totalBytes -= entries[i].bytes;
+            entries.erase(entries.begin() + i);
+            break;
+        }
+    }
+    
+    entries.insert(entries.begin(), entry);
+    totalBytes += entry.bytes;
+    
+    while (totalBytes > maxBytes && entries.size() > 1)
+    {
+        totalBytes -= entries.back().bytes;
+        entries.pop_back();
+    }
+}
+
+//==============================================================================
+void AnalysisHistory::clear()
+{
+    const ScopedLock sl(lock);
+    entries.clear();
+    totalBytes = 0;
+}
+
+//==============================================================================
+int64 AnalysisHistory::sizeOf(const Analysis &analysis)
+{
+    // breakpoints are nodes of a tree, a few pointers each
+    static const int64 kBreakpointSize = sizeof(Loris::Partial::container_type::value_type) + 4 * sizeof(void *);
+    
+    int64 bytes = sizeof(Analysis);
+    for (const Loris::Partial &partial : analysis.partials)
+        bytes += sizeof(Loris::Partial) + (int64) partial.numBreakpoints() * kBreakpointSize;
+    
+    if (analysis.bank)
+        bytes += (int64) analysis.bank->imageSize();
+    if (analysis.noiseBands)
+        bytes += (int64) analysis.noiseBands->numFrames() * (sizeof(double) + Loris::NoiseBands::NumBands * sizeof(float));
+    
+    return bytes;
+}
@@ -0,0 +1,98 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef ANALYSIS_HISTORY_H_INCLUDED
+#define ANALYSIS_HISTORY_H_INCLUDED
+
+#include "JuceHeader.h"
+#include "PartialList.h"
+#include "PartialBank.h"
+#include "NoiseBands.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ In-memory history of the analyses of an instance. Switching analysis parameters back and
+ forth (frequency resolution, reverse) sets up partials analysed before again without
+ analysing the sample, or reading it from AnalysisCache.
+ 
+ An entry keeps the partials of an analysis and the bank prepared from them, so the
+ synthesiser finds the bank in AnalysisRegistry instead of preparing it again. Entries are
+ keyed by SampleAnalyzer::settingsKey(), the least recently used ones are dropped when the
+ history takes more memory than its limit.
+ */
+class AnalysisHistory
+{
+public:
+    /** Results of an analysis, see SampleAnalyzer. */
+    struct Analysis
+    {
+        Loris::PartialList partials;
+        double pitch = 0;
+        String cacheKey;                    // key in AnalysisCache, empty if not cached
+        int64 overviewHash = 0;             // hash in SampleOverviewCache, 0 if not cached
+        Loris::NoiseBands::Ptr noiseBands;
+        double loopStart = 0;
+        double loopEnd = 0;
+        Loris::PartialBank::Ptr bank;       // prepared from partials, keeps it registered
+    };
+    
+    /** Shared, immutable analysis. */
+    typedef std::shared_ptr<const Analysis> Ptr;
+    
+    enum { kDefaultMaxBytes = 256 << 20 };
+    
+    /** Create history keeping analyses up to maxBytes of memory. The latest one is kept
+        even if it is larger. */
+    AnalysisHistory(int64 maxBytes = kDefaultMaxBytes);
+    
+    /** Find analysis of settings key, it is the most recently used one then.
+        @return analysis or empty pointer if it is not in the history. */
+    Ptr find(const String &key);
+    
+    /** Store analysis of settings key, replacing older one. */
+    void add(const String &key, const Ptr &analysis);
+    
+    /** Remove all analyses. */
+    void clear();
+    
+    /** Return estimate of memory taken by analysis, in bytes. */
+    static int64 sizeOf(const Analysis &analysis);
+    
+private:
+    struct Entry
+    {
+        String key;
+        Ptr analysis;
+        int64 bytes;
+    };
+    
+    std::vector<Entry> entries;     // most recently used first
+    int64 maxBytes;
+    int64 totalBytes = 0;
+    CriticalSection lock;           // guards entries, analyses finish on job threads
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisHistory)
+};
+
+#endif  // ANALYSIS_HISTORY_H_INCLUDED
@@ -0,0 +1,279 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+
+#include "AnalysisScheduler.h"
+#include "ScopedNoDenormals.h"
+
+#if JUCE_MAC
+ #include <pthread.h>
+#endif
+
+// Reported audio loads are kept for kAudioLoadWindowMs, analysis waits while one is above
+// kHighAudioLoad. Workers and threads of analyses run at kAnalysisPriority (JUCE priority).
+static const uint32 kAudioLoadWindowMs = 100;
+static const float kHighAudioLoad = 0.5f;
+static const int kAnalysisPriority = 2;
+
+//==============================================================================
+/** Thread running jobs of AnalysisScheduler. */
+class AnalysisScheduler::Worker : public Thread
+{
+public:
+    Worker(AnalysisScheduler &scheduler) : Thread("Paraphrasis analysis"), scheduler(scheduler) {}
+    
+    void run() override
+    {
+        setBackgroundPriority();
+        const ScopedNoDenormals noDenormals;
+        
+        while ( !threadShouldExit() )
+        {
+            int numThreads = 0;
+            SampleAnalyzer *job = scheduler.pickNextJob(numThreads);
+            
+            if (job == nullptr)
+            {
+                scheduler.jobAdded.wait(500);
+                continue;
+            }
+            
+            job->setScheduler(&scheduler, numThreads);
+            job->runJob();
+            scheduler.jobFinished(job);
+        }
+    }
+    
+private:
+    AnalysisScheduler &scheduler;
+};
+
+//==============================================================================
+AnalysisScheduler::AnalysisScheduler()
+{
+    // leave one core for audio and GUI, the core budget may leave more
+    const int numWorkers = jmax(1, SystemStats::getNumCpus() - 1);
+    
+    for (int i = 0; i < numWorkers; i++)
+    {
+        Worker *worker = new Worker(*this);
+        workers.add(worker);
+        worker->startThread(kAnalysisPriority);
+    }
+}
+
+//==============================================================================
+AnalysisScheduler::~AnalysisScheduler()
+{
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i]->signalThreadShouldExit();
+        jobAdded.signal();
+    }
+    
+    for (int i = 0; i < workers.size(); i++)
+        workers[i]->waitForThreadToExit(-1);
+    
+    workers.clear();
+    
+    // clients removed their jobs, but just in case
+    for (int i = 0; i < jobs.size(); i++)
+        delete jobs.getReference(i).job;
+}
+
+//==============================================================================
+void AnalysisScheduler::addJob(SampleAnalyzer *job, Client *client)
+{
+    jassert(job != nullptr && client != nullptr);
+    
+    {
+        const ScopedLock sl(lock);
+        
+        Entry entry = { job, client, false };
+        jobs.add(entry);
+    }
+    
+    jobAdded.signal();
+}
+
+//==============================================================================
+void AnalysisScheduler::removeJobs(Client *client, bool wait)
+{
+    OwnedArray<SampleAnalyzer> removed; // deleted when leaving, not while locked
+    
+    {
+        const ScopedLock sl(lock);
+        
+        for (int i = jobs.size(); --i >= 0;)
+        {
+            Entry &entry = jobs.getReference(i);
+            if (entry.client != client)
+                continue;
+            
+            if (entry.running)
+            {
+                entry.job->signalJobShouldExit();
+            }
+            else
+            {
+                removed.add(entry.job);
+                jobs.remove(i);
+            }
+        }
+    }
+    
+    if (wait)
+    {
+        while (isRunning(client))
+            jobDone.wait(20);
+    }
+}
+
+//==============================================================================
+SampleAnalyzer *AnalysisScheduler::pickNextJob(int &numThreads)
+{
+    const ScopedLock sl(lock);
+    
+    int running = 0;
+    for (int i = 0; i < jobs.size(); i++)
+        if (jobs.getReference(i).running)
+            running++;
+    
+    // no more jobs than cores of the budget, they split the cores
+    const int cores = getCores();
+    if (running >= cores)
+        return nullptr;
+    numThreads = jmax(1, cores / (running + 1));
+    
+    // oldest waiting job, but job of playing instance goes first
+    int next = -1;
+    for (int i = 0; i < jobs.size(); i++)
+    {
+        const Entry &entry = jobs.getReference(i);
+        if (entry.running)
+            continue;
+        
+        if (next < 0)
+            next = i;
+        
+        if (entry.client->isPlaying())
+        {
+            next = i;
+            break;
+        }
+    }
+    
+    if (next < 0)
+        return nullptr;
+    
+    jobs.getReference(next).running = true;
+    return jobs.getReference(next).job;
+}
+
+//==============================================================================
+void AnalysisScheduler::jobFinished(SampleAnalyzer *job)
+{
+    {
+        const ScopedLock sl(lock);
+        
+        for (int i = 0; i < jobs.size(); i++)
+        {
+            if (jobs.getReference(i).job == job)
+            {
+                jobs.remove(i);
+                break;
+            }
+        }
+    }
+    
+    delete job;
+    jobDone.signal();
+}
+
+//==============================================================================
+bool AnalysisScheduler::isRunning(Client *client)
+{
+    const ScopedLock sl(lock);
+    
+    for (int i = 0; i < jobs.size(); i++)
+    {
+        const Entry &entry = jobs.getReference(i);
+        if (entry.client == client && entry.running)
+            return true;
+    }
+    
+    return false;
+}
+
+//==============================================================================
+void AnalysisScheduler::setCoreBudget(int cores) noexcept
+{
+    coreBudget = jmax(0, cores);
+}
+
+//==============================================================================
+int AnalysisScheduler::getCores() const noexcept
+{
+    const int budget = coreBudget.get();
+    return budget > 0 ? budget : jmax(1, SystemStats::getNumCpus() - 1);
+}
+
+//==============================================================================
+void AnalysisScheduler::reportAudioLoad(float load) noexcept
+{
+    const int permille = roundToInt(load * 1000.f);
+    const uint32 now = Time::getMillisecondCounter();
+    
+    // loads of all instances are kept as the highest of the window, a race with another
+    // instance starting a window loses one report at most
+    if (now - audioLoadWindow.get() >= kAudioLoadWindowMs)
+    {
+        audioLoadWindow = now;
+        previousAudioLoad = audioLoad.get();
+        audioLoad = permille;
+        return;
+    }
+    
+    for (int highest = audioLoad.get(); permille > highest; highest = audioLoad.get())
+        if (audioLoad.compareAndSetBool(permille, highest))
+            break;
+}
+
+//==============================================================================
+bool AnalysisScheduler::isAudioLoadHigh() const noexcept
+{
+    // nothing reported lately, the host stopped processing
+    if (Time::getMillisecondCounter() - audioLoadWindow.get() >= 2 * kAudioLoadWindowMs)
+        return false;
+    
+    return jmax(audioLoad.get(), previousAudioLoad.get()) > roundToInt(kHighAudioLoad * 1000.f);
+}
+
+//==============================================================================
+void AnalysisScheduler::setBackgroundPriority() noexcept
+{
+   #if JUCE_MAC
+    pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+   #else
+    Thread::setCurrentThreadPriority(kAnalysisPriority);
+   #endif
+}
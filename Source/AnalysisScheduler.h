@@ -0,0 +1,124 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef ANALYSIS_SCHEDULER_H_INCLUDED
+#define ANALYSIS_SCHEDULER_H_INCLUDED
+
+#include "JuceHeader.h"
+#include "SampleAnalyzer.h"
+
+/**
+ Process-wide scheduler of SampleAnalyzer jobs. All plugin instances in the host process
+ share one scheduler (through SharedResourcePointer), so when a session with many
+ instances is restored their samples are analyzed concurrently on a bounded number
+ of threads (number of cores minus one) instead of one after another.
+ 
+ Jobs of instances which are playing are run before jobs of silent ones.
+ 
+ Analysis runs at background priority and does not starve audio threads: jobs use at most
+ the cores of the core budget between them, and their threads wait between frames while
+ instances report a high audio load.
+ */
+class AnalysisScheduler
+{
+public:
+    /** Plugin instance which asks for analysis. */
+    class Client
+    {
+    public:
+        virtual ~Client() {}
+        
+        /** Is the instance playing? Its jobs are preferred then. It is called
+            while scheduler is locked, so it must be fast. */
+        virtual bool isPlaying() const = 0;
+    };
+    
+    /** Create new scheduler and start its threads. */
+    AnalysisScheduler();
+    ~AnalysisScheduler();
+    
+    /** Add job to be run. The scheduler deletes the job when it is finished.
+        @param job analysis to be run.
+        @param client instance which asked for the job. */
+    void addJob(SampleAnalyzer *job, Client *client);
+    
+    /** Remove waiting jobs of client and ask its running jobs to exit.
+        @param client instance which asked for jobs.
+        @param wait wait until running jobs of client are finished. */
+    void removeJobs(Client *client, bool wait);
+    
+    /** Set the cores analysis may use, shared by all running jobs, 0 for all cores but
+        one (default). Jobs started after it take it, the last instance setting it wins.
+        Safe to call from any thread. */
+    void setCoreBudget(int cores) noexcept;
+    
+    /** Report the load of a block rendered by an instance (time rendering it to its
+        duration). Called from audio threads, nothing is locked. */
+    void reportAudioLoad(float load) noexcept;
+    
+    /** Did any instance report a load above kHighAudioLoad lately? Analysis waits then. */
+    bool isAudioLoadHigh() const noexcept;
+    
+    /** Lower the priority of the calling thread to the one of analysis: background QoS on
+        Mac, a priority below normal elsewhere. */
+    static void setBackgroundPriority() noexcept;
+    
+    enum { kPaceSleepMs = 2 };          // Analysis threads wait this long before a frame while
+                                        // the audio load is high
+    
+private:
+    class Worker;
+    
+    struct Entry
+    {
+        SampleAnalyzer *job;
+        Client *client;
+        bool running;
+    };
+    
+    /** Pick job to run next and mark it running, nullptr if there is nothing to do or the
+        core budget is used up. numThreads is set to the threads the job may use. */
+    SampleAnalyzer *pickNextJob(int &numThreads);
+    
+    /** Remove and delete finished job. */
+    void jobFinished(SampleAnalyzer *job);
+    
+    /** Is any job of client running? */
+    bool isRunning(Client *client);
+    
+    /** Return the cores of the core budget. */
+    int getCores() const noexcept;
+    
+    OwnedArray<Worker> workers;
+    Array<Entry> jobs;          // waiting and running jobs in order they were added
+    Atomic<int> coreBudget;     // see setCoreBudget()
+    Atomic<int> audioLoad;      // highest load reported in the current window, permille
+    Atomic<int> previousAudioLoad; // and in the window before it
+    Atomic<uint32> audioLoadWindow; // millisecond counter the current window started at
+    CriticalSection lock;       // guards jobs
+    WaitableEvent jobAdded;     // wakes workers up
+    WaitableEvent jobDone;      // wakes removeJobs() up
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisScheduler)
+};
+
+#endif  // ANALYSIS_SCHEDULER_H_INCLUDED
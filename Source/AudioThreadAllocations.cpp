@@ -0,0 +1,186 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+
+#include "AudioThreadAllocations.h"
+
+#ifdef PARAPHRASIS_TRACK_AUDIO_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+#if JUCE_WINDOWS
+ extern "C" __declspec(dllimport) unsigned short __stdcall RtlCaptureStackBackTrace(unsigned long, unsigned long, void **, unsigned long *);
+ #define PARAPHRASIS_THREAD_LOCAL __declspec(thread)
+#else
+ #include <execinfo.h>
+ #define PARAPHRASIS_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+    /** Allocation caught on the audio thread, written once by the thread which made it. */
+    struct CapturedStack
+    {
+        void *frames[AudioThreadAllocations::kMaxFrames];
+        int numFrames;
+        size_t size;            // bytes allocated, 0 for a release
+        Atomic<int> captured;   // are frames written?
+    };
+    
+    // plain thread locals, ready before any constructor runs (allocations come that early)
+    PARAPHRASIS_THREAD_LOCAL int audioThreadDepth = 0;   // scopes entered by this thread
+    PARAPHRASIS_THREAD_LOCAL bool insideHook = false;    // capturing, its own allocations are not caught
+    
+    Atomic<int> numAllocations;
+    CapturedStack stacks[AudioThreadAllocations::kMaxStacks];
+    int numLogged = 0;                                  // message thread only
+    
+    int captureStack(void **frames, int maxFrames) noexcept
+    {
+       #if JUCE_WINDOWS
+        return (int) RtlCaptureStackBackTrace(2, (unsigned long) maxFrames, frames, nullptr);
+       #else
+        return backtrace(frames, maxFrames);
+       #endif
+    }
+    
+    void allocationMade(size_t size) noexcept
+    {
+        if (audioThreadDepth == 0 || insideHook)
+            return;
+        
+        insideHook = true;
+        const int n = ++numAllocations;
+        if (n <= AudioThreadAllocations::kMaxStacks)
+        {
+            CapturedStack &stack = stacks[n - 1];
+            stack.size = size;
+            stack.numFrames = captureStack(stack.frames, AudioThreadAllocations::kMaxFrames);
+            stack.captured = 1;
+        }
+        insideHook = false;
+    }
+}
+
+//==============================================================================
+AudioThreadAllocations::ScopedAudioThread::ScopedAudioThread() noexcept
+{
+    ++audioThreadDepth;
+}
+
+AudioThreadAllocations::ScopedAudioThread::~ScopedAudioThread() noexcept
+{
+    --audioThreadDepth;
+}
+
+//==============================================================================
+int AudioThreadAllocations::getNumAllocations() noexcept
+{
+    return numAllocations.get();
+}
+
+//==============================================================================
+void AudioThreadAllocations::logAllocations()
+{
+    const int count = numAllocations.get();
+    if (count <= numLogged)
+        return;
+    
+    Logger::writeToLog("Paraphrasis: " + String(count) + " allocations on the audio thread");
+    
+    for (; numLogged < jmin(count, (int) kMaxStacks); numLogged++)
+    {
+        CapturedStack &stack = stacks[numLogged];
+        if (stack.captured.get() == 0)
+            break; // still being captured, logged next time
+        
+        String text;
+        text << (stack.size > 0 ? "allocation of " + String((int64) stack.size) + " bytes" : String("release")) << newLine;
+       #if JUCE_WINDOWS
+        for (int i = 0; i < stack.numFrames; i++)
+            text << "  0x" << String::toHexString((pointer_sized_int) stack.frames[i]) << newLine;
+       #else
+        if (char **symbols = backtrace_symbols(stack.frames, stack.numFrames))
+        {
+            for (int i = 0; i < stack.numFrames; i++)
+                text << "  " << symbols[i] << newLine;
+            ::free(symbols);
+        }
+       #endif
+        Logger::writeToLog(text);
+    }
+    
+    // stacks are not captured beyond kMaxStacks, later allocations are only counted
+    if (numLogged >= kMaxStacks)
+        numLogged = count;
+}
+
+//==============================================================================
+// Replaced global allocation functions, every allocation of the plugin comes through here.
+void *operator new(size_t size)
+{
+    allocationMade(size > 0 ? size : 1);
+    if (void *p = std::malloc(size > 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    allocationMade(size > 0 ? size : 1);
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+    if (p != nullptr)
+        allocationMade(0);
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    operator delete(p);
+}
+
+#endif  // PARAPHRASIS_TRACK_AUDIO_ALLOCATIONS
@@ -0,0 +1,73 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef AUDIO_THREAD_ALLOCATIONS_H_INCLUDED
+#define AUDIO_THREAD_ALLOCATIONS_H_INCLUDED
+
+#include "JuceHeader.h"
+
+/**
+ Debugging aid which catches heap allocations of the audio thread. It is built only with
+ PARAPHRASIS_TRACK_AUDIO_ALLOCATIONS defined (extra preprocessor definitions of a debug or
+ profiling build of the project), otherwise it is empty and costs nothing.
+ 
+ Global operator new and delete are replaced. Every allocation and release made by a
+ thread inside a ScopedAudioThread (processBlock() and the voice rendering workers) is
+ counted, and the stacks of the first kMaxStacks of them are captured without allocating.
+ logAllocations() writes the stacks captured since it was called last to the log.
+ */
+class AudioThreadAllocations
+{
+public:
+    enum { kMaxStacks = 16, kMaxFrames = 32 };
+    
+#ifdef PARAPHRASIS_TRACK_AUDIO_ALLOCATIONS
+    /** Marks the calling thread as the audio thread while it exists, scopes may nest. */
+    class ScopedAudioThread
+    {
+    public:
+        ScopedAudioThread() noexcept;
+        ~ScopedAudioThread() noexcept;
+        
+    private:
+        JUCE_DECLARE_NON_COPYABLE(ScopedAudioThread)
+    };
+    
+    /** Return the number of allocations and releases made inside ScopedAudioThread so far. */
+    static int getNumAllocations() noexcept;
+    
+    /** Write stacks of allocations captured since the last call to the log, with their count.
+        Called from the message thread. */
+    static void logAllocations();
+#else
+    class ScopedAudioThread
+    {
+    public:
+        ScopedAudioThread() noexcept {}
+    };
+    
+    static int getNumAllocations() noexcept { return 0; }
+    static void logAllocations() {}
+#endif
+};
+
+#endif  // AUDIO_THREAD_ALLOCATIONS_H_INCLUDED
@@ -0,0 +1,160 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "BankBrowser.h"
+
+//==============================================================================
+BankBrowser::BankBrowser(Listener &listener)
+    : Thread("Paraphrasis bank browser"), listener(listener), entries(library->getEntries())
+{
+    addAndMakeVisible(list = new ListBox("banks", this));
+    list->setRowHeight(16);
+    list->setColour(ListBox::backgroundColourId, Colour(0xfff0f0f0));
+    addAndMakeVisible(preview = new PartialView());
+    
+    library->addChangeListener(this);
+    startThread(3);
+}
+
+//==============================================================================
+BankBrowser::~BankBrowser()
+{
+    library->removeChangeListener(this);
+    stopThread(-1);
+    cancelPendingUpdate();
+}
+
+//==============================================================================
+void BankBrowser::resized()
+{
+    list->setBounds(0, 0, getWidth(), getHeight() - 68);
+    preview->setBounds(0, getHeight() - 64, getWidth(), 64);
+}
+
+//==============================================================================
+void BankBrowser::visibilityChanged()
+{
+    // banks prepared since the browser was shown last are listed
+    if (isVisible())
+        library->rescan();
+}
+
+//==============================================================================
+int BankBrowser::getNumRows()
+{
+    return (int) entries->size();
+}
+
+//==============================================================================
+void BankBrowser::paintListBoxItem(int row, Graphics &g, int width, int height, bool selected)
+{
+    if (row < 0 || row >= (int) entries->size())
+        return;
+    
+    const BankLibrary::Entry &entry = (*entries)[row];
+    if (selected)
+        g.fillAll(Colour(0x30000000));
+    
+    // banks which can not be loaded are greyed
+    g.setColour(Colour(entry.hasSource ? 0xdd000000 : 0x66000000));
+    g.setFont(Font(11.0f, Font::plain));
+    g.drawText(entry.getName(), 4, 0, width / 2 - 4, height, Justification::centredLeft, true);
+    
+    g.setFont(Font(10.0f, Font::plain));
+    g.drawText(String::formatted("%.1f Hz  %d  %.1f s  %.1f MB", entry.info.pitch, (int) entry.info.numPartials,
+                                 entry.info.duration, entry.info.imageSize / (1024. * 1024.)),
+               width / 2, 0, width / 2 - 4, height, Justification::centredRight, true);
+}
+
+//==============================================================================
+void BankBrowser::selectedRowsChanged(int lastRowSelected)
+{
+    {
+        const ScopedLock sl(loadLock);
+        requested = lastRowSelected >= 0 && lastRowSelected < (int) entries->size()
+                    ? (*entries)[lastRowSelected].file : File::nonexistent;
+    }
+    notify();
+}
+
+//==============================================================================
+void BankBrowser::listBoxItemDoubleClicked(int row, const MouseEvent &)
+{
+    if (row >= 0 && row < (int) entries->size() && (*entries)[row].hasSource)
+        listener.bankChosen((*entries)[row]);
+}
+
+//==============================================================================
+void BankBrowser::changeListenerCallback(ChangeBroadcaster *)
+{
+    // the selection follows its bank to its row in the new entries
+    const int selected = list->getSelectedRow();
+    const File selectedFile = selected >= 0 && selected < (int) entries->size() ? (*entries)[selected].file : File::nonexistent;
+    
+    entries = library->getEntries();
+    list->updateContent();
+    
+    for (int row = 0; row < (int) entries->size(); row++)
+        if ((*entries)[row].file == selectedFile)
+            list->selectRow(row, false, true);
+    list->repaint();
+}
+
+//==============================================================================
+void BankBrowser::run()
+{
+    File mapped;
+    while ( ! threadShouldExit())
+    {
+        File file;
+        {
+            const ScopedLock sl(loadLock);
+            file = requested;
+        }
+        
+        // mapping validates the whole bank, the message thread never waits for it
+        if (file != mapped)
+        {
+            Loris::PartialBank::Ptr bank = file.existsAsFile() ? AnalysisCache::readBankFile(file) : nullptr;
+            {
+                const ScopedLock sl(loadLock);
+                loaded = bank;
+            }
+            mapped = file;
+            triggerAsyncUpdate();
+        }
+        
+        wait(-1);
+    }
+}
+
+//==============================================================================
+void BankBrowser::handleAsyncUpdate()
+{
+    Loris::PartialBank::Ptr bank;
+    {
+        const ScopedLock sl(loadLock);
+        bank = loaded;
+    }
+    preview->setBank(bank);
+}
@@ -0,0 +1,84 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef BANK_BROWSER_H_INCLUDED
+#define BANK_BROWSER_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include "BankLibrary.h"
+#include "PartialView.h"
+
+/**
+ Browser of the banks of BankLibrary, shown by the editor. The list is drawn from the
+ descriptions of the library only. The bank selected is mapped on a background thread and
+ its partials shown below the list, double click loads its sample with the settings of its
+ analysis (see Listener), which finds the cached partials and bank.
+ */
+class BankBrowser : public Component,
+                    private ListBoxModel,
+                    private ChangeListener,
+                    private Thread,
+                    private AsyncUpdater
+{
+public:
+    /** Receives banks chosen to be loaded. */
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        
+        /** Load sample of entry with the settings of its analysis, entry has a source. */
+        virtual void bankChosen(const BankLibrary::Entry &entry) = 0;
+    };
+    
+    BankBrowser(Listener &listener);
+    ~BankBrowser();
+    
+    /** @internal */
+    void resized() override;
+    /** @internal */
+    void visibilityChanged() override;
+    
+private:
+    int getNumRows() override;
+    void paintListBoxItem(int row, Graphics &g, int width, int height, bool selected) override;
+    void selectedRowsChanged(int lastRowSelected) override;
+    void listBoxItemDoubleClicked(int row, const MouseEvent &event) override;
+    void changeListenerCallback(ChangeBroadcaster *source) override;
+    void run() override;
+    void handleAsyncUpdate() override;
+    
+    Listener &listener;
+    SharedResourcePointer<BankLibrary> library;
+    BankLibrary::Entries entries;   // Shown by the list
+    ScopedPointer<ListBox> list;
+    ScopedPointer<PartialView> preview;
+    
+    File requested;                 // Bank to map, guarded by loadLock
+    Loris::PartialBank::Ptr loaded; // Bank mapped last, guarded by loadLock
+    CriticalSection loadLock;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BankBrowser)
+};
+
+#endif  // BANK_BROWSER_H_INCLUDED
@@ -0,0 +1,195 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "BankLibrary.h"
+
+#include <algorithm>
+
+// Fields of an index line before the source of the bank, see run().
+static const int kIndexFields = 11;
+
+//==============================================================================
+String BankLibrary::Entry::getName() const
+{
+    return hasSource ? File(source.samplePath).getFileName() : contentKey;
+}
+
+//==============================================================================
+BankLibrary::BankLibrary(const File &directory)
+    : Thread("Paraphrasis bank library"), directory(directory), entries(std::make_shared<std::vector<Entry>>())
+{
+    startThread(2);
+}
+
+//==============================================================================
+BankLibrary::~BankLibrary()
+{
+    stopThread(-1);
+}
+
+//==============================================================================
+void BankLibrary::rescan()
+{
+    notify();
+}
+
+//==============================================================================
+BankLibrary::Entries BankLibrary::getEntries() const
+{
+    const ScopedLock sl(lock);
+    return entries;
+}
+
+//==============================================================================
+void BankLibrary::readIndex(HashMap<String, String> &lines) const
+{
+    StringArray read;
+    directory.getChildFile("BankLibrary.txt").readLines(read);
+    
+    // lines of bank file name, its size and modification time, and its description
+    for (const String &line : read)
+        if (line.containsChar('\t'))
+            lines.set(line.upToFirstOccurrenceOf("\t", false, false), line);
+}
+
+//==============================================================================
+bool BankLibrary::describe(const File &file, Entry &entry) const
+{
+    // only the header of the image is read
+    FileInputStream in(file);
+    HeapBlock<char> header(Loris::PartialBank::imageHeaderSize());
+    if (in.failedToOpen() || in.read(header, (int) Loris::PartialBank::imageHeaderSize())
+                             != (int) Loris::PartialBank::imageHeaderSize())
+        return false;
+    
+    try
+    {
+        entry.info = Loris::PartialBank::imageInfo(header, Loris::PartialBank::imageHeaderSize());
+    }
+    catch (...)
+    {
+        return false;
+    }
+    
+    entry.hasSource = AnalysisCache(directory).readSource(entry.analysisKey, entry.source);
+    return entry.info.imageSize <= (size_t) file.getSize();
+}
+
+//==============================================================================
+void BankLibrary::run()
+{
+    while ( ! threadShouldExit())
+    {
+        HashMap<String, String> indexed;
+        readIndex(indexed);
+        
+        Array<File> files;
+        directory.findChildFiles(files, File::findFiles, false, "*.bank");
+        
+        std::shared_ptr<std::vector<Entry>> scanned = std::make_shared<std::vector<Entry>>();
+        StringArray lines;
+        bool changed = false;
+        for (const File &file : files)
+        {
+            if (threadShouldExit())
+                return;
+            
+            // bank key is the key of the analysis followed by the bank settings, see
+            // LorisSynthesiser::getBankKey()
+            StringArray keys;
+            keys.addTokens(file.getFileNameWithoutExtension(), "-", String::empty);
+            if (keys.size() < 4)
+                continue;
+            
+            Entry entry;
+            entry.file = file;
+            entry.contentKey = keys[0] + "-" + keys[1];
+            entry.analysisKey = entry.contentKey + "-" + keys[2];
+            
+            // the header is read again only if the file changed since it was indexed
+            const String name = file.getFileName();
+            const String stamp = name + "\t" + String(file.getSize()) + "\t"
+                                 + String(file.getLastModificationTime().toMilliseconds());
+            StringArray fields;
+            fields.addTokens(indexed[name], "\t", String::empty);
+            if (fields.size() > kIndexFields && fields.joinIntoString("\t", 0, 3) == stamp)
+            {
+                entry.info.encoding = (Loris::PartialBank::Encoding) fields[3].getIntValue();
+                entry.info.numPartials = (size_t) fields[4].getLargeIntValue();
+                entry.info.numBreakpoints = (size_t) fields[5].getLargeIntValue();
+                entry.info.pitch = fields[6].getDoubleValue();
+                entry.info.sampleRate = fields[7].getDoubleValue();
+                entry.info.duration = fields[8].getDoubleValue();
+                entry.info.imageSize = (size_t) fields[9].getLargeIntValue();
+                entry.info.phaseFree = keys[keys.size() - 1] == "p";
+                entry.hasSource = fields[10].getIntValue() != 0
+                                  && entry.source.fromString(fields.joinIntoString("\t", kIndexFields));
+                
+                // source of a bank analysed before sources were stored is found later
+                if (!entry.hasSource)
+                {
+                    entry.hasSource = AnalysisCache(directory).readSource(entry.analysisKey, entry.source);
+                    changed = changed || entry.hasSource;
+                }
+            }
+            else if (describe(file, entry))
+            {
+                changed = true;
+            }
+            else
+            {
+                continue;
+            }
+            
+            lines.add(stamp + "\t" + String((int) entry.info.encoding) + "\t" + String((int64) entry.info.numPartials)
+                      + "\t" + String((int64) entry.info.numBreakpoints) + "\t" + String(entry.info.pitch, 17)
+                      + "\t" + String(entry.info.sampleRate, 17) + "\t" + String(entry.info.duration, 17)
+                      + "\t" + String((int64) entry.info.imageSize) + "\t" + String((int) entry.hasSource)
+                      + "\t" + (entry.hasSource ? entry.source.toString() : AnalysisCache::Source().toString()));
+            scanned->push_back(entry);
+        }
+        
+        std::sort(scanned->begin(), scanned->end(), [](const Entry &a, const Entry &b)
+                  {
+                      const int order = a.getName().compareIgnoreCase(b.getName());
+                      return order != 0 ? order < 0 : a.info.pitch < b.info.pitch;
+                  });
+        
+        // index is written when banks were added, changed or deleted, other instances may
+        // read it, so it is written aside first
+        if (changed || lines.size() != indexed.size())
+        {
+            TemporaryFile temp(directory.getChildFile("BankLibrary.txt"));
+            if (temp.getFile().replaceWithText(lines.joinIntoString("\n") + "\n"))
+                temp.overwriteTargetFileWithTemporary();
+        }
+        
+        {
+            const ScopedLock sl(lock);
+            entries = scanned;
+        }
+        sendChangeMessage();
+        
+        wait(-1);
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef BANK_LIBRARY_H_INCLUDED
+#define BANK_LIBRARY_H_INCLUDED
+
+#include "JuceHeader.h"
+#include "AnalysisCache.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ Library of the banks in AnalysisCache, browsed by editors without reading the banks. A bank
+ is described by the header of its image (see Loris::PartialBank::imageInfo()) and the source
+ stored with its analysis (see AnalysisCache::Source). The descriptions are kept in an index
+ file in the cache, so a scan reads the headers of new and changed bank files only, and the
+ rest of a bank file is never read. Scans run on a background thread, editors of all
+ instances share the library through SharedResourcePointer and are told about new entries
+ as a ChangeBroadcaster.
+ */
+class BankLibrary : public ChangeBroadcaster,
+                    private Thread
+{
+public:
+    /** Description of a bank file. */
+    struct Entry
+    {
+        File file;
+        String contentKey;                      // see AnalysisCache::createContentKey()
+        String analysisKey;                     // key of the partials the bank was prepared from
+        Loris::PartialBank::ImageInfo info;
+        bool hasSource = false;                 // source is unknown for banks of deleted partials
+        AnalysisCache::Source source;
+        
+        /** Return the file name of the sample, or the content key if the source is unknown. */
+        String getName() const;
+    };
+    
+    /** Entries of a scan, sorted by name and pitch, shared by readers. */
+    typedef std::shared_ptr<const std::vector<Entry>> Entries;
+    
+    /** Create library of banks in given directory, it is scanned in background right away. */
+    BankLibrary(const File &directory = AnalysisCache::getDefaultDirectory());
+    ~BankLibrary();
+    
+    /** Scan the directory again in background, change message is sent when it is done. */
+    void rescan();
+    
+    /** Return entries of the last scan, empty until it is done. */
+    Entries getEntries() const;
+    
+private:
+    void run() override;
+    
+    /** Read descriptions of the banks from the index. */
+    void readIndex(HashMap<String, String> &lines) const;
+    
+    /** Describe a bank file by its header and source.
+        @return false if it is not a valid bank file. */
+    bool describe(const File &file, Entry &entry) const;
+    
+    File directory;
+    Entries entries;                // Guarded by lock
+    CriticalSection lock;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BankLibrary)
+};
+
+#endif  // BANK_LIBRARY_H_INCLUDED
@@ -0,0 +1,211 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#include "BankStreamer.h"
+
+#if ! JUCE_WINDOWS
+ #include <sys/mman.h>
+#endif
+
+//==============================================================================
+BankStreamer::BankStreamer() : Thread("Paraphrasis bank streamer")
+{
+    for (int i = 0; i < kMaxVoices; i++)
+        voices[i].zone = -1;
+}
+
+//==============================================================================
+BankStreamer::~BankStreamer()
+{
+    stopThread(-1);
+}
+
+//==============================================================================
+bool BankStreamer::shouldStream(const Loris::PartialBank &bank) noexcept
+{
+    Loris::PartialBank::MemoryRange ranges[Loris::PartialBank::NumBreakpointArrays];
+    bank.breakpointMemory(0, bank.numBreakpoints(), ranges);
+    
+    size_t bytes = 0;
+    for (const Loris::PartialBank::MemoryRange &range : ranges)
+        bytes += range.size;
+    return bank.isImage() && bytes >= (size_t) kMinStreamedBytes;
+}
+
+//==============================================================================
+void BankStreamer::setBank(int zone, Loris::PartialBank::Ptr bank)
+{
+    if (zone < 0 || zone >= kMaxZones)
+        return;
+    
+    {
+        const ScopedLock sl(banksLock);
+        banks[zone] = bank != nullptr && shouldStream(*bank) ? bank : Loris::PartialBank::Ptr();
+    }
+    
+    // left running once a bank was streamed, it only waits when there is nothing to stream
+    if (banks[zone] != nullptr && ! isThreadRunning())
+        startThread(4);
+    notify();
+}
+
+//==============================================================================
+int BankStreamer::addVoice() noexcept
+{
+    for (int i = 0; i < kMaxVoices; i++)
+    {
+        if (voices[i].used.compareAndSetBool(1, 0))
+        {
+            voices[i].zone = -1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+//==============================================================================
+void BankStreamer::removeVoice(int slot) noexcept
+{
+    if (slot >= 0 && slot < kMaxVoices)
+    {
+        voices[slot].zone = -1;
+        voices[slot].used = 0;
+    }
+}
+
+//==============================================================================
+void BankStreamer::setVoicePosition(int slot, int zone, int sample) noexcept
+{
+    if (slot < 0 || slot >= kMaxVoices)
+        return;
+    
+    // the thread may read the zone of one block and the sample of the next, it only
+    // reads a window the voice is about to play
+    voices[slot].sample = sample;
+    voices[slot].zone = zone;
+}
+
+//==============================================================================
+void BankStreamer::run()
+{
+    while ( ! threadShouldExit())
+    {
+        for (int zone = 0; zone < kMaxZones && ! threadShouldExit(); zone++)
+        {
+            Loris::PartialBank::Ptr bank;
+            {
+                const ScopedLock sl(banksLock);
+                bank = banks[zone];
+            }
+            
+            // pages of a replaced bank are unmapped with it, nothing is released
+            Stream &stream = streams[zone];
+            if (stream.bank != bank)
+            {
+                stream = Stream();
+                stream.bank = bank;
+            }
+            if (bank != nullptr)
+                update(stream, zone);
+        }
+        
+        wait(kPollIntervalMs);
+    }
+}
+
+//==============================================================================
+void BankStreamer::update(Stream &stream, int zone)
+{
+    const Loris::PartialBank &bank = *stream.bank;
+    if (stream.base == nullptr)
+    {
+        // arrays are page aligned in the image and follow each other, phase-free banks
+        // have no phase array
+        Loris::PartialBank::MemoryRange ranges[Loris::PartialBank::NumBreakpointArrays];
+        bank.breakpointMemory(0, bank.numBreakpoints(), ranges);
+        const char *first = static_cast<const char *>(ranges[0].data);
+        const char *last = first;
+        for (const Loris::PartialBank::MemoryRange &range : ranges)
+        {
+            if (range.size == 0)
+                continue;
+
+            first = jmin(first, static_cast<const char *>(range.data));
+            last = jmax(last, static_cast<const char *>(range.data) + range.size);
+        }
+        
+        stream.base = first - (reinterpret_cast<pointer_sized_uint>(first) % kPageSize);
+        const size_t numPages = (size_t) (last - stream.base + kPageSize - 1) / kPageSize;
+        stream.resident.assign(numPages, 0);
+        stream.wanted.assign(numPages, 0);
+    }
+    
+    // notes start at the beginning, voices play on from where they are
+    std::fill(stream.wanted.begin(), stream.wanted.end(), 0);
+    want(stream, 0);
+    for (int i = 0; i < kMaxVoices; i++)
+        if (voices[i].used.get() != 0 && voices[i].zone.get() == zone)
+            want(stream, voices[i].sample.get());
+    
+    for (size_t page = 0; page < stream.resident.size(); page++)
+    {
+        const char *data = stream.base + page * kPageSize;
+        if (stream.wanted[page] != 0 && stream.resident[page] == 0)
+        {
+            // reading a byte faults the page in, here and not on the audio thread
+            const volatile char *touched = data;
+            (void) *touched;
+            stream.resident[page] = 1;
+        }
+        else if (stream.wanted[page] == 0 && stream.resident[page] != 0)
+        {
+           #if ! JUCE_WINDOWS
+            madvise(const_cast<char *>(data), kPageSize, MADV_DONTNEED);
+           #endif
+            stream.resident[page] = 0;
+        }
+    }
+}
+
+//==============================================================================
+void BankStreamer::want(Stream &stream, int sample)
+{
+    const Loris::PartialBank &bank = *stream.bank;
+    const int lookahead = (int) (kLookaheadMs * 0.001 * bank.sampleRate());
+    
+    size_t first = 0, last = 0;
+    bank.breakpointWindow(sample, sample + jmax(lookahead, 1), first, last);
+    
+    Loris::PartialBank::MemoryRange ranges[Loris::PartialBank::NumBreakpointArrays];
+    bank.breakpointMemory(first, last, ranges);
+    for (const Loris::PartialBank::MemoryRange &range : ranges)
+    {
+        if (range.size == 0)
+            continue;
+        
+        const char *data = static_cast<const char *>(range.data);
+        const size_t firstPage = (size_t) (data - stream.base) / kPageSize;
+        const size_t lastPage = jmin((size_t) (data + range.size - 1 - stream.base) / kPageSize, stream.wanted.size() - 1);
+        for (size_t page = firstPage; page <= lastPage; page++)
+            stream.wanted[page] = 1;
+    }
+}
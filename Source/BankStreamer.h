@@ -0,0 +1,116 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef BANK_STREAMER_H_INCLUDED
+#define BANK_STREAMER_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include "PartialBank.h"
+
+#include <vector>
+
+/**
+ Streams partial banks of long sounds from their mapped cache files ahead of the voices playing
+ them. Breakpoints of a bank are stored in the onset order of their partials, so the ones voices
+ play in the next kLookaheadMs are a range of each breakpoint array (see
+ Loris::PartialBank::breakpointWindow()). A background thread reads the pages of these ranges
+ before voices reach them and releases pages no voice plays any more, they are read from the file
+ again when a voice comes back. Only a sliding window of breakpoints is resident, whatever the
+ length of the sound.
+
+ Voices publish the sample of the bank they play by atomics, the audio thread never waits for the
+ thread. A note starting far from where any voice plays (a start position or a loop jump) may read
+ pages which are not resident, the thread reads them within kPollIntervalMs.
+ */
+class BankStreamer : private Thread
+{
+public:
+    enum
+    {
+        kMaxZones = 16,             // Key zones, as LorisVoice::kMaxZones
+        kMaxVoices = 64,            // Voices publishing their position
+        kPollIntervalMs = 10,       // The thread follows voices this often
+        kLookaheadMs = 2000,        // Breakpoints read ahead of voices and of note starts
+        kPageSize = 4096,           // Pages read and released, images are aligned to them
+        kMinStreamedBytes = 16 << 20// Breakpoint arrays of banks streamed at least
+    };
+
+    BankStreamer();
+    ~BankStreamer();
+
+    /** Return true if the bank is worth streaming: mapped from an image and large. */
+    static bool shouldStream(const Loris::PartialBank &bank) noexcept;
+
+    /** Set the bank voices of a zone play, it is streamed if shouldStream() says so. Do not call
+        it from the audio thread, the thread is started here.
+        @param zone index of the key zone
+        @param bank bank voices play in the zone, empty for none */
+    void setBank(int zone, Loris::PartialBank::Ptr bank);
+
+    /** Return a slot a voice publishes its position in, -1 if there is none left. Do not call it
+        from the audio thread. */
+    int addVoice() noexcept;
+
+    /** Free slot of a voice which is deleted. */
+    void removeVoice(int slot) noexcept;
+
+    /** Publish sample of the bank a voice plays. Called from the audio thread.
+        @param slot slot of the voice, see addVoice(), nothing is done for -1
+        @param zone zone of the bank, -1 when the voice does not play */
+    void setVoicePosition(int slot, int zone, int sample) noexcept;
+
+private:
+    /** Position published by a voice. */
+    struct Voice
+    {
+        Atomic<int> used;
+        Atomic<int> zone;       // -1 when not playing
+        Atomic<int> sample;     // Sample of the bank
+    };
+
+    /** Pages of the breakpoint arrays of a streamed bank, accessed by the thread only. */
+    struct Stream
+    {
+        Loris::PartialBank::Ptr bank;
+        const char *base = nullptr;     // First page of the breakpoint arrays
+        std::vector<char> resident;     // Per page, read by the thread
+        std::vector<char> wanted;       // Per page, played in the next kLookaheadMs
+    };
+
+    void run() override;
+
+    /** Read pages voices will play and release the others. */
+    void update(Stream &stream, int zone);
+
+    /** Mark pages of breakpoints played from a sample for kLookaheadMs. */
+    void want(Stream &stream, int sample);
+
+    Voice voices[kMaxVoices];
+    Loris::PartialBank::Ptr banks[kMaxZones];   // Guarded by banksLock
+    CriticalSection banksLock;
+    Stream streams[kMaxZones];                  // Accessed by the thread only
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BankStreamer)
+};
+
+#endif  // BANK_STREAMER_H_INCLUDED
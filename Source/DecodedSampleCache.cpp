@@ -0,0 +1,85 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+
+#include "DecodedSampleCache.h"
+
+//==============================================================================
+DecodedSampleCache::DecodedSampleCache(int maxEntries)
+    : maxEntries(jmax(1, maxEntries))
+{
+}
+
+//==============================================================================
+DecodedSampleCache::Samples DecodedSampleCache::find(const File &sample, bool reverse, int downmix)
+{
+    const String path = sample.getFullPathName();
+    const Time modified = sample.getLastModificationTime();
+    
+    const ScopedLock sl(lock);
+    
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].path != path || entries[i].reverse != reverse || entries[i].downmix != downmix)
+            continue;
+        
+        // file was edited since it was decoded
+        if (entries[i].modified != modified)
+        {
+            entries.erase(entries.begin() + i);
+            return Samples();
+        }
+        
+        // move to front, it is the most recently used now
+        std::rotate(entries.begin(), entries.begin() + i, entries.begin() + i + 1);
+        return entries.front().samples;
+    }
+    
+    return Samples();
+}
+
+//==============================================================================
+void DecodedSampleCache::add(const File &sample, bool reverse, int downmix, const Samples &samples)
+{
+    Entry entry;
+    entry.path = sample.getFullPathName();
+    entry.modified = sample.getLastModificationTime();
+    entry.reverse = reverse;
+    entry.downmix = downmix;
+    entry.samples = samples;
+    
+    const ScopedLock sl(lock);
+    
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].path == entry.path && entries[i].reverse == reverse && entries[i].downmix == downmix)
+        {
+            entries.erase(entries.begin() + i);
+            break;
+        }
+    }
+    
+    entries.insert(entries.begin(), entry);
+    
+    if (entries.size() > (size_t) maxEntries)
+        entries.resize((size_t) maxEntries);
+}
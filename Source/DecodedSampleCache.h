@@ -0,0 +1,75 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef DECODED_SAMPLE_CACHE_H_INCLUDED
+#define DECODED_SAMPLE_CACHE_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ In-memory cache of the decoded beginnings of samples. Pitch detection, preview analysis
+ and full analysis of a processor draw the beginning of the sample from one decoded
+ buffer, so analysing the sample again (preview followed by the full analysis, edited
+ analysis parameters) does not read and decode it again.
+ 
+ Only the beginning of a sample is kept, the rest is read by analysis chunk by chunk, so
+ memory does not depend on sample length. Entries are keyed by file path, modification
+ time, direction (reversed sample is decoded from its end) and stereo downmix, the least
+ recently used one is dropped when the cache is full.
+ */
+class DecodedSampleCache
+{
+public:
+    /** Mono samples decoded from the beginning of the (reversed) sample, shared by jobs. */
+    typedef std::shared_ptr<const std::vector<float>> Samples;
+    
+    /** Create cache keeping samples of given number of files. */
+    DecodedSampleCache(int maxEntries = 4);
+    
+    /** Find decoded samples of a file.
+        @return samples or empty pointer if they are not cached or the file was modified. */
+    Samples find(const File &sample, bool reverse, int downmix);
+    
+    /** Store decoded samples of a file, replacing older ones. */
+    void add(const File &sample, bool reverse, int downmix, const Samples &samples);
+    
+private:
+    struct Entry
+    {
+        String path;
+        Time modified;
+        bool reverse;
+        int downmix;
+        Samples samples;
+    };
+    
+    std::vector<Entry> entries;     // most recently used first
+    int maxEntries;
+    CriticalSection lock;           // guards entries, jobs run in parallel
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DecodedSampleCache)
+};
+
+#endif  // DECODED_SAMPLE_CACHE_H_INCLUDED
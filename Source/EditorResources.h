@@ -0,0 +1,50 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef EDITOR_RESOURCES_H_INCLUDED
+#define EDITOR_RESOURCES_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include "ResourceCache.h"
+
+/**
+ Images of the editor, one cache shared by all instances in the host process (through
+ SharedResourcePointer). Each image is decoded when an editor draws it first and kept for
+ the editors opened later, so reopening editors of many instances decodes nothing again.
+ The cache is freed with the last instance.
+ */
+class EditorResources
+{
+public:
+    EditorResources();
+    
+    /** Return the cache given to the editors, owned by this. */
+    teragon::ResourceCache *getCache() const noexcept   { return cache; }
+    
+private:
+    ScopedPointer<teragon::ResourceCache> cache;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EditorResources)
+};
+
+#endif  // EDITOR_RESOURCES_H_INCLUDED
@@ -0,0 +1,334 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#include "LiveResynthesiser.h"
+#include "ScopedNoDenormals.h"
+
+#include "Breakpoint.h"
+
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+LiveResynthesiser::LiveResynthesiser() : Thread("Paraphrasis live analysis")
+{
+}
+
+//==============================================================================
+LiveResynthesiser::~LiveResynthesiser()
+{
+    stopThread(-1);
+}
+
+//==============================================================================
+void LiveResynthesiser::prepare(double newSampleRate, int samplesPerBlock, double resolution)
+{
+    stopThread(-1);
+
+    analysis.reset(new Loris::Analyzer::LiveAnalysis(Loris::Analyzer(resolution), newSampleRate));
+    const int windowLength = (int) analysis->windowLength();
+    const int hopLength = (int) analysis->hop();
+    jassert(hopLength < windowLength);
+
+    window.assign(windowLength, 0.);
+    windowFilled = 0;
+    threadGeneration = -1;
+    threadFrame = 0;
+    sampleRate = newSampleRate;
+
+    // frame k ends with input sample (k + 1) * hop and is reached lead samples later; the
+    // audio thread ramps to it from the block after the one the sample came in, so the thread
+    // has a block (at least a hop) to analyse it
+    const int leadLength = hopLength + jmax(hopLength, samplesPerBlock);
+    hopSamples = hopLength;
+    leadSamples = leadLength;
+    latency = leadLength + windowLength / 2 + 1;
+    configuration += 1;
+
+    startThread(8);
+}
+
+//==============================================================================
+void LiveResynthesiser::release()
+{
+    stopThread(-1);
+
+    // the audio thread stops playing at its next block
+    hopSamples = 0;
+    leadSamples = 0;
+    latency = 0;
+    configuration += 1;
+}
+
+//==============================================================================
+void LiveResynthesiser::reset() noexcept
+{
+    ++generation;
+    position = 0;
+    appliedFrame = -1;
+    for (Slot &slot : slots)
+    {
+        slot.label = 0;
+        slot.fading = false;
+    }
+}
+
+//==============================================================================
+void LiveResynthesiser::pushInput(const AudioSampleBuffer &buffer, int numChannels, int numSamples) noexcept
+{
+    const int config = configuration.get();
+    if (config != audioConfiguration)
+    {
+        audioConfiguration = config;
+        hop = hopSamples.get();
+        lead = leadSamples.get();
+        reset();
+    }
+    if (hop <= 0 || numChannels <= 0)
+        return;
+
+    const float gain = 1.f / numChannels;
+    Chunk chunk;
+    chunk.generation = generation;
+    for (int start = 0; start < numSamples; start += kChunkSize)
+    {
+        chunk.numSamples = jmin((int) kChunkSize, numSamples - start);
+        FloatVectorOperations::copyWithMultiply(chunk.samples, buffer.getReadPointer(0, start), gain, chunk.numSamples);
+        for (int i = 1; i < numChannels; ++i)
+            FloatVectorOperations::addWithMultiply(chunk.samples, buffer.getReadPointer(i, start), gain, chunk.numSamples);
+
+        // dropped when the thread is late, its frames are late too
+        chunks.try_enqueue(chunk);
+    }
+}
+
+//==============================================================================
+void LiveResynthesiser::renderNextBlock(AudioSampleBuffer &buffer, int numSamples) noexcept
+{
+    if (hop <= 0)
+        return;
+
+    float samples[kChunkSize];
+    for (int done = 0; done < numSamples;)
+    {
+        // frame k is reached at sample (k + 1) * hop + lead, ramped to over the hop before it
+        int64 segmentEnd = lead;
+        if (position >= lead)
+        {
+            const int64 k = (position - lead) / hop;
+            segmentEnd = (k + 1) * hop + lead;
+            if (k != appliedFrame)
+            {
+                bool found = popFrame(k, popped);
+                for (int waited = 0; !found && nonRealtime && waited < kOfflineWaitMs; ++waited)
+                {
+                    Thread::sleep(1);
+                    found = popFrame(k, popped);
+                }
+
+                // a late frame is ramped to over the rest of its hop, the oscillators hold
+                // the partials of the frame before it until then
+                if (found)
+                {
+                    applyFrame(popped);
+                    appliedFrame = k;
+                }
+            }
+        }
+
+        const int toTarget = (int) (segmentEnd - position);
+        const int n = jmin(toTarget, numSamples - done, (int) kChunkSize);
+        FloatVectorOperations::clear(samples, n);
+        for (Slot &slot : slots)
+        {
+            if (slot.label != 0)
+                slot.oscillator.oscillate(samples, samples + n, slot.target.frequency, slot.target.amplitude,
+                                          slot.target.bandwidth, rate, toTarget);
+        }
+
+        for (int i = jmin(buffer.getNumChannels(), 2); --i >= 0;)
+            buffer.addFrom(i, done, samples, n);
+
+        position += n;
+        done += n;
+    }
+}
+
+//==============================================================================
+bool LiveResynthesiser::popFrame(int64 index, Frame &frame) noexcept
+{
+    while (const Frame *front = frames.peek())
+    {
+        if (front->generation == generation && front->index > index)
+            return false;
+
+        const bool found = front->generation == generation && front->index == index;
+        if (found)
+            frame = *front;
+        frames.pop();
+        if (found)
+            return true;
+    }
+    return false;
+}
+
+//==============================================================================
+void LiveResynthesiser::applyFrame(const Frame &frame) noexcept
+{
+    rate = frame.sampleRate;
+
+    // partials faded out over the last hop are done, the others fade out unless the frame
+    // extends them
+    for (Slot &slot : slots)
+    {
+        if (slot.fading)
+            slot.label = 0;
+        slot.fading = slot.label != 0;
+    }
+
+    for (int i = 0; i < frame.numTracks; ++i)
+    {
+        const Track &track = frame.tracks[i];
+        Slot *slot = nullptr;
+        for (Slot &s : slots)
+        {
+            if (s.label == track.label)
+            {
+                slot = &s;
+                break;
+            }
+        }
+
+        // new partial fades in over the hop, from the phase reaching the one of the frame
+        if (slot == nullptr)
+        {
+            for (Slot &s : slots)
+            {
+                if (s.label == 0)
+                {
+                    slot = &s;
+                    break;
+                }
+            }
+            if (slot == nullptr)
+                continue;
+
+            slot->label = track.label;
+            const double phase = track.phase - 2 * double_Pi * track.frequency * hop / rate;
+            slot->oscillator.resetEnvelopes(Loris::Breakpoint(track.frequency, 0, track.bandwidth, phase), rate);
+        }
+
+        slot->target = track;
+        slot->fading = false;
+    }
+
+    for (Slot &slot : slots)
+    {
+        if (slot.fading)
+            slot.target.amplitude = 0;
+    }
+}
+
+//==============================================================================
+void LiveResynthesiser::run()
+{
+    const ScopedNoDenormals noDenormals;
+    const int windowLength = (int) window.size();
+    const int hopLength = (int) analysis->hop();
+
+    while ( ! threadShouldExit())
+    {
+        while (const Chunk *chunk = chunks.peek())
+        {
+            // input after a reset starts over with an empty window
+            if (chunk->generation != threadGeneration)
+            {
+                threadGeneration = chunk->generation;
+                threadFrame = 0;
+                analysis->reset();
+                std::fill(window.begin(), window.end(), 0.);
+                windowFilled = 0;
+            }
+
+            for (int read = 0; read < chunk->numSamples;)
+            {
+                // the window slides by a hop before the samples of the next frame fill its end
+                if (windowFilled == 0)
+                    std::copy(window.begin() + hopLength, window.end(), window.begin());
+
+                const int n = jmin(hopLength - windowFilled, chunk->numSamples - read);
+                std::copy(chunk->samples + read, chunk->samples + read + n,
+                          window.begin() + (windowLength - hopLength + windowFilled));
+                read += n;
+                windowFilled += n;
+
+                if (windowFilled == hopLength)
+                {
+                    analyseFrame();
+                    windowFilled = 0;
+                }
+            }
+            chunks.pop();
+
+            if (threadShouldExit())
+                return;
+        }
+
+        wait(kPollIntervalMs);
+    }
+}
+
+//==============================================================================
+void LiveResynthesiser::analyseFrame()
+{
+    const double frameTime = analysis->frameTime();
+    tracks.clear();
+    analysis->analyzeFrame(window.data(), tracks);
+
+    // partial budget, the loudest are played
+    typedef Loris::Analyzer::LiveAnalysis::Track LiveTrack;
+    if (tracks.size() > (size_t) kMaxPartials)
+        std::nth_element(tracks.begin(), tracks.begin() + kMaxPartials, tracks.end(),
+                         [](const LiveTrack &a, const LiveTrack &b)
+                         { return a.breakpoint.amplitude() > b.breakpoint.amplitude(); });
+
+    analysed.generation = threadGeneration;
+    analysed.index = threadFrame++;
+    analysed.sampleRate = sampleRate;
+    analysed.numTracks = jmin((int) tracks.size(), (int) kMaxPartials);
+    for (int i = 0; i < analysed.numTracks; ++i)
+    {
+        // phase at the center of the frame, the breakpoint is at the reassigned time
+        const LiveTrack &live = tracks[i];
+        const Loris::Breakpoint &bp = live.breakpoint;
+        Track &track = analysed.tracks[i];
+        track.label = live.label;
+        track.frequency = (float) bp.frequency();
+        track.amplitude = (float) bp.amplitude();
+        track.bandwidth = (float) bp.bandwidth();
+        track.phase = (float) std::remainder(bp.phase() + 2 * double_Pi * bp.frequency() * (frameTime - live.time),
+                                             2 * double_Pi);
+    }
+
+    // dropped when the audio thread does not play, it skips missing frames
+    frames.try_enqueue(analysed);
+}
@@ -0,0 +1,177 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef LIVE_RESYNTHESISER_H_INCLUDED
+#define LIVE_RESYNTHESISER_H_INCLUDED
+
+#include "JuceHeader.h"
+#include "readerwriterqueue/readerwriterqueue.h"
+
+#include "Analyzer.h"
+#include "RealtimeOscillator.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ Resynthesises the input of the plugin as it plays, a spectral effect instead of a sample player.
+ The audio thread queues chunks of the mono mix of the input, a background thread analyses a
+ short-time frame (Loris::Analyzer::LiveAnalysis) every hop of them and queues the loudest
+ kMaxPartials partials of each frame back. The audio thread ramps an oscillator per partial to
+ the partials of a frame, reaching them a fixed latency after the samples at the center of the
+ frame came in: half the analysis window, a hop and a block for the thread to analyse the frame
+ (see getLatencySamples()). Both queues are lock-free, the audio thread never waits for the
+ thread in real time.
+
+ Partials keep their oscillators while the analysis extends them, new ones fade in and finished
+ ones fade out over a hop.
+ */
+class LiveResynthesiser : private Thread
+{
+public:
+    enum
+    {
+        kMaxPartials = 64,          // Loudest partials of a frame played, the rest is dropped
+        kChunkSize = 256,           // Input samples of a queued chunk
+        kQueuedChunks = 256,        // Input chunks waiting for the thread
+        kQueuedFrames = 32,         // Analysed frames waiting for the audio thread
+        kPollIntervalMs = 1,        // The thread looks for input this often
+        kOfflineWaitMs = 1000       // Rendering offline waits this long for a late frame
+    };
+
+    LiveResynthesiser();
+    ~LiveResynthesiser();
+
+    /** Analyse input at sampleRate with the frequency resolution, in blocks of about
+        samplesPerBlock, and start the thread. The audio thread starts over with the new
+        analysis at its next block. Do not call it from the audio thread. */
+    void prepare(double sampleRate, int samplesPerBlock, double resolution);
+
+    /** Stop the thread, input is not analysed until prepare() is called again. Do not call it
+        from the audio thread. */
+    void release();
+
+    /** Return the samples from input to output, 0 until prepared. */
+    int getLatencySamples() const noexcept { return latency.get(); }
+
+    /** Offline bounces wait for the thread instead of playing frames it did not analyse yet.
+        Called from the audio thread. */
+    void setNonRealtime(bool isNonRealtime) noexcept { nonRealtime = isNonRealtime; }
+
+    /** Start over: playing partials are dropped and input queued before is not played. Called
+        from the audio thread, when live input is switched on. */
+    void reset() noexcept;
+
+    /** Queue the mono mix of the first numChannels channels (the inputs) of a block for
+        analysis. Called from the audio thread before the synth overwrites the input. */
+    void pushInput(const AudioSampleBuffer &buffer, int numChannels, int numSamples) noexcept;
+
+    /** Add the resynthesised input to the first two channels of a block, numSamples after the
+        block queued by pushInput(). Called from the audio thread. */
+    void renderNextBlock(AudioSampleBuffer &buffer, int numSamples) noexcept;
+
+private:
+    /** Input samples queued by the audio thread. */
+    struct Chunk
+    {
+        int generation;             // reset() the samples were queued after
+        int numSamples;
+        float samples[kChunkSize];
+    };
+
+    /** Partial of an analysed frame. */
+    struct Track
+    {
+        int64 label;                // Identifies the partial while the analysis extends it
+        float frequency;
+        float amplitude;
+        float bandwidth;
+        float phase;                // At the center of the frame
+    };
+
+    /** Analysed frame queued by the thread. */
+    struct Frame
+    {
+        int generation;
+        int64 index;                // Frames of a generation are hop samples apart
+        double sampleRate;          // Of the analysis
+        int numTracks;
+        Track tracks[kMaxPartials];
+    };
+
+    /** Oscillator of a playing partial, audio thread only. */
+    struct Slot
+    {
+        int64 label = 0;            // 0 when the slot is free
+        bool fading = false;        // The partial ramps to silence, freed by the next frame
+        Track target;
+        Loris::RealtimeOscillator oscillator;
+    };
+
+    void run() override;
+
+    /** Analyse the frame the window ends with and queue its loudest partials. Called from the
+        thread. */
+    void analyseFrame();
+
+    /** Ramp the oscillators to the partials of a frame. Called from the audio thread. */
+    void applyFrame(const Frame &frame) noexcept;
+
+    /** Pop frames older than index, and a frame of index into frame if it is there. Called from
+        the audio thread. */
+    bool popFrame(int64 index, Frame &frame) noexcept;
+
+    // analysis, the thread only (and prepare() while it is stopped)
+    std::unique_ptr<Loris::Analyzer::LiveAnalysis> analysis;
+    std::vector<double> window;                             // Samples of the frame being filled
+    int windowFilled = 0;                                   // New samples in it since the last frame
+    int threadGeneration = -1;                              // Generation of the chunks analysed
+    int64 threadFrame = 0;                                  // Index of the next frame analysed
+    std::vector<Loris::Analyzer::LiveAnalysis::Track> tracks; // Tracks of a frame, reused
+    Frame analysed;                                         // Frame being queued
+
+    // configuration published by prepare()
+    Atomic<int> configuration;      // Incremented by prepare(), the audio thread starts over
+    Atomic<int> hopSamples;
+    Atomic<int> leadSamples;        // From the end of the window of a frame to reaching it
+    Atomic<int> latency;
+    double sampleRate = 0;          // The thread only
+
+    // playback, the audio thread only
+    int audioConfiguration = 0;     // Configuration the audio thread plays
+    int generation = 0;             // Incremented by reset()
+    int hop = 0;
+    int lead = 0;
+    int64 position = 0;             // Samples rendered since reset()
+    int64 appliedFrame = -1;        // Index of the frame the oscillators ramp to
+    double rate = 44100;            // Sample rate of the frame the oscillators ramp to
+    bool nonRealtime = false;
+    Frame popped;                   // Frame being applied
+    Slot slots[kMaxPartials];
+
+    moodycamel::ReaderWriterQueue<Chunk> chunks { kQueuedChunks };  // Audio thread to the thread
+    moodycamel::ReaderWriterQueue<Frame> frames { kQueuedFrames };  // The thread to the audio thread
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LiveResynthesiser)
+};
+
+#endif  // LIVE_RESYNTHESISER_H_INCLUDED
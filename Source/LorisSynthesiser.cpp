@@ -27,15 +27,83 @@
 //==============================================================================
 /** Create new instance.
     @param tailTimeSec lenght of tail of the sound
+    @param fadeOutTimeSec lenght of fade out of notes stopped at once (stolen voices)
  */
-LorisVoice::LorisVoice(double tailTimeSec) :  tailTimeSec(tailTimeSec), synth(buffer)
+LorisVoice::LorisVoice(double tailTimeSec, double fadeOutTimeSec) :  tailTimeSec(tailTimeSec), fadeOutTimeSec(fadeOutTimeSec)
 {
+    // the first zone always has a synthesiser, so idle voice has one
+    synths[0] = new Loris::RealTimeSynthesizer(buffer);
+    synth = synths[0];
+    zone = 0;
+    noteCache = nullptr;
+    cachedNote = nullptr;
+    cachedPosition = 0;
+    bankStreamer = nullptr;
+    streamSlot = -1;
+    envelopes = nullptr;
+    nextChordVoice = nullptr;
+    fadingSynth = nullptr;
+    fadingSynthZone = 0;
+    bankFadeSamples = 0;
+    bankFadeLeft = 0;
+    bankCrossfadeTime = 0.;
+    for (const Loris::PartialGains *&gains : partialGains)
+        gains = nullptr;
+    spectralSurface = nullptr;
+    surfaceEffect = 0.;
+    surfaceTimeStretch = 1.;
+    surfaceFrequencyStretch = 1.;
+    
     synthesise = false;
     tailOff = false;
+    level = 0.;
+    pitch = 0.;
+    
+    pitchWheel = 0.;
+    modulationWheel = 0;
+    morphController = 0;
+    aftertouch = 0;
+    timbre = 0;
+    vibratoPhase = 0.;
+    vibratoRate = 5.;
+    vibratoDepth = 0.5;
+    maximumBlockSize = kDefaultMaximumBlockSize;
+    oscillatorKernel = (int) Loris::RealtimeOscillatorBank::CosineKernel;
+    playbackSpeed.setValue(1.);
+    startPosition = 0.;
+    noiseLevel = 0.;
+    harmonicRendering = false;
+    multiRate = true;
     
     tailSamples = tailTimeSec * getSampleRate();
+    morphAmount.setRampLength(roundToInt(kSmoothingTimeMs * 0.001 * getSampleRate()));
+    playbackSpeed.setRampLength(roundToInt(kSmoothingTimeMs * 0.001 * getSampleRate()));
+    
+    eventOffset = 0;
+    tailOffDelay = 0;
+    writtenChannels = 0;
+    playingPartials = 0;
+    culledPartials = 0;
     
-    buffer.reserve(kDefaultSynthesiserBufferSize);
+    fadingOut = false;
+    fadeOutDelay = 0;
+    fadeOutSamplesLeft = 0;
+    fadeOutSamples = fadeOutTimeSec * getSampleRate();
+    nextNote = false;
+    nextNoteNumber = 0;
+    nextNoteVelocity = 0.f;
+    nextNoteZone = 0;
+    nextNoteReleased = false;
+}
+
+LorisVoice::~LorisVoice()
+{
+    for (int i = 0; i < kMaxZones; i++)
+    {
+        delete pendingSynths[i].exchange(nullptr);
+        delete retiredSynths[i].exchange(nullptr);
+    }
+    delete fadingSynth;
 }
 
 //==============================================================================
@@ -46,16 +114,78 @@ bool LorisVoice::canPlaySound(SynthesiserSound* sound) noexcept
 
 //==============================================================================
 void LorisVoice::startNote(int midiNoteNumber, float velocity,
-               SynthesiserSound* /*sound*/, int /*currentPitchWheelPosition*/) noexcept
+               SynthesiserSound* sound, int currentPitchWheelPosition) noexcept
 {
     // This will be called during the rendering callback, so must be fast and thread-safe.
-    const ScopedLock sl(lock);
+    
+    // wheel moved while the voice was idle is not told to it
+    pitchWheelMoved(currentPitchWheelPosition);
+    aftertouch = 0;
+    
+    // synthesiser of the zone is picked when the note begins, a note fading out keeps its one
+    const LorisSound *lorisSound = dynamic_cast<const LorisSound *>(sound);
+    const int noteZone = lorisSound != nullptr ? lorisSound->getZone() : 0;
+    
+    if (fadingOut)
+    {
+        // stolen voice fades out its previous note first, the new one starts right after it
+        nextNote = true;
+        nextNoteNumber = midiNoteNumber;
+        nextNoteVelocity = velocity;
+        nextNoteZone = noteZone;
+        nextNoteReleased = false;
+        return;
+    }
+    
+    beginNote(midiNoteNumber, velocity, noteZone, eventOffset);
+}
+
+//==============================================================================
+/** Start synthesising a note from the start position of the partials.
+    @param noteZone zone of the sound of the note
+    @param startOffset number of samples of the next block before the note starts
+ */
+void LorisVoice::beginNote(int midiNoteNumber, float velocity, int noteZone, int startOffset) noexcept
+{
+    endBankCrossfade();
+    releaseCachedNote();
+    zone = jlimit(0, kMaxZones - 1, noteZone);
+    updateSynth();
+    if (synths[zone] == nullptr)
+    {
+        // zone is not set up yet, nothing to play
+        zone = 0;
+        synth = synths[0];
+        clearCurrentNote();
+        return;
+    }
+    synth = synths[zone];
     
     level = velocity;
     tailOff = false;
+    pitch = MidiMessage::getMidiNoteInHertz (midiNoteNumber);
+    vibratoPhase = 0.;
     
-    synth.reset();
-    synth.setPitch(MidiMessage::getMidiNoteInHertz (midiNoteNumber));
+    // note starts at the morph and speed the voice is ramping to
+    morphAmount.setValue(morphAmount.getTargetValue());
+    playbackSpeed.setValue(playbackSpeed.getTargetValue());
+    synth->setMorphAmount(morphAmount.getValue());
+    synth->setPlaybackRate(playbackSpeed.getValue());
+    
+    synth->reset(startOffset, startPosition * synth->duration());
+    synth->setModifiers(modifiers);
+    synth->setPitch(getModulatedPitch());
+    synth->setBrightness(getExpression(ExpressionMatrix::kBrightness));
+    synth->setLooping(true);
+    
+    // a note without modulation plays its rendered samples, if it is rendered already (they
+    // are rendered at the rate of the bank)
+    if (noteCache != nullptr && noteCache->isEnabled() && startPosition == 0. && ! synth->hasLoop() && isUnmodulated()
+        && synth->partialBank() != nullptr && synth->partialBank()->sampleRate() == getSampleRate())
+    {
+        cachedNote = noteCache->acquire(zone, midiNoteNumber, synth->partialBank());
+        cachedPosition = -startOffset;
+    }
     
     synthesise = true;
 }
@@ -65,95 +195,526 @@ void LorisVoice::stopNote(float /*velocity*/, bool allowTailOff) noexcept
 {
     // This will be called during the rendering callback, so must be fast and thread-safe.
     
+    if (fadingOut)
+    {
+        // the note being faded out is cleared already, only the one waiting for it can stop
+        if (nextNote && allowTailOff)
+            nextNoteReleased = true;
+        else if (nextNote)
+        {
+            nextNote = false;
+            clearCurrentNote();
+        }
+        return;
+    }
+    
     if (allowTailOff)
     {
         // start a tail-off by setting this flag. The render callback will pick up on
         // this and do a fade out, calling clearCurrentNote() when it's finished.
         if (tailOff == false)
+        {
             tailOff = true;
+            tailOffDelay = eventOffset;
+            
+            // released note leaves the sustain loop and plays the rest of the partials
+            synth->setLooping(false);
+        }
+    }
+    else if (synthesise && fadeOutSamples > 0)
+    {
+        // we're being told to stop playing immediately (stolen voice or all notes off), the
+        // voice is free at once but fades out for a few milliseconds, cutting it would click
+        fadingOut = true;
+        fadeOutDelay = eventOffset;
+        fadeOutSamplesLeft = fadeOutSamples;
+        tailOff = false;
+        clearCurrentNote();
     }
     else
     {
-        // we're being told to stop playing immediately, so reset everything..
+        // nothing is sounding, so reset everything..
         stop();
     }
 }
 
 //==============================================================================
-void LorisVoice::pitchWheelMoved(int /*newValue*/) noexcept
+void LorisVoice::pitchWheelMoved(int newValue) noexcept
 {
     // This will be called during the rendering callback, so must be fast and thread-safe.
-    
+    // Partials follow the new pitch from the next block, see renderNextBlock().
+    pitchWheel = (newValue - 8192) / 8192.;
 }
 
 //==============================================================================
-void LorisVoice::controllerMoved(int /*controllerNumber*/, int /*newValue*/) noexcept
+void LorisVoice::controllerMoved(int controllerNumber, int newValue) noexcept
 {
     // This will be called during the rendering callback, so must be fast and thread-safe.
-    
+    if (controllerNumber == kModulationWheelController)
+        modulationWheel = newValue;
+    else if (controllerNumber == kMorphController)
+    {
+        morphController = newValue;
+        morphAmount.setTarget(newValue / 127.);
+    }
+    else if (controllerNumber == kTimbreController)
+        timbre = newValue;
 }
 
 //==============================================================================
-void LorisVoice::aftertouchChanged(int /*newAftertouchValue*/) noexcept
+void LorisVoice::aftertouchChanged(int newAftertouchValue) noexcept
 {
     // This will be called during the rendering callback, so must be fast and thread-safe.
-    
+    aftertouch = newAftertouchValue;
+}
+
+//==============================================================================
+/** Return pitch of current note with pitch bend and vibrato at the next sample, in Hz. */
+double LorisVoice::getModulatedPitch() const noexcept
+{
+    double semitones = getExpression(ExpressionMatrix::kPitch);
+    const int modulation = jmax(modulationWheel, aftertouch);
+    if (modulation > 0)
+        semitones += vibratoDepth * modulation / 127. * std::sin(vibratoPhase);
+    return semitones == 0. ? pitch : pitch * std::pow(2., semitones / 12.);
+}
+
+//==============================================================================
+/** Return a destination of the expression for the controllers of the note. */
+double LorisVoice::getExpression(ExpressionMatrix::Destination destination) const noexcept
+{
+    const double sources[ExpressionMatrix::kNumSources] = { pitchWheel, aftertouch / 127., timbre / 127. };
+    return expression.evaluate(destination, sources);
 }
 
 //==============================================================================
-/** Setup voice to imitate sound with given partials. */
+/** Render the next block of the voice and of the voices joining it, see joinChord(). */
 void LorisVoice::renderNextBlock(AudioSampleBuffer& outputBuffer, int startSample, int numSamples) noexcept
 {
-    if (!synthesise) return;
-    
-    const ScopedLock sl(lock);
-    
-    synth.synthesizeNext(numSamples);
+    for (LorisVoice *voice = this; voice != nullptr;)
+    {
+        voice->renderNote(outputBuffer, startSample, numSamples);
+        
+        LorisVoice *next = voice->nextChordVoice;
+        voice->nextChordVoice = nullptr;
+        voice->envelopes = nullptr;
+        voice = next;
+    }
+}
+
+//==============================================================================
+/** Return true if the voice can share the breakpoints a voice rendering before it evaluates. */
+bool LorisVoice::canShareEnvelopes(const LorisVoice &leader) const noexcept
+{
+    // the synthesisers tell apart the ones whose speed, morph or modifiers differ
+    return synthesise && leader.synthesise && ! fadingOut && ! leader.fadingOut
+           && cachedNote == nullptr && leader.cachedNote == nullptr
+           && synth->partialBank() != nullptr && synth->partialBank() == leader.synth->partialBank()
+           && synth->renderedSamples() == leader.synth->renderedSamples();
+}
+
+//==============================================================================
+/** Render the next block right after another voice, with the breakpoints it evaluated. */
+void LorisVoice::joinChord(LorisVoice *leader) noexcept
+{
+    nextChordVoice = nullptr;
+    if (leader == nullptr)
+    {
+        envelopes = &envelopeFrame;
+        return;
+    }
     
-    double tailDiff = 0.;
+    envelopes = leader->envelopes;
+    nextChordVoice = leader->nextChordVoice;
+    leader->nextChordVoice = this;
+}
+
+//==============================================================================
+/** Render the next block of the voice alone. */
+void LorisVoice::renderNote(AudioSampleBuffer& outputBuffer, int startSample, int numSamples) noexcept
+{
+    writtenChannels = 0;
+    playingPartials = 0;
+    culledPartials = 0;
     
-    if (tailOff)
+    if (!synthesise)
     {
-        tailDiff = level * (double) numSamples / (double) tailSamples;// change level due to tail position
-        if (level < tailDiff) // prevent negative gain
-            tailDiff = level;
+        // sounding note keeps its synthesiser, new one is used from the next note
+        updateSynth();
+        return;
     }
-
-    outputBuffer.addFromWithRamp(0, startSample, buffer.data(), numSamples, level, level - tailDiff);
     
-    if (tailOff)
+    // synthesise straight into the output (level ramp folded into amplitudes), partials
+    // go to their channel of a channel bus (see LorisSynthesiser::mixChannels()), other
+    // outputs get all partials in the first channel
+    synth->setMaxPartials(maxPartials.get());
+    synth->setOscillatorKernel((Loris::RealtimeOscillatorBank::Kernel) oscillatorKernel.get());
+    synth->setHarmonicRendering(harmonicRendering);
+    synth->setMultiRate(multiRate);
+    const bool channelBus = outputBuffer.getNumChannels() >= Loris::PartialStruct::NumChannels;
+    float *outputs[Loris::PartialStruct::NumChannels];
+    for (int c = 0; c < Loris::PartialStruct::NumChannels; c++)
+        outputs[c] = outputBuffer.getWritePointer(channelBus ? c : 0, startSample);
+    
+    // blocks longer than the estimate of the host are synthesised in sub-blocks
+    while (numSamples > 0 && synthesise)
     {
-        level -= tailDiff;
-
-        if (level <= 0.005) // this number is from Juce synthesiser tutorial.
+        if (cachedNote != nullptr && ! isUnmodulated())
+            synthesiseCachedNote();
+        
+        // held note moves to the bank set up since it started, if it crossfades
+        beginBankCrossfade();
+        
+        int blockSize = jmin(numSamples, maximumBlockSize);
+        if (fadingSynth != nullptr)
+            blockSize = jmin(blockSize, bankFadeLeft);
+        double tailDiff = 0.;
+        
+        if (fadingOut && fadeOutDelay > 0)
+        {
+            // note sounds until the event which stopped it
+            blockSize = jmin(blockSize, fadeOutDelay);
+            fadeOutDelay -= blockSize;
+        }
+        else if (tailOff && tailOffDelay > 0)
+        {
+            blockSize = jmin(blockSize, tailOffDelay);
+            tailOffDelay -= blockSize;
+        }
+        else if (fadingOut)
+        {
+            // fade out ends exactly where the next note starts
+            blockSize = jmin(blockSize, fadeOutSamplesLeft);
+            tailDiff = level * (double) blockSize / (double) fadeOutSamplesLeft;
+            fadeOutSamplesLeft -= blockSize;
+        }
+        else if (tailOff)
+        {
+            tailDiff = level * (double) blockSize / (double) tailSamples;// change level due to tail position
+            if (level < tailDiff) // prevent negative gain
+                tailDiff = level;
+        }
+        
+        // bend and vibrato glide inside the synthesiser, the pitch at the end of the
+        // block is reached by all partials without touching the shared bank
+        if ((modulationWheel > 0 || aftertouch > 0) && getSampleRate() > 0)
+            vibratoPhase = std::fmod(vibratoPhase + 2. * double_Pi * vibratoRate * blockSize / getSampleRate(), 2. * double_Pi);
+        const double modulatedPitch = getModulatedPitch();
+        
+        // expression is evaluated once per block, brightness and noise ramp over it
+        const double brightness = getExpression(ExpressionMatrix::kBrightness);
+        const double blockNoiseLevel = jmax(0., noiseLevel + getExpression(ExpressionMatrix::kNoise));
+        
+        // morph ramps inside the synthesiser, speed is stepped at every block of the ramp
+        const bool morphRamping = morphAmount.isRamping();
+        const double morph = morphRamping ? morphAmount.advance(blockSize) : 0.;
+        const bool speedRamping = playbackSpeed.isRamping();
+        const double speed = speedRamping ? playbackSpeed.advance(blockSize) : 0.;
+        
+        // synthesiser of the old bank is modulated the same way while it fades out
+        for (Loris::RealTimeSynthesizer *s : { synth, fadingSynth })
+        {
+            if (s == nullptr)
+                continue;
+            s->setModifiers(modifiers);
+            s->glidePitch(modulatedPitch);
+            s->glideBrightness(brightness);
+            s->setPartialFilter(&partialFilter);
+            s->setPartialGains(partialGains[s == fadingSynth ? fadingSynthZone : zone]);
+            s->setSpectralSurface(spectralSurface);
+            s->setSurfaceEffect(surfaceEffect);
+            s->setSurfaceStretch(surfaceTimeStretch, surfaceFrequencyStretch);
+            if (morphRamping)
+                s->glideMorphAmount(morph);
+            if (speedRamping)
+                s->setPlaybackRate(speed);
+            s->setNoiseLevel(blockNoiseLevel);
+        }
+        
+        if (cachedNote != nullptr)
+            renderCachedNote(outputs, blockSize, level, level - tailDiff, channelBus);
+        else
+        {
+            double gain = level;
+            double targetGain = level - tailDiff;
+            if (fadingSynth != nullptr)
+            {
+                // old bank fades out as the new one fades in
+                const double fadeStart = 1. - (double) bankFadeLeft / bankFadeSamples;
+                bankFadeLeft -= blockSize;
+                const double fadeEnd = 1. - (double) bankFadeLeft / bankFadeSamples;
+                fadingSynth->setEnvelopeFrame(nullptr);
+                fadingSynth->synthesizeNext(outputs, blockSize, gain * (1. - fadeStart), targetGain * (1. - fadeEnd));
+                if (fadingSynth->writtenChannels() != 0)
+                    writtenChannels |= channelBus ? fadingSynth->writtenChannels() : 1;
+                gain *= fadeStart;
+                targetGain *= fadeEnd;
+                if (bankFadeLeft <= 0)
+                    endBankCrossfade();
+            }
+            
+            synth->setEnvelopeFrame(envelopes);
+            synth->synthesizeNext(outputs, blockSize, gain, targetGain);
+            if (synth->writtenChannels() != 0)
+                writtenChannels |= channelBus ? synth->writtenChannels() : 1;
+            playingPartials = jmax(playingPartials, synth->numPlayingPartials());
+            culledPartials += synth->culledPartials();
+        }
+        
+        if (fadingOut)
+        {
+            level -= tailDiff;
+            
+            if (fadeOutDelay <= 0 && fadeOutSamplesLeft <= 0)
+                endFadeOut();
+        }
+        else if (tailOff)
+        {
+            level -= tailDiff;
+            
+            if (level <= 0.005) // this number is from Juce synthesiser tutorial.
+                stop();
+        }
+        
+        // one-shot whose partials have all ended frees the voice at once, fading
+        // out voices end with the fade (the next note starts there)
+        const bool finished = cachedNote != nullptr ? cachedPosition >= cachedNote->numSamples : synth->isFinished();
+        if (synthesise && !fadingOut && finished)
             stop();
+        
+        for (float *&output : outputs)
+            output += blockSize;
+        numSamples -= blockSize;
     }
+    
+    // breakpoints ahead of the note are read from disk in background
+    if (bankStreamer != nullptr)
+        bankStreamer->setVoicePosition(streamSlot, synthesise ? zone : -1, synth->bankSample());
 }
 
 //==============================================================================
 /** Stop current note. */
 void LorisVoice::stop() noexcept
 {
+    endBankCrossfade();
+    releaseCachedNote();
+    if (bankStreamer != nullptr)
+        bankStreamer->setVoicePosition(streamSlot, -1, 0);
     synthesise = false;
     tailOff = false;
     clearCurrentNote();
 }
 
 //==============================================================================
-void LorisVoice::setup(Loris::PartialList &partials, double pitch) noexcept
+/** Finish fade out of a stopped note, start the note waiting for it if there is one. */
+void LorisVoice::endFadeOut() noexcept
 {
-    const ScopedLock sl(lock);
-    synth.setup(partials, pitch);
+    fadingOut = false;
+    
+    if (nextNote)
+    {
+        nextNote = false;
+        beginNote(nextNoteNumber, nextNoteVelocity, nextNoteZone, 0);
+        tailOff = nextNoteReleased;
+        synth->setLooping(! nextNoteReleased);
+    }
+    else
+    {
+        // note was cleared when the fade out started
+        endBankCrossfade();
+        releaseCachedNote();
+        synthesise = false;
+        tailOff = false;
+    }
 }
 
 //==============================================================================
-void LorisVoice::setCurrentPlaybackSampleRate(double rate) noexcept
+/** Return how much stealing the voice would be heard. */
+double LorisVoice::getStealCost() const noexcept
 {
-    const ScopedLock sl(lock);
+    if (getCurrentlyPlayingNote() < 0)
+        return 0.;
     
+    // quieter voices and voices closer to the end of their partials first,
+    // voices in tail-off before all held ones
+    const double progress = cachedNote != nullptr ? jlimit(0., 1., (double) cachedPosition / cachedNote->numSamples)
+                                                  : synth->progress();
+    const double cost = level * (1. - progress);
+    return tailOff ? cost : 1. + cost;
+}
+
+//==============================================================================
+void LorisVoice::setup(int zone, const Loris::RealTimeSynthesizer &prepared)
+{
+    jassert(zone >= 0 && zone < kMaxZones);
+    
+    // all allocation is done here, off the audio thread, the rest is shared with prepared
+    Loris::RealTimeSynthesizer *newSynth = new Loris::RealTimeSynthesizer(buffer);
+    newSynth->setup(prepared);
+    newSynth->setPitch(prepared.partialBank()->pitch());
+    
+    // free synthesiser replaced at audio thread since last call
+    delete retiredSynths[zone].exchange(nullptr);
+    
+    // publish new one, free previous one if audio thread did not pick it up
+    delete pendingSynths[zone].exchange(newSynth);
+}
+
+//==============================================================================
+/** Pick up synthesiser published by setup(). Called from the audio thread. */
+void LorisVoice::updateSynth() noexcept
+{
+    // wait until setup() deletes the previously retired one, the one fading out is retired next
+    if (retiredSynths[zone].get() != nullptr || (fadingSynth != nullptr && fadingSynthZone == zone))
+        return;
+    
+    Loris::RealTimeSynthesizer *newSynth = pendingSynths[zone].exchange(nullptr);
+    if (newSynth == nullptr)
+        return;
+    
+    retiredSynths[zone] = synths[zone].release();
+    synths[zone] = newSynth;
+    synth = newSynth;
+    
+    if (synthesise)
+    {
+        synth->setModifiers(modifiers);
+        synth->setPitch(getModulatedPitch());
+        synth->setBrightness(getExpression(ExpressionMatrix::kBrightness));
+    }
+}
+
+//==============================================================================
+/** Move a held note to the synthesiser published by setup() since it started. */
+void LorisVoice::beginBankCrossfade() noexcept
+{
+    if (bankCrossfadeTime <= 0. || getSampleRate() <= 0 || fadingSynth != nullptr || tailOff || fadingOut
+        || cachedNote != nullptr || retiredSynths[zone].get() != nullptr)
+        return;
+    
+    Loris::RealTimeSynthesizer *newSynth = pendingSynths[zone].exchange(nullptr);
+    if (newSynth == nullptr)
+        return;
+    
+    // partials of the new bank enter where the note is, from the checkpoints of the bank
+    const Loris::PartialBank *bank = synth->partialBank();
+    if (synth->renderedSamples() < 0 || bank == nullptr || bank->sampleRate() <= 0)
+        newSynth->reset(jmax(0, -synth->renderedSamples()));
+    else
+        newSynth->reset(0, synth->bankSample() / bank->sampleRate());
+    newSynth->setMorphAmount(morphAmount.getValue());
+    newSynth->setPlaybackRate(playbackSpeed.getValue());
+    newSynth->setModifiers(modifiers);
+    newSynth->setPitch(getModulatedPitch());
+    newSynth->setBrightness(getExpression(ExpressionMatrix::kBrightness));
+    newSynth->setLooping(true);
+    
+    fadingSynth = synths[zone].release();
+    fadingSynthZone = zone;
+    synths[zone] = newSynth;
+    synth = newSynth;
+    bankFadeSamples = bankFadeLeft = jmax(1, roundToInt(bankCrossfadeTime * getSampleRate()));
+}
+
+//==============================================================================
+/** Retire the synthesiser of the old bank, the crossfade is over or the note stopped. */
+void LorisVoice::endBankCrossfade() noexcept
+{
+    if (fadingSynth == nullptr)
+        return;
+    
+    // updateSynth() does not retire into the slot of its zone while it fades out, so it is
+    // free, setup() deletes it
+    retiredSynths[fadingSynthZone] = fadingSynth;
+    fadingSynth = nullptr;
+    bankFadeLeft = 0;
+}
+
+//==============================================================================
+/** Return true if the note sounds the same as its rendered note. */
+bool LorisVoice::isUnmodulated() const noexcept
+{
+    return pitchWheel == 0. && modulationWheel == 0 && aftertouch == 0
+        && (timbre == 0 || expression.movesNothing(ExpressionMatrix::kTimbre))
+        && morphAmount.getTargetValue() == 0. && ! morphAmount.isRamping()
+        && playbackSpeed.getTargetValue() == 1. && ! playbackSpeed.isRamping()
+        && (noiseLevel == 0. || synth == nullptr || ! synth->noiseBands())
+        && modifiers.isIdentity() && partialFilter.isFlat()
+        && (partialGains[zone] == nullptr || partialGains[zone]->isIdentity())
+        && (spectralSurface == nullptr || surfaceEffect == 0.);
+}
+
+//==============================================================================
+/** Add samples of the rendered note to outputs. */
+void LorisVoice::renderCachedNote(float * const *outputs, int numSamples, double gain, double targetGain,
+                                  bool channelBus) noexcept
+{
+    // the note starts at its event, the gain ramps over the whole block as in the synthesiser
+    const int offset = jlimit(0, numSamples, -cachedPosition);
+    const int start = cachedPosition + offset;
+    const int count = jmin(numSamples - offset, cachedNote->numSamples - start);
+    const double step = (targetGain - gain) / numSamples;
+    
+    if (count > 0)
+    {
+        for (int c = 0; c < Loris::PartialStruct::NumChannels; c++)
+        {
+            if ((cachedNote->channels & (1 << c)) == 0)
+                continue;
+            
+            const float *in = cachedNote->samples[c].data() + start;
+            float *out = outputs[c] + offset;
+            const double first = gain + step * offset;
+            for (int k = 0; k < count; k++)
+                out[k] += in[k] * (float) (first + step * k);
+        }
+        writtenChannels |= channelBus ? cachedNote->channels : 1;
+    }
+    
+    cachedPosition += numSamples;
+}
+
+//==============================================================================
+/** Synthesise the rest of the rendered note. */
+void LorisVoice::synthesiseCachedNote() noexcept
+{
+    // partials enter at the time reached with their state from the checkpoints
+    if (cachedPosition > 0 && getSampleRate() > 0)
+        synth->reset(0, cachedPosition / getSampleRate());
+    else
+        synth->reset(-cachedPosition);
+    synth->setModifiers(modifiers);
+    synth->setPitch(getModulatedPitch());
+    synth->setBrightness(getExpression(ExpressionMatrix::kBrightness));
+    synth->setMorphAmount(morphAmount.getValue());
+    synth->setPlaybackRate(playbackSpeed.getValue());
+    synth->setLooping(! tailOff);
+    
+    releaseCachedNote();
+}
+
+//==============================================================================
+/** Stop playing the rendered note. */
+void LorisVoice::releaseCachedNote() noexcept
+{
+    if (cachedNote != nullptr)
+    {
+        noteCache->release(cachedNote);
+        cachedNote = nullptr;
+    }
+}
+
+//==============================================================================
+void LorisVoice::setCurrentPlaybackSampleRate(double rate) noexcept
+{
     SynthesiserVoice::setCurrentPlaybackSampleRate(rate);
     
-    synth.setSampleRate(getSampleRate());
+    for (int i = 0; i < kMaxZones; i++)
+        if (synths[i] != nullptr)
+            synths[i]->setSampleRate(getSampleRate());
     
     tailSamples = tailTimeSec * getSampleRate();
+    fadeOutSamples = fadeOutTimeSec * getSampleRate();
+    morphAmount.setRampLength(roundToInt(kSmoothingTimeMs * 0.001 * getSampleRate()));
+    playbackSpeed.setRampLength(roundToInt(kSmoothingTimeMs * 0.001 * getSampleRate()));
 }
\ No newline at end of file
@@ -26,21 +26,157 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 
+#include "AnalysisCache.h"
+#include "BankStreamer.h"
+#include "NoteRenderCache.h"
+#include "PartialsCodec.h"
+#include "VoiceRenderPool.h"
 #include "Synthesizer.h"
 #include "RealTimeSynthesizer.h"
+#include "PartialBank.h"
+#include "PartialGains.h"
+#include "SpectralSurface.h"
+#include "LorisTrace.h"
+#include "Pruner.h"
+#include "Simplifier.h"
 #include "Resampler.h"
 
+#include <map>
+
 using namespace juce;
 
 //==============================================================================
-/** Describes the sounds that LorisSynthesiser can play. */
+/** Describes the sounds that LorisSynthesiser can play: a key zone, the sample played by a
+    range of keys. Zones do not overlap, every note is played by one of them. Sounds are not
+    changed once they are added to the synthesiser, they are replaced. */
 class LorisSound : public SynthesiserSound
 {
 public:
-    LorisSound() {}
+    /** Create sound of the first zone playing all notes. */
+    LorisSound() : zone(0) { notes.setRange(0, 128, true); }
+    
+    /** Create sound of zone playing given notes (bits of MIDI note numbers). */
+    LorisSound(int zone, const BigInteger &notes) : zone(zone), notes(notes) {}
     
-    bool appliesToNote(const int /*midiNoteNumber*/)  noexcept override { return true; }
+    bool appliesToNote(const int midiNoteNumber)  noexcept override { return notes[midiNoteNumber]; }
     bool appliesToChannel(const int /*midiChannel*/)  noexcept override { return true; }
+    
+    /** Return index of the zone in LorisSynthesiser, voices pick its synthesiser by it. */
+    int getZone() const noexcept { return zone; }
+    
+private:
+    const int zone;
+    BigInteger notes;
+};
+
+//==============================================================================
+/**
+   Linear ramp of a parameter to the value set last, over a fixed number of samples. It is
+   advanced once per block and gives the value at the block's end, the synthesiser ramps to it
+   sample by sample (see Loris::RealTimeSynthesizer::glideMorphAmount()), so nothing is
+   computed per sample here. A value set while ramping ramps from where the ramp is.
+ */
+class LinearSmoother
+{
+public:
+    explicit LinearSmoother(double value = 0.) noexcept : current(value), target(value) {}
+    
+    /** Set length of ramps, at least a sample. */
+    void setRampLength(int samples) noexcept { rampSamples = jmax(1, samples); }
+    
+    /** Jump to a value, ramp going on is dropped. */
+    void setValue(double value) noexcept
+    {
+        current = target = value;
+        samplesLeft = 0;
+    }
+    
+    /** Ramp to a value, from the current one. */
+    void setTarget(double value) noexcept
+    {
+        if (value == target)
+            return;
+        target = value;
+        samplesLeft = rampSamples;
+        step = (target - current) / samplesLeft;
+    }
+    
+    /** Return value at the beginning of the next block. */
+    double getValue() const noexcept { return current; }
+    
+    /** Return value set last, the ramp ends at it. */
+    double getTargetValue() const noexcept { return target; }
+    
+    bool isRamping() const noexcept { return samplesLeft > 0; }
+    
+    /** Move by a block, return value at its end. */
+    double advance(int samples) noexcept
+    {
+        if (samples >= samplesLeft)
+        {
+            current = target;
+            samplesLeft = 0;
+        }
+        else
+        {
+            current += step * samples;
+            samplesLeft -= samples;
+        }
+        return current;
+    }
+    
+private:
+    double current;
+    double target;
+    double step = 0.;
+    int samplesLeft = 0;
+    int rampSamples = 1;
+};
+
+//==============================================================================
+/**
+   Routing of per-note expression to the synthesis of a voice: every source moves every
+   destination by an amount. With MPE every note has a MIDI channel of its own, so the pitch
+   wheel, channel pressure and timbre (controller 74) of the channel are per note; polyphonic
+   aftertouch is pressure per note too. The matrix is evaluated once per block by every voice,
+   the synthesiser ramps to its outputs over the block, nothing is added per sample.
+ */
+struct ExpressionMatrix
+{
+    enum Source
+    {
+        kPitchWheel,    // -1 - 1
+        kPressure,      // 0 - 1, aftertouch
+        kTimbre,        // 0 - 1, LorisVoice::kTimbreController
+        kNumSources
+    };
+    
+    enum Destination
+    {
+        kPitch,         // semitones
+        kBrightness,    // dB per octave, see Loris::RealTimeSynthesizer::setBrightness()
+        kNoise,         // added to the noise level of the voice
+        kNumDestinations
+    };
+    
+    ExpressionMatrix() noexcept { amounts[kPitchWheel][kPitch] = 2.; }
+    
+    /** Return the value of a destination for the sources. */
+    double evaluate(Destination destination, const double (&sources)[kNumSources]) const noexcept
+    {
+        double value = 0.;
+        for (int s = 0; s < kNumSources; s++)
+            value += amounts[s][destination] * sources[s];
+        return value;
+    }
+    
+    /** Return true if a source moves no destination. */
+    bool movesNothing(Source source) const noexcept
+    {
+        return amounts[source][kPitch] == 0. && amounts[source][kBrightness] == 0. && amounts[source][kNoise] == 0.;
+    }
+    
+    double amounts[kNumSources][kNumDestinations] = {}; // Destination at full source.
 };
 
 //==============================================================================
@@ -50,49 +186,341 @@ public:
  */
 class LorisVoice : public SynthesiserVoice
 {
-    enum BufferSize { kDefaultSynthesiserBufferSize = 8192 };
+    enum Smoothing { kSmoothingTimeMs = 20 };   // Ramp of morph and playback speed changes.
     
 public:
+    enum BlockSize { kDefaultMaximumBlockSize = 8192 }; // Sub-blocks when no size is set.
+    enum Zones { kMaxZones = 16 };              // Key zones of LorisSynthesiser a voice can play.
+    
+    /** MIDI controllers the voice follows. */
+    enum Controllers
+    {
+        kModulationWheelController = 1, // depth of vibrato
+        kMorphController = 2,           // breath controller, morph to the morph target of the bank
+        kTimbreController = 74          // MPE timbre (slide), see ExpressionMatrix
+    };
+    
     /** Create new instance.
        @param tailTimeSec lenght of tail of the sound
+       @param fadeOutTimeSec lenght of fade out of notes stopped at once (stolen voices)
      */
-    LorisVoice(double tailTimeSec = 0.01);
+    LorisVoice(double tailTimeSec = 0.01, double fadeOutTimeSec = 0.003);
+    
+    ~LorisVoice();
     
     bool canPlaySound(SynthesiserSound* sound) noexcept override;
     
     void startNote(int midiNoteNumber, float velocity,
-                   SynthesiserSound* /*sound*/, int /*currentPitchWheelPosition*/) noexcept override;
+                   SynthesiserSound* /*sound*/, int currentPitchWheelPosition) noexcept override;
     
     void stopNote(float /*velocity*/, bool allowTailOff) noexcept override;
     
-    void pitchWheelMoved(int /*newValue*/)  noexcept override;
-    void controllerMoved(int /*controllerNumber*/, int /*newValue*/) noexcept override;
-    void aftertouchChanged(int /*newAftertouchValue*/)  noexcept override;
+    /** Bend pitch of the note, by the pitch wheel amount of the expression up or down. The
+        pitch glides to it during the next block. */
+    void pitchWheelMoved(int newValue)  noexcept override;
+    
+    /** Modulation wheel (controller 1) sets depth of vibrato, breath controller (controller 2)
+        morphs the partials to the morph target given to setup(), timbre (controller 74) is
+        a source of the expression. */
+    void controllerMoved(int controllerNumber, int newValue) noexcept override;
+    
+    /** Aftertouch sets depth of vibrato too, the deeper one of the two is used, and it is the
+        pressure of the expression. */
+    void aftertouchChanged(int newAftertouchValue)  noexcept override;
     
     void renderNextBlock(AudioSampleBuffer& outputBuffer, int startSample, int numSamples) noexcept override;
     
     void setCurrentPlaybackSampleRate(double rate) noexcept override;
     
-    /** Setup voice to imitate sound with given partials. */
-    void setup(Loris::PartialList &partials, double pitch) noexcept;
+    /** Setup voice to imitate sound of a key zone with given partials. The bank and what
+        was derived from it are shared by all voices, the voice keeps only its playback state.
+     
+        It is safe to call this while the voice is playing. New synthesiser is
+        prepared here and published without locking, the audio thread picks it up
+        when the voice is idle or starts a note, so a sounding note is never
+        switched to other partials. Synthesiser it replaced is deleted
+        here, on the next call, so memory is never freed on the audio thread.
+        Every zone has its own synthesiser, a note of a zone (see LorisSound) just picks it.
+        @param zone index of the zone, less than kMaxZones
+        @param prepared synthesiser set up once for all voices (see
+                        Loris::RealTimeSynthesizer::setup(const RealTimeSynthesizer &)) with
+                        the bank, its morph target and noise bands, and the sustain loop: held
+                        notes go on from the loop start, released ones play the rest of the
+                        partials. The voice does not keep it.
+     */
+    void setup(int zone, const Loris::RealTimeSynthesizer &prepared);
+    
+    /** Set the largest number of partials the voice renders at once, 0 for no limit.
+        Quieter partials fade out when there are more. Safe to call from any thread,
+        the audio thread applies it with the next block.
+     */
+    void setMaxPartials(int count) noexcept { maxPartials = count; }
+    
+    /** Select the way samples of the partials are computed, see
+        Loris::RealTimeSynthesizer::setOscillatorKernel(). Safe to call from any thread, the
+        audio thread applies it with the next block.
+     */
+    void setOscillatorKernel(Loris::RealtimeOscillatorBank::Kernel kernel) noexcept { oscillatorKernel = (int) kernel; }
+    
+    /** Set the largest number of samples synthesised at once, usually the block size
+        estimate of prepareToPlay(). Longer blocks of hosts exceeding their estimate are
+        synthesised in sub-blocks, so partial budget and tail-off are updated as often.
+        Nothing is allocated, the voice synthesises straight into the output.
+     */
+    void setMaximumBlockSize(int samples) noexcept { maximumBlockSize = samples > 0 ? samples : (int) kDefaultMaximumBlockSize; }
+    
+    /** Set speed the partials are played at, without changing their pitch: 2 plays them
+        twice as fast, 0.5 twice as long. Playing notes ramp to it block by block (see
+        kSmoothingTimeMs), nothing is prepared again. LorisSynthesiser calls it with its
+        lock held.
+     */
+    void setPlaybackSpeed(double speed) noexcept { playbackSpeed.setTarget(speed > 0. ? speed : 1.); }
+    
+    /** Set part of the sound notes start at, 0 for its beginning, 1 for its end. Partials
+        playing there enter with their state from the checkpoints of the bank, nothing
+        before it is synthesised. LorisSynthesiser calls it with its lock held.
+     */
+    void setStartPosition(double position) noexcept { startPosition = jlimit(0., 1., position); }
+    
+    /** Set gain of the noise bands of the sound (see setup()) relative to the residual of its
+        analysis, 0 renders none and costs nothing. Playing notes ramp to it over a block.
+        LorisSynthesiser calls it with its lock held.
+     */
+    void setNoiseLevel(double level) noexcept { noiseLevel = jmax(0., level); }
+    
+    /** Set spectral transforms applied to the partials while they are synthesised (see
+        Loris::PartialModifiers), nothing is prepared again. Playing notes take them at the
+        next block. LorisSynthesiser calls it with its lock held.
+     */
+    void setModifiers(const Loris::PartialModifiers &newModifiers) noexcept { modifiers = newModifiers; }
+    
+    /** Set the routing of per-note expression, see ExpressionMatrix. Playing notes take it at
+        the next block. LorisSynthesiser calls it with its lock held.
+     */
+    void setExpression(const ExpressionMatrix &matrix) noexcept { expression = matrix; }
+    
+    /** Set the equalizer of the partials (see Loris::PartialFilter), copied to the voice.
+        Playing notes take it at the next block. LorisSynthesiser calls it with its lock held.
+     */
+    void setPartialFilter(const Loris::PartialFilter &filter) noexcept { partialFilter = filter; }
+    
+    /** Set the gains of single partials of the bank of a zone (see Loris::PartialGains), not
+        copied, they must live while they are set. Playing notes take them at the next block.
+        LorisSynthesiser calls it with its lock held. */
+    void setPartialGains(int zone, const Loris::PartialGains *gains) noexcept { partialGains[zone] = gains; }
+    
+    /** Set the spectral surface the partials are cross-synthesised with (see
+        Loris::RealTimeSynthesizer::setSpectralSurface()), not copied, it must live while it is
+        set. Playing notes take it at the next block. LorisSynthesiser calls it with its lock held. */
+    void setSpectralSurface(const Loris::SpectralSurface *surface) noexcept { spectralSurface = surface; }
+    
+    /** Set the amount of cross-synthesis with the spectral surface, 0 for none, and its stretch
+        in time and frequency. Playing notes take them at the next block. LorisSynthesiser calls
+        it with its lock held. */
+    void setSurfaceEffect(double effect, double timeStretch, double frequencyStretch) noexcept
+    {
+        surfaceEffect = effect;
+        surfaceTimeStretch = timeStretch;
+        surfaceFrequencyStretch = frequencyStretch;
+    }
+    
+    /** Render the partials following the harmonics of the fundamental from its phase, see
+        Loris::RealTimeSynthesizer::setHarmonicRendering(). Playing notes take it at the next
+        block. LorisSynthesiser calls it with its lock held.
+     */
+    void setHarmonicRendering(bool enable) noexcept { harmonicRendering = enable; }
+    
+    /** Compute low partials at a reduced rate, see Loris::RealTimeSynthesizer::setMultiRate().
+        Playing notes take it at the next block. LorisSynthesiser calls it with its lock held.
+     */
+    void setMultiRate(bool enable) noexcept { multiRate = enable; }
+    
+    /** Set how long a held note crossfades to the bank of a setup() done while it plays, 0
+        (default) keeps playing the bank it started with until it ends. The new bank enters at
+        the position of the note from its checkpoints, the old synthesiser is retired (and its
+        bank released, unless other voices play it) when the crossfade ends. Released notes
+        finish on their bank. LorisSynthesiser calls it with its lock held.
+        @param seconds length of the crossfade
+     */
+    void setBankCrossfadeTime(double seconds) noexcept { bankCrossfadeTime = jmax(0., seconds); }
+    
+    /** Return how much stopping the note would be heard, LorisSynthesiser steals the
+        voice with the lowest cost. Voices in tail-off cost less than 1, held ones more,
+        both by level and by the part of their partials not synthesised yet. */
+    double getStealCost() const noexcept;
+    
+    /** Return the channels of the output the last renderNextBlock() added samples to, bit
+        1 << channel for each. The others were not touched, 0 if the voice was silent. */
+    int getWrittenChannels() const noexcept { return writtenChannels; }
+    
+    /** Return the largest number of partials playing in the sub-blocks of the last
+        renderNextBlock(), 0 if the voice was silent. */
+    int getPlayingPartials() const noexcept { return playingPartials; }
+    
+    /** Return the number of partials the last renderNextBlock() skipped because they were
+        above Nyquist at the pitch of the note. */
+    int getCulledPartials() const noexcept { return culledPartials; }
+    
+    /** Set position of the MIDI event being handled in the block rendered next, notes started
+        and stopped by it start and stop there. LorisSynthesiser sets it for every event, it is
+        0 for notes started and stopped out of renderNextBlock().
+     */
+    void setEventOffset(int samples) noexcept { eventOffset = samples; }
+    
+    /** Return true if the note was stopped at once and is fading out. The voice is free,
+        but a note started on it waits for the end of the fade out. */
+    bool isFadingOut() const noexcept { return fadingOut; }
+    
+    /** Set cache of rendered notes the voice plays unmodulated notes from, nullptr for none.
+        Notes without pitch bend, vibrato, morph, speed change or start position, of zones
+        without a sustain loop, are played from it once they are rendered. A note which gets
+        modulated is synthesised from where it is. Do not call it while the voice plays.
+     */
+    void setNoteCache(NoteRenderCache *cache) noexcept { noteCache = cache; }
+    
+    /** Set streamer the voice publishes the sample it plays to, so breakpoints ahead of it are
+        read from disk, nullptr for none. Do not call it while the voice plays.
+        @param streamer streamer of the banks of the voice
+        @param slot slot of the voice, see BankStreamer::addVoice() */
+    void setBankStreamer(BankStreamer *streamer, int slot) noexcept { bankStreamer = streamer; streamSlot = slot; }
+    
+    /** Return slot of the voice in its streamer, -1 for none. */
+    int getStreamSlot() const noexcept { return streamSlot; }
+    
+    /** Return true if the voice can share the breakpoints a voice rendering before it
+        evaluates, see joinChord(): both synthesise the same bank from the same sample. */
+    bool canShareEnvelopes(const LorisVoice &leader) const noexcept;
+    
+    /** Render the next block right after another voice, on its thread, with the breakpoints
+        it evaluated (see Loris::EnvelopeFrame), so notes of a chord struck together walk and
+        convert their breakpoints once and differ only by their pitch. The leader renders
+        the voices joining it from its renderNextBlock(), it holds for one block.
+        @param leader voice rendering before this one, nullptr to render alone */
+    void joinChord(LorisVoice *leader) noexcept;
     
 private:
     
+    /** Return pitch of current note with pitch bend and vibrato at the next sample, in Hz. */
+    double getModulatedPitch() const noexcept;
+    
+    /** Return a destination of the expression for the controllers of the note. */
+    double getExpression(ExpressionMatrix::Destination destination) const noexcept;
+    
+    /** Move a held note to the synthesiser published by setup() since it started, if the
+        voice crossfades to new banks, see setBankCrossfadeTime(). Called from the audio thread. */
+    void beginBankCrossfade() noexcept;
+    
+    /** Retire the synthesiser of the old bank, the crossfade is over or the note stopped. */
+    void endBankCrossfade() noexcept;
+    
+    /** Render the next block of the voice alone, see renderNextBlock(). */
+    void renderNote(AudioSampleBuffer& outputBuffer, int startSample, int numSamples) noexcept;
+    
+    /** Start synthesising a note from the beginning of the partials.
+        @param noteZone zone of the sound of the note
+        @param startOffset number of samples of the next block before the note starts
+     */
+    void beginNote(int midiNoteNumber, float velocity, int noteZone, int startOffset) noexcept;
+    
     /** Stop current note. */
     void stop() noexcept;
     
+    /** Finish fade out of a stopped note, start the note waiting for it if there is one. */
+    void endFadeOut() noexcept;
+    
+    /** Pick up synthesiser of the current zone published by setup(). Called from the audio thread. */
+    void updateSynth() noexcept;
+    
+    /** Return true if the note sounds the same as its rendered note, nothing modulates it. */
+    bool isUnmodulated() const noexcept;
+    
+    /** Add samples of the rendered note to outputs, with gain ramped like the synthesiser does it. */
+    void renderCachedNote(float * const *outputs, int numSamples, double gain, double targetGain,
+                          bool channelBus) noexcept;
+    
+    /** Synthesise the rest of the rendered note, from where it is played. */
+    void synthesiseCachedNote() noexcept;
+    
+    /** Stop playing the rendered note, if there is one. */
+    void releaseCachedNote() noexcept;
+    
     bool synthesise;      // Flag to determine if synthesiser should synthesise
     
     double level;         // Gain of synthesised sound.
     
     double tailOff;       //
+    int tailOffDelay;     // Samples of the next block before tail-off starts.
     int tailSamples;      // Lenght of tail in samples.
     double tailTimeSec;   // Lenght of tail in seconds.
+    
+    int eventOffset;      // Position of the MIDI event being handled, see setEventOffset().
+    
+    bool fadingOut;       // Note stopped at once is fading out.
+    int fadeOutDelay;     // Samples of the next block before fade out starts.
+    int fadeOutSamples;   // Lenght of fade out in samples.
+    double fadeOutTimeSec;// Lenght of fade out in seconds.
+    int fadeOutSamplesLeft;
+    
+    bool nextNote;        // Note started while fading out, it starts when the fade out ends.
+    int nextNoteNumber;
+    float nextNoteVelocity;
+    int nextNoteZone;
+    bool nextNoteReleased;// Next note was released before it started, it tails off at once.
         
-    Loris::RealTimeSynthesizer synth;  // This makes the sound.
-    CriticalSection lock; // For safe processing.
+    double pitch;         // Pitch of current note in Hz.
+    
+    double pitchWheel;    // Pitch wheel, -1 - 1.
+    ExpressionMatrix expression; // Routing of the controllers of the note.
+    Loris::PartialFilter partialFilter; // Equalizer of the partials, set to the synthesisers every block.
+    const Loris::PartialGains *partialGains[kMaxZones]; // Edits of the partials of each zone, or nullptr, set like partialFilter.
+    const Loris::SpectralSurface *spectralSurface; // Cross-synthesised with the partials, or nullptr, set like partialFilter.
+    double surfaceEffect; // Amount of cross-synthesis, 0 - 1,
+    double surfaceTimeStretch; // and stretch of the surface.
+    double surfaceFrequencyStretch;
+    int modulationWheel;  // Controller 1, 0 - 127.
+    int morphController;  // Controller 2, 0 - 127, 127 plays the morph target.
+    LinearSmoother morphAmount;  // Morph controller ramped over blocks.
+    int aftertouch;       // 0 - 127.
+    int timbre;           // Controller 74, 0 - 127.
+    double vibratoPhase;  // Phase of vibrato, radians.
+    double vibratoRate;   // Frequency of vibrato in Hz.
+    double vibratoDepth;  // Semitones of vibrato at full modulation.
+    
+    int maximumBlockSize; // Longer blocks are synthesised in sub-blocks.
+    LinearSmoother playbackSpeed; // Rate partials are played at, 1 for original timing.
+    double startPosition; // Part of the sound notes start at.
+    double noiseLevel;    // Gain of the noise bands, 0 for none.
+    Loris::PartialModifiers modifiers; // Spectral transforms of the partials.
+    bool harmonicRendering;            // Harmonic partials are rendered from the fundamental.
+    bool multiRate;                    // Low partials are computed at a reduced rate.
+    double bankCrossfadeTime;          // Held notes crossfade to new banks, seconds, 0 for none.
+    
+    std::vector<float> buffer;         // Synthesiser's innner buffer, unused: voice synthesises into output.
+    Atomic<int> maxPartials;           // CPU budget of the voice, 0 for no limit.
+    Atomic<int> oscillatorKernel;      // Loris::RealtimeOscillatorBank::Kernel of the partials.
+    int writtenChannels;               // Output channels written by the last block.
+    int playingPartials;               // Partials played by the last block, at most.
+    int culledPartials;                // Partials above Nyquist skipped by the last block.
     
-    std::vector<float> buffer;         // Synthesiser's innner buffer.
+    NoteRenderCache *noteCache;         // Rendered notes, nullptr for none.
+    const NoteRenderCache::Note *cachedNote; // Rendered note played instead of the synthesiser, or nullptr.
+    int cachedPosition;                 // Next sample of cachedNote, negative before the note starts.
+    BankStreamer *bankStreamer;         // Streams banks ahead of the voice, nullptr for none.
+    int streamSlot;                     // Slot the voice publishes its position in.
+    
+    Loris::RealTimeSynthesizer *synth;  // This makes the sound, synthesiser of the current zone.
+    int zone;                           // Zone of the current note.
+    ScopedPointer<Loris::RealTimeSynthesizer> synths[kMaxZones];  // Synthesiser of each zone set up.
+    Atomic<Loris::RealTimeSynthesizer *> pendingSynths[kMaxZones];// Published by setup(), not picked up yet.
+    Atomic<Loris::RealTimeSynthesizer *> retiredSynths[kMaxZones];// Replaced by pending one, to be deleted by setup().
+    Loris::RealTimeSynthesizer *fadingSynth;  // Old bank of a held note crossfading to synth, or nullptr.
+    int fadingSynthZone;                      // Zone of fadingSynth, retired there when it is faded out.
+    int bankFadeSamples;                      // Length of the crossfade,
+    int bankFadeLeft;                         // and its samples not synthesised yet.
+    
+    Loris::EnvelopeFrame envelopeFrame; // Breakpoints of a block, shared with voices joining this one.
+    Loris::EnvelopeFrame *envelopes;    // Frame of the next block, of this voice or its leader, or nullptr.
+    LorisVoice *nextChordVoice;         // Voice joining this one in the next block, see joinChord().
 };
 
 //==============================================================================
@@ -103,55 +531,1462 @@ private:
 class LorisSynthesiser : public Synthesiser
 {
 public:
+    LorisSynthesiser()
+    {
+        zones.add(new Zone());
+        updateSounds();
+    }
     
     /**
-       Setup synthesiser's voices using partials.
+       Setup synthesiser's voices using partials. Sounding notes are not stopped, like in
+       setupPreview(): released notes finish with the partials they started with, held ones
+       too or crossfade to the new ones (see setBankCrossfadeTime()), and new notes play the
+       new ones. An old bank is freed with the last synthesiser playing it.
        @param partials data gathered at analysis stage
        @param samplePitch original pitch of partils data.
+       @param cacheKey key of the partials in AnalysisCache, prepared banks are cached
+                       under it. Empty if the partials are not cached.
      */
-    void setup(Loris::PartialList &partials, double samplePitch)
+    void setup(Loris::PartialList &partials, double samplePitch, const String &cacheKey = String::empty)
     {
-        allNotesOff(0, false); // clear all notes before setting new partials
+        const ScopedLock sl(partialsLock);
         
-        this->partials.clear();
-        this->partials = std::move(partials);
+        Zone &zone = *zones.getUnchecked(0);
+        zone.partials.clear();
+        zone.partials = std::move(partials);
         partials.clear(); // invalidate partials due to std::move
+        zone.hibernatedPartials.reset();
         
-        this->samplePitch = samplePitch;
+        zone.samplePitch = samplePitch;
+        zone.cacheKey = cacheKey;
+        clearBanks(zone);
         
-        update(this->partials, this->samplePitch);
+        update(0);
     }
     
-    void setCurrentPlaybackSampleRate(double newRate) override
+    /**
+       Setup synthesiser's voices using partials of unfinished analysis. Unlike
+       setup(), sounding notes are not stopped, they finish with partials they
+       started with and new notes play the new ones.
+       @param partials partials finished so far
+       @param samplePitch original pitch of partils data.
+     */
+    void setupPreview(Loris::PartialList &partials, double samplePitch)
     {
-        juce::Synthesiser::setCurrentPlaybackSampleRate(newRate);
+        const ScopedLock sl(partialsLock);
+        
+        Zone &zone = *zones.getUnchecked(0);
+        zone.partials.clear();
+        zone.partials = std::move(partials);
+        partials.clear(); // invalidate partials due to std::move
+        zone.hibernatedPartials.reset();
+        
+        zone.samplePitch = samplePitch;
+        zone.cacheKey = String::empty;
+        zone.noiseBands = nullptr; // not measured until the analysis finishes
+        clearBanks(zone);
+        
+        update(0);
+    }
+    
+    /**
+       Set number of key zones, including the first one played by setup(). Zones beyond it are
+       removed, new zones play nothing until they are set up by setupZone().
+       @param numZones number of zones, from 1 to LorisVoice::kMaxZones
+     */
+    void setNumZones(int numZones)
+    {
+        const ScopedLock sl(partialsLock);
+        
+        numZones = jlimit(1, (int) LorisVoice::kMaxZones, numZones);
+        while (zones.size() < numZones)
+            zones.add(new Zone());
+        
+        if (zones.size() > numZones)
+        {
+            for (int i = numZones; i < zones.size(); i++)
+            {
+                publishPartialGains(i, nullptr);
+                noteCache.setBank(i, Loris::PartialBank::Ptr());
+                bankStreamer.setBank(i, Loris::PartialBank::Ptr());
+            }
+            zones.removeRange(numZones, zones.size() - numZones);
+            updateSounds();
+        }
+    }
     
-        update(this->partials, this->samplePitch);
+    /** Return number of key zones, including the first one. */
+    int getNumZones()
+    {
+        const ScopedLock sl(partialsLock);
+        return zones.size();
     }
-
-private:
-    Loris::PartialList partials;
-    double samplePitch;
     
-    void update(Loris::PartialList &partials, double samplePitch)
+    /**
+       Setup key zone played by a range of keys with its own partials, notes of the keys
+       switch to its bank, the first zone plays the other keys. Sounding notes go on.
+       @param zone index of the zone, from 1 to getNumZones() - 1
+       @param lowestNote lowest MIDI note of the zone
+       @param highestNote highest MIDI note of the zone
+       @param partials partials of the sample of the zone, moved to the synthesiser
+       @param samplePitch root pitch of the sample of the zone
+       @param cacheKey key of the partials in AnalysisCache, see setup()
+       @param loopStart sustain loop of the zone, see setLoop()
+       @param loopEnd
+     */
+    void setupZone(int zone, int lowestNote, int highestNote, Loris::PartialList &partials, double samplePitch,
+                   const String &cacheKey = String::empty, double loopStart = 0., double loopEnd = 0.)
     {
-        Loris::PartialList resampledPartials(partials);
+        const ScopedLock sl(partialsLock);
         
-        if ( ! resampledPartials.empty() )
+        if (zone < 1 || zone >= zones.size())
+            return;
+        
+        Zone &z = *zones.getUnchecked(zone);
+        z.partials.clear();
+        z.partials = std::move(partials);
+        partials.clear(); // invalidate partials due to std::move
+        z.hibernatedPartials.reset();
+        
+        z.samplePitch = samplePitch;
+        z.cacheKey = cacheKey;
+        z.lowestNote = jlimit(0, 127, lowestNote);
+        z.highestNote = jlimit(0, 127, highestNote);
+        z.loopStart = loopStart;
+        z.loopEnd = loopEnd;
+        clearBanks(z);
+        
+        update(zone);
+        updateSounds();
+    }
+    
+    /**
+       Set partials the sound morphs to, moved by the morph controller of the voices (see
+       LorisVoice::kMorphController). Partials correspond by their Channelizer labels, the
+       target is sampled at every breakpoint of the sound once here and the voices interpolate
+       to it on the fly. It is kept when the sound is set up again. Do not call it from the
+       audio thread.
+       @param partials partials of the target, labeled by Channelizer
+       @param targetPitch original pitch of the target, it is played at the pitch of the sound
+     */
+    void setMorphTarget(Loris::PartialList &partials, double targetPitch)
+    {
+        // the surface of the target is sampled once, voices look it up at every block
+        std::shared_ptr<Loris::SpectralSurface> surface;
+        if ( ! partials.empty())
         {
-            Loris::Resampler resampler(1 / getSampleRate());
-            resampler.setPhaseCorrect(true);
-            resampler.quantize(resampledPartials.begin(), resampledPartials.end());
+            try
+            {
+                surface = std::make_shared<Loris::SpectralSurface>(partials.begin(), partials.end());
+                surface->sampleGrid();
+            }
+            catch (...)
+            {
+                // no labeled partials or silent ones, nothing to cross-synthesise with
+                surface.reset();
+            }
         }
         
-        LorisVoice *voice;
-        int numVoices = getNumVoices();
-        for (int i = 0; i < numVoices; i++)
+        const ScopedLock sl(partialsLock);
+        
+        morphPartials.clear();
+        morphPartials = std::move(partials);
+        partials.clear(); // invalidate partials due to std::move
+        
+        morphPitch = targetPitch;
+        publishSpectralSurface(surface);
+        
+        for (int i = 0; i < zones.size(); i++)
+        {
+            updateMorph(*zones.getUnchecked(i));
+            setupVoices(i);
+        }
+    }
+    
+    /** Remove partials the sound morphs to, see setMorphTarget(). */
+    void clearMorphTarget()
+    {
+        Loris::PartialList none;
+        setMorphTarget(none, 0.);
+    }
+    
+    /**
+       Set the peak amplitude partials have to reach to be synthesised. Quieter partials,
+       partials masked by louder neighbours and very short ones are not given to voices.
+       Banks of the voices are prepared again, do not call it from the audio thread.
+       @param amplitude absolute amplitude floor (linear)
+     */
+    void setPartialThreshold(double amplitude)
+    {
+        const ScopedLock sl(partialsLock);
+        
+        if (amplitude == partialThreshold)
+            return;
+        
+        partialThreshold = amplitude;
+        for (int i = 0; i < zones.size(); i++)
+            clearBanks(*zones.getUnchecked(i));
+        
+        updateZones();
+    }
+    
+    /** Prepare banks without phases (see Loris::PartialBank::isPhaseFree()): partials are not
+        phase fixed nor quantized phase-correctly, banks take less memory and voices start
+        partials at scattered phases. Banks are prepared again. */
+    void setPhaseFree(bool enable)
+    {
+        const ScopedLock sl(partialsLock);
+        
+        if (enable == phaseFree)
+            return;
+        
+        phaseFree = enable;
+        for (int i = 0; i < zones.size(); i++)
+            clearBanks(*zones.getUnchecked(i));
+        
+        updateZones();
+    }
+    
+    /**
+       Set the number of voices (polyphony). New voices get the partials and settings of the
+       others, removed voices stop sounding at once, idle ones are removed first. Voices are
+       created and deleted here, out of the audio thread lock, do not call it from the audio thread.
+       Before the first prepareToPlay() the number is only kept and voices are created there, so
+       instances hosts create and never play (plugin scans, templates) create no voices.
+       @param numVoices number of voices, at least 1
+     */
+    void setNumVoices(int numVoices)
+    {
+        const ScopedLock sl(partialsLock); // update() gives banks to voices
+        
+        numVoices = jmax(numVoices, 1);
+        wantedVoices = numVoices;
+        if (!prepared)
+            return;
+        
+        // new voices are ready to play before they are added
+        OwnedArray<SynthesiserVoice> added;
+        for (int i = getNumVoices(); i < numVoices; i++)
+        {
+            LorisVoice *voice = new LorisVoice();
+            if (getSampleRate() > 0)
+                voice->setCurrentPlaybackSampleRate(getSampleRate());
+            voice->setMaxPartials(getVoiceMaxPartials());
+            voice->setOscillatorKernel(getVoiceOscillatorKernel());
+            voice->setMaximumBlockSize(getVoiceMaximumBlockSize());
+            voice->setPlaybackSpeed(playbackSpeed);
+            voice->setStartPosition(startPosition);
+            voice->setNoiseLevel(getVoiceNoiseLevel());
+            voice->setModifiers(modifiers);
+            voice->setExpression(expression);
+            voice->setPartialFilter(partialFilter);
+            voice->setSpectralSurface(spectralSurface.get());
+            voice->setSurfaceEffect(surfaceEffect, surfaceTimeStretch, surfaceFrequencyStretch);
+            for (int z = 0; z < zones.size(); z++)
+                voice->setPartialGains(z, zones.getUnchecked(z)->partialGains.get());
+            voice->setHarmonicRendering(harmonicRendering);
+            voice->setMultiRate(multiRate);
+            voice->setBankCrossfadeTime(bankCrossfadeTime);
+            voice->setNoteCache(&noteCache);
+            voice->setBankStreamer(&bankStreamer, bankStreamer.addVoice());
+            for (int z = 0; z < zones.size(); z++)
+            {
+                const Zone &zone = *zones.getUnchecked(z);
+                if (zone.voicesSetup)
+                    voice->setup(z, *zone.voicesSetup);
+            }
+            added.add(voice);
+        }
+        
+        HeapBlock<SynthesiserVoice *> newActiveVoices(jmax(numVoices, getNumVoices()));
+        OwnedArray<SynthesiserVoice> removed; // deleted when leaving, not while locked
+        
+        {
+            const ScopedLock voicesLock(lock);
+            
+            while (added.size() > 0)
+                voices.add(added.removeAndReturn(0));
+            
+            while (voices.size() > numVoices)
+            {
+                int idx = voices.size() - 1;
+                for (int i = idx; i >= 0; i--)
+                {
+                    if (voices.getUnchecked(i)->getCurrentlyPlayingNote() < 0)
+                    {
+                        idx = i;
+                        break;
+                    }
+                }
+                removed.add(voices.removeAndReturn(idx));
+                if (LorisVoice *voice = dynamic_cast<LorisVoice *>(removed.getLast()))
+                    bankStreamer.removeVoice(voice->getStreamSlot());
+            }
+            
+            activeVoices.swapWith(newActiveVoices);
+            activeVoicesSize = voices.size();
+        }
+    }
+    
+    /** Set the largest number of partials each voice renders at once, 0 for no limit. Voices
+        rendering offline play all of them (see setNonRealtime()), lower quality tiers fewer
+        (see setQualityTier()). */
+    void setMaxPartialsPerVoice(int count) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        maxPartialsPerVoice = count;
+        updateVoicesQuality();
+    }
+    
+    /** Quality of voices rendering in real time, each tier costs roughly half of the one
+        before it. */
+    enum QualityTier
+    {
+        kFullQuality = 0,   // Partial budget of setMaxPartialsPerVoice()
+        kHalfPartials,      // Half of the budget
+        kQuarterPartials,   // Quarter of the budget, phasor oscillator kernel
+        kNoNoise,           // As kQuarterPartials, without noise bands
+        kNumQualityTiers
+    };
+    
+    /** Lower the cost of voices rendering in real time, see QualityTier. Playing notes follow
+        with their next block, fading partials and noise out. Voices rendering offline always
+        play at full quality. Safe to call from the audio thread, nothing is allocated.
+        @param tier a QualityTier
+     */
+    void setQualityTier(int tier) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        tier = jlimit(0, (int) kNumQualityTiers - 1, tier);
+        if (tier == qualityTier)
+            return;
+        
+        qualityTier = tier;
+        updateVoicesQuality();
+    }
+    
+    /** Return the QualityTier set by setQualityTier(). */
+    int getQualityTier() const noexcept { return qualityTier; }
+    
+    /**
+       Play notes from memory once they are rendered ("freeze per key"), see NoteRenderCache.
+       Notes without modulation are rendered in background the first time they are played,
+       later notes of the key play the rendered samples and cost hardly anything. Notes of
+       zones with a sustain loop are always synthesised. Do not call it from the audio thread,
+       the rendering thread is started here.
+     */
+    void setFreezeNotes(bool enabled) { noteCache.setEnabled(enabled); }
+    
+    /** Set memory notes rendered by setFreezeNotes() may take, least recently played ones are
+        dropped beyond it. Safe to call from any thread. */
+    void setNoteCacheSize(int64 bytes) noexcept { noteCache.setMaxBytes(bytes); }
+    
+    /** Return memory taken by rendered notes. */
+    int64 getNoteCacheBytes() const noexcept { return noteCache.getBytes(); }
+    
+    /** Limit memory of rendered notes to a share of the process-wide budget, -1 for none, see
+        MemoryGovernor. Safe to call from any thread. */
+    void setNoteCacheBudget(int64 bytes) noexcept { noteCache.setBudgetBytes(bytes); }
+    
+    /** Return memory taken by partials of the zones (also compressed ones) and by banks which
+        are not mapped from files. It is counted again only if partials are not being set up,
+        the last count is returned otherwise. Do not call it from the audio thread. */
+    int64 getBankBytes() const
+    {
+        const ScopedTryLock sl(partialsLock);
+        if ( ! sl.isLocked())
+            return bankBytes;
+        
+        int64 total = 0;
+        auto addPartials = [&total](const Loris::PartialList &partials)
+        {
+            for (const Loris::Partial &partial : partials)
+                total += (int64) (sizeof(Loris::Partial) + partial.numBreakpoints() * (sizeof(double) + sizeof(Loris::Breakpoint)));
+        };
+        for (const Zone *zone : zones)
+        {
+            addPartials(zone->partials);
+            total += (int64) zone->hibernatedPartials.getSize();
+            for (const auto &bank : zone->banks)
+                if (bank.second && ! bank.second->isImage())
+                    total += (int64) bank.second->imageSize();
+        }
+        addPartials(morphPartials);
+        return bankBytes = total;
+    }
+    
+    /** Set speed all voices play the partials at, without changing their pitch, see
+        LorisVoice::setPlaybackSpeed(). Safe to call from any thread, cheap enough to be
+        called from the audio thread for every block.
+     */
+    void setPlaybackSpeed(double speed) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        playbackSpeed = speed;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setPlaybackSpeed(speed);
+    }
+    
+    /** Set part of the sound notes of all voices start at, see LorisVoice::setStartPosition().
+        Safe to call from any thread, playing notes are not affected.
+     */
+    void setStartPosition(double position) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        startPosition = position;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setStartPosition(position);
+    }
+    
+    /** Set gain of the noise bands of all voices, see LorisVoice::setNoiseLevel(). Safe to call
+        from any thread.
+     */
+    void setNoiseLevel(double level) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        noiseLevel = level;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setNoiseLevel(getVoiceNoiseLevel());
+    }
+    
+    /** Set spectral transforms of the partials of all voices, see LorisVoice::setModifiers().
+        Safe to call from any thread.
+     */
+    void setModifiers(const Loris::PartialModifiers &newModifiers) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        modifiers = newModifiers;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setModifiers(newModifiers);
+    }
+    
+    /** Set the routing of per-note expression of all voices, see LorisVoice::setExpression().
+        Safe to call from any thread.
+     */
+    void setExpression(const ExpressionMatrix &matrix) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        expression = matrix;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setExpression(matrix);
+    }
+    
+    /** Set the equalizer of the partials of all voices, see LorisVoice::setPartialFilter().
+        Safe to call from any thread.
+     */
+    void setPartialFilter(const Loris::PartialFilter &filter) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        partialFilter = filter;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setPartialFilter(filter);
+    }
+    
+    /** Set the amount of cross-synthesis of all voices with the spectral surface of the morph
+        target, and its stretch, see LorisVoice::setSurfaceEffect(). Safe to call from any thread.
+        @param effect 0 for none, 1 scales the partials by the surface
+        @param timeStretch 2 plays the surface twice as slowly as the sound
+        @param frequencyStretch 2 moves the spectrum of the surface an octave up
+     */
+    void setSurfaceEffect(double effect, double timeStretch, double frequencyStretch) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        surfaceEffect = effect;
+        surfaceTimeStretch = timeStretch;
+        surfaceFrequencyStretch = frequencyStretch;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setSurfaceEffect(effect, timeStretch, frequencyStretch);
+    }
+    
+    /** Crossfade held notes of all voices to banks set up while they play, see
+        LorisVoice::setBankCrossfadeTime(). Safe to call from any thread.
+        @param seconds length of the crossfade, 0 keeps held notes on their bank
+     */
+    void setBankCrossfadeTime(double seconds) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        bankCrossfadeTime = seconds;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setBankCrossfadeTime(seconds);
+    }
+    
+    /** Render harmonic partials of all voices from their fundamental, see
+        LorisVoice::setHarmonicRendering(). Safe to call from any thread.
+     */
+    void setHarmonicRendering(bool enable) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        harmonicRendering = enable;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setHarmonicRendering(enable);
+    }
+    
+    /** Compute low partials of all voices at a reduced rate, see LorisVoice::setMultiRate().
+        Safe to call from any thread.
+     */
+    void setMultiRate(bool enable) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        multiRate = enable;
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setMultiRate(enable);
+    }
+    
+    /**
+       Set residual of the analysis of the partials of a zone, rendered by voices as bands of
+       filtered noise (see Loris::RealtimeNoiseBands) at the level set by setNoiseLevel(). Voices
+       get it with the partials, call it before setup() or setupZone(). Kept until it is set
+       again, setupPreview() clears it.
+       @param zone index of the zone, 0 for the one set up by setup()
+       @param noiseBands residual of the zone, empty for none
+     */
+    void setNoiseBands(int zone, Loris::NoiseBands::Ptr noiseBands)
+    {
+        const ScopedLock sl(partialsLock);
+        
+        if (zone >= 0 && zone < zones.size())
+            zones.getUnchecked(zone)->noiseBands = noiseBands;
+    }
+    
+    /**
+       Set sustain loop of the sound of the first zone, held notes go on from its start when they
+       reach its end.
+       Voices are set up again if it changes, do not call it from the audio thread.
+       @param startSec loop start in seconds (time of partials)
+       @param endSec loop end in seconds, no loop if it is not after start
+     */
+    void setLoop(double startSec, double endSec)
+    {
+        const ScopedLock sl(partialsLock);
+        
+        Zone &zone = *zones.getUnchecked(0);
+        if (startSec == zone.loopStart && endSec == zone.loopEnd)
+            return;
+        
+        zone.loopStart = startSec;
+        zone.loopEnd = endSec;
+        
+        setupVoices(0);
+    }
+    
+    /**
+       Set the gain of partials of the bank a zone plays, 0 mutes them (a deleted partial is a
+       muted one). Edits are copy-on-write patches of the shared bank (see Loris::PartialGains):
+       only the chunks of gains holding the partials edited are copied, the bank is not prepared
+       again and playing notes take the new gains at the next block, so an edit takes the same
+       time whatever the size of the bank. Edits are dropped when the zone gets another bank.
+       Do not call it from the audio thread.
+       @param zone index of the zone
+       @param partials indices of the partials in the bank (see Loris::PartialBank::partials())
+       @param gain linear gain of the partials, 1 undoes the edits
+     */
+    void setPartialGain(int zone, const std::vector<size_t> &partials, float gain)
+    {
+        editPartialGains(zone, [&](const Loris::PartialGains &gains, const Loris::PartialBank &)
+                               { return gains.withGain(partials, gain); });
+    }
+    
+    /** Set the gain of the partials of a label in the bank a zone plays, like setPartialGain(). */
+    void setLabelGain(int zone, int label, float gain)
+    {
+        editPartialGains(zone, [&](const Loris::PartialGains &gains, const Loris::PartialBank &bank)
+                               { return gains.withLabelGain(bank, label, gain); });
+    }
+    
+    /** Undo all edits of setPartialGain() and setLabelGain() of a zone. */
+    void clearPartialGains(int zone)
+    {
+        const ScopedLock sl(partialsLock);
+        if (zone >= 0 && zone < zones.size())
+            publishPartialGains(zone, nullptr);
+    }
+    
+    /** Return copy of partials the synthesiser plays in the first zone (not resampled). */
+    Loris::PartialList getPartials()
+    {
+        const ScopedLock sl(partialsLock);
+        Zone &zone = *zones.getUnchecked(0);
+        wake(zone);
+        return zone.partials;
+    }
+    
+    /**
+       Compact an idle synthesiser: partials of the zones are compressed in memory and voices
+       play banks mapped from AnalysisCache (their pages are the file, the system drops them
+       when memory is short), banks prepared in memory are released. Notes go on playing the
+       mapped banks, nothing is done again until partials are needed to prepare a bank
+       (another sample rate or partial threshold), they are decompressed then. Do not call
+       it from the audio thread.
+     */
+    void hibernate()
+    {
+        LORIS_TRACE_ZONE("LorisSynthesiser::hibernate");
+        const ScopedLock sl(partialsLock);
+        
+        AnalysisCache cache;
+        for (int i = 0; i < zones.size(); i++)
+        {
+            Zone &zone = *zones.getUnchecked(i);
+            if ( ! zone.partials.empty())
+            {
+                MemoryOutputStream stream(zone.hibernatedPartials, false);
+                {
+                    GZIPCompressorOutputStream compressor(&stream, 3);
+                    PartialsCodec::write(zone.partials, compressor);
+                }
+                Loris::PartialList().swap(zone.partials);
+            }
+            
+            if (zone.cacheKey.isEmpty() || ! zone.voicesBank || zone.voicesBank->isImage())
+                continue;
+            
+            Loris::PartialBank::Ptr mapped = cache.readBank(getBankKey(zone), getSampleRate());
+            if ( ! mapped || mapped->pitch() != zone.voicesBank->pitch() || mapped->fadeTime() != zone.voicesBank->fadeTime())
+                continue;
+            
+            // the morph holds values at the breakpoints, the mapped bank has the same ones
+            clearBanks(zone);
+            zone.banks[getSampleRate()] = mapped;
+            zone.voicesBank = mapped;
+            if (zone.partialGains)
+                publishPartialGains(i, zone.partialGains->rebased(*mapped));
+            setupVoices(i);
+        }
+    }
+    
+    /** Prepare voices for playback, call it from prepareToPlay() of the processor.
+        @param sampleRate sample rate of the host
+        @param samplesPerBlock estimated size of blocks, voices split longer ones
+     */
+    void prepareToPlay(double sampleRate, int samplesPerBlock)
+    {
+        // voices deferred by setNumVoices() are created the first time
+        if (!prepared)
+        {
+            const ScopedLock sl(partialsLock);
+            prepared = true;
+            setNumVoices(wantedVoices);
+        }
+        
+        HeapBlock<SynthesiserVoice *> newActiveVoices(getNumVoices());
+        
+        {
+            const ScopedLock sl(lock);
+            maximumBlockSize = samplesPerBlock;
+            for (int i = getNumVoices(); --i >= 0;)
+                if (LorisVoice *voice = dynamic_cast<LorisVoice *>(getVoice(i)))
+                    voice->setMaximumBlockSize(getVoiceMaximumBlockSize());
+            channelBus.setSize(Loris::PartialStruct::NumChannels, jmax(samplesPerBlock, 0));
+            markChannelBusDirty();
+            if (renderPool != nullptr)
+                (*renderPool)->prepare(samplesPerBlock);
+            activeVoices.swapWith(newActiveVoices);
+            activeVoicesSize = getNumVoices();
+        }
+        
+        setCurrentPlaybackSampleRate(sampleRate);
+    }
+    
+    /**
+       Render voices on several threads, off by default. Playing voices are shared by the audio
+       thread and at most numThreads - 1 workers of the pool shared by all instances (see
+       SharedVoiceRenderPool), blocks with a single playing voice are rendered by the audio
+       thread only. Do not call it from the audio thread, the shared pool may be started here.
+       @param numThreads number of threads rendering voices, including the audio thread,
+                         1 (or less) renders voices serially
+     */
+    void setRenderThreads(int numThreads)
+    {
+        {
+            const ScopedLock sl(lock);
+            realtimeThreads = jmax(numThreads, 1);
+        }
+        updateRenderPool();
+    }
+    
+    /**
+       Render voices on several threads while rendering offline (see setNonRealtime()), like
+       setRenderThreads() does it in real time. Do not call it from the audio thread.
+       @param numThreads number of threads rendering voices offline, including the audio
+                         thread, 1 (or less) renders voices serially
+     */
+    void setOfflineRenderThreads(int numThreads)
+    {
+        {
+            const ScopedLock sl(lock);
+            offlineThreads = jmax(numThreads, 1);
+        }
+        updateRenderPool();
+    }
+    
+    /** Return number of threads rendering voices offline, including the audio thread. */
+    int getOfflineRenderThreads() const noexcept { return offlineThreads; }
+    
+    /**
+       Render offline (a bounce, see AudioProcessor::isNonRealtime()) or in real time. Offline,
+       voices play all their partials whatever their partial budget is, synthesise blocks of
+       any length at once (not in sub-blocks of the prepareToPlay() estimate) and are rendered
+       by the threads set for it (see setOfflineRenderThreads()). Safe to call from the audio thread,
+       nothing is allocated.
+     */
+    void setNonRealtime(bool offline) noexcept
+    {
+        const ScopedLock sl(lock);
+        
+        if (offline == nonRealtime)
+            return;
+        
+        nonRealtime = offline;
+        updateVoicesQuality();
+        for (int i = getNumVoices(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(getVoice(i)))
+                voice->setMaximumBlockSize(getVoiceMaximumBlockSize());
+    }
+    
+    /**
+       Render the next block like Synthesiser::renderNextBlock(), but without splitting it at
+       MIDI events. Events are handled first, voices are told their positions and start and
+       stop notes there, so every voice is rendered once per block no matter how dense the
+       MIDI is. It hides the non-virtual method of Synthesiser.
+       Output with two or more channels gets partials of stereo sounds in the first two,
+       see mixChannels(), mono output gets all of them. Channels no voice wrote are not
+       touched, see getWrittenChannels().
+     */
+    void renderNextBlock(AudioSampleBuffer &outputAudio, const MidiBuffer &inputMidi,
+                         int startSample, int numSamples)
+    {
+        // must set the sample rate before using this!
+        jassert(getSampleRate() != 0);
+        
+        const ScopedLock sl(lock);
+        
+        MidiBuffer::Iterator midiIterator(inputMidi);
+        midiIterator.setNextSamplePosition(startSample);
+        MidiMessage m(0xf4, 0.0);
+        int midiEventPos;
+        
+        while (midiIterator.getNextEvent(m, midiEventPos) && midiEventPos < startSample + numSamples)
+        {
+            setEventOffset(midiEventPos - startSample);
+            handleMidiEvent(m);
+        }
+        setEventOffset(0);
+        writtenChannels = 0;
+        
+        if (numSamples <= 0)
+            return;
+        
+        if (outputAudio.getNumChannels() < 2)
+        {
+            renderVoices(outputAudio, startSample, numSamples);
+            writtenChannels = getVoicesWrittenChannels() != 0 ? 1 : 0;
+            return;
+        }
+        
+        // voices accumulate partials of each channel on their own, the channels are
+        // mixed once per block (grows only if the host exceeds its estimate); channels
+        // no voice wrote to in the last block are still clear
+        if (channelBus.getNumSamples() < numSamples)
+        {
+            channelBus.setSize(Loris::PartialStruct::NumChannels, numSamples, false, false, true);
+            markChannelBusDirty();
+        }
+        for (int c = 0; c < Loris::PartialStruct::NumChannels; c++)
+            if ((busChannelsDirty & (1 << c)) != 0)
+                channelBus.clear(c, 0, busSamplesDirty);
+        
+        renderVoices(channelBus, 0, numSamples);
+        busChannelsDirty = getVoicesWrittenChannels();
+        busSamplesDirty = numSamples;
+        writtenChannels = mixChannels(channelBus, busChannelsDirty, outputAudio, startSample, numSamples);
+    }
+    
+    /** Return the channels of the output the last renderNextBlock() added samples to, bit
+        1 << channel for each, 0 if all voices were silent. The others were not touched. */
+    int getWrittenChannels() const noexcept { return writtenChannels; }
+    
+    /** Return the voices which rendered the last block, with the partials they played
+        and the partials they skipped above Nyquist (see LorisVoice::getPlayingPartials()). */
+    void getVoicesRenderStats(int &activeVoices, int &playingPartials, int &culledPartials) const noexcept
+    {
+        activeVoices = playingPartials = culledPartials = 0;
+        for (int i = voices.size(); --i >= 0;)
+            if (const LorisVoice *voice = dynamic_cast<const LorisVoice *>(voices.getUnchecked(i)))
+            {
+                if (voice->getCurrentlyPlayingNote() >= 0 || voice->isFadingOut())
+                    ++activeVoices;
+                playingPartials += voice->getPlayingPartials();
+                culledPartials += voice->getCulledPartials();
+            }
+    }
+    
+    /** Fill the partials each voice played in the last block, 0 for silent voices, and return
+        the number of voices filled, at most maxVoices. Called from the audio thread. */
+    int getVoicesActivity(uint16 *partials, int maxVoices) const noexcept
+    {
+        const int numVoices = jmin(voices.size(), maxVoices);
+        for (int i = 0; i < numVoices; i++)
+        {
+            const LorisVoice *voice = dynamic_cast<const LorisVoice *>(voices.getUnchecked(i));
+            const bool sounding = voice != nullptr && (voice->getCurrentlyPlayingNote() >= 0 || voice->isFadingOut());
+            partials[i] = (uint16) (sounding ? jlimit(1, 0xffff, voice->getPlayingPartials()) : 0);
+        }
+        return numVoices;
+    }
+    
+    /** Return statistics of the bank of the first zone as voices play it at the sample rate,
+        all zero until it is set up. Playback state is given for one voice. Safe to call
+        from any thread, it does not wait for analysis or preparation of banks. */
+    Loris::RealTimeSynthesizer::Statistics getStatistics() const noexcept
+    {
+        const SpinLock::ScopedLockType sl(statisticsLock);
+        return statistics;
+    }
+    
+    /** Return the bank of the first zone voices play, empty until it is set up. Safe to call
+        from any thread, like getStatistics(). */
+    Loris::PartialBank::Ptr getBank() const
+    {
+        const SpinLock::ScopedLockType sl(statisticsLock);
+        return statisticsBank;
+    }
+    
+    /** Add a channel bus to the first two channels of output: Center to both, Left and Right
+        to their channel, Side to left and inverted to right (see Loris::PartialStruct::Channel).
+        Only channels of the bus in the mask busChannels (bit 1 << channel) are added, the
+        channels of the output they were added to are returned the same way. */
+    static int mixChannels(const AudioSampleBuffer &bus, int busChannels, AudioSampleBuffer &output,
+                           int startSample, int numSamples) noexcept
+    {
+        float *left = output.getWritePointer(0, startSample);
+        float *right = output.getWritePointer(1, startSample);
+        int outputChannels = 0;
+        
+        if ((busChannels & (1 << Loris::PartialStruct::Center)) != 0)
+        {
+            const float *center = bus.getReadPointer(Loris::PartialStruct::Center);
+            FloatVectorOperations::add(left, center, numSamples);
+            FloatVectorOperations::add(right, center, numSamples);
+            outputChannels |= 3;
+        }
+        if ((busChannels & (1 << Loris::PartialStruct::Left)) != 0)
+        {
+            FloatVectorOperations::add(left, bus.getReadPointer(Loris::PartialStruct::Left), numSamples);
+            outputChannels |= 1;
+        }
+        if ((busChannels & (1 << Loris::PartialStruct::Right)) != 0)
+        {
+            FloatVectorOperations::add(right, bus.getReadPointer(Loris::PartialStruct::Right), numSamples);
+            outputChannels |= 2;
+        }
+        if ((busChannels & (1 << Loris::PartialStruct::Side)) != 0)
+        {
+            const float *side = bus.getReadPointer(Loris::PartialStruct::Side);
+            FloatVectorOperations::add(left, side, numSamples);
+            FloatVectorOperations::subtract(right, side, numSamples);
+            outputChannels |= 3;
+        }
+        
+        return outputChannels;
+    }
+    
+    /** Return number of threads rendering voices, including the audio thread. */
+    int getRenderThreads() const noexcept { return realtimeThreads; }
+    
+    void setCurrentPlaybackSampleRate(double newRate) override
+    {
+        juce::Synthesiser::setCurrentPlaybackSampleRate(newRate);
+    
+        const ScopedLock sl(partialsLock);
+        updateZones();
+    }
+
+protected:
+    /** The morph controller is told to idle voices too, so notes start at the morph it is at,
+        other controllers are handled as by Synthesiser. */
+    void handleController(int midiChannel, int controllerNumber, int controllerValue) override
+    {
+        if (controllerNumber == LorisVoice::kMorphController)
+        {
+            const ScopedLock sl(lock);
+            
+            for (int i = voices.size(); --i >= 0;)
+            {
+                SynthesiserVoice *voice = voices.getUnchecked(i);
+                if (voice->getCurrentlyPlayingNote() < 0)
+                    voice->controllerMoved(controllerNumber, controllerValue);
+            }
+        }
+        
+        Synthesiser::handleController(midiChannel, controllerNumber, controllerValue);
+    }
+    
+    /** Channel pressure is the pressure of the notes of its channel (polyphonic aftertouch is
+        handled by Synthesiser), with MPE every note has a channel of its own. Pressure and
+        timbre (LorisVoice::kTimbreController) sent to a channel before a note starts on it
+        are given to the note, as Synthesiser gives it the pitch wheel of the channel. */
+    void handleMidiEvent(const MidiMessage &m) override
+    {
+        const int channel = m.getChannel();
+        if (m.isChannelPressure())
+        {
+            const ScopedLock sl(lock);
+            
+            channelPressures[channel - 1] = m.getChannelPressureValue();
+            for (int i = voices.size(); --i >= 0;)
+            {
+                SynthesiserVoice *voice = voices.getUnchecked(i);
+                if (voice->getCurrentlyPlayingNote() >= 0 && voice->isPlayingChannel(channel))
+                    voice->aftertouchChanged(channelPressures[channel - 1]);
+            }
+            return;
+        }
+        
+        if (m.isController() && m.getControllerNumber() == LorisVoice::kTimbreController && channel > 0)
+            channelTimbres[channel - 1] = m.getControllerValue();
+        
+        Synthesiser::handleMidiEvent(m);
+        
+        if (m.isNoteOn() && channel > 0)
+        {
+            const ScopedLock sl(lock);
+            
+            for (int i = voices.size(); --i >= 0;)
+            {
+                SynthesiserVoice *voice = voices.getUnchecked(i);
+                if (voice->getCurrentlyPlayingNote() == m.getNoteNumber() && voice->isPlayingChannel(channel))
+                {
+                    voice->aftertouchChanged(channelPressures[channel - 1]);
+                    voice->controllerMoved(LorisVoice::kTimbreController, channelTimbres[channel - 1]);
+                }
+            }
+        }
+    }
+    
+    /** Find idle voice, voices fading out a stopped note are taken only if there is no other. */
+    SynthesiserVoice *findFreeVoice(SynthesiserSound *soundToPlay, int midiChannel, int midiNoteNumber,
+                                    const bool stealIfNoneAvailable) const override
+    {
+        const ScopedLock sl(lock);
+        
+        SynthesiserVoice *fading = nullptr;
+        for (int i = 0; i < voices.size(); i++)
+        {
+            SynthesiserVoice *voice = voices.getUnchecked(i);
+            if (voice->getCurrentlyPlayingNote() >= 0 || ! voice->canPlaySound(soundToPlay))
+                continue;
+            
+            LorisVoice *lorisVoice = dynamic_cast<LorisVoice *>(voice);
+            if (lorisVoice == nullptr || ! lorisVoice->isFadingOut())
+                return voice;
+            if (fading == nullptr)
+                fading = voice;
+        }
+        
+        if (fading != nullptr || ! stealIfNoneAvailable)
+            return fading;
+        
+        return findVoiceToSteal(soundToPlay, midiChannel, midiNoteNumber);
+    }
+    
+    /** Steal the voice which is heard least: tailing off, quiet or close to the end of its
+        partials, see LorisVoice::getStealCost(). The stolen note fades out for a few
+        milliseconds. Nothing is allocated, unlike the default implementation. */
+    SynthesiserVoice *findVoiceToSteal(SynthesiserSound *soundToPlay, int /*midiChannel*/,
+                                       int /*midiNoteNumber*/) const override
+    {
+        SynthesiserVoice *cheapest = nullptr;
+        double cheapestCost = 0.;
+        
+        for (int i = 0; i < voices.size(); i++)
+        {
+            SynthesiserVoice *voice = voices.getUnchecked(i);
+            if ( ! voice->canPlaySound(soundToPlay))
+                continue;
+            
+            LorisVoice *lorisVoice = dynamic_cast<LorisVoice *>(voice);
+            const double cost = lorisVoice != nullptr ? lorisVoice->getStealCost() : 2.;
+            
+            // the oldest note wins a tie
+            if (cheapest == nullptr || cost < cheapestCost
+                || (cost == cheapestCost && voice->wasStartedBefore(*cheapest)))
+            {
+                cheapest = voice;
+                cheapestCost = cost;
+            }
+        }
+        
+        return cheapest;
+    }
+    
+    /** Render playing voices on threads of the shared pool, as many as set for the render mode,
+        if more voices are playing. Notes of a chord struck together are rendered one after
+        another by the first of them, they share its breakpoints (see LorisVoice::joinChord()). */
+    void renderVoices(AudioSampleBuffer &buffer, int startSample, int numSamples) override
+    {
+        if (activeVoicesSize < voices.size())
+        {
+            Synthesiser::renderVoices(buffer, startSample, numSamples);
+            return;
+        }
+        
+        // idle voices only pick up new partials, there is nothing to share
+        int numActive = 0;
+        for (int i = voices.size(); --i >= 0;)
+        {
+            SynthesiserVoice *voice = voices.getUnchecked(i);
+            if (voice->getCurrentlyPlayingNote() < 0)
+            {
+                voice->renderNextBlock(buffer, startSample, numSamples);
+                continue;
+            }
+            
+            if (LorisVoice *lorisVoice = dynamic_cast<LorisVoice *>(voice))
+            {
+                LorisVoice *leader = findChordLeader(*lorisVoice, numActive);
+                lorisVoice->joinChord(leader);
+                if (leader != nullptr)
+                    continue;
+            }
+            activeVoices[numActive++] = voice;
+        }
+        
+        const int numThreads = nonRealtime ? offlineThreads : realtimeThreads;
+        if (renderPool != nullptr && numThreads > 1 && numActive > 1
+            && (*renderPool)->render(activeVoices, numActive, buffer, startSample, numSamples, numThreads - 1))
+            return;
+        
+        for (int i = 0; i < numActive; i++)
+            activeVoices[i]->renderNextBlock(buffer, startSample, numSamples);
+    }
+    
+private:
+    /** Return the first of the voices picked for the block a voice can share breakpoints
+        with, nullptr if there is none. */
+    LorisVoice *findChordLeader(const LorisVoice &voice, int numActive) const noexcept
+    {
+        for (int i = 0; i < numActive; i++)
+            if (LorisVoice *leader = dynamic_cast<LorisVoice *>(activeVoices[i]))
+                if (voice.canShareEnvelopes(*leader))
+                    return leader;
+        return nullptr;
+    }
+    
+    /** Key zone, a sample played by a range of keys with its own partials and banks. The
+        first zone is the main sample, it plays keys of no other zone. */
+    struct Zone
+    {
+        Loris::PartialList partials;
+        double samplePitch = 0.;
+        String cacheKey;
+        int lowestNote = 0;                           // Keys of the zone, unused by the first one
+        int highestNote = 127;
+        std::map<double, Loris::PartialBank::Ptr> banks; // Banks of partials prepared for sample rates
+        Loris::PartialBank::Ptr voicesBank;           // Bank given to voices by the last update
+        Loris::PartialMorph::Ptr voicesMorph;         // Morph of voicesBank to morphPartials given to voices
+        double loopStart = 0.;                        // Sustain loop given to voices with the bank
+        double loopEnd = 0.;
+        Loris::NoiseBands::Ptr noiseBands;            // Residual given to voices with the bank
+        MemoryBlock hibernatedPartials;               // Partials compressed by hibernate(), partials are empty then
+        std::shared_ptr<const Loris::RealTimeSynthesizer> voicesSetup; // Voices are set up from it, see setupVoices()
+        Loris::PartialGains::Ptr partialGains;        // Edits of the partials of voicesBank given to voices, or empty
+    };
+    
+    OwnedArray<Zone> zones;                           // At least the first one
+    double partialThreshold = Decibels::decibelsToGain((double) Loris::Pruner::DefaultFloorDb);
+    bool phaseFree = false;                           // Banks are prepared without phases
+    CriticalSection partialsLock; // setup() is called from analysis thread, never from audio thread
+    mutable int64 bankBytes = 0;  // Last count of getBankBytes()
+    SharedResourcePointer<AnalysisRegistry> registry; // Banks shared by all instances
+    std::vector<float> unusedBuffer;                  // Of synthesisers voices are set up from, they never render
+    
+    Loris::PartialList morphPartials;                 // Target of the morph controller, empty for none
+    double morphPitch = 0.;
+    std::shared_ptr<const Loris::SpectralSurface> spectralSurface; // Of morphPartials given to voices, or empty
+    
+    ScopedPointer<SharedResourcePointer<SharedVoiceRenderPool> > renderPool; // Held while a render mode uses several threads
+    int realtimeThreads = 1;                          // Threads rendering voices in real time, see setRenderThreads()
+    int offlineThreads = 1;                           // Threads rendering voices offline, see setOfflineRenderThreads()
+    bool nonRealtime = false;                         // Rendering offline, see setNonRealtime()
+    HeapBlock<SynthesiserVoice *> activeVoices;       // Playing voices of a block, sized for all voices
+    int activeVoicesSize = 0;
+    int maximumBlockSize = 0;                         // Estimate of prepareToPlay()
+    int wantedVoices = 1;                             // Voices set by setNumVoices(), guarded by partialsLock
+    bool prepared = false;                            // Was prepareToPlay() called, voices are created since then
+    AudioSampleBuffer channelBus;                     // Voices render here, a channel per PartialStruct::Channel
+    int busChannelsDirty = 0;                         // Channels of channelBus which are not clear,
+    int busSamplesDirty = 0;                          // in samples from the beginning
+    int writtenChannels = 0;                          // Output channels written by the last block
+    int maxPartialsPerVoice = 0;                      // Given to new voices
+    int qualityTier = kFullQuality;                   // See setQualityTier(), guarded by lock
+    Loris::RealTimeSynthesizer::Statistics statistics;// Of the first zone, see getStatistics()
+    Loris::PartialBank::Ptr statisticsBank;           // Bank of statistics, see getBank()
+    SpinLock statisticsLock;                          // Guards statistics, partialsLock is held for long
+    double playbackSpeed = 1.;                        // Given to new voices
+    double startPosition = 0.;                        // Given to new voices
+    double noiseLevel = 0.;                           // Given to new voices
+    Loris::PartialModifiers modifiers;                // Given to new voices
+    ExpressionMatrix expression;                      // Given to new voices
+    Loris::PartialFilter partialFilter;               // Given to new voices
+    double surfaceEffect = 0.;                        // Given to new voices
+    double surfaceTimeStretch = 1.;                   // Given to new voices
+    double surfaceFrequencyStretch = 1.;              // Given to new voices
+    int channelPressures[16] = {};                    // Last channel pressure of each MIDI channel,
+    int channelTimbres[16] = {};                      // and timbre, given to notes starting on it
+    bool harmonicRendering = false;                   // Given to new voices
+    bool multiRate = true;                            // Given to new voices
+    double bankCrossfadeTime = 0.;                    // Given to new voices
+    NoteRenderCache noteCache;                        // Notes rendered for voices, see setFreezeNotes()
+    BankStreamer bankStreamer;                        // Streams long banks from their cache files
+    
+    /** Return the partial budget of voices, none while rendering offline. */
+    int getVoiceMaxPartials() const noexcept
+    {
+        if (nonRealtime || maxPartialsPerVoice <= 0)
+            return nonRealtime ? 0 : maxPartialsPerVoice;
+        return jmax(1, maxPartialsPerVoice >> jmin(qualityTier, (int) kQuarterPartials));
+    }
+    
+    /** Return the oscillator kernel of voices, the cheaper one at low quality tiers. */
+    Loris::RealtimeOscillatorBank::Kernel getVoiceOscillatorKernel() const noexcept
+    {
+        return ! nonRealtime && qualityTier >= kQuarterPartials ? Loris::RealtimeOscillatorBank::PhasorKernel
+                                                                : Loris::RealtimeOscillatorBank::CosineKernel;
+    }
+    
+    /** Return the gain of noise bands of voices, none at the lowest quality tier. */
+    double getVoiceNoiseLevel() const noexcept { return ! nonRealtime && qualityTier >= kNoNoise ? 0. : noiseLevel; }
+    
+    /** Give the partial budget, kernel and noise of the quality tier to all voices. lock must
+        be held. */
+    void updateVoicesQuality() noexcept
+    {
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+            {
+                voice->setMaxPartials(getVoiceMaxPartials());
+                voice->setOscillatorKernel(getVoiceOscillatorKernel());
+                voice->setNoiseLevel(getVoiceNoiseLevel());
+            }
+    }
+    
+    /** Return the sub-block size of voices, whole blocks while rendering offline. */
+    int getVoiceMaximumBlockSize() const noexcept
+    {
+        return nonRealtime ? (int) LorisVoice::kDefaultMaximumBlockSize : maximumBlockSize;
+    }
+    
+    /** Set position of the MIDI event being handled on all voices. */
+    void setEventOffset(int samples) noexcept
+    {
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setEventOffset(samples);
+    }
+    
+    /** Prepare bank of zone for the sample rate and give it to voices, partialsLock must be held. */
+    void update(int zoneIndex)
+    {
+        LORIS_TRACE_ZONE("LorisSynthesiser::update");
+        Zone &zone = *zones.getUnchecked(zoneIndex);
+        const Loris::PartialList &partials = zone.partials;
+        const double samplePitch = zone.samplePitch;
+        
+        // hosts call prepareToPlay often (buffer size changes, offline bounces), partials
+        // are quantized only once for each sample rate
+        Loris::PartialBank::Ptr &bank = zone.banks[getSampleRate()];
+        if (bank && bank == zone.voicesBank)
+            return;
+        
+        wake(zone);
+        const double fadeTime = Loris::Synthesizer::DefaultParameters().fadeTime;
+        const bool useCache = zone.cacheKey.isNotEmpty() && getSampleRate() > 0 && ! partials.empty();
+        const double thresholdDb = Decibels::gainToDecibels(partialThreshold, -1000.);
+        const String bankKey = getBankKey(zone);
+        AnalysisCache cache;
+        
+        // one read-only bank for all voices, shared with other instances playing the same
+        // sound or mapped from cache if it was prepared before
+        if ( ! bank && useCache)
+        {
+            bank = registry->findBank(bankKey, getSampleRate());
+            if ( ! bank )
+                bank = cache.readBank(bankKey, getSampleRate());
+            if (bank && (bank->pitch() != samplePitch || bank->fadeTime() != fadeTime
+                         || bank->isPhaseFree() != phaseFree))
+                bank = nullptr;
+        }
+        
+        if ( ! bank )
+        {
+            // one working copy from the analysed partials to the bank: inaudible partials are
+            // not worth their oscillators and are never copied, the copy is contiguous, so it
+            // is fixed, simplified and quantized in parallel without collecting the partials
+            // first, breakpoints on straight stretches of envelopes are not worth their segments,
+            // phases dropped by phase-free banks are not worth fixing
+            Loris::Pruner pruner(thresholdDb);
+            Loris::PartialVector prepared = pruner.pruned(partials);
+            if ( ! prepared.empty())
+            {
+                Loris::Resampler resampler(1 / getSampleRate());
+                resampler.setNumThreads(0);
+                if ( ! phaseFree)
+                    resampler.fixPhases(prepared.begin(), prepared.end());
+                Loris::Simplifier simplifier;
+                simplifier.setNumThreads(0);
+                simplifier.simplify(prepared.begin(), prepared.end());
+                resampler.setPhaseCorrect( ! phaseFree);
+                resampler.setPhasesFixed( ! phaseFree);
+                resampler.quantize(prepared.begin(), prepared.end());
+            }
+            
+            // breakpoints in 16 bits keep large banks in cache, rounding is inaudible
+            bank = Loris::PartialBank::create(prepared, samplePitch, fadeTime, getSampleRate(),
+                                              Loris::PartialBank::CompactEncoding, phaseFree);
+            
+            if (useCache)
+            {
+                cache.writeBank(bankKey, *bank);
+                
+                // long sounds are played from the mapped file, which is streamed
+                Loris::PartialBank::Ptr mapped = cache.readBank(bankKey, getSampleRate());
+                if (mapped && BankStreamer::shouldStream(*mapped))
+                    bank = mapped;
+            }
+        }
+        
+        if (useCache)
+            registry->addBank(bankKey, bank);
+        
+        // edits of the partials are by their index in the bank, another bank drops them
+        if (bank != zone.voicesBank && zone.partialGains)
+            publishPartialGains(zoneIndex, nullptr);
+        zone.voicesBank = bank;
+        updateMorph(zone);
+        setupVoices(zoneIndex);
+    }
+    
+    /** Prepare banks of all zones for the sample rate, partialsLock must be held. */
+    void updateZones()
+    {
+        for (int i = 0; i < zones.size(); i++)
+            update(i);
+    }
+    
+    /** Return key of the bank of zone in AnalysisCache, for the partial threshold, the
+        tolerances of simplification and phase-free banks. */
+    String getBankKey(const Zone &zone) const
+    {
+        const double thresholdDb = Decibels::gainToDecibels(partialThreshold, -1000.);
+        const Loris::Simplifier simplifier;
+        return zone.cacheKey + "-t" + String(roundToInt(-10 * thresholdDb))
+               + "-s" + String(roundToInt(10 * simplifier.cents())) + "-" + String(roundToInt(100 * simplifier.dB()))
+               + (phaseFree ? "-p" : "");
+    }
+    
+    /** Decompress partials of zone compressed by hibernate(), partialsLock must be held. */
+    static void wake(Zone &zone)
+    {
+        if (zone.hibernatedPartials.getSize() == 0)
+            return;
+        
+        MemoryInputStream stream(zone.hibernatedPartials, false);
+        GZIPDecompressorInputStream decompressor(stream);
+        PartialsCodec::read(decompressor, zone.partials);
+        zone.hibernatedPartials.reset();
+    }
+    
+    /** Forget banks of zone prepared for sample rates, partialsLock must be held. */
+    static void clearBanks(Zone &zone)
+    {
+        zone.banks.clear();
+    }
+    
+    /** Sample morphPartials at the breakpoints of the bank of zone, partialsLock must be held. The
+        target bank is not resampled nor cached, only its values at the breakpoints are kept. */
+    void updateMorph(Zone &zone)
+    {
+        zone.voicesMorph = nullptr;
+        if (morphPartials.empty() || ! zone.voicesBank)
+            return;
+        
+        Loris::PartialList targetPartials(morphPartials);
+        Loris::Pruner pruner(Decibels::gainToDecibels(partialThreshold, -1000.));
+        pruner.prune(targetPartials);
+        
+        const Loris::PartialBank target(targetPartials, morphPitch, zone.voicesBank->fadeTime(), zone.voicesBank->sampleRate(),
+                                        Loris::PartialBank::FloatEncoding, true);
+        zone.voicesMorph = Loris::PartialMorph::create(*zone.voicesBank, target);
+    }
+    
+    /** Apply an edit to the gains of the partials of a zone, from gains of 1 if there are none
+        for its bank, and give them to voices. */
+    template <typename Edit>
+    void editPartialGains(int zoneIndex, Edit edit)
+    {
+        const ScopedLock sl(partialsLock);
+        if (zoneIndex < 0 || zoneIndex >= zones.size())
+            return;
+        
+        const Zone &zone = *zones.getUnchecked(zoneIndex);
+        if ( ! zone.voicesBank)
+            return;
+        
+        const Loris::PartialBank &bank = *zone.voicesBank;
+        const Loris::PartialGains::Ptr gains = zone.partialGains && zone.partialGains->appliesTo(bank)
+                                               ? zone.partialGains : Loris::PartialGains::create(bank);
+        publishPartialGains(zoneIndex, edit(*gains, bank));
+    }
+    
+    /** Give gains of the partials of zone to all voices, partialsLock must be held. Voices take
+        them under the lock of the audio thread, so the gains replaced are freed here, after
+        no voice reads them. */
+    void publishPartialGains(int zoneIndex, Loris::PartialGains::Ptr gains)
+    {
+        Zone &zone = *zones.getUnchecked(zoneIndex);
+        const Loris::PartialGains::Ptr replaced = zone.partialGains;
+        zone.partialGains = gains;
+        
+        const ScopedLock sl(lock);
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setPartialGains(zoneIndex, gains.get());
+    }
+    
+    /** Give the spectral surface of the morph target to all voices, partialsLock must be held.
+        The surface replaced is freed here, after no voice reads it, like in publishPartialGains(). */
+    void publishSpectralSurface(std::shared_ptr<const Loris::SpectralSurface> surface)
+    {
+        const std::shared_ptr<const Loris::SpectralSurface> replaced = spectralSurface;
+        spectralSurface = surface;
+        
+        const ScopedLock sl(lock);
+        for (int i = voices.size(); --i >= 0;)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(voices.getUnchecked(i)))
+                voice->setSpectralSurface(surface.get());
+    }
+    
+    /** Give bank and the loop of zone to all voices, partialsLock must be held. */
+    void setupVoices(int zoneIndex)
+    {
+        Zone &zone = *zones.getUnchecked(zoneIndex);
+        if ( ! zone.voicesBank)
+            return;
+        
+        // notes rendered from the previous bank are dropped
+        noteCache.setBank(zoneIndex, zone.voicesBank);
+        bankStreamer.setBank(zoneIndex, zone.voicesBank);
+        
+        // harmonic partials and loop entries are found once, voices only allocate their state
+        std::shared_ptr<Loris::RealTimeSynthesizer> prepared = std::make_shared<Loris::RealTimeSynthesizer>(unusedBuffer);
+        if (zone.voicesBank->sampleRate() > 0)
+            prepared->setSampleRate(zone.voicesBank->sampleRate());
+        prepared->setup(zone.voicesBank);
+        prepared->setMorph(zone.voicesMorph);
+        prepared->setNoiseBands(zone.noiseBands);
+        prepared->setLoop(zone.loopStart, zone.loopEnd); // loop entries of partials are computed here
+        zone.voicesSetup = prepared;
+        
+        int numVoices = getNumVoices();
+        for (int i = 0; i < numVoices; i++)
+            if (LorisVoice *voice = dynamic_cast<LorisVoice *>(getVoice(i)))
+                voice->setup(zoneIndex, *prepared);
+        
+        if (zoneIndex == 0 && numVoices > 0)
+        {
+            const SpinLock::ScopedLockType sl(statisticsLock);
+            statistics = prepared->statistics();
+            statisticsBank = zone.voicesBank;
+        }
+    }
+    
+    /** Replace sounds by one for each zone with partials, keys of overlapping zones are played
+        by the first of them and the first zone plays keys of no other one. Notes already playing
+        keep their sound, old sounds are released out of the lock. partialsLock must be held. */
+    void updateSounds()
+    {
+        BigInteger mainNotes;
+        mainNotes.setRange(0, 128, true);
+        
+        ReferenceCountedArray<SynthesiserSound> newSounds;
+        for (int i = 1; i < zones.size(); i++)
+        {
+            const Zone &zone = *zones.getUnchecked(i);
+            if ((zone.partials.empty() && zone.hibernatedPartials.getSize() == 0) || zone.highestNote < zone.lowestNote)
+                continue;
+            
+            BigInteger notes;
+            notes.setRange(zone.lowestNote, zone.highestNote - zone.lowestNote + 1, true);
+            notes &= mainNotes;
+            mainNotes.setRange(zone.lowestNote, zone.highestNote - zone.lowestNote + 1, false);
+            if ( ! notes.isZero())
+                newSounds.add(new LorisSound(i, notes));
+        }
+        if ( ! mainNotes.isZero())
+            newSounds.insert(0, new LorisSound(0, mainNotes));
+        
+        const ScopedLock voicesLock(lock);
+        sounds.swapWith(newSounds);
+    }
+    
+    /** Return the channels all voices wrote to in the last block, see LorisVoice::getWrittenChannels(). */
+    int getVoicesWrittenChannels() const noexcept
+    {
+        int channels = 0;
+        for (int i = voices.size(); --i >= 0;)
+            if (const LorisVoice *voice = dynamic_cast<const LorisVoice *>(voices.getUnchecked(i)))
+                channels |= voice->getWrittenChannels();
+        return channels;
+    }
+    
+    /** Make the next block clear all of channelBus, its content is not known. lock must be held. */
+    void markChannelBusDirty() noexcept
+    {
+        busChannelsDirty = (1 << Loris::PartialStruct::NumChannels) - 1;
+        busSamplesDirty = channelBus.getNumSamples();
+    }
+    
+    /** Hold the shared pool while a render mode uses several threads, release it otherwise. */
+    void updateRenderPool()
+    {
+        const bool needed = jmax(realtimeThreads, offlineThreads) > 1;
+        if (needed == (renderPool != nullptr))
+            return;
+        
+        ScopedPointer<SharedResourcePointer<SharedVoiceRenderPool> > pool(needed ? new SharedResourcePointer<SharedVoiceRenderPool>() : nullptr);
+        if (pool != nullptr)
+            (*pool)->prepare(maximumBlockSize);
+        HeapBlock<SynthesiserVoice *> newActiveVoices(getNumVoices());
+        
         {
-            voice = dynamic_cast<LorisVoice *>(getVoice(i));
-            if (voice)
-                voice->setup(resampledPartials, samplePitch);
+            const ScopedLock sl(lock);
+            renderPool.swapWith(pool);
+            activeVoices.swapWith(newActiveVoices);
+            activeVoicesSize = getNumVoices();
         }
+        // the last instance releasing the pool stops its threads here, outside of lock
     }
     
 };
@@ -0,0 +1,121 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "MemoryGovernor.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+//==============================================================================
+MemoryGovernor::MemoryGovernor()
+{
+}
+
+//==============================================================================
+MemoryGovernor::~MemoryGovernor()
+{
+    stopTimer();
+}
+
+//==============================================================================
+void MemoryGovernor::addClient(Client *client)
+{
+    const ScopedLock sl(lock);
+    clients.addIfNotAlreadyThere(client);
+    if ( ! isTimerRunning())
+        startTimer(kCheckIntervalMs);
+}
+
+//==============================================================================
+void MemoryGovernor::removeClient(Client *client)
+{
+    const ScopedLock sl(lock);
+    clients.removeFirstMatchingValue(client);
+    if (clients.size() == 0)
+        stopTimer();
+}
+
+//==============================================================================
+void MemoryGovernor::timerCallback()
+{
+    const ScopedLock sl(lock);
+    const int64 maxBytes = budget.get();
+
+    // note caches are limited only while there is a budget, they are left alone otherwise
+    if (maxBytes == 0)
+    {
+        if (limited)
+            for (Client *client : clients)
+                client->setNoteCacheBudget(-1);
+        limited = false;
+        return;
+    }
+    limited = true;
+
+    struct Usage
+    {
+        Client *client;
+        int64 bankBytes;
+        int64 noteBytes;
+        uint32 age;             // Milliseconds since the instance was active
+        bool playing;
+    };
+
+    const uint32 now = Time::getMillisecondCounter();
+    std::vector<Usage> usages;
+    int64 bankBytes = 0;
+    for (Client *client : clients)
+    {
+        const uint32 lastActive = client->getLastActiveMs();
+        const Usage usage = { client, client->getBankBytes(), client->getNoteCacheBytes(),
+                              lastActive != 0 ? now - lastActive : std::numeric_limits<uint32>::max(),
+                              client->isPlaying() };
+        usages.push_back(usage);
+        bankBytes += usage.bankBytes;
+    }
+
+    // most recently active instances first, playing ones before all idle ones
+    std::sort(usages.begin(), usages.end(), [](const Usage &a, const Usage &b)
+              { return a.playing != b.playing ? a.playing : a.age < b.age; });
+
+    // rendered notes get what banks leave, the instance active most recently may grow its
+    // cache into all of it, the ones after it get what the caches before them leave
+    int64 available = maxBytes - bankBytes;
+    for (const Usage &usage : usages)
+    {
+        const int64 share = jmax((int64) 0, available);
+        usage.client->setNoteCacheBudget(share);
+        available -= jmin(usage.noteBytes, share);
+    }
+
+    // banks above the budget are mapped from files, idle instances active least recently first
+    for (auto it = usages.rbegin(); it != usages.rend() && bankBytes > maxBytes; ++it)
+    {
+        if (it->playing || it->bankBytes == 0)
+            continue;
+
+        it->client->hibernateBanks();
+        bankBytes -= it->bankBytes - it->client->getBankBytes();
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef MEMORY_GOVERNOR_H_INCLUDED
+#define MEMORY_GOVERNOR_H_INCLUDED
+
+#include "JuceHeader.h"
+
+/**
+ Process-wide budget of the memory partial banks and rendered notes (see NoteRenderCache) of
+ all plugin instances take, shared through SharedResourcePointer. Sessions with more instances
+ than the memory of the machine holds degrade to reading banks from disk instead of swapping or
+ being killed.
+
+ Every kCheckIntervalMs the governor adds up the memory instances report. Banks come first, they
+ are needed to play: rendered notes get what the banks leave of the budget, the instance active
+ most recently first, so the caches of the instances active least recently are dropped first.
+ If the banks alone are above the budget, idle instances are hibernated, least recently active
+ first (see LorisSynthesiser::hibernate()): their banks are mapped from the analysis cache, the
+ system reads their pages as voices play them and drops them when memory is short.
+
+ Banks shared by instances (see AnalysisRegistry) are counted by each of them, so the budget
+ errs on the safe side.
+ */
+class MemoryGovernor : private Timer
+{
+public:
+    /** Plugin instance whose memory is governed. Its methods are called from the message
+        thread, while the governor is locked. */
+    class Client
+    {
+    public:
+        virtual ~Client() {}
+
+        /** Return memory taken by partials and by banks which are not mapped from files. */
+        virtual int64 getBankBytes() const = 0;
+
+        /** Return memory taken by rendered notes. */
+        virtual int64 getNoteCacheBytes() const = 0;
+
+        /** Return the millisecond counter of the last block the instance played anything in,
+            0 if it has not played. */
+        virtual uint32 getLastActiveMs() const = 0;
+
+        /** Is the instance playing? It is never hibernated then. */
+        virtual bool isPlaying() const = 0;
+
+        /** Limit memory of rendered notes to the share of the budget, -1 for no limit. */
+        virtual void setNoteCacheBudget(int64 bytes) = 0;
+
+        /** Map banks from files and compress partials, see LorisSynthesiser::hibernate(). */
+        virtual void hibernateBanks() = 0;
+    };
+
+    enum { kCheckIntervalMs = 1000 };   // Memory of instances is added up this often
+
+    MemoryGovernor();
+    ~MemoryGovernor();
+
+    /** Govern memory of an instance from now on. Do not call it from the audio thread. */
+    void addClient(Client *client);
+
+    /** Stop governing memory of an instance, it is not called any more once this returns. Do not
+        call it from the audio thread. */
+    void removeClient(Client *client);
+
+    /** Set memory all instances may take, 0 for no limit (default). The last instance setting it
+        wins. Safe to call from any thread, it is applied at the next check. */
+    void setBudget(int64 bytes) noexcept { budget = jmax((int64) 0, bytes); }
+
+    /** Return memory all instances may take, 0 for no limit. */
+    int64 getBudget() const noexcept { return budget.get(); }
+
+private:
+    void timerCallback() override;
+
+    Array<Client *> clients;
+    Atomic<int64> budget;
+    bool limited = false;       // Were note caches limited by the last check?
+    CriticalSection lock;       // Guards clients
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MemoryGovernor)
+};
+
+#endif  // MEMORY_GOVERNOR_H_INCLUDED
@@ -0,0 +1,278 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "NoteRenderCache.h"
+#include "LorisTrace.h"
+#include "ScopedNoDenormals.h"
+#include "RealTimeSynthesizer.h"
+
+//==============================================================================
+size_t NoteRenderCache::Note::getBytes() const noexcept
+{
+    size_t size = sizeof(Note);
+    for (int c = 0; c < Loris::PartialStruct::NumChannels; c++)
+        size += samples[c].capacity() * sizeof(float);
+    return size;
+}
+
+//==============================================================================
+NoteRenderCache::NoteRenderCache() : Thread("Paraphrasis note cache")
+{
+    enabled = 0;
+    maxBytes = 0;
+    budgetBytes = -1;
+    bytes = 0;
+    clock = 0;
+}
+
+//==============================================================================
+NoteRenderCache::~NoteRenderCache()
+{
+    stopThread(-1);
+
+    // voices are not rendered any more, notes they may still point to are freed too
+    for (int i = 0; i < kMaxZones * kNumNotes; i++)
+        delete slots[i].note.exchange(nullptr);
+    for (size_t i = 0; i < retired.size(); i++)
+        delete retired[i].note;
+}
+
+//==============================================================================
+void NoteRenderCache::setEnabled(bool enable)
+{
+    enabled = enable ? 1 : 0;
+
+    // notes are dropped by the thread once voices release them, it is left running
+    if (enable && ! isThreadRunning())
+        startThread(3);
+}
+
+//==============================================================================
+void NoteRenderCache::setBank(int zone, Loris::PartialBank::Ptr bank)
+{
+    if (zone < 0 || zone >= kMaxZones)
+        return;
+
+    const ScopedLock sl(banksLock);
+    banks[zone] = bank;
+}
+
+//==============================================================================
+const NoteRenderCache::Note *NoteRenderCache::acquire(int zone, int noteNumber, const Loris::PartialBank *bank) noexcept
+{
+    if (zone < 0 || zone >= kMaxZones || noteNumber < 0 || noteNumber >= kNumNotes)
+        return nullptr;
+
+    // users are counted before the note is read, so the thread never frees a note
+    // which was read (see freeRetired())
+    Slot &slot = slots[zone * kNumNotes + noteNumber];
+    slot.lastUsed = ++clock;
+    ++slot.users;
+    const Note *note = slot.note.get();
+    if (note != nullptr && note->bank.get() == bank)
+        return note;
+
+    --slot.users;
+    slot.requested = 1;
+    return nullptr;
+}
+
+//==============================================================================
+void NoteRenderCache::release(const Note *note) noexcept
+{
+    if (note != nullptr)
+        --slots[note->zone * kNumNotes + note->noteNumber].users;
+}
+
+//==============================================================================
+void NoteRenderCache::run()
+{
+    const ScopedNoDenormals noDenormals;
+    
+    while ( ! threadShouldExit())
+    {
+        freeRetired();
+        dropNotes();
+
+        for (int zone = 0; zone < kMaxZones && isEnabled() && ! threadShouldExit(); zone++)
+        {
+            Loris::PartialBank::Ptr bank;
+            {
+                const ScopedLock sl(banksLock);
+                bank = banks[zone];
+            }
+
+            for (int noteNumber = 0; noteNumber < kNumNotes && ! threadShouldExit(); noteNumber++)
+            {
+                Slot &slot = slots[zone * kNumNotes + noteNumber];
+                if (slot.requested.exchange(0) == 0 || slot.note.get() != nullptr || ! bank)
+                    continue;
+
+                Note *note = render(zone, noteNumber, bank);
+                if (note == nullptr)
+                    continue;
+
+                // bank replaced while rendering, the note is not played any more
+                {
+                    const ScopedLock sl(banksLock);
+                    if (banks[zone] != bank)
+                    {
+                        delete note;
+                        continue;
+                    }
+                }
+
+                bytes += (int64) note->getBytes();
+                slot.note = note;
+                dropNotes();
+            }
+        }
+
+        wait(kPollIntervalMs);
+    }
+}
+
+//==============================================================================
+NoteRenderCache::Note *NoteRenderCache::render(int zone, int noteNumber, Loris::PartialBank::Ptr bank)
+{
+    LORIS_TRACE_ZONE("NoteRenderCache::render");
+
+    // played as a voice plays it, but at gain 1 and with all partials like an offline bounce
+    std::vector<float> unused;
+    Loris::RealTimeSynthesizer synth(unused);
+    if (bank->sampleRate() > 0)
+        synth.setSampleRate(bank->sampleRate());
+    synth.setup(bank);
+    synth.reset();
+    synth.setPitch(MidiMessage::getMidiNoteInHertz(noteNumber));
+    synth.setLooping(true);
+
+    // partials end at the duration of the bank, fades are within a second after it
+    const int64 maxSamples = (int64) ((synth.duration() + 1.) * bank->sampleRate());
+    if (maxSamples <= 0 || maxSamples * Loris::PartialStruct::NumChannels * (int64) sizeof(float) > getLimit())
+        return nullptr;
+
+    ScopedPointer<Note> note(new Note());
+    note->bank = bank;
+    note->zone = zone;
+    note->noteNumber = noteNumber;
+    note->numSamples = 0;
+    note->channels = 0;
+    for (int c = 0; c < Loris::PartialStruct::NumChannels; c++)
+        note->samples[c].assign((size_t) maxSamples, 0.f);
+
+    while ( ! synth.isFinished() && note->numSamples < maxSamples)
+    {
+        if (threadShouldExit())
+            return nullptr;
+
+        const int blockSize = (int) jmin((int64) kRenderBlockSize, maxSamples - note->numSamples);
+        float *outputs[Loris::PartialStruct::NumChannels];
+        for (int c = 0; c < Loris::PartialStruct::NumChannels; c++)
+            outputs[c] = note->samples[c].data() + note->numSamples;
+
+        synth.synthesizeNext(outputs, blockSize);
+        note->channels |= synth.writtenChannels();
+        note->numSamples += blockSize;
+    }
+
+    // channels no partial plays take no memory
+    for (int c = 0; c < Loris::PartialStruct::NumChannels; c++)
+    {
+        if ((note->channels & (1 << c)) != 0)
+        {
+            note->samples[c].resize((size_t) note->numSamples);
+            note->samples[c].shrink_to_fit();
+        }
+        else
+            std::vector<float>().swap(note->samples[c]);
+    }
+
+    return note.release();
+}
+
+//==============================================================================
+void NoteRenderCache::dropNotes()
+{
+    Loris::PartialBank::Ptr playedBanks[kMaxZones];
+    {
+        const ScopedLock sl(banksLock);
+        for (int zone = 0; zone < kMaxZones; zone++)
+            playedBanks[zone] = banks[zone];
+    }
+
+    for (int i = 0; i < kMaxZones * kNumNotes; i++)
+    {
+        const Note *note = slots[i].note.get();
+        if (note != nullptr && ( ! isEnabled() || note->bank != playedBanks[i / kNumNotes]))
+            retire(slots[i]);
+    }
+
+    // notes played least recently first, retired notes count until voices release them
+    while (bytes.get() > getLimit())
+    {
+        Slot *oldest = nullptr;
+        int oldestAge = -1;
+        for (int i = 0; i < kMaxZones * kNumNotes; i++)
+        {
+            const int age = clock.get() - slots[i].lastUsed.get();
+            if (slots[i].note.get() != nullptr && age > oldestAge)
+            {
+                oldest = &slots[i];
+                oldestAge = age;
+            }
+        }
+
+        if (oldest == nullptr)
+            break;
+        retire(*oldest);
+        freeRetired();
+    }
+}
+
+//==============================================================================
+void NoteRenderCache::retire(Slot &slot)
+{
+    Note *note = slot.note.exchange(nullptr);
+    if (note != nullptr)
+    {
+        Retired r = { note, &slot };
+        retired.push_back(r);
+    }
+}
+
+//==============================================================================
+void NoteRenderCache::freeRetired()
+{
+    // a voice acquiring the slot after it was unpublished does not find the note, so
+    // no user of the slot means no voice plays it
+    for (size_t i = retired.size(); i-- > 0;)
+    {
+        if (retired[i].slot->users.get() != 0)
+            continue;
+
+        bytes -= (int64) retired[i].note->getBytes();
+        delete retired[i].note;
+        retired.erase(retired.begin() + (long) i);
+    }
+}
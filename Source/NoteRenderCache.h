@@ -0,0 +1,163 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef NOTE_RENDER_CACHE_H_INCLUDED
+#define NOTE_RENDER_CACHE_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include "PartialBank.h"
+
+#include <vector>
+
+/**
+ Notes rendered once and played from memory afterwards ("freeze per key"). A note of a bank
+ without modulation is the same every time it is played: the partials are fixed, the pitch
+ of the note only scales their frequencies and the velocity is a gain. Voices ask for a note
+ when they start it (see acquire()), a background thread renders it at full quality, like an
+ offline bounce (no partial budget), and later notes of the key play the rendered samples.
+ Until then, and for notes with modulation, voices synthesise live.
+
+ Rendered notes take at most the size given to setMaxBytes(), the least recently played ones
+ are dropped. The audio thread never allocates, locks or frees: notes are published by
+ atomic pointers, a note dropped while voices play it is freed by the thread once they
+ release it.
+ */
+class NoteRenderCache : private Thread
+{
+public:
+    enum
+    {
+        kMaxZones = 16,         // Key zones, as LorisVoice::kMaxZones
+        kNumNotes = 128,        // MIDI notes of each zone
+        kPollIntervalMs = 20,   // Voices ask for notes by flags, the thread checks them this often
+        kRenderBlockSize = 1024 // Samples the thread renders at once
+    };
+
+    /** Samples of a rendered note, at gain 1 and at the sample rate of its bank. */
+    struct Note
+    {
+        Loris::PartialBank::Ptr bank;   // Bank it was rendered from
+        int zone;
+        int noteNumber;
+        int numSamples;
+        int channels;                   // Bit 1 << channel for each Loris::PartialStruct::Channel rendered
+        std::vector<float> samples[Loris::PartialStruct::NumChannels]; // Empty for channels not rendered
+
+        /** Return memory taken by the samples. */
+        size_t getBytes() const noexcept;
+    };
+
+    NoteRenderCache();
+    ~NoteRenderCache();
+
+    /** Start rendering notes asked for, or stop and drop all of them. Do not call it from the
+        audio thread, the rendering thread is started and stopped here. */
+    void setEnabled(bool enabled);
+
+    /** Return true if notes are rendered and played from memory. */
+    bool isEnabled() const noexcept { return enabled.get() != 0; }
+
+    /** Set the memory rendered notes may take, least recently played ones are dropped beyond
+        it. Safe to call from any thread. */
+    void setMaxBytes(int64 bytes) noexcept { maxBytes = jmax((int64) 0, bytes); }
+
+    /** Set the share of the process-wide memory budget rendered notes may take, -1 for none
+        (default), see MemoryGovernor. Notes are dropped beyond the lower of it and the size
+        given to setMaxBytes(). Safe to call from any thread. */
+    void setBudgetBytes(int64 bytes) noexcept { budgetBytes = bytes; }
+
+    /** Set the bank notes of a zone are rendered from, notes of other banks are dropped. Do
+        not call it from the audio thread.
+        @param zone index of the key zone
+        @param bank bank voices play in the zone, empty for none */
+    void setBank(int zone, Loris::PartialBank::Ptr bank);
+
+    /** Return the rendered note of a key, or nullptr if it is not rendered from the bank yet,
+        then it is rendered in background. A note returned is kept until it is given to
+        release(), call it for every note returned. Called from the audio thread, nothing is
+        allocated nor locked.
+        @param zone index of the key zone
+        @param noteNumber MIDI note
+        @param bank bank of the voice, notes of other banks are not returned */
+    const Note *acquire(int zone, int noteNumber, const Loris::PartialBank *bank) noexcept;
+
+    /** Stop playing a note returned by acquire(). Called from the audio thread. */
+    void release(const Note *note) noexcept;
+
+    /** Return memory taken by rendered notes, including the ones dropped but still played. */
+    int64 getBytes() const noexcept { return bytes.get(); }
+
+private:
+    /** Key of a zone, the audio thread asks for its note and plays it by atomic state. */
+    struct Slot
+    {
+        Atomic<Note *> note;        // Published by the thread
+        Atomic<int> users;          // Voices playing a note of the slot (also a dropped one)
+        Atomic<int> requested;      // Set by voices which did not find the note
+        Atomic<int> lastUsed;       // Value of clock when it was acquired last
+    };
+
+    /** Note dropped while it may be played, freed when no voice uses its slot. */
+    struct Retired
+    {
+        Note *note;
+        Slot *slot;
+    };
+
+    void run() override;
+
+    /** Render note of a key from the bank of its zone, nullptr if the thread should exit or
+        the note is longer than the cache. */
+    Note *render(int zone, int noteNumber, Loris::PartialBank::Ptr bank);
+
+    /** Drop notes of banks which are not played any more, least recently used ones beyond
+        maxBytes and all of them when the cache is disabled. */
+    void dropNotes();
+
+    /** Unpublish note of a slot, it is freed once no voice plays it. */
+    void retire(Slot &slot);
+
+    /** Free retired notes no voice plays. */
+    void freeRetired();
+
+    /** Return the memory rendered notes may take, see setBudgetBytes(). */
+    int64 getLimit() const noexcept
+    {
+        const int64 budget = budgetBytes.get();
+        return budget >= 0 ? jmin(budget, maxBytes.get()) : maxBytes.get();
+    }
+
+    Slot slots[kMaxZones * kNumNotes];
+    Loris::PartialBank::Ptr banks[kMaxZones];   // Guarded by banksLock
+    CriticalSection banksLock;
+    std::vector<Retired> retired;               // Accessed by the thread only
+    Atomic<int> enabled;
+    Atomic<int64> maxBytes;
+    Atomic<int64> budgetBytes;                  // Share of MemoryGovernor budget, -1 for none
+    Atomic<int64> bytes;
+    Atomic<int> clock;                          // Advanced by every acquire(), orders slots by use
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoteRenderCache)
+};
+
+#endif  // NOTE_RENDER_CACHE_H_INCLUDED
@@ -34,14 +34,281 @@ static const  int kParameterFrequencyResolution_minValue = 30;
 static const  int kParameterFrequencyResolution_maxValue = 10000;
 static const  int kParameterFrequencyResolution_defaultValue = 40;
 
+static const char* kParameterPartialThreshold_name = "Partial Threshold";// quieter partials are not synthesised
+static const  int kParameterPartialThreshold_minValue = -120;
+static const  int kParameterPartialThreshold_maxValue = -30;
+static const  int kParameterPartialThreshold_defaultValue = -90;
+
 static const char* kParameterReverse_name = "Reverse";
 static const  bool kParameterReverse_defaultValue = false;
 
+static const char* kParameterStereoDownmix_name = "Stereo Downmix";// max, mid, left, right, stereo or mid/side, see SampleAnalyzer::Downmix
+static const  int kParameterStereoDownmix_minValue = 0;
+static const  int kParameterStereoDownmix_maxValue = 5;
+static const  int kParameterStereoDownmix_defaultValue = 0;
+
+static const char* kParameterEmbedPartials_name = "Embed Partials";// store analysed data in plugin state
+static const  bool kParameterEmbedPartials_defaultValue = false;
+
 static const double kDefaultPitchResolutionRation = 0.8;
 
 static const char* kParameterLastSamplePath_name = "Last Sample Path";
+static const char* kParameterMorphTargetPath_name = "Morph Target Path";// sample the breath controller morphs to, none if empty
+
+static const char* kParameterPolyphony_name = "Polyphony";// number of voices, created only when needed
+static const  int kParameterPolyphony_minValue = 1;
+static const  int kParameterPolyphony_maxValue = 32;
+static const  int kParameterPolyphony_defaultValue = 16;
+
+static const char* kParameterPlaybackSpeed_name = "Playback Speed";// partials are stretched when synthesised, pitch is kept
+static const  double kParameterPlaybackSpeed_minValue = 0.25;
+static const  double kParameterPlaybackSpeed_maxValue = 4.;
+static const  double kParameterPlaybackSpeed_defaultValue = 1.;
+
+static const char* kParameterStartPosition_name = "Start Position";// part of the sound notes start at
+static const  double kParameterStartPosition_minValue = 0.;
+static const  double kParameterStartPosition_maxValue = 1.;
+static const  double kParameterStartPosition_defaultValue = 0.;
+
+static const char* kParameterKeyZones_name = "Key Zones";// a zone per line: lowest and highest MIDI note, root pitch
+                                                         // in Hz and sample path, other keys play the sample
+
+static const char* kParameterLoopStart_name = "Loop Start";// seconds, loop markers of the sample are used
+static const char* kParameterLoopEnd_name = "Loop End";    // unless end is after start
+static const  double kParameterLoop_minValue = 0.;
+static const  double kParameterLoop_maxValue = 60.;
+static const  double kParameterLoop_defaultValue = 0.;
+
+static const char* kParameterFreezeNotes_name = "Freeze Notes";// notes without modulation are rendered once and
+static const  bool kParameterFreezeNotes_defaultValue = false; // played from memory, see NoteRenderCache
+
+static const char* kParameterNoteCacheSize_name = "Note Cache Size";// megabytes of notes rendered by Freeze Notes
+static const  int kParameterNoteCacheSize_minValue = 16;
+static const  int kParameterNoteCacheSize_maxValue = 4096;
+static const  int kParameterNoteCacheSize_defaultValue = 256;
+
+static const char* kParameterNoiseLevel_name = "Noise Level";// gain of the residual of the analysis played as filtered
+static const  double kParameterNoiseLevel_minValue = 0.;      // noise bands, 0 plays partials only
+static const  double kParameterNoiseLevel_maxValue = 2.;
+static const  double kParameterNoiseLevel_defaultValue = 0.;
+
+static const char* kParameterAnalysisCeiling_name = "Analysis Ceiling";// Hz, samples of higher rates are decimated
+static const  int kParameterAnalysisCeiling_minValue = 0;              // before analysis keeping partials below it,
+static const  int kParameterAnalysisCeiling_maxValue = 24000;          // 0 analyses them at their own rate
+static const  int kParameterAnalysisCeiling_defaultValue = 0;
+
+static const char* kParameterSpectralTilt_name = "Spectral Tilt";// dB per octave above the pitch of the sample,
+static const  double kParameterSpectralTilt_minValue = -12.;      // applied while partials are synthesised
+static const  double kParameterSpectralTilt_maxValue = 12.;
+static const  double kParameterSpectralTilt_defaultValue = 0.;
+
+static const char* kParameterSpectralStretch_name = "Spectral Stretch";// frequencies of all partials are scaled by it
+static const  double kParameterSpectralStretch_minValue = 0.5;
+static const  double kParameterSpectralStretch_maxValue = 2.;
+static const  double kParameterSpectralStretch_defaultValue = 1.;
+
+static const char* kParameterNoiseRatio_name = "Noise Ratio";// scales noise to sine energy ratio of the partials
+static const  double kParameterNoiseRatio_minValue = 0.;
+static const  double kParameterNoiseRatio_maxValue = 4.;
+static const  double kParameterNoiseRatio_defaultValue = 1.;
+
+static const char* kParameterCropStart_name = "Crop Start";// seconds, partials are silent out of the crop
+static const char* kParameterCropEnd_name = "Crop End";    // unless end is after start
+static const  double kParameterCrop_minValue = 0.;
+static const  double kParameterCrop_maxValue = 60.;
+static const  double kParameterCrop_defaultValue = 0.;
+
+static const char* kParameterAnalysisStart_name = "Analysis Start";// seconds of the (reversed) sample analysed, the
+static const char* kParameterAnalysisEnd_name = "Analysis End";    // rest is not decoded, 0 end analyses it to its end,
+static const  double kParameterAnalysisRegion_minValue = 0.;       // sound and loop are timed from the start
+static const  double kParameterAnalysisRegion_maxValue = 60.;
+static const  double kParameterAnalysisRegion_defaultValue = 0.;
+
+static const char* kParameterShortWindowAbove_name = "Short Window Above";// Hz, partials above it are analysed with a
+static const  int kParameterShortWindowAbove_minValue = 0;                // window half as long, sharper in time but
+static const  int kParameterShortWindowAbove_maxValue = 20000;            // blurring close harmonics, 0 uses one
+static const  int kParameterShortWindowAbove_defaultValue = 0;            // window for all of them
+
+static const char* kParameterTransientHop_name = "Transient Hop";  // ms between frames around transients, the
+static const  double kParameterTransientHop_minValue = 0.;          // hop of the resolution is kept elsewhere,
+static const  double kParameterTransientHop_maxValue = 20.;         // 0 (or a longer one) analyses all of the
+static const  double kParameterTransientHop_defaultValue = 0.;      // sample with it
+
+static const char* kParameterRenderThreads_name = "Render Threads";// threads rendering voices in real time, the
+static const  int kParameterRenderThreads_minValue = 1;            // audio thread and workers of the pool shared
+static const  int kParameterRenderThreads_maxValue = 16;           // by all instances, offline all cores are used
+static const  int kParameterRenderThreads_defaultValue = 1;
+
+static const char* kParameterAdaptiveQuality_name = "Adaptive Quality";// blocks close to their deadline lower the
+static const  bool kParameterAdaptiveQuality_defaultValue = true;       // partial budget, kernel and noise in steps
+
+static const char* kParameterHarmonicRendering_name = "Harmonic Rendering";// partials within a few cents of their
+static const  bool kParameterHarmonicRendering_defaultValue = false;        // harmonic are rendered from one phase
+
+static const char* kParameterHarmonicAnalysis_name = "Harmonic Analysis";// only the spectrum around harmonics of the
+static const  bool kParameterHarmonicAnalysis_defaultValue = false;       // sample pitch is analysed, one partial each
+
+static const char* kParameterBankCrossfade_name = "Bank Crossfade";// ms held notes crossfade to partials of a new
+static const  double kParameterBankCrossfade_minValue = 0.;        // analysis over, 0 keeps them playing the ones
+static const  double kParameterBankCrossfade_maxValue = 500.;      // they started with
+static const  double kParameterBankCrossfade_defaultValue = 0.;
+
+static const char* kParameterHibernate_name = "Hibernate When Idle";// idle instance compresses its partials and
+static const  bool kParameterHibernate_defaultValue = false;      // plays banks mapped from the cache
+
+static const char* kParameterAnalysisCores_name = "Analysis Cores";// cores analyses of all instances may use,
+static const  int kParameterAnalysisCores_minValue = 0;            // 0 for all but one, the instance setting it
+static const  int kParameterAnalysisCores_maxValue = 64;           // last wins
+static const  int kParameterAnalysisCores_defaultValue = 0;
+
+static const char* kParameterPitchBendRange_name = "Pitch Bend Range";// semitones of full pitch wheel movement, per
+static const  double kParameterPitchBendRange_minValue = 0.;          // note with MPE (48 there)
+static const  double kParameterPitchBendRange_maxValue = 96.;
+static const  double kParameterPitchBendRange_defaultValue = 2.;
+
+static const char* kParameterPressureBrightness_name = "Pressure Brightness";// dB per octave of spectral tilt at full
+static const  double kParameterPressureBrightness_minValue = -12.;           // pressure (aftertouch) of a note
+static const  double kParameterPressureBrightness_maxValue = 12.;
+static const  double kParameterPressureBrightness_defaultValue = 0.;
+
+static const char* kParameterPressureNoise_name = "Pressure Noise";// noise level added at full pressure of a note
+static const  double kParameterPressureNoise_minValue = 0.;
+static const  double kParameterPressureNoise_maxValue = 2.;
+static const  double kParameterPressureNoise_defaultValue = 0.;
+
+static const char* kParameterTimbreBrightness_name = "Timbre Brightness";// dB per octave of spectral tilt at full
+static const  double kParameterTimbreBrightness_minValue = -12.;         // timbre (controller 74, MPE slide) of a note
+static const  double kParameterTimbreBrightness_maxValue = 12.;
+static const  double kParameterTimbreBrightness_defaultValue = 0.;
+
+static const char* kParameterTimbreNoise_name = "Timbre Noise";// noise level added at full timbre of a note
+static const  double kParameterTimbreNoise_minValue = 0.;
+static const  double kParameterTimbreNoise_maxValue = 2.;
+static const  double kParameterTimbreNoise_defaultValue = 0.;
+
+static const char* kParameterFormantFrequency_name = "Formant Frequency";// Hz of a peak of the equalizer of the
+static const  double kParameterFormantFrequency_minValue = 100.;         // partials, it stays there when notes
+static const  double kParameterFormantFrequency_maxValue = 10000.;       // are transposed
+static const  double kParameterFormantFrequency_defaultValue = 1000.;
+
+static const char* kParameterFormantGain_name = "Formant Gain";// dB of the peak, 0 for none
+static const  double kParameterFormantGain_minValue = -24.;
+static const  double kParameterFormantGain_maxValue = 24.;
+static const  double kParameterFormantGain_defaultValue = 0.;
+
+static const char* kParameterFormantWidth_name = "Formant Width";// octaves of the peak at half its gain
+static const  double kParameterFormantWidth_minValue = 0.1;
+static const  double kParameterFormantWidth_maxValue = 4.;
+static const  double kParameterFormantWidth_defaultValue = 1.;
+
+static const char* kParameterLowShelf_name = "Low Shelf";// dB of partials below kLowShelfFrequency
+static const  double kParameterLowShelf_minValue = -24.;
+static const  double kParameterLowShelf_maxValue = 24.;
+static const  double kParameterLowShelf_defaultValue = 0.;
+
+static const char* kParameterHighShelf_name = "High Shelf";// dB of partials above kHighShelfFrequency
+static const  double kParameterHighShelf_minValue = -24.;
+static const  double kParameterHighShelf_maxValue = 24.;
+static const  double kParameterHighShelf_defaultValue = 0.;
+
+static const char* kParameterMultiRate_name = "Multi-Rate Rendering";// low partials are computed at a half or
+static const  bool kParameterMultiRate_defaultValue = true;           // a quarter of the sample rate
+
+static const char* kParameterLiveInput_name = "Live Input";// input is analysed and resynthesised as it plays,
+static const  bool kParameterLiveInput_defaultValue = false;  // delayed by the latency of the analysis
+
+static const char* kParameterMemoryBudget_name = "Memory Budget";// MB banks and rendered notes of all instances
+static const  int kParameterMemoryBudget_minValue = 0;            // may take, 0 for no limit, the instance
+static const  int kParameterMemoryBudget_maxValue = 262144;       // setting it last wins
+static const  int kParameterMemoryBudget_defaultValue = 0;
+
+static const char* kParameterPhaseFree_name = "Phase Free";// partials are played without their phases, from
+static const  bool kParameterPhaseFree_defaultValue = false; // scattered ones, smaller banks prepared faster
+
+static const char* kParameterSurfaceEffect_name = "Surface Effect";// partials are scaled by the spectral surface
+static const  double kParameterSurfaceEffect_minValue = 0.;          // of the morph target by this amount,
+static const  double kParameterSurfaceEffect_maxValue = 1.;          // 0 for none (cross-synthesis)
+static const  double kParameterSurfaceEffect_defaultValue = 0.;
+
+static const char* kParameterSurfaceTimeStretch_name = "Surface Time Stretch";// 2 plays the surface twice
+static const  double kParameterSurfaceTimeStretch_minValue = 0.25;              // as slowly as the sound
+static const  double kParameterSurfaceTimeStretch_maxValue = 4.;
+static const  double kParameterSurfaceTimeStretch_defaultValue = 1.;
+
+static const char* kParameterSurfaceFrequencyStretch_name = "Surface Frequency Stretch";// 2 moves the spectrum
+static const  double kParameterSurfaceFrequencyStretch_minValue = 0.5;                   // of the surface an
+static const  double kParameterSurfaceFrequencyStretch_maxValue = 2.;                    // octave up
+static const  double kParameterSurfaceFrequencyStretch_defaultValue = 1.;
+
+static const char* kParameterHarmonify_name = "Harmonify";// frequencies of partials are moved by this amount
+static const  double kParameterHarmonify_minValue = 0.;     // toward harmonics of the fundamental, 0 for none
+static const  double kParameterHarmonify_maxValue = 1.;
+static const  double kParameterHarmonify_defaultValue = 0.;
+
+// Position of each parameter in the parameter set, it has to be the order they are added in by
+// ParaphrasisAudioProcessor (it is their order in the host too). Parameters are looked up and
+// updates are dispatched by it, without strings.
+enum ParameterIndex
+{
+    kParameterSamplePitch_index = 0,
+    kParameterFrequencyResolution_index,
+    kParameterPartialThreshold_index,
+    kParameterLastSamplePath_index,
+    kParameterMorphTargetPath_index,
+    kParameterReverse_index,
+    kParameterEmbedPartials_index,
+    kParameterPolyphony_index,
+    kParameterPlaybackSpeed_index,
+    kParameterStartPosition_index,
+    kParameterLoopStart_index,
+    kParameterLoopEnd_index,
+    kParameterStereoDownmix_index,
+    kParameterKeyZones_index,
+    kParameterFreezeNotes_index,
+    kParameterNoteCacheSize_index,
+    kParameterNoiseLevel_index,
+    kParameterAnalysisCeiling_index,
+    kParameterSpectralTilt_index,
+    kParameterSpectralStretch_index,
+    kParameterNoiseRatio_index,
+    kParameterCropStart_index,
+    kParameterCropEnd_index,
+    kParameterAnalysisStart_index,
+    kParameterAnalysisEnd_index,
+    kParameterShortWindowAbove_index,
+    kParameterTransientHop_index,
+    kParameterRenderThreads_index,
+    kParameterAdaptiveQuality_index,
+    kParameterHarmonicRendering_index,
+    kParameterHarmonicAnalysis_index,
+    kParameterBankCrossfade_index,
+    kParameterHibernate_index,
+    kParameterAnalysisCores_index,
+    kParameterPitchBendRange_index,
+    kParameterPressureBrightness_index,
+    kParameterPressureNoise_index,
+    kParameterTimbreBrightness_index,
+    kParameterTimbreNoise_index,
+    kParameterFormantFrequency_index,
+    kParameterFormantGain_index,
+    kParameterFormantWidth_index,
+    kParameterLowShelf_index,
+    kParameterHighShelf_index,
+    kParameterMultiRate_index,
+    kParameterLiveInput_index,
+    kParameterMemoryBudget_index,
+    kParameterPhaseFree_index,
+    kParameterSurfaceEffect_index,
+    kParameterSurfaceTimeStretch_index,
+    kParameterSurfaceFrequencyStretch_index,
+    kParameterHarmonify_index,
+    kNumParameters
+};
+
+static const int kDefaultMaxPartialsPerVoice = 256;// CPU budget, loudest partials are rendered only
 
-static const int kDefaultSynthesiserVoiceNumbers = 16;// going to be a parameter
+static const double kLowShelfFrequency = 250.;    // Hz, middle of the slopes of the shelves of the
+static const double kHighShelfFrequency = 4000.;  // equalizer of the partials
 
 
 #endif  // PARAMETERDEFITIONS_H_INCLUDED
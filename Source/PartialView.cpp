@@ -0,0 +1,302 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "PartialView.h"
+
+#include <algorithm>
+#include <cmath>
+
+// frequencies shown, bottom and top of the view
+static const double kLowestFrequency = 20.;
+static const double kHighestFrequency = 20000.;
+
+// amplitudes shown, from transparent to the full colour
+static const double kSilentDb = -80.;
+
+//==============================================================================
+static float frequencyToY(double frequency)
+{
+    const double octaves = std::log(jmax(frequency, kLowestFrequency) / kLowestFrequency)
+                           / std::log(kHighestFrequency / kLowestFrequency);
+    return (float) ((1. - octaves) * PartialView::kTileHeight);
+}
+
+//==============================================================================
+static float amplitudeToAlpha(float amplitude)
+{
+    const double db = Decibels::gainToDecibels((double) amplitude, kSilentDb);
+    return (float) jlimit(0., 1., 1. - db / kSilentDb);
+}
+
+//==============================================================================
+PartialView::PartialView() : Thread("Paraphrasis partial view")
+{
+    startThread(3);
+}
+
+//==============================================================================
+PartialView::~PartialView()
+{
+    stopThread(-1);
+    cancelPendingUpdate();
+}
+
+//==============================================================================
+void PartialView::setBank(Loris::PartialBank::Ptr newBank)
+{
+    if (newBank == bank)
+        return;
+
+    const double newDuration = newBank ? newBank->duration() : 0;
+
+    {
+        const ScopedLock sl(tilesLock);
+        bank = newBank;
+        duration = newDuration;
+        tiles.clear();
+        requested.clearQuick();
+    }
+
+    visibleStart = 0;
+    visibleEnd = duration;
+    repaint();
+}
+
+//==============================================================================
+void PartialView::setVisibleRange(double startSeconds, double endSeconds)
+{
+    // at the finest level a tile covers the whole view at most
+    const double minSpan = duration / (1 << (kNumLevels - 1));
+    const double span = jlimit(jmin(minSpan, duration), duration, endSeconds - startSeconds);
+    visibleStart = jlimit(0., duration - span, startSeconds);
+    visibleEnd = visibleStart + span;
+    repaint();
+}
+
+//==============================================================================
+int PartialView::chooseLevel() const noexcept
+{
+    const double fraction = (visibleEnd - visibleStart) / duration;
+    int level = 0;
+    while (level < kNumLevels - 1 && kTileWidth * (double) (1 << level) * fraction < getWidth())
+        level++;
+    return level;
+}
+
+//==============================================================================
+PartialView::Tile *PartialView::findTile(int level, int index) const noexcept
+{
+    for (int i = 0; i < tiles.size(); i++)
+        if (tiles.getUnchecked(i)->level == level && tiles.getUnchecked(i)->index == index)
+            return tiles.getUnchecked(i);
+    return nullptr;
+}
+
+//==============================================================================
+void PartialView::paint(Graphics &g)
+{
+    g.fillAll(Colour(0xff141414));
+    if (duration <= 0 || getWidth() <= 0)
+        return;
+
+    const int level = chooseLevel();
+    const int numTiles = 1 << level;
+    const double tileSeconds = duration / numTiles;
+    const double pixelsPerSecond = getWidth() / (visibleEnd - visibleStart);
+    const int first = jlimit(0, numTiles - 1, (int) (visibleStart / tileSeconds));
+    const int last = jlimit(first, numTiles - 1, (int) std::ceil(visibleEnd / tileSeconds) - 1);
+    g.setImageResamplingQuality(Graphics::lowResamplingQuality);
+
+    const ScopedLock sl(tilesLock);
+    requested.clearQuick();
+    for (int index = first; index <= last; index++)
+    {
+        const int x = roundToInt((index * tileSeconds - visibleStart) * pixelsPerSecond);
+        const int width = roundToInt(((index + 1) * tileSeconds - visibleStart) * pixelsPerSecond) - x;
+
+        // the tile, or the part of the coarser tile covering it until it is rendered
+        for (int coarser = level; coarser >= 0; coarser--)
+        {
+            const int shift = level - coarser;
+            if (Tile *tile = findTile(coarser, index >> shift))
+            {
+                const int sourceWidth = kTileWidth >> shift;
+                g.drawImage(tile->image, x, 0, width, getHeight(),
+                            (index & ((1 << shift) - 1)) * sourceWidth, 0, sourceWidth, kTileHeight);
+                tile->lastDrawn = ++clock;
+                break;
+            }
+        }
+
+        if (findTile(level, index) == nullptr)
+            requested.add(((int64) level << 32) | index);
+    }
+
+    // the whole sound is rendered first, it stands in for any tile
+    if (findTile(0, 0) == nullptr)
+        requested.addIfNotAlreadyThere(0);
+    if (requested.size() > 0)
+        notify();
+}
+
+//==============================================================================
+void PartialView::mouseWheelMove(const MouseEvent &event, const MouseWheelDetails &wheel)
+{
+    if (duration <= 0)
+        return;
+
+    // zoom around the time under the mouse
+    const double span = visibleEnd - visibleStart;
+    const double mouseTime = visibleStart + span * event.x / jmax(1, getWidth());
+    const double newSpan = span * std::pow(2., -2. * wheel.deltaY);
+    const double scroll = -span * wheel.deltaX;
+    setVisibleRange(mouseTime - (mouseTime - visibleStart) * newSpan / span + scroll,
+                    mouseTime + (visibleEnd - mouseTime) * newSpan / span + scroll);
+}
+
+//==============================================================================
+void PartialView::mouseDoubleClick(const MouseEvent &)
+{
+    setVisibleRange(0, duration);
+}
+
+//==============================================================================
+void PartialView::handleAsyncUpdate()
+{
+    repaint();
+}
+
+//==============================================================================
+void PartialView::run()
+{
+    while ( ! threadShouldExit())
+    {
+        Loris::PartialBank::Ptr renderedBank;
+        double bankDuration = 0;
+        int64 key = 0;
+        {
+            const ScopedLock sl(tilesLock);
+            if (requested.size() > 0 && bank)
+            {
+                key = requested.getLast();
+                requested.removeLast();
+                renderedBank = bank;
+                bankDuration = duration;
+            }
+        }
+
+        if ( ! renderedBank)
+        {
+            wait(-1);
+            continue;
+        }
+
+        const int level = (int) (key >> 32);
+        const int index = (int) (key & 0xffffffff);
+        const Image image = renderTile(*renderedBank, bankDuration, level, index);
+        if (image.isNull())
+            continue;
+
+        {
+            const ScopedLock sl(tilesLock);
+            if (bank != renderedBank || findTile(level, index) != nullptr)
+                continue;
+
+            // the least recently drawn tiles make room, they are rendered again when needed
+            while (tiles.size() >= kMaxTiles)
+            {
+                int oldest = 0;
+                for (int i = 1; i < tiles.size(); i++)
+                    if (clock - tiles.getUnchecked(i)->lastDrawn > clock - tiles.getUnchecked(oldest)->lastDrawn)
+                        oldest = i;
+                tiles.remove(oldest);
+            }
+
+            Tile *tile = new Tile { level, index, image, clock };
+            tiles.add(tile);
+        }
+
+        triggerAsyncUpdate();
+    }
+}
+
+//==============================================================================
+Image PartialView::renderTile(const Loris::PartialBank &bank, double bankDuration, int level, int index) const
+{
+    Image image(Image::ARGB, kTileWidth, kTileHeight, true);
+    Graphics g(image);
+    const Colour colour(0xffffc860);
+
+    const double tileSeconds = bankDuration / (1 << level);
+    const double tileStart = index * tileSeconds;
+    const double pixelsPerSample = kTileWidth / (tileSeconds * bank.sampleRate());
+    const int startSample = (int) (tileStart * bank.sampleRate());
+    const Loris::BreakpointArrays breakpoints = bank.breakpoints();
+    const Loris::PartialStruct *partials = bank.partials();
+
+    for (size_t p = 0; p < bank.size(); p++)
+    {
+        if (threadShouldExit())
+            return Image();
+
+        // partials are sorted by start, the ones ending before the tile are skipped
+        const Loris::PartialStruct &partial = partials[p];
+        if (partial.startTime >= tileStart + tileSeconds)
+            break;
+        if (partial.endTime < tileStart || partial.numBreakpoints < 2)
+            continue;
+
+        // from the last breakpoint before the tile
+        const int *samples = breakpoints.samples() + partial.firstBreakpoint;
+        const int first = jmax(0, (int) (std::upper_bound(samples, samples + partial.numBreakpoints, startSample)
+                                         - samples) - 1);
+
+        float lastX = 0, lastY = 0;
+        float loudest = 0;
+        for (int i = first; i < partial.numBreakpoints; i++)
+        {
+            const int b = partial.firstBreakpoint + i;
+            const float x = (float) ((breakpoints.sample(b) - startSample) * pixelsPerSample);
+            loudest = jmax(loudest, breakpoints.amplitude(b));
+
+            // breakpoints closer than a pixel are merged, the loudest of them shows
+            if (i > first && x - lastX < 1.f && i + 1 < partial.numBreakpoints)
+                continue;
+
+            const float y = frequencyToY(breakpoints.frequency(b));
+            if (i > first)
+            {
+                g.setColour(colour.withAlpha(amplitudeToAlpha(loudest)));
+                g.drawLine(lastX, lastY, x, y);
+            }
+
+            if (x > kTileWidth)
+                break;
+            lastX = x;
+            lastY = y;
+            loudest = breakpoints.amplitude(b);
+        }
+    }
+
+    return image;
+}
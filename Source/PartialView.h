@@ -0,0 +1,106 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef PARTIAL_VIEW_H_INCLUDED
+#define PARTIAL_VIEW_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include "PartialBank.h"
+
+/**
+ View of the partials of a bank, time from left to right, logarithmic frequency from bottom
+ to top and amplitude as brightness, to judge analysis settings without listening.
+
+ The partials are never drawn on the message thread. A background thread renders them into
+ tiles of a few levels of detail, like mipmaps: level n cuts the sound into 2^n tiles of the
+ same width, and breakpoints closer than a pixel of a tile are merged. The view draws the
+ tiles of the level matching its zoom, scaled, and the coarser tile covering a tile until the
+ tile is rendered. So a repaint costs the same for a bank of ten partials and of thousands.
+ The mouse wheel zooms around the mouse, horizontal scrolling scrolls, double click shows
+ the whole sound.
+ */
+class PartialView : public Component,
+                    private Thread,
+                    private AsyncUpdater
+{
+public:
+    enum
+    {
+        kTileWidth = 256,       // Pixels of a tile in time
+        kTileHeight = 128,      // Pixels of a tile in frequency, tiles are scaled to the view
+        kNumLevels = 8,         // The finest level cuts the sound into 2^(kNumLevels - 1) tiles
+        kMaxTiles = 96          // Tiles kept, the least recently drawn ones are dropped
+    };
+
+    PartialView();
+    ~PartialView();
+
+    /** Show partials of a bank, the whole sound, nothing for an empty bank. Tiles of the
+        bank shown before are dropped. */
+    void setBank(Loris::PartialBank::Ptr bank);
+
+    /** Show the part of the sound between two times in seconds, limited to the sound. */
+    void setVisibleRange(double startSeconds, double endSeconds);
+
+    /** @internal */
+    void paint(Graphics &g) override;
+    /** @internal */
+    void mouseWheelMove(const MouseEvent &event, const MouseWheelDetails &wheel) override;
+    /** @internal */
+    void mouseDoubleClick(const MouseEvent &event) override;
+
+private:
+    /** Partials of a part of the sound rendered at a level. */
+    struct Tile
+    {
+        int level;
+        int index;
+        Image image;
+        uint32 lastDrawn;       // Value of clock when it was drawn last
+    };
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    /** Return the level whose tiles have at least a pixel per pixel of the view. */
+    int chooseLevel() const noexcept;
+
+    /** Return a rendered tile, or nullptr. tilesLock must be held. */
+    Tile *findTile(int level, int index) const noexcept;
+
+    /** Render the partials of a tile, a null image if the thread should exit. */
+    Image renderTile(const Loris::PartialBank &bank, double bankDuration, int level, int index) const;
+
+    Loris::PartialBank::Ptr bank;   // Guarded by tilesLock
+    double duration = 0;            // End of the last partial of bank, seconds, set with it
+    double visibleStart = 0;        // Part of the sound shown, seconds
+    double visibleEnd = 0;
+    OwnedArray<Tile> tiles;         // Guarded by tilesLock
+    Array<int64> requested;         // Tiles missing in the view, (level << 32) | index, the last first
+    CriticalSection tilesLock;
+    uint32 clock = 0;               // Advanced by every tile drawn, orders tiles by use
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PartialView)
+};
+
+#endif  // PARTIAL_VIEW_H_INCLUDED
@@ -0,0 +1,96 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+
+#include "PartialsCodec.h"
+
+#include "Breakpoint.h"
+#include "Partial.h"
+
+//==============================================================================
+void PartialsCodec::write(const Loris::PartialList &partials, OutputStream &stream)
+{
+    stream.writeInt(kMagic);
+    stream.writeInt((int) partials.size());
+    
+    for (const Loris::Partial &partial : partials)
+    {
+        stream.writeInt(partial.label());
+        stream.writeInt(partial.numBreakpoints());
+        
+        for (Loris::Partial::const_iterator it = partial.begin(); it != partial.end(); ++it)
+        {
+            stream.writeDouble(it.time());
+            stream.writeFloat((float) it->frequency());
+            stream.writeFloat((float) it->amplitude());
+            stream.writeFloat((float) it->bandwidth());
+            stream.writeFloat((float) it->phase());
+        }
+    }
+}
+
+//==============================================================================
+bool PartialsCodec::read(InputStream &stream, Loris::PartialList &partials)
+{
+    static const int kPartialHeaderSize = 2 * sizeof(int);
+    static const int kBreakpointSize = sizeof(double) + 4 * sizeof(float);
+    
+    if (stream.readInt() != kMagic)
+        return false;
+    
+    // every partial has at least its header, do not trust broken data
+    const int numPartials = stream.readInt();
+    if (numPartials < 0 || stream.getNumBytesRemaining() < (int64) numPartials * kPartialHeaderSize)
+        return false;
+    
+    Loris::PartialList result;
+    for (int i = 0; i < numPartials; i++)
+    {
+        if (stream.getNumBytesRemaining() < kPartialHeaderSize)
+            return false;
+        
+        const int label = stream.readInt();
+        const int numBreakpoints = stream.readInt();
+        
+        // do not trust broken data
+        if (numBreakpoints < 0 || stream.getNumBytesRemaining() < (int64) numBreakpoints * kBreakpointSize)
+            return false;
+        
+        result.push_back(Loris::Partial());
+        Loris::Partial &partial = result.back();
+        partial.setLabel(label);
+        
+        for (int j = 0; j < numBreakpoints; j++)
+        {
+            const double time = stream.readDouble();
+            const double frequency = stream.readFloat();
+            const double amplitude = stream.readFloat();
+            const double bandwidth = stream.readFloat();
+            const double phase = stream.readFloat();
+            
+            partial.insert(time, Loris::Breakpoint(frequency, amplitude, bandwidth, phase));
+        }
+    }
+    
+    partials = std::move(result);
+    return true;
+}
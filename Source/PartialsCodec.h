@@ -0,0 +1,48 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef PARTIALS_CODEC_H_INCLUDED
+#define PARTIALS_CODEC_H_INCLUDED
+
+#include "JuceHeader.h"
+#include "PartialList.h"
+
+/**
+ Compact binary encoding of Loris::PartialList, used to store analysed partials in plugin
+ state. Each partial is its label and breakpoints, each breakpoint is its time (double) and
+ frequency, amplitude, bandwidth and phase (floats). Numbers are little endian.
+ */
+class PartialsCodec
+{
+public:
+    /** Write partials to stream. */
+    static void write(const Loris::PartialList &partials, OutputStream &stream);
+    
+    /** Read partials from stream.
+        @return true if partials were read, false if data are not valid (partials are not changed then). */
+    static bool read(InputStream &stream, Loris::PartialList &partials);
+    
+private:
+    static const int kMagic   = 0x50504c31; // "PPL1"
+};
+
+#endif  // PARTIALS_CODEC_H_INCLUDED
@@ -43,12 +43,15 @@
 #include "Resources.h"
 #include "SampleAnalyzer.h"
 #include "ParameterDefitions.h"
+#include "AudioThreadAllocations.h"
 //[/Headers]
 
 #include "PluginEditor.h"
 
 
 //[MiscUserDefs] You can add your own user definitions and misc code here...
+// render time of a sample of a playing partial assumed until one is measured, ns
+static const float kDefaultPartialSampleNs = 10.f;
 
 //[/MiscUserDefs]
 
@@ -167,26 +170,82 @@ ParaphrasisAudioProcessorEditor::ParaphrasisAudioProcessorEditor (ParaphrasisAud
                               Image(), 1.000f, Colour (0x00000000),
                               ImageCache::getFromMemory (Resources::button_analyze_down_png, Resources::button_analyze_down_pngSize), 1.000f, Colour (0x00000000));
     reverseBtn->setClickingTogglesState(true);
-    reverseBtn->setToggleState(parameters[kParameterReverse_name]->getValue(), juce::dontSendNotification);
+    reverseBtn->setToggleState(parameters[kParameterReverse_index]->getValue(), juce::dontSendNotification);
 
     // register this as parameter observer
-    parameters.get(kParameterSamplePitch_name)->addObserver(this);
-    parameters.get(kParameterFrequencyResolution_name)->addObserver(this);
-    parameters.get(kParameterReverse_name)->addObserver(this);
+    parameters[kParameterSamplePitch_index]->addObserver(this);
+    parameters[kParameterFrequencyResolution_index]->addObserver(this);
+    parameters[kParameterReverse_index]->addObserver(this);
 
     // set last values
-    onParameterUpdated(parameters.get(kParameterFrequencyResolution_name));
-    onParameterUpdated(parameters.get(kParameterSamplePitch_name));
-    onParameterUpdated(parameters.get(kParameterLastSamplePath_name));
+    refreshParameters((1 << kParameterFrequencyResolution_index) | (1 << kParameterSamplePitch_index)
+                      | (1 << kParameterLastSamplePath_index));
 
     // set default LED state
     ledBtn->setClickingTogglesState(false);
     ParaphrasisAudioProcessor *processor = dynamic_cast<ParaphrasisAudioProcessor *>(getProcessor());
     if (processor)
-        lightOn(processor->isReady());
+        lightOn(processor->isReady() && ! processor->isAnalyzing());
+
+    // render statistics are measured by the processor only while they are shown
+    addAndMakeVisible (renderStatsLbl = new Label ("renderStatsLbl", String::empty));
+    renderStatsLbl->setFont (Font (11.00f, Font::plain));
+    renderStatsLbl->setJustificationType (Justification::centred);
+    renderStatsLbl->setColour (Label::textColourId, Colour (0x99000000));
+    if (processor)
+        processor->setRenderStatsEnabled(true);
+
+    // statistics of the partial bank, with load estimated by the render time measured last
+    addAndMakeVisible (bankStatsLbl = new Label ("bankStatsLbl", String::empty));
+    bankStatsLbl->setFont (Font (10.00f, Font::plain));
+    bankStatsLbl->setJustificationType (Justification::centredRight);
+    bankStatsLbl->setColour (Label::textColourId, Colour (0x99000000));
+    partialSampleNs = kDefaultPartialSampleNs;
+    updateBankStats();
+
+    // overview of the sample, cached by its analysis
+    addAndMakeVisible (waveformView = new WaveformView (formatManager));
+    waveformView->setOverview (getProcessor()->getOverviewHash());
+
+    // progress of the analysis of the sample, shown while it runs
+    addChildComponent (analysisBar = new ProgressBar (analysisProgress));
+
+    // partials of the bank, rendered in background as the bank changes
+    addAndMakeVisible (partialView = new PartialView());
+    partialView->setBank (getProcessor()->getBank());
+
+    // output and voices published by the audio thread while the editor is open
+   #if JUCE_MAC || JUCE_IOS || DROWAUDIO_USE_FFTREAL
+    addAndMakeVisible (spectroscope = new drow::Spectroscope (kScopeFFTSizeLog2));
+    spectroscope->setLogFrequencyDisplay (true);
+    scopeThread = new TimeSliceThread ("Paraphrasis scope");
+    scopeThread->addTimeSliceClient (spectroscope);
+    scopeThread->startThread (1);
+   #endif
+    addAndMakeVisible (voiceMeter = new VoiceMeter());
+    getProcessor()->setScopeEnabled(true);
+
+    // banks analysed before, browsed over the controls
+    addAndMakeVisible (libraryBtn = new TextButton ("libraryBtn"));
+    libraryBtn->setButtonText ("Library");
+    libraryBtn->setClickingTogglesState (true);
+    libraryBtn->addListener (this);
+    addChildComponent (bankBrowser = new BankBrowser (*this));
+
+    // analysis exported to a file in background, with its progress over the bank statistics
+    addAndMakeVisible (exportBtn = new TextButton ("exportBtn"));
+    exportBtn->setButtonText ("Export");
+    exportBtn->setTooltip ("Export the analysis played, as a bank or as SDIF partials");
+    exportBtn->addListener (this);
+    exporter = new AnalysisExporter (*this);
+    addChildComponent (exportBar = new ProgressBar (exportProgress));
+
+    startTimer(kStatsTimer, kStatsIntervalMs);
+    startTimer(kParametersTimer, kParametersIntervalMs);
+    startTimer(kScopeTimer, kScopeIntervalMs);
     //[/UserPreSize]
 
-    setSize (300, 300);
+    setSize (300, 450);
 
 
     //[Constructor] You can add your own custom stuff here..
@@ -197,9 +256,31 @@ ParaphrasisAudioProcessorEditor::~ParaphrasisAudioProcessorEditor()
 {
     //[Destructor_pre]. You can add your own custom destruction code here..
     // unregister observers
-    parameters.get(kParameterSamplePitch_name)->removeObserver(this);
-    parameters.get(kParameterFrequencyResolution_name)->removeObserver(this);
-    parameters.get(kParameterReverse_name)->removeObserver(this);
+    parameters[kParameterSamplePitch_index]->removeObserver(this);
+    parameters[kParameterFrequencyResolution_index]->removeObserver(this);
+    parameters[kParameterReverse_index]->removeObserver(this);
+
+    stopTimer(kStatsTimer);
+    stopTimer(kParametersTimer);
+    stopTimer(kScopeTimer);
+    getProcessor()->setRenderStatsEnabled(false);
+    getProcessor()->setScopeEnabled(false);
+   #if JUCE_MAC || JUCE_IOS || DROWAUDIO_USE_FFTREAL
+    scopeThread->removeTimeSliceClient (spectroscope);
+    scopeThread = nullptr;
+    spectroscope = nullptr;
+   #endif
+    voiceMeter = nullptr;
+    renderStatsLbl = nullptr;
+    bankStatsLbl = nullptr;
+    bankBrowser = nullptr;
+    libraryBtn = nullptr;
+    exporter = nullptr;
+    exportBtn = nullptr;
+    exportBar = nullptr;
+    waveformView = nullptr;
+    analysisBar = nullptr;
+    partialView = nullptr;
     //[/Destructor_pre]
 
     knob = nullptr;
@@ -248,12 +329,37 @@ void ParaphrasisAudioProcessorEditor::resized()
     ledBtn->setBounds (240, 240, 24, 24);
     reverseBtn->setBounds (23, 238, 88, 30);
     //[UserResized] Add your own custom resize handling here..
+    renderStatsLbl->setBounds (8, 281, 284, 16);
+    bankStatsLbl->setBounds (152, 100, 130, 14);
+    waveformView->setBounds (24, 72, 258, 26);
+    analysisBar->setBounds (24, 72, 258, 14);
+    partialView->setBounds (8, 304, 284, 68);
+    libraryBtn->setBounds (24, 100, 64, 14);
+    exportBtn->setBounds (92, 100, 56, 14);
+    exportBar->setBounds (152, 100, 130, 14);
+    bankBrowser->setBounds (8, 118, 284, 182);
+   #if JUCE_MAC || JUCE_IOS || DROWAUDIO_USE_FFTREAL
+    spectroscope->setBounds (8, 376, 200, 68);
+    voiceMeter->setBounds (212, 376, 80, 68);
+   #else
+    voiceMeter->setBounds (8, 376, 284, 68);
+   #endif
     //[/UserResized]
 }
 
 void ParaphrasisAudioProcessorEditor::buttonClicked (Button* buttonThatWasClicked)
 {
     //[UserbuttonClicked_Pre]
+    if (buttonThatWasClicked == libraryBtn)
+    {
+        bankBrowser->setVisible (libraryBtn->getToggleState());
+        return;
+    }
+    if (buttonThatWasClicked == exportBtn)
+    {
+        exportBank();
+        return;
+    }
     //[/UserbuttonClicked_Pre]
 
     if (buttonThatWasClicked == selectBtn)
@@ -263,7 +369,7 @@ void ParaphrasisAudioProcessorEditor::buttonClicked (Button* buttonThatWasClicke
         File lastFile;
 
         // load last location
-        String filePath = parameters.get(kParameterLastSamplePath_name)->getDisplayText();
+        String filePath = parameters[kParameterLastSamplePath_index]->getDisplayText();
         if ( filePath.isEmpty() )
             lastFile = File::getSpecialLocation (File::userHomeDirectory);
         else
@@ -279,26 +385,13 @@ void ParaphrasisAudioProcessorEditor::buttonClicked (Button* buttonThatWasClicke
             File sampleFile (myChooser.getResult());
             if ( sampleFile.exists() )
             {
+                // pitch is detected by the analysis in background, it sets pitch and resolution
+                getProcessor()->detectPitchOf(sampleFile.getFullPathName());
+
                 // set parameter
                 sampleLbl->setText(sampleFile.getFileName(), juce::dontSendNotification);
                 path = sampleFile.getFullPathName().toRawUTF8();
-                parameters.setData(kParameterLastSamplePath_name, path.c_str(), path.length());
-
-                // dectect pitch
-                AudioFormatReader* reader = formatManager.createReaderFor(sampleFile);
-                if (reader)
-                {
-                    detector.setSampleRate(reader->sampleRate);
-                    AudioSampleBuffer buffer(reader->numChannels, reader->lengthInSamples);
-                    reader->read(&buffer, 0, reader->lengthInSamples, 0, true, true);
-                    double pitch = detector.detectPitch(buffer.getWritePointer(0), reader->lengthInSamples);
-
-                    parameters.set(kParameterSamplePitch_name, pitch);
-                    parameters.set(kParameterFrequencyResolution_name, kDefaultPitchResolutionRation * pitch);
-
-                    delete reader;
-                }
-
+                parameters.setData(kParameterLastSamplePath_index, path.c_str(), path.length());
             }
 
         }
@@ -314,7 +407,7 @@ void ParaphrasisAudioProcessorEditor::buttonClicked (Button* buttonThatWasClicke
     {
         //[UserButtonCode_resolutionBtn] -- add your button handler code here..
         // set default resolution freq defined by actual pitch frequency
-        parameters.set(kParameterFrequencyResolution_name, kDefaultPitchResolutionRation * parameters.get(kParameterSamplePitch_name)->getValue());
+        parameters.set(kParameterFrequencyResolution_index, kDefaultPitchResolutionRation * parameters[kParameterSamplePitch_index]->getValue());
         //[/UserButtonCode_resolutionBtn]
     }
     else if (buttonThatWasClicked == ledBtn)
@@ -326,7 +419,7 @@ void ParaphrasisAudioProcessorEditor::buttonClicked (Button* buttonThatWasClicke
     {
         //[UserButtonCode_reverseBtn] -- add your button handler code here..
         // change reverse name.
-        parameters.set(kParameterReverse_name, reverseBtn->getToggleState());
+        parameters.set(kParameterReverse_index, reverseBtn->getToggleState());
         //[/UserButtonCode_reverseBtn]
     }
 
@@ -345,8 +438,8 @@ void ParaphrasisAudioProcessorEditor::labelTextChanged (Label* labelThatHasChang
         if ( ! pitchLbl->isBeingEdited() )
         {
             float newValue = pitchLbl->getText().getFloatValue();
-            teragon::Parameter* par = parameters.get(kParameterSamplePitch_name);
-            parameters.set(kParameterSamplePitch_name, checkParameterBoundaries(par, newValue));
+            teragon::Parameter* par = parameters[kParameterSamplePitch_index];
+            parameters.set(kParameterSamplePitch_index, checkParameterBoundaries(par, newValue));
         }
         //[/UserLabelCode_pitchLbl]
     }
@@ -356,8 +449,8 @@ void ParaphrasisAudioProcessorEditor::labelTextChanged (Label* labelThatHasChang
         if ( ! resolutionLbl->isBeingEdited() )
         {
             float newValue = resolutionLbl->getText().getFloatValue();
-            teragon::Parameter* par = parameters.get(kParameterFrequencyResolution_name);
-            parameters.set(kParameterFrequencyResolution_name, checkParameterBoundaries(par, newValue));
+            teragon::Parameter* par = parameters[kParameterFrequencyResolution_index];
+            parameters.set(kParameterFrequencyResolution_index, checkParameterBoundaries(par, newValue));
         }
         //[/UserLabelCode_resolutionLbl]
     }
@@ -370,27 +463,31 @@ void ParaphrasisAudioProcessorEditor::labelTextChanged (Label* labelThatHasChang
 
 //[MiscUserCode] You can add your own definitions of your custom methods or any other code here...
 void ParaphrasisAudioProcessorEditor::onParameterUpdated(const Parameter *parameter)
+{
+    // called by the dispatcher thread of the parameters for every automation event, the
+    // message thread shows the latest values by kParametersTimer
+    const int bit = 1 << (int) parameter->getIndex();
+    for (int changed = changedParameters.get(); ! changedParameters.compareAndSetBool(changed | bit, changed);)
+        changed = changedParameters.get();
+}
+
+void ParaphrasisAudioProcessorEditor::refreshParameters(int changed)
 {
     // update editor due to parameter changes
-    if ( parameter->getName() == kParameterFrequencyResolution_name )
-    {
-        resolutionLbl->setText( String( parameter->getValue(), 2 ), juce::dontSendNotification );
-    }
-    else if ( parameter->getName() == kParameterSamplePitch_name )
+    if ((changed & (1 << kParameterFrequencyResolution_index)) != 0)
+        resolutionLbl->setText( String( parameters[kParameterFrequencyResolution_index]->getValue(), 2 ), juce::dontSendNotification );
+    
+    if ((changed & (1 << kParameterSamplePitch_index)) != 0)
+        pitchLbl->setText( String( parameters[kParameterSamplePitch_index]->getValue() , 2) , juce::dontSendNotification );
+    
+    if ((changed & (1 << kParameterLastSamplePath_index)) != 0)
     {
-        pitchLbl->setText( String( parameter->getValue() , 2) , juce::dontSendNotification );
-    }
-    else if ( parameter->getName() == kParameterLastSamplePath_name )
-    {
-        File file( parameter->getDisplayText() );
+        File file( parameters[kParameterLastSamplePath_index]->getDisplayText() );
         sampleLbl->setText( String( file.getFileName() ), juce::dontSendNotification );
     }
-    else if (parameter->getName() == kParameterReverse_name )
-    {
-        reverseBtn->setToggleState(parameters[kParameterReverse_name]->getValue(), juce::dontSendNotification);
-    }
-
-    lightOn(false);// when any parameter changes - set light off
+    
+    if ((changed & (1 << kParameterReverse_index)) != 0)
+        reverseBtn->setToggleState(parameters[kParameterReverse_index]->getValue(), juce::dontSendNotification);
 }
 
 double ParaphrasisAudioProcessorEditor::checkParameterBoundaries(const Parameter *parameter, double value)
@@ -403,6 +500,158 @@ double ParaphrasisAudioProcessorEditor::checkParameterBoundaries(const Parameter
     return value;
 }
 
+void ParaphrasisAudioProcessorEditor::timerCallback(int timerID)
+{
+    if (timerID == kParametersTimer)
+    {
+        const int changed = changedParameters.exchange(0);
+        if (changed == 0)
+            return;
+        
+        // changed parameters make the processor analyse the sample again, the light shows it
+        refreshParameters(changed);
+        lightOn(getProcessor()->isReady() && ! getProcessor()->isAnalyzing());
+        return;
+    }
+    
+    if (timerID == kScopeTimer)
+    {
+        // the spectroscope gets every block, the meter the voices at the end of the latest
+        ParaphrasisAudioProcessor::ScopeBlock block;
+        bool published = false;
+        while (getProcessor()->popScopeBlock(block))
+        {
+           #if JUCE_MAC || JUCE_IOS || DROWAUDIO_USE_FFTREAL
+            spectroscope->copySamples (block.samples, ParaphrasisAudioProcessor::ScopeBlock::kNumSamples);
+           #endif
+            published = true;
+        }
+        if (published)
+            voiceMeter->setActivity (block.voicePartials, block.numVoices);
+        return;
+    }
+    
+    // allocations of the audio thread caught by a build tracking them
+    AudioThreadAllocations::logAllocations();
+
+    double secondsLeft;
+    const bool analyzing = getProcessor()->getAnalysisProgress(analysisProgress, secondsLeft);
+    if (analyzing)
+        analysisBar->setTextToDisplay (secondsLeft >= 0 ? String (roundToInt (analysisProgress * 100)) + "%, "
+                                                          + String (roundToInt (secondsLeft)) + " s left"
+                                                        : String::empty);
+    analysisBar->setVisible (analyzing);
+
+    const bool exporting = exporter->isExporting();
+    exportProgress = exporter->getProgress();
+    exportBar->setVisible (exporting);
+    bankStatsLbl->setVisible (! exporting);
+
+    // statistics of the blocks since the last tick, the latest are shown
+    ParaphrasisAudioProcessor::RenderStats stats, latest;
+    bool published = false;
+    while (getProcessor()->popRenderStats(stats))
+    {
+        renderOverruns += stats.overruns;
+        if (stats.partialSampleNs > 0)
+            partialSampleNs = stats.partialSampleNs;
+        latest = stats;
+        published = true;
+    }
+
+    updateBankStats();
+    partialView->setBank (getProcessor()->getBank());
+    waveformView->setOverview (getProcessor()->getOverviewHash());
+
+    if (!published)
+        return;
+
+    String text (String::formatted ("CPU %d%% (peak %d%%)  voices %d  partials %d  culled %d  overruns %d",
+                                    roundToInt (latest.load * 100.f), roundToInt (latest.peakLoad * 100.f),
+                                    latest.activeVoices, latest.playingPartials, latest.culledPartials,
+                                    renderOverruns));
+    if (latest.qualityTier > 0)
+        text << "  quality -" << latest.qualityTier;
+    renderStatsLbl->setText (text, juce::dontSendNotification);
+}
+
+void ParaphrasisAudioProcessorEditor::updateBankStats()
+{
+    const Loris::RealTimeSynthesizer::Statistics bank = getProcessor()->getBankStatistics();
+    if (bank.numPartials == 0)
+    {
+        bankStatsLbl->setText (String::empty, juce::dontSendNotification);
+        bankStatsLbl->setTooltip (String::empty);
+        return;
+    }
+
+    // every sounding partial costs the render time of a sample for each sample of the voice
+    const double peakLoad = bank.peakPartialSamples * partialSampleNs * 1e-9;
+    const double meanLoad = bank.meanPartialSamples * partialSampleNs * 1e-9;
+    const double megabytes = (bank.bankBytes + bank.stateBytes) / (1024. * 1024.);
+
+    bankStatsLbl->setText (String::formatted ("%d partials  %d bps  %.1f MB  ~%d%% CPU/voice",
+                                              (int) bank.numPartials, (int) bank.numBreakpoints, megabytes,
+                                              roundToInt (peakLoad * 100.)),
+                           juce::dontSendNotification);
+    bankStatsLbl->setTooltip (String::formatted ("%d partials, %d breakpoints, %.1f s\n"
+                                                 "%d playing at most, %.1f on average\n"
+                                                 "CPU of a voice %.1f%% at most, %.1f%% on average (%.1f ns per partial sample)\n"
+                                                 "Bank %.2f MB shared by voices, %.2f MB of playback state per voice",
+                                                 (int) bank.numPartials, (int) bank.numBreakpoints, bank.duration,
+                                                 (int) bank.maxConcurrentPartials, bank.meanConcurrentPartials,
+                                                 peakLoad * 100., meanLoad * 100., partialSampleNs,
+                                                 bank.bankBytes / (1024. * 1024.), bank.stateBytes / (1024. * 1024.)));
+}
+
+void ParaphrasisAudioProcessorEditor::bankChosen(const BankLibrary::Entry &entry)
+{
+    // settings first, the sample path starts the analysis with all of them
+    const AnalysisCache::Source &source = entry.source;
+    parameters.set(kParameterSamplePitch_index, source.pitchHz);
+    parameters.set(kParameterFrequencyResolution_index, source.resolutionHz);
+    parameters.set(kParameterReverse_index, source.reverse ? 1 : 0);
+    parameters.set(kParameterStereoDownmix_index, source.downmix);
+    parameters.set(kParameterAnalysisCeiling_index, source.ceilingHz);
+    parameters.set(kParameterAnalysisStart_index, source.regionStart);
+    parameters.set(kParameterAnalysisEnd_index, source.regionEnd);
+    parameters.set(kParameterShortWindowAbove_index, source.shortWindowHz);
+    parameters.set(kParameterTransientHop_index, 1000. * source.transientHop);
+    parameters.set(kParameterHarmonicAnalysis_index, source.harmonic ? 1 : 0);
+
+    sampleLbl->setText(File(source.samplePath).getFileName(), juce::dontSendNotification);
+    path = source.samplePath.toRawUTF8();
+    parameters.setData(kParameterLastSamplePath_index, path.c_str(), path.length());
+
+    libraryBtn->setToggleState(false, juce::dontSendNotification);
+    bankBrowser->setVisible(false);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessorEditor::exportBank()
+{
+    const Loris::PartialBank::Ptr bank = getProcessor()->getBank();
+    if ( ! bank || bank->empty() || exporter->isExporting())
+        return;
+
+    // named after the sample, beside it
+    const File sample(parameters[kParameterLastSamplePath_index]->getDisplayText());
+    const File proposed(sample.existsAsFile() ? sample.withFileExtension("bank")
+                                              : File::getSpecialLocation(File::userHomeDirectory).getChildFile("analysis.bank"));
+
+    FileChooser chooser("Export the analysis as a bank or as SDIF partials...", proposed, "*.bank;*.sdif");
+    if (chooser.browseForFileToSave(true))
+        exporter->start(bank, chooser.getResult());
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessorEditor::exportFinished(const File &file, bool succeeded)
+{
+    if ( ! succeeded)
+        AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Export failed",
+                                         "The analysis could not be written into " + file.getFullPathName());
+}
+
 //[/MiscUserCode]
 
 
@@ -416,11 +665,11 @@ double ParaphrasisAudioProcessorEditor::checkParameterBoundaries(const Parameter
 BEGIN_JUCER_METADATA
 
 <JUCER_COMPONENT documentType="Component" className="ParaphrasisAudioProcessorEditor"
-                 componentName="" parentClasses="public AudioProcessorEditor, public ParameterObserver"
+                 componentName="" parentClasses="public AudioProcessorEditor, public ParameterObserver, public MultiTimer, public BankBrowser::Listener"
                  constructorParams="ParaphrasisAudioProcessor* ownerFilter, teragon::ConcurrentParameterSet&amp; p, teragon::ResourceCache *r, AudioFormatManager &amp;formatManager"
                  variableInitialisers="AudioProcessorEditor(ownerFilter),&#10;    parameters(p),&#10;    resources(r),&#10;    formatManager(formatManager)"
                  snapPixels="8" snapActive="1" snapShown="1" overlayOpacity="0.330"
-                 fixedSize="1" initialWidth="300" initialHeight="300">
+                 fixedSize="1" initialWidth="300" initialHeight="450">
   <BACKGROUND backgroundColour="ffbdbdbd">
     <IMAGE pos="0 0 300 300" resource="background2_png" opacity="1" mode="0"/>
   </BACKGROUND>
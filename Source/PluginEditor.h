@@ -48,8 +48,11 @@
 #include "TeragonGuiComponents.h"
 
 #include "Resources.h"
-
-#include "dRowAudio_PitchDetector.h"
+#include "AnalysisExporter.h"
+#include "BankBrowser.h"
+#include "PartialView.h"
+#include "WaveformView.h"
+#include "VoiceMeter.h"
 //[/Headers]
 
 
@@ -63,7 +66,10 @@
 class ParaphrasisAudioProcessorEditor  : public AudioProcessorEditor,
                                          public ParameterObserver,
                                          public ButtonListener,
-                                         public LabelListener
+                                         public LabelListener,
+                                         public MultiTimer,
+                                         public BankBrowser::Listener,
+                                         public AnalysisExporter::Listener
 {
 public:
     //==============================================================================
@@ -81,11 +87,16 @@ public:
         @param on true = on, off otherwise. */
     void lightOn(bool on) { ledBtn->setToggleState(on, false); }
 
-    /** teragon::ParameterObserver method
+    /** teragon::ParameterObserver method, only marks the parameter changed, changes are shown
+        by refreshParameters() at most kParametersIntervalMs apart.
         @param parameter Parameter to be updated.
      */
     virtual void onParameterUpdated(const Parameter *parameter) ;
 
+    /** Show values of parameters.
+        @param changed bits 1 << ParameterIndex of the parameters to show. */
+    void refreshParameters(int changed);
+
     /** teragon::ParameterObserver method.
      */
     virtual bool isRealtimePriority() const { return false; }
@@ -97,6 +108,26 @@ public:
      */
     static double checkParameterBoundaries(const Parameter *parameter, double value);
 
+    /** MultiTimer method, kStatsTimer shows analysis progress, render statistics published by
+        the processor and statistics of the partial bank, kParametersTimer shows parameters
+        changed since it was called last, kScopeTimer shows the output published since then.
+     */
+    virtual void timerCallback(int timerID) override;
+
+    /** Show statistics of the partial bank the voices play, with the CPU load of a voice
+        estimated from the render time of a partial sample measured last. */
+    void updateBankStats();
+
+    /** BankBrowser::Listener method, sets the sample and the analysis settings of the bank,
+        its analysis finds the cached partials and bank. */
+    void bankChosen(const BankLibrary::Entry &entry) override;
+
+    /** Ask for a file and export the bank the voices play into it, in background. */
+    void exportBank();
+
+    /** AnalysisExporter::Listener method, tells the user if the export failed. */
+    void exportFinished(const File &file, bool succeeded) override;
+
     //[/UserMethods]
 
     void paint (Graphics& g);
@@ -115,11 +146,42 @@ public:
 
 private:
     //[UserVariables]   -- You can add your own custom variables in this section.
+    enum
+    {
+        kStatsTimer = 0,
+        kParametersTimer,
+        kScopeTimer,
+        kStatsIntervalMs = 250,
+        kParametersIntervalMs = 33, // Automation is shown at 30 Hz however dense it is
+        kScopeIntervalMs = 33,
+        kScopeFFTSizeLog2 = 11      // FFT of the spectroscope, at the decimated rate of the scope
+    };
+
     teragon::ConcurrentParameterSet& parameters; // parameters
+    Atomic<int> changedParameters;      // bits 1 << ParameterIndex set by observers, cleared by kParametersTimer
     teragon::ResourceCache *resources;  // pictures, etc.
     AudioFormatManager& formatManager;  // loads audio files
     std::string path;                   // path of actual sample (it is class variable - we want it to have live long, string data are send and processed later, it is done so to prevent memory issues if it was local variable)
-    drow::PitchDetector detector;       // to auto-detect sample pitch
+    ScopedPointer<Label> renderStatsLbl; // CPU load and voices of the audio thread
+    ScopedPointer<WaveformView> waveformView; // overview of the sample, under analysisBar
+    double analysisProgress = 0;        // part of the analysis of the sample done, shown by analysisBar
+    ScopedPointer<ProgressBar> analysisBar;
+    ScopedPointer<PartialView> partialView;  // partials of the bank played, under the panel
+   #if JUCE_MAC || JUCE_IOS || DROWAUDIO_USE_FFTREAL
+    ScopedPointer<TimeSliceThread> scopeThread; // computes FFTs of spectroscope
+    ScopedPointer<drow::Spectroscope> spectroscope; // spectrum of the output, where dRowAudio has an FFT
+   #endif
+    ScopedPointer<VoiceMeter> voiceMeter;    // partials played by each voice
+    int renderOverruns = 0;             // blocks close to missing their deadline since the editor was opened
+    ScopedPointer<Label> bankStatsLbl;  // partials, memory and estimated CPU load of the bank played
+    SharedResourcePointer<TooltipWindow> tooltipWindow; // shows details of bankStatsLbl
+    ScopedPointer<TextButton> libraryBtn; // shows bankBrowser
+    ScopedPointer<BankBrowser> bankBrowser; // banks of the analysis cache, over the controls
+    ScopedPointer<TextButton> exportBtn; // exports the bank played by exporter
+    ScopedPointer<AnalysisExporter> exporter;
+    double exportProgress = 0;          // part of the export done, shown by exportBar
+    ScopedPointer<ProgressBar> exportBar; // over bankStatsLbl while exporting
+    float partialSampleNs;              // render time of a sample of a playing partial, measured or estimated
     //[/UserVariables]
 
     //==============================================================================
@@ -24,69 +24,845 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 #include "ParameterDefitions.h"
+#include "PartialsCodec.h"
+#include "AudioThreadAllocations.h"
+#include "ScopedNoDenormals.h"
 
 // Loris
 #include "Analyzer.h"
 #include "AiffFile.h"
+#include "LorisTrace.h"
 #include "PartialUtils.h"
 #include "Resampler.h"
 #include "SdifFile.h"
 
+// State with embedded partials: magic, size of parameters (XML) state, parameters state, partials.
+// States without partials are written as parameters state only, as before.
+static const int kStateWithPartialsMagic = 0x50505331; // "PPS1"
+
+// Render statistics are published every kRenderStatsIntervalMs of audio, a block rendered
+// in more than kRenderStatsRiskLoad of its duration counts as a risk of a dropout.
+static const double kRenderStatsIntervalMs = 50.;
+static const float kRenderStatsRiskLoad = 0.8f;
+
+// Quality governor: load is averaged over kGovernorSmoothingMs, quality steps down when it is
+// above kGovernorHighLoad (or a block is a risk) and up when it was below kGovernorLowLoad for
+// kGovernorRaiseMs. A tier costs about half of the one above it, so the gap keeps it from
+// flapping. kGovernorSettleMs lets a step down take effect before the next one.
+static const double kGovernorSmoothingMs = 100.;
+static const float kGovernorHighLoad = 0.7f;
+static const float kGovernorLowLoad = 0.3f;
+static const double kGovernorSettleMs = 100.;
+static const double kGovernorRaiseMs = 2000.;
+
+// Instance hibernating when idle does so once nothing played for kHibernateIdleSeconds.
+static const double kHibernateIdleSeconds = 60.;
+
 
 //==============================================================================
 ParaphrasisAudioProcessor::ParaphrasisAudioProcessor()
     : TeragonPluginBase(),
-      ParameterObserver(),
-      analyzer(formatManager, analyzerSync)
+      ParameterObserver()
 {
     // setup parameters
     parameters.add(new teragon::FrequencyParameter(kParameterSamplePitch_name, kParameterSamplePitch_minValue,
                                                    kParameterSamplePitch_maxValue, kParameterSamplePitch_defaultValue));
     parameters.add(new teragon::FrequencyParameter(kParameterFrequencyResolution_name, kParameterFrequencyResolution_minValue,
                                                    kParameterFrequencyResolution_maxValue, kParameterFrequencyResolution_defaultValue));
+    parameters.add(new teragon::DecibelParameter(kParameterPartialThreshold_name, kParameterPartialThreshold_minValue,
+                                                 kParameterPartialThreshold_maxValue, kParameterPartialThreshold_defaultValue));
     parameters.add(new teragon::StringParameter(kParameterLastSamplePath_name));
+    parameters.add(new teragon::StringParameter(kParameterMorphTargetPath_name));
     parameters.add(new teragon::BooleanParameter(kParameterReverse_name, kParameterReverse_defaultValue));
+    parameters.add(new teragon::BooleanParameter(kParameterEmbedPartials_name, kParameterEmbedPartials_defaultValue));
+    parameters.add(new teragon::IntegerParameter(kParameterPolyphony_name, kParameterPolyphony_minValue,
+                                                 kParameterPolyphony_maxValue, kParameterPolyphony_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterPlaybackSpeed_name, kParameterPlaybackSpeed_minValue,
+                                               kParameterPlaybackSpeed_maxValue, kParameterPlaybackSpeed_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterStartPosition_name, kParameterStartPosition_minValue,
+                                               kParameterStartPosition_maxValue, kParameterStartPosition_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterLoopStart_name, kParameterLoop_minValue,
+                                               kParameterLoop_maxValue, kParameterLoop_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterLoopEnd_name, kParameterLoop_minValue,
+                                               kParameterLoop_maxValue, kParameterLoop_defaultValue));
+    parameters.add(new teragon::IntegerParameter(kParameterStereoDownmix_name, kParameterStereoDownmix_minValue,
+                                                 kParameterStereoDownmix_maxValue, kParameterStereoDownmix_defaultValue));
+    parameters.add(new teragon::StringParameter(kParameterKeyZones_name));
+    parameters.add(new teragon::BooleanParameter(kParameterFreezeNotes_name, kParameterFreezeNotes_defaultValue));
+    parameters.add(new teragon::IntegerParameter(kParameterNoteCacheSize_name, kParameterNoteCacheSize_minValue,
+                                                 kParameterNoteCacheSize_maxValue, kParameterNoteCacheSize_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterNoiseLevel_name, kParameterNoiseLevel_minValue,
+                                               kParameterNoiseLevel_maxValue, kParameterNoiseLevel_defaultValue));
+    parameters.add(new teragon::IntegerParameter(kParameterAnalysisCeiling_name, kParameterAnalysisCeiling_minValue,
+                                                 kParameterAnalysisCeiling_maxValue, kParameterAnalysisCeiling_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterSpectralTilt_name, kParameterSpectralTilt_minValue,
+                                               kParameterSpectralTilt_maxValue, kParameterSpectralTilt_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterSpectralStretch_name, kParameterSpectralStretch_minValue,
+                                               kParameterSpectralStretch_maxValue, kParameterSpectralStretch_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterNoiseRatio_name, kParameterNoiseRatio_minValue,
+                                               kParameterNoiseRatio_maxValue, kParameterNoiseRatio_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterCropStart_name, kParameterCrop_minValue,
+                                               kParameterCrop_maxValue, kParameterCrop_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterCropEnd_name, kParameterCrop_minValue,
+                                               kParameterCrop_maxValue, kParameterCrop_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterAnalysisStart_name, kParameterAnalysisRegion_minValue,
+                                               kParameterAnalysisRegion_maxValue, kParameterAnalysisRegion_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterAnalysisEnd_name, kParameterAnalysisRegion_minValue,
+                                               kParameterAnalysisRegion_maxValue, kParameterAnalysisRegion_defaultValue));
+    parameters.add(new teragon::IntegerParameter(kParameterShortWindowAbove_name, kParameterShortWindowAbove_minValue,
+                                                 kParameterShortWindowAbove_maxValue, kParameterShortWindowAbove_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterTransientHop_name, kParameterTransientHop_minValue,
+                                               kParameterTransientHop_maxValue, kParameterTransientHop_defaultValue));
+    parameters.add(new teragon::IntegerParameter(kParameterRenderThreads_name, kParameterRenderThreads_minValue,
+                                                 kParameterRenderThreads_maxValue, kParameterRenderThreads_defaultValue));
+    parameters.add(new teragon::BooleanParameter(kParameterAdaptiveQuality_name, kParameterAdaptiveQuality_defaultValue));
+    parameters.add(new teragon::BooleanParameter(kParameterHarmonicRendering_name, kParameterHarmonicRendering_defaultValue));
+    parameters.add(new teragon::BooleanParameter(kParameterHarmonicAnalysis_name, kParameterHarmonicAnalysis_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterBankCrossfade_name, kParameterBankCrossfade_minValue,
+                                               kParameterBankCrossfade_maxValue, kParameterBankCrossfade_defaultValue));
+    parameters.add(new teragon::BooleanParameter(kParameterHibernate_name, kParameterHibernate_defaultValue));
+    parameters.add(new teragon::IntegerParameter(kParameterAnalysisCores_name, kParameterAnalysisCores_minValue,
+                                                 kParameterAnalysisCores_maxValue, kParameterAnalysisCores_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterPitchBendRange_name, kParameterPitchBendRange_minValue,
+                                               kParameterPitchBendRange_maxValue, kParameterPitchBendRange_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterPressureBrightness_name, kParameterPressureBrightness_minValue,
+                                               kParameterPressureBrightness_maxValue, kParameterPressureBrightness_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterPressureNoise_name, kParameterPressureNoise_minValue,
+                                               kParameterPressureNoise_maxValue, kParameterPressureNoise_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterTimbreBrightness_name, kParameterTimbreBrightness_minValue,
+                                               kParameterTimbreBrightness_maxValue, kParameterTimbreBrightness_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterTimbreNoise_name, kParameterTimbreNoise_minValue,
+                                               kParameterTimbreNoise_maxValue, kParameterTimbreNoise_defaultValue));
+    parameters.add(new teragon::FrequencyParameter(kParameterFormantFrequency_name, kParameterFormantFrequency_minValue,
+                                                   kParameterFormantFrequency_maxValue, kParameterFormantFrequency_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterFormantGain_name, kParameterFormantGain_minValue,
+                                               kParameterFormantGain_maxValue, kParameterFormantGain_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterFormantWidth_name, kParameterFormantWidth_minValue,
+                                               kParameterFormantWidth_maxValue, kParameterFormantWidth_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterLowShelf_name, kParameterLowShelf_minValue,
+                                               kParameterLowShelf_maxValue, kParameterLowShelf_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterHighShelf_name, kParameterHighShelf_minValue,
+                                               kParameterHighShelf_maxValue, kParameterHighShelf_defaultValue));
+    parameters.add(new teragon::BooleanParameter(kParameterMultiRate_name, kParameterMultiRate_defaultValue));
+    parameters.add(new teragon::BooleanParameter(kParameterLiveInput_name, kParameterLiveInput_defaultValue));
+    parameters.add(new teragon::IntegerParameter(kParameterMemoryBudget_name, kParameterMemoryBudget_minValue,
+                                                 kParameterMemoryBudget_maxValue, kParameterMemoryBudget_defaultValue));
+    parameters.add(new teragon::BooleanParameter(kParameterPhaseFree_name, kParameterPhaseFree_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterSurfaceEffect_name, kParameterSurfaceEffect_minValue,
+                                               kParameterSurfaceEffect_maxValue, kParameterSurfaceEffect_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterSurfaceTimeStretch_name, kParameterSurfaceTimeStretch_minValue,
+                                               kParameterSurfaceTimeStretch_maxValue, kParameterSurfaceTimeStretch_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterSurfaceFrequencyStretch_name, kParameterSurfaceFrequencyStretch_minValue,
+                                               kParameterSurfaceFrequencyStretch_maxValue, kParameterSurfaceFrequencyStretch_defaultValue));
+    parameters.add(new teragon::FloatParameter(kParameterHarmonify_name, kParameterHarmonify_minValue,
+                                               kParameterHarmonify_maxValue, kParameterHarmonify_defaultValue));
+    jassert(parameters.size() == kNumParameters); // they are looked up by ParameterIndex
+    parameters[kParameterPartialThreshold_index]->addObserver(this);
+    parameters[kParameterPolyphony_index]->addObserver(this);
+    parameters[kParameterPlaybackSpeed_index]->addObserver(this);
+    parameters[kParameterStartPosition_index]->addObserver(this);
+    parameters[kParameterLoopStart_index]->addObserver(this);
+    parameters[kParameterLoopEnd_index]->addObserver(this);
+    parameters[kParameterSamplePitch_index]->addObserver(this);
+    parameters[kParameterFrequencyResolution_index]->addObserver(this);
+    parameters[kParameterReverse_index]->addObserver(this);
+    parameters[kParameterStereoDownmix_index]->addObserver(this);
+    parameters[kParameterLastSamplePath_index]->addObserver(this);
+    parameters[kParameterMorphTargetPath_index]->addObserver(this);
+    parameters[kParameterKeyZones_index]->addObserver(this);
+    parameters[kParameterFreezeNotes_index]->addObserver(this);
+    parameters[kParameterNoteCacheSize_index]->addObserver(this);
+    parameters[kParameterNoiseLevel_index]->addObserver(this);
+    parameters[kParameterAnalysisCeiling_index]->addObserver(this);
+    parameters[kParameterSpectralTilt_index]->addObserver(this);
+    parameters[kParameterSpectralStretch_index]->addObserver(this);
+    parameters[kParameterNoiseRatio_index]->addObserver(this);
+    parameters[kParameterCropStart_index]->addObserver(this);
+    parameters[kParameterCropEnd_index]->addObserver(this);
+    parameters[kParameterAnalysisStart_index]->addObserver(this);
+    parameters[kParameterAnalysisEnd_index]->addObserver(this);
+    parameters[kParameterShortWindowAbove_index]->addObserver(this);
+    parameters[kParameterTransientHop_index]->addObserver(this);
+    parameters[kParameterRenderThreads_index]->addObserver(this);
+    parameters[kParameterAdaptiveQuality_index]->addObserver(this);
+    parameters[kParameterHarmonicRendering_index]->addObserver(this);
+    parameters[kParameterHarmonicAnalysis_index]->addObserver(this);
+    parameters[kParameterBankCrossfade_index]->addObserver(this);
+    parameters[kParameterHibernate_index]->addObserver(this);
+    parameters[kParameterAnalysisCores_index]->addObserver(this);
+    parameters[kParameterPitchBendRange_index]->addObserver(this);
+    parameters[kParameterPressureBrightness_index]->addObserver(this);
+    parameters[kParameterPressureNoise_index]->addObserver(this);
+    parameters[kParameterTimbreBrightness_index]->addObserver(this);
+    parameters[kParameterTimbreNoise_index]->addObserver(this);
+    parameters[kParameterFormantFrequency_index]->addObserver(this);
+    parameters[kParameterFormantGain_index]->addObserver(this);
+    parameters[kParameterFormantWidth_index]->addObserver(this);
+    parameters[kParameterLowShelf_index]->addObserver(this);
+    parameters[kParameterHighShelf_index]->addObserver(this);
+    parameters[kParameterMultiRate_index]->addObserver(this);
+    parameters[kParameterLiveInput_index]->addObserver(this);
+    parameters[kParameterMemoryBudget_index]->addObserver(this);
+    parameters[kParameterPhaseFree_index]->addObserver(this);
+    parameters[kParameterSurfaceEffect_index]->addObserver(this);
+    parameters[kParameterSurfaceTimeStretch_index]->addObserver(this);
+    parameters[kParameterSurfaceFrequencyStretch_index]->addObserver(this);
+    parameters[kParameterHarmonify_index]->addObserver(this);
 
     // setup synth
-    for (int i = kDefaultSynthesiserVoiceNumbers; --i >= 0;)
-        synth.addVoice(new LorisVoice());
-
-    synth.addSound(new LorisSound());
+    synth.setMaxPartialsPerVoice(kDefaultMaxPartialsPerVoice);
+    synth.setNoteCacheSize((int64) kParameterNoteCacheSize_defaultValue << 20);
+    synth.setNumVoices(kParameterPolyphony_defaultValue); // synth has a sound for each key zone, voices are created by prepareToPlay()
     
-    // setup format manager
-    formatManager.registerBasicFormats();
+    memoryGovernor->addClient(this);
 }
 
 //==============================================================================
 ParaphrasisAudioProcessor::~ParaphrasisAudioProcessor()
 {
-
+    // running analysis can not be interrupted, wait for it
+    scheduler->removeJobs(this, true);
+    memoryGovernor->removeClient(this);
+    cancelPendingUpdate();
+    parameters[kParameterPartialThreshold_index]->removeObserver(this);
+    parameters[kParameterPolyphony_index]->removeObserver(this);
+    parameters[kParameterPlaybackSpeed_index]->removeObserver(this);
+    parameters[kParameterStartPosition_index]->removeObserver(this);
+    parameters[kParameterLoopStart_index]->removeObserver(this);
+    parameters[kParameterLoopEnd_index]->removeObserver(this);
+    parameters[kParameterSamplePitch_index]->removeObserver(this);
+    parameters[kParameterFrequencyResolution_index]->removeObserver(this);
+    parameters[kParameterReverse_index]->removeObserver(this);
+    parameters[kParameterStereoDownmix_index]->removeObserver(this);
+    parameters[kParameterLastSamplePath_index]->removeObserver(this);
+    parameters[kParameterMorphTargetPath_index]->removeObserver(this);
+    parameters[kParameterKeyZones_index]->removeObserver(this);
+    parameters[kParameterFreezeNotes_index]->removeObserver(this);
+    parameters[kParameterNoteCacheSize_index]->removeObserver(this);
+    parameters[kParameterNoiseLevel_index]->removeObserver(this);
+    parameters[kParameterAnalysisCeiling_index]->removeObserver(this);
+    parameters[kParameterSpectralTilt_index]->removeObserver(this);
+    parameters[kParameterSpectralStretch_index]->removeObserver(this);
+    parameters[kParameterNoiseRatio_index]->removeObserver(this);
+    parameters[kParameterCropStart_index]->removeObserver(this);
+    parameters[kParameterCropEnd_index]->removeObserver(this);
+    parameters[kParameterAnalysisStart_index]->removeObserver(this);
+    parameters[kParameterAnalysisEnd_index]->removeObserver(this);
+    parameters[kParameterShortWindowAbove_index]->removeObserver(this);
+    parameters[kParameterTransientHop_index]->removeObserver(this);
+    parameters[kParameterRenderThreads_index]->removeObserver(this);
+    parameters[kParameterAdaptiveQuality_index]->removeObserver(this);
+    parameters[kParameterHarmonicRendering_index]->removeObserver(this);
+    parameters[kParameterHarmonicAnalysis_index]->removeObserver(this);
+    parameters[kParameterBankCrossfade_index]->removeObserver(this);
+    parameters[kParameterHibernate_index]->removeObserver(this);
+    parameters[kParameterAnalysisCores_index]->removeObserver(this);
+    parameters[kParameterPitchBendRange_index]->removeObserver(this);
+    parameters[kParameterPressureBrightness_index]->removeObserver(this);
+    parameters[kParameterPressureNoise_index]->removeObserver(this);
+    parameters[kParameterTimbreBrightness_index]->removeObserver(this);
+    parameters[kParameterTimbreNoise_index]->removeObserver(this);
+    parameters[kParameterFormantFrequency_index]->removeObserver(this);
+    parameters[kParameterFormantGain_index]->removeObserver(this);
+    parameters[kParameterFormantWidth_index]->removeObserver(this);
+    parameters[kParameterLowShelf_index]->removeObserver(this);
+    parameters[kParameterHighShelf_index]->removeObserver(this);
+    parameters[kParameterMultiRate_index]->removeObserver(this);
+    parameters[kParameterLiveInput_index]->removeObserver(this);
+    parameters[kParameterMemoryBudget_index]->removeObserver(this);
+    parameters[kParameterPhaseFree_index]->removeObserver(this);
+    parameters[kParameterSurfaceEffect_index]->removeObserver(this);
+    parameters[kParameterSurfaceTimeStretch_index]->removeObserver(this);
+    parameters[kParameterSurfaceFrequencyStretch_index]->removeObserver(this);
+    parameters[kParameterHarmonify_index]->removeObserver(this);
 }
 
 //==============================================================================
-void ParaphrasisAudioProcessor::analyzeSample()
+void ParaphrasisAudioProcessor::analyzeSample(bool withPreview)
 {
+    SampleAnalyzer *analyzer = new SampleAnalyzer(*formatManager, decodedSamples, *this);
+    SampleAnalyzer *preview = nullptr;
+    
     // upate analyzer parameters
-    analyzer.setSamplePath(parameters[kParameterLastSamplePath_name]->getDisplayText());
-    analyzer.setFrequencyResolution(parameters[kParameterFrequencyResolution_name]->getValue());
-    analyzer.setPitch(parameters[kParameterSamplePitch_name]->getValue());
-    analyzer.setReverse(parameters[kParameterReverse_name]->getValue());
+    analyzer->setSamplePath(parameters[kParameterLastSamplePath_index]->getDisplayText());
+    analyzer->setFrequencyResolution(parameters[kParameterFrequencyResolution_index]->getValue());
+    analyzer->setPitch(parameters[kParameterSamplePitch_index]->getValue());
+    analyzer->setReverse(parameters[kParameterReverse_index]->getValue());
+    analyzer->setDownmix(stereoDownmix());
+    analyzer->setFrequencyCeiling(parameters[kParameterAnalysisCeiling_index]->getValue());
+    analyzer->setShortWindowAbove(parameters[kParameterShortWindowAbove_index]->getValue());
+    analyzer->setTransientHop(0.001 * parameters[kParameterTransientHop_index]->getValue());
+    analyzer->setHarmonicAnalysis(parameters[kParameterHarmonicAnalysis_index]->getValue() != 0);
+    analyzer->setRegion(parameters[kParameterAnalysisStart_index]->getValue(),
+                        parameters[kParameterAnalysisEnd_index]->getValue());
+    
+    if (withPreview)
+    {
+        preview = new SampleAnalyzer(*formatManager, decodedSamples, *this, "Paraphrasis is previewing...");
+        preview->setSamplePath(analyzer->samplePath());
+        preview->setFrequencyResolution(analyzer->frequencyResolution());
+        preview->setPitch(analyzer->pitch());
+        preview->setReverse(parameters[kParameterReverse_index]->getValue());
+        preview->setDownmix(stereoDownmix());
+        preview->setFrequencyCeiling(analyzer->frequencyCeiling());
+        preview->setShortWindowAbove(analyzer->shortWindowAbove());
+        preview->setTransientHop(analyzer->transientHop());
+        preview->setHarmonicAnalysis(analyzer->isHarmonicAnalysis());
+        preview->setRegion(parameters[kParameterAnalysisStart_index]->getValue(),
+                           parameters[kParameterAnalysisEnd_index]->getValue());
+        preview->setPreview(true);
+    }
+    
+    AnalysisHistory::Ptr recent;
+    {
+        const ScopedLock sl(analyzerLock);
+        analyzer->setGeneration(++analysisGeneration);
+        if (preview != nullptr)
+            preview->setGeneration(analysisGeneration);
+        
+        // newly selected sample, both jobs detect the same pitch so preview plays it too
+        const bool detect = analyzer->samplePath() == pitchDetectionPath;
+        analyzer->setDetectPitch(detect);
+        if (preview != nullptr)
+            preview->setDetectPitch(detect);
+        
+        // parameters switched back to ones analysed lately, the pitch is known then
+        if (!detect)
+            recent = analysisHistory.find(analyzer->settingsKey());
+        
+        analysedPath = analyzer->samplePath();
+        analysedPitch = analyzer->pitch();
+        analysedResolution = analyzer->frequencyResolution();
+        analysedReverse = parameters[kParameterReverse_index]->getValue() != 0;
+        analysedDownmix = stereoDownmix();
+        analysedRegionStart = parameters[kParameterAnalysisStart_index]->getValue();
+        analysedRegionEnd = parameters[kParameterAnalysisEnd_index]->getValue();
+        
+        analysisPending = recent == nullptr;
+        previewPending = preview != nullptr && recent == nullptr;
+        analysisProgressDone = 0;
+        analysisStartMs = Time::getMillisecondCounter();
+    }
+    
+    // drop waiting analysis and ask running one to exit, then analyze in background,
+    // preview is picked up first
+    scheduler->removeJobs(this, false);
+    if (recent != nullptr)
+    {
+        delete preview;
+        delete analyzer;
+        setupRecentAnalysis(*recent);
+    }
+    else
+    {
+        if (preview != nullptr)
+            scheduler->addJob(preview, this);
+        scheduler->addJob(analyzer, this);
+    }
+    
+    // morph target and key zone analyses dropped with the others are asked for again
+    if (!parameters[kParameterMorphTargetPath_index]->getDisplayText().empty())
+        analyzeMorphTarget();
+    if (!parameters[kParameterKeyZones_index]->getDisplayText().empty())
+        analyzeZones();
+    
+    // indicate analysis state
+    triggerAsyncUpdate();
+}
 
-    // analyze
-    analyzer.runThread();
-    analyzerSync.wait();
+//==============================================================================
+void ParaphrasisAudioProcessor::analyzeMorphTarget()
+{
+    const String path = parameters[kParameterMorphTargetPath_index]->getDisplayText();
     
-    // setup synth
-    double samplePitch = parameters[kParameterSamplePitch_name]->getValue();
+    if (path.isEmpty())
+    {
+        {
+            const ScopedLock sl(analyzerLock);
+            ++morphGeneration; // results of running analysis are dropped
+        }
+        const ScopedLock setupLock(synthSetupLock);
+        synth.clearMorphTarget();
+        return;
+    }
+    
+    // target is analysed like the sample, at its own detected pitch
+    SampleAnalyzer *analyzer = new SampleAnalyzer(*formatManager, decodedSamples, *this, "Paraphrasis is loading morph target...");
+    analyzer->setSamplePath(path);
+    analyzer->setFrequencyResolution(parameters[kParameterFrequencyResolution_index]->getValue());
+    analyzer->setPitch(parameters[kParameterSamplePitch_index]->getValue());
+    analyzer->setReverse(parameters[kParameterReverse_index]->getValue());
+    analyzer->setDownmix(stereoDownmix());
+    analyzer->setFrequencyCeiling(parameters[kParameterAnalysisCeiling_index]->getValue());
+    analyzer->setShortWindowAbove(parameters[kParameterShortWindowAbove_index]->getValue());
+    analyzer->setTransientHop(0.001 * parameters[kParameterTransientHop_index]->getValue());
+    analyzer->setHarmonicAnalysis(parameters[kParameterHarmonicAnalysis_index]->getValue() != 0);
+    analyzer->setDetectPitch(true);
+    analyzer->setMorphTarget(true);
+    
+    {
+        const ScopedLock sl(analyzerLock);
+        analyzer->setGeneration(++morphGeneration);
+    }
+    
+    scheduler->addJob(analyzer, this);
+}
+
+//==============================================================================
+Array<ParaphrasisAudioProcessor::KeyZone> ParaphrasisAudioProcessor::parseKeyZones(const String &text)
+{
+    Array<KeyZone> zones;
+    const StringArray lines = StringArray::fromLines(text);
+    
+    for (int i = 0; i < lines.size() && zones.size() < LorisVoice::kMaxZones - 1; i++)
+    {
+        // lowest note, highest note and pitch are separated by whitespace, the rest is the path
+        String rest = lines[i].trim();
+        KeyZone zone;
+        zone.lowestNote = rest.upToFirstOccurrenceOf(" ", false, false).getIntValue();
+        rest = rest.fromFirstOccurrenceOf(" ", false, false).trimStart();
+        zone.highestNote = rest.upToFirstOccurrenceOf(" ", false, false).getIntValue();
+        rest = rest.fromFirstOccurrenceOf(" ", false, false).trimStart();
+        zone.pitch = rest.upToFirstOccurrenceOf(" ", false, false).getDoubleValue();
+        zone.path = rest.fromFirstOccurrenceOf(" ", false, false).trim().unquoted();
+        
+        if (zone.path.isNotEmpty() && zone.pitch > 0 && zone.lowestNote <= zone.highestNote)
+            zones.add(zone);
+    }
+    
+    return zones;
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::analyzeZones()
+{
+    const Array<KeyZone> zones = parseKeyZones(parameters[kParameterKeyZones_index]->getDisplayText());
+    
+    int generation;
+    {
+        const ScopedLock sl(analyzerLock);
+        generation = ++zonesGeneration; // results of running analyses are dropped
+        keyZones = zones;
+    }
+    
+    {
+        // zones play what they played until their analysis is finished
+        const ScopedLock setupLock(synthSetupLock);
+        synth.setNumZones(zones.size() + 1);
+    }
+    
+    // zones are analysed like the sample, each at its own root pitch, in parallel
+    for (int i = 0; i < zones.size(); i++)
+    {
+        SampleAnalyzer *analyzer = new SampleAnalyzer(*formatManager, decodedSamples, *this, "Paraphrasis is loading key zones...");
+        analyzer->setSamplePath(zones[i].path);
+        analyzer->setFrequencyResolution(kDefaultPitchResolutionRation * zones[i].pitch);
+        analyzer->setPitch(zones[i].pitch);
+        analyzer->setReverse(parameters[kParameterReverse_index]->getValue());
+        analyzer->setDownmix(stereoDownmix());
+        analyzer->setFrequencyCeiling(parameters[kParameterAnalysisCeiling_index]->getValue());
+        analyzer->setShortWindowAbove(parameters[kParameterShortWindowAbove_index]->getValue());
+        analyzer->setTransientHop(0.001 * parameters[kParameterTransientHop_index]->getValue());
+        analyzer->setHarmonicAnalysis(parameters[kParameterHarmonicAnalysis_index]->getValue() != 0);
+        analyzer->setZone(i + 1);
+        analyzer->setGeneration(generation);
+        
+        scheduler->addJob(analyzer, this);
+    }
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::detectPitchOf(const String &samplePath)
+{
+    const ScopedLock sl(analyzerLock);
+    pitchDetectionPath = samplePath;
+}
+
+//==============================================================================
+bool ParaphrasisAudioProcessor::analysisParametersChanged()
+{
+    const ScopedLock sl(analyzerLock);
+    return analysedPath != parameters[kParameterLastSamplePath_index]->getDisplayText() ||
+           analysedPitch != parameters[kParameterSamplePitch_index]->getValue() ||
+           analysedResolution != parameters[kParameterFrequencyResolution_index]->getValue() ||
+           analysedReverse != (parameters[kParameterReverse_index]->getValue() != 0) ||
+           analysedDownmix != stereoDownmix() ||
+           analysedRegionStart != parameters[kParameterAnalysisStart_index]->getValue() ||
+           analysedRegionEnd != parameters[kParameterAnalysisEnd_index]->getValue();
+}
+
+//==============================================================================
+SampleAnalyzer::Downmix ParaphrasisAudioProcessor::stereoDownmix()
+{
+    const int downmix = roundToInt(parameters[kParameterStereoDownmix_index]->getValue());
+    return (SampleAnalyzer::Downmix) jlimit(kParameterStereoDownmix_minValue, kParameterStereoDownmix_maxValue, downmix);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::analysisFinished(SampleAnalyzer *analyzer)
+{
+    // jobs of this instance may run in parallel on different threads
+    const ScopedLock setupLock(synthSetupLock);
+    
+    if (analyzer->isPreview())
+    {
+        previewFinished(analyzer);
+        return;
+    }
+    
+    if (analyzer->zone() > 0)
+    {
+        KeyZone zone;
+        {
+            const ScopedLock sl(analyzerLock);
+            if (analyzer->generation() != zonesGeneration || analyzer->zone() > keyZones.size())
+                return; // newer zones were requested meanwhile
+            zone = keyZones.getReference(analyzer->zone() - 1);
+        }
+        
+        // partials will be moved from analyzer to synth
+        synth.setNoiseBands(analyzer->zone(), analyzer->noiseBands());
+        synth.setupZone(analyzer->zone(), zone.lowestNote, zone.highestNote, analyzer->partials(),
+                        analyzer->pitch(), analyzer->cacheKey(), analyzer->loopStart(), analyzer->loopEnd());
+        return;
+    }
+    
+    if (analyzer->isMorphTarget())
+    {
+        {
+            const ScopedLock sl(analyzerLock);
+            if (analyzer->generation() != morphGeneration)
+                return; // newer morph target was requested meanwhile
+        }
+        
+        synth.setMorphTarget(analyzer->partials(), analyzer->pitch());// partials will be moved from analyzer to synth
+        return;
+    }
+    
+    {
+        const ScopedLock sl(analyzerLock);
+        if (analyzer->generation() != analysisGeneration)
+            return; // newer analysis was requested meanwhile
+        
+        previewPending = false; // too late to be played
+    }
+    
+    m_previewTime = 0;
+    
+    // setup synth, old sound is played until now
+    m_isReady = analyzer->partials().empty() == false;
+    
+    m_sampleLoopStart = analyzer->loopStart();
+    m_sampleLoopEnd = analyzer->loopEnd();
+    updateLoop();
+    m_overviewHash = analyzer->overviewHash();
+    
+    // kept for switching the parameters back, with the bank prepared from the partials
+    std::shared_ptr<AnalysisHistory::Analysis> analysis;
+    if (!analyzer->partials().empty())
+    {
+        analysis = std::make_shared<AnalysisHistory::Analysis>();
+        analysis->partials = analyzer->partials();
+        analysis->pitch = analyzer->pitch();
+        analysis->cacheKey = analyzer->cacheKey();
+        analysis->overviewHash = analyzer->overviewHash();
+        analysis->noiseBands = analyzer->noiseBands();
+        analysis->loopStart = analyzer->loopStart();
+        analysis->loopEnd = analyzer->loopEnd();
+    }
+    
+    synth.setNoiseBands(0, analyzer->noiseBands());
+    synth.setup(analyzer->partials(), analyzer->pitch(), analyzer->cacheKey());// partials will be moved from analyzer to synth
+    
+    if (analysis != nullptr)
+    {
+        analysis->bank = synth.getBank();
+        analysisHistory.add(analyzer->settingsKey(), analysis);
+    }
+    
+    {
+        const ScopedLock sl(analyzerLock);
+        if (analyzer->generation() == analysisGeneration)
+            analysisPending = false;
+    }
+    
+    // indicate analysis state
+    triggerAsyncUpdate();
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::analysisProgress(SampleAnalyzer *analyzer, double progress)
+{
+    // preview, morph target and key zones are not shown, the full analysis of the sample is
+    if (analyzer->isPreview() || analyzer->isMorphTarget() || analyzer->zone() > 0)
+        return;
+    
+    const ScopedLock sl(analyzerLock);
+    if (analyzer->generation() == analysisGeneration)
+        analysisProgressDone = progress;
+}
+
+//==============================================================================
+bool ParaphrasisAudioProcessor::getAnalysisProgress(double &progress, double &secondsLeft)
+{
+    const ScopedLock sl(analyzerLock);
+    progress = analysisProgressDone;
+    secondsLeft = -1;
+    
+    // rate of the analysis so far, waiting for other jobs included
+    const double elapsed = (Time::getMillisecondCounter() - analysisStartMs) * 0.001;
+    if (progress > 0.01 && elapsed > 1.)
+        secondsLeft = elapsed * (1. - progress) / progress;
+    
+    return analysisPending;
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::analysisProgressed(SampleAnalyzer *analyzer, Loris::PartialList &partialsSoFar)
+{
+    if (analyzer->isMorphTarget() || analyzer->zone() > 0)
+        return; // not published by analyzer, morph target and zones are set up when finished
+    
+    const ScopedLock setupLock(synthSetupLock);
+    
+    {
+        const ScopedLock sl(analyzerLock);
+        if (analyzer->generation() != analysisGeneration)
+            return; // newer analysis was requested meanwhile
+    }
+    
+    // preview covering more of the sample is kept
+    if (analyzer->analysedTime() < m_previewTime)
+        return;
+    
+    // play what is analysed so far, notes already sounding are not cut
+    m_isReady = partialsSoFar.empty() == false;
+    
+    m_sampleLoopStart = analyzer->loopStart();
+    m_sampleLoopEnd = analyzer->loopEnd();
+    updateLoop();
+    
+    synth.setupPreview(partialsSoFar, analyzer->pitch());
+    
+    // indicate analysis state
+    triggerAsyncUpdate();
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::pitchDetected(SampleAnalyzer *analyzer)
+{
+    if (analyzer->isMorphTarget() || analyzer->zone() > 0)
+        return; // pitch of the target is its own, parameters are of the sample
+    
+    {
+        const ScopedLock sl(analyzerLock);
+        if (analyzer->generation() != analysisGeneration || analyzer->samplePath() != pitchDetectionPath)
+            return; // newer analysis was requested or pitch was already detected meanwhile
+        
+        // parameters set by the detected pitch do not request the same analysis again
+        pitchDetectionPath = String::empty;
+        analysedPitch = analyzer->pitch();
+        analysedResolution = analyzer->frequencyResolution();
+    }
+    
+    // parameters are set off the analysis thread
+    m_pitchDetected = 1;
+    triggerAsyncUpdate();
+}
+
+//==============================================================================
+// called with synthSetupLock locked
+void ParaphrasisAudioProcessor::previewFinished(SampleAnalyzer *preview)
+{
+    {
+        const ScopedLock sl(analyzerLock);
+        if (preview->generation() != analysisGeneration || !previewPending)
+            return; // full or newer analysis was finished or requested meanwhile
+        
+        previewPending = false;
+    }
+    
+    if (preview->partials().empty())
+        return;
+    
+    m_isReady = 1;
+    m_previewTime = preview->analysedTime();
+    
+    m_sampleLoopStart = preview->loopStart();
+    m_sampleLoopEnd = preview->loopEnd();
+    updateLoop();
+    
+    synth.setupPreview(preview->partials(), preview->pitch());
+    
+    // indicate analysis state
+    triggerAsyncUpdate();
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::setupRecentAnalysis(const AnalysisHistory::Analysis &analysis)
+{
+    const ScopedLock setupLock(synthSetupLock);
+    
+    m_previewTime = 0;
+    m_isReady = true;
+    
+    m_sampleLoopStart = analysis.loopStart;
+    m_sampleLoopEnd = analysis.loopEnd;
+    updateLoop();
+    m_overviewHash = analysis.overviewHash;
+    
+    // the bank held by the history is found by its cache key, it is not prepared again
+    Loris::PartialList partials(analysis.partials);
+    synth.setNoiseBands(0, analysis.noiseBands);
+    synth.setup(partials, analysis.pitch, analysis.cacheKey);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::setupRestoredPartials(Loris::PartialList &partials)
+{
+    // restored partials replace any analysis
+    scheduler->removeJobs(this, false);
+    
+    const ScopedLock setupLock(synthSetupLock);
+    
+    {
+        const ScopedLock sl(analyzerLock);
+        ++analysisGeneration; // results of running analysis are dropped
+        analysisPending = false;
+        previewPending = false;
+    }
     
-    m_isReady = analyzer.partials().empty() == false;
+    m_previewTime = 0;
+    m_isReady = partials.empty() == false;
     
-    synth.setup(analyzer.partials(), samplePitch);// partials will be moved from analyzer to synth
+    synth.setNoiseBands(0, nullptr); // the residual is not stored with the partials
+    synth.setup(partials, parameters[kParameterSamplePitch_index]->getValue());
+    
+    // morph target and key zone analyses dropped with the others are asked for again
+    if (!parameters[kParameterMorphTargetPath_index]->getDisplayText().empty())
+        analyzeMorphTarget();
+    if (!parameters[kParameterKeyZones_index]->getDisplayText().empty())
+        analyzeZones();
     
     // indicate analysis state
+    triggerAsyncUpdate();
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::updateLoop()
+{
+    // loop set by user wins over the markers of the sample
+    const double start = parameters[kParameterLoopStart_index]->getValue();
+    const double end = parameters[kParameterLoopEnd_index]->getValue();
+    
+    if (end > start)
+        synth.setLoop(start, end);
+    else
+        synth.setLoop(m_sampleLoopStart, m_sampleLoopEnd);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::updateModifiers()
+{
+    Loris::PartialModifiers modifiers;
+    modifiers.spectralTilt = parameters[kParameterSpectralTilt_index]->getValue();
+    modifiers.frequencyScale = parameters[kParameterSpectralStretch_index]->getValue();
+    modifiers.noiseRatioScale = parameters[kParameterNoiseRatio_index]->getValue();
+    modifiers.cropStart = parameters[kParameterCropStart_index]->getValue(); // no crop unless end is after start
+    modifiers.cropEnd = parameters[kParameterCropEnd_index]->getValue();
+    modifiers.harmonify = parameters[kParameterHarmonify_index]->getValue();
+    synth.setModifiers(modifiers);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::updateExpression()
+{
+    ExpressionMatrix expression;
+    expression.amounts[ExpressionMatrix::kPitchWheel][ExpressionMatrix::kPitch] = parameters[kParameterPitchBendRange_index]->getValue();
+    expression.amounts[ExpressionMatrix::kPressure][ExpressionMatrix::kBrightness] = parameters[kParameterPressureBrightness_index]->getValue();
+    expression.amounts[ExpressionMatrix::kPressure][ExpressionMatrix::kNoise] = parameters[kParameterPressureNoise_index]->getValue();
+    expression.amounts[ExpressionMatrix::kTimbre][ExpressionMatrix::kBrightness] = parameters[kParameterTimbreBrightness_index]->getValue();
+    expression.amounts[ExpressionMatrix::kTimbre][ExpressionMatrix::kNoise] = parameters[kParameterTimbreNoise_index]->getValue();
+    synth.setExpression(expression);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::updatePartialFilter()
+{
+    Loris::PartialFilter filter;
+    filter.addPeak(parameters[kParameterFormantFrequency_index]->getValue(), parameters[kParameterFormantGain_index]->getValue(),
+                   parameters[kParameterFormantWidth_index]->getValue());
+    filter.addShelf(kLowShelfFrequency, parameters[kParameterLowShelf_index]->getValue(), false);
+    filter.addShelf(kHighShelfFrequency, parameters[kParameterHighShelf_index]->getValue(), true);
+    synth.setPartialFilter(filter);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::handleAsyncUpdate()
+{
+    // banks are prepared again off the audio thread
+    if (m_partialThresholdChanged.exchange(0) != 0)
+        synth.setPartialThreshold(parameters[kParameterPartialThreshold_index]->getValue());
+    if (m_phaseFreeChanged.exchange(0) != 0)
+        synth.setPhaseFree(parameters[kParameterPhaseFree_index]->getValue() != 0);
+    
+    // threads rendering voices are taken from the shared pool off the audio thread
+    if (m_renderModeChanged.exchange(0) != 0)
+        updateRenderThreads();
+    
+    // thread rendering notes is started off the audio thread
+    if (m_freezeNotesChanged.exchange(0) != 0)
+        synth.setFreezeNotes(parameters[kParameterFreezeNotes_index]->getValue() != 0);
+    
+    // voices are created and deleted off the audio thread
+    if (m_polyphonyChanged.exchange(0) != 0)
+        synth.setNumVoices(roundToInt(parameters[kParameterPolyphony_index]->getValue()));
+    
+    // loop entries of partials are prepared off the audio thread
+    if (m_loopChanged.exchange(0) != 0)
+    {
+        const ScopedLock setupLock(synthSetupLock);
+        updateLoop();
+    }
+    
+    if (m_hibernate.exchange(0) != 0)
+        hibernateBanks();
+    
+    // detected pitch is shown as if it was set by user
+    if (m_pitchDetected.exchange(0) != 0)
+    {
+        double pitch, resolution;
+        {
+            const ScopedLock sl(analyzerLock);
+            pitch = analysedPitch;
+            resolution = analysedResolution;
+        }
+        parameters.set(kParameterSamplePitch_index, pitch);
+        parameters.set(kParameterFrequencyResolution_index, resolution);
+    }
+    
+    // edited analysis parameters are previewed at once, the full analysis follows,
+    // parameters already analysed (like the detected pitch) are not analysed again
+    const bool analysisChanged = m_analysisChanged.exchange(0) != 0;
+    if (analysisChanged && analysisParametersChanged())
+        analyzeSample(true);
+    
+    // live input is analysed with the frequency resolution too, its thread is started and
+    // stopped off the audio thread
+    if (m_liveInputChanged.exchange(0) != 0 || analysisChanged)
+        updateLiveInput(false);
+    
+    // morph target is analysed on its own, the sound keeps playing meanwhile
+    if (m_morphTargetChanged.exchange(0) != 0)
+        analyzeMorphTarget();
+    
+    // key zones too, other keys keep playing the sample
+    if (m_zonesChanged.exchange(0) != 0)
+        analyzeZones();
+    
     ParaphrasisAudioProcessorEditor* editor = dynamic_cast<ParaphrasisAudioProcessorEditor *>(getActiveEditor());
     if (editor)
-        editor->lightOn( m_isReady );
+        editor->lightOn( isReady() && ! isAnalyzing() );
 }
 
 //==============================================================================
@@ -101,9 +877,75 @@ void ParaphrasisAudioProcessor::prepareToPlay(double sampleRate, int samplesPerB
     // prepareToPlay(). Your code must be able to cope with variable-sized blocks,
     // or you're going to get clicks and crashes!
     TeragonPluginBase::prepareToPlay(sampleRate, samplesPerBlock);
-    synth.setCurrentPlaybackSampleRate(sampleRate);
+    synth.prepareToPlay(sampleRate, samplesPerBlock);
+    
+    // hosts switching to offline before they prepare bounce on all cores from the first block
+    updateRenderThreads();
+    
+    // analysis windows and the latency depend on the sample rate and the block size
+    updateLiveInput(true);
 }
 
+//==============================================================================
+void ParaphrasisAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    // hosts call it for every block, mostly with no change
+    const bool changed = isNonRealtime != AudioProcessor::isNonRealtime();
+    
+    TeragonPluginBase::setNonRealtime(isNonRealtime);
+    synth.setNonRealtime(isNonRealtime);
+    live.setNonRealtime(isNonRealtime);
+    
+    // called from the audio thread, threads are started in handleAsyncUpdate()
+    if (changed)
+    {
+        m_renderModeChanged = 1;
+        triggerAsyncUpdate();
+    }
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::updateRenderThreads()
+{
+    // bounce speed scales with cores, workers of the shared pool are used by one instance at once
+    const int offlineThreads = isNonRealtime() ? SystemStats::getNumCpus() : 1;
+    if (synth.getOfflineRenderThreads() != offlineThreads)
+        synth.setOfflineRenderThreads(offlineThreads);
+    
+    const int realtimeThreads = roundToInt(parameters[kParameterRenderThreads_index]->getValue());
+    if (synth.getRenderThreads() != realtimeThreads)
+        synth.setRenderThreads(realtimeThreads);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::hibernateBanks()
+{
+    // partials analysed lately are dropped with the rest, the sample is analysed again then
+    analysisHistory.clear();
+    synth.hibernate();
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::updateLiveInput(bool restart)
+{
+    const bool enabled = parameters[kParameterLiveInput_index]->getValue() != 0 && getSampleRate() > 0;
+    const double resolution = parameters[kParameterFrequencyResolution_index]->getValue();
+    if (!enabled)
+    {
+        if (liveResolution != 0)
+            live.release();
+        liveResolution = 0;
+    }
+    else if (restart || resolution != liveResolution)
+    {
+        live.prepare(getSampleRate(), getBlockSize(), resolution);
+        liveResolution = resolution;
+    }
+    
+    // hosts delay the other tracks by it
+    if (getLatencySamples() != live.getLatencySamples())
+        setLatencySamples(live.getLatencySamples());
+}
 
 //==============================================================================
 void ParaphrasisAudioProcessor::releaseResources()
@@ -111,31 +953,275 @@ void ParaphrasisAudioProcessor::releaseResources()
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
     TeragonPluginBase::releaseResources();
+    AudioThreadAllocations::logAllocations();
+    
+    // nothing is played until prepareToPlay(), which starts the live analysis again
+    live.release();
+    liveResolution = 0;
+    
+    // not playing until prepareToPlay(), which finds the banks mapped by hibernation
+    if (parameters[kParameterHibernate_index]->getValue() != 0)
+    {
+        m_hibernate = 1;
+        triggerAsyncUpdate();
+    }
 }
 
 //==============================================================================
 void ParaphrasisAudioProcessor::onParameterUpdated(const Parameter *parameter)
 {
+    // called from the audio thread, the synth is changed in handleAsyncUpdate()
+    switch (parameter->getIndex())
+    {
+        case kParameterPartialThreshold_index:
+            m_partialThresholdChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterPolyphony_index:
+            m_polyphonyChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterRenderThreads_index:
+            m_renderModeChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterLoopStart_index:
+        case kParameterLoopEnd_index:
+            m_loopChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterSamplePitch_index:
+        case kParameterFrequencyResolution_index:
+        case kParameterReverse_index:
+        case kParameterLastSamplePath_index:
+        case kParameterStereoDownmix_index:
+        case kParameterAnalysisCeiling_index:
+        case kParameterAnalysisStart_index:
+        case kParameterAnalysisEnd_index:
+        case kParameterShortWindowAbove_index:
+        case kParameterTransientHop_index:
+        case kParameterHarmonicAnalysis_index:
+            m_analysisChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterMorphTargetPath_index:
+            m_morphTargetChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterKeyZones_index:
+            m_zonesChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterFreezeNotes_index:
+            m_freezeNotesChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterNoteCacheSize_index:
+            // notes beyond it are dropped by the thread rendering them
+            synth.setNoteCacheSize((int64) roundToInt(parameter->getValue()) << 20);
+            break;
+            
+        case kParameterAdaptiveQuality_index:
+            // audio thread only, quality is full again until the governor lowers it
+            m_adaptiveQuality = parameter->getValue() != 0;
+            if (!m_adaptiveQuality)
+                resetQualityGovernor();
+            break;
+            
+        case kParameterHarmonicRendering_index:
+            // harmonics were measured when the banks were set up, playing notes switch over
+            synth.setHarmonicRendering(parameter->getValue() != 0);
+            break;
+            
+        case kParameterBankCrossfade_index:
+            // held notes crossfade to the partials of the next analysis
+            synth.setBankCrossfadeTime(parameter->getValue() * 0.001);
+            break;
+            
+        case kParameterHibernate_index:
+            // audio thread only, idle time is counted from now
+            m_hibernateWhenIdle = parameter->getValue() != 0;
+            idleSamples = 0;
+            break;
+            
+        case kParameterAnalysisCores_index:
+            // shared by all instances, jobs started from now on take it
+            scheduler->setCoreBudget(roundToInt(parameter->getValue()));
+            break;
+            
+        case kParameterPlaybackSpeed_index:
+            // nothing is prepared again, voices stretch the partials they play
+            synth.setPlaybackSpeed(parameter->getValue());
+            break;
+            
+        case kParameterStartPosition_index:
+            // notes started from now on enter the partials there, see LorisVoice::beginNote()
+            synth.setStartPosition(parameter->getValue());
+            break;
+            
+        case kParameterNoiseLevel_index:
+            // playing notes ramp to it, the residual is measured by every analysis anyway
+            synth.setNoiseLevel(parameter->getValue());
+            break;
+            
+        case kParameterSpectralTilt_index:
+        case kParameterSpectralStretch_index:
+        case kParameterNoiseRatio_index:
+        case kParameterCropStart_index:
+        case kParameterCropEnd_index:
+        case kParameterHarmonify_index:
+            // nothing is prepared again, voices transform the partials they play
+            updateModifiers();
+            break;
+            
+        case kParameterPitchBendRange_index:
+        case kParameterPressureBrightness_index:
+        case kParameterPressureNoise_index:
+        case kParameterTimbreBrightness_index:
+        case kParameterTimbreNoise_index:
+            // playing notes take it at the next block
+            updateExpression();
+            break;
+            
+        case kParameterFormantFrequency_index:
+        case kParameterFormantGain_index:
+        case kParameterFormantWidth_index:
+        case kParameterLowShelf_index:
+        case kParameterHighShelf_index:
+            // voices scale the partials they play, instead of filtering the output
+            updatePartialFilter();
+            break;
+            
+        case kParameterMultiRate_index:
+            // playing notes switch at their next block
+            synth.setMultiRate(parameter->getValue() != 0);
+            break;
+            
+        case kParameterLiveInput_index:
+            // input is played from the next block, delayed until the thread is started
+            m_liveInput = parameter->getValue() != 0;
+            if (m_liveInput)
+                live.reset();
+            m_liveInputChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterMemoryBudget_index:
+            // shared by all instances, applied at the next check of the governor
+            memoryGovernor->setBudget((int64) roundToInt(parameter->getValue()) << 20);
+            break;
+            
+        case kParameterPhaseFree_index:
+            m_phaseFreeChanged = 1;
+            triggerAsyncUpdate();
+            break;
+            
+        case kParameterSurfaceEffect_index:
+        case kParameterSurfaceTimeStretch_index:
+        case kParameterSurfaceFrequencyStretch_index:
+            // voices look the surface up for the partials they play, at the next block
+            synth.setSurfaceEffect(parameters[kParameterSurfaceEffect_index]->getValue(),
+                                   parameters[kParameterSurfaceTimeStretch_index]->getValue(),
+                                   parameters[kParameterSurfaceFrequencyStretch_index]->getValue());
+            break;
+            
+        default:
+            break;
+    }
+}
 
+//==============================================================================
+void ParaphrasisAudioProcessor::getStateInformation(MemoryBlock &destData)
+{
+    MemoryBlock parametersState;
+    TeragonPluginBase::getStateInformation(parametersState);
+    
+    Loris::PartialList partials;
+    if (parameters[kParameterEmbedPartials_index]->getValue())
+        partials = synth.getPartials();
+    
+    if (partials.empty())
+    {
+        destData = parametersState;
+        return;
+    }
+    
+    // store partials as binary data, so the sound can be restored without analysis
+    MemoryOutputStream stream(destData, false);
+    stream.writeInt(kStateWithPartialsMagic);
+    stream.writeInt((int) parametersState.getSize());
+    stream.write(parametersState.getData(), parametersState.getSize());
+    PartialsCodec::write(partials, stream);
 }
 
 //==============================================================================
 void ParaphrasisAudioProcessor::setStateInformation(const void *data, int sizeInBytes)
 {
+    MemoryInputStream stream(data, (size_t) sizeInBytes, false);
+    
+    if (sizeInBytes > 8 && stream.readInt() == kStateWithPartialsMagic)
+    {
+        const int parametersSize = stream.readInt();
+        if (parametersSize > 0 && parametersSize <= stream.getNumBytesRemaining())
+        {
+            TeragonPluginBase::setStateInformation(static_cast<const char *>(data) + 8, parametersSize);
+            m_analysisChanged = 0; // restored parameters are not edits
+            
+            Loris::PartialList partials;
+            stream.setPosition(8 + parametersSize);
+            if (PartialsCodec::read(stream, partials))
+                setupRestoredPartials(partials);
+            else
+                analyzeSample();// broken partials data, analyse sample again
+        }
+        return;
+    }
+    
     TeragonPluginBase::setStateInformation(data, sizeInBytes);
+    m_analysisChanged = 0; // restored parameters are not edits
     analyzeSample();// reload sample when state information changes (possible path change)
 }
 
 //==============================================================================
 void ParaphrasisAudioProcessor::processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
+    // allocations of this thread are caught by a build tracking them
+    const AudioThreadAllocations::ScopedAudioThread audioThread;
+    const ScopedNoDenormals noDenormals;
+    LORIS_TRACE_ZONE("ParaphrasisAudioProcessor::processBlock");
+    
+    // blocks are timed while the editor shows it, and in real time for the governor and for
+    // analyses, which wait while audio threads are busy
+    const bool realtime = !isNonRealtime();
+    const bool govern = m_adaptiveQuality && realtime;
+    const int64 startTicks = m_renderStatsEnabled.get() != 0 || realtime ? Time::getHighResolutionTicks() : 0;
+    if (!govern && governorTier != LorisSynthesiser::kFullQuality)
+        resetQualityGovernor();
+    
     // In case we have more outputs than inputs, we'll clear any output
     // channels that didn't contain input data, (because these aren't
     // guaranteed to be empty - they may contain garbage).
-    TeragonPluginBase::processBlock(buffer, midiMessages);
+    {
+        // applies parameter changes, ConcurrentParameterSet::processRealtimeEvents()
+        LORIS_TRACE_ZONE("ConcurrentParameterSet::processRealtimeEvents");
+        TeragonPluginBase::processBlock(buffer, midiMessages);
+    }
 
-	// Clear input channels.
-	for (int i = 0; i < getNumInputChannels(); ++i)
+    // live input is queued for analysis before it is cleared
+    if (m_liveInput)
+        live.pushInput(buffer, getNumInputChannels(), buffer.getNumSamples());
+    
+	// Clear input channels and the outputs beyond them, voices add to the first two and
+	// the others are only copied to when the synth wrote to their channel.
+	for (int i = 0; i < buffer.getNumChannels(); ++i)
     {
 		buffer.clear(i, 0, buffer.getNumSamples());
 	}
@@ -143,11 +1229,159 @@ void ParaphrasisAudioProcessor::processBlock(AudioSampleBuffer& buffer, MidiBuff
     // synthesise
     const int numSamples = buffer.getNumSamples();
     synth.renderNextBlock(buffer, midiMessages, 0, numSamples);
+    if (m_liveInput)
+        live.renderNextBlock(buffer, numSamples);
+    
+    // analysis of playing instances is scheduled first, resynthesised input plays
+    bool playing = m_liveInput;
+    for (int i = synth.getNumVoices(); --i >= 0 && !playing;)
+        playing = synth.getVoice(i)->getCurrentlyPlayingNote() >= 0;
     
-    // copy first channel to other(s) (synth is mono)
-    auto synthetisedChannel = buffer.getReadPointer(0);
-    for (int i = buffer.getNumChannels(); --i > 0;)
-        buffer.copyFrom(i, 0, synthetisedChannel, numSamples);
+    AudioPlayHead::CurrentPositionInfo position;
+    if (!playing && getPlayHead() != nullptr && getPlayHead()->getCurrentPosition(position))
+        playing = position.isPlaying;
+    
+    m_isPlaying = playing;
+    if (playing)
+        m_lastActiveMs = Time::getMillisecondCounter();
+    
+    // idle instance is compacted once, off the audio thread
+    const int64 hibernateSamples = (int64) (kHibernateIdleSeconds * getSampleRate());
+    if (playing || !m_hibernateWhenIdle)
+        idleSamples = 0;
+    else if (idleSamples < hibernateSamples && (idleSamples += numSamples) >= hibernateSamples)
+    {
+        m_hibernate = 1;
+        triggerAsyncUpdate();
+    }
+    
+    // synth renders the first two channels, other outputs repeat them (all are cleared
+    // above, so outputs of channels the synth did not write to stay silent)
+    const int writtenChannels = synth.getWrittenChannels() | (m_liveInput ? 3 : 0);
+    for (int i = buffer.getNumChannels(); --i > 1;)
+        if ((writtenChannels & (1 << (i % 2))) != 0)
+            buffer.copyFrom(i, 0, buffer, i % 2, 0, numSamples);
+    
+    const int64 ticks = startTicks != 0 ? Time::getHighResolutionTicks() - startTicks : 0;
+    if (govern)
+        updateQualityGovernor(ticks, numSamples);
+    if (startTicks != 0 && m_renderStatsEnabled.get() != 0)
+        addRenderStats(ticks, numSamples);
+    if (startTicks != 0 && realtime && numSamples > 0 && getSampleRate() > 0)
+        scheduler->reportAudioLoad((float) (Time::highResolutionTicksToSeconds(ticks) * getSampleRate() / numSamples));
+    
+    if (m_scopeEnabled.get() != 0)
+        addScopeSamples(buffer, numSamples);
+}
+//==============================================================================
+void ParaphrasisAudioProcessor::addRenderStats(int64 ticks, int numSamples) noexcept
+{
+    if (numSamples <= 0 || getSampleRate() <= 0)
+        return;
+    
+    const double seconds = Time::highResolutionTicksToSeconds(ticks);
+    const float load = (float) (seconds * getSampleRate() / numSamples);
+    int activeVoices, playingPartials, culledPartials;
+    synth.getVoicesRenderStats(activeVoices, playingPartials, culledPartials);
+    
+    // load of the interval is kept as seconds until it is published
+    renderStats.load += (float) seconds;
+    renderStats.peakLoad = jmax(renderStats.peakLoad, load);
+    renderStats.activeVoices = jmax(renderStats.activeVoices, activeVoices);
+    renderStats.playingPartials = jmax(renderStats.playingPartials, playingPartials);
+    renderStats.culledPartials += culledPartials;
+    renderStats.qualityTier = jmax(renderStats.qualityTier, governorTier);
+    if (load > kRenderStatsRiskLoad)
+        renderStats.overruns++;
+    renderStatsSamples += numSamples;
+    
+    // time of blocks playing partials is kept as seconds too, voices report the most partials
+    // of their sub-blocks, so the cost of a partial sample comes out a bit low
+    if (playingPartials > 0)
+    {
+        renderStats.partialSampleNs += (float) seconds;
+        renderStatsPartialSamples += (double) playingPartials * numSamples;
+    }
+    
+    if (renderStatsSamples >= kRenderStatsIntervalMs * 0.001 * getSampleRate())
+    {
+        renderStats.load = (float) (renderStats.load * getSampleRate() / renderStatsSamples);
+        renderStats.partialSampleNs = renderStatsPartialSamples > 0
+                                    ? (float) (renderStats.partialSampleNs * 1e9 / renderStatsPartialSamples) : 0.f;
+        // the queue never allocates here, stats the editor did not read yet are dropped
+        renderStatsQueue.try_enqueue(renderStats);
+        renderStats = RenderStats();
+        renderStatsSamples = 0;
+        renderStatsPartialSamples = 0;
+    }
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::updateQualityGovernor(int64 ticks, int numSamples) noexcept
+{
+    if (numSamples <= 0 || getSampleRate() <= 0)
+        return;
+    
+    const double sampleRate = getSampleRate();
+    const float load = (float) (Time::highResolutionTicksToSeconds(ticks) * sampleRate / numSamples);
+    const float smoothing = (float) jmin(1., numSamples / (kGovernorSmoothingMs * 0.001 * sampleRate));
+    governorLoad += smoothing * (load - governorLoad);
+    governorHeldSamples = jmin(governorHeldSamples + numSamples, 0x40000000); // hours of a steady tier do not wrap
+    
+    int tier = governorTier;
+    if ((load > kRenderStatsRiskLoad || governorLoad > kGovernorHighLoad)
+        && governorHeldSamples >= kGovernorSettleMs * 0.001 * sampleRate)
+        tier++;
+    else if (governorLoad < kGovernorLowLoad && governorHeldSamples >= kGovernorRaiseMs * 0.001 * sampleRate)
+        tier--;
+    
+    tier = jlimit(0, (int) LorisSynthesiser::kNumQualityTiers - 1, tier);
+    if (tier == governorTier)
+        return;
+    
+    // a step up is measured from scratch, its load is about twice the one it was raised at
+    governorTier = tier;
+    governorHeldSamples = 0;
+    synth.setQualityTier(tier);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::resetQualityGovernor() noexcept
+{
+    governorTier = LorisSynthesiser::kFullQuality;
+    governorLoad = 0;
+    governorHeldSamples = 0;
+    synth.setQualityTier(governorTier);
+}
+
+//==============================================================================
+void ParaphrasisAudioProcessor::addScopeSamples(const AudioSampleBuffer &buffer, int numSamples) noexcept
+{
+    // mono mix of the first two channels, averages of kScopeDecimation samples are a cheap
+    // low-pass, the scope does not need more
+    const int numChannels = jmin(2, buffer.getNumChannels());
+    if (numChannels == 0)
+        return;
+    const float *left = buffer.getReadPointer(0);
+    const float *right = buffer.getReadPointer(numChannels - 1);
+    
+    for (int i = 0; i < numSamples; i++)
+    {
+        scopeSum += left[i] + right[i];
+        if (++scopeSumSamples < kScopeDecimation)
+            continue;
+        
+        scopeBlock.samples[scopeBlockSamples++] = scopeSum / (2 * kScopeDecimation);
+        scopeSum = 0;
+        scopeSumSamples = 0;
+        if (scopeBlockSamples < ScopeBlock::kNumSamples)
+            continue;
+        
+        // the queue never allocates here, blocks the editor did not read yet are dropped
+        scopeBlock.numVoices = synth.getVoicesActivity(scopeBlock.voicePartials, ScopeBlock::kMaxVoices);
+        scopeQueue.try_enqueue(scopeBlock);
+        scopeBlockSamples = 0;
+    }
 }
 //==============================================================================
 bool ParaphrasisAudioProcessor::hasEditor() const
@@ -157,7 +1391,7 @@ bool ParaphrasisAudioProcessor::hasEditor() const
 //==============================================================================
 AudioProcessorEditor* ParaphrasisAudioProcessor::createEditor()
 {
-    return new ParaphrasisAudioProcessorEditor(this, parameters, Resources::getCache(), formatManager);
+    return new ParaphrasisAudioProcessorEditor(this, parameters, editorResources->getCache(), *formatManager);
 }
 //==============================================================================
 // This creates new instances of the plugin..
@@ -26,11 +26,18 @@
 // teragon
 #include "TeragonPluginBase.h"
 #include "PluginParameters.h"
+#include "readerwriterqueue/readerwriterqueue.h"
 // Loris
 #include "PartialList.h"
 // My
 #include "SampleAnalyzer.h"
+#include "AnalysisHistory.h"
+#include "AnalysisScheduler.h"
+#include "EditorResources.h"
+#include "SharedFormatManager.h"
 #include "LorisSynthesiser.h"
+#include "LiveResynthesiser.h"
+#include "MemoryGovernor.h"
 
 using namespace teragon;
 
@@ -38,7 +45,9 @@ using namespace teragon;
 /**
  Paraphrasis processor class. 
 */
-class ParaphrasisAudioProcessor  : public TeragonPluginBase, ParameterObserver
+class ParaphrasisAudioProcessor  : public TeragonPluginBase, ParameterObserver,
+                                   public SampleAnalyzer::Listener, public AnalysisScheduler::Client,
+                                   public MemoryGovernor::Client, private AsyncUpdater
 {
 
 public:
@@ -55,31 +64,287 @@ public:
     void releaseResources() override;
     void processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages) override;
     
+    /** Offline bounces render voices on all cores and without partial budget (see
+        LorisSynthesiser::setNonRealtime()). Hosts may call it from the audio thread. */
+    void setNonRealtime(bool isNonRealtime) noexcept override;
+    
+    virtual void getStateInformation(MemoryBlock &destData) override;
     virtual void setStateInformation(const void *data, int sizeInBytes) override;
 
     // PluginParameterObserver methods
     virtual bool isRealtimePriority() const override { return true; }
     virtual void onParameterUpdated(const Parameter *parameter) override;
 
+    // SampleAnalyzer::Listener methods
+    virtual void analysisFinished(SampleAnalyzer *analyzer) override;
+    virtual void analysisProgressed(SampleAnalyzer *analyzer, Loris::PartialList &partialsSoFar) override;
+    virtual void pitchDetected(SampleAnalyzer *analyzer) override;
+    virtual void analysisProgress(SampleAnalyzer *analyzer, double progress) override;
+
+    // AnalysisScheduler::Client and MemoryGovernor::Client methods
+    virtual bool isPlaying() const override { return m_isPlaying.get() != 0; }
+    
+    // MemoryGovernor::Client methods
+    virtual int64 getBankBytes() const override { return synth.getBankBytes(); }
+    virtual int64 getNoteCacheBytes() const override { return synth.getNoteCacheBytes(); }
+    virtual uint32 getLastActiveMs() const override { return m_lastActiveMs.get(); }
+    virtual void setNoteCacheBudget(int64 bytes) override { synth.setNoteCacheBudget(bytes); }
+    virtual void hibernateBanks() override;
+
     // my methods
-    void analyzeSample();
+    /** Start analysis of the sample in background. It returns immediately, the
+        current sound is played until the analysis is finished. Parameters analysed lately
+        are set up again from analysisHistory at once.
+        @param withPreview run fast preview analysis first, its partials are played
+                           until the full analysis replaces them */
+    void analyzeSample(bool withPreview = false);
+
+    /** Start analysis of the morph target sample in background, its partials are given to
+        the synth when it is finished. The morph target is removed if its path is empty. */
+    void analyzeMorphTarget();
+
+    /** Start analysis of samples of key zones in background, each zone is given to the synth
+        when its analysis is finished. Keys of no zone play the sample. */
+    void analyzeZones();
+
+    /** Detect pitch of the sample when it is analysed, pitch and frequency resolution
+        parameters are set by it. Call it before the sample path parameter is set.
+        @param samplePath path of newly selected sample */
+    void detectPitchOf(const String &samplePath);
 
     /** Is processor (analysis data) ready for synthesis? */
     bool isReady()
     {
-        return m_isReady;
+        return m_isReady.get() != 0;
+    }
+
+    /** Is analysis running (or waiting to run)? */
+    bool isAnalyzing()
+    {
+        const ScopedLock sl(analyzerLock);
+        return analysisPending;
+    }
+
+    /** Return true while the sample is analysed, with the part of the analysis done (0 to 1)
+        and an estimate of seconds left, negative until it can be estimated. */
+    bool getAnalysisProgress(double &progress, double &secondsLeft);
+
+    /** Render statistics of the blocks of about kRenderStatsIntervalMs of audio. */
+    struct RenderStats
+    {
+        float load = 0;             // Render time of the blocks against their duration, 1 misses the deadline
+        float peakLoad = 0;         // Highest load of a single block
+        int activeVoices = 0;       // Most voices rendering a block
+        int playingPartials = 0;    // Most partials playing in a block, all voices
+        int culledPartials = 0;     // Partials skipped above Nyquist, all blocks
+        int overruns = 0;           // Blocks whose load was above kRenderStatsRiskLoad
+        float partialSampleNs = 0;  // Render time of a sample of a playing partial, 0 if none played
+        int qualityTier = 0;        // Lowest LorisSynthesiser::QualityTier the governor set
+    };
+
+    /** Measure blocks and publish their statistics, the editor enables it while it is open.
+        Nothing is measured when it is disabled. Called from the message thread. */
+    void setRenderStatsEnabled(bool enabled)
+    {
+        if (!enabled)
+        {
+            m_renderStatsEnabled = 0;
+            return;
+        }
+        // stats of the last time it was enabled are dropped, the audio thread does not
+        // publish any while disabled
+        RenderStats stale;
+        while (renderStatsQueue.try_dequeue(stale)) {}
+        m_renderStatsEnabled = 1;
+    }
+
+    /** Pop the oldest statistics published by the audio thread, false if there are none.
+        Called from the message thread. */
+    bool popRenderStats(RenderStats &stats) { return renderStatsQueue.try_dequeue(stats); }
+    
+    /** Output for the scope of the editor, the mono mix decimated by kScopeDecimation and the
+        voices playing at the end of it. */
+    struct ScopeBlock
+    {
+        enum { kNumSamples = 512, kMaxVoices = kParameterPolyphony_maxValue };
+        float samples[kNumSamples];
+        uint16 voicePartials[kMaxVoices];   // Partials each voice played, 0 for silent voices
+        int numVoices;
+    };
+    
+    /** Publish the output for the scope, the editor enables it while it is open. The audio
+        thread only copies samples into a block and a full block into a queue. Called from the
+        message thread. */
+    void setScopeEnabled(bool enabled)
+    {
+        if (!enabled)
+        {
+            m_scopeEnabled = 0;
+            return;
+        }
+        ScopeBlock stale;
+        while (scopeQueue.try_dequeue(stale)) {}
+        m_scopeEnabled = 1;
     }
+    
+    /** Pop the oldest block published by the audio thread, false if there are none. Called
+        from the message thread. */
+    bool popScopeBlock(ScopeBlock &block) { return scopeQueue.try_dequeue(block); }
+    
+    /** Return the sample rate of the samples of scope blocks. */
+    double getScopeSampleRate() const { return getSampleRate() / kScopeDecimation; }
+    
+    /** Return statistics of the partial bank the voices play, see LorisSynthesiser::getStatistics().
+        Safe to call from any thread. */
+    Loris::RealTimeSynthesizer::Statistics getBankStatistics() const noexcept { return synth.getStatistics(); }
+    
+    /** Return the bank of partials the voices play, empty until the sample is analysed. */
+    Loris::PartialBank::Ptr getBank() const { return synth.getBank(); }
+    
+    /** Return the hash of the overview of the analysed sample in SampleOverviewCache, 0 if
+        there is none. Safe to call from any thread. */
+    int64 getOverviewHash() const { return m_overviewHash.get(); }
 
 private:
+    /** Key zone set by parameter, see kParameterKeyZones_name. */
+    struct KeyZone
+    {
+        int lowestNote = 0;
+        int highestNote = 127;
+        double pitch = 0;
+        String path;
+    };
+
+    /** Parse key zones parameter, invalid lines are skipped. */
+    static Array<KeyZone> parseKeyZones(const String &text);
+
+    // AsyncUpdater method, updates editor due to analysis state
+    void handleAsyncUpdate() override;
+
+    /** Play partials of finished preview analysis until the full analysis replaces them. */
+    void previewFinished(SampleAnalyzer *preview);
+    
+    /** Setup synth with analysis found in analysisHistory, called by analyzeSample(). */
+    void setupRecentAnalysis(const AnalysisHistory::Analysis &analysis);
+    
+    /** Setup synth with partials restored from state, no analysis is needed. */
+    void setupRestoredPartials(Loris::PartialList &partials);
+    
+    /** Give synth the loop set by user, or the loop markers of the sample if there is none. */
+    void updateLoop();
+
+    /** Give synth the spectral transforms set by parameters, see Loris::PartialModifiers. */
+    void updateModifiers();
+
+    /** Give synth the routing of per-note expression set by parameters, see ExpressionMatrix. */
+    void updateExpression();
+
+    /** Give synth the equalizer of the partials set by parameters, see Loris::PartialFilter. */
+    void updatePartialFilter();
+
+    /** Do analysis parameters differ from those of the latest requested analysis? */
+    bool analysisParametersChanged();
+
+    /** How stereo samples are mixed down for analysis, set by parameter. */
+    SampleAnalyzer::Downmix stereoDownmix();
+
+    /** Render voices on threads of the shared pool, on all cores if the host renders offline,
+        on the threads of the Render Threads parameter in real time. Do not call it from the
+        audio thread. */
+    void updateRenderThreads();
+    
+    /** Start, configure or stop the analysis of live input as parameters say, and report its
+        latency. The analysis is started again if restart is true, or if the frequency resolution
+        changed. Do not call it from the audio thread. */
+    void updateLiveInput(bool restart);
+
+    /** Add a block rendered in ticks of Time::getHighResolutionTicks() to renderStats,
+        publish them when they cover kRenderStatsIntervalMs. Called from the audio thread. */
+    void addRenderStats(int64 ticks, int numSamples) noexcept;
+    
+    /** Step the quality of the synth down when blocks rendered in ticks get close to their
+        deadline, up when there is headroom again. Called from the audio thread in real time. */
+    void updateQualityGovernor(int64 ticks, int numSamples) noexcept;
+    
+    /** Render at full quality again and forget the measured load. Called from the audio thread. */
+    void resetQualityGovernor() noexcept;
+    
+    /** Add the output of a block to scopeBlock, publish it when it is full. Called from the
+        audio thread. */
+    void addScopeSamples(const AudioSampleBuffer &buffer, int numSamples) noexcept;
+
     String loadedSamplePath;    // Path to actual data
-    bool m_isReady = false;     // Is processor (analysis data) ready for synthesis?
+    Atomic<int> m_isReady;      // Is processor (analysis data) ready for synthesis?
+    Atomic<int> m_isPlaying;    // Is any note or host transport playing?
+    Atomic<uint32> m_lastActiveMs; // Millisecond counter of the last block m_isPlaying was set in
+    Atomic<int64> m_overviewHash;  // Overview of the analysed sample, see getOverviewHash()
+    Atomic<int> m_partialThresholdChanged; // Synth has to prepare its banks again?
+    Atomic<int> m_phaseFreeChanged;        // Synth has to prepare its banks with or without phases?
+    Atomic<int> m_polyphonyChanged;        // Synth has to create or delete voices?
+    Atomic<int> m_loopChanged;             // Synth has to set up voices with new loop?
+    Atomic<int> m_analysisChanged;         // Sample has to be analysed again?
+    Atomic<int> m_pitchDetected;           // Detected pitch has to be set as parameter?
+    Atomic<int> m_morphTargetChanged;      // Morph target has to be analysed again?
+    Atomic<int> m_zonesChanged;            // Key zones have to be analysed again?
+    Atomic<int> m_renderModeChanged;       // Threads rendering voices have to be changed?
+    Atomic<int> m_freezeNotesChanged;      // Thread rendering notes has to be started?
+    Atomic<int> m_hibernate;               // Synth has to be compacted, see LorisSynthesiser::hibernate()
+    Atomic<int> m_liveInputChanged;        // Live analysis has to be started or stopped?
+    bool m_liveInput = kParameterLiveInput_defaultValue; // Is input resynthesised? Audio thread only
+    double liveResolution = 0;             // Resolution live input is analysed with, 0 when it is not,
+                                           // message thread only
+    bool m_hibernateWhenIdle = kParameterHibernate_defaultValue; // Is the synth compacted when idle? Audio thread only
+    int64 idleSamples = 0;                 // Samples since a note or the transport played, audio thread only
+    double m_sampleLoopStart = 0;          // Loop markers of the analysed sample, seconds
+    double m_sampleLoopEnd = 0;
+    double m_previewTime = 0;              // Seconds covered by the preview played, guarded by synthSetupLock
+    Atomic<int> m_renderStatsEnabled;      // Is the editor showing render statistics?
+    RenderStats renderStats;               // Statistics of the blocks not published yet, audio thread only
+    int renderStatsSamples = 0;            // Samples of the blocks in renderStats
+    double renderStatsPartialSamples = 0;  // Samples of playing partials of the blocks in renderStats
+    moodycamel::ReaderWriterQueue<RenderStats> renderStatsQueue { 64 }; // Published by the audio thread, read by the editor
+    bool m_adaptiveQuality = kParameterAdaptiveQuality_defaultValue; // Does the governor follow the load? Audio thread only
+    int governorTier = 0;                  // LorisSynthesiser::QualityTier set by the governor
+    float governorLoad = 0;                // Load of the blocks, smoothed over kGovernorSmoothingMs
+    int governorHeldSamples = 0;           // Samples since the tier changed
+    
+    enum { kScopeDecimation = 2 };         // Output samples averaged into a sample of the scope
+    Atomic<int> m_scopeEnabled;            // Is the editor showing the scope?
+    ScopeBlock scopeBlock;                 // Block being filled, audio thread only
+    int scopeBlockSamples = 0;             // Samples of scopeBlock filled
+    float scopeSum = 0;                    // Output samples averaged into the next scope sample
+    int scopeSumSamples = 0;
+    moodycamel::ReaderWriterQueue<ScopeBlock> scopeQueue { 16 }; // Published by the audio thread, read by the editor
 
     // the synth!
     LorisSynthesiser synth;     // Loris wrapper
-    SampleAnalyzer analyzer;    // Data analyzer and loader
-    WaitableEvent analyzerSync; // Wait for analyzer to finish
+    LiveResynthesiser live;     // Resynthesis of the input, see kParameterLiveInput_name
+
+    SharedResourcePointer<SharedFormatManager> formatManager; // For loading input data (audio files), shared by all instances
+    DecodedSampleCache  decodedSamples; // Beginnings of samples decoded once for all analysis jobs
+    AnalysisHistory analysisHistory;    // Analyses of the sample done lately, for switching parameters back
 
-    AudioFormatManager  formatManager; // For loading input data (audio files)
+    SharedResourcePointer<AnalysisScheduler> scheduler; // Runs SampleAnalyzer jobs of all instances
+    SharedResourcePointer<MemoryGovernor> memoryGovernor; // Keeps memory of all instances within a budget
+    SharedResourcePointer<EditorResources> editorResources; // Images of the editors of all instances
+    int analysisGeneration = 0;         // Generation of the latest requested analysis, results of older ones are dropped
+    bool analysisPending = false;       // Is the latest analysis not finished yet?
+    bool previewPending = false;        // Is preview of the latest analysis not finished yet?
+    double analysisProgressDone = 0;    // Part of the latest analysis done, see SampleAnalyzer::Listener::analysisProgress()
+    uint32 analysisStartMs = 0;         // Millisecond counter the latest analysis was requested at
+    int morphGeneration = 0;            // Generation of the latest requested morph target analysis
+    int zonesGeneration = 0;            // Generation of the latest requested key zone analyses
+    Array<KeyZone> keyZones;            // Key zones being analysed, zone i + 1 of synth is keyZones[i]
+    String analysedPath;                // Analysis parameters of the latest requested analysis,
+    double analysedPitch = 0;           // pitch and resolution are the detected ones once pitch
+    double analysedResolution = 0;      // is detected
+    bool analysedReverse = false;
+    SampleAnalyzer::Downmix analysedDownmix = SampleAnalyzer::downmixMax;
+    double analysedRegionStart = 0;
+    double analysedRegionEnd = 0;
+    String pitchDetectionPath;          // Sample whose pitch is detected by its analysis
+    CriticalSection analyzerLock;       // Guards analysis generation, pending flags and parameters
+    CriticalSection synthSetupLock;             // Older analysis can not override newer one
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParaphrasisAudioProcessor)
 };
@@ -22,18 +22,101 @@
  */
 
 #include "SampleAnalyzer.h"
+#include "AnalysisCache.h"
+#include "DecodedSampleCache.h"
+#include "AnalysisScheduler.h"
 
-#include "Analyzer.h"
 #include "Channelizer.h"
 #include "Distiller.h"
+#include "Fundamental.h"
+#include "LinearEnvelope.h"
+#include "LorisTrace.h"
+#include "PartialBank.h"
 #include "PartialUtils.h"
 #include "SdifFile.h"
 #include "PartialUtils.h" 
 
-SampleAnalyzer::SampleAnalyzer(AudioFormatManager &formatManager, WaitableEvent& syncObj, const String &name)
-    : ThreadWithProgressWindow(name, false, false),
+// How often partials finished so far are published while analysis runs.
+static const uint32 kPreviewIntervalMs = 250;
+
+// Part of the progress of a job taken by decoding and analysis of the sample, processing of
+// its partials takes the rest.
+static const double kAnalysisProgressShare = 0.9;
+
+// Preview analysis covers this many seconds of the sample at most.
+static const double kPreviewMaxSeconds = 4.;
+
+// Steady parts of the sound are analysed this many hops apart by preview analysis.
+static const double kPreviewHopFactor = 4.;
+
+// Onset of the sample is searched for in this many seconds of its beginning, it is where
+// the sample gets louder than this fraction of the peak level found there.
+static const double kPitchOnsetSearchSeconds = 1.;
+static const float kPitchOnsetLevel = 0.1f;
+
+// Pitch is detected in this many seconds after the attack following the onset.
+static const double kPitchAttackSeconds = 0.05;
+static const double kPitchWindowSeconds = 0.3;
+
+// Pitch is estimated this many times in its window, the most confident estimate is taken
+// if it is confident enough.
+static const int kPitchNumEstimates = 6;
+static const double kPitchMinConfidence = 0.5;
+
+// Main lobe width of the pitch detection window, below the lowest pitch to resolve harmonics.
+static const double kPitchWindowWidthHz = 0.8 * kParameterSamplePitch_minValue;
+
+// Beginning of the sample decoded once for pitch detection, preview and full analysis.
+static const double kDecodedHeadSeconds = jmax(kPreviewMaxSeconds,
+                                               kPitchOnsetSearchSeconds + kPitchAttackSeconds + kPitchWindowSeconds);
+
+// Region of the sample is read with a margin of this many periods of the frequency resolution
+// around it (more than half of the analysis window), so partials crossing its ends are
+// analysed as in the whole sample.
+static const double kRegionMarginPeriods = 4.;
+
+// Sample not decoded whole by its analysis is read in chunks of this many samples for its overview.
+static const int kOverviewChunkSamples = 65536;
+
+// Mono mix analysed by one pass of the analysis, and the channel its partials are played in.
+struct AnalysisPass
+{
+    SampleAnalyzer::Downmix downmix;
+    Loris::PartialStruct::Channel channel;
+};
+
+// Return true if the downmix analyses two mixes of a stereo sample.
+static bool isTwoPass(SampleAnalyzer::Downmix downmix)
+{
+    return downmix == SampleAnalyzer::downmixStereo || downmix == SampleAnalyzer::downmixMidSide;
+}
+
+// Fill passes analysing a sample with given number of channels, return their number.
+static int analysisPasses(SampleAnalyzer::Downmix downmix, int numChannels, AnalysisPass passes[2])
+{
+    if (numChannels < 2 || !isTwoPass(downmix))
+    {
+        // mono sample has nothing to be played apart
+        passes[0].downmix = isTwoPass(downmix) ? SampleAnalyzer::downmixMid : downmix;
+        passes[0].channel = Loris::PartialStruct::Center;
+        return 1;
+    }
+    
+    const bool stereo = downmix == SampleAnalyzer::downmixStereo;
+    passes[0].downmix = stereo ? SampleAnalyzer::downmixLeft : SampleAnalyzer::downmixMid;
+    passes[0].channel = stereo ? Loris::PartialStruct::Left : Loris::PartialStruct::Center;
+    passes[1].downmix = stereo ? SampleAnalyzer::downmixRight : SampleAnalyzer::downmixSide;
+    passes[1].channel = stereo ? Loris::PartialStruct::Right : Loris::PartialStruct::Side;
+    return 2;
+}
+
+//==============================================================================
+SampleAnalyzer::SampleAnalyzer(AudioFormatManager &formatManager, DecodedSampleCache &decodedSamples,
+                               Listener &listener, const String &name)
+    : ThreadPoolJob(name),
       formatManager(formatManager),
-      analyzerSync(syncObj)
+      decodedSamples(decodedSamples),
+      listener(listener)
 {
 
 }
@@ -44,10 +127,29 @@ SampleAnalyzer::~SampleAnalyzer()
 }
 
 //==============================================================================
-void SampleAnalyzer::run() noexcept
+String SampleAnalyzer::settingsKey() const
+{
+    const File file(m_samplePath);
+    const String fileKey = file.getFullPathName() + "-" + String::toHexString(file.getSize())
+                           + "-" + String::toHexString(file.getLastModificationTime().toMilliseconds());
+    
+    return AnalysisCache::createKey(fileKey, m_resolution, m_pitch, reverse, downmix, roundToInt(m_ceiling),
+                                    m_regionStart, m_regionEnd, roundToInt(m_shortWindowAbove), m_transientHop,
+                                    m_harmonicAnalysis);
+}
+
+//==============================================================================
+ThreadPoolJob::JobStatus SampleAnalyzer::runJob() noexcept
 {
-    buffer.clear();
     sampleRate = 0;
+    m_cacheKey = String::empty;
+    m_overviewHash = 0;
+    overview = nullptr;
+    m_loopStart = m_loopEnd = 0;
+    m_noiseBands = nullptr;
+    m_analysedTime = 0;
+    stageTimes = String::empty;
+    reportProgress(0);
     
     //TODO: loading should be controlled by exceptions not by bool functions...
     if ( !m_samplePath.isEmpty() )
@@ -60,28 +162,137 @@ void SampleAnalyzer::run() noexcept
         }
         else
 #endif
-            if ( loadAudioFile() )
         {
-            postProcessPartials();
-        }
-        else
-        {
-             NativeMessageBox::showMessageBoxAsync(AlertWindow::WarningIcon, "Ooops...", "Paraphrasis can not load file, sorry...");
+            // loop is not cached with partials, markers are read from the file header only
+            readLoop();
+            
+            // content is hashed for the cache key, and for the index of samples analysed in
+            // batch only if there is one
+            AnalysisCache cache;
+            String contentKey;
+            if ( !preview || (detect && cache.hasIndex()) )
+                contentKey = AnalysisCache::createContentKey(File(m_samplePath));
+            
+            // newly selected sample, its analysis and cache key depend on the detected pitch,
+            // sample analysed in batch takes the pitch it was analysed at, so its key is found
+            if ( detect && !reverse && contentKey.isNotEmpty()
+                 && cache.readIndexedPitch(contentKey, downmix, m_pitch, m_resolution) )
+                listener.pitchDetected(this);
+            else if ( detect && detectPitch() && !shouldExit() )
+                listener.pitchDetected(this);
+            
+            if ( preview )
+            {
+                // full analysis reads the cache and reports failures
+                if ( loadAudioFile() )
+                    postProcessPartials();
+                
+                logStageTimes();
+                if ( !shouldExit() )
+                    listener.analysisFinished(this);
+                
+                return jobHasFinished;
+            }
+            
+            // editor draws the main sample from its overview, built by the analysis if missing
+            if ( m_zone == 0 && !morphTarget && contentKey.isNotEmpty() )
+                m_overviewHash = SampleOverviewCache::createHash(contentKey, reverse, downmix);
+            
+            // reopened project does not need to analyze the same sample again, instances
+            // asking for the same analysis at once get partials of the first one
+            const String cacheKey = contentKey.isEmpty() ? String::empty
+                                    : AnalysisCache::createKey(contentKey, m_resolution, m_pitch, reverse, downmix,
+                                                               roundToInt(m_ceiling), m_regionStart, m_regionEnd,
+                                                               roundToInt(m_shortWindowAbove), m_transientHop,
+                                                               m_harmonicAnalysis);
+            
+            // banks of the analysis are loaded again from BankLibrary by these settings
+            AnalysisCache::Source source;
+            source.samplePath = m_samplePath;
+            source.pitchHz = m_pitch;
+            source.resolutionHz = m_resolution;
+            source.reverse = reverse;
+            source.downmix = downmix;
+            source.ceilingHz = roundToInt(m_ceiling);
+            source.regionStart = m_regionStart;
+            source.regionEnd = m_regionEnd;
+            source.shortWindowHz = roundToInt(m_shortWindowAbove);
+            source.transientHop = m_transientHop;
+            source.harmonic = m_harmonicAnalysis;
+            
+            beginStage("Reading cache...");
+            if ( cacheKey.isNotEmpty() && cache.read(cacheKey, m_partials) )
+            {
+                postProcessPartials();
+                m_noiseBands = cache.readNoiseBands(cacheKey);
+                m_cacheKey = cacheKey;
+                
+                // analysed in batch or before sources were stored
+                AnalysisCache::Source stored;
+                if ( !cache.readSource(cacheKey, stored) || stored.samplePath != m_samplePath )
+                    cache.writeSource(cacheKey, source);
+            }
+            else if ( cacheKey.isNotEmpty() && registry->join(cacheKey, *this, m_partials) )
+            {
+                m_cacheKey = cacheKey; // post-processed and cached by the job which analysed them
+            }
+            else if ( loadAudioFile() )
+            {
+                postProcessPartials();
+                
+                if ( cacheKey.isNotEmpty() && !shouldExit() )
+                {
+                    beginStage("Writing cache...");
+                    cache.write(cacheKey, m_partials);
+                    if ( m_noiseBands )
+                        cache.writeNoiseBands(cacheKey, *m_noiseBands);
+                    cache.writeSource(cacheKey, source);
+                    m_cacheKey = cacheKey;
+                }
+            }
+            else if ( !shouldExit() )
+            {
+                NativeMessageBox::showMessageBoxAsync(AlertWindow::WarningIcon, "Ooops...", "Paraphrasis can not load file, sorry...");
+            }
+            
+            // jobs waiting for this analysis analyse the sample themselves if it was stopped
+            if ( cacheKey.isNotEmpty() )
+                registry->publish(cacheKey, *this, shouldExit() ? Loris::PartialList() : m_partials);
+            
+            cacheOverview();
         }
     }
-    analyzerSync.signal();
+    
+    logStageTimes();
+    
+    // newer analysis was requested, nobody is interested in this result
+    if ( !shouldExit() )
+        listener.analysisFinished(this);
+    
+    return jobHasFinished;
 }
 
 //==============================================================================
 bool SampleAnalyzer::loadSdif() noexcept
 {
+    beginStage("Reading SDIF...");
     try
     {
-        Loris::SdifFile sdifFile(m_samplePath.toStdString());
+        Loris::SdifFile sdifFile(m_samplePath.toStdString(), numThreads); // partials are built on the cores of the job
     
         m_partials.clear();
         m_partials = std::move(sdifFile.partials());
         
+        // loop markers are stored by name
+        for (const Loris::Marker &marker : sdifFile.markers())
+        {
+            const String name = String(marker.name()).removeCharacters(" _-");
+            if (name.equalsIgnoreCase("LoopStart"))
+                m_loopStart = marker.time();
+            else if (name.equalsIgnoreCase("LoopEnd"))
+                m_loopEnd = marker.time();
+        }
+        
         return true;
     }
     catch (...) { }
@@ -89,93 +300,578 @@ bool SampleAnalyzer::loadSdif() noexcept
     return false;
 }
 
+//==============================================================================
+void SampleAnalyzer::readLoop() noexcept
+{
+    ScopedPointer<AudioFormatReader> reader (formatManager.createReaderFor (File(m_samplePath)));
+    
+    if (reader == nullptr || reader->sampleRate <= 0)
+        return;
+    
+    const StringPairArray &metadata = reader->metadataValues;
+    int64 start = 0;
+    int64 end = 0;
+    
+    if (metadata.getValue("Loop0Start", String::empty).isNotEmpty())
+    {
+        // WAV sample chunk, its end sample is played too
+        start = metadata["Loop0Start"].getLargeIntValue();
+        end = metadata["Loop0End"].getLargeIntValue() + 1;
+    }
+    else if (metadata["Loop0Type"].getIntValue() != 0)
+    {
+        // AIFF sustain loop, its ends are markers
+        const int startIdentifier = metadata["Loop0StartIdentifier"].getIntValue();
+        const int endIdentifier = metadata["Loop0EndIdentifier"].getIntValue();
+        const int numCues = metadata["NumCuePoints"].getIntValue();
+        
+        for (int i = 0; i < numCues; i++)
+        {
+            const String prefixCue ("Cue" + String (i));
+            const int identifier = metadata[prefixCue + "Identifier"].getIntValue();
+            if (identifier == startIdentifier)
+                start = metadata[prefixCue + "Offset"].getLargeIntValue();
+            if (identifier == endIdentifier)
+                end = metadata[prefixCue + "Offset"].getLargeIntValue();
+        }
+    }
+    
+    if (end <= start)
+        return;
+    
+    if (reverse)
+    {
+        const int64 reversedStart = reader->lengthInSamples - end;
+        end = reader->lengthInSamples - start;
+        start = reversedStart;
+    }
+    
+    // markers are timed from the start of the analysed region, loop out of it is dropped
+    const double regionEnd = m_regionEnd > 0 ? m_regionEnd : reader->lengthInSamples / reader->sampleRate;
+    if (start / reader->sampleRate < m_regionStart || end / reader->sampleRate > regionEnd)
+        return;
+    
+    m_loopStart = start / reader->sampleRate - m_regionStart;
+    m_loopEnd = end / reader->sampleRate - m_regionStart;
+}
+
+//==============================================================================
+void SampleAnalyzer::trimToRegion(Loris::PartialList &partials) const
+{
+    if (regionOffset > 0)
+        Loris::PartialUtils::shiftTime(partials.begin(), partials.end(), -regionOffset);
+    Loris::PartialUtils::crop(partials.begin(), partials.end(), 0, regionLength);
+    partials.remove_if([](const Loris::Partial &partial) { return partial.numBreakpoints() == 0; });
+}
+
+//==============================================================================
+void SampleAnalyzer::configureHop(Loris::Analyzer &analyzer) const
+{
+    // previews skip frames between transients at the hop of the resolution already
+    if (preview || m_transientHop <= 0 || m_transientHop >= analyzer.hopTime())
+        return;
+    
+    analyzer.setCoarseHopTime(analyzer.hopTime());
+    analyzer.setHopTime(m_transientHop);
+}
+
 //==============================================================================
 void SampleAnalyzer::postProcessPartials() noexcept
 {
-    setStatusMessage("Processing partials...");
+    LORIS_TRACE_ZONE("SampleAnalyzer::postProcessPartials");
+    beginStage("Processing partials...");
+    reportProgress(kAnalysisProgressShare);
+    processPartials(m_partials, true);
+    reportProgress(1);
+}
 
-    // partials in partial list will be sorted by start time
-    m_partials.sort(Loris::PartialUtils::compareStartTimeLess());
+//==============================================================================
+void SampleAnalyzer::processPartials(Loris::PartialList &partials, bool withProgress)
+{
+    // superseded job does not process partials nobody is interested in
+    if (shouldExit())
+        return;
+    
+    // labels of partials analysed in two passes tell their channel
+    if (!isTwoPass(downmix))
+    {
+        // chanelize - mark partial by the harmonic it follows
+        Loris::Channelizer channelizer(m_pitch);
+        channelizer.setNumThreads(numThreads);
+        channelizer.channelize(partials.begin(), partials.end());
+        
+        if (shouldExit())
+            return;
         
-    // chanelize - mark partial - not needed now
-    Loris::Channelizer channelizer(m_pitch);
-    channelizer.channelize(m_partials.begin(), m_partials.end());
+        if (withProgress)
+            reportProgress(0.5 * (1 + kAnalysisProgressShare));
+        
+        // partials of each harmonic are distilled into one, the synthesiser plays far
+        // less of them
+        Loris::Distiller distiller;
+        distiller.setNumThreads(numThreads);
+        distiller.distill(partials);
+        
+        if (shouldExit())
+            return;
+    }
     
-//    Loris::Distiller dist;
-//    dist.distill(m_partials);
+    // partials in partial list will be sorted by start time
+    partials.sort(Loris::PartialUtils::compareStartTimeLess());
 }
 
 //==============================================================================
-bool SampleAnalyzer::loadAudioFile() noexcept
+void SampleAnalyzer::beginStage(const String &name) noexcept
 {
-    AudioFormatReader* reader = formatManager.createReaderFor (File(m_samplePath));
+    const double now = Time::getMillisecondCounterHiRes();
+    if (stageName.isNotEmpty())
+        stageTimes << stageName.upToFirstOccurrenceOf("...", false, false) << " " << String(now - stageStartMs, 1) << " ms, ";
     
-    if (reader == nullptr)
+    stageName = name;
+    stageStartMs = now;
+    if (name.isNotEmpty())
+        setJobName(name);
+}
+
+//==============================================================================
+void SampleAnalyzer::logStageTimes() noexcept
+{
+    beginStage(String::empty);
+    if (stageTimes.isEmpty() || shouldExit())
+        return;
+    
+    // where the time of slow samples goes
+    Logger::writeToLog("Paraphrasis: " + File(m_samplePath).getFileName()
+                       + (preview ? " preview: " : ": ") + stageTimes.dropLastCharacters(2));
+}
+
+//==============================================================================
+void SampleAnalyzer::reportProgress(double progress) noexcept
+{
+    listener.analysisProgress(this, jlimit(0., 1., progress));
+}
+
+//==============================================================================
+void SampleAnalyzer::pace() const
+{
+    // threads of the analyzer are started by it, each lowers its priority once
+    static thread_local bool background = false;
+    if (!background)
     {
-        return false;
+        AnalysisScheduler::setBackgroundPriority();
+        background = true;
     }
     
-    // check if user really wants to load a long sample
-    if (reader->lengthInSamples / reader->sampleRate > 20)
+    if (scheduler != nullptr && scheduler->isAudioLoadHigh())
+        Thread::sleep(AnalysisScheduler::kPaceSleepMs);
+}
+
+//==============================================================================
+void SampleAnalyzer::partialsFinished(const Loris::PartialList &finished, double time)
+{
+    for (const Loris::Partial &partial : finished)
     {
-        bool result = NativeMessageBox::showOkCancelBox(AlertWindow::QuestionIcon, "Do you...?", "Do you REALLY want to load sample longer than 20 sec?");
+        finishedPartials.push_back(partial);
+        finishedPartials.back().setLabel(passLabel);
+    }
+    
+    // analysed part of the sample, passes of a stereo sample take their share each
+    if (analysisLength > 0)
+        reportProgress(kAnalysisProgressShare * (pass + jmin(1., time / analysisLength)) / numPasses);
+    
+    // every preview rebuilds the synthesiser, so do not publish too often, morph
+    // target and key zones are not worth playing before they are finished
+    const uint32 now = Time::getMillisecondCounter();
+    if (finishedPartials.empty() || shouldExit() || morphTarget || m_zone > 0 || now - lastPreviewTime < kPreviewIntervalMs)
+        return;
+    
+    lastPreviewTime = now;
+    m_analysedTime = jlimit(0., regionLength, time - regionOffset);
+    
+    Loris::PartialList preview(finishedPartials);
+    trimToRegion(preview);
+    processPartials(preview);
+    listener.analysisProgressed(this, preview);
+}
+
+//==============================================================================
+/**
+ Feeds Loris analyzer with mono samples read from audio file reader chunk by chunk,
+ so the file is never loaded whole. Stereo is mixed down (see SampleAnalyzer::Downmix),
+ reversed sample is read backwards. Reading stops when the analysis job is asked to exit.
+ Beginning of the sample decoded before (see DecodedSampleCache) is not decoded again.
+ Samples read may build the overview of the sample too (see SampleOverviewCache).
+ */
+class ReaderSampleSource : public Loris::Analyzer::SampleSource
+{
+public:
+    /** @param length number of samples read from the (reversed) sample, not more than its length
+        @param head samples of the (reversed) sample decoded from its beginning, may be empty
+        @param offset first sample of the (reversed) sample read, the source starts there
+        @param overview builder of the overview samples read are added to, may be null */
+    ReaderSampleSource(AudioFormatReader &reader, int64 length, bool reverse, SampleAnalyzer::Downmix downmix,
+                       ThreadPoolJob &job, const DecodedSampleCache::Samples &head = DecodedSampleCache::Samples(),
+                       int64 offset = 0, SampleOverviewCache::Builder *overview = nullptr)
+        : reader(reader), job(job), length(length), offset(offset), reverse(reverse), downmix(downmix), head(head),
+          overview(overview)
+    {
+    }
+    
+    long numSamples() const override    { return (long) length; }
+    
+    bool read(long start, long count, float *dest) override
+    {
+        if (job.shouldExit())
+            return false;
         
-        if ( !result )
+        start += (long) offset;
+        const int num = (int) count;
+        
+        if (head != nullptr && start + count <= (long) head->size())
+            std::copy(head->begin() + start, head->begin() + start + count, dest);
+        else
+            decode(start, num, dest);
+        
+        if (overview != nullptr)
+            overview->addSamples(start, dest, num);
+        
+        return true;
+    }
+    
+private:
+    void decode(long start, int num, float *dest)
+    {
+        // reversed sample is the file read backwards
+        const int64 readerStart = reverse ? reader.lengthInSamples - start - num : start;
+        
+        if (reader.numChannels < 2 || downmix == SampleAnalyzer::downmixLeft || downmix == SampleAnalyzer::downmixRight)
         {
-            delete reader;
-            return false;
+            // single channel is decoded right into dest
+            AudioSampleBuffer channel(&dest, 1, num);
+            const bool right = downmix == SampleAnalyzer::downmixRight;
+            reader.read(&channel, 0, num, readerStart, !right, right);
         }
+        else
+        {
+            fileSamples.setSize(2, num, false, false, true);
+            reader.read(&fileSamples, 0, num, readerStart, true, true);
+            
+            const float *left = fileSamples.getReadPointer(0);
+            const float *right = fileSamples.getReadPointer(1);
+            
+            if (downmix == SampleAnalyzer::downmixMid)
+            {
+                FloatVectorOperations::add(dest, left, right, num);
+                FloatVectorOperations::multiply(dest, 0.5f, num);
+            }
+            else if (downmix == SampleAnalyzer::downmixSide)
+            {
+                FloatVectorOperations::subtract(dest, left, right, num);
+                FloatVectorOperations::multiply(dest, 0.5f, num);
+            }
+            else
+            {
+                // huh strange stereo to mono algorith which seems to be working...
+                // credits or inspiration: http://www.dsprelated.com/showmessage/106421/2.php
+                // (branch-free loop over plain pointers, vectorised by the compiler)
+                for (int i = 0; i < num; i++)
+                    dest[i] = std::max(left[i], right[i]);
+            }
+        }
+        
+        if (reverse)
+            std::reverse(dest, dest + num);
     }
     
-    // read samples
-    setStatusMessage("Reading file...");
-    AudioSampleBuffer fileSamples(2, reader->lengthInSamples);
-    reader->read(&fileSamples, 0, reader->lengthInSamples, 0, true, true);
+    AudioFormatReader &reader;
+    ThreadPoolJob &job;
+    int64 length;
+    int64 offset;
+    bool reverse;
+    SampleAnalyzer::Downmix downmix;
+    DecodedSampleCache::Samples head;
+    SampleOverviewCache::Builder *overview;
+    AudioSampleBuffer fileSamples;
+};
+
+//==============================================================================
+DecodedSampleCache::Samples SampleAnalyzer::decodeHead(AudioFormatReader &reader, Downmix downmix) noexcept
+{
+    const File file (m_samplePath);
+    DecodedSampleCache::Samples head = decodedSamples.find(file, reverse, downmix);
     
-    // reverse
-    if (reverse)
-        fileSamples.reverse(0, reader->lengthInSamples);
+    if (head != nullptr || reader.sampleRate <= 0)
+        return head;
+    
+    const long numSamples = (long) jmin(reader.lengthInSamples, (int64) (kDecodedHeadSeconds * reader.sampleRate));
+    if (numSamples <= 0)
+        return head;
+    
+    std::shared_ptr<std::vector<float>> samples = std::make_shared<std::vector<float>>((size_t) numSamples);
+    ReaderSampleSource source(reader, reader.lengthInSamples, reverse, downmix, *this);
+    if (!source.read(0, numSamples, samples->data()))
+        return head;
     
-    // mono -> stereo
-    if (reader->numChannels == 2 && fileSamples.getNumChannels() == 2)
+    head = samples;
+    decodedSamples.add(file, reverse, downmix, head);
+    return head;
+}
+
+//==============================================================================
+bool SampleAnalyzer::detectPitch() noexcept
+{
+    ScopedPointer<AudioFormatReader> reader (formatManager.createReaderFor (File(m_samplePath)));
+    
+    if (reader == nullptr || reader->sampleRate <= 0)
+        return false;
+    
+    // sample analysed in two passes has the pitch of their sum
+    beginStage("Detecting pitch...");
+    const DecodedSampleCache::Samples head = decodeHead(*reader, isTwoPass(downmix) ? downmixMid : downmix);
+    
+    if (head == nullptr)
+        return false;
+    
+    const double rate = reader->sampleRate;
+    const std::vector<float> &samples = *head;
+    const long numSamples = jmin((long) samples.size(),
+                                 (long) ((kPitchOnsetSearchSeconds + kPitchAttackSeconds + kPitchWindowSeconds) * rate));
+    
+    // onset is where the sample gets loud, silence before it has no pitch
+    const long searchEnd = jmin(numSamples, (long) (kPitchOnsetSearchSeconds * rate));
+    float peak = 0;
+    for (long i = 0; i < searchEnd; i++)
+        peak = jmax(peak, std::abs(samples[i]));
+    
+    if (peak <= 0)
+        return false;
+    
+    long onset = 0;
+    while (onset < searchEnd && std::abs(samples[onset]) < kPitchOnsetLevel * peak)
+        onset++;
+    
+    // most confident of the estimates in the window after the attack
+    const std::vector<double> window(samples.begin() + onset, samples.begin() + numSamples);
+    const double windowStart = jmin(kPitchAttackSeconds, 0.5 * window.size() / rate);
+    const double windowLength = jmin(kPitchWindowSeconds, window.size() / rate - windowStart);
+    
+    double bestPitch = 0;
+    double bestConfidence = 0;
+    try
     {
-        // huh strange stereo to mono algorith which seems to be working...
-        // credits or inspiration: http://www.dsprelated.com/showmessage/106421/2.php
-        int64 numSamples = fileSamples.getNumSamples();
-        for (int i = 0; i < numSamples; i++)
+        Loris::FundamentalFromSamples estimator(kPitchWindowWidthHz);
+        for (int i = 0; i < kPitchNumEstimates && !shouldExit(); i++)
         {
-            *fileSamples.getWritePointer(0, i) = std::max(*fileSamples.getReadPointer(0, i), *fileSamples.getReadPointer(1, i));
+            const double time = windowStart + windowLength * (i + 0.5) / kPitchNumEstimates;
+            const Loris::F0Estimate estimate = estimator.estimateAt(window, rate, time,
+                                                                    kParameterSamplePitch_minValue,
+                                                                    kParameterSamplePitch_maxValue);
+            if (estimate.confidence() > bestConfidence)
+            {
+                bestPitch = estimate.frequency();
+                bestConfidence = estimate.confidence();
+            }
         }
     }
+    catch (...)
+    {
+        return false;
+    }
+    
+    if (shouldExit() || bestConfidence < kPitchMinConfidence)
+        return false;
+    
+    m_pitch = jlimit<double>(kParameterSamplePitch_minValue, kParameterSamplePitch_maxValue, bestPitch);
+    m_resolution = jlimit<double>(kParameterFrequencyResolution_minValue, kParameterFrequencyResolution_maxValue,
+                                  kDefaultPitchResolutionRation * m_pitch);
+    
+    return true;
+}
+
+//==============================================================================
+bool SampleAnalyzer::loadAudioFile() noexcept
+{
+    ScopedPointer<AudioFormatReader> reader (formatManager.createReaderFor (File(m_samplePath)));
+    
+    if (reader == nullptr)
+    {
+        return false;
+    }
     
-    // delete reader ASAP so we dont forget and prevent memory leaks
-    int64 lengthInSamples = reader->lengthInSamples;
     sampleRate = reader->sampleRate;
-    delete reader;
-    reader = nullptr;
     
-    // transform data from JUCE to Loris (from float to double)
-    buffer.reserve(lengthInSamples);
-    const float *sample = fileSamples.getReadPointer(0);
-    for (int i = 0; i < lengthInSamples; i++)
+    // samples are read as analysis goes, memory does not depend on sample length
+    beginStage("Analyzing sample...");
+    const int64 regionStart = jlimit((int64) 0, reader->lengthInSamples, (int64) (m_regionStart * sampleRate));
+    int64 regionEnd = m_regionEnd > 0 ? jlimit(regionStart, reader->lengthInSamples, (int64) (m_regionEnd * sampleRate))
+                                      : reader->lengthInSamples;
+    if (preview)
+        regionEnd = jmin(regionEnd, regionStart + (int64) (kPreviewMaxSeconds * sampleRate));
+    
+    // only the region is decoded and analysed, with a margin around it, starting at a frame
+    // of the whole sample so frames of the analyses before are found (see AnalysisFrameCache)
+    Loris::Analyzer configured(m_resolution);
+    configured.setFrequencyCeiling(m_ceiling);
+    configureHop(configured);
+    const int64 spacing = configured.frameSpacing(sampleRate);
+    const int64 margin = (int64) (kRegionMarginPeriods / m_resolution * sampleRate);
+    const int64 readStart = jmax((int64) 0, regionStart - margin) / spacing * spacing;
+    const int64 length = jmin(reader->lengthInSamples, regionEnd + margin) - readStart;
+    regionOffset = (regionStart - readStart) / sampleRate;
+    regionLength = (regionEnd - regionStart) / sampleRate;
+    analysisLength = length / sampleRate;
+    
+    // stereo sample may be analysed in two passes, partials of each are labeled by their channel
+    AnalysisPass passes[2];
+    numPasses = analysisPasses(downmix, (int) reader->numChannels, passes);
+    Loris::PartialList analysed;
+    Loris::NoiseBands::Ptr noiseBands;
+    finishedPartials.clear();
+    
+    // overview is built from the first pass, it is complete if its reads cover the whole sample
+    if ( m_overviewHash != 0 && !overviews->contains(m_overviewHash) )
+        overview = new SampleOverviewCache::Builder(formatManager, *overviews, sampleRate, reader->lengthInSamples);
+    
+    for (int i = 0; i < numPasses; i++)
     {
-        buffer.push_back(sample[i]);
+        Loris::Analyzer analyzer(m_resolution);
+        analyzer.setNumThreads(numThreads);
+        analyzer.buildFundamentalEnv(false); // envelopes are never read, frames do not pay for them
+        analyzer.buildAmpEnv(false);
+        analyzer.buildNoiseBands(!preview && i == 0);
+        analyzer.setFrequencyCeiling(m_ceiling);
+        if (m_shortWindowAbove > 0)
+            analyzer.addWindowBand(m_shortWindowAbove, 2 * analyzer.windowWidth());
+        configureHop(analyzer);
+        if (m_harmonicAnalysis)
+            analyzer.setHarmonicFundamental(Loris::LinearEnvelope(m_pitch));
+        pass = i;
+        passLabel = Loris::PartialStruct::channelLabel(passes[i].channel);
+        AnalysisFrameCache::Frames frames;
+        
+        if (preview)
+        {
+            // beginning of the sample, transients keep the full hop, no bandwidth
+            analyzer.setCoarseHopTime(kPreviewHopFactor * analyzer.hopTime());
+            analyzer.storeNoBandwidth();
+        }
+        else
+        {
+            // publish partials finished so far while analysis goes, with the passes before
+            lastPreviewTime = Time::getMillisecondCounter();
+            analyzer.setProgressListener(this);
+            
+            // frames the analysis before extracted are not transformed again
+            frames = frameCaches->take(File(m_samplePath), reverse, passes[i].downmix);
+            frames->setOrigin((long) readStart);
+            analyzer.setFrameCache(frames.get());
+        }
+        
+        // beginning of the sample is decoded once for all jobs analysing it
+        ReaderSampleSource source(*reader, length, reverse, passes[i].downmix, *this,
+                                  decodeHead(*reader, passes[i].downmix), readStart,
+                                  i == 0 ? overview.get() : nullptr);
+        analyzer.setCancellation(this);
+        
+        try
+        {
+            analyzer.analyze(source, sampleRate);
+        }
+        catch (...)
+        {
+            finishedPartials.clear();
+            return false;
+        }
+        
+        // frames extracted before the analysis was stopped are found by the next one too
+        if (frames)
+            frameCaches->put(File(m_samplePath), reverse, passes[i].downmix, frames);
+        
+        if (shouldExit())
+            break;
+        
+        if (i == 0)
+            noiseBands = analyzer.noiseBands().share();
+        
+        for (Loris::Partial &partial : analyzer.partials())
+            partial.setLabel(passLabel);
+        analysed.splice(analysed.end(), analyzer.partials());
+        
+        if (!preview && i + 1 < numPasses)
+            finishedPartials = analysed;
     }
     
-    analyze();
+    finishedPartials.clear();
+    
+    if (shouldExit())
+        return false;
+    
+    m_partials.clear();
+    m_partials = std::move(analysed);
+    trimToRegion(m_partials);
+    
+    if (noiseBands && !noiseBands->empty())
+    {
+        // frames of the margins are dropped with the partials
+        Loris::NoiseBands trimmed;
+        for (std::size_t f = 0; f < noiseBands->numFrames(); f++)
+        {
+            const double time = noiseBands->frameTime(f) - regionOffset;
+            if (time >= 0 && time <= regionLength)
+                trimmed.addFrame(time, noiseBands->frameEnergies(f));
+        }
+        
+        if (!trimmed.empty())
+            m_noiseBands = trimmed.share();
+    }
+    m_analysedTime = regionLength;
     
     return true;
 }
 
 //==============================================================================
-void SampleAnalyzer::analyze() noexcept
+void SampleAnalyzer::cacheOverview() noexcept
 {
-    // analyze
-    setStatusMessage("Anayzing sample...");
-    Loris::Analyzer analyzer(m_resolution);
-    analyzer.analyze(buffer, sampleRate);
+    ScopedPointer<SampleOverviewCache::Builder> built (overview.release());
     
-    m_partials.clear();
-    m_partials = std::move(analyzer.partials());
+    if (m_overviewHash == 0 || overviews->contains(m_overviewHash))
+        return;
     
-}
\ No newline at end of file
+    if (shouldExit())
+    {
+        m_overviewHash = 0;
+        return;
+    }
+    
+    // partials came from the cache or only a region was analysed, the sample is read once
+    // more for its overview, it is cached after that
+    if (built == nullptr || !built->isComplete())
+    {
+        ScopedPointer<AudioFormatReader> reader (formatManager.createReaderFor (File(m_samplePath)));
+        if (reader == nullptr || reader->sampleRate <= 0)
+        {
+            m_overviewHash = 0;
+            return;
+        }
+        
+        beginStage("Drawing overview...");
+        AnalysisPass passes[2];
+        analysisPasses(downmix, (int) reader->numChannels, passes);
+        built = new SampleOverviewCache::Builder(formatManager, *overviews, reader->sampleRate, reader->lengthInSamples);
+        ReaderSampleSource source(*reader, reader->lengthInSamples, reverse, passes[0].downmix, *this,
+                                  decodedSamples.find(File(m_samplePath), reverse, passes[0].downmix), 0, built);
+        
+        HeapBlock<float> chunk (kOverviewChunkSamples);
+        for (int64 start = 0; start < reader->lengthInSamples; start += kOverviewChunkSamples)
+        {
+            const long count = (long) jmin((int64) kOverviewChunkSamples, reader->lengthInSamples - start);
+            if (!source.read((long) start, count, chunk))
+                break;
+        }
+    }
+    
+    if (built->isComplete() && !shouldExit())
+        overviews->storeThumb(built->getThumbnail(), m_overviewHash);
+    else
+        m_overviewHash = 0;
+}
@@ -25,25 +25,90 @@
 
 #include "JuceHeader.h"
 #include "ParameterDefitions.h"
+#include "Analyzer.h"
 #include "PartialList.h"
+#include "DecodedSampleCache.h"
+#include "AnalysisCache.h"
+#include "AnalysisFrameCache.h"
+#include "SampleOverviewCache.h"
+
+class AnalysisScheduler;
 
 /**
  Sample analyzer reads audio files and converts it into Loris::PartialList. It can reverse loaded sample.
- Analysis runs in another thread.
+ Analysis runs as a job of ThreadPool, so it does not block the thread which asked for it.
+ Partials finished so far are published periodically while the analysis runs, so the sound
+ can be played before it is analysed completely.
+ 
+ Analysis stops within one frame when the job is asked to exit, partials of such analysis
+ are not processed nor published.
+ 
+ Preview analyzer is a fast and coarse one, it analyses only the beginning of the sample
+ with sparser frames and without bandwidth, so the sound can be played right after
+ analysis parameters are edited. Its result is not cached.
+ 
+ Pitch of a newly selected sample can be detected by the analyzer before it is analysed,
+ from a short window after the onset. Beginning of the sample is decoded once into
+ DecodedSampleCache, pitch detection and all analyses of the sample read it from there.
+ The analysis of the main sample builds its overview for the editor from the samples it
+ decodes (see SampleOverviewCache).
  */
-class SampleAnalyzer : public ThreadWithProgressWindow
+class SampleAnalyzer : public ThreadPoolJob,
+                       private Loris::Analyzer::ProgressListener,
+                       private Loris::Analyzer::Cancellation
 {
 public:
+    /** How channels of a stereo sample are mixed down to the mono analysed. Stereo and
+        mid/side analyse two mixes apart, their partials are labeled by the channel they are
+        played in (see Loris::PartialStruct::Channel). */
+    enum Downmix
+    {
+        downmixMax = 0,     // louder of the channels, sample by sample
+        downmixMid,         // average of the channels
+        downmixLeft,        // left channel only
+        downmixRight,       // right channel only
+        downmixStereo,      // left and right channels, played in their channel
+        downmixMidSide,     // mid played in both channels and side played inverted in the right one
+        downmixSide         // half difference of the channels, a pass of downmixMidSide only
+    };
+    
+    /** Receives results of analysis. */
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        
+        /** Called from the analysis thread when analysis is finished (this is not
+            called if the job was asked to exit). Partials can be moved from analyzer. */
+        virtual void analysisFinished(SampleAnalyzer *analyzer) = 0;
+        
+        /** Called from the analysis thread periodically while an audio file is analysed,
+            with partials finished so far (post-processed like the final ones). Partials
+            can be moved from the list. */
+        virtual void analysisProgressed(SampleAnalyzer * /*analyzer*/, Loris::PartialList & /*partialsSoFar*/) {}
+        
+        /** Called from the analysis thread when pitch of the sample was detected, before
+            the sample is analysed with it (see pitch() and frequencyResolution()). */
+        virtual void pitchDetected(SampleAnalyzer * /*analyzer*/) {}
+        
+        /** Called from the analysis thread as the job goes, with the part of it done from 0
+            to 1: decoding and analysis of the sample by the time analysed so far, then
+            processing of partials (see kAnalysisProgressShare). */
+        virtual void analysisProgress(SampleAnalyzer * /*analyzer*/, double /*progress*/) {}
+    };
+    
     /**
      Create new SampleAnalyzer object.
      @param formatManager format manager object for loading audio files.
-     @param syncObj sinalize when thread/analysis is finished.
+     @param decodedSamples cache of decoded beginnings of samples, shared by jobs.
+     @param listener is notified when analysis is finished.
      */
-    SampleAnalyzer(AudioFormatManager &formatManager, WaitableEvent &syncObj, const String &name = "Paraphrasis is loading...");
+    SampleAnalyzer(AudioFormatManager &formatManager, DecodedSampleCache &decodedSamples, Listener &listener,
+                   const String &name = "Paraphrasis is loading...");
     virtual ~SampleAnalyzer();
     
-    /** Start the analysis thread. When analysis is finished WitableEvent passed in constructor is signaled. */
-    void run() noexcept override;
+    /** Run the analysis. When analysis is finished listener passed in constructor is notified. */
+    JobStatus runJob() noexcept override;
     
     void setSamplePath(const String & path) noexcept            { this->m_samplePath = path; }
     String samplePath()  noexcept                               { return m_samplePath; }
@@ -56,31 +121,187 @@ public:
     
     void setReverse(bool reverse) noexcept                      { this->reverse = reverse; }
     
+    void setDownmix(Downmix downmix) noexcept                   { this->downmix = downmix; }
+    
+    /** Analyse only a region of the (reversed) sample, in seconds, end 0 analyses it to its
+        end. Partials, noise bands and loop markers are timed from the start of the region.
+        SDIF files are not analysed, they are read whole. */
+    void setRegion(double start, double end) noexcept           { m_regionStart = jmax(0., start); m_regionEnd = end; }
+    
+    /** Analyse samples decimated to the lowest rate keeping partials below ceilingHz (see
+        Loris::Analyzer::setFrequencyCeiling()), 0 analyses them at their own rate. */
+    void setFrequencyCeiling(double ceilingHz) noexcept         { this->m_ceiling = ceilingHz; }
+    double frequencyCeiling() const noexcept                    { return m_ceiling; }
+    
+    /** Analyse partials above frequencyHz with a window half as long (see
+        Loris::Analyzer::addWindowBand()), 0 analyses all of them with one window. */
+    void setShortWindowAbove(double frequencyHz) noexcept       { this->m_shortWindowAbove = jmax(0., frequencyHz); }
+    double shortWindowAbove() const noexcept                    { return m_shortWindowAbove; }
+    
+    /** Analyse frames around transients hopSeconds apart and the rest of the sample at the
+        hop of the resolution (see Loris::Analyzer::setCoarseHopTime()), 0 or a hop not
+        shorter than that one analyses all of it at the hop of the resolution. Previews keep
+        their own coarse hop. */
+    void setTransientHop(double hopSeconds) noexcept            { this->m_transientHop = jmax(0., hopSeconds); }
+    double transientHop() const noexcept                        { return m_transientHop; }
+    
+    /** Analyse only the spectrum around the harmonics of the pitch of the sample and form
+        one partial of each harmonic at a time (see Loris::Analyzer::setHarmonicFundamental()),
+        faster, into fewer partials. Components between the harmonics are lost. */
+    void setHarmonicAnalysis(bool harmonic) noexcept            { this->m_harmonicAnalysis = harmonic; }
+    bool isHarmonicAnalysis() const noexcept                    { return m_harmonicAnalysis; }
+    
+    /** Detect pitch of the sample and set frequency resolution by it before the analysis,
+        pitch set before is kept if it can not be detected. */
+    void setDetectPitch(bool detect) noexcept                   { this->detect = detect; }
+    
+    void setPreview(bool preview) noexcept                      { this->preview = preview; }
+    bool isPreview() const noexcept                             { return preview; }
+    
+    /** Analyse the morph target of the sound instead of the sound, its partials are not
+        published while analysis runs. */
+    void setMorphTarget(bool morphTarget) noexcept              { this->morphTarget = morphTarget; }
+    bool isMorphTarget() const noexcept                         { return morphTarget; }
+    
+    /** Analyse the sample of a key zone of the sound (see LorisSynthesiser::setupZone()), 0 for
+        the main sample. Partials of a key zone are not published while analysis runs. */
+    void setZone(int zone) noexcept                             { this->m_zone = zone; }
+    int zone() const noexcept                                   { return m_zone; }
+    
+    /** Set scheduler running the job and the threads it may use (analysis of frames,
+        channelizing and distilling), its analysis slows down when the scheduler reports a
+        high audio load. Set by AnalysisScheduler before the job is run. */
+    void setScheduler(AnalysisScheduler *scheduler, int numThreads) noexcept { this->scheduler = scheduler; this->numThreads = numThreads; }
+    
+    /** Number given by listener to tell results of the analysis it asked for last. */
+    void setGeneration(int generation) noexcept                 { this->m_generation = generation; }
+    int generation() const noexcept                             { return m_generation; }
+    
     Loris::PartialList& partials() noexcept                     { return m_partials; }
     
+    /** Residual of the analysis as noise band envelopes, measured by the first pass (mid, or
+        left of a stereo downmix) and cached with the partials. Empty for previews, SDIF files
+        and partials taken from an analysis of another instance. */
+    Loris::NoiseBands::Ptr noiseBands() const noexcept          { return m_noiseBands; }
+    
+    /** Sustain loop of the sample in seconds, read from its loop markers (WAV sample chunk,
+        AIFF sustain loop, SDIF markers named "Loop Start" and "Loop End"). Reversed with
+        the sample. No loop if end is not after start. */
+    double loopStart() const noexcept                           { return m_loopStart; }
+    double loopEnd() const noexcept                             { return m_loopEnd; }
+    
+    /** Seconds of the sample covered by the partials published last (or by the final ones
+        of a preview analysis). */
+    double analysedTime() const noexcept                        { return m_analysedTime; }
+    
+    /** Key of partials in AnalysisCache, empty if they are not cached. */
+    const String& cacheKey() const noexcept                     { return m_cacheKey; }
+    
+    /** Hash of the overview of the main sample in SampleOverviewCache, 0 if it is not cached
+        or the analysis is a preview, of a key zone or of the morph target. */
+    int64 overviewHash() const noexcept                         { return m_overviewHash; }
+    
+    /** Key of the analysis parameters and of the sample file by its path, size and
+        modification time, for AnalysisHistory. Unlike cacheKey() it is known before the
+        analysis, the file is not read. */
+    String settingsKey() const;
+    
 private:
     
-    /** Read file specified by samplePath using formatManager passed in constructor */
+    /** Analyse file specified by samplePath, read using formatManager passed in constructor
+        chunk by chunk while analysis goes. */
     bool loadAudioFile() noexcept;
-    /** Analyse loaded sampes. */
-    void analyze() noexcept;
     /** Read SDIF file using Loris. */
     bool loadSdif() noexcept;
+    /** Return the decoded beginning of the sample mixed down by downmix from the cache,
+        decode and cache it if it is not there. Empty if it can not be decoded. */
+    DecodedSampleCache::Samples decodeHead(AudioFormatReader &reader, Downmix downmix) noexcept;
+    /** Detect pitch of audio file specified by samplePath from its decoded beginning. */
+    bool detectPitch() noexcept;
+    /** Read sustain loop markers of audio file specified by samplePath. */
+    void readLoop() noexcept;
+    /** Store the overview of the sample built by the analysis, or read the sample for it if
+        the analysis did not decode all of it. Clears overviewHash() if it is not cached. */
+    void cacheOverview() noexcept;
+    /** Time partials analysed from the margin before the region from its start, drop the
+        parts of them outside the region. */
+    void trimToRegion(Loris::PartialList &partials) const;
+    /** Shorten the hop of the analyzer around transients to the transient hop, if it is
+        shorter. Previews keep the hop. */
+    void configureHop(Loris::Analyzer &analyzer) const;
     /** Fix phases and order partials by time. */
     void postProcessPartials() noexcept;
+    /** Channelize and distill partials (unless labeled by channel), order them by time.
+        @param withProgress tell listener how far processing is */
+    void processPartials(Loris::PartialList &partials, bool withProgress = false);
+    
+    /** Finish the stage of the job running and start timing the next one, named as the job.
+        Empty name just finishes the stage. */
+    void beginStage(const String &name) noexcept;
+    /** Write times of the stages of the job to the log, once it is finished. */
+    void logStageTimes() noexcept;
+    /** Tell listener the part of the job done, from 0 to 1. */
+    void reportProgress(double progress) noexcept;
+    
+    // Loris::Analyzer::ProgressListener method, publishes preview of partials
+    void partialsFinished(const Loris::PartialList &finished, double time) override;
+    
+    // Loris::Analyzer::Cancellation method, stops analysis of the job asked to exit
+    bool isCancelled() const override                           { return shouldExit(); }
+    
+    // Loris::Analyzer::Cancellation method, lowers priority of analysing threads and makes
+    // them wait while audio threads are busy
+    void pace() const override;
     
     String m_samplePath;
     double m_resolution = kParameterFrequencyResolution_defaultValue;
     double m_pitch      = kParameterSamplePitch_defaultValue;
     bool reverse        = false;
+    Downmix downmix     = downmixMax;
+    double m_ceiling    = kParameterAnalysisCeiling_defaultValue;
+    double m_shortWindowAbove = 0;
+    double m_transientHop = 0;
+    bool m_harmonicAnalysis = false;
+    double m_regionStart = 0;
+    double m_regionEnd  = 0;
+    bool preview        = false;
+    bool morphTarget    = false;
+    int m_zone          = 0;
+    bool detect         = false;
+    int m_generation    = 0;
+    AnalysisScheduler *scheduler = nullptr;
+    int numThreads      = 0;    // 0 for all cores
     
     AudioFormatManager& formatManager;
-    WaitableEvent& analyzerSync;
+    DecodedSampleCache& decodedSamples;
+    Listener& listener;
+    SharedResourcePointer<AnalysisRegistry> registry; // Coalesces analyses of all instances
+    SharedResourcePointer<AnalysisFrameCache> frameCaches; // Frames of the samples analysed last
+    SharedResourcePointer<SampleOverviewCache> overviews;  // Overviews of samples drawn by editors
+    ScopedPointer<SampleOverviewCache::Builder> overview;  // Built by the first analysis pass, if missing
     
     Loris::PartialList m_partials;
-    std::vector<double> buffer;
+    Loris::NoiseBands::Ptr m_noiseBands;
+    String m_cacheKey;
+    int64 m_overviewHash = 0;
+    double m_loopStart = 0;
+    double m_loopEnd = 0;
+    double m_analysedTime = 0;
     double sampleRate = 0;
     
+    Loris::PartialList finishedPartials;  // Finished so far by running analysis (and its previous passes)
+    int passLabel = 0;                    // Label of partials of the running analysis pass
+    uint32 lastPreviewTime = 0;           // Millisecond counter of the last published preview
+    int pass = 0;                         // Pass of the analysis running and their number
+    int numPasses = 1;
+    double analysisLength = 0;            // Seconds of the sample analysed by a pass
+    double regionOffset = 0;              // Seconds of the margin read before the region
+    double regionLength = 0;              // Seconds of the region analysed
+    
+    String stageName;                     // Stage of the job running, see beginStage()
+    double stageStartMs = 0;              // Time it started, Time::getMillisecondCounterHiRes()
+    String stageTimes;                    // Stages finished so far with their times
+    
 };
 
 
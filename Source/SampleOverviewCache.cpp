@@ -0,0 +1,128 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "SampleOverviewCache.h"
+
+#include "AnalysisCache.h"
+
+#include <algorithm>
+
+//==============================================================================
+SampleOverviewCache::Builder::Builder(AudioFormatManager &formatManager, SampleOverviewCache &cache,
+                                      double sampleRate, int64 numSamples)
+    : thumbnail(kSamplesPerPoint, formatManager, cache),
+      length(numSamples)
+{
+    thumbnail.reset(1, sampleRate, numSamples);
+}
+
+//==============================================================================
+void SampleOverviewCache::Builder::addSamples(int64 start, const float *samples, int numSamples)
+{
+    // samples added before are skipped, a gap can not be filled later
+    const int64 skip = next - start;
+    if (skip < 0 || skip >= numSamples)
+        return;
+
+    samples += skip;
+    numSamples -= (int) skip;
+
+    // points start at multiples of kSamplesPerPoint, whole ones are added right from the block
+    while (numSamples > 0)
+    {
+        if (numPending == 0 && numSamples >= kSamplesPerPoint)
+        {
+            const int n = numSamples / kSamplesPerPoint * kSamplesPerPoint;
+            float *channel = const_cast<float *>(samples);
+            thumbnail.addBlock(next, AudioSampleBuffer(&channel, 1, n), 0, n);
+            next += n;
+            samples += n;
+            numSamples -= n;
+            continue;
+        }
+
+        const int n = jmin(numSamples, kSamplesPerPoint - numPending);
+        std::copy(samples, samples + n, pending + numPending);
+        numPending += n;
+        next += n;
+        samples += n;
+        numSamples -= n;
+
+        if (numPending == kSamplesPerPoint || next >= length)
+            flush();
+    }
+}
+
+//==============================================================================
+void SampleOverviewCache::Builder::flush()
+{
+    float *channel = pending;
+    thumbnail.addBlock(next - numPending, AudioSampleBuffer(&channel, 1, numPending), 0, numPending);
+    numPending = 0;
+}
+
+//==============================================================================
+SampleOverviewCache::SampleOverviewCache() : AudioThumbnailCache(kMaxInMemory)
+{
+}
+
+//==============================================================================
+int64 SampleOverviewCache::createHash(const String &contentKey, bool reverse, int downmix)
+{
+    return (contentKey + ";" + (reverse ? "r" : "f") + ";d" + String(downmix)).hashCode64();
+}
+
+//==============================================================================
+bool SampleOverviewCache::contains(int64 hash) const
+{
+    return fileForHash(hash).existsAsFile();
+}
+
+//==============================================================================
+void SampleOverviewCache::saveNewlyFinishedThumbnail(const AudioThumbnailBase &thumbnail, int64 hash)
+{
+    const File file(fileForHash(hash));
+    if ( !file.getParentDirectory().createDirectory() )
+        return;
+
+    MemoryOutputStream out;
+    thumbnail.saveTo(out);
+
+    // other instances may read the file, so write it aside first
+    TemporaryFile temp(file);
+    if ( temp.getFile().replaceWithData(out.getData(), out.getDataSize()) )
+        temp.overwriteTargetFileWithTemporary();
+}
+
+//==============================================================================
+bool SampleOverviewCache::loadNewThumb(AudioThumbnailBase &thumbnail, int64 hash)
+{
+    FileInputStream in(fileForHash(hash));
+    return in.openedOk() && thumbnail.loadFrom(in);
+}
+
+//==============================================================================
+File SampleOverviewCache::fileForHash(int64 hash)
+{
+    return AnalysisCache::getDefaultDirectory().getChildFile(String::toHexString(hash) + ".overview");
+}
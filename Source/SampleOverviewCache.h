@@ -0,0 +1,100 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef SAMPLE_OVERVIEW_CACHE_H_INCLUDED
+#define SAMPLE_OVERVIEW_CACHE_H_INCLUDED
+
+#include "JuceHeader.h"
+
+/**
+ Min/max overviews of samples as they are analysed (reversed, mixed down to the mono of the
+ first analysis pass), drawn by the editor instead of reading the sample. An overview is an
+ AudioThumbnail built once from the blocks the analysis decodes anyway (see Builder), stored
+ in the directory of AnalysisCache and kept in memory by this AudioThumbnailCache, which all
+ plugin instances share through SharedResourcePointer. Reopening the editor or the project
+ draws the overview from memory or from its file.
+ */
+class SampleOverviewCache : public AudioThumbnailCache
+{
+public:
+    enum
+    {
+        kSamplesPerPoint = 512,     // Samples of a min/max pair of an overview
+        kMaxInMemory = 8            // Overviews kept in memory, the least recently used are dropped
+    };
+
+    /**
+     Builds the overview of a sample from its blocks, added in the order the sample is read.
+     Blocks overlapping the ones before are fine, a gap leaves the overview incomplete. Not
+     thread safe, the analysis adds blocks one at a time.
+     */
+    class Builder
+    {
+    public:
+        Builder(AudioFormatManager &formatManager, SampleOverviewCache &cache, double sampleRate, int64 numSamples);
+
+        /** Add numSamples samples of the sample starting at start. */
+        void addSamples(int64 start, const float *samples, int numSamples);
+
+        /** Has all of the sample been added? */
+        bool isComplete() const noexcept                { return next >= length; }
+
+        const AudioThumbnail& getThumbnail() const noexcept { return thumbnail; }
+
+    private:
+        /** Add min and max of the points pending. */
+        void flush();
+
+        AudioThumbnail thumbnail;
+        int64 length;
+        int64 next = 0;                     // Sample following the last one added
+        float pending[kSamplesPerPoint];    // Samples of the point being added, from its start
+        int numPending = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(Builder)
+    };
+
+    SampleOverviewCache();
+
+    /** Return the hash the overview of a sample is cached by.
+        @param contentKey key of the content of the sample, see AnalysisCache::createContentKey()
+        @param reverse is the sample reversed?
+        @param downmix how a stereo sample is mixed down (SampleAnalyzer::Downmix) */
+    static int64 createHash(const String &contentKey, bool reverse, int downmix);
+
+    /** Is the overview of hash cached? */
+    bool contains(int64 hash) const;
+
+protected:
+    /** Write a finished overview into its file. */
+    void saveNewlyFinishedThumbnail(const AudioThumbnailBase &thumbnail, int64 hash) override;
+
+    /** Read an overview missing in memory from its file. */
+    bool loadNewThumb(AudioThumbnailBase &thumbnail, int64 hash) override;
+
+private:
+    static File fileForHash(int64 hash);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleOverviewCache)
+};
+
+#endif  // SAMPLE_OVERVIEW_CACHE_H_INCLUDED
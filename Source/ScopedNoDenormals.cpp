@@ -0,0 +1,63 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "ScopedNoDenormals.h"
+
+#if JUCE_INTEL
+ #include <xmmintrin.h>
+#endif
+
+namespace
+{
+#if JUCE_INTEL
+    const uint64 kFlushToZero = 0x8000;         // FTZ of MXCSR
+    const uint64 kDenormalsAreZero = 0x0040;    // DAZ of MXCSR
+    
+    uint64 getMode() noexcept           { return _mm_getcsr(); }
+    void setMode(uint64 mode) noexcept  { _mm_setcsr((unsigned int) mode); }
+#elif defined(__aarch64__)
+    const uint64 kFlushToZero = 1 << 24;        // FZ of FPCR, flushes inputs too
+    const uint64 kDenormalsAreZero = 0;
+    
+    uint64 getMode() noexcept           { uint64 mode; asm volatile("mrs %0, fpcr" : "=r"(mode)); return mode; }
+    void setMode(uint64 mode) noexcept  { asm volatile("msr fpcr, %0" : : "r"(mode)); }
+#else
+    const uint64 kFlushToZero = 0;
+    const uint64 kDenormalsAreZero = 0;
+    
+    uint64 getMode() noexcept           { return 0; }
+    void setMode(uint64) noexcept       {}
+#endif
+}
+
+//==============================================================================
+ScopedNoDenormals::ScopedNoDenormals() noexcept : previous(getMode())
+{
+    setMode(previous | kFlushToZero | kDenormalsAreZero);
+}
+
+//==============================================================================
+ScopedNoDenormals::~ScopedNoDenormals() noexcept
+{
+    setMode(previous);
+}
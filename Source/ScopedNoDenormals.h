@@ -0,0 +1,51 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef SCOPED_NO_DENORMALS_H_INCLUDED
+#define SCOPED_NO_DENORMALS_H_INCLUDED
+
+#include "JuceHeader.h"
+
+/**
+ Flushes denormal floats and doubles to zero in the calling thread while it exists, and
+ restores the floating point mode it found when it goes. Results too small to be normal
+ are zero and denormal operands are read as zero (FTZ and DAZ of SSE, FZ of AArch64),
+ so envelopes and filter states decaying at the end of notes do not run into the slow
+ path of the processor. Elsewhere it does nothing.
+ 
+ processBlock(), the voice rendering workers and the analysis threads hold one for all of
+ their work. Threads started by Loris (see Loris::parallelFor) take the mode of the thread
+ which starts them.
+ */
+class ScopedNoDenormals
+{
+public:
+    ScopedNoDenormals() noexcept;
+    ~ScopedNoDenormals() noexcept;
+    
+private:
+    uint64 previous;            // Control register found
+    
+    JUCE_DECLARE_NON_COPYABLE(ScopedNoDenormals)
+};
+
+#endif  // SCOPED_NO_DENORMALS_H_INCLUDED
@@ -0,0 +1,43 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef SHARED_FORMAT_MANAGER_H_INCLUDED
+#define SHARED_FORMAT_MANAGER_H_INCLUDED
+
+#include "JuceHeader.h"
+
+/**
+ Audio formats samples are read with, registered once for all instances in the host process
+ (through SharedResourcePointer) instead of by every instance a host creates. Formats are not
+ changed after the constructor, instances and their analysis jobs only create readers and
+ list wildcards, from any thread.
+ */
+class SharedFormatManager : public AudioFormatManager
+{
+public:
+    SharedFormatManager();
+    
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedFormatManager)
+};
+
+#endif  // SHARED_FORMAT_MANAGER_H_INCLUDED
@@ -0,0 +1,73 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "VoiceMeter.h"
+
+//==============================================================================
+VoiceMeter::VoiceMeter() : maxPartials(1)
+{
+    setOpaque(true);
+}
+
+//==============================================================================
+void VoiceMeter::setActivity(const uint16 *partials, int numVoices)
+{
+    bool changed = numVoices != voicePartials.size();
+    voicePartials.resize(numVoices);
+    for (int i = 0; i < numVoices; i++)
+    {
+        changed = changed || voicePartials.getUnchecked(i) != partials[i];
+        voicePartials.set(i, partials[i]);
+        maxPartials = jmax(maxPartials, (int) partials[i]);
+    }
+
+    if (changed)
+        repaint();
+}
+
+//==============================================================================
+void VoiceMeter::paint(Graphics &g)
+{
+    g.fillAll(Colours::black);
+
+    const int numVoices = voicePartials.size();
+    if (numVoices == 0)
+        return;
+
+    // bars share the width, a pixel apart while there is room for it
+    const float barWidth = (float) getWidth() / numVoices;
+    const float gap = barWidth >= 3.f ? 1.f : 0.f;
+    for (int i = 0; i < numVoices; i++)
+    {
+        const int partials = voicePartials.getUnchecked(i);
+        const float x = i * barWidth;
+        g.setColour(Colour(0xff303030));
+        g.fillRect(x, 0.f, barWidth - gap, (float) getHeight());
+        if (partials == 0)
+            continue;
+
+        const float height = jmax(1.f, getHeight() * (float) partials / maxPartials);
+        g.setColour(Colour(0xff7fd07f));
+        g.fillRect(x, getHeight() - height, barWidth - gap, height);
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef VOICE_METER_H_INCLUDED
+#define VOICE_METER_H_INCLUDED
+
+#include "JuceHeader.h"
+
+/**
+ Bars of the voices of the synthesiser, the height of a bar is the number of partials its
+ voice plays relative to the voice playing most of them, silent voices are left dark. The
+ editor sets the activity published by the audio thread with the output for the scope.
+ */
+class VoiceMeter : public Component
+{
+public:
+    VoiceMeter();
+
+    /** Show partials each voice plays, 0 for silent voices.
+        @param partials partials of the voices
+        @param numVoices number of voices */
+    void setActivity(const uint16 *partials, int numVoices);
+
+    /** @internal */
+    void paint(Graphics &g) override;
+
+private:
+    Array<int> voicePartials;   // Partials of the voices shown
+    int maxPartials;            // Most partials a voice played since the meter was created, scales the bars
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceMeter)
+};
+
+#endif  // VOICE_METER_H_INCLUDED
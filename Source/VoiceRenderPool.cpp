@@ -0,0 +1,186 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+
+#include "VoiceRenderPool.h"
+#include "AudioThreadAllocations.h"
+#include "ScopedNoDenormals.h"
+#include "LorisTrace.h"
+
+//==============================================================================
+/** Thread rendering voices of VoiceRenderPool into its scratch buffer. */
+class VoiceRenderPool::Worker : public Thread
+{
+public:
+    Worker(VoiceRenderPool &pool) : Thread("Paraphrasis voices"), scratch(kMaxChannels, 0), pool(pool)
+    {
+        lastGeneration = -1;
+    }
+    
+    void run() override
+    {
+        // renders for the audio thread, its allocations are caught alike
+        const AudioThreadAllocations::ScopedAudioThread audioThread;
+        const ScopedNoDenormals noDenormals;
+        
+        while ( !threadShouldExit() )
+        {
+            wake.wait(-1);
+            pool.renderVoices(this);
+        }
+    }
+    
+    WaitableEvent wake;         // signalled when a block is to be rendered
+    AudioSampleBuffer scratch;  // voices taken by this worker are rendered here
+    Atomic<int> lastGeneration; // block scratch was cleared for
+    
+private:
+    VoiceRenderPool &pool;
+};
+
+//==============================================================================
+VoiceRenderPool::VoiceRenderPool(int numWorkers) : maximumBlockSize(0), blockVoices(nullptr), blockNumVoices(0),
+    blockOutput(nullptr), blockNumChannels(0), blockStartSample(0), blockNumSamples(0)
+{
+    generation = 0;
+    nextVoice = kNoVoices;
+    voicesDone = 0;
+    claimed = 0;
+    
+    for (int i = 0; i < numWorkers; i++)
+    {
+        Worker *worker = new Worker(*this);
+        workers.add(worker);
+        worker->startThread(10); // as close to the audio thread as we can get
+    }
+}
+
+//==============================================================================
+VoiceRenderPool::~VoiceRenderPool()
+{
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i]->signalThreadShouldExit();
+        workers[i]->wake.signal();
+    }
+    
+    for (int i = 0; i < workers.size(); i++)
+        workers[i]->waitForThreadToExit(-1);
+}
+
+//==============================================================================
+void VoiceRenderPool::prepare(int maximumBlockSize)
+{
+    // blocks of other synthesisers sharing the pool are short, they are waited for
+    while ( !claimed.compareAndSetBool(1, 0))
+        Thread::yield();
+    
+    if (maximumBlockSize > this->maximumBlockSize)
+    {
+        this->maximumBlockSize = maximumBlockSize;
+        for (int i = 0; i < workers.size(); i++)
+            workers[i]->scratch.setSize(kMaxChannels, maximumBlockSize);
+    }
+    
+    claimed = 0;
+}
+
+//==============================================================================
+bool VoiceRenderPool::render(SynthesiserVoice * const *voices, int numVoices,
+                             AudioSampleBuffer &output, int startSample, int numSamples,
+                             int maxWorkers) noexcept
+{
+    if (output.getNumChannels() > kMaxChannels || !claimed.compareAndSetBool(1, 0))
+        return false;
+    
+    if (numSamples > maximumBlockSize)
+    {
+        claimed = 0;
+        return false;
+    }
+    
+    blockVoices = voices;
+    blockNumVoices = numVoices;
+    blockOutput = &output;
+    blockNumChannels = output.getNumChannels();
+    blockStartSample = startSample;
+    blockNumSamples = numSamples;
+    
+    const int block = ++generation;
+    voicesDone = 0;
+    nextVoice = 0; // voices can be taken from now on
+    
+    const int numWoken = jmin(workers.size(), numVoices - 1, maxWorkers);
+    for (int i = 0; i < numWoken; i++)
+        workers.getUnchecked(i)->wake.signal();
+    
+    renderVoices(nullptr);
+    
+    // voices left are being rendered by running workers, it will not take long
+    while (voicesDone.get() < numVoices)
+        Thread::yield();
+    
+    nextVoice = kNoVoices;
+    
+    for (int i = 0; i < workers.size(); i++)
+    {
+        Worker *worker = workers.getUnchecked(i);
+        if (worker->lastGeneration.get() == block)
+            for (int c = 0; c < blockNumChannels; c++)
+                output.addFrom(c, startSample, worker->scratch, c, 0, numSamples);
+    }
+    
+    claimed = 0;
+    return true;
+}
+
+//==============================================================================
+void VoiceRenderPool::renderVoices(Worker *worker) noexcept
+{
+    LORIS_TRACE_ZONE("VoiceRenderPool::renderVoices");
+    for (;;)
+    {
+        // block is only read once a voice of it was taken
+        const int i = (++nextVoice) - 1;
+        if (i >= kNoVoices || i >= blockNumVoices)
+            return;
+        
+        if (worker == nullptr)
+        {
+            blockVoices[i]->renderNextBlock(*blockOutput, blockStartSample, blockNumSamples);
+        }
+        else
+        {
+            // scratch has as many channels as the output (refers to the scratch, allocates nothing)
+            AudioSampleBuffer scratch(worker->scratch.getArrayOfWritePointers(), blockNumChannels, blockNumSamples);
+            const int block = generation.get();
+            if (worker->lastGeneration.get() != block)
+            {
+                scratch.clear();
+                worker->lastGeneration = block;
+            }
+            blockVoices[i]->renderNextBlock(scratch, 0, blockNumSamples);
+        }
+        
+        ++voicesDone;
+    }
+}
@@ -0,0 +1,117 @@
+/*
+ This is Paraphrasis synthesiser.
+ 
+ Copyright (c) 2014 by Tomas Medek
+ 
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ 
+ tom@virtualanalogy.com
+ 
+ */
+#ifndef VOICE_RENDER_POOL_H_INCLUDED
+#define VOICE_RENDER_POOL_H_INCLUDED
+
+#include "JuceHeader.h"
+
+/**
+ Pool of high priority threads which render synthesiser voices concurrently with
+ the audio thread. The audio thread hands a block of voices to render(), the voices
+ are taken one by one by whichever thread is free first (the audio thread too), so
+ a worker which wakes up late just finds less work. Every worker renders into its
+ own scratch buffer, the buffers are added to the output when all voices are done.
+
+ Nothing is allocated or locked while rendering, waking the workers up is the only
+ system call. Scratch buffers are sized by prepare().
+
+ A pool may be shared by synthesisers of several instances (see SharedVoiceRenderPool), each
+ block claims it with an atomic flag. An audio thread finding it claimed by another instance
+ does not wait, render() returns false and it renders its voices itself: the host is running
+ instances on several threads then, the cores are busy anyway.
+ */
+class VoiceRenderPool
+{
+public:
+    /** Create pool and start its threads.
+        @param numWorkers number of threads besides the audio thread */
+    VoiceRenderPool(int numWorkers);
+    ~VoiceRenderPool();
+
+    /** Size scratch buffers of the workers for blocks of at least the size, they never
+        shrink as other synthesisers may share the pool. Do not call it from the audio thread,
+        it waits for the block being rendered.
+        @param maximumBlockSize largest number of samples rendered at once */
+    void prepare(int maximumBlockSize);
+
+    /** Render voices into output, like SynthesiserVoice::renderNextBlock() called for each
+        of them. Only called from the audio thread.
+        @param maxWorkers most workers woken for the block, besides the audio thread
+        @return false if nothing was rendered because the block is longer than prepared,
+                output has more than kMaxChannels channels or another synthesiser renders
+                with the pool */
+    bool render(SynthesiserVoice * const *voices, int numVoices,
+                AudioSampleBuffer &output, int startSample, int numSamples,
+                int maxWorkers = 0x7fffffff) noexcept;
+
+    /** Return number of threads besides the audio thread. */
+    int getNumWorkers() const noexcept { return workers.size(); }
+
+private:
+    class Worker;
+
+    /** Take voices of current block and render them until there are none left.
+        @param worker thread rendering into its scratch buffer, nullptr for the audio thread */
+    void renderVoices(Worker *worker) noexcept;
+
+    enum { kNoVoices = 0x40000000 }; // nextVoice between blocks, no voice can be taken
+    enum { kMaxChannels = 4 };       // scratch channels, a channel bus of LorisSynthesiser
+
+    OwnedArray<Worker> workers;
+    int maximumBlockSize;
+
+    // current block, written by render() before nextVoice is reset
+    SynthesiserVoice * const *blockVoices;
+    int blockNumVoices;
+    AudioSampleBuffer *blockOutput;
+    int blockNumChannels;
+    int blockStartSample;
+    int blockNumSamples;
+
+    Atomic<int> generation;     // number of the current block
+    Atomic<int> nextVoice;      // next voice to be taken
+    Atomic<int> voicesDone;     // voices of current block rendered
+    Atomic<int> claimed;        // set while a block is rendered or scratch buffers are sized
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceRenderPool)
+};
+
+/**
+ VoiceRenderPool shared by all instances in the host process (through SharedResourcePointer),
+ with a worker for each core but one. Instances rendering voices on several threads use its
+ workers instead of starting their own, so many instances never run more voice threads than
+ there are cores. It is created by the first instance rendering on several threads and
+ stopped with the last one.
+ */
+class SharedVoiceRenderPool : public VoiceRenderPool
+{
+public:
+    SharedVoiceRenderPool() : VoiceRenderPool(jlimit(0, (int) kMaxWorkers, SystemStats::getNumCpus() - 1)) {}
+
+    enum { kMaxWorkers = 31 };  // more than the voices of a synthesiser would stay idle
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedVoiceRenderPool)
+};
+
+#endif  // VOICE_RENDER_POOL_H_INCLUDED
@@ -0,0 +1,53 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+
+#include "WaveformView.h"
+
+//==============================================================================
+WaveformView::WaveformView(AudioFormatManager &formatManager)
+    : thumbnail(SampleOverviewCache::kSamplesPerPoint, formatManager, *cache)
+{
+    setInterceptsMouseClicks(false, false);
+}
+
+//==============================================================================
+void WaveformView::setOverview(int64 newHash)
+{
+    if (newHash == hash)
+        return;
+
+    hash = newHash;
+    thumbnail.clear();
+    loaded = hash != 0 && cache->loadThumb(thumbnail, hash);
+    repaint();
+}
+
+//==============================================================================
+void WaveformView::paint(Graphics &g)
+{
+    if (!loaded || thumbnail.getTotalLength() <= 0)
+        return;
+
+    g.setColour(Colour(0x66000000));
+    thumbnail.drawChannel(g, getLocalBounds(), 0, thumbnail.getTotalLength(), 0, 1.0f);
+}
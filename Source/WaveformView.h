@@ -0,0 +1,54 @@
+/*
+ This is Paraphrasis synthesiser.
+
+ Copyright (c) 2014 by Tomas Medek
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY, without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+ tom@virtualanalogy.com
+
+ */
+#ifndef WAVEFORM_VIEW_H_INCLUDED
+#define WAVEFORM_VIEW_H_INCLUDED
+
+#include "JuceHeader.h"
+
+#include "SampleOverviewCache.h"
+
+/**
+ Waveform of the analysed sample, drawn from its overview in SampleOverviewCache, so the
+ sample is never read to draw it. Nothing is drawn until the analysis caches the overview.
+ */
+class WaveformView : public Component
+{
+public:
+    WaveformView(AudioFormatManager &formatManager);
+
+    /** Show the overview of a hash, see SampleOverviewCache::createHash(), nothing for 0. */
+    void setOverview(int64 hash);
+
+    /** @internal */
+    void paint(Graphics &g) override;
+
+private:
+    SharedResourcePointer<SampleOverviewCache> cache;
+    AudioThumbnail thumbnail;
+    int64 hash = 0;             // Overview shown
+    bool loaded = false;        // Was the overview of hash found in cache?
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformView)
+};
+
+#endif  // WAVEFORM_VIEW_H_INCLUDED
@@ -42,6 +42,7 @@
 typedef struct LorisReader LorisReader;
 typedef struct LorisPlayer LorisPlayer;
 typedef struct LorisMorpher LorisMorpher;
+typedef struct LorisVoice LorisVoice;
 
 /*	Define a structure to hold parameters for the lorisread module. */
 typedef struct 
@@ -92,6 +93,22 @@ typedef struct
 	LorisMorpher *imp;
 } LORISMORPH;
 
+/*	Define a structure to hold parameters for the lorisvoice module. */
+typedef struct 
+{
+	/*	standard structure holding csound global data (esr, ksmps, etc.) */
+	OPDS h;  	
+	
+	/* output */
+	MYFLT *result;
+	
+	/* unit generator parameters/arguments */
+	MYFLT *ifilnam, *freqenv, *ampenv, *bwenv, *speed, *fadetime;    
+
+	/* private internal data, used by generator */
+	LorisVoice *imp;
+} LORISVOICE;
+
 
 #endif	/* nef INCLUDE_LORISGENS_H */
 
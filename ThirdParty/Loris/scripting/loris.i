@@ -106,15 +106,24 @@ namespace std {
    %template(MarkerVector) vector< Marker >;
 };
 
+// ----------------------------------------------------------------
+//		Pass samples to and from Python without copying them.
+//
+#ifdef SWIGPYTHON
+%include lorisBuffers.i
+#endif
+
 // ----------------------------------------------------------------
 //		notification and exception handlers
 //
 //	Exception handling code for procedural interface calls.
 //	Copied from the SWIG manual. Tastes great, less filling.
+//	The error is kept per thread, because long calls let other
+//	threads call Loris meanwhile (see ReleaseGIL).
 
 %{ 
-	static char error_message[256];
-	static int error_status = 0;
+	static thread_local char error_message[256];
+	static thread_local int error_status = 0;
 	
 	void throw_exception( const char *msg ) 
 	{
@@ -384,6 +393,19 @@ and is included only for backward compatability") wrap_exportAiff;
 // Need this junk, because SWIG changed the way it handles
 // default arguments when writing C++ wrappers.
 //
+#ifdef SWIGPYTHON
+%inline 
+%{
+	void wrap_exportAiff( const char * path, SampleBuffer & samples,
+					      double samplerate = 44100, int bitsPerSamp = 16, 
+					      int nchansignored = 1 )
+	{
+		ReleaseGIL unlocked;
+		exportAiff( path, samples.doubles(), samples.size(), 
+					samplerate, bitsPerSamp );
+	}
+%}
+#else
 %inline 
 %{
 	void wrap_exportAiff( const char * path, const std::vector< double > & samples,
@@ -393,12 +415,19 @@ and is included only for backward compatability") wrap_exportAiff;
 		exportAiff( path, &(samples.front()), samples.size(), 
 					samplerate, bitsPerSamp );
 	}
-	
+%}
+#endif
+
+%inline 
+%{
 	void wrap_exportAiff( const char * path, PartialList * partials,
 					      double samplerate = 44100, int bitsPerSamp = 16 )
 	{
 		try
 		{
+%#ifdef SWIGPYTHON
+			ReleaseGIL unlocked;
+%#endif
 			std::vector< double > vec;
 			
 			Synthesizer synth( samplerate, vec );			
@@ -1665,6 +1694,44 @@ Model, refer to the Loris website:
 
 
 %newobject Analyzer::analyze;
+
+#ifdef SWIGPYTHON
+%{
+	//	Analyze samples in place with the interpreter lock released,
+	//	floats are analyzed as floats.
+	static PartialList * analyze_samples( Analyzer & analyzer, SampleBuffer & samples, 
+										  double srate, const Envelope * env )
+	{
+		PartialList * partials = new PartialList();
+		try
+		{
+			ReleaseGIL unlocked;
+			if ( samples.floats() && ! samples.empty() )
+			{
+				const float * begin = samples.floats();
+				if ( env )
+					analyzer.analyze( begin, begin + samples.size(), srate, *env );
+				else
+					analyzer.analyze( begin, begin + samples.size(), srate );
+			}
+			else if ( ! samples.empty() )
+			{
+				const double * begin = samples.doubles();
+				if ( env )
+					analyzer.analyze( begin, begin + samples.size(), srate, *env );
+				else
+					analyzer.analyze( begin, begin + samples.size(), srate );
+			}
+			partials->splice( partials->end(), analyzer.partials() );
+		}
+		catch ( std::exception & ex )
+		{
+			throw_exception( ex.what() );
+		}
+		return partials;
+	}
+%}
+#endif
 			
 class Analyzer
 {
@@ -1699,8 +1766,25 @@ instance.") Analyzer;
 "Analyze a vector of (mono) samples at the given sample rate 	  	
 (in Hz) and return the resulting Partials in a PartialList.
 If specified, use a frequency envelope as a fundamental reference for
-Partial formation.") analyze;
+Partial formation.
+
+Arrays of doubles or floats (NumPy arrays, array.array) are analyzed
+in place, without copying them, and other Python threads run during
+the analysis, so several analyses can run at once from threads
+(using an Analyzer for each). Other sequences of numbers are copied.") analyze;
 
+#ifdef SWIGPYTHON
+		PartialList * analyze( SampleBuffer & samples, double srate )
+		{
+			return analyze_samples( *self, samples, srate, 0 );
+		}
+		 
+		PartialList * analyze( SampleBuffer & samples, double srate, 
+                               Envelope * env )
+		{
+			return analyze_samples( *self, samples, srate, env );
+		}
+#else
 		PartialList * analyze( const std::vector< double > & vec, double srate )
 		{
 			PartialList * partials = new PartialList();
@@ -1723,6 +1807,7 @@ Partial formation.") analyze;
 			partials->splice( partials->end(), self->partials() );
 			return partials;
 		}
+#endif
 	}
 	
 %feature("docstring",
@@ -1930,8 +2015,8 @@ method is used or if no bandwidth is computed.");
 %feature("docstring",
 "Return the fundamental frequency estimate envelope constructed
 during the most recent analysis performed by this Analyzer.
-Will be empty unless buildFundamentalEnv was invoked to enable the
-construction of this envelope during analysis.") fundamentalEnv;
+Will be empty if buildFundamentalEnv( false ) was invoked to disable
+the construction of this envelope during analysis.") fundamentalEnv;
 
     LinearEnvelope fundamentalEnv( void ) const;
         
@@ -1963,8 +2048,9 @@ during the most recent analysis performed by this Analyzer.") ampEnv;
     LinearEnvelope ampEnv( void ) const;
     
 %feature("docstring",
-"Legacy support, do not use. The amplitude and frequency envelopes
-are always estimated.") buildAmpEnv;
+"Enable or disable construction of the amplitude envelope during
+analysis, buildFundamentalEnv( bool ) does the same for the fundamental
+frequency envelope. Both are constructed by default.") buildAmpEnv;
 
     void buildAmpEnv( bool TF = true );
 
@@ -0,0 +1,318 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ *  lorisBuffers.i
+ *
+ *  SWIG interface file describing how samples and other arrays are passed
+ *  between Python and Loris without copying them, using the Python buffer
+ *  protocol. Include this file in loris.i (Python only) before the classes
+ *  and functions that use SampleBuffer arguments.
+ *
+ *  Samples are read from any object exporting contiguous doubles or floats
+ *  (NumPy arrays, array.array, memoryviews) in place, other sequences of
+ *  numbers are copied as before. Samples and arrays returned to Python are
+ *  memoryviews of memory owned by Loris, numpy.asarray() wraps them without
+ *  copying. NumPy is not needed to build or use the module.
+ *
+ */
+
+/* ******************** inserted C++ code ******************** */
+%{
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+//	class SampleBuffer
+//
+//	SampleBuffer is a view of the samples of a Python object. Objects exporting
+//	a one-dimensional contiguous buffer of doubles or floats are viewed in
+//	place, the buffer is released when the SampleBuffer is destroyed. Any
+//	other sequence of numbers is copied into doubles.
+//
+//	The buffer cannot be resized while it is viewed, so the samples can
+//	be read with the interpreter lock released (see ReleaseGIL).
+//
+class SampleBuffer
+{
+public:
+	SampleBuffer( void ) : m_viewing( false ), m_doubles( 0 ), m_floats( 0 ), m_size( 0 ) {}
+	~SampleBuffer( void ) { if ( m_viewing ) PyBuffer_Release( &m_view ); }
+
+	//	View or copy the samples of an object, return false with a Python
+	//	exception set if the object holds no numbers.
+	bool acquire( PyObject * obj )
+	{
+		if ( PyObject_CheckBuffer( obj ) &&
+			 0 == PyObject_GetBuffer( obj, &m_view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT ) )
+		{
+			m_viewing = true;
+			if ( m_view.ndim > 1 )
+			{
+				PyErr_SetString( PyExc_ValueError, "samples must be one-dimensional" );
+				return false;
+			}
+
+			const char * format = m_view.format ? m_view.format : "B";
+			if ( *format == '@' || *format == '=' )
+				++format;
+			if ( 0 == std::strcmp( format, "d" ) && m_view.itemsize == sizeof(double) )
+			{
+				m_doubles = static_cast< const double * >( m_view.buf );
+				m_size = m_view.len / sizeof(double);
+				return true;
+			}
+			if ( 0 == std::strcmp( format, "f" ) && m_view.itemsize == sizeof(float) )
+			{
+				m_floats = static_cast< const float * >( m_view.buf );
+				m_size = m_view.len / sizeof(float);
+				return true;
+			}
+
+			//	other numbers (integers) are converted below
+			PyBuffer_Release( &m_view );
+			m_viewing = false;
+		}
+		PyErr_Clear();
+
+		PyObject * seq = PySequence_Fast( obj, "samples must be a sequence of numbers" );
+		if ( ! seq )
+			return false;
+
+		const Py_ssize_t n = PySequence_Fast_GET_SIZE( seq );
+		PyObject ** items = PySequence_Fast_ITEMS( seq );
+		m_copy.resize( n );
+		for ( Py_ssize_t i = 0; i < n; ++i )
+		{
+			m_copy[i] = PyFloat_AsDouble( items[i] );
+		}
+		Py_DECREF( seq );
+		if ( PyErr_Occurred() )
+			return false;
+
+		m_doubles = m_copy.empty() ? 0 : &m_copy.front();
+		m_size = m_copy.size();
+		return true;
+	}
+
+	//	Return the number of samples.
+	std::size_t size( void ) const { return m_size; }
+	bool empty( void ) const { return m_size == 0; }
+
+	//	Return the samples if they are floats, otherwise 0.
+	const float * floats( void ) const { return m_floats; }
+
+	//	Return the samples as doubles, floats are converted (copied) the
+	//	first time.
+	const double * doubles( void )
+	{
+		if ( m_floats && ! m_doubles )
+		{
+			m_copy.assign( m_floats, m_floats + m_size );
+			m_doubles = m_copy.empty() ? 0 : &m_copy.front();
+		}
+		return m_doubles;
+	}
+
+private:
+	Py_buffer m_view;
+	bool m_viewing;
+	std::vector< double > m_copy;
+	const double * m_doubles;
+	const float * m_floats;
+	std::size_t m_size;
+
+	SampleBuffer( const SampleBuffer & );
+	SampleBuffer & operator= ( const SampleBuffer & );
+};
+
+// ---------------------------------------------------------------------------
+//	class ReleaseGIL
+//
+//	Release the Python interpreter lock for the lifetime of an instance, so
+//	that other Python threads run while Loris analyzes or synthesizes. The
+//	lock is taken again when the instance is destroyed, also when an
+//	exception leaves the scope. Nothing in the scope may touch Python objects.
+//
+class ReleaseGIL
+{
+public:
+	ReleaseGIL( void ) : m_state( PyEval_SaveThread() ) {}
+	~ReleaseGIL( void ) { PyEval_RestoreThread( m_state ); }
+
+private:
+	PyThreadState * m_state;
+
+	ReleaseGIL( const ReleaseGIL & );
+	ReleaseGIL & operator= ( const ReleaseGIL & );
+};
+
+// ---------------------------------------------------------------------------
+//	LorisArray
+//
+//	A LorisArray exports memory owned by Loris through the buffer protocol,
+//	as a one-dimensional array of items of a struct module format, which may
+//	be strided (fields of an array of structures). The owner keeps the memory
+//	alive as long as the array or any view of it exists.
+//
+struct LorisArray
+{
+	PyObject_HEAD
+	std::shared_ptr< const void > owner;
+	void * data;
+	Py_ssize_t size;
+	Py_ssize_t itemsize;
+	Py_ssize_t stride;
+	const char * format;
+	bool writable;
+};
+
+static int LorisArray_getbuffer( PyObject * self, Py_buffer * view, int flags )
+{
+	LorisArray * array = reinterpret_cast< LorisArray * >( self );
+	if ( ( flags & PyBUF_WRITABLE ) && ! array->writable )
+	{
+		PyErr_SetString( PyExc_BufferError, "Loris array is read-only" );
+		view->obj = NULL;
+		return -1;
+	}
+	if ( array->stride != array->itemsize && ( flags & PyBUF_STRIDES ) != PyBUF_STRIDES )
+	{
+		PyErr_SetString( PyExc_BufferError, "Loris array is not contiguous" );
+		view->obj = NULL;
+		return -1;
+	}
+
+	view->buf = array->data;
+	view->obj = self;
+	Py_INCREF( self );
+	view->len = array->size * array->itemsize;
+	view->readonly = ! array->writable;
+	view->itemsize = array->itemsize;
+	view->format = ( flags & PyBUF_FORMAT ) ? const_cast< char * >( array->format ) : NULL;
+	view->ndim = 1;
+	view->shape = ( flags & PyBUF_ND ) ? &array->size : NULL;
+	view->strides = ( ( flags & PyBUF_STRIDES ) == PyBUF_STRIDES ) ? &array->stride : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+static void LorisArray_dealloc( PyObject * self )
+{
+	LorisArray * array = reinterpret_cast< LorisArray * >( self );
+	array->owner.~shared_ptr();
+	PyTypeObject * type = Py_TYPE( self );
+	type->tp_free( self );
+	Py_DECREF( type );
+}
+
+//	The type is created the first time an array is, as a heap type
+//	(so no PyTypeObject initializer depending on the Python version).
+static PyTypeObject * LorisArray_type( void )
+{
+	static PyObject * type = 0;
+	if ( ! type )
+	{
+		static PyType_Slot slots[] =
+		{
+			{ Py_bf_getbuffer, (void *) LorisArray_getbuffer },
+			{ Py_tp_dealloc, (void *) LorisArray_dealloc },
+			{ 0, 0 }
+		};
+		static PyType_Spec spec =
+		{
+			"loris.LorisArray", sizeof(LorisArray), 0, Py_TPFLAGS_DEFAULT, slots
+		};
+		type = PyType_FromSpec( &spec );
+	}
+	return reinterpret_cast< PyTypeObject * >( type );
+}
+
+// ---------------------------------------------------------------------------
+//	newArray
+//
+//	Return a new memoryview of size items of memory owned by owner, or NULL
+//	with a Python exception set. The memoryview keeps the owner alive.
+//
+static PyObject * newArray( std::shared_ptr< const void > owner, const void * data,
+							Py_ssize_t size, const char * format, Py_ssize_t itemsize,
+							Py_ssize_t stride, bool writable )
+{
+	PyTypeObject * type = LorisArray_type();
+	if ( ! type )
+		return NULL;
+
+	LorisArray * array = PyObject_New( LorisArray, type );
+	if ( ! array )
+		return NULL;
+
+	new ( &array->owner ) std::shared_ptr< const void >( owner );
+	array->data = const_cast< void * >( data );
+	array->size = size;
+	array->itemsize = itemsize;
+	array->stride = stride;
+	array->format = format;
+	array->writable = writable;
+
+	PyObject * view = PyMemoryView_FromObject( reinterpret_cast< PyObject * >( array ) );
+	Py_DECREF( array );
+	return view;
+}
+
+// ---------------------------------------------------------------------------
+//	newSampleArray
+//
+//	Return a new writable memoryview of doubles taking over the samples in
+//	a vector (which is left empty), the samples are not copied.
+//
+static PyObject * newSampleArray( std::vector< double > & samples )
+{
+	std::shared_ptr< std::vector< double > > owner = std::make_shared< std::vector< double > >();
+	owner->swap( samples );
+	const double * data = owner->empty() ? 0 : &owner->front();
+	return newArray( owner, data, owner->size(), "d", sizeof(double), sizeof(double), true );
+}
+
+%}
+/* ***************** end of inserted C++ code ***************** */
+
+/* ************************ typemaps ************************* */
+
+//	Functions taking a SampleBuffer accept any object holding numbers,
+//	see SampleBuffer.
+%typemap(in) SampleBuffer & (SampleBuffer temp)
+{
+	if ( ! temp.acquire( $input ) )
+	{
+		SWIG_fail;
+	}
+	$1 = &temp;
+}
+
+%typemap(typecheck, precedence=SWIG_TYPECHECK_DOUBLE_ARRAY) SampleBuffer &
+{
+	$1 = ( PyObject_CheckBuffer( $input ) || PySequence_Check( $input ) ) ? 1 : 0;
+}
+
+/* ********************* end of typemaps ********************* */
@@ -38,8 +38,11 @@
 %{
 
 #include <LorisExceptions.h>
+#include <PartialBank.h>
 #include <Synthesizer.h>
 
+using Loris::PartialBank;
+using Loris::PartialStruct;
 using Loris::Synthesizer;
 
 
@@ -80,6 +83,21 @@ SynthesisParameters::setFadeTime;
 ") 
 SynthesisParameters::setSampleRate;
 
+%feature("docstring",
+"Return the number of threads used by the Loris Synthesizer to 
+render a PartialList, 0 for one per hardware core.") 
+SynthesisParameters::numThreads;
+
+%feature("docstring",
+"Set the number of threads used by the Loris Synthesizer to 
+render a PartialList, 0 for one per hardware core (default is 1).
+The samples do not depend on the number of threads, but differ
+from the samples rendered by one thread.
+
+	n is the new number of threads.
+") 
+SynthesisParameters::setNumThreads;
+
 %feature("docstring",
 "Return the numerator coefficients in the filter used by the Loris 
 Synthesizer in bandwidth-enhanced sinusoidal synthesis.") 
@@ -148,6 +166,22 @@ SynthesisParameters::setFilterCoefs;
             Synthesizer::SetDefaultParameters( params );        
         }
     
+        //  -- default number of threads access and mutation --
+        
+        static unsigned int numThreads( void ) 
+        {
+            return Synthesizer::DefaultParameters().numThreads;
+        }
+    
+    
+        static void setNumThreads( unsigned int n )    
+        {
+            Synthesizer::Parameters params = 
+                Synthesizer::DefaultParameters();
+            params.numThreads = n;
+            Synthesizer::SetDefaultParameters( params );        
+        }
+    
         //  -- filter access and mutation --
         
         static std::vector< double > filterCoefsNumerator( void ) 
@@ -192,10 +226,52 @@ sized to hold as many samples as are needed for the complete
 synthesis of all the Partials in the PartialList. 
 
 If the sample rate is unspecified, the sample rate in the default 
-SynthesisParameters is used. (See loris.SynthesisParameters.)") 
+SynthesisParameters is used. (See loris.SynthesisParameters.)
+
+In Python the samples are returned as a memoryview of doubles, 
+which numpy.asarray() wraps without copying, and other Python 
+threads run during the synthesis.") 
 synthesize;
 
 
+#ifdef SWIGPYTHON
+%inline 
+%{
+	PyObject * synthesize( const PartialList * partials, double srate )
+	{
+		std::vector<double> dst;
+		try
+		{
+			ReleaseGIL unlocked;
+			Synthesizer synth( srate, dst );
+			synth.synthesize( partials->begin(), partials->end() );
+		}
+		catch ( std::exception & ex )
+		{
+			throw_exception( ex.what() );
+			return NULL;
+		}
+		return newSampleArray( dst );
+	}
+	
+	PyObject * synthesize( const PartialList * partials )
+	{
+		std::vector<double> dst;
+		try
+		{
+			ReleaseGIL unlocked;
+			Synthesizer synth( dst );
+			synth.synthesize( partials->begin(), partials->end() );
+		}
+		catch ( std::exception & ex )
+		{
+			throw_exception( ex.what() );
+			return NULL;
+		}
+		return newSampleArray( dst );
+	}
+%}
+#else
 %newobject synthesize;
 %inline 
 %{
@@ -229,5 +305,96 @@ synthesize;
 		return dst;
 	}
 %}
+#endif
+
+
+/* *********************** partial bank ************************ */
+
+#ifdef SWIGPYTHON
 
+%feature("docstring",
+"A PartialBank is the read-only form of a PartialList played by the
+Loris real-time synthesizer. Its Breakpoints are stored in arrays, one
+for each parameter, which are returned as memoryviews of the memory of
+the bank. numpy.asarray() wraps them without copying, and they keep the
+bank alive. The Breakpoints of Partial i are the partialNumBreakpoints()[i]
+Breakpoints from partialFirstBreakpoints()[i] on, including the fade in 
+and fade out Breakpoints inserted by the bank.
+
+Target samples and the Partial arrays are 32 bit integers, frequencies
+(Hz), amplitudes, bandwidths and phases are single precision floats.") PartialBankArrays;
+
+%feature("docstring",
+"Construct a bank of the Partials in a PartialList, for synthesis at
+the given sample rate. The Partials are faded in and out over the fade
+time (in seconds), pitch is their original pitch (in Hz). Other Python
+threads run while the bank is built.") PartialBankArrays::PartialBankArrays;
+
+%rename(PartialBank) PartialBankArrays;
+
+%inline 
+%{
+	class PartialBankArrays
+	{
+	public:
+		PartialBankArrays( const PartialList * partials, double pitch, double fadeTime, double srate )
+		{
+			try
+			{
+				ReleaseGIL unlocked;
+				m_bank = PartialBank::create( *partials, pitch, fadeTime, srate );
+			}
+			catch ( std::exception & ex )
+			{
+				throw_exception( ex.what() );
+			}
+		}
+		
+		long size( void ) const { return m_bank->size(); }
+		long numBreakpoints( void ) const { return m_bank->numBreakpoints(); }
+		double pitch( void ) const { return m_bank->pitch(); }
+		double fadeTime( void ) const { return m_bank->fadeTime(); }
+		double sampleRate( void ) const { return m_bank->sampleRate(); }
+		double duration( void ) const { return m_bank->duration(); }
+		
+		//	-- Breakpoint arrays --
+		
+		PyObject * samples( void ) const { return breakpointArray( 0, "i" ); }
+		PyObject * frequencies( void ) const { return breakpointArray( 1, "f" ); }
+		PyObject * amplitudes( void ) const { return breakpointArray( 2, "f" ); }
+		PyObject * bandwidths( void ) const { return breakpointArray( 3, "f" ); }
+		PyObject * phases( void ) const { return breakpointArray( 4, "f" ); }
+		
+		//	-- Partial arrays, fields of the PartialStruct array --
+		
+		PyObject * partialFirstBreakpoints( void ) const 
+			{ return partialArray( &m_bank->partials()->firstBreakpoint ); }
+		PyObject * partialNumBreakpoints( void ) const 
+			{ return partialArray( &m_bank->partials()->numBreakpoints ); }
+		PyObject * partialStartSamples( void ) const 
+			{ return partialArray( &m_bank->partials()->startSample ); }
+		PyObject * partialLabels( void ) const 
+			{ return partialArray( &m_bank->partials()->label ); }
+		
+	private:
+		PartialBank::Ptr m_bank;
+		
+		//	One of the arrays of PartialBank::breakpointMemory(), the
+		//	bank is built with float parameters and phases.
+		PyObject * breakpointArray( int which, const char * format ) const
+		{
+			PartialBank::MemoryRange ranges[ PartialBank::NumBreakpointArrays ];
+			m_bank->breakpointMemory( 0, m_bank->numBreakpoints(), ranges );
+			return newArray( m_bank, ranges[which].data, m_bank->numBreakpoints(),
+							 format, 4, 4, false );
+		}
+		
+		PyObject * partialArray( const int * first ) const
+		{
+			return newArray( m_bank, first, m_bank->size(), "i", sizeof(int),
+							 sizeof(PartialStruct), false );
+		}
+	};
+%}
 
+#endif
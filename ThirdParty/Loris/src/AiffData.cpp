@@ -311,7 +311,7 @@ readMarkerData( std::istream & s, MarkerCk & ck, unsigned long chunkSize )
 static std::istream & 
 readSamples( std::istream & s, std::vector< Byte > & bytes )
 {	
-	debugger << "reading " << bytes.size() << " bytes of sample data" << endl;
+	LORIS_DEBUGGER << "reading " << bytes.size() << " bytes of sample data" << endl;
 
 	//	read integer samples without byte swapping: 
 	BigEndian::read( s, bytes.size(), 1, (char*)(&bytes[0]) );
@@ -527,12 +527,12 @@ std::ostream &
 writeCommonData( std::ostream & s, const CommonCk & ck )
 {
 /*
-	debugger << "writing common chunk: " << endl;
-	debugger << "header id: " << ck.header.id << endl;
-	debugger << "size: " << ck.header.size << endl;
-	debugger << "channels: " << ck.channels << endl;
-	debugger << "sample frames: " << ck.sampleFrames << endl;
-	debugger << "bits per sample: " << ck.bitsPerSample << endl;
+	LORIS_DEBUGGER << "writing common chunk: " << endl;
+	LORIS_DEBUGGER << "header id: " << ck.header.id << endl;
+	LORIS_DEBUGGER << "size: " << ck.header.size << endl;
+	LORIS_DEBUGGER << "channels: " << ck.channels << endl;
+	LORIS_DEBUGGER << "sample frames: " << ck.sampleFrames << endl;
+	LORIS_DEBUGGER << "bits per sample: " << ck.bitsPerSample << endl;
 	//debugger << "rate: " << _sampleRate  << endl;
 */
 	
@@ -567,10 +567,10 @@ std::ostream &
 writeContainer( std::ostream & s, const ContainerCk & ck )
 {
 /*
-	debugger << "writing container: " << endl;
-	debugger << "header id: " << ck.header.id << endl;
-	debugger << "size: " << ck.header.size << endl;
-	debugger << "type: " << ck.formType << endl;
+	LORIS_DEBUGGER << "writing container: " << endl;
+	LORIS_DEBUGGER << "header id: " << ck.header.id << endl;
+	LORIS_DEBUGGER << "size: " << ck.header.size << endl;
+	LORIS_DEBUGGER << "type: " << ck.formType << endl;
 */
 	
 	//	write it out:
@@ -700,21 +700,17 @@ std::ostream &
 writeSampleData( std::ostream & s, const SoundDataCk & ck )
 {
 /*
-	debugger << "writing sample data: " << endl;
-	debugger << "header id: " << ck.header.id << endl;
-	debugger << "size: " << ck.header.size << endl;
-	debugger << "offset: " << ck.offset << endl;
-	debugger << "block size: " << ck.blockSize << endl;
+	LORIS_DEBUGGER << "writing sample data: " << endl;
+	LORIS_DEBUGGER << "header id: " << ck.header.id << endl;
+	LORIS_DEBUGGER << "size: " << ck.header.size << endl;
+	LORIS_DEBUGGER << "offset: " << ck.offset << endl;
+	LORIS_DEBUGGER << "block size: " << ck.blockSize << endl;
 */
 
 	//	write it out:
 	try 
 	{
-		BigEndian::write( s, 1, sizeof(ID), (char *)&ck.header.id );
-		BigEndian::write( s, 1, sizeof(Int_32), (char *)&ck.header.size );
-		BigEndian::write( s, 1, sizeof(Int_32), (char *)&ck.offset );
-		BigEndian::write( s, 1, sizeof(Int_32), (char *)&ck.blockSize );
-
+		writeSoundDataHeader( s, ck );
 		writeSamples( s, ck.sampleBytes );
 	}
 	catch( FileIOException & ex ) 
@@ -726,6 +722,23 @@ writeSampleData( std::ostream & s, const SoundDataCk & ck )
 	return s;
 }
 
+// ---------------------------------------------------------------------------
+//	writeSoundDataHeader
+// ---------------------------------------------------------------------------
+//	Write the Sound Data chunk up to its sample bytes, for writers that
+//	stream the samples after it.
+//
+std::ostream & 
+writeSoundDataHeader( std::ostream & s, const SoundDataCk & ck )
+{
+	BigEndian::write( s, 1, sizeof(ID), (char *)&ck.header.id );
+	BigEndian::write( s, 1, sizeof(Int_32), (char *)&ck.header.size );
+	BigEndian::write( s, 1, sizeof(Int_32), (char *)&ck.offset );
+	BigEndian::write( s, 1, sizeof(Int_32), (char *)&ck.blockSize );
+	
+	return s;
+}
+
 // -- sample conversion --
 
 // ---------------------------------------------------------------------------
@@ -747,7 +760,7 @@ convertBytesToSamples( const std::vector< Byte > & bytes,
 	const int bytesPerSample = bps / 8;
 	samples.resize( bytes.size() / bytesPerSample );
 
-	debugger << "converting " << samples.size() << " samples of size " 
+	LORIS_DEBUGGER << "converting " << samples.size() << " samples of size " 
 			 << bps << " bits" << endl;
 
 	//	shift sample bytes into a long integer, and 
@@ -808,7 +821,7 @@ convertSamplesToBytes( const std::vector< double > & samples,
 		++howManyBytes;
 	bytes.resize( howManyBytes );
 
-	debugger << "converting " << samples.size() << " samples to size " 
+	LORIS_DEBUGGER << "converting " << samples.size() << " samples to size " 
 			 << bps << " bits" << endl;
 
 	//	shift sample bytes into a long integer, and 
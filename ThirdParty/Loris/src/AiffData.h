@@ -334,6 +334,15 @@ writeMarkerData( std::ostream & s, const MarkerCk & ck );
 std::ostream & 
 writeSampleData( std::ostream & s, const SoundDataCk & ck );
 
+// ---------------------------------------------------------------------------
+//	writeSoundDataHeader
+// ---------------------------------------------------------------------------
+//	Write the Sound Data chunk up to its sample bytes, for writers that
+//	stream the samples after it.
+//
+std::ostream & 
+writeSoundDataHeader( std::ostream & s, const SoundDataCk & ck );
+
 // ---------------------------------------------------------------------------
 //	convertBytesToSamples
 // ---------------------------------------------------------------------------
@@ -0,0 +1,284 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * AiffWriter.C
+ *
+ * Implementation of class Loris::AiffWriter, export of samples to an AIFF
+ * file as they are rendered.
+ *
+ */
+#if HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include "AiffWriter.h"
+#include "AiffData.h"
+#include "LorisExceptions.h"
+#include "RealtimeSynthesizer.h"
+
+#include <algorithm>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	constructor
+// ---------------------------------------------------------------------------
+//!	Create or overwrite an AIFF file and write its header.
+//
+AiffWriter::AiffWriter( const std::string & filename, double samplerate, unsigned int numChannels,
+                        unsigned int bps, double midiNoteNum, const std::vector< Marker > & markers ) :
+    m_filename( filename ),
+    m_rate( samplerate ),
+    m_numChannels( numChannels ),
+    m_bps( bps ),
+    m_midiNoteNum( midiNoteNum ),
+    m_markers( markers )
+{
+    static const unsigned int ValidSizes[] = { 8, 16, 24, 32 };
+    if ( std::find( ValidSizes, ValidSizes+4, bps ) == ValidSizes+4 )
+    {
+        Throw( InvalidArgument, "Invalid bits-per-sample." );
+    }
+    if ( numChannels != 1 && numChannels != 2 )
+    {
+        Throw( InvalidArgument, "AiffWriter writes one or two channels." );
+    }
+    if ( samplerate <= 0 )
+    {
+        Throw( InvalidArgument, "Sample rate must be positive." );
+    }
+    if ( midiNoteNum < 0 || midiNoteNum > 128 )
+    {
+        Throw( InvalidArgument, "MIDI note number outside of the valid range [1,128]" );
+    }
+
+    m_stream.open( filename.c_str(), std::ofstream::binary );
+    if ( ! m_stream )
+    {
+        std::string s = "Could not create file \"";
+        s += filename;
+        s += "\". Failed to write AIFF file.";
+        Throw( FileIOException, s );
+    }
+    writeHeader();
+}
+
+// ---------------------------------------------------------------------------
+//	destructor
+// ---------------------------------------------------------------------------
+//!	Close the file if close() was not called, errors are ignored.
+//
+AiffWriter::~AiffWriter( void )
+{
+    try
+    {
+        close();
+    }
+    catch ( Exception & )
+    {
+    }
+}
+
+// ---------------------------------------------------------------------------
+//	write
+// ---------------------------------------------------------------------------
+//!	Write sample frames after the ones written before. The samples are
+//!	converted like the ones AiffFile writes, the bytes of an odd number
+//!	of 8 bit samples are padded by close() only.
+//
+void
+AiffWriter::write( const double * samples, std::size_t numFrames )
+{
+    m_samples.assign( samples, samples + numFrames * m_numChannels );
+    writeSamples();
+}
+
+// ---------------------------------------------------------------------------
+//	render
+// ---------------------------------------------------------------------------
+//!	Render all Partials of a bank in original pitch by a RealTimeSynthesizer
+//!	and write the samples after the ones written before, tileSize sample
+//!	frames at a time, up to the last Breakpoint of the bank. Samples delayed
+//!	by the latency of the engine are dropped, the file begins with the
+//!	sound like the one AiffFile renders.
+//
+void
+AiffWriter::render( PartialBank::Ptr bank, int tileSize )
+{
+    if ( ! bank || bank->sampleRate() != m_rate )
+    {
+        Throw( InvalidArgument, "The bank is not prepared for the sample rate of the AIFF file." );
+    }
+    if ( tileSize <= 0 )
+    {
+        Throw( InvalidArgument, "Tile size must be positive." );
+    }
+
+    std::vector< float > unused;
+    RealTimeSynthesizer synth( unused );
+    synth.setSampleRate( m_rate );
+    synth.setup( bank );
+    synth.prepare( tileSize );
+    synth.reset();
+
+    std::vector< float > channels( PartialStruct::NumChannels * tileSize );
+    float * outputs[PartialStruct::NumChannels];
+    for ( int c = 0; c < PartialStruct::NumChannels; ++c )
+        outputs[c] = channels.data() + c * tileSize;
+
+    const float * center = outputs[PartialStruct::Center];
+    const float * left = outputs[PartialStruct::Left];
+    const float * right = outputs[PartialStruct::Right];
+    const float * side = outputs[PartialStruct::Side];
+
+    //	the sound ends at the sample of the last Breakpoint of the bank
+    const long length = long( synth.duration() * m_rate + 0.5 ) + 1;
+    long skip = synth.latency();
+    for ( long written = 0; written < length; )
+    {
+        const int samples = (int) std::min< long >( tileSize, length + skip - written );
+        std::fill( channels.begin(), channels.end(), 0.f );
+        synth.synthesizeNext( outputs, samples );
+
+        const int first = (int) std::min< long >( skip, samples );
+        skip -= first;
+        m_samples.resize( ( samples - first ) * m_numChannels );
+        double * out = m_samples.data();
+        for ( int n = first; n < samples; ++n )
+        {
+            if ( m_numChannels == 1 )
+            {
+                *out++ = center[n] + left[n] + right[n] + side[n];
+            }
+            else
+            {
+                *out++ = center[n] + left[n] + side[n];
+                *out++ = center[n] + right[n] - side[n];
+            }
+        }
+        writeSamples();
+        written += samples - first;
+    }
+}
+
+// ---------------------------------------------------------------------------
+//	close
+// ---------------------------------------------------------------------------
+//!	Update the sizes in the header to the sample frames written, pad
+//!	the sample data to an even size and close the file.
+//
+void
+AiffWriter::close( void )
+{
+    if ( ! m_stream.is_open() )
+        return;
+
+    if ( ( m_numFrames * m_numChannels * ( m_bps / 8 ) ) % 2 )
+        m_stream.put( 0 );
+
+    m_stream.seekp( 0 );
+    writeHeader();
+    m_stream.close();
+    if ( m_stream.fail() )
+    {
+        Throw( FileIOException, "Failed to update the header of AIFF file \"" + m_filename + "\"." );
+    }
+}
+
+// ---------------------------------------------------------------------------
+//	writeSamples
+// ---------------------------------------------------------------------------
+//	Convert the samples of the sample frames to write and write them.
+//
+void
+AiffWriter::writeSamples( void )
+{
+    if ( ! m_stream.is_open() )
+    {
+        Throw( FileIOException, "AIFF file \"" + m_filename + "\" is closed." );
+    }
+
+    convertSamplesToBytes( m_samples, m_bytes, m_bps );
+    m_stream.write( m_bytes.data(), m_samples.size() * ( m_bps / 8 ) );
+    if ( ! m_stream )
+    {
+        Throw( FileIOException, "Failed to write samples to AIFF file \"" + m_filename + "\"." );
+    }
+    m_numFrames += m_samples.size() / m_numChannels;
+}
+
+// ---------------------------------------------------------------------------
+//	writeHeader
+// ---------------------------------------------------------------------------
+//	Write the header, the chunks AiffFile::write() writes before the sample
+//	bytes. Their size depends on the number of sample frames only, so they
+//	are written again over the first ones by close().
+//
+void
+AiffWriter::writeHeader( void )
+{
+    unsigned long dataSize = 0;
+
+    CommonCk commonChunk;
+    configureCommonCk( commonChunk, m_numFrames, m_numChannels, m_bps, m_rate );
+    dataSize += commonChunk.header.size + sizeof(CkHeader);
+
+    //	the sample bytes are not in the chunk, only counted
+    SoundDataCk soundDataChunk;
+    configureSoundDataCk( soundDataChunk, std::vector< double >(), m_bps );
+    Uint_32 sampleBytes = m_numFrames * m_numChannels * ( m_bps / 8 );
+    if ( sampleBytes % 2 )
+        ++sampleBytes;
+    soundDataChunk.header.size += sampleBytes;
+    dataSize += soundDataChunk.header.size + sizeof(CkHeader);
+
+    InstrumentCk instrumentChunk;
+    configureInstrumentCk( instrumentChunk, m_midiNoteNum );
+    dataSize += instrumentChunk.header.size + sizeof(CkHeader);
+
+    MarkerCk markerChunk;
+    if ( ! m_markers.empty() )
+    {
+        configureMarkerCk( markerChunk, m_markers, m_rate );
+        dataSize += markerChunk.header.size + sizeof(CkHeader);
+    }
+
+    ContainerCk containerChunk;
+    configureContainer( containerChunk, dataSize );
+
+    try
+    {
+        writeContainer( m_stream, containerChunk );
+        writeCommonData( m_stream, commonChunk );
+        if ( ! m_markers.empty() )
+            writeMarkerData( m_stream, markerChunk );
+        writeInstrumentData( m_stream, instrumentChunk );
+        writeSoundDataHeader( m_stream, soundDataChunk );
+    }
+    catch ( Exception & ex )
+    {
+        ex.append( " Failed to write AIFF file." );
+        throw;
+    }
+}
+
+}	//	end of namespace Loris
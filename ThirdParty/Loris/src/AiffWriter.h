@@ -0,0 +1,151 @@
+#ifndef INCLUDE_AIFF_WRITER_H
+#define INCLUDE_AIFF_WRITER_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * AiffWriter.h
+ *
+ * Definition of class Loris::AiffWriter, export of samples to an AIFF file
+ * as they are rendered.
+ *
+ */
+#include "Marker.h"
+#include "PartialBank.h"
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	class AiffWriter
+//
+//! An AiffWriter exports samples to an AIFF file in the order they are
+//! rendered, one block after another, so exporting a long sound takes
+//! the memory of a block instead of all of its samples, which AiffFile
+//! holds until it is written.
+//!
+//! The header is written when the file is created and its sizes are
+//! updated by close(), when the number of sample frames is known. Until
+//! then the file is not a valid AIFF file.
+//
+class AiffWriter
+{
+//	-- public interface --
+public:
+    //! Samples rendered by render() at once, per channel.
+    enum { DefaultTileSize = 8192 };
+
+//	-- construction --
+
+    //! Create or overwrite an AIFF file and write its header.
+    //!
+    //! \param filename is the name or path of the AIFF samples file.
+    //! \param samplerate is the rate (Hz) of the samples.
+    //! \param numChannels is the number of channels, 1 or 2.
+    //! \param bps is the number of bits per sample to store in the
+    //! samples file (8, 16, 24, or 32).
+    //! \param midiNoteNum is the fractional MIDI note number of the sound,
+    //! 60 if it has no definable pitch.
+    //! \param markers are the AIFF markers of the file.
+    //! \throw InvalidArgument if a parameter is invalid.
+    //! \throw FileIOException if the file could not be created.
+    AiffWriter( const std::string & filename, double samplerate, unsigned int numChannels = 1,
+                unsigned int bps = 16, double midiNoteNum = 60,
+                const std::vector< Marker > & markers = std::vector< Marker >() );
+
+    //! Close the file if close() was not called, errors are ignored.
+    ~AiffWriter( void );
+
+//	-- export --
+
+    //! Write sample frames after the ones written before.
+    //!
+    //! \param samples are numFrames sample frames, the samples of a frame
+    //! one after another (interleaved) if there are two channels.
+    //! \param numFrames is the number of sample frames.
+    //! \throw FileIOException if the samples could not be written.
+    void write( const double * samples, std::size_t numFrames );
+
+    //! Render all Partials of a bank in original pitch by a RealTimeSynthesizer
+    //! and write the samples after the ones written before, tileSize sample
+    //! frames at a time, up to the last Breakpoint of the bank. The samples
+    //! of a mono file are all channels of the bank mixed, a stereo one has
+    //! the Center Partials in both channels and the Side ones in the left one
+    //! and inverted in the right one.
+    //!
+    //! \param bank The Partials, prepared for the sample rate of the file.
+    //! \param tileSize Number of sample frames rendered at once.
+    //! \throw InvalidArgument if the bank has another sample rate, or the
+    //! tile size is not positive.
+    //! \throw FileIOException if the samples could not be written.
+    void render( PartialBank::Ptr bank, int tileSize = DefaultTileSize );
+
+    //! Update the sizes in the header to the sample frames written, pad
+    //! the sample data to an even size and close the file. Writing after
+    //! close() is not possible.
+    //!
+    //! \throw FileIOException if the file could not be updated.
+    void close( void );
+
+//	-- access --
+
+    //! Return the number of sample frames written.
+    std::size_t numFrames( void ) const { return m_numFrames; }
+
+    //! Return the sample rate (Hz) of the file.
+    double sampleRate( void ) const { return m_rate; }
+
+    //! Return the number of channels of the file.
+    unsigned int numChannels( void ) const { return m_numChannels; }
+
+//	-- implementation --
+private:
+    //! Write the header, the sizes depending on the number of sample frames
+    //! are the ones of the frames written so far.
+    void writeHeader( void );
+
+    //! Convert the samples of the sample frames to write and write them.
+    void writeSamples( void );
+
+    std::ofstream m_stream;
+    std::string m_filename;
+    double m_rate;
+    unsigned int m_numChannels;
+    unsigned int m_bps;
+    double m_midiNoteNum;
+    std::vector< Marker > m_markers;
+
+    std::size_t m_numFrames = 0;
+    std::vector< double > m_samples;        // samples of the frames to write, reused
+    std::vector< char > m_bytes;            // bytes of the samples written, reused
+
+    AiffWriter( const AiffWriter & ) = delete;
+    AiffWriter & operator=( const AiffWriter & ) = delete;
+};
+
+}	//	end of namespace Loris
+
+#endif /* ndef INCLUDE_AIFF_WRITER_H */
@@ -43,9 +43,12 @@
 #include "BreakpointEnvelope.h"
 #include "Envelope.h"
 #include "F0Estimate.h"
+#include "FrameCache.h"
 #include "LorisExceptions.h"
+#include "LorisTrace.h"
 #include "KaiserWindow.h"
 #include "Notifier.h"
+#include "ParallelFor.h"   //  for FloatingPointEnvironment
 #include "Partial.h"
 #include "PartialPtrs.h"
 #include "ReassignedSpectrum.h"
@@ -57,10 +60,17 @@
 
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <deque>
+#include <exception>
 #include <functional>   //  for std::plus
+#include <future>
 #include <memory>
 #include <numeric>      //  for std::inner_product
+#include <system_error>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -90,6 +100,21 @@ static double compare2nd( const Pair & p1, const Pair & p2 )
     return p1.second < p2.second;
 }
 
+//  Return the time in seconds, for profiling stages of the analysis.
+static double profileClock( void )
+{
+    return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+//  Add the time since start to a stage of a Profile and return the time
+//  now, the start of the next stage.
+static double profileStage( double & stageTime, double start )
+{
+    const double now = profileClock();
+    stageTime += now - start;
+    return now;
+}
+
 // ---------------------------------------------------------------------------
 //  LinearEnvelopeBuilder
 // ---------------------------------------------------------------------------
@@ -127,6 +152,7 @@ class FundamentalBuilder : public LinearEnvelopeBuilder
     double mAmpThresh, mFreqThresh;
     
     std::vector< double > amplitudes, frequencies;
+    F0Estimate::Workspace mWorkspace;   //  candidates of the estimates, reused by frames
     
     const double mMinConfidence;    // 0.9, this could be made a parameter, 
                                     // or raised to make estimates smoother
@@ -186,7 +212,7 @@ void FundamentalBuilder::build( const Peaks & peaks, double frameTime )
         const double fmax = mFmaxEnv->valueAt( frameTime );
         
         //  estimate f0
-        F0Estimate est( amplitudes, frequencies, fmin, fmax, 0.1 );
+        F0Estimate est( amplitudes, frequencies, fmin, fmax, 0.1, &mWorkspace );
         
         if ( est.confidence() >= mMinConfidence &&
              est.frequency() > fmin && est.frequency() < fmax  )
@@ -235,6 +261,19 @@ void AmpEnvBuilder::build( const Peaks & peaks, double frameTime )
 //! \param resolutionHz is the frequency resolution in Hz.
 //
 Analyzer::Analyzer( double resolutionHz )
+:
+    m_coarseHopTime( 0 ),
+    m_freqCeiling( 0 ),
+    m_progressListener( 0 ),
+    m_cancellation( 0 ),
+    m_profile( 0 ),
+    m_frameCache( 0 ),
+    m_numThreads( 0 ),
+    m_transformOversampling( 2. ),
+    m_fastTransformLength( false ),
+    m_buildFundamentalEnv( true ),
+    m_buildAmpEnv( true ),
+    m_buildNoiseBands( false )
 {
     configure( resolutionHz, 2.0 * resolutionHz );
 }
@@ -253,6 +292,19 @@ Analyzer::Analyzer( double resolutionHz )
 //! analysis window in Hz.
 //
 Analyzer::Analyzer( double resolutionHz, double windowWidthHz )
+:
+    m_coarseHopTime( 0 ),
+    m_freqCeiling( 0 ),
+    m_progressListener( 0 ),
+    m_cancellation( 0 ),
+    m_profile( 0 ),
+    m_frameCache( 0 ),
+    m_numThreads( 0 ),
+    m_transformOversampling( 2. ),
+    m_fastTransformLength( false ),
+    m_buildFundamentalEnv( true ),
+    m_buildAmpEnv( true ),
+    m_buildNoiseBands( false )
 {
     configure( resolutionHz, windowWidthHz );
 }
@@ -271,6 +323,19 @@ Analyzer::Analyzer( double resolutionHz, double windowWidthHz )
 //! analysis window in Hz.
 //
 Analyzer::Analyzer( const Envelope & resolutionEnv, double windowWidthHz )
+:
+    m_coarseHopTime( 0 ),
+    m_freqCeiling( 0 ),
+    m_progressListener( 0 ),
+    m_cancellation( 0 ),
+    m_profile( 0 ),
+    m_frameCache( 0 ),
+    m_numThreads( 0 ),
+    m_transformOversampling( 2. ),
+    m_fastTransformLength( false ),
+    m_buildFundamentalEnv( true ),
+    m_buildAmpEnv( true ),
+    m_buildNoiseBands( false )
 {
     configure( resolutionEnv, windowWidthHz );
 }
@@ -291,11 +356,26 @@ Analyzer::Analyzer( const Analyzer & other ) :
     m_freqFloor( other.m_freqFloor ),
     m_freqDrift( other.m_freqDrift ),
     m_hopTime( other.m_hopTime ),
+    m_coarseHopTime( other.m_coarseHopTime ),
+    m_windowBands( other.m_windowBands ),
+    m_harmonicFundamental( other.isHarmonic() ? other.m_harmonicFundamental->clone() : 0 ),
+    m_freqCeiling( other.m_freqCeiling ),
     m_cropTime( other.m_cropTime ),
     m_bwAssocParam( other.m_bwAssocParam ),
     m_sidelobeLevel( other.m_sidelobeLevel ),
     m_phaseCorrect( other.m_phaseCorrect ),
-    m_partials( other.m_partials )
+    m_partials( other.m_partials ),
+    m_progressListener( other.m_progressListener ),
+    m_cancellation( other.m_cancellation ),
+    m_profile( other.m_profile ),
+    m_frameCache( other.m_frameCache ),
+    m_numThreads( other.m_numThreads ),
+    m_transformOversampling( other.m_transformOversampling ),
+    m_fastTransformLength( other.m_fastTransformLength ),
+    m_buildFundamentalEnv( other.m_buildFundamentalEnv ),
+    m_buildAmpEnv( other.m_buildAmpEnv ),
+    m_buildNoiseBands( other.m_buildNoiseBands ),
+    m_noiseBands( other.m_noiseBands )
 {
     m_f0Builder.reset( other.m_f0Builder->clone() );
     m_ampEnvBuilder.reset( other.m_ampEnvBuilder->clone() );
@@ -321,11 +401,26 @@ Analyzer::operator=( const Analyzer & rhs )
         m_freqFloor = rhs.m_freqFloor;  
         m_freqDrift = rhs.m_freqDrift;
         m_hopTime = rhs.m_hopTime;
+        m_coarseHopTime = rhs.m_coarseHopTime;
+        m_windowBands = rhs.m_windowBands;
+        m_harmonicFundamental.reset( rhs.isHarmonic() ? rhs.m_harmonicFundamental->clone() : 0 );
+        m_freqCeiling = rhs.m_freqCeiling;
         m_cropTime = rhs.m_cropTime;
         m_bwAssocParam = rhs.m_bwAssocParam;
         m_sidelobeLevel = rhs.m_sidelobeLevel;
         m_phaseCorrect = rhs.m_phaseCorrect;
         m_partials = rhs.m_partials;
+        m_progressListener = rhs.m_progressListener;
+        m_cancellation = rhs.m_cancellation;
+        m_profile = rhs.m_profile;
+        m_frameCache = rhs.m_frameCache;
+        m_numThreads = rhs.m_numThreads;
+        m_transformOversampling = rhs.m_transformOversampling;
+        m_fastTransformLength = rhs.m_fastTransformLength;
+        m_buildFundamentalEnv = rhs.m_buildFundamentalEnv;
+        m_buildAmpEnv = rhs.m_buildAmpEnv;
+        m_buildNoiseBands = rhs.m_buildNoiseBands;
+        m_noiseBands = rhs.m_noiseBands;
 
         m_f0Builder.reset( rhs.m_f0Builder->clone() );
         m_ampEnvBuilder.reset( rhs.m_ampEnvBuilder->clone() );
@@ -334,6 +429,28 @@ Analyzer::operator=( const Analyzer & rhs )
     return *this;
 }
 
+// ---------------------------------------------------------------------------
+//  Profile::operator+=
+// ---------------------------------------------------------------------------
+//! Add the times and counts of another Profile.
+//
+Analyzer::Profile & 
+Analyzer::Profile::operator+=( const Profile & other )
+{
+    windowTime += other.windowTime;
+    transformTime += other.transformTime;
+    selectTime += other.selectTime;
+    thinTime += other.thinTime;
+    bandwidthTime += other.bandwidthTime;
+    buildTime += other.buildTime;
+    fixFrequencyTime += other.fixFrequencyTime;
+    frames += other.frames;
+    cachedFrames += other.cachedFrames;
+    transforms += other.transforms;
+    peaks += other.peaks;
+    return *this;
+}
+
 // ---------------------------------------------------------------------------
 //  Analyzer destructor
 // ---------------------------------------------------------------------------
@@ -530,6 +647,304 @@ Analyzer::configure( const Envelope & resolutionEnv, double windowWidthHz )
 }
 
 // -- analysis --
+// ---------------------------------------------------------------------------
+//  BufferSamples and SourceSamples (sample providers, HELPERS)
+// ---------------------------------------------------------------------------
+//  Make ranges of samples available to analyzeFrames(). fetch() makes the
+//  samples on the half open range [begin, end) available, pointed to by
+//  samps, and returns false if the analysis should stop. prefetch() tells
+//  the range fetched next, so a provider can get it ready while the frames
+//  of the current one are analyzed (the current samples stay valid until
+//  the next fetch()).
+//
+//  BufferSamples: all samples are in memory already.
+//
+template< class Sample >
+struct BufferSamples
+{
+    typedef Sample sample_type;
+    
+    const Sample * buffer;
+    
+    bool fetch( long begin, long, const Sample * & samps )
+    {
+        samps = buffer + begin;
+        return true;
+    }
+    
+    void prefetch( long, long ) {}
+};
+
+//  SourceSamples: samples are read from a SampleSource into a chunk 
+//  buffer, one range at a time. The range prefetched is read on a thread 
+//  of its own into a second buffer, so decoding the source overlaps the
+//  analysis of the chunk before. Only one read is in progress at a time,
+//  the source does not need to be thread safe.
+//
+class SourceSamples
+{
+public:
+    typedef float sample_type;
+    
+    SourceSamples( Analyzer::SampleSource & source ) : 
+        m_source( source ),
+        m_nextBegin( 0 ),
+        m_nextEnd( 0 )
+    {
+    }
+    
+    ~SourceSamples( void )
+    {
+        //  an abandoned read is waited for, its result does not matter:
+        if ( m_next.valid() )
+        {
+            m_next.wait();
+        }
+    }
+    
+    bool fetch( long begin, long end, const float * & samps )
+    {
+        if ( m_next.valid() )
+        {
+            //  rethrows the exception of the read, if any:
+            const bool read = m_next.get();
+            if ( begin == m_nextBegin && end == m_nextEnd )
+            {
+                if ( ! read )
+                {
+                    return false;
+                }
+                m_chunk.swap( m_nextChunk );
+                samps = &m_chunk.front();
+                return true;
+            }
+        }
+        
+        m_chunk.resize( end - begin );
+        if ( ! m_source.read( begin, end - begin, &m_chunk.front() ) )
+        {
+            return false;
+        }
+        samps = &m_chunk.front();
+        return true;
+    }
+    
+    void prefetch( long begin, long end )
+    {
+        if ( m_next.valid() )
+        {
+            m_next.wait();
+        }
+        
+        m_nextBegin = begin;
+        m_nextEnd = end;
+        m_nextChunk.resize( end - begin );
+        try
+        {
+            m_next = std::async( std::launch::async, 
+                                 &Analyzer::SampleSource::read, &m_source, 
+                                 begin, end - begin, &m_nextChunk.front() );
+        }
+        catch ( std::system_error & )
+        {
+            //  no thread to read on, fetch() reads the range itself
+        }
+    }
+    
+private:
+    Analyzer::SampleSource & m_source;
+    std::vector< float > m_chunk;
+    std::vector< float > m_nextChunk;   //  range being read ahead
+    long m_nextBegin, m_nextEnd;
+    std::future< bool > m_next;         //  read of the next range, if any
+};
+
+//  DecimatedSamples: samples of another provider low-pass filtered and
+//  decimated by an integer factor, decimated sample k is filtered sample
+//  k * factor (the filter has linear phase, its delay is compensated).
+//  Only the kept samples are filtered. Taps outside the samples are 
+//  clipped, as the analysis windows are.
+//
+template< class Samples >
+class DecimatedSamples
+{
+public:
+    typedef float sample_type;
+    
+    DecimatedSamples( Samples & samples, long numSamples, long factor, 
+                      const std::vector< double > & taps ) :
+        m_samples( samples ),
+        m_numSamples( numSamples ),
+        m_factor( factor ),
+        m_taps( taps )
+    {
+    }
+    
+    bool fetch( long begin, long end, const float * & samps )
+    {
+        const long half = long( m_taps.size() / 2 );
+        long first, last;
+        samplesFiltered( begin, end, first, last );
+        const typename Samples::sample_type * in = 0;
+        if ( ! m_samples.fetch( first, last, in ) )
+        {
+            return false;
+        }
+        
+        m_chunk.resize( end - begin );
+        for ( long k = begin; k < end; ++k )
+        {
+            const long center = k * m_factor;
+            const long from = std::max( center - half, first );
+            const long to = std::min( center + half + 1, last );
+            const double * tap = &m_taps[ from - ( center - half ) ];
+            double sum = 0.;
+            for ( long i = from; i < to; ++i )
+            {
+                sum += *tap++ * in[ i - first ];
+            }
+            m_chunk[ k - begin ] = float( sum );
+        }
+        samps = &m_chunk.front();
+        return true;
+    }
+    
+    void prefetch( long begin, long end )
+    {
+        long first, last;
+        samplesFiltered( begin, end, first, last );
+        m_samples.prefetch( first, last );
+    }
+    
+private:
+    //  the range [first, last) of samples filtered into the
+    //  decimated samples [begin, end):
+    void samplesFiltered( long begin, long end, long & first, long & last ) const
+    {
+        const long half = long( m_taps.size() / 2 );
+        first = std::max( begin * m_factor - half, 0L );
+        last = std::min( ( end - 1 ) * m_factor + half + 1, m_numSamples );
+    }
+    
+    Samples & m_samples;
+    long m_numSamples;
+    long m_factor;
+    const std::vector< double > & m_taps;
+    std::vector< float > m_chunk;
+};
+
+// ---------------------------------------------------------------------------
+//  FrameSelector (HELPER)
+// ---------------------------------------------------------------------------
+//  Choose the short-time frames of each batch that analyzeFrames() 
+//  analyzes. All frames are analyzed, unless adaptive hop analysis is
+//  enabled (stride larger than one). Then only every stride-th frame
+//  is analyzed, except around transients, where every frame is.
+//
+//  Transients are onsets in the short-time energy of the samples: the
+//  energy of the last window length rising TransientRise times above
+//  the energy of the window length before it. Energies are kept as mean 
+//  squares of hop long blocks centered at the frames, carried over from
+//  batch to batch (frames of earlier batches are not revisited, so a
+//  transient found at a batch start is not refined backwards).
+//
+class FrameSelector
+{
+public:
+    FrameSelector( long hop, long winlen, long stride, double floorAmplitude ) :
+        m_hop( hop ),
+        m_blocksPerWindow( std::max( winlen / hop, 1L ) ),
+        m_stride( std::max( stride, 1L ) ),
+        m_minMeanSquare( 0.5 * floorAmplitude * floorAmplitude ),
+        m_denseUntil( -1 )
+    {
+    }
+
+    //  Fill frames with the indices (relative to firstFrame) of the
+    //  frames of a batch to analyze. Samples of the window of every 
+    //  frame of the batch are in the chunk [chunkBegin, chunkEnd).
+    template< class Sample >
+    void select( const Sample * chunk, long chunkBegin, long chunkEnd,
+                 long firstFrame, long batchFrames, long numFrames,
+                 std::vector< long > & frames )
+    {
+        frames.clear();
+        
+        if ( m_stride == 1 )
+        {
+            for ( long k = 0; k < batchFrames; ++k )
+            {
+                frames.push_back( k );
+            }
+            return;
+        }
+        
+        //  onsets make frames near them dense:
+        std::vector< char > dense( batchFrames, 0 );
+        for ( long k = 0; k < batchFrames && firstFrame + k <= m_denseUntil; ++k )
+        {
+            dense[ k ] = 1;
+        }
+        
+        for ( long k = 0; k < batchFrames; ++k )
+        {
+            const long center = ( firstFrame + k ) * m_hop;
+            const long b = std::max( center - m_hop / 2, chunkBegin );
+            const long e = std::min( center - m_hop / 2 + m_hop, chunkEnd );
+            double sumSquares = 0;
+            for ( long i = b; i < e; ++i )
+            {
+                const double x = chunk[ i - chunkBegin ];
+                sumSquares += x * x;
+            }
+            m_blocks.push_back( sumSquares / std::max( e - b, 1L ) );
+            if ( long( m_blocks.size() ) > 2 * m_blocksPerWindow )
+            {
+                m_blocks.pop_front();
+            }
+            
+            //  compare the last window length to the one before:
+            const long numRecent = std::min( m_blocksPerWindow, long( m_blocks.size() ) );
+            const double recent = 
+                std::accumulate( m_blocks.end() - numRecent, m_blocks.end(), 0. );
+            const double older = 
+                std::accumulate( m_blocks.begin(), m_blocks.end() - numRecent, 0. );
+            if ( recent > m_minMeanSquare * numRecent && recent > TransientRise * older )
+            {
+                //  the onset is somewhere in the recent window length,
+                //  analyze densely from a window length before it to a 
+                //  window length after it:
+                const long from = std::max( k - 2 * m_blocksPerWindow, 0L );
+                const long to = std::min( k + m_blocksPerWindow, batchFrames - 1 );
+                std::fill( dense.begin() + from, dense.begin() + to + 1, 1 );
+                m_denseUntil = std::max( m_denseUntil, firstFrame + k + m_blocksPerWindow );
+            }
+        }
+        
+        for ( long k = 0; k < batchFrames; ++k )
+        {
+            const long frame = firstFrame + k;
+            if ( dense[ k ] || 0 == frame % m_stride || frame == numFrames - 1 )
+            {
+                frames.push_back( k );
+            }
+        }
+    }
+
+private:
+    //  energy ratio (6 dB) indicating a transient
+    static const double TransientRise;
+    
+    long m_hop;                     //  samples between frames
+    long m_blocksPerWindow;         //  hop long blocks in a window length
+    long m_stride;                  //  frames per coarse hop
+    double m_minMeanSquare;         //  quieter onsets are ignored
+    long m_denseUntil;              //  last frame made dense by an earlier batch
+    std::deque< double > m_blocks;  //  mean squares of the last frames' blocks
+};
+
+const double FrameSelector::TransientRise = 4.0;
+
 // ---------------------------------------------------------------------------
 //  analyze
 // ---------------------------------------------------------------------------
@@ -606,111 +1021,575 @@ void
 Analyzer::analyze( const double * bufBegin, const double * bufEnd, double srate,
                    const Envelope & reference )
 { 
+    BufferSamples< double > samples = { bufBegin };
+    analyzeSamples( samples, long(bufEnd - bufBegin), srate, reference );
+}
+
+// ---------------------------------------------------------------------------
+//  analyze
+// ---------------------------------------------------------------------------
+//! Analyze a range of (mono) single precision samples at the given 
+//! sample rate (in Hz) and store the extracted Partials in the 
+//! Analyzer's PartialList (std::list of Partials). The samples are
+//! converted as each short-time frame is windowed, so no double
+//! precision copy of the buffer is needed.
+//! 
+//! \param bufBegin is a pointer to a buffer of floating point samples
+//! \param bufEnd is (one-past) the end of a buffer of floating point 
+//! samples
+//! \param srate is the sample rate of the samples in the buffer
+//
+void 
+Analyzer::analyze( const float * bufBegin, const float * bufEnd, double srate )
+{ 
+    BreakpointEnvelope reference( 1.0 );
+    analyze( bufBegin, bufEnd, srate, reference ); 
+}
+
+// ---------------------------------------------------------------------------
+//  analyze
+// ---------------------------------------------------------------------------
+//! Analyze a range of (mono) single precision samples at the given 
+//! sample rate (in Hz) and store the extracted Partials in the 
+//! Analyzer's PartialList (std::list of Partials). Use the specified 
+//! envelope as a frequency reference for Partial tracking. The samples
+//! are converted as each short-time frame is windowed, so no double
+//! precision copy of the buffer is needed.
+//! 
+//! \param bufBegin is a pointer to a buffer of floating point samples
+//! \param bufEnd is (one-past) the end of a buffer of floating point 
+//! samples
+//! \param srate is the sample rate of the samples in the buffer
+//! \param reference is an Envelope having the approximate
+//! frequency contour expected of the resulting Partials.
+//
+void 
+Analyzer::analyze( const float * bufBegin, const float * bufEnd, double srate,
+                   const Envelope & reference )
+{ 
+    BufferSamples< float > samples = { bufBegin };
+    analyzeSamples( samples, long(bufEnd - bufBegin), srate, reference );
+}
+
+// ---------------------------------------------------------------------------
+//  analyze
+// ---------------------------------------------------------------------------
+//! Analyze (mono) samples read from a SampleSource at the given sample
+//! rate (in Hz) and store the extracted Partials in the Analyzer's 
+//! PartialList (std::list of Partials). The samples are read in chunks
+//! as the analysis goes, so memory used for samples is bounded by
+//! the analysis window length, not by the source length. 
+//!
+//! \param source provides the samples to analyze
+//! \param srate is the sample rate of the samples
+//
+void 
+Analyzer::analyze( SampleSource & source, double srate )
+{
+    BreakpointEnvelope reference( 1.0 );
+    analyze( source, srate, reference ); 
+}
+
+// ---------------------------------------------------------------------------
+//  analyze
+// ---------------------------------------------------------------------------
+//! Analyze (mono) samples read from a SampleSource at the given sample
+//! rate (in Hz) and store the extracted Partials in the Analyzer's 
+//! PartialList (std::list of Partials). Use the specified envelope as 
+//! a frequency reference for Partial tracking. The samples are read in 
+//! chunks as the analysis goes, so memory used for samples is bounded
+//! by the analysis window length, not by the source length. 
+//!
+//! \param source provides the samples to analyze
+//! \param srate is the sample rate of the samples
+//! \param reference is an Envelope having the approximate
+//! frequency contour expected of the resulting Partials.
+//
+void 
+Analyzer::analyze( SampleSource & source, double srate, const Envelope & reference )
+{
+    SourceSamples samples( source );
+    analyzeSamples( samples, source.numSamples(), srate, reference );
+}
+
+// ---------------------------------------------------------------------------
+//  frameSpacing
+// ---------------------------------------------------------------------------
+//! Return the distance of short-time frames in samples at srate (of
+//! the samples before they are decimated). Analyses of parts of a
+//! sound find frames of each other in a FrameCache only if their 
+//! origins are a multiple of it apart. With adaptive hop analysis it
+//! is the coarse hop, so the same frames are analyzed between
+//! transients.
+//!
+//! \param  srate is the sample rate of the samples analyzed
+//
+long
+Analyzer::frameSpacing( double srate ) const
+{
+    //  the hop of analyzeFrames, at the decimated rate
+    const long factor = decimationFactor( srate );
+    return std::max( long( m_hopTime * ( srate / factor ) ), 1L ) * factor * coarseStride();
+}
+
+// ---------------------------------------------------------------------------
+//  coarseStride
+// ---------------------------------------------------------------------------
+//  Return the number of hops in a coarse hop, 1 if adaptive hop
+//  analysis is not enabled.
+//
+long
+Analyzer::coarseStride( void ) const
+{
+    return ( m_coarseHopTime > m_hopTime ) ? long( m_coarseHopTime / m_hopTime + 0.5 ) : 1L;
+}
+
+// ---------------------------------------------------------------------------
+//  decimationFactor
+// ---------------------------------------------------------------------------
+//  Return the factor samples at srate are decimated by before they are
+//  analyzed, 1 if they are analyzed at their own rate. The decimated
+//  Nyquist frequency is at least CeilingMargin times the ceiling, leaving
+//  room for the transition band of the low-pass.
+//
+long
+Analyzer::decimationFactor( double srate ) const
+{
+    const double CeilingMargin = 1.25;
+    if ( m_freqCeiling <= 0 )
+    {
+        return 1;
+    }
+    return std::max( long( 0.5 * srate / ( CeilingMargin * m_freqCeiling ) ), 1L );
+}
+
+// ---------------------------------------------------------------------------
+//  analyzeSamples
+// ---------------------------------------------------------------------------
+//  Analyze numSamples samples provided by Samples, decimated first if
+//  the frequency ceiling allows it. The low-pass is a Kaiser windowed 
+//  sinc cutting at the decimated Nyquist frequency, its transition band
+//  ends where components would alias below the ceiling, and it rejects
+//  them down to the amplitude floor. Times of frames are computed from 
+//  the decimated rate, so Partials are in the time of the original 
+//  samples.
+//
+template< class Samples >
+void 
+Analyzer::analyzeSamples( Samples & samples, long numSamples, double srate,
+                          const Envelope & reference )
+{
+    const long factor = decimationFactor( srate );
+    if ( 1 == factor )
+    {
+        analyzeFrames( samples, numSamples, srate, reference );
+        return;
+    }
+    
+    LORIS_DEBUGGER << "Decimating samples by " << factor << endl;
+    const double nyquist = 0.5 * srate / factor;
+    const double transition = 2. * ( nyquist - m_freqCeiling );
+    const double shape = KaiserWindow::computeShape( std::max( - m_ampFloor, 60. ) );
+    long len = KaiserWindow::computeLength( transition / srate, shape );
+    if (! (len % 2)) 
+    {
+        ++len;
+    }
+    
+    std::vector< double > taps( len );
+    KaiserWindow::buildWindow( taps, shape );
+    const long half = len / 2;
+    for ( long n = 0; n < len; ++n )
+    {
+        const double x = Pi * ( n - half );
+        taps[ n ] *= ( 0 == n - half ) ? 1. / factor : std::sin( x / factor ) / x;
+    }
+    
+    DecimatedSamples< Samples > decimated( samples, numSamples, factor, taps );
+    analyzeFrames( decimated, ( numSamples + factor - 1 ) / factor, srate / factor, reference,
+                   factor, ( half + factor - 1 ) / factor );
+}
+
+// ---------------------------------------------------------------------------
+//  analyzeFrames
+// ---------------------------------------------------------------------------
+//  Analyze numSamples samples provided by Samples (BufferSamples or 
+//  SourceSamples, having a fetch member that makes a range of samples 
+//  available).
+//
+template< class Samples >
+void 
+Analyzer::analyzeFrames( Samples & samples, long numSamples, double srate,
+                         const Envelope & reference, long step, long guard )
+{ 
+    typedef typename Samples::sample_type Sample;
+    
     //  configure the reassigned spectral analyzer, 
     //  always use odd-length windows:
 
-    //  Kaiser window
+    //  Kaiser window, and the windows of the bands analyzed with
+    //  other widths:
     double winshape = KaiserWindow::computeShape( sidelobeLevel() );
-    long winlen = KaiserWindow::computeLength( windowWidth() / srate, winshape );    
-    if (! (winlen % 2)) 
+    std::vector< long > winlens;
+    winlens.push_back( KaiserWindow::computeLength( windowWidth() / srate, winshape ) );
+    for ( const WindowBand & band : m_windowBands )
     {
-        ++winlen;
+        winlens.push_back( KaiserWindow::computeLength( band.windowWidth / srate, winshape ) );
+    }
+    for ( long & len : winlens )
+    {
+        if (! (len % 2)) 
+        {
+            ++len;
+        }
     }
-    debugger << "Using Kaiser window of length " << winlen << endl;
+    LORIS_DEBUGGER << "Using Kaiser window of length " << winlens.front() << endl;
     
-    std::vector< double > window( winlen );
-    KaiserWindow::buildWindow( window, winshape );
+    //  frames read the samples of the longest window:
+    const long winlen = *std::max_element( winlens.begin(), winlens.end() );
     
-    std::vector< double > windowDeriv( winlen );
-    KaiserWindow::buildTimeDerivativeWindow( windowDeriv, winshape );
-       
-    ReassignedSpectrum spectrum( window, windowDeriv );   
+    //  the short-time frames are analyzed concurrently, each thread
+    //  needs its own spectra (all of them sharing the windows, which
+    //  are cached, see ReassignedSpectrum), selector, bandwidth 
+    //  associator and buffers for the Peaks of a band and for thinning
+    //  Peaks (reused for all its frames):
+    const unsigned int numThreads = 0 != m_numThreads ? m_numThreads 
+                                    : std::max( std::thread::hardware_concurrency(), 1u );
+    std::vector< std::vector< double > > thinBuffers( numThreads );
+    std::vector< Peaks > bandBuffers( numThreads );
     
-    //  configure the peak selection and partial formation policies:
-    SpectralPeakSelector selector( srate, m_cropTime );
-    PartialBuilder builder( m_freqDrift, reference );
+    //  stages of each thread are profiled apart, and added to the
+    //  Profile at the end:
+    std::vector< Profile > profiles( 0 != m_profile ? numThreads : 0 );
+    Profile * const profile = 0 != m_profile ? &profiles[ 0 ] : 0;
+    double stageStart = 0 != profile ? profileClock() : 0.;
+    
+    std::vector< std::vector< std::unique_ptr< ReassignedSpectrum > > > spectra( numThreads );
+    std::vector< SpectralPeakSelector > selectors;
+    for ( unsigned int t = 0; t < numThreads; ++t )
+    {
+        for ( long len : winlens )
+        {
+            spectra[ t ].emplace_back( new ReassignedSpectrum( len, winshape, transformLength( len ) ) );
+        }
+        selectors.push_back( SpectralPeakSelector( srate, m_cropTime ) );
+    }
     
     //  configure bw association policy, unless
     //  bandwidth association is disabled:
-    std::auto_ptr< AssociateBandwidth > bwAssociator;
+    std::vector< std::unique_ptr< AssociateBandwidth > > bwAssociators( numThreads );
     if( m_bwAssocParam > 0 )
     {
-        debugger << "Using bandwidth association regions of width " 
-                 << bwRegionWidth() << " Hz" << endl;
-        bwAssociator.reset( new AssociateBandwidth( bwRegionWidth(), srate ) );
+        LORIS_DEBUGGER << "Using bandwidth association regions of width " 
+                       << bwRegionWidth() << " Hz" << endl;
+        for ( auto & bwAssociator : bwAssociators )
+        {
+            bwAssociator.reset( new AssociateBandwidth( bwRegionWidth(), srate ) );
+        }
     }
     else
     {
-        debugger << "Bandwidth association disabled" << endl;
+        LORIS_DEBUGGER << "Bandwidth association disabled" << endl;
     }
+    
+    if ( 0 != profile )
+    {
+        profileStage( profile->windowTime, stageStart );
+    }
+    
+    //  configure the partial formation policy:
+    PartialBuilder builder( m_freqDrift, reference );
 
-    //  reset envelope builders:
+    //  frames cached before are reused only if their Peaks were
+    //  selected from the spectrum the way they would be now, Peaks
+    //  selected around harmonics depend on the fundamental:
+    FrameCache * const cache = isHarmonic() ? 0 : m_frameCache;
+    if ( 0 != cache )
+    {
+        const double settings[] = { srate, double( step ), winshape, m_hopTime, m_freqFloor, m_cropTime };
+        std::vector< double > configuration( settings, settings + sizeof( settings ) / sizeof( settings[0] ) );
+        configuration.insert( configuration.end(), winlens.begin(), winlens.end() );
+        //  frames cached with the default transform lengths are
+        //  configured as before they could be changed:
+        for ( long len : winlens )
+        {
+            if ( transformLength( len ) != ReassignedSpectrum::transformLength( len ) )
+            {
+                configuration.push_back( double( transformLength( len ) ) );
+            }
+        }
+        for ( const WindowBand & band : m_windowBands )
+        {
+            configuration.push_back( band.lowerFrequency );
+        }
+        cache->configure( configuration );
+    }
+    
+    //  reset envelope builders, disabled ones are left empty:
     m_ampEnvBuilder->reset();
     m_f0Builder->reset();
+    m_noiseBands.clear();
     
     m_partials.clear();
         
     try 
     { 
-        const double * winMiddle = bufBegin; 
-
-        //  loop over short-time analysis frames:
-        while ( winMiddle < bufEnd )
+        //  hop in samples, truncated; short-time frames are centered
+        //  at sample k * hop, for all k such that the center is
+        //  inside the buffer:
+        const long hop = std::max( long( m_hopTime * srate ), 1L );
+        const long numFrames = ( numSamples + hop - 1 ) / hop;
+        
+        //  frames whose window is clipped (or reaches the guard samples)
+        //  depend on where the samples end, they are not cached:
+        const long cachedBegin = winlen / 2 + guard;
+        const long cachedEnd = numSamples - winlen / 2 - guard;
+        auto isCached = [&]( long center ) 
+        { 
+            return 0 != cache && center >= cachedBegin && center < cachedEnd; 
+        };
+        
+        //  Peaks are extracted from a batch of frames in parallel, then
+        //  the batch is used serially to form Partials, bounding the
+        //  memory used for Peaks waiting for Partial formation (the
+        //  collections are reused by every batch, keeping capacity):
+        const long framesPerBatch = 32 * long( numThreads );
+        std::vector< Peaks > framePeaks( framesPerBatch );
+        std::vector< float > frameResidual( m_buildNoiseBands ? framesPerBatch * NoiseBands::NumBands : 0 );
+        std::vector< Peaks > frameSelected( 0 != cache ? framesPerBatch : 0 );
+        std::vector< char > frameFound( framesPerBatch );
+        
+        //  the samples covered by the windows of a batch, clipped
+        //  to the buffer:
+        auto batchChunkBegin = [&]( long firstFrame )
         {
-            //  compute the time of this analysis frame:
-            const double currentFrameTime = long(winMiddle - bufBegin) / srate;
-            
-            //  compute reassigned spectrum:
-            //  sampsBegin is the position of the first sample to be transformed,
-            //  sampsEnd is the position after the last sample to be transformed.
-            //  (these computations work for odd length windows only)
-            const double * sampsBegin = std::max( winMiddle - (winlen / 2), bufBegin );
-            const double * sampsEnd = std::min( winMiddle + (winlen / 2) + 1, bufEnd );
-            spectrum.transform( sampsBegin, winMiddle, sampsEnd );
+            return std::max( firstFrame * hop - (winlen / 2), 0L );
+        };
+        auto batchChunkEnd = [&]( long firstFrame, long batchFrames )
+        {
+            return std::min( ( firstFrame + batchFrames - 1 ) * hop + (winlen / 2) + 1, numSamples );
+        };
+        
+        //  adaptive hop analysis skips frames between transients:
+        FrameSelector frameSelector( hop, winlen, coarseStride(), std::pow( 10., 0.05 * m_ampFloor ) );
+        std::vector< long > frames;
+        
+        //  set by any thread finding the analysis cancelled:
+        std::atomic< bool > cancelled( false );
+        
+        //  loop over batches of short-time analysis frames:
+        for ( long firstFrame = 0; firstFrame < numFrames; firstFrame += framesPerBatch )
+        {
+            LORIS_TRACE_ZONE( "Analyzer batch" );
+            const long batchFrames = std::min( framesPerBatch, numFrames - firstFrame );
             
-             
-            //  extract peaks from the spectrum, and thin
-            Peaks peaks = selector.selectPeaks( spectrum, m_freqFloor ); 
-			Peaks::iterator rejected = thinPeaks( peaks, currentFrameTime );
-
-            //	fix the stored bandwidth values
-            //	KLUDGE: need to do this before the bandwidth
-            //	associator tries to do its job, because the mixed
-            //	derivative is temporarily stored in the Breakpoint 
-            //	bandwidth!!! FIX!!!!
-            fixBandwidth( peaks );
+            //  get the samples covered by the windows of this batch,
+            //  clipped to the buffer:
+            const long chunkBegin = batchChunkBegin( firstFrame );
+            const long chunkEnd = batchChunkEnd( firstFrame, batchFrames );
+            const Sample * chunk = 0;
+            if ( ! samples.fetch( chunkBegin, chunkEnd, chunk ) )
+            {
+                //  the source stopped the analysis
+                break;
+            }
             
-            if ( m_bwAssocParam > 0 )
+            //  let the samples of the next batch be read while the 
+            //  Peaks of this one are extracted and tracked:
+            const long nextBatch = firstFrame + batchFrames;
+            if ( nextBatch < numFrames )
             {
-                bwAssociator->associateBandwidth( peaks.begin(), rejected, peaks.end() );
+                samples.prefetch( batchChunkBegin( nextBatch ), 
+                                  batchChunkEnd( nextBatch, std::min( framesPerBatch, numFrames - nextBatch ) ) );
             }
+            const Sample * chunkEndPtr = chunk + ( chunkEnd - chunkBegin );
             
-            //  remove rejected Breakpoints (needed above to 
-            //  compute bandwidth envelopes):
-            peaks.erase( rejected, peaks.end() );
+            frameSelector.select( chunk, chunkBegin, chunkEnd, firstFrame, 
+                                  batchFrames, numFrames, frames );
+            const long numSelected = long( frames.size() );
             
-            //  estimate the amplitude in this frame:
-            m_ampEnvBuilder->build( peaks, currentFrameTime );
+            //  extract peaks, threads take frames in order until
+            //  the batch is done:
+            std::atomic< long > nextFrame( 0 );
+            std::vector< std::exception_ptr > errors( numThreads );
+            const FloatingPointEnvironment environment;
+            auto extractPeaks = [&]( unsigned int t ) 
+            {
+                LORIS_TRACE_ZONE( "Analyzer extract peaks" );
+                if ( 0 != t )
+                {
+                    environment.apply();
+                }
+                try
+                {
+                    for ( long i = nextFrame++; i < numSelected; i = nextFrame++ )
+                    {
+                        if ( 0 != m_cancellation && m_cancellation->isCancelled() )
+                        {
+                            cancelled = true;
+                            nextFrame = numSelected;
+                            break;
+                        }
+                        if ( 0 != m_cancellation )
+                            m_cancellation->pace();
                         
-            //  collect amplitudes and frequencies and try to 
-            //  estimate the fundamental
-            m_f0Builder->build( peaks, currentFrameTime );          
-
-            //  form Partials from the extracted Breakpoints:
-            builder.buildPartials( peaks, currentFrameTime );
+                        const long k = frames[ i ];
+                        const long center = ( firstFrame + k ) * hop;
+                        
+                        //  Peaks of the frame selected by an analysis before,
+                        //  the ones selected now are kept for the next one:
+                        const Peaks * found = isCached( center ) ? 
+                            cache->find( cache->origin() + center * step ) : 0;
+                        frameFound[ k ] = 0 != found;
+                        analyzeFrame( spectra[ t ], selectors[ t ], bwAssociators[ t ].get(), 
+                                      bandBuffers[ t ], thinBuffers[ t ], 
+                                      chunk + ( center - chunkBegin ), 
+                                      chunk, chunkEndPtr, center / srate, framePeaks[ k ], 
+                                      m_buildNoiseBands ? &frameResidual[ k * NoiseBands::NumBands ] : 0,
+                                      0 != profile ? &profiles[ t ] : 0, found,
+                                      isCached( center ) && 0 == found ? &frameSelected[ k ] : 0 );
+                    }
+                }
+                catch ( ... )
+                {
+                    errors[ t ] = std::current_exception();
+                    nextFrame = numSelected;
+                }
+            };
             
-            //  slide the analysis window:
-            winMiddle += long( m_hopTime * srate ); //  hop in samples, truncated
-
-        }   //  end of loop over short-time frames
+            std::vector< std::thread > threads;
+            for ( unsigned int t = 1; t < numThreads; ++t )
+            {
+                try
+                {
+                    threads.emplace_back( extractPeaks, t );
+                }
+                catch ( std::system_error & )
+                {
+                    //  no more threads, the others will do the work:
+                    break;
+                }
+            }
+            extractPeaks( 0 );
+            for ( std::thread & thread : threads )
+            {
+                thread.join();
+            }
+            for ( std::exception_ptr & error : errors )
+            {
+                if ( error )
+                {
+                    std::rethrow_exception( error );
+                }
+            }
+            
+            //  Peaks of the skipped frames are left from the last batch:
+            if ( cancelled )
+            {
+                break;
+            }
+            
+            //  track the Peaks in frame order:
+            if ( 0 != profile )
+            {
+                stageStart = profileClock();
+            }
+            {
+                LORIS_TRACE_ZONE( "Analyzer build partials" );
+                for ( long k : frames )
+                {
+                    //  compute the time of this analysis frame:
+                    const long center = ( firstFrame + k ) * hop;
+                    const double currentFrameTime = center / srate;
+                    
+                    //  keep the Peaks selected for the next analysis
+                    //  (none if the frame was too quiet to transform):
+                    if ( isCached( center ) && ! frameFound[ k ] && ! frameSelected[ k ].empty() )
+                    {
+                        cache->store( cache->origin() + center * step, frameSelected[ k ] );
+                    }
+                    
+                    //  estimate the amplitude in this frame:
+                    if ( m_buildAmpEnv )
+                    {
+                        m_ampEnvBuilder->build( framePeaks[ k ], currentFrameTime );
+                    }
+                                
+                    //  collect amplitudes and frequencies and try to 
+                    //  estimate the fundamental
+                    if ( m_buildFundamentalEnv )
+                    {
+                        m_f0Builder->build( framePeaks[ k ], currentFrameTime );
+                    }
+                    
+                    //  keep the residual of this frame:
+                    if ( m_buildNoiseBands )
+                    {
+                        m_noiseBands.addFrame( currentFrameTime, &frameResidual[ k * NoiseBands::NumBands ] );
+                    }
         
-        //  unwarp the Partial frequency envelopes:
-        builder.finishBuilding( m_partials );
+                    //  form Partials from the extracted Breakpoints:
+                    if ( isHarmonic() )
+                    {
+                        builder.buildHarmonicPartials( framePeaks[ k ], currentFrameTime, 
+                                                       m_harmonicFundamental->valueAt( currentFrameTime ) );
+                    }
+                    else
+                    {
+                        builder.buildPartials( framePeaks[ k ], currentFrameTime );
+                    }
+                }
+            }
+            if ( 0 != profile )
+            {
+                profileStage( profile->buildTime, stageStart );
+            }
+            
+            //  publish the Partials finished in this batch:
+            if ( 0 != m_progressListener )
+            {
+                LORIS_TRACE_ZONE( "Analyzer publish partials" );
+                PartialList finished;
+                builder.takeFinished( finished );
+                
+                if ( m_phaseCorrect )
+                {
+                    stageStart = 0 != profile ? profileClock() : 0.;
+                    fixFrequency( finished.begin(), finished.end() );
+                    if ( 0 != profile )
+                    {
+                        profileStage( profile->fixFrequencyTime, stageStart );
+                    }
+                }
+                
+                const double batchEndTime = ( ( firstFrame + batchFrames - 1 ) * hop ) / srate;
+                m_progressListener->partialsFinished( finished, batchEndTime );
+                m_partials.splice( m_partials.end(), finished );
+            }
+            
+        }   //  end of loop over batches of short-time frames
+        
+        //  collect the remaining Partials:
+        PartialList remaining;
+        builder.finishBuilding( remaining );
+        
+        //  fix the frequencies and phases to be consistent,
+        //  nobody needs the Partials of a cancelled analysis:
+        if ( m_phaseCorrect && ! cancelled )
+        {
+            LORIS_TRACE_ZONE( "Analyzer fix frequency" );
+            stageStart = 0 != profile ? profileClock() : 0.;
+            fixFrequency( remaining.begin(), remaining.end() );
+            if ( 0 != profile )
+            {
+                profileStage( profile->fixFrequencyTime, stageStart );
+            }
+        }
+        m_partials.splice( m_partials.end(), remaining );
         
-        //  fix the frequencies and phases to be consistent.
-        if ( m_phaseCorrect )
+        for ( const Profile & threadProfile : profiles )
         {
-            fixFrequency( m_partials.begin(), m_partials.end() );
+            *m_profile += threadProfile;
         }
         
         
@@ -733,6 +1612,161 @@ Analyzer::analyze( const double * bufBegin, const double * bufEnd, double srate,
     }
 }
 
+// -- live analysis --
+
+// ---------------------------------------------------------------------------
+//  LiveAnalysis::State
+// ---------------------------------------------------------------------------
+//  The objects analyzing a frame and forming Partials, as one thread
+//  of analyzeFrames() uses them, reused by every frame.
+//
+struct Analyzer::LiveAnalysis::State
+{
+    std::vector< std::unique_ptr< ReassignedSpectrum > > spectra;
+    SpectralPeakSelector selector;
+    std::unique_ptr< AssociateBandwidth > bwAssociator;
+    PartialBuilder builder;
+    Peaks peaks;
+    Peaks bandBuffer;
+    std::vector< double > thinBuffer;
+    PartialPtrs extended;
+    PartialList finished;
+    
+    State( double srate, double cropTime, double drift ) :
+        selector( srate, cropTime ),
+        builder( drift )
+    {
+    }
+};
+
+// ---------------------------------------------------------------------------
+//  LiveAnalysis constructor
+// ---------------------------------------------------------------------------
+//! Construct a new LiveAnalysis of samples at the given sample
+//! rate, with the configuration of an Analyzer.
+//!
+//! \param  analyzer is the Analyzer configuration to use (it is copied)
+//! \param  srate is the sample rate of the samples in Hz
+//
+Analyzer::LiveAnalysis::LiveAnalysis( const Analyzer & analyzer, double srate ) :
+    m_analyzer( analyzer ),
+    m_srate( srate ),
+    m_winlen( 0 ),
+    m_hop( std::max( long( analyzer.m_hopTime * srate ), 1L ) ),
+    m_frame( 0 ),
+    m_nextLabel( 1 )
+{
+    if ( srate <= 0 )
+    {
+        Throw( InvalidArgument, "Live analysis sample rate must be positive." );
+    }
+    
+    //  only the configuration is used, the frames are not 
+    //  selected around harmonics, there is no time origin
+    //  for the fundamental:
+    m_analyzer.m_partials.clear();
+    m_analyzer.m_harmonicFundamental.reset();
+    m_analyzer.m_progressListener = 0;
+    m_analyzer.m_cancellation = 0;
+    m_analyzer.m_profile = 0;
+    m_analyzer.m_frameCache = 0;
+    
+    //  odd-length Kaiser windows, as in analyzeFrames():
+    const double winshape = KaiserWindow::computeShape( m_analyzer.sidelobeLevel() );
+    m_state.reset( new State( srate, m_analyzer.m_cropTime, m_analyzer.m_freqDrift ) );
+    std::vector< double > widths( 1, m_analyzer.windowWidth() );
+    for ( const WindowBand & band : m_analyzer.m_windowBands )
+    {
+        widths.push_back( band.windowWidth );
+    }
+    for ( double width : widths )
+    {
+        long len = KaiserWindow::computeLength( width / srate, winshape );
+        if (! (len % 2)) 
+        {
+            ++len;
+        }
+        m_state->spectra.emplace_back( new ReassignedSpectrum( len, winshape, 
+                                                               m_analyzer.transformLength( len ) ) );
+        m_winlen = std::max( m_winlen, len );
+    }
+    
+    if( m_analyzer.m_bwAssocParam > 0 )
+    {
+        m_state->bwAssociator.reset( new AssociateBandwidth( m_analyzer.bwRegionWidth(), srate ) );
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  LiveAnalysis destructor
+// ---------------------------------------------------------------------------
+//! Destroy this LiveAnalysis.
+//
+Analyzer::LiveAnalysis::~LiveAnalysis( void )
+{
+}
+
+// ---------------------------------------------------------------------------
+//  LiveAnalysis::analyzeFrame
+// ---------------------------------------------------------------------------
+//! Analyze the next frame, and append the Tracks of the Partials it 
+//! extended or spawned to tracks, by increasing frequency. Partials
+//! not extended by the frame are finished, their labels are not
+//! reported again.
+//!
+//! \param  window is the first of the windowLength() samples centered
+//!         on the frame (zeros before the sound started)
+//! \param  tracks collects the Tracks of the frame
+//
+void 
+Analyzer::LiveAnalysis::analyzeFrame( const double * window, std::vector< Track > & tracks )
+{
+    State & state = *m_state;
+    const double currentFrameTime = frameTime();
+    ++m_frame;
+    
+    m_analyzer.analyzeFrame( state.spectra, state.selector, state.bwAssociator.get(),
+                             state.bandBuffer, state.thinBuffer,
+                             window + m_winlen / 2, window, window + m_winlen,
+                             currentFrameTime, state.peaks, 0, 0 );
+    state.builder.buildPartials( state.peaks, currentFrameTime );
+    
+    //  finished Partials are dropped, the others keep only the
+    //  Breakpoint of this frame, which spawned ones are labeled by:
+    state.builder.takeFinished( state.finished );
+    state.finished.clear();
+    
+    state.extended.clear();
+    state.builder.extendedPartials( state.extended );
+    for ( Partial * partial : state.extended )
+    {
+        if ( 0 == partial->label() )
+        {
+            partial->setLabel( m_nextLabel++ );
+        }
+        Partial::iterator last = partial->end();
+        --last;
+        last = partial->erase( partial->begin(), last );
+        
+        Track track = { partial->label(), last.time(), last.breakpoint() };
+        tracks.push_back( track );
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  LiveAnalysis::reset
+// ---------------------------------------------------------------------------
+//! Finish all Partials, the next frame is at time 0. Labels keep
+//! counting from the last one used.
+//
+void 
+Analyzer::LiveAnalysis::reset( void )
+{
+    m_state->builder.finishBuilding( m_state->finished );
+    m_state->finished.clear();
+    m_frame = 0;
+}
+
 // -- parameter access --
 
 // ---------------------------------------------------------------------------
@@ -816,6 +1850,30 @@ Analyzer::hopTime( void ) const
     return m_hopTime; 
 }
 
+// ---------------------------------------------------------------------------
+//  coarseHopTime
+// ---------------------------------------------------------------------------
+//! Return the coarse hop time used between transients, or 0 if
+//! every short-time frame (one per hop time) is analyzed.
+//
+double 
+Analyzer::coarseHopTime( void ) const 
+{ 
+    return m_coarseHopTime; 
+}
+
+// ---------------------------------------------------------------------------
+//  frequencyCeiling
+// ---------------------------------------------------------------------------
+//! Return the highest frequency (Hz) the analysis must preserve,
+//! or 0 if samples are analyzed at their own rate.
+//
+double 
+Analyzer::frequencyCeiling( void ) const 
+{ 
+    return m_freqCeiling; 
+}
+
 // ---------------------------------------------------------------------------
 //  sidelobeLevel
 // ---------------------------------------------------------------------------
@@ -966,6 +2024,37 @@ Analyzer::setFreqResolution( const Envelope & e )
     m_freqResolutionEnv.reset( e.clone() ); 
 }
 
+// ---------------------------------------------------------------------------
+//  setTransformOversampling
+// ---------------------------------------------------------------------------
+//! Set the zero-padding factor of the short-time transforms, 
+//! the transform length is at least this many times the window
+//! length (see ReassignedSpectrum::transformLength). The default, 2, 
+//! gives the lengths Loris always used.
+//! 
+//! \param x is the new value of this parameter, at least 1.
+//
+void 
+Analyzer::setTransformOversampling( double x ) 
+{ 
+    VERIFY_ARG( setTransformOversampling, x >= 1 );
+    m_transformOversampling = x; 
+}
+
+// ---------------------------------------------------------------------------
+//  transformLength
+// ---------------------------------------------------------------------------
+//  Return the length of the transforms of windows of winlen samples,
+//  padded and rounded as configured.
+//
+unsigned long
+Analyzer::transformLength( long winlen ) const
+{
+    return ReassignedSpectrum::transformLength( winlen, m_transformOversampling,
+                                                m_fastTransformLength ? ReassignedSpectrum::FastLength
+                                                                      : ReassignedSpectrum::PowerOfTwo );
+}
+
 // ---------------------------------------------------------------------------
 //  setSidelobeLevel
 // ---------------------------------------------------------------------------
@@ -1000,6 +2089,96 @@ Analyzer::setHopTime( double x )
     m_hopTime = x; 
 }
 
+// ---------------------------------------------------------------------------
+//  setCoarseHopTime
+// ---------------------------------------------------------------------------
+//! Set the coarse hop time, enabling adaptive hop analysis. Steady
+//! parts of the sound are analyzed only once per coarse hop time, 
+//! frames around transients (found from short-time energy of the
+//! samples) once per hop time. A value not larger than the hop time 
+//! (default 0) disables adaptive hop analysis.
+//! 
+//! \param x is the new value of this parameter.
+//
+void 
+Analyzer::setCoarseHopTime( double x ) 
+{ 
+    VERIFY_ARG( setCoarseHopTime, x >= 0 );
+    m_coarseHopTime = x; 
+}
+
+// ---------------------------------------------------------------------------
+//  setHarmonicFundamental
+// ---------------------------------------------------------------------------
+//! Analyze a harmonic sound of a known fundamental frequency: spectral
+//! peaks are only selected within the frequency drift of the harmonics
+//! of the fundamental in each frame, and Partials are formed by harmonic
+//! number, labeled by it.
+//! 
+//! \param fundamental is an Envelope of the fundamental frequency in Hz.
+//
+void 
+Analyzer::setHarmonicFundamental( const Envelope & fundamental ) 
+{ 
+	//	No mechanism exists to verify that the envelope never
+	//	drops below zero, frames where it does have no Peaks.
+    m_harmonicFundamental.reset( fundamental.clone() ); 
+}
+
+// ---------------------------------------------------------------------------
+//  addWindowBand
+// ---------------------------------------------------------------------------
+//! Analyze the components above a frequency with a window of another
+//! width, in the same pass. The Peaks of each band are merged before
+//! they are thinned and Partials are formed. A band covers the components
+//! up to the lower frequency of the next band, the window of windowWidth
+//! covers the ones below the lowest band. A band at the frequency of
+//! another one replaces it.
+//! 
+//! \param lowerFrequencyHz is the lowest frequency of the band.
+//! \param windowWidthHz is the main lobe width of the Kaiser window 
+//!         of the band, in Hz.
+//
+void 
+Analyzer::addWindowBand( double lowerFrequencyHz, double windowWidthHz ) 
+{ 
+    VERIFY_ARG( addWindowBand, lowerFrequencyHz > 0 );
+    VERIFY_ARG( addWindowBand, windowWidthHz > 0 );
+    
+    WindowBand band = { lowerFrequencyHz, windowWidthHz };
+    std::vector< WindowBand >::iterator pos = m_windowBands.begin();
+    while ( pos != m_windowBands.end() && pos->lowerFrequency < lowerFrequencyHz )
+    {
+        ++pos;
+    }
+    if ( pos != m_windowBands.end() && pos->lowerFrequency == lowerFrequencyHz )
+    {
+        *pos = band;
+    }
+    else
+    {
+        m_windowBands.insert( pos, band );
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  setFrequencyCeiling
+// ---------------------------------------------------------------------------
+//! Set the highest frequency (Hz) the analysis must preserve. Samples
+//! at a rate much higher than twice the ceiling are decimated by an
+//! integer factor before they are analyzed, Partials above the ceiling
+//! may be attenuated or lost. 0 (default) analyzes samples at their
+//! own rate.
+//! 
+//! \param x is the new value of this parameter.
+//
+void 
+Analyzer::setFrequencyCeiling( double x ) 
+{ 
+    VERIFY_ARG( setFrequencyCeiling, x >= 0 );
+    m_freqCeiling = x; 
+}
+
 // ---------------------------------------------------------------------------
 //  setWindowWidth
 // ---------------------------------------------------------------------------
@@ -1205,6 +2384,7 @@ void Analyzer::buildFundamentalEnv( double fmin, double fmax,
 {
     m_f0Builder.reset( 
         new FundamentalBuilder( fmin, fmax, threshDb, threshHz ) );
+    m_buildFundamentalEnv = true;
 }
 
 // ---------------------------------------------------------------------------
@@ -1212,8 +2392,8 @@ void Analyzer::buildFundamentalEnv( double fmin, double fmax,
 // ---------------------------------------------------------------------------
 //! Return the fundamental frequency estimate envelope constructed
 //! during the most recent analysis performed by this Analyzer.
-//! Will be empty unless buildFundamentalEnv was invoked to enable the
-//! construction of this envelope during analysis.
+//! Will be empty if buildFundamentalEnv( false ) was invoked to disable
+//! the construction of this envelope during analysis.
 //
 const LinearEnvelope &
 Analyzer::fundamentalEnv( void ) const
@@ -1227,7 +2407,7 @@ Analyzer::fundamentalEnv( void ) const
 // ---------------------------------------------------------------------------
 //! Return the overall amplitude estimate envelope constructed
 //! during the most recent analysis performed by this Analyzer.
-//! Will be empty unless buildAmpEnv was invoked to enable the
+//! Will be empty if buildAmpEnv( false ) was invoked to disable the
 //! construction of this envelope during analysis.
 //
 const LinearEnvelope & 
@@ -1238,31 +2418,6 @@ Analyzer::ampEnv( void ) const
 
 // -- private helpers --
 
-// ---------------------------------------------------------------------------
-//	can_mask
-// ---------------------------------------------------------------------------
-//	functor used for identying peaks that are too close
-//	in frequency to another louder peak:
-struct can_mask
-{
-	//	masking occurs if any (louder) peak falls
-	//	in the frequency range delimited by fmin and fmax:
-	bool operator()( const SpectralPeak & v )  const
-	{ 
-		return	( v.frequency() > _fmin ) && 
-				( v.frequency() < _fmax ); 
-	}
-		
-	//	constructor:
-	can_mask( double x, double y ) : 
-		_fmin( x ), _fmax( y ) 
-		{ if (x>y) std::swap(x,y); }
-		
-	//	bounds:
-private:
-	double _fmin, _fmax;
-};
-
 // ---------------------------------------------------------------------------
 //	negative_time
 // ---------------------------------------------------------------------------
@@ -1288,6 +2443,188 @@ private:
 };
 
 
+// ---------------------------------------------------------------------------
+//	analyzeFrame (HELPER)
+// ---------------------------------------------------------------------------
+//	Compute the reassigned spectra of the short-time analysis frame
+//	centered at winMiddle, at time currentFrameTime, and store its 
+//	thinned Peaks, having bandwidth fixed or associated and rejected 
+//	Peaks removed, in peaks. The windows are clipped to [bufBegin, bufEnd).
+//	The first spectrum is the one of the window of windowWidth, the
+//	others are the ones of the window bands (see addWindowBand), each 
+//	contributing the Peaks of its band.
+//	The previous contents of peaks are replaced, its capacity is kept,
+//	so the frame loop does not allocate once the buffers have grown.
+//	Unless residual is 0, the energy of the rejected Peaks is stored 
+//	there by band (see NoiseBands), all zero if the frame is silent.
+//
+//	This reads only the analysis parameters, so frames can be analyzed 
+//	concurrently, each thread using its own spectra, selector and 
+//	bandwidth associator (which may be 0 if bandwidth association is 
+//	disabled) and buffers for the Peaks of a band and for thinning. 
+//	Partials are formed from the Peaks afterwards, in frame order.
+//
+//	The Peaks selected from the spectrum are taken from cached instead, 
+//	unless it is 0, then the frame is not transformed. Unless selected 
+//	is 0, the Peaks selected are copied there (left empty if the frame 
+//	is too quiet to transform), for a FrameCache.
+//
+template< class Sample >
+void 
+Analyzer::analyzeFrame( const std::vector< std::unique_ptr< ReassignedSpectrum > > & spectra, 
+                        SpectralPeakSelector & selector, AssociateBandwidth * bwAssociator, 
+                        Peaks & bandBuffer, std::vector< double > & thinBuffer,
+                        const Sample * winMiddle,
+                        const Sample * bufBegin, const Sample * bufEnd, 
+                        double currentFrameTime, Peaks & peaks, float * residual, 
+                        Profile * profile, const Peaks * cached, Peaks * selected ) const
+{
+    peaks.clear();
+    if ( 0 != selected )
+    {
+        selected->clear();
+    }
+    if ( 0 != residual )
+    {
+        std::fill_n( residual, int( NoiseBands::NumBands ), 0.f );
+    }
+    if ( 0 != profile )
+    {
+        ++profile->frames;
+    }
+    
+    //  compute reassigned spectrum:
+    //  sampsBegin is the position of the first sample to be transformed,
+    //  sampsEnd is the position after the last sample to be transformed.
+    //  (these computations work for odd length windows only)
+    long winlen = 0;
+    for ( const std::unique_ptr< ReassignedSpectrum > & spectrum : spectra )
+    {
+        winlen = std::max( winlen, long( spectrum->window().size() ) );
+    }
+    const Sample * longestBegin = std::max( winMiddle - (winlen / 2), bufBegin );
+    const Sample * longestEnd = std::min( winMiddle + (winlen / 2) + 1, bufEnd );
+    
+    //  the windows are scaled to sum to 2, so no spectral magnitude
+    //  exceeds twice the largest sample magnitude in the longest window, 
+    //  skip the transforms if no peak could be above the amplitude 
+    //  floor (with 6 dB to spare for rounding), there would be no 
+    //  Peaks:
+    double maxSample = 0;
+    for ( const Sample * s = longestBegin; s != longestEnd; ++s )
+    {
+        maxSample = std::max( maxSample, (double) std::fabs( *s ) );
+    }
+    if ( 4. * maxSample < std::pow( 10., 0.05 * m_ampFloor ) )
+    {
+        return;
+    }
+    
+    double stageStart = 0 != profile ? profileClock() : 0.;
+    if ( 0 != cached )
+    {
+        //  the spectrum is the one of an analysis before
+        peaks = *cached;
+        if ( 0 != profile )
+        {
+            ++profile->cachedFrames;
+        }
+    }
+    else
+    {
+        const double fundamental = isHarmonic() ? m_harmonicFundamental->valueAt( currentFrameTime ) : 0.;
+        for ( std::size_t b = 0; b < spectra.size(); ++b )
+        {
+            ReassignedSpectrum & spectrum = *spectra[ b ];
+            const long len = long( spectrum.window().size() );
+            const Sample * sampsBegin = std::max( winMiddle - (len / 2), bufBegin );
+            const Sample * sampsEnd = std::min( winMiddle + (len / 2) + 1, bufEnd );
+            spectrum.transform( sampsBegin, winMiddle, sampsEnd );
+            if ( 0 != profile )
+            {
+                ++profile->transforms;
+                stageStart = profileStage( profile->transformTime, stageStart );
+            }
+            
+            //  extract peaks from the spectrum (only around the harmonics
+            //  of the fundamental, if there is one), the window of 
+            //  windowWidth covers the components below the lowest band, 
+            //  each band the ones up to the next:
+            auto select = [&]( double lower, Peaks & selected )
+            {
+                if ( isHarmonic() )
+                {
+                    selector.selectHarmonicPeaks( spectrum, lower, fundamental, m_freqDrift, selected );
+                }
+                else
+                {
+                    selector.selectPeaks( spectrum, lower, selected );
+                }
+            };
+            if ( 1 == spectra.size() )
+            {
+                select( m_freqFloor, peaks ); 
+            }
+            else
+            {
+                const double lower = 0 == b ? m_freqFloor 
+                                     : std::max( m_windowBands[ b - 1 ].lowerFrequency, m_freqFloor );
+                const double upper = b < m_windowBands.size() ? m_windowBands[ b ].lowerFrequency : 0.;
+                select( lower, bandBuffer );
+                for ( const SpectralPeak & pk : bandBuffer )
+                {
+                    if ( 0. == upper || pk.frequency() < upper )
+                    {
+                        peaks.push_back( pk );
+                    }
+                }
+            }
+            if ( 0 != profile )
+            {
+                stageStart = profileStage( profile->selectTime, stageStart );
+            }
+        }
+        
+        if ( 0 != selected )
+        {
+            *selected = peaks;
+        }
+    }
+    
+    //  thin the peaks
+    Peaks::iterator rejected = thinPeaks( peaks, currentFrameTime, thinBuffer );
+    if ( 0 != profile )
+    {
+        stageStart = profileStage( profile->thinTime, stageStart );
+    }
+
+    //	fix the stored bandwidth values
+    //	KLUDGE: need to do this before the bandwidth
+    //	associator tries to do its job, because the mixed
+    //	derivative is temporarily stored in the Breakpoint 
+    //	bandwidth!!! FIX!!!!
+    fixBandwidth( peaks );
+    
+    if ( 0 != residual )
+    {
+        AssociateBandwidth::measureResidual( rejected, peaks.end(), residual );
+    }
+    
+    if ( 0 != bwAssociator )
+    {
+        bwAssociator->associateBandwidth( peaks.begin(), rejected, peaks.end() );
+    }
+    
+    //  remove rejected Breakpoints (needed above to 
+    //  compute bandwidth envelopes):
+    peaks.erase( rejected, peaks.end() );
+    if ( 0 != profile )
+    {
+        profileStage( profile->bandwidthTime, stageStart );
+        profile->peaks += long( peaks.size() );
+    }
+}
+
 // ---------------------------------------------------------------------------
 //	thinPeaks (HELPER)
 // ---------------------------------------------------------------------------
@@ -1306,8 +2643,13 @@ private:
 //	there. It _should_ remove the rejected peaks, but for now, those are needed
 //	by the bandwidth association strategy.
 //
+//	The frequencies of retained peaks are kept sorted in retained, so 
+//	finding a louder peak masking a quieter one is a binary search, not
+//	a scan of all retained peaks. The buffer is only cleared, it keeps
+//	its capacity for the next frame.
+//
 Peaks::iterator 
-Analyzer::thinPeaks( Peaks & peaks, double frameTime  )
+Analyzer::thinPeaks( Peaks & peaks, double frameTime, std::vector< double > & retained ) const
 {
 	const double ampFloordB = m_ampFloor;
 
@@ -1338,18 +2680,25 @@ Analyzer::thinPeaks( Peaks & peaks, double frameTime  )
     const double freqResolution = 
     	std::max( m_freqResolutionEnv->valueAt( frameTime ), 0.0 ); 
     
+    retained.clear();
     
 	while ( it != peaks.end() ) 
 	{
 		SpectralPeak & pk = *it;
 		
 		//	keep this peak if it is loud enough and not
-		//	 too near in frequency to a louder one:
+		//	 too near in frequency to a louder one, the 
+		//	first retained frequency above lower is the 
+		//	only one that can mask it:
 		double lower = pk.frequency() - freqResolution;
 		double upper = pk.frequency() + freqResolution;
+		std::vector< double >::iterator masker = 
+			std::upper_bound( retained.begin(), retained.end(), lower );
 		if ( pk.amplitude() > threshold &&
-			 beginRejected == std::find_if( peaks.begin(), beginRejected, can_mask(lower, upper) ) )
+			 ( masker == retained.end() || ! ( *masker < upper ) ) )
 		{
+			retained.insert( std::upper_bound( masker, retained.end(), pk.frequency() ), pk.frequency() );
+			
 			//	this peak is a keeper, fade its
 			//	amplitude if it is too quiet:
 			if ( pk.amplitude() < beginFade )
@@ -1394,7 +2743,7 @@ Analyzer::thinPeaks( Peaks & peaks, double frameTime  )
 //  correspond to bandwidth equal to 1.0. This is achieved by scaling
 //  the convergence by the inverse of the tolerance, and saturating
 //  at 1.0.
-void Analyzer::fixBandwidth( Peaks & peaks )
+void Analyzer::fixBandwidth( Peaks & peaks ) const
 {
 	
 	if ( m_bwAssocParam < 0 )
@@ -35,6 +35,7 @@
 #include <memory>
 #include <vector>
 #include "LinearEnvelope.h"
+#include "NoiseBands.h"
 #include "Partial.h"
 #include "PartialList.h"
 // #include "SpectralPeaks.h"
@@ -42,8 +43,12 @@
 //  begin namespace
 namespace Loris {
 
+class AssociateBandwidth;
 class Envelope;
+class FrameCache;
 class LinearEnvelopeBuilder;
+class ReassignedSpectrum;
+class SpectralPeakSelector;
 // class Peaks;
 // class Peaks::iterator;
 //  oooo, this is nasty, need to fix it!
@@ -224,6 +229,18 @@ public:
     //! \param  srate is the sample rate of the samples in the buffer
     void analyze( const double * bufBegin, const double * bufEnd, double srate );
     
+    //! Analyze a range of (mono) single precision samples at the given 
+    //! sample rate (in Hz) and store the extracted Partials in the 
+    //! Analyzer's PartialList (std::list of Partials). The samples are
+    //! converted as each short-time frame is windowed, so no double
+    //! precision copy of the buffer is needed.
+    //! 
+    //! \param  bufBegin is a pointer to a buffer of floating point samples
+    //! \param  bufEnd is (one-past) the end of a buffer of floating point 
+    //!         samples
+    //! \param  srate is the sample rate of the samples in the buffer
+    void analyze( const float * bufBegin, const float * bufEnd, double srate );
+    
 //  -- tracking analysis --
 
     //! Analyze a vector of (mono) samples at the given sample rate         
@@ -252,6 +269,246 @@ public:
     void analyze( const double * bufBegin, const double * bufEnd, double srate,
                   const Envelope & reference );
     
+    //! Analyze a range of (mono) single precision samples at the given 
+    //! sample rate (in Hz) and store the extracted Partials in the 
+    //! Analyzer's PartialList (std::list of Partials). Use the specified 
+    //! envelope as a frequency reference for Partial tracking. The samples
+    //! are converted as each short-time frame is windowed, so no double
+    //! precision copy of the buffer is needed.
+    //! 
+    //! \param  bufBegin is a pointer to a buffer of floating point samples
+    //! \param  bufEnd is (one-past) the end of a buffer of floating point 
+    //!         samples
+    //! \param  srate is the sample rate of the samples in the buffer
+    //! \param  reference is an Envelope having the approximate
+    //!         frequency contour expected of the resulting Partials.
+    void analyze( const float * bufBegin, const float * bufEnd, double srate,
+                  const Envelope & reference );
+    
+//  -- streaming analysis --
+
+    //! SampleSource is the interface of a source of (mono) samples for
+    //! streaming analysis. The Analyzer reads the samples in chunks 
+    //! (overlapping by about one analysis window) from the beginning to 
+    //! the end, so the whole sound never needs to be in memory. Each 
+    //! chunk is read on a thread of its own while the chunk before it
+    //! is analyzed, so decoding overlaps the analysis; reads are never
+    //! concurrent, but they are not made on the thread analyzing.
+    class SampleSource
+    {
+    public:
+        //! Destroy this SampleSource.
+        virtual ~SampleSource( void ) {}
+        
+        //! Return the number of samples in the source.
+        virtual long numSamples( void ) const = 0;
+        
+        //! Read count samples starting at sample start, never outside
+        //! [0, numSamples()), into dest.
+        //!
+        //! \param  start is the index of the first sample to read
+        //! \param  count is the number of samples to read 
+        //! \param  dest is a buffer of at least count samples
+        //! \return true if the samples were read, or false to stop 
+        //!         the analysis early (for example if it is cancelled,
+        //!         or the source cannot be read). The Partials analyzed
+        //!         so far are kept.
+        virtual bool read( long start, long count, float * dest ) = 0;
+    };
+
+    //! Analyze (mono) samples read from a SampleSource at the given sample
+    //! rate (in Hz) and store the extracted Partials in the Analyzer's 
+    //! PartialList (std::list of Partials). The samples are read in chunks
+    //! as the analysis goes, so memory used for samples is bounded by
+    //! the analysis window length, not by the source length. 
+    //!
+    //! \param  source provides the samples to analyze
+    //! \param  srate is the sample rate of the samples
+    void analyze( SampleSource & source, double srate );
+
+    //! Analyze (mono) samples read from a SampleSource at the given sample
+    //! rate (in Hz) and store the extracted Partials in the Analyzer's 
+    //! PartialList (std::list of Partials). Use the specified envelope as 
+    //! a frequency reference for Partial tracking. The samples are read in 
+    //! chunks as the analysis goes, so memory used for samples is bounded
+    //! by the analysis window length, not by the source length. 
+    //!
+    //! \param  source provides the samples to analyze
+    //! \param  srate is the sample rate of the samples
+    //! \param  reference is an Envelope having the approximate
+    //!         frequency contour expected of the resulting Partials.
+    void analyze( SampleSource & source, double srate, const Envelope & reference );
+    
+//  -- progressive analysis --
+
+    //! ProgressListener is the interface of an object notified of the
+    //! Partials finished while the analysis is in progress, so that 
+    //! they can be used before the whole sound is analyzed.
+    class ProgressListener
+    {
+    public:
+        //! Destroy this ProgressListener.
+        virtual ~ProgressListener( void ) {}
+        
+        //! Called from the analyzing thread after a batch of short-time
+        //! frames is analyzed, with the Partials that were finished in 
+        //! that batch (phase corrected, if phase correction is enabled).
+        //! These Partials will not change anymore, and they are also 
+        //! stored in the Analyzer's PartialList at the end of the analysis.
+        //!
+        //! \param  finished are the Partials finished in the batch
+        //! \param  time is the time in seconds analyzed so far, all 
+        //!         Partials ending earlier have been notified
+        virtual void partialsFinished( const PartialList & finished, double time ) = 0;
+    };
+    
+    //! Set the listener notified of finished Partials while the analysis
+    //! is in progress, or 0 (the default) for no notifications. The listener 
+    //! is not owned by the Analyzer.
+    //!
+    //! \param  listener is the listener, or 0
+    void setProgressListener( ProgressListener * listener ) { m_progressListener = listener; }
+    
+    //! Return the listener notified of finished Partials while the analysis
+    //! is in progress, or 0 if there is none.
+    ProgressListener * progressListener( void ) const { return m_progressListener; }
+    
+    //! Cancellation is the interface of an object asked, after every 
+    //! short-time frame, whether the analysis should stop (for example
+    //! because its result is not needed anymore).
+    class Cancellation
+    {
+    public:
+        //! Destroy this Cancellation.
+        virtual ~Cancellation( void ) {}
+        
+        //! Return true if the analysis should stop. Called from all 
+        //! the analyzing threads, so it must be thread-safe and fast.
+        virtual bool isCancelled( void ) const = 0;
+        
+        //! Called by every analyzing thread before each short-time frame,
+        //! it may block to slow the analysis down, leaving the cores to
+        //! more urgent work. Thread-safe like isCancelled(). The default
+        //! does nothing.
+        virtual void pace( void ) const {}
+    };
+    
+    //! Set the object asked whether the analysis should stop, or 0 (the
+    //! default) to always run the analysis to its end. A cancelled analysis 
+    //! stops within one short-time frame, its Partials are incomplete and 
+    //! not phase corrected. The Cancellation is not owned by the Analyzer.
+    //!
+    //! \param  cancellation is the Cancellation, or 0
+    void setCancellation( const Cancellation * cancellation ) { m_cancellation = cancellation; }
+    
+    //! Return the object asked whether the analysis should stop, or 0 if 
+    //! there is none.
+    const Cancellation * cancellation( void ) const { return m_cancellation; }
+    
+//  -- live analysis --
+
+    //! LiveAnalysis analyzes a sound a frame at a time as its samples 
+    //! arrive, with the configuration of an Analyzer (see below).
+    class LiveAnalysis;
+
+//  -- frame cache --
+
+    //! Set the cache the Peaks of short-time frames are looked up in and
+    //! stored to, or 0 (the default) to transform every frame. Frames
+    //! found there are not transformed again, their Peaks are thinned and
+    //! Partials are formed from them as from the others, so an analysis
+    //! of a part of a sound analysed before transforms only the frames it
+    //! did not analyse, and an analysis differing only in the parameters
+    //! of the stages after the transform (amplitude floor, frequency
+    //! resolution and drift, bandwidth) transforms none (see FrameCache). 
+    //! The cache is not owned by the Analyzer.
+    //!
+    //! \param  cache is the FrameCache, or 0
+    void setFrameCache( FrameCache * cache ) { m_frameCache = cache; }
+    
+    //! Return the cache of short-time frames, or 0 if there is none.
+    FrameCache * frameCache( void ) const { return m_frameCache; }
+    
+    //! Return the distance of short-time frames in samples at srate (of
+    //! the samples before they are decimated). Analyses of parts of a
+    //! sound find frames of each other in a FrameCache only if their 
+    //! origins are a multiple of it apart.
+    //!
+    //! \param  srate is the sample rate of the samples analyzed
+    long frameSpacing( double srate ) const;
+    
+//  -- profiling --
+
+    //! Profile collects the time spent in each stage of an analysis and
+    //! the amount of work done, for benchmarking. Times of the stages run
+    //! concurrently for many frames are summed over all analyzing threads.
+    struct Profile
+    {
+        double windowTime = 0.;         //!  seconds building the spectra and their windows
+        double transformTime = 0.;      //!  seconds in ReassignedSpectrum::transform
+        double selectTime = 0.;         //!  seconds in SpectralPeakSelector::selectPeaks
+        double thinTime = 0.;           //!  seconds thinning Peaks
+        double bandwidthTime = 0.;      //!  seconds fixing and associating bandwidth
+        double buildTime = 0.;          //!  seconds forming Partials (and envelopes)
+        double fixFrequencyTime = 0.;   //!  seconds in fixFrequency
+        long frames = 0;                //!  short-time frames analyzed
+        long cachedFrames = 0;          //!  frames whose Peaks were found in the FrameCache
+        long transforms = 0;            //!  frames transformed (not below the floor)
+        long peaks = 0;                 //!  Peaks retained to form Partials
+        
+        //! Add the times and counts of another Profile.
+        Profile & operator+=( const Profile & other );
+    };
+    
+    //! Set the Profile every analysis adds its stage times and counts to,
+    //! or 0 (the default) for no profiling. Stages are timed only when
+    //! there is a Profile. The Profile is not owned by the Analyzer.
+    //!
+    //! \param  profile is the Profile, or 0
+    void setProfile( Profile * profile ) { m_profile = profile; }
+    
+    //! Return the Profile analyses add to, or 0 if there is none.
+    Profile * profile( void ) const { return m_profile; }
+    
+//  -- threading --
+
+    //! Set the number of threads short-time frames are analyzed on,
+    //! 0 (the default) for one per hardware core. Frames are analyzed
+    //! independently, so the Partials do not depend on the number of
+    //! threads.
+    void setNumThreads( unsigned int n ) { m_numThreads = n; }
+    
+    //! Return the number of threads frames are analyzed on, 0 for one
+    //! per hardware core.
+    unsigned int numThreads( void ) const { return m_numThreads; }
+    
+//  -- transform lengths --
+
+    //! Set the zero-padding factor of the short-time transforms, 
+    //! the transform length is at least this many times the window
+    //! length (see ReassignedSpectrum::transformLength). The default, 2, 
+    //! gives the lengths Loris always used. Reassigned frequencies
+    //! and times are not quantized to the transform bins, so a factor
+    //! of 1 often suffices, and the transforms are about twice as fast.
+    //! 
+    //! \param x is the new value of this parameter, at least 1.
+    void setTransformOversampling( double x );
+    
+    //! Return the zero-padding factor of the short-time transforms.
+    double transformOversampling( void ) const { return m_transformOversampling; }
+    
+    //! Round padded transform lengths up to the next length the FFT 
+    //! backend transforms fast, instead of the next power of two (the 
+    //! default). With FFTW, lengths with factors 3, 5 and 7 are fast,
+    //! and are often much shorter than the power of two.
+    //!
+    //! \param TF is true to round to fast lengths, false for powers of two
+    void setFastTransformLength( bool TF ) { m_fastTransformLength = TF; }
+    
+    //! Return true if transform lengths are rounded up to fast lengths,
+    //! false if to powers of two (the default).
+    bool fastTransformLength( void ) const { return m_fastTransformLength; }
+    
 //  -- parameter access --
 
     //! Return the amplitude floor (lowest detected spectral amplitude),            
@@ -286,6 +543,26 @@ public:
     //! Analyzer.
     double hopTime( void ) const;
 
+    //! Return the coarse hop time used between transients, or 0 if
+    //! every short-time frame (one per hop time) is analyzed.
+    double coarseHopTime( void ) const;
+
+    //! Return the highest frequency (Hz) the analysis must preserve,
+    //! or 0 if samples are analyzed at their own rate.
+    double frequencyCeiling( void ) const;
+    
+    //! A band of components analyzed with a window of another width (see
+    //! addWindowBand).
+    struct WindowBand
+    {
+        double lowerFrequency;      //!  in Hz, lowest frequency of the band
+        double windowWidth;         //!  in Hz, main lobe width of its window
+    };
+    
+    //! Return the bands analyzed with windows of other widths, in order of
+    //! their lower frequency, empty if there are none.
+    const std::vector< WindowBand > & windowBands( void ) const { return m_windowBands; }
+
     //! Return the sidelobe attenutation level for the Kaiser analysis window in
     //! positive dB. Larger numbers (e.g. 90) give very good sidelobe 
     //! rejection but cause the window to be longer in time. Smaller numbers 
@@ -352,6 +629,78 @@ public:
     //! \param x is the new value of this parameter.            
     void setHopTime( double x );
 
+    //! Set the coarse hop time, enabling adaptive hop analysis. Steady
+    //! parts of the sound are analyzed only once per coarse hop time, 
+    //! frames around transients (found from short-time energy of the
+    //! samples) once per hop time. Fewer frames are analyzed, so the
+    //! analysis is faster, but Partials have fewer Breakpoints between
+    //! transients. The coarse hop is rounded to a multiple of the hop
+    //! time. A value not larger than the hop time (default 0) disables
+    //! adaptive hop analysis.
+    //! 
+    //! Independent of this setting, short-time frames too quiet to have
+    //! any spectral peak above the amplitude floor are never transformed.
+    //! 
+    //! \param x is the new value of this parameter.            
+    void setCoarseHopTime( double x );
+
+    //! Set the highest frequency (Hz) the analysis must preserve. Samples
+    //! at a rate much higher than twice the ceiling are decimated by an
+    //! integer factor before they are analyzed, with a linear phase
+    //! low-pass removing what would alias below the ceiling. The window
+    //! and the hop are the same in seconds, so they are shorter in
+    //! samples and the transforms are smaller, and Breakpoint times stay
+    //! those of the original samples. Partials above the ceiling may be
+    //! attenuated or lost. 0 (default) analyzes samples at their own rate.
+    //! 
+    //! \param x is the new value of this parameter.            
+    void setFrequencyCeiling( double x );
+    
+    //! Analyze the components above a frequency with a window of another
+    //! width, in the same pass: every frame is transformed with the window
+    //! of each band, centered at the same time, and the Peaks of each band
+    //! are merged before they are thinned and Partials are formed. Low 
+    //! components need long windows (narrow main lobe) to be resolved, high 
+    //! ones are sharper in time with short windows, and a long window makes
+    //! many short-lived high Partials of their transients. A band covers 
+    //! the components up to the lower frequency of the next band, the window 
+    //! of windowWidth covers the ones below the lowest band. Every band adds
+    //! a transform to every frame. No bands (default) analyze all components
+    //! with the window of windowWidth.
+    //! 
+    //! \param lowerFrequencyHz is the lowest frequency of the band.
+    //! \param windowWidthHz is the main lobe width of the Kaiser window 
+    //!         of the band, in Hz.
+    void addWindowBand( double lowerFrequencyHz, double windowWidthHz );
+    
+    //! Remove all the bands added by addWindowBand, all components are
+    //! analyzed with the window of windowWidth.
+    void clearWindowBands( void ) { m_windowBands.clear(); }
+    
+    //! Analyze a harmonic sound of a known fundamental frequency: spectral
+    //! peaks are only selected within the frequency drift (at most half 
+    //! the fundamental) of the harmonics of the fundamental in each frame,
+    //! the spectrum between them is never evaluated, and Partials are 
+    //! formed by harmonic number instead of by frequency distance, one 
+    //! Partial of each harmonic at a time, labeled by its number. Pitched 
+    //! sounds are analyzed faster, into fewer Partials. Components away 
+    //! from the harmonics are lost (as is their energy in noiseBands()), 
+    //! and so are harmonics drifting further from the envelope than the
+    //! frequency drift. Frames are not looked up in the FrameCache, the
+    //! Peaks depend on the fundamental.
+    //! 
+    //! \param fundamental is an Envelope of the fundamental frequency
+    //!         in Hz, for example one estimated by FundamentalFromSamples.
+    void setHarmonicFundamental( const Envelope & fundamental );
+    
+    //! Analyze all spectral peaks and form Partials by frequency distance
+    //! (default), undoing setHarmonicFundamental.
+    void clearHarmonicFundamental( void ) { m_harmonicFundamental.reset(); }
+    
+    //! Return true if Partials are formed by harmonic of a fundamental
+    //! frequency envelope (see setHarmonicFundamental).
+    bool isHarmonic( void ) const { return 0 != m_harmonicFundamental.get(); }
+
     //! Set the sidelobe attenutation level for the Kaiser analysis window in
     //! positive dB. More negative numbers (e.g. -90) give very good sidelobe 
     //! rejection but cause the window to be longer in time. Less negative 
@@ -505,13 +854,29 @@ public:
     const LinearEnvelope & ampEnv( void ) const;
     
     
-//  -- legacy support --
+    //! Enable or disable construction of the amplitude envelope during
+    //! analysis. It is constructed by default, when disabled ampEnv()
+    //! is empty after analysis and frames do not pay for it.
+    void buildAmpEnv( bool TF = true ) { m_buildAmpEnv = TF; }
+    
+    //! Enable or disable construction of the fundamental frequency
+    //! envelope during analysis, with the parameters specified last
+    //! (see above). It is constructed by default, when disabled
+    //! fundamentalEnv() is empty after analysis and no fundamental
+    //! is estimated in frames.
+    void buildFundamentalEnv( bool TF = true ) { m_buildFundamentalEnv = TF; }
     
-    //  Fundamental and amplitude envelopes are always constructed during
-    //  analysis, these members do nothing, and are retained for backwards
-    //  compatibility.
-    void buildAmpEnv( bool TF = true ) { TF = TF; }
-    void buildFundamentalEnv( bool TF = true ) { TF = TF; }
+    //! Return the residual of the most recent analysis performed by
+    //! this Analyzer, the energy of the spectral peaks that were not
+    //! used to form Partials, as band energy envelopes (see NoiseBands).
+    //! Empty unless buildNoiseBands() was invoked.
+    const NoiseBands & noiseBands( void ) const { return m_noiseBands; }
+    
+    //! Enable or disable construction of the residual band energy
+    //! envelopes during analysis, see noiseBands(). They are not
+    //! constructed by default. They are measured whether or not
+    //! bandwidth is associated with Partials.
+    void buildNoiseBands( bool TF = true ) { m_buildNoiseBands = TF; }
 
 //  -- private member variables --
 
@@ -541,6 +906,21 @@ private:
     double m_hopTime;           //!  in seconds, time between analysis windows in
                                 //!  successive spectral analyses
     
+    double m_coarseHopTime;     //!  in seconds, time between analysis windows
+                                //!  between transients, or 0 if adaptive hop
+                                //!  analysis is disabled
+    
+    std::vector< WindowBand > m_windowBands;  //!  bands analyzed with windows of 
+                                              //!  other widths, by lower frequency
+    
+    std::auto_ptr< Envelope > m_harmonicFundamental;
+                                //!  in Hz, fundamental frequency of the harmonics
+                                //!  peaks are selected around, or 0 for all peaks
+    
+    double m_freqCeiling;       //!  in Hz, highest frequency preserved when
+                                //!  samples are decimated before analysis, or 
+                                //!  0 if they are analyzed at their own rate
+    
     double m_cropTime;          //!  in seconds, maximum time correction for a spectral
                                 //!  component to be considered reliable, and to be eligible
                                 //!  for extraction and for Breakpoint formation
@@ -559,6 +939,25 @@ private:
                                 //!  made consistent at the end of the analysis
                             
     PartialList m_partials;     //!  collect Partials here
+    
+    ProgressListener * m_progressListener;  //!  notified of finished Partials 
+                                            //!  during analysis, or 0
+    
+    const Cancellation * m_cancellation;    //!  asked whether to stop the 
+                                            //!  analysis, or 0
+    
+    Profile * m_profile;                    //!  stage times are added to it, or 0
+    
+    FrameCache * m_frameCache;              //!  Peaks of frames are looked up
+                                            //!  and stored in it, or 0
+    
+    unsigned int m_numThreads;              //!  threads analyzing frames, 0 for
+                                            //!  one per hardware core
+    
+    double m_transformOversampling;         //!  zero-padding factor of the transforms
+    
+    bool m_fastTransformLength;             //!  round transform lengths to fast
+                                            //!  lengths, not powers of two
         
     //! builder object for constructing a fundamental frequency
     //! estimate during analysis
@@ -567,6 +966,17 @@ private:
     //! builder object for constructing an amplitude
     //! estimate during analysis
     std::auto_ptr< LinearEnvelopeBuilder > m_ampEnvBuilder;
+    
+    bool m_buildFundamentalEnv;             //!  estimate the fundamental
+                                            //!  envelope in frames
+    
+    bool m_buildAmpEnv;                     //!  estimate the amplitude
+                                            //!  envelope in frames
+    
+    bool m_buildNoiseBands;                 //!  measure the residual in 
+                                            //!  frames
+    
+    NoiseBands m_noiseBands;                //!  residual of the last analysis
 
 //  -- private auxiliary functions --
 //	future development
@@ -601,8 +1011,10 @@ private:
     //  
     //  Rejected peaks are placed at the end of the peak collection.
     //  Return the first position in the collection containing a rejected peak,
-    //  or the end of the collection if no peaks are rejected.
-    Peaks::iterator thinPeaks( Peaks & peaks, double frameTime  );
+    //  or the end of the collection if no peaks are rejected. The frequencies
+    //  of retained peaks are kept sorted in the retained buffer.
+    Peaks::iterator thinPeaks( Peaks & peaks, double frameTime, 
+                               std::vector< double > & retained ) const;
                 
     //  Fix the bandwidth value stored in the specified Peaks. 
     //  This function is invoked if the spectral residue method is
@@ -611,10 +1023,152 @@ private:
     //  compute bandwidth, the appropriate scaling is applied
     //  to the stored mixed phase derivative. Otherwise, the
     //  Peak bandwidth is set to zero.
-    void fixBandwidth( Peaks & peaks );
+    void fixBandwidth( Peaks & peaks ) const;
+    
+    //  Analyze numSamples samples provided by Samples, decimated first if
+    //  the frequency ceiling allows it (see setFrequencyCeiling()).
+    template< class Samples >
+    void analyzeSamples( Samples & samples, long numSamples, double srate,
+                         const Envelope & reference );
+    
+    //  Return the factor samples at srate are decimated by before they are
+    //  analyzed, 1 if they are analyzed at their own rate.
+    long decimationFactor( double srate ) const;
+    
+    //  Return the number of hops in a coarse hop, 1 if adaptive hop
+    //  analysis is not enabled.
+    long coarseStride( void ) const;
+    
+    //  Return the length of the transforms of windows of winlen samples,
+    //  padded and rounded as configured.
+    unsigned long transformLength( long winlen ) const;
+    
+    //  Analyze numSamples samples provided by Samples (BufferSamples,
+    //  SourceSamples or DecimatedSamples, having a fetch member that makes 
+    //  a range of samples available). Every sample analyzed stands for 
+    //  step samples of the sound, and the guard samples at both ends 
+    //  depend on samples beyond them (decimated ones), frames whose
+    //  window reaches them are not cached.
+    template< class Samples >
+    void analyzeFrames( Samples & samples, long numSamples, double srate,
+                        const Envelope & reference, long step = 1, long guard = 0 );
+    
+    //  Compute the reassigned spectra of the short-time analysis frame
+    //  centered at winMiddle, at time currentFrameTime, and store its 
+    //  thinned Peaks, having bandwidth fixed or associated and rejected 
+    //  Peaks removed, in peaks (keeping its capacity). The windows are 
+    //  clipped to [bufBegin, bufEnd). The energy of the rejected Peaks
+    //  is stored in residual (NoiseBands::NumBands values), unless it 
+    //  is 0. This reads only the analysis parameters, so frames can be 
+    //  analyzed concurrently, each thread using its own spectra (one per
+    //  window band, the first for the window of windowWidth), selector,
+    //  bandwidth associator (which may be 0 if bandwidth association is 
+    //  disabled) and buffers for the Peaks of a band and for thinning. 
+    //  The Peaks selected from the spectra are taken from cached instead,
+    //  unless it is 0, and copied to selected, unless it is 0.
+    template< class Sample >
+    void analyzeFrame( const std::vector< std::unique_ptr< ReassignedSpectrum > > & spectra, 
+                       SpectralPeakSelector & selector, AssociateBandwidth * bwAssociator, 
+                       Peaks & bandBuffer, std::vector< double > & thinBuffer,
+                       const Sample * winMiddle,
+                       const Sample * bufBegin, const Sample * bufEnd, 
+                       double currentFrameTime, Peaks & peaks, float * residual, 
+                       Profile * profile, const Peaks * cached = 0, 
+                       Peaks * selected = 0 ) const;
                     
 };  //  end of class Analyzer
 
+// ---------------------------------------------------------------------------
+//  class Analyzer::LiveAnalysis
+//
+//! Class LiveAnalysis analyzes a sound a short-time frame at a time, as 
+//! its samples arrive (from a live input), with the configuration of an
+//! Analyzer. Peaks are selected, thinned and given bandwidth as in the
+//! analysis of a buffer, and Partials are formed from them frame by frame,
+//! but they are not collected: after each frame, the LiveAnalysis reports
+//! the last Breakpoint of every Partial that the frame extended or spawned,
+//! labeled by a number identifying the Partial for as long as it lasts,
+//! and forgets the Breakpoints before it, so memory does not grow with
+//! the length of the sound.
+//!
+//! Frames are hop() samples apart and each reads the windowLength() 
+//! samples centered on it, so a frame can be analyzed windowLength() / 2
+//! samples after the sample at its center arrives. Frame cache, adaptive
+//! hop, decimation, phase correction, the harmonic fundamental and the
+//! amplitude, fundamental and noise band estimates of the Analyzer are
+//! not used.
+//
+class Analyzer::LiveAnalysis
+{
+//  -- public interface --
+public:
+
+    //! The last Breakpoint of a Partial extended or spawned by a frame.
+    struct Track
+    {
+        long label;             //!  identifies the Partial, unique in the analysis
+        double time;            //!  time of the Breakpoint in seconds (reassigned,
+                                //!  near the time of the frame)
+        Breakpoint breakpoint;
+    };
+    
+    //! Construct a new LiveAnalysis of samples at the given sample
+    //! rate, with the configuration of an Analyzer.
+    //!
+    //! \param  analyzer is the Analyzer configuration to use (it is copied)
+    //! \param  srate is the sample rate of the samples in Hz
+    LiveAnalysis( const Analyzer & analyzer, double srate );
+    
+    //! Destroy this LiveAnalysis.
+    ~LiveAnalysis( void );
+    
+    //! Return the number of samples each frame reads (odd, centered on
+    //! the frame).
+    long windowLength( void ) const { return m_winlen; }
+    
+    //! Return the number of samples between frames.
+    long hop( void ) const { return m_hop; }
+    
+    //! Return the sample rate of the samples in Hz.
+    double sampleRate( void ) const { return m_srate; }
+    
+    //! Return the time (in seconds) of the next frame, frames are
+    //! centered at sample k * hop() for k = 0, 1, ...
+    double frameTime( void ) const { return m_frame * m_hop / m_srate; }
+    
+    //! Analyze the next frame, and append the Tracks of the Partials it 
+    //! extended or spawned to tracks, by increasing frequency. Partials
+    //! not extended by the frame are finished, their labels are not
+    //! reported again.
+    //!
+    //! \param  window is the first of the windowLength() samples centered
+    //!         on the frame (zeros before the sound started)
+    //! \param  tracks collects the Tracks of the frame
+    void analyzeFrame( const double * window, std::vector< Track > & tracks );
+    
+    //! Finish all Partials, the next frame is at time 0. Labels keep
+    //! counting from the last one used.
+    void reset( void );
+    
+private:
+
+    struct State;
+    
+    Analyzer m_analyzer;            //!  configuration, harmonic selection disabled
+    double m_srate;
+    long m_winlen;
+    long m_hop;
+    long m_frame;                   //!  index of the next frame
+    long m_nextLabel;               //!  label of the next Partial spawned
+    std::unique_ptr< State > m_state; //!  spectra, selector, builder and buffers
+
+//  -- disallow copy and assignment --
+
+    LiveAnalysis( const LiveAnalysis & );
+    LiveAnalysis & operator=( const LiveAnalysis & );
+    
+};  //  end of class Analyzer::LiveAnalysis
+
 }   //  end of namespace Loris
 
 #endif /* ndef INCLUDE_ANALYZER_H */
@@ -42,6 +42,7 @@
 #include "Breakpoint.h"
 #include "BreakpointUtils.h"
 #include "LorisExceptions.h"
+#include "NoiseBands.h"
 #include "Notifier.h"
 #include "SpectralPeaks.h"
 
@@ -105,165 +106,77 @@ static double binFrequency( double freqHz, double regionRate )
 }
 
 // ---------------------------------------------------------------------------
-//	findRegionBelow
+//	computeRegions
 // ---------------------------------------------------------------------------
-//	Return the index of the last region having center frequency less than
-//	or equal to freq, or -1 if no region is low enough. 
+//	Compute, for every Peak in [begin, end), the index of the last region 
+//	having center frequency less than or equal to its bin frequency, and
+//	the relative contribution alpha of the Peak to the region above (that
+//	of the region below is 1 - alpha). 
 //
-//	Note: the zeroeth region is centered at bin frequency 1 and tapers
-//	to zero at bin frequency 0! (when booger is 1.)
+//	Peaks are processed as arrays, in one pass without branches, so the 
+//	compiler can vectorize it; the regions are then used by all the 
+//	accumulation and association passes, instead of being computed again
+//	for every Peak in every pass.
 //
-static int findRegionBelow( double binfreq, unsigned int howManyBins )
-{
-	const double booger = 0.;
-	if ( binfreq < booger ) 
-	{
-		return -1;
-	}
-	else 
-	{
-		return int( std::min( std::floor(binfreq - booger), howManyBins - 1. ) );
-	}
-}
-
-// ---------------------------------------------------------------------------
-//	computeAlpha
-// ---------------------------------------------------------------------------
-//	binfreq is a warped, fractional bin frequency, and bin frequencies 
-//	are integers. Return the relative contribution of a component at
-//	binfreq to the bins (bw association regions) below and above
-//	binfreq. 
+//	Note: the zeroeth region is centered at bin frequency 0. Everything 
+//	above the center of the highest bin is lumped into that bin; i.e it 
+//	does not taper off at higher frequencies. Negative frequencies are
+//	mapped to bin frequency 0, the passes skip them.
 //
-static double computeAlpha( double binfreq, unsigned int howManyBins )
+void
+AssociateBandwidth::computeRegions( Peaks::const_iterator begin, Peaks::const_iterator end )
 {
-	//	everything above the center of the highest
-	//	bin is lumped into that bin; i.e it does
-	//	not taper off at higher frequencies:	
-	if ( binfreq > howManyBins ) 
+	const std::size_t numPeaks = end - begin;
+	_frequencies.resize( numPeaks );
+	_amplitudes.resize( numPeaks );
+	_below.resize( numPeaks );
+	_alpha.resize( numPeaks );
+	
+	for ( std::size_t i = 0; i < numPeaks; ++i )
 	{
-		return 0.;
+		_frequencies[i] = begin[i].frequency();
+		_amplitudes[i] = begin[i].amplitude();
 	}
-	else 
+	
+	const double howManyBins = double( _weights.size() );
+	for ( std::size_t i = 0; i < numPeaks; ++i )
 	{
-		return binfreq - std::floor( binfreq );
+		const double bin = binFrequency( std::max( _frequencies[i], 0. ), _regionRate );
+		const double below = std::floor( bin );
+		_below[i] = int( std::min( below, howManyBins - 1. ) );
+		_alpha[i] = ( bin > howManyBins ) ? 0. : bin - below;
 	}
 }
 
 // ---------------------------------------------------------------------------
 //	distribute
 // ---------------------------------------------------------------------------
+//	Contribute x[i] of Peaks [first, last) of the arrays computed by
+//	computeRegions() having positive frequencies to the two regions 
+//	having center frequencies less and greater than theirs.
 //
-static void distribute( double fractionalBin, double x, std::vector<double> & regions )
-{
-	//	contribute x to two regions having center
-	//	frequencies less and greater than freqHz:
-	int posBelow = findRegionBelow( fractionalBin, regions.size() );
-	int posAbove = posBelow + 1;
-	
-	double alpha = computeAlpha( fractionalBin, regions.size() );
-	
-	if ( posAbove < regions.size() )
-		regions[posAbove] += alpha * x;
-	
-	if ( posBelow >= 0 )
-		regions[posBelow] += (1. - alpha) * x;
-}
-
-// ---------------------------------------------------------------------------
-//	computeNoiseEnergy
-// ---------------------------------------------------------------------------
-//	Return the noise energy to be associated with a component at freqHz.
-//	_surplus contains the surplus spectral energy in each region, which is,
-//	by defintion, non-negative.
-//
-double 
-AssociateBandwidth::computeNoiseEnergy( double freq, double amp )
-{
-	//	don't mess with negative frequencies:
-	if ( freq < 0. )
-		return 0.;
-	
-	//	compute the fractional bin frequency 
-	//	corresponding to freqHz:
-	double bin = binFrequency( freq, _regionRate );
-	
-	//	contribute x to two regions having center
-	//	frequencies less and greater than freqHz:
-	int posBelow = findRegionBelow( bin, _surplus.size() );
-	int posAbove = posBelow + 1;
-
-	double alpha = computeAlpha( bin, _surplus.size() );
-
-	double noise = 0.;
-	//	Have to check for alpha == 0, because 
-	//	the weights will be zero (see computeAlpha()):
-	//	(ignore lowest regions)
-	const int LowestRegion = 2;
-	/*
-	if ( posAbove < _surplus.size() && alpha != 0. && posAbove >= LowestRegion )
-		noise += _surplus[posAbove] * alpha / _weights[posAbove];
-	
-	if ( posBelow >= LowestRegion )
-		noise += _surplus[posBelow] * (1. - alpha) / _weights[posBelow];
-	*/
-	//	new idea, weight Partials by amplitude:	
-	if ( posAbove < _surplus.size() && alpha != 0. && posAbove >= LowestRegion )
-		noise += _surplus[posAbove] * alpha * amp / _weights[posAbove];
-	
-	if ( posBelow >= LowestRegion )
-		noise += _surplus[posBelow] * (1. - alpha) * amp / _weights[posBelow];
-		
-	return noise;
-}
-
-// ---------------------------------------------------------------------------
-//	accumulateSinusoid
-// ---------------------------------------------------------------------------
-//	Accumulate sinusoidal energy at frequency f and amplitude a.
-//	The amplitude isn't used for anything.
-//	
-void
-AssociateBandwidth::accumulateSinusoid( double freq, double amp )
+void 
+AssociateBandwidth::distribute( std::size_t first, std::size_t last, 
+                                const double * x, std::vector< double > & regions ) const
 {
-	//	distribute weight at the peak frequency,
-	//	don't mess with negative frequencies:
-	if ( freq > 0. )
+	const int howManyBins = int( regions.size() );
+	double * r = regions.data();
+	for ( std::size_t i = first; i < last; ++i )
 	{
-		//distribute( binFrequency( freq, _regionRate ), 1., _weights );
-		//	new idea: weight Partials by amplitude:
-		distribute( binFrequency( freq, _regionRate ), amp, _weights );
+		if ( _frequencies[i] > 0. )
+		{
+			const int posBelow = _below[i];
+			const int posAbove = posBelow + 1;
+			
+			if ( posAbove < howManyBins )
+				r[posAbove] += _alpha[i] * x[i];
+			
+			if ( posBelow >= 0 )
+				r[posBelow] += (1. - _alpha[i]) * x[i];
+		}
 	}
 }
 
-// ---------------------------------------------------------------------------
-//	accumulateNoise
-// ---------------------------------------------------------------------------
-//	Accumulate a rejected spectral peak as surplus (noise) energy.
-//
-void
-AssociateBandwidth::accumulateNoise( double freq, double amp )
-{
-	//	compute energy contribution and distribute 
-	//	at frequency f, don't mess with negative 
-	//	frequencies:
-	if ( freq > 0. )
-    {
-		distribute( binFrequency( freq, _regionRate ), amp * amp, _surplus  );
-    }
-}
-
-// ---------------------------------------------------------------------------
-//	associate
-// ---------------------------------------------------------------------------
-//	Associate bandwidth with a single SpectralPeak.
-//
-void 
-AssociateBandwidth::associate( SpectralPeak & pk )
-{		
-    pk.setBandwidth(0);
-    pk.addNoiseEnergy( computeNoiseEnergy( pk.frequency(), pk.amplitude() ) );
-}
-
 // ---------------------------------------------------------------------------
 //	reset
 // ---------------------------------------------------------------------------
@@ -292,27 +205,77 @@ AssociateBandwidth::associateBandwidth( Peaks::iterator begin, 		//	beginning of
 {		
 	if ( begin == rejected )
 		return;
-		
+	
+	//	regions of all Peaks, retained ones first:
+	computeRegions( begin, end );
+	const std::size_t numRetained = rejected - begin;
+	const std::size_t numPeaks = end - begin;
+	
 	//	accumulate retained Breakpoints as sinusoids, 
-	for ( Peaks::iterator it = begin; it != rejected; ++it )
-	{
-		accumulateSinusoid( it->frequency(), it->amplitude() );
-	}
+	//	weighted by amplitude:
+	distribute( 0, numRetained, _amplitudes.data(), _weights );
 	
-	//	accumulate rejected breakpoints as noise:
-	for ( Peaks::iterator it = rejected; it != end; ++it )
+	//	accumulate rejected breakpoints as noise, by energy:
+	_energies.resize( numPeaks );
+	for ( std::size_t i = numRetained; i < numPeaks; ++i )
 	{
-		accumulateNoise( it->frequency(), it->amplitude() );
+		_energies[i] = _amplitudes[i] * _amplitudes[i];
 	}
+	distribute( numRetained, numPeaks, _energies.data(), _surplus );
 
 	//	associate bandwidth with each retained Breakpoint:
-	for ( Peaks::iterator it = begin; it != rejected; ++it )
+	//	the noise energy associated with a component is 
+	//	the surplus of its regions, weighted by its amplitude
+	//	(_surplus is, by defintion, non-negative). Have to 
+	//	check for alpha == 0, because the weights will be 
+	//	zero then, and ignore the lowest regions:
+	const int LowestRegion = 2;
+	const int howManyBins = int( _surplus.size() );
+	for ( std::size_t i = 0; i < numRetained; ++i )
 	{
-        //  sets bandwidth to zero, then calls addNoiseEnergy()
-		associate( *it );
+		//	don't mess with negative frequencies:
+		double noise = 0.;
+		if ( _frequencies[i] >= 0. )
+		{
+			const int posBelow = _below[i];
+			const int posAbove = posBelow + 1;
+			const double alpha = _alpha[i];
+			const double amp = _amplitudes[i];
+			
+			if ( posAbove < howManyBins && alpha != 0. && posAbove >= LowestRegion )
+				noise += _surplus[posAbove] * alpha * amp / _weights[posAbove];
+			
+			if ( posBelow >= LowestRegion )
+				noise += _surplus[posBelow] * (1. - alpha) * amp / _weights[posBelow];
+		}
+		
+		SpectralPeak & pk = begin[i];
+		pk.setBandwidth(0);
+		pk.addNoiseEnergy( noise );
 	}
 	
 	//	reset after association, yuk:
 	reset();
 
 }
+
+// ---------------------------------------------------------------------------
+//	measureResidual
+// ---------------------------------------------------------------------------
+//	Add the energy of the rejected Peaks [rejected, end), the energy 
+//	accumulated as surplus, to the bands of residual (NoiseBands::NumBands
+//	values) by the frequency of each Peak. It does not depend on the 
+//	association regions, so it is also used if bandwidth association
+//	is disabled.
+//
+void
+AssociateBandwidth::measureResidual( Peaks::const_iterator rejected, Peaks::const_iterator end,
+									 float * residual )
+{
+	for ( Peaks::const_iterator it = rejected; it != end; ++it )
+	{
+		const int band = NoiseBands::bandOf( it->frequency() );
+		if ( band >= 0 )
+			residual[band] += float( it->amplitude() * it->amplitude() );
+	}
+}
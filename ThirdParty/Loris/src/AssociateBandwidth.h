@@ -67,6 +67,14 @@ class AssociateBandwidth
 	
 	double _regionRate;				//	inverse of region center spacing
 	
+	//	Peaks of the frame being associated, as arrays reused for
+	//	every frame (see computeRegions()):
+	std::vector< double > _frequencies;
+	std::vector< double > _amplitudes;
+	std::vector< double > _energies;	//	squared amplitudes of rejected Peaks
+	std::vector< int > _below;			//	region below each Peak
+	std::vector< double > _alpha;		//	contribution to the region above
+	
 //	-- public interface --
 public:
 	//	construction:
@@ -82,21 +90,23 @@ public:
 							 Peaks::iterator rejected, 	//	first rejected Peak
 							 Peaks::iterator end );		//	end of Peaks
 	
+	//	Add the energy of the rejected Peaks [rejected, end), the energy 
+	//	accumulated as surplus, to the bands of residual (NoiseBands::NumBands
+	//	values) by the frequency of each Peak. It does not depend on the 
+	//	association regions, so it is also used if bandwidth association
+	//	is disabled.
+	static void measureResidual( Peaks::const_iterator rejected, Peaks::const_iterator end,
+								 float * residual );
 		
 //	-- private helpers --	
 private:	
-	double computeNoiseEnergy( double freq, double amp );
-	
-	//	These four formerly comprised the public interface
-	//	to this policy, now they are all hidden behind a 
-	//	single call to associateBandwidth.
-	
-	//	energy accumulation:
-	void accumulateNoise( double freq, double amp );	
-	void accumulateSinusoid( double freq, double amp  );	
+	//	compute region indices and contributions of all Peaks into the 
+	//	arrays below, in one (vectorizable) pass:
+	void computeRegions( Peaks::const_iterator begin, Peaks::const_iterator end );
 	
-	//	bandwidth assocation:
-	void associate( SpectralPeak & pk );
+	//	energy accumulation of a range of those Peaks into regions:
+	void distribute( std::size_t first, std::size_t last, 
+	                 const double * x, std::vector< double > & regions ) const;
 	
 	//	call this to wipe out the accumulated energy to 
 	//	prepare for the next frame (yuk):
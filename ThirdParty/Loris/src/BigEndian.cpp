@@ -38,9 +38,21 @@
 
 #include "BigEndian.h"
 #include "LorisExceptions.h"
+#include <cstring>
 #include <vector>
 #include <iostream>
 
+#if defined(_MSC_VER)
+	#include <stdlib.h>
+	#define bswap_16( x ) _byteswap_ushort( x )
+	#define bswap_32( x ) _byteswap_ulong( x )
+	#define bswap_64( x ) _byteswap_uint64( x )
+#else
+	#define bswap_16( x ) __builtin_bswap16( x )
+	#define bswap_32( x ) __builtin_bswap32( x )
+	#define bswap_64( x ) __builtin_bswap64( x )
+#endif
+
 //	begin namespace
 namespace Loris {
 
@@ -83,6 +95,61 @@ static void swapByteOrder( char * bytes, int n )
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	swapBlock
+// ---------------------------------------------------------------------------
+//	Reverse byte order of n values of type T at bytes using a byte swap
+//	intrinsic, the loop is simple enough for compilers to vectorize
+//	into byte shuffles. Values are copied in and out, so bytes need not
+//	be aligned.
+//
+template< typename T, T (*Swap)( T ) >
+static void swapBlock( char * bytes, long n )
+{
+	for ( long i = 0; i < n; ++i )
+	{
+		T x;
+		std::memcpy( &x, bytes + i*sizeof(T), sizeof(T) );
+		x = Swap( x );
+		std::memcpy( bytes + i*sizeof(T), &x, sizeof(T) );
+	}
+}
+
+static unsigned short swap16( unsigned short x ) { return bswap_16( x ); }
+static unsigned int swap32( unsigned int x ) { return bswap_32( x ); }
+static unsigned long long swap64( unsigned long long x ) { return bswap_64( x ); }
+
+// ---------------------------------------------------------------------------
+//	BigEndian swap
+// ---------------------------------------------------------------------------
+//
+void
+BigEndian::swap( long howmany, int size, char * stuff )
+{
+	if ( bigEndianSystem() || size < 2 ) 
+	{
+		return;
+	}
+	
+	switch ( size )
+	{
+		case 2:
+			swapBlock< unsigned short, swap16 >( stuff, howmany );
+			break;
+		case 4:
+			swapBlock< unsigned int, swap32 >( stuff, howmany );
+			break;
+		case 8:
+			swapBlock< unsigned long long, swap64 >( stuff, howmany );
+			break;
+		default:
+			for ( long i = 0; i < howmany; ++i )
+			{
+				swapByteOrder( stuff + (i*size), size );
+			}
+	}
+}
+
 // ---------------------------------------------------------------------------
 //	BigEndian read
 // ---------------------------------------------------------------------------
@@ -101,13 +168,7 @@ BigEndian::read( std::istream & s, long howmany, int size, char * putemHere )
         Assert( s.gcount() == howmany*size );
 
         //	swap byte order if nec.
-        if ( ! bigEndianSystem() && size > 1 ) 
-        {
-            for ( long i = 0; i < howmany; ++i )
-            {
-                swapByteOrder( putemHere + (i*size), size );
-            }
-        }
+        swap( howmany, size, putemHere );
     }
     
     return s;
@@ -125,10 +186,7 @@ BigEndian::write( std::ostream & s, long howmany, int size, const char * stuff )
 	{
 		//	use a temporary vector to automate storage:
 		std::vector<char> v( stuff, stuff + (howmany*size) );
-		for ( long i = 0; i < howmany; ++i )
-		{
-			swapByteOrder( & v[i*size], size );
-		}
+		swap( howmany, size, &v[0] );
 		s.write( &v[0], howmany*size );
 	}
 	else
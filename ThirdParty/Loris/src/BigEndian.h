@@ -46,6 +46,11 @@ class BigEndian
 public:
 	static std::istream & read( std::istream & s, long howmany, int size, char * putemHere );
 	static std::ostream & write( std::ostream & s, long howmany, int size, const char * stuff );	
+	
+	//	Convert howmany values of size bytes each between big-endian and
+	//	native byte order in place, a block at a time. Does nothing on
+	//	big-endian systems.
+	static void swap( long howmany, int size, char * stuff );
 };	//	end of class BigEndian
 
 
@@ -74,7 +74,8 @@ Channelizer::Channelizer( const Envelope & refChanFreq, int refChanLabel, double
 	_refChannelFreq( refChanFreq.clone() ),
 	_refChannelLabel( refChanLabel ),
 	_stretchFactor( stretchFactor ),
-    _ampWeighting( 0 )
+    _ampWeighting( 0 ),
+    _numThreads( 1 )
 {
 	if ( refChanLabel <= 0 )
 	{
@@ -104,7 +105,8 @@ Channelizer::Channelizer( double refFreq, double stretchFactor ) :
 	_refChannelFreq( new LinearEnvelope( refFreq ) ),
 	_refChannelLabel( 1 ),
 	_stretchFactor( stretchFactor ),
-    _ampWeighting( 0 )
+    _ampWeighting( 0 ),
+    _numThreads( 1 )
 {
 	if ( refFreq <= 0 )
 	{
@@ -130,7 +132,8 @@ Channelizer::Channelizer( const Channelizer & other ) :
 	_refChannelFreq( other._refChannelFreq->clone() ),
 	_refChannelLabel( other._refChannelLabel ),
 	_stretchFactor( other._stretchFactor ),
-    _ampWeighting( other._ampWeighting )
+    _ampWeighting( other._ampWeighting ),
+    _numThreads( other._numThreads )
 {
 }
 
@@ -152,6 +155,7 @@ Channelizer::operator=( const Channelizer & rhs )
 		_refChannelLabel = rhs._refChannelLabel;
 		_stretchFactor = rhs._stretchFactor;
         _ampWeighting = rhs._ampWeighting;
+        _numThreads = rhs._numThreads;
 	}
 	return *this;
 }
@@ -198,6 +202,30 @@ void Channelizer::setAmplitudeWeighting( double x )
     _ampWeighting = x;
 }
 
+// ---------------------------------------------------------------------------
+//	numThreads
+// ---------------------------------------------------------------------------
+//! Return the number of threads used to channelize sequences
+//! of Partials, 0 for one per hardware core. Default is 1.
+//
+unsigned int Channelizer::numThreads( void ) const
+{
+    return _numThreads;
+}
+
+// ---------------------------------------------------------------------------
+//	setNumThreads
+// ---------------------------------------------------------------------------
+//! Set the number of threads used to channelize sequences
+//! of Partials, 0 for one per hardware core. Partials are
+//! channelized independently, so the labels assigned do
+//! not depend on the number of threads. Default is 1.
+//
+void Channelizer::setNumThreads( unsigned int n )
+{
+    _numThreads = n;
+}
+
 // ---------------------------------------------------------------------------
 //	stretchFactor
 // ---------------------------------------------------------------------------
@@ -373,9 +401,23 @@ Channelizer::computeStretchFactor( double f1, double fn, double n )
 //! a function of the stretch factor. 
 //
 double Channelizer::referenceFrequencyAt( double time ) const
+{
+    EnvelopeCursor cursor( *_refChannelFreq );
+    return referenceFrequencyAt( time, cursor );
+}
+
+// ---------------------------------------------------------------------------
+//	referenceFrequencyAt (private helper)
+// ---------------------------------------------------------------------------
+//  Compute the reference frequency at the specified time, same as
+//  referenceFrequencyAt( time ), but the reference envelope is evaluated
+//  by a cursor sweeping it along non-decreasing times, without a virtual
+//  call and a search for a LinearEnvelope reference.
+//
+double Channelizer::referenceFrequencyAt( double time, EnvelopeCursor & cursor ) const
 {
     const double N = _refChannelLabel;
-    double fref = _refChannelFreq->valueAt( time ) / N;
+    double fref = cursor.valueAt( time ) / N;
     
     if ( 0 != _stretchFactor )
     {
@@ -413,8 +455,41 @@ double Channelizer::referenceFrequencyAt( double time ) const
 double 
 Channelizer::computeFractionalChannelNumber( double time, double frequency ) const
 {
-    double refFreq = referenceFrequencyAt( time );
-    
+    return fractionalChannelNumber( referenceFrequencyAt( time ), frequency );
+}
+
+// ---------------------------------------------------------------------------
+//	computeFractionalChannelNumbers
+// ---------------------------------------------------------------------------
+//! Compute the (fractional) channel number estimate for each Breakpoint
+//! of a Partial, as computeFractionalChannelNumber() at its time and
+//! frequency. The reference envelope is evaluated in a single forward
+//! sweep over the (sorted) Breakpoint times.
+//!
+//! \param  partial is the Partial whose Breakpoints are evaluated
+//! \param  numbers receives partial.numBreakpoints() channel numbers,
+//!         in Breakpoint order
+//
+void 
+Channelizer::computeFractionalChannelNumbers( const Partial & partial, double * numbers ) const
+{
+    EnvelopeCursor cursor( *_refChannelFreq );
+    for ( Partial::const_iterator bp = partial.begin(); bp != partial.end(); ++bp )
+    {
+        *numbers++ = fractionalChannelNumber( referenceFrequencyAt( bp.time(), cursor ), 
+                                              bp.breakpoint().frequency() );
+    }
+}
+
+// ---------------------------------------------------------------------------
+//	fractionalChannelNumber (private helper)
+// ---------------------------------------------------------------------------
+//  Compute the fractional channel number of a frequency, given the
+//  reference frequency at its time, see computeFractionalChannelNumber().
+//
+double 
+Channelizer::fractionalChannelNumber( double refFreq, double frequency ) const
+{
     if ( 0 == _stretchFactor )
     {
         return frequency / refFreq;
@@ -507,12 +582,13 @@ Channelizer::channelize( Partial & partial ) const
 {
     using std::pow;
 
-	debugger << "channelizing Partial with " << partial.numBreakpoints() << " Breakpoints" << endl;
+	LORIS_DEBUGGER << "channelizing Partial with " << partial.numBreakpoints() << " Breakpoints" << endl;
 			
 	//	compute an amplitude-weighted average channel
 	//	label for each Partial:
 	//double ampsum = 0.;
 	double weightedlabel = 0.;
+	EnvelopeCursor cursor( *_refChannelFreq );  //  swept along the sorted Breakpoint times
 	Partial::const_iterator bp;
 	for ( bp = partial.begin(); bp != partial.end(); ++bp )
 	{
@@ -535,7 +611,7 @@ Channelizer::channelize( Partial & partial ) const
             weight = pow( a, _ampWeighting );
         }
         
-        weightedlabel += weight * computeFractionalChannelNumber( t, f );
+        weightedlabel += weight * fractionalChannelNumber( referenceFrequencyAt( t, cursor ), f );
 	}
 	
 	int label = 0;
@@ -33,6 +33,7 @@
  *
  */
 
+#include "ParallelFor.h"
 #include "PartialList.h"
 
 #include <memory>
@@ -41,6 +42,7 @@
 namespace Loris {
 
 class Envelope;
+class EnvelopeCursor;
 class Partial;
 
 // ---------------------------------------------------------------------------
@@ -101,6 +103,10 @@ class Channelizer
                                                 //! amplitude weighting, 2 for power weighting, etc.
                                                 //! default is 0, amplitude weighting is a bad idea
                                                 //! for many sounds
+
+    unsigned int _numThreads;                   //! number of threads channelizing sequences
+                                                //! of Partials, 0 for one per hardware core,
+                                                //! default is 1
     
 //  -- public interface --
 public:
@@ -250,6 +256,16 @@ public:
     //!         frequency and time
     double computeFractionalChannelNumber( double time, double frequency ) const;
     
+    //! Compute the (fractional) channel number estimate for each Breakpoint
+    //! of a Partial, as computeFractionalChannelNumber() at its time and
+    //! frequency. The reference envelope is evaluated in a single forward
+    //! sweep over the (sorted) Breakpoint times.
+    //!
+    //! \param  partial is the Partial whose Breakpoints are evaluated
+    //! \param  numbers receives partial.numBreakpoints() channel numbers,
+    //!         in Breakpoint order
+    void computeFractionalChannelNumbers( const Partial & partial, double * numbers ) const;
+    
     
     //! Compute the reference frequency at the specified time. For non-stretched 
     //! harmonics, this is simply the ratio of the reference envelope evaluated 
@@ -313,6 +329,16 @@ public:
     //! \throw  InvalidArgument if stretch is negative.
     void setStretchFactor( double stretch );    
     
+    //! Return the number of threads used to channelize sequences
+    //! of Partials, 0 for one per hardware core. Default is 1.
+    unsigned int numThreads( void ) const;
+    
+    //! Set the number of threads used to channelize sequences
+    //! of Partials, 0 for one per hardware core. Partials are
+    //! channelized independently, so the labels assigned do
+    //! not depend on the number of threads. Default is 1.
+    void setNumThreads( unsigned int n );
+    
          
 // -- static members --
 
@@ -447,6 +473,16 @@ public:
     //!             (that is, for harmonic frequencies fn = n*f1).
     static double computeStretchFactor( double f1, double fn, double n );
     
+//  -- helpers --
+private:
+    //! Compute the reference frequency at a time, evaluating the reference
+    //! envelope by a cursor sweeping it (see EnvelopeCursor).
+    double referenceFrequencyAt( double time, EnvelopeCursor & cursor ) const;
+    
+    //! Compute the fractional channel number of a frequency, given
+    //! the reference frequency at its time.
+    double fractionalChannelNumber( double refFreq, double frequency ) const;
+    
 };  //  end of class Channelizer
 
 // ---------------------------------------------------------------------------
@@ -459,6 +495,8 @@ public:
 //! \param begin is the beginning of the range of Partials to channelize
 //! \param end is (one-past) the end of the range of Partials o channelize
 //! 
+//! Partials are channelized concurrently by numThreads() threads.
+//!
 //! If compiled with NO_TEMPLATE_MEMBERS defined, then begin and end
 //! must be PartialList::iterators, otherwise they can be any type
 //! of iterators over a sequence of Partials.
@@ -471,10 +509,8 @@ inline
 void Channelizer::channelize( PartialList::iterator begin, PartialList::iterator end ) const
 #endif
 {
-    while ( begin != end )
-    {
-        channelize( *begin++ );
-    }
+    parallelForEach( begin, end, _numThreads,
+                     [this]( Partial & partial ) { channelize( partial ); } );
 }
 
 // ---------------------------------------------------------------------------
@@ -40,14 +40,19 @@
 #include "Breakpoint.h"
 #include "BreakpointUtils.h"
 #include "LorisExceptions.h"
+#include "ParallelFor.h"
 #include "Partial.h"
 #include "PartialList.h"
 #include "PartialUtils.h"
 #include "Notifier.h"
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
+#include <limits>
+#include <map>
 #include <utility>
+#include <vector>
 
 //	begin namespace
 namespace Loris {
@@ -77,7 +82,9 @@ namespace Loris {
 //!            0.001 (one millisecond).
 Collator::Collator( double partialFadeTime, double partialSilentTime ) :
 	_fadeTime( partialFadeTime ),
-	_gapTime( partialSilentTime )
+	_gapTime( partialSilentTime ),
+	_bandWidth( 0 ),
+	_numThreads( 1 )
 {
 	if ( _fadeTime <= 0.0 )
 	{
@@ -89,6 +96,60 @@ Collator::Collator( double partialFadeTime, double partialSilentTime ) :
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	frequencyBandWidth
+// ---------------------------------------------------------------------------
+//! Return the width in Hz of the frequency bands collated
+//! independently, 0 if all Partials are collated together.
+//! Default is 0.
+//
+double Collator::frequencyBandWidth( void ) const
+{
+    return _bandWidth;
+}
+
+// ---------------------------------------------------------------------------
+//	setFrequencyBandWidth
+// ---------------------------------------------------------------------------
+//! Set the width in Hz of the frequency bands collated
+//! independently, 0 collates all Partials together. See
+//! Collator.h.
+//!
+//! \throw  InvalidArgument if hz is negative.
+//
+void Collator::setFrequencyBandWidth( double hz )
+{
+	if ( hz < 0.0 )
+	{
+		Throw( InvalidArgument, "Collator frequency band width must be non-negative." );
+	}
+    _bandWidth = hz;
+}
+
+// ---------------------------------------------------------------------------
+//	numThreads
+// ---------------------------------------------------------------------------
+//! Return the number of threads used to collate frequency
+//! bands, 0 for one per hardware core. Default is 1.
+//
+unsigned int Collator::numThreads( void ) const
+{
+    return _numThreads;
+}
+
+// ---------------------------------------------------------------------------
+//	setNumThreads
+// ---------------------------------------------------------------------------
+//! Set the number of threads used to collate frequency bands,
+//! 0 for one per hardware core. Bands are collated independently,
+//! so the collated Partials do not depend on the number of 
+//! threads. Default is 1.
+//
+void Collator::setNumThreads( unsigned int n )
+{
+    _numThreads = n;
+}
+
 // -- helpers --
 
 // ---------------------------------------------------------------------------
@@ -99,93 +160,194 @@ static bool ends_earlier( const Partial & lhs, const Partial & rhs )
 	return lhs.endTime() < rhs.endTime();
 }
 
-struct ends_before : public std::unary_function< const Partial, bool >
+// ---------------------------------------------------------------------------
+//	CollatedEnds (helper class)
+// ---------------------------------------------------------------------------
+//	End times of the collated Partials, in the order they were collated,
+//	for finding the first one that ends before a time in logarithmic time.
+//	A complete binary tree keeps the earliest end time of each range of
+//	collated Partials, a search goes down to the left child whenever a
+//	Partial in its range ends early enough. Positions not collated yet
+//	end at infinity.
+//
+class CollatedEnds
 {
-	double t;
-	ends_before( double time ) : t( time ) {}
+public:
+	explicit CollatedEnds( std::size_t maxCollated ) :
+		_size( 1 )
+	{
+		while ( _size < maxCollated )
+		{
+			_size *= 2;
+		}
+		_earliest.assign( 2 * _size, std::numeric_limits< double >::infinity() );
+	}
+	
+	//	Return the position of the first collated Partial ending
+	//	before time, or a position past all collated ones if none
+	//	does.
+	std::size_t firstEndingBefore( double time ) const
+	{
+		if ( !( _earliest[ 1 ] < time ) )
+			return _size;
+		
+		std::size_t node = 1;
+		while ( node < _size )
+		{
+			node = ( _earliest[ 2 * node ] < time ) ? ( 2 * node ) : ( 2 * node + 1 );
+		}
+		return node - _size;
+	}
 	
-	bool operator() ( const Partial & p ) const 
-		{ return p.endTime() < t; }
+	//	Set the end time of the collated Partial at position.
+	void setEnd( std::size_t position, double time )
+	{
+		std::size_t node = position + _size;
+		_earliest[ node ] = time;
+		for ( node /= 2; node > 0; node /= 2 )
+		{
+			_earliest[ node ] = std::min( _earliest[ 2 * node ], _earliest[ 2 * node + 1 ] );
+		}
+	}
+	
+private:
+	std::size_t _size;
+	std::vector< double > _earliest;
 };
 
 // ---------------------------------------------------------------------------
-//	collateAux
+//	collateBand	(STATIC)
 // ---------------------------------------------------------------------------
-//! Collate unlabeled (zero labeled) Partials into the smallest
-//! possible number of Partials that does not combine any temporally
-//! overlapping Partials. The unlabeled Partials are
-//! collated in-place.
+//	Collate Partials into the smallest possible number of Partials that 
+//	does not combine any temporally overlapping Partials, in-place.
 //
-void Collator::collateAux( PartialList & unlabeled  )
+static void collateBand( PartialList & unlabeled, double fadeTime, double gapTime )
 {
-	debugger << "Collator found " << unlabeled.size() 
-			 << " unlabeled Partials, collating..." << endl;
-	
 	// 	sort Partials by end time:
 	// 	thanks to Ulrike Axen for this optimal algorithm!
 	unlabeled.sort( ends_earlier );
 	
 	//	invariant:
-	//	Partials in the range [partials.begin(), endcollated)
-	//	are the collated Partials.
+	//	the Partials in collated (in the order they are in
+	//	unlabeled) are the collated Partials, ends has their
+	//	end times.
+	std::vector< Partial * > collated;
+	CollatedEnds ends( unlabeled.size() );
+	
+	//	There must be a gap of at least
+	//	twice the fadeTime, because this algorithm
+	//	does not remove any null Breakpoints, and 
+	//	because Partials joined in this way might
+	//	be far apart in frequency.
+	const double clearance = (2.*fadeTime) + gapTime;
+	
 	PartialList::iterator endcollated = unlabeled.begin();
 	while ( endcollated != unlabeled.end() )
 	{
-		//	find a collated Partial that ends
-		//	before this one begins.
-		//	There must be a gap of at least
-		//	twice the _fadeTime, because this algorithm
-		//	does not remove any null Breakpoints, and 
-		//	because Partials joined in this way might
-		//	be far apart in frequency.
-		const double clearance = (2.*_fadeTime) + _gapTime;
-		PartialList::iterator it = 
-			std::find_if( unlabeled.begin(), endcollated, 
-                          ends_before( endcollated->startTime() - clearance) );
+		//	find the first collated Partial that ends
+		//	before this one begins:
+		std::size_t found = ends.firstEndingBefore( endcollated->startTime() - clearance );
 						  
 		// 	if no such Partial exists, then this Partial
 		//	becomes one of the collated ones, otherwise, 
 		//	insert two null Breakpoints, and then all
 		//	the Breakpoints in this Partial:
-		if ( it != endcollated )
+		if ( found < collated.size() )
 		{
 			Partial & addme = *endcollated;
-			Partial & collated = *it;
-			Assert( &addme != &collated );
+			Partial & collated_p = *collated[ found ];
+			Assert( &addme != &collated_p );
 			
 			//	insert a null at the (current) end
 			//	of collated:
-			double nulltime1 = collated.endTime() + _fadeTime;
-			Breakpoint null1( collated.frequencyAt(nulltime1), 0., 
-							  collated.bandwidthAt(nulltime1), collated.phaseAt(nulltime1) );			
-			collated.insert( nulltime1, null1 );
+			double nulltime1 = collated_p.endTime() + fadeTime;
+			Breakpoint null1( collated_p.frequencyAt(nulltime1), 0., 
+							  collated_p.bandwidthAt(nulltime1), collated_p.phaseAt(nulltime1) );			
+			collated_p.insert( nulltime1, null1 );
 
 			//	insert a null at the beginning of
 			//	of the current Partial:
-			double nulltime2 = addme.startTime() - _fadeTime;
+			double nulltime2 = addme.startTime() - fadeTime;
 			Assert( nulltime2 >= nulltime1 );
 			Breakpoint null2( addme.frequencyAt(nulltime2), 0., 
 							  addme.bandwidthAt(nulltime2), addme.phaseAt(nulltime2) );			
-			collated.insert( nulltime2, null2 );
+			collated_p.insert( nulltime2, null2 );
 	
 			//	insert all the Breakpoints in addme 
 			//	into collated:
 			Partial::iterator addme_it;
 			for ( addme_it = addme.begin(); addme_it != addme.end(); ++addme_it )
 			{
-				collated.insert( addme_it.time(), addme_it.breakpoint() );
+				collated_p.insert( addme_it.time(), addme_it.breakpoint() );
 			}
+			ends.setEnd( found, collated_p.endTime() );
 			
 			//	remove this Partial from the list:
 			endcollated = unlabeled.erase( endcollated );
 		}
 		else
 		{
+			ends.setEnd( collated.size(), endcollated->endTime() );
+			collated.push_back( &*endcollated );
 		    ++endcollated;
 		}
 	}
+}
+
+// ---------------------------------------------------------------------------
+//	collateAux
+// ---------------------------------------------------------------------------
+//! Collate unlabeled (zero labeled) Partials into the smallest
+//! possible number of Partials that does not combine any temporally
+//! overlapping Partials. The unlabeled Partials are
+//! collated in-place.
+//
+void Collator::collateAux( PartialList & unlabeled  )
+{
+	LORIS_DEBUGGER << "Collator found " << unlabeled.size() 
+			 << " unlabeled Partials, collating..." << endl;
+	
+	if ( 0 == _bandWidth )
+	{
+		collateBand( unlabeled, _fadeTime, _gapTime );
+	}
+	else
+	{
+		//	bucket the Partials by frequency band, each is spliced
+		//	to the list of its band, the map keeps the bands in
+		//	frequency order:
+		std::map< long, PartialList > bands;
+		PartialList::iterator it = unlabeled.begin();
+		while ( it != unlabeled.end() )
+		{
+			PartialList::iterator next = it;
+			++next;
+			
+			long band = (long) std::floor( PartialUtils::avgFrequency( *it ) / _bandWidth );
+			PartialList & samebands = bands[ band ];
+			samebands.splice( samebands.end(), unlabeled, it );
+			it = next;
+		}
+		
+		std::vector< PartialList * > lists;
+		lists.reserve( bands.size() );
+		for ( auto & entry : bands )
+		{
+			lists.push_back( &entry.second );
+		}
+		
+		parallelFor( lists.size(), _numThreads,
+					 [&]( std::size_t i ) 
+					 { 
+						 collateBand( *lists[ i ], _fadeTime, _gapTime ); 
+					 } );
+		for ( PartialList * list : lists )
+		{
+			unlabeled.splice( unlabeled.end(), *list );
+		}
+	}
 	
-	debugger << "...now have " << unlabeled.size() << endl;
+	LORIS_DEBUGGER << "...now have " << unlabeled.size() << endl;
 }
 
 }	//	end of namespace Loris
@@ -62,12 +62,18 @@ namespace Loris {
 //! unlabeled (labeled 0) Partials are affected by the collating
 //! operation. Collated Partials are moved to the end of the 
 //! collection of Partials.
+//!
+//! Unlabeled Partials can also be collated in frequency bands (see
+//! setFrequencyBandWidth), concurrently. Partials are then only joined
+//! to Partials in the same band.
 //
 class Collator
 {
 //  -- instance variables --
 
     double _fadeTime, _gapTime;       
+    double _bandWidth;                  // Hz of bands collated independently, 0 for one
+    unsigned int _numThreads;           // threads collating bands, 0 for all cores
         
 //  -- public interface --
 public:
@@ -118,6 +124,33 @@ public:
      
     //  Use compiler-generated copy, assign, and destroy.
     
+//  -- parameters --
+
+    //! Return the width in Hz of the frequency bands collated
+    //! independently, 0 if all Partials are collated together.
+    //! Default is 0.
+    double frequencyBandWidth( void ) const;
+    
+    //! Set the width in Hz of the frequency bands collated
+    //! independently. A Partial belongs to the band of its
+    //! average frequency and is only joined to Partials in the
+    //! same band, so collated Partials stay within a band but 
+    //! there are more of them. 0 collates all Partials together,
+    //! into the smallest-possible number of Partials. Default is 0.
+    //!
+    //! \throw  InvalidArgument if hz is negative.
+    void setFrequencyBandWidth( double hz );
+    
+    //! Return the number of threads used to collate frequency
+    //! bands, 0 for one per hardware core. Default is 1.
+    unsigned int numThreads( void ) const;
+    
+    //! Set the number of threads used to collate frequency bands,
+    //! 0 for one per hardware core. Bands are collated independently,
+    //! so the collated Partials do not depend on the number of 
+    //! threads. Default is 1.
+    void setNumThreads( unsigned int n );
+    
 //  -- collating --
 
     //! Collate unlabeled (zero-labeled) Partials into the smallest-possible 
@@ -54,7 +54,8 @@ namespace Loris {
 // ---------------------------------------------------------------------------
 //!	Construct a new Dilator with 
 //!	no time points.
-Dilator::Dilator( void )
+Dilator::Dilator( void ) :
+	_numThreads( 1 )
 {
 }
 
@@ -99,8 +100,51 @@ Dilator::insert( double i, double t )
 double
 Dilator::warpTime( double currentTime ) const
 {
-    int idx = std::distance( _initial.begin(), 
-                             std::lower_bound( _initial.begin(), _initial.end(), currentTime ) );
+    std::size_t idx = std::distance( _initial.begin(), 
+                                     std::lower_bound( _initial.begin(), _initial.end(), currentTime ) );
+    return warpTimeAt( currentTime, idx );
+}
+
+// ---------------------------------------------------------------------------
+//	warpTime (sweep)
+// --------------------------------------------------------------------------
+//! Return the dilated time value corresponding to the specified initial
+//! time, for a sweep of non-decreasing times (as the Breakpoint times
+//! of a Partial). The cursor walks forward through the time points, so
+//! a sweep costs amortized constant time per time instead of a search.
+//! Earlier times are still warped correctly, by searching again.
+//! 
+//! \param currentTime is a pre-dilated time.
+//! \param cursor is the position of the sweep in the initial time
+//!        points, 0 to start a sweep, updated by every call.
+//! \return the dilated time corresponding to the initial time currentTime
+//
+double
+Dilator::warpTime( double currentTime, std::size_t & cursor ) const
+{
+    //  the cursor is the first initial time point not earlier than
+    //  the last time warped
+    if ( cursor > _initial.size() || ( cursor > 0 && _initial[cursor-1] >= currentTime ) )
+    {
+        cursor = std::distance( _initial.begin(), 
+                                std::lower_bound( _initial.begin(), _initial.end(), currentTime ) );
+    }
+    while ( cursor < _initial.size() && _initial[cursor] < currentTime )
+    {
+        ++cursor;
+    }
+    return warpTimeAt( currentTime, cursor );
+}
+
+// ---------------------------------------------------------------------------
+//	warpTimeAt
+// --------------------------------------------------------------------------
+//! Return the dilated time of currentTime, idx is the position of
+//! the first initial time point not earlier than currentTime.
+//
+double
+Dilator::warpTimeAt( double currentTime, std::size_t idx ) const
+{
     Assert( idx == _initial.size() || currentTime <= _initial[idx] );
     
     //	compute a new time for the Breakpoint at pIter:
@@ -170,7 +214,7 @@ Dilator::warpTime( double currentTime ) const
 void
 Dilator::dilate( Partial & p ) const
 {
-	debugger << "dilating Partial having " << p.numBreakpoints() 
+	LORIS_DEBUGGER << "dilating Partial having " << p.numBreakpoints() 
 			 << " Breakpoints" << endl;
 
 	//	sanity check:
@@ -187,61 +231,20 @@ Dilator::dilate( Partial & p ) const
 	Partial newp;
 	newp.setLabel( p.label() );
 	
-	//	timepoint index:
-	int idx = 0;
+	//	Breakpoint times increase, the time points are swept
+	//	along with them:
+	std::size_t cursor = 0;
 	for ( Partial::const_iterator iter = p.begin(); iter != p.end(); ++iter )
 	{
-		//	find the first initial time point later 
-		//	than the currentTime:
-		double currentTime = iter.time();
-        idx = std::distance( _initial.begin(), 
-                             std::lower_bound( _initial.begin(), _initial.end(), currentTime ) );
-        Assert( idx == _initial.size() || currentTime <= _initial[idx] );
-        
-		//	compute a new time for the Breakpoint at pIter:
-		double newtime = 0;
-		if ( idx == 0 ) 
-		{
-			//	all time points in _initial are later than 
-			//	the currentTime; stretch if no zero time 
-			//	point has been specified, otherwise, shift:
-			if ( _initial[idx] != 0. )
-				newtime = currentTime * _target[idx] / _initial[idx];
-			else
-				newtime = _target[idx] + (currentTime - _initial[idx]);
-		}
-		else if ( idx == _initial.size() ) 
-		{
-			//	all time points in _initial are earlier than 
-			//	the currentTime; shift:
-			//
-			//	note: size is already known to be > 0, so
-			//	idx-1 is safe
-			newtime = _target[idx-1] + (currentTime - _initial[idx-1]);
-		}
-		else 
-		{
-			//	currentTime is between the time points at idx and
-			//	idx-1 in _initial; shift and stretch: 
-			//
-			//	note: size is already known to be > 0, so
-			//	idx-1 is safe
-			Assert( _initial[idx-1] < _initial[idx] );	//	currentTime can't wind up 
-														//	between two equal times
-			
-			double stretch = (_target[idx]	- _target[idx-1]) / (_initial[idx] - _initial[idx-1]);			
-			newtime = _target[idx-1] + ((currentTime - _initial[idx-1]) * stretch);
-		}
-		
 		//	add a Breakpoint at the computed time:
-		newp.insert( newtime, iter.breakpoint() );
+		newp.insert( warpTime( iter.time(), cursor ), iter.breakpoint() );
 	}
 	
 	//	new Breakpoints need to be added to the Partial at times corresponding
 	//	to all target time points that are after the first Breakpoint and
 	//	before the last, otherwise, Partials may be briefly out of tune with
 	//	each other, since our Breakpoints are non-uniformly distributed in time:
-	for ( idx = 0; idx < _initial.size(); ++ idx )
+	for ( std::size_t idx = 0; idx < _initial.size(); ++ idx )
 	{
 		if ( _initial[idx] <= p.startTime() )
         {
@@ -37,6 +37,8 @@
 #include "PartialList.h"
 #endif
 
+#include "ParallelFor.h"
+
 #include <vector>
 
 //	begin namespace
@@ -65,6 +67,7 @@ class Dilator
 //	-- instance variables --
 
 	std::vector< double > _initial, _target;	//	time points
+	unsigned int _numThreads;					//	threads dilating sequences, 0 for all cores
 	
 //	-- public interface --
 public:
@@ -117,6 +120,16 @@ public:
 	//!	time t in the dilation process.	
 	void insert( double i, double t );
 	
+	//!	Return the number of threads used to dilate sequences of
+	//!	Partials or Markers, 0 for one per hardware core. Default is 1.
+	unsigned int numThreads( void ) const { return _numThreads; }
+	
+	//!	Set the number of threads used to dilate sequences of
+	//!	Partials or Markers, 0 for one per hardware core. Each is 
+	//!	dilated independently, so the result does not depend on the 
+	//!	number of threads. Default is 1.
+	void setNumThreads( unsigned int n ) { _numThreads = n; }
+	
 //	-- dilation --
 
 	//!	Replace the Partial envelope with a new envelope having the
@@ -203,6 +216,18 @@ public:
 	//! \return the dilated time corresponding to the initial time currentTime
     double warpTime( double currentTime ) const;
 
+	//!	Return the dilated time value corresponding to the specified initial
+	//!	time, for a sweep of non-decreasing times (as the Breakpoint times
+	//!	of a Partial). The cursor walks forward through the time points, so
+	//!	a sweep costs amortized constant time per time instead of a search.
+	//!	Earlier times are still warped correctly, by searching again.
+	//! 
+	//!	\param currentTime is a pre-dilated time.
+	//!	\param cursor is the position of the sweep in the initial time
+	//!	       points, 0 to start a sweep, updated by every call.
+	//! \return the dilated time corresponding to the initial time currentTime
+    double warpTime( double currentTime, std::size_t & cursor ) const;
+
 // -- static members --
 
    //!   Static member that constructs an instance and applies
@@ -242,6 +267,13 @@ public:
 				 const double * tbegin  );
 #endif
 
+//	-- implementation --
+private:
+
+	//!	Return the dilated time of currentTime, idx is the position of
+	//!	the first initial time point not earlier than currentTime.
+    double warpTimeAt( double currentTime, std::size_t idx ) const;
+
 };	//	end of class Dilator
 
 
@@ -271,6 +303,7 @@ Dilator::Dilator( Iter1 ibegin, Iter1 iend, Iter2 tbegin )
 inline
 Dilator::Dilator( const double * ibegin, const double * iend, const double * tbegin )
 #endif
+	: _numThreads( 1 )
 {
 	while ( ibegin != iend )
 	{
@@ -304,10 +337,8 @@ void Dilator::dilate( PartialList::iterator dilate_begin,
 					  PartialList::iterator dilate_end  ) const
 #endif
 {
-	while ( dilate_begin != dilate_end )
-	{
-		dilate( *(dilate_begin++) );
-	}
+	parallelForEach( dilate_begin, dilate_end, _numThreads,
+					 [this]( decltype( *dilate_begin ) x ) { dilate( x ); } );
 }
 
 // ---------------------------------------------------------------------------
@@ -40,14 +40,18 @@
 #include "Breakpoint.h"
 #include "BreakpointUtils.h"
 #include "LorisExceptions.h"
+#include "ParallelFor.h"
 #include "Partial.h"
 #include "PartialList.h"
 #include "PartialUtils.h"
 #include "Notifier.h"
+#include "Sieve.h"
 
 #include <algorithm>
 #include <functional>
+#include <map>
 #include <utility>
+#include <vector>
 
 //	begin namespace
 namespace Loris {
@@ -78,7 +82,9 @@ namespace Loris {
 //
 Distiller::Distiller( double partialFadeTime, double partialSilentTime ) :
 	_fadeTime( partialFadeTime ),
-	_gapTime( partialSilentTime )
+	_gapTime( partialSilentTime ),
+	_numThreads( 1 ),
+	_sifting( false )
 {
 	if ( _fadeTime <= 0.0 )
 	{
@@ -90,6 +96,54 @@ Distiller::Distiller( double partialFadeTime, double partialSilentTime ) :
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	numThreads
+// ---------------------------------------------------------------------------
+//! Return the number of threads used to distill Partials,
+//! 0 for one per hardware core. Default is 1.
+//
+unsigned int Distiller::numThreads( void ) const
+{
+    return _numThreads;
+}
+
+// ---------------------------------------------------------------------------
+//	setNumThreads
+// ---------------------------------------------------------------------------
+//! Set the number of threads used to distill Partials, 0 for
+//! one per hardware core. Partials having different labels are
+//! distilled independently, so the distilled Partials do not 
+//! depend on the number of threads. Default is 1.
+//
+void Distiller::setNumThreads( unsigned int n )
+{
+    _numThreads = n;
+}
+
+// ---------------------------------------------------------------------------
+//	sifting
+// ---------------------------------------------------------------------------
+//! Return true if Partials are sifted before they are
+//! distilled. Default is false.
+//
+bool Distiller::sifting( void ) const
+{
+    return _sifting;
+}
+
+// ---------------------------------------------------------------------------
+//	setSifting
+// ---------------------------------------------------------------------------
+//! Set whether Partials are sifted before they are distilled.
+//! When sifting, a Partial overlapping a longer Partial having
+//! the same label is not distilled, but unlabeled and left at the 
+//! end of the distilled Partials. See Distiller.h.
+//
+void Distiller::setSifting( bool sift )
+{
+    _sifting = sift;
+}
+
 // -- helpers --
 
 // ---------------------------------------------------------------------------
@@ -177,7 +231,7 @@ static void merge( Partial::const_iterator beg,
     double rbt = (removeBegin != destPartial.end())?(removeBegin.time()):(destPartial.endTime());
     double ret = (removeEnd != destPartial.end())?(removeEnd.time()):(destPartial.endTime());
     Assert( rbt <= ret );
-	destPartial.erase( removeBegin, removeEnd );
+	removeEnd = destPartial.erase( removeBegin, removeEnd );
 
     //  how about doing the fades here instead?
     //  fade in if necessary:
@@ -188,12 +242,15 @@ static void merge( Partial::const_iterator beg,
 
         //	update removeEnd so that we don't remove this 
         //	null we are inserting:
+        //
+        //  (insertion may invalidate removeEnd, and the Breakpoint
+        //  before it is this null now, so there is no fade out
+        //  to insert below)
         destPartial.insert( 
             removeEnd.time() - fadeTime, 
             BreakpointUtils::makeNullBefore( removeEnd.breakpoint(), fadeTime ) );
 	}
-
-    if ( removeEnd != destPartial.begin() )
+    else if ( removeEnd != destPartial.begin() )
     {
         Partial::iterator beforeMerge = --Partial::iterator(removeEnd);
         if ( beforeMerge.breakpoint().amplitude() > 0 )
@@ -305,14 +362,35 @@ static bool distillSorter( const Partial & lhs, const Partial & rhs )
 // 	into a single Partial with that label, and append it
 //  to the distilled collection. If an empty list of Partials
 //  is passed, then an empty Partial having the specified
-//  label is appended.
+//  label is appended. When sifting, Partials sifted out
+//  are unlabeled and appended to sifted.
 //
 void Distiller::distillOne( PartialList & partials, Partial::label_type label,
-                            PartialList & distilled )
+                            PartialList & distilled, PartialList & sifted )
 {
-	debugger << "Distiller found " << partials.size() 
+	LORIS_DEBUGGER << "Distiller found " << partials.size() 
 			 << " Partials labeled " << label << endl;
 
+    //  the Sieve only unlabels the Partials it sifts out, they
+    //  are moved out of the way of the distillation, the rest 
+    //  are far enough apart to be just joined below:
+    if ( _sifting && partials.size() > 1 )
+    {
+        Sieve( _fadeTime + 0.5 * _gapTime ).sift( partials );
+        
+        PartialList::iterator it = partials.begin();
+        while ( it != partials.end() )
+        {
+            PartialList::iterator next = it;
+            ++next;
+            if ( 0 == it->label() )
+            {
+                sifted.splice( sifted.end(), partials, it );
+            }
+            it = next;
+        }
+    }
+
 	Partial newp;
     newp.setLabel( label );
 
@@ -320,6 +398,25 @@ void Distiller::distillOne( PartialList & partials, Partial::label_type label,
     {
         //  trivial if there is only one partial to distill
         newp = partials.front();
+    }
+    else if ( _sifting && partials.size() > 0 )
+    {
+        //  sifted Partials are at least two fade times and the
+        //  silent time apart, so each fades out before the next 
+        //  one fades in, there is nothing to merge or absorb:
+        partials.sort( PartialUtils::compareStartTimeLess() );
+        
+        PartialList::iterator it = partials.begin();
+        newp = *it;
+        fadeInAndOut( newp, _fadeTime );
+        for ( ++it; it != partials.end(); ++it )
+        {
+            fadeInAndOut( *it, _fadeTime );
+            for ( Partial::const_iterator bp = it->begin(); bp != it->end(); ++bp )
+            {
+                newp.insert( bp.time(), bp.breakpoint() );
+            }
+        }
     }
 	else if ( partials.size() > 0 )  //  it will be an empty Partial otherwise
     {	
@@ -432,37 +529,54 @@ void Distiller::distillOne( PartialList & partials, Partial::label_type label,
 //
 PartialList::iterator Distiller::distill_list( PartialList & partials )
 {  
-    //  sort the Partials by label, this is why it
-    //  is so much better to distill a list!    
-    partials.sort( PartialUtils::compareLabelLess() );
-
     //  temporary container of distilled Partials:
     PartialList distilled; 
-	
-	PartialList::iterator lower = partials.begin();
-	while ( lower != partials.end() )
-	{
-		Partial::label_type label = lower->label();
-
-        //  identify a sequence of Partials having the same label:
-	    PartialList::iterator upper = 
-	        std::find_if( lower, partials.end(),
-	                      std::not1( PartialUtils::isLabelEqual( label ) ) );
-                            
-        //  upper is the first Partial after lower whose label is not
-        //  equal to that of lower.
-		//	[lower, upper) is a range of all the
-		//	partials labeled `label'.
-
+    
+    //  labels are distilled concurrently, each into its own list,
+    //  the map keeps the lists in label order:
+    struct Channel
+    {
+        Partial::label_type label;
+        PartialList samelabel, distilled, sifted;
+    };
+    std::map< Partial::label_type, Channel > labeled;
+    
+    //  bucket the labeled Partials in a single pass, each is spliced
+    //  to the list of its label (nodes are relinked, not copied), so
+    //  the whole list is not sorted by label, unlabeled Partials stay
+    //  in partials in their order:
+    PartialList::iterator it = partials.begin();
+    while ( it != partials.end() )
+    {
+        PartialList::iterator next = it;
+        ++next;
+        
+        Partial::label_type label = it->label();
         if ( 0 != label )
         {
-            //	make a container of the Partials having the same 
-            //	label, and distill them:
-            PartialList samelabel;
-            samelabel.splice( samelabel.begin(), partials, lower, upper );
-            distillOne( samelabel, label, distilled );
+            Channel & channel = labeled[ label ];
+            channel.label = label;
+            channel.samelabel.splice( channel.samelabel.end(), partials, it );
         }
-        lower = upper;
+        it = next;
+    }
+    
+    std::vector< Channel * > channels;
+    channels.reserve( labeled.size() );
+    for ( auto & entry : labeled )
+    {
+        channels.push_back( &entry.second );
+    }
+    
+    parallelFor( channels.size(), _numThreads,
+                 [&]( std::size_t i ) 
+                 { 
+                     distillOne( channels[ i ]->samelabel, channels[ i ]->label, 
+                                 channels[ i ]->distilled, channels[ i ]->sifted ); 
+                 } );
+    for ( Channel * channel : channels )
+    {
+        distilled.splice( distilled.end(), channel->distilled );
     }
         
 #if defined(Debug_Loris) && Debug_Loris
@@ -472,6 +586,13 @@ PartialList::iterator Distiller::distill_list( PartialList & partials )
                           std::not1( PartialUtils::isLabelEqual( 0 ) ) ) );
 #endif    
     
+    //  Partials sifted out follow the ones that were not labeled,
+    //  in label order:
+    for ( Channel * channel : channels )
+    {
+        partials.splice( partials.end(), channel->sifted );
+    }
+    
     //  remember where the unlabeled Partials start:
     PartialList::iterator beginUnlabeled = partials.begin(); 
     
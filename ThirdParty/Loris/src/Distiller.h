@@ -65,12 +65,18 @@ namespace Loris {
 //! Partials in the distilled range having a common label are replaced by
 //! a single Partial in the distillation process. Only labeled
 //! Partials are affected by distillation. 
+//!
+//! A Distiller can also sift the Partials of each label before distilling
+//! them (see setSifting), doing the work of a Sieve followed by a Distiller
+//! in a single pass over the labels.
 //
 class Distiller
 {
 //  -- instance variables --
 
     double _fadeTime, _gapTime;         // distillation parameters
+    unsigned int _numThreads;           // threads distilling labels, 0 for all cores
+    bool _sifting;                      // sift each label before distilling it
         
 //  -- public interface --
 public:
@@ -122,6 +128,36 @@ public:
      
     //  Use compiler-generated copy, assign, and destroy.
     
+//  -- parameters --
+
+    //! Return the number of threads used to distill Partials,
+    //! 0 for one per hardware core. Default is 1.
+    unsigned int numThreads( void ) const;
+    
+    //! Set the number of threads used to distill Partials, 0 for
+    //! one per hardware core. Partials having different labels are
+    //! distilled independently, so the distilled Partials do not 
+    //! depend on the number of threads. Default is 1.
+    void setNumThreads( unsigned int n );
+    
+    //! Return true if Partials are sifted before they are
+    //! distilled. Default is false.
+    bool sifting( void ) const;
+    
+    //! Set whether Partials are sifted before they are distilled.
+    //! When sifting, a Partial overlapping a longer Partial having
+    //! the same label (including the fade time at both ends and the
+    //! silent time between them) is not distilled, but unlabeled and
+    //! left at the end of the distilled Partials with the Partials 
+    //! that were not labeled. The Partials left labeled are joined
+    //! without merging or absorbing energy. The result is the same as
+    //! sifting with a Sieve having a fade time of the fade time plus
+    //! half the silent time and then distilling only the Partials left
+    //! labeled, but the Partials are grouped by label only once and 
+    //! each label is sifted by the thread that distills it. Default 
+    //! is false.
+    void setSifting( bool sift );
+    
 //  -- distillation --
 
     //! Distill labeled Partials in a collection leaving only a single 
@@ -226,9 +262,10 @@ private:
     //! into a single Partial with that label, and append it
     //! to the distilled collection. If an empty list of Partials
     //! is passed, then an empty Partial having the specified
-    //! label is appended.
+    //! label is appended. When sifting, Partials sifted out
+    //! are unlabeled and appended to sifted.
     void distillOne( PartialList & partials, Partial::label_type label,
-                     PartialList & distilled );
+                     PartialList & distilled, PartialList & sifted );
     
 };  //  end of class Distiller
 
@@ -295,7 +332,7 @@ template< >
 inline
 PartialList::iterator Distiller::distill( PartialList & partials )
 {
-    debugger << "using PartialList version of distill to avoid copying" << endl;
+    LORIS_DEBUGGER << "using PartialList version of distill to avoid copying" << endl;
     return distill_list( partials );
 }
 #else
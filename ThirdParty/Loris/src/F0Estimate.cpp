@@ -50,6 +50,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 #include <numeric>
 
 #include <vector>
@@ -117,6 +118,20 @@ static double
 evaluate_Qprime( const vector<double> & amps, 
                  const vector<double> & freqs, 
                  double eval_freq );
+
+static void
+order_peaks( const vector<double> & amps, 
+             const vector<double> & freqs, 
+             double norm,
+             F0Estimate::Workspace & workspace );
+
+static vector<double>::size_type
+scan_candidates( const vector<double> & amps, 
+                 const vector<double> & freqs, 
+                 const vector<double> & eval_freqs, 
+                 vector<double> & Q,
+                 double norm,
+                 const F0Estimate::Workspace & workspace );
          
 static void
 evaluate_Q( const vector<double> & amps, 
@@ -144,11 +159,15 @@ evaluate_Q( const vector<double> & amps,
 //
 //  See the F0Estimate.h for a description of the algorithm, also
 //  outlined inline below.
+//
+//  Candidates are kept in workspace if one is given, so that
+//  estimators can reuse its storage.
 
 F0Estimate::F0Estimate( const vector<double> & amps, 
                         const vector<double> & freqs, 
                         double fmin, double fmax,
-                        double resolution ) :
+                        double resolution,
+                        Workspace * workspace ) :
     m_frequency( 0 ), 
     m_confidence( 0 )
 {
@@ -159,6 +178,12 @@ F0Estimate::F0Estimate( const vector<double> & amps,
 	//	never consider DC (0 Hz) to be a valid fundamental
 	fmin = std::max( 1., fmin );
     
+    Workspace local;
+    if ( 0 == workspace )
+    {
+        workspace = &local;
+    }
+    
     // -------------------------------------------------------------------------    
     // 1)  Identify candidate F0s as the integer divisors of the sinusoidal 
     //     frequencies provided, within the specified range (this algorithm
@@ -169,7 +194,7 @@ F0Estimate::F0Estimate( const vector<double> & amps,
     //  First collect candidate frequencies: all integer 
     //  divisors of the peak frequencies that are between 
     //  fmin and fmax.
-    vector< double > eval_freqs;
+    vector< double > & eval_freqs = workspace->candidates;
     compute_candidate_freqs( freqs, fmin, fmax, eval_freqs );
 
     if ( ! eval_freqs.empty() )
@@ -186,8 +211,13 @@ F0Estimate::F0Estimate( const vector<double> & amps,
             1.0 / std::inner_product( amps.begin(), amps.end(), amps.begin(), 0.0 );
             
         //  Evaluate the likelihood function at the candidate frequencies.
-        vector < double > Q( eval_freqs.size() );
-        evaluate_Q( amps, freqs, eval_freqs, Q, normalization );
+        //  There are often thousands of them, so they are scanned with
+        //  an approximate cosine, peaks of most energy first, giving up
+        //  each candidate that can no longer be the most likely one
+        //  (see scan_candidates).
+        vector < double > & Q = workspace->likelihoods;
+        Q.resize( eval_freqs.size() );
+        order_peaks( amps, freqs, normalization, *workspace );
 
         // -------------------------------------------------------------------------    
         // 2)  Select the highest frequency candidate that nearly maximizes the 
@@ -199,7 +229,7 @@ F0Estimate::F0Estimate( const vector<double> & amps,
         //  (the most likely candidate).            
 
         vector<double>::size_type idx = 
-            std::max_element( Q.begin(), Q.end() ) - Q.begin();
+            scan_candidates( amps, freqs, eval_freqs, Q, normalization, *workspace );
         
         double bestFreq = eval_freqs[ idx ];
         double bestQ = Q[ idx ];
@@ -464,6 +494,175 @@ evaluate_Q( const vector<double> & amps,
 		++freq_it;
 	}
 }
+
+// ---------------------------------------------------------------------------
+//  --- fast scan of the candidates ---
+// ---------------------------------------------------------------------------
+
+//  Peaks are scanned in chunks of this many (a multiple of the four
+//  partial sums in scan_chunk), after each chunk the scan of a 
+//  candidate stops if the peaks left can not make it the most likely.
+const vector<double>::size_type ScanChunk = 16;
+
+//  Bound of the error of the likelihood computed using cos_turns
+//  (the normalized energies of the peaks sum to 1), with a wide margin.
+const double ScanTolerance = 1.e-7;
+
+//	cos_turns
+//
+//	Approximate the cosine of an angle in turns (cycles), non-negative
+//  and less than 2^31, with an error less than 1e-9. It has neither
+//  branches nor calls, so loops of it are vectorized by the compiler.
+
+static inline double
+cos_turns( double t )
+{
+    //  reduce the angle to r in [-1/2, 1/2] turn, then
+    //  cos(2 Pi r) = sin(2 Pi (1/4 - |r|)), an angle in [-Pi/2, Pi/2]
+    double r = t - double( int( t + 0.5 ) );
+    double x = 2 * Pi * ( 0.25 - std::abs( r ) );
+    double x2 = x * x;
+    
+    //  Taylor series of sin up to x^13
+    double p = 1. / 6227020800.;
+    p = 1. / 39916800. - x2 * p;
+    p = 1. / 362880. - x2 * p;
+    p = 1. / 5040. - x2 * p;
+    p = 1. / 120. - x2 * p;
+    p = 1. / 6. - x2 * p;
+    p = 1. - x2 * p;
+    return x * p;
+}
+
+//	scan_chunk
+//
+//	Return the approximate likelihood function summed over a chunk of
+//  peaks, given their normalized energies and frequencies, evaluated
+//  at the frequency whose reciprocal is specified.
+
+static inline double
+scan_chunk( const double * weights, const double * freqs, double inv_f0 )
+{
+    //  four partial sums, so that the compiler can keep them in
+    //  vector registers without reordering the sum
+    double sums[4] = { 0, 0, 0, 0 };
+    for ( vector<double>::size_type i = 0; i < ScanChunk; i += 4 )
+    {
+        for ( int k = 0; k < 4; ++k )
+        {
+            sums[k] += weights[i + k] * cos_turns( freqs[i + k] * inv_f0 );
+        }
+    }
+    return ( sums[0] + sums[1] ) + ( sums[2] + sums[3] );
+}
+
+//	order_peaks
+//
+//	Store the normalized energies and the frequencies of the peaks in 
+//  the workspace, ordered by decreasing energy and padded with silent
+//  peaks to a whole number of chunks, and the energy of the peaks 
+//  following each chunk.
+
+static void
+order_peaks( const vector<double> & amps, 
+             const vector<double> & freqs, 
+             double norm,
+             F0Estimate::Workspace & workspace )
+{
+	Assert( amps.size() == freqs.size() );
+    
+    vector< std::pair<double, double> > & peaks = workspace.peaks;
+    peaks.clear();
+    for ( vector<double>::size_type k = 0; k < amps.size(); ++k )
+    {
+        peaks.push_back( std::make_pair( amps[k] * amps[k] * norm, freqs[k] ) );
+    }
+    std::sort( peaks.begin(), peaks.end(), std::greater< std::pair<double, double> >() );
+    
+    const vector<double>::size_type nchunks = ( peaks.size() + ScanChunk - 1 ) / ScanChunk;
+    workspace.weights.assign( nchunks * ScanChunk, 0. );
+    workspace.frequencies.assign( nchunks * ScanChunk, 0. );
+    workspace.remaining.assign( nchunks, 0. );
+    for ( vector<double>::size_type k = 0; k < peaks.size(); ++k )
+    {
+        workspace.weights[k] = peaks[k].first;
+        workspace.frequencies[k] = peaks[k].second;
+    }
+    
+    double rest = 0;
+    for ( vector<double>::size_type c = nchunks; c-- > 0; )
+    {
+        workspace.remaining[c] = rest;
+        rest = std::accumulate( workspace.weights.begin() + c * ScanChunk,
+                                workspace.weights.begin() + ( c + 1 ) * ScanChunk,
+                                rest );
+    }
+}
+
+//	scan_candidates
+//
+//	Evaluate the likelihood function at the candidate frequencies
+//  using the peaks ordered by order_peaks, and return the index of
+//  the most likely candidate.
+//
+//  The likelihood is first summed using cos_turns, the scan of a 
+//  candidate stops when that sum plus the energy of the peaks left
+//  (the largest likelihood it can have) is less than the largest
+//  likelihood found so far, its entry in Q is then that bound. The
+//  candidates nearly as likely as the most likely one are evaluated
+//  exactly and the first of the most likely is returned, the same
+//  candidate as if all were evaluated exactly.
+
+static vector<double>::size_type
+scan_candidates( const vector<double> & amps, 
+                 const vector<double> & freqs, 
+                 const vector<double> & eval_freqs, 
+                 vector<double> & Q,
+                 double norm,
+                 const F0Estimate::Workspace & workspace )
+{
+	Assert( eval_freqs.size() == Q.size() );
+	Assert( ! workspace.remaining.empty() );
+    
+    const double * weights = workspace.weights.data();
+    const double * peak_freqs = workspace.frequencies.data();
+    const vector<double>::size_type nchunks = workspace.remaining.size();
+    
+    double Qmax = -DBL_MAX;
+    for ( vector<double>::size_type i = 0; i < eval_freqs.size(); ++i )
+    {
+        const double inv_f0 = 1. / eval_freqs[i];
+        double sum = 0, bound = 0;
+        vector<double>::size_type c = 0;
+        do
+        {
+            sum += scan_chunk( weights + c * ScanChunk, peak_freqs + c * ScanChunk, inv_f0 );
+            bound = sum + workspace.remaining[c];
+        } while ( ++c < nchunks && bound >= Qmax - ScanTolerance );
+        
+        Q[i] = bound;
+        Qmax = std::max( Qmax, bound );
+    }
+    
+    //  exact likelihoods of the candidates within the 
+    //  error of the scan from the most likely one
+    vector<double>::size_type best = 0;
+    double bestQ = -DBL_MAX;
+    for ( vector<double>::size_type i = 0; i < eval_freqs.size(); ++i )
+    {
+        if ( Q[i] >= Qmax - ScanTolerance )
+        {
+            Q[i] = evaluate_Q( amps, freqs, eval_freqs[i], norm );
+            if ( Q[i] > bestQ )
+            {
+                bestQ = Q[i];
+                best = i;
+            }
+        }
+    }
+    
+    return best;
+}
             
 // ---------------------------------------------------------------------------
 //  --- likelihood function derivative evaluation ---
@@ -39,6 +39,7 @@
  *
  */
 
+#include <utility>
 #include <vector>
 
 //	begin namespace
@@ -86,6 +87,20 @@ private:
 
 public:
 
+    //! Candidate frequencies and their likelihoods, and the peaks ordered
+    //! by energy for scanning the candidates, storage that can be kept 
+    //! from one estimate to the next, so that estimating allocates
+    //! nothing once it is large enough.
+    struct Workspace
+    {
+        std::vector<double> candidates;
+        std::vector<double> likelihoods;
+        std::vector< std::pair<double, double> > peaks;
+        std::vector<double> weights;
+        std::vector<double> frequencies;
+        std::vector<double> remaining;
+    };
+
     //  --- lifecycle ---
 
     //! Construct from parameters of the iterative F0 estimation 
@@ -98,11 +113,15 @@ public:
     //! likelihood function at that frequency (1.0 indicates that
     //! all the peaks are perfect harmonics of the estimated
     //! frequency).
+    //!
+    //! Candidates are kept in workspace if one is given (it is
+    //! overwritten), otherwise in storage of this estimate.
 
     F0Estimate( const std::vector<double> & amps, 
                 const std::vector<double> & freqs, 
                 double fmin, double fmax,
-                double resolution );
+                double resolution,
+                Workspace * workspace = 0 );
                 
     //  default copy/assign/destroy are OK
 
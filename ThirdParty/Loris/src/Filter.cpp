@@ -41,6 +41,7 @@
 #include "Filter.h"
 
 #include <algorithm>
+#include <complex>
 #include <numeric>
 #include <functional>
 
@@ -55,9 +56,11 @@ namespace Loris {
 Filter::Filter( void ) :
     m_ffwdcoefs( 1, 1.0 ),
     m_fbackcoefs( 1, 1.0 ),
-    m_delayline( 1, 0 ),
-    m_gain( 1.0 )
+    m_gain( 1.0 ),
+    m_head( 0 ),
+    m_cascadeGain( 1.0 )
 {
+    initialize();
 }
 
 // ---------------------------------------------------------------------------
@@ -70,10 +73,14 @@ Filter::Filter( const Filter & other ) :
     m_delayline( other.m_delayline.size(), 0. ),
     m_ffwdcoefs( other.m_ffwdcoefs ),
     m_fbackcoefs( other.m_fbackcoefs ),
-    m_gain( other.m_gain )
+    m_gain( other.m_gain ),
+    m_head( 0 ),
+    m_sections( other.m_sections ),
+    m_sectionState( other.m_sectionState.size(), 0. ),
+    m_cascadeGain( other.m_cascadeGain )
 {
-    Assert( m_delayline.size() >= m_ffwdcoefs.size() - 1 );
-    Assert( m_delayline.size() >= m_fbackcoefs.size() - 1 );
+    Assert( m_delayline.size() >= 2 * m_ffwdcoefs.size() );
+    Assert( m_delayline.size() >= 2 * m_fbackcoefs.size() );
 }
 
 // ---------------------------------------------------------------------------
@@ -88,14 +95,17 @@ Filter::operator=( const Filter & rhs )
     if ( &rhs != this )
     {
         m_delayline.resize( rhs.m_delayline.size() );
+        m_sectionState.resize( rhs.m_sectionState.size() );
         clear();
         
         m_ffwdcoefs = rhs.m_ffwdcoefs;
         m_fbackcoefs = rhs.m_fbackcoefs;
         m_gain = rhs.m_gain;
+        m_sections = rhs.m_sections;
+        m_cascadeGain = rhs.m_cascadeGain;
 
-        Assert( m_delayline.size() >= m_ffwdcoefs.size() - 1 );
-        Assert( m_delayline.size() >= m_fbackcoefs.size() - 1 );
+        Assert( m_delayline.size() >= 2 * m_ffwdcoefs.size() );
+        Assert( m_delayline.size() >= 2 * m_fbackcoefs.size() );
     }
     return *this;
 }
@@ -111,31 +121,494 @@ Filter::~Filter( void )
 {
 }
 
+//  --- factoring ---
+
+typedef std::complex< double > Complex;
 
 // ---------------------------------------------------------------------------
-//  apply
+//  findRoots
 // ---------------------------------------------------------------------------
-//! Compute a filtered sample from the next input sample.
-//!
+//  Find the roots of the polynomial in z with coefficients c (highest
+//  power first, c[0] is not 0) by Durand-Kerner iteration. Return false
+//  if the iteration does not converge.
 //
-double
-Filter::apply( double input )
+static bool findRoots( const std::vector< double > & c, std::vector< Complex > & roots )
+{
+    const std::size_t n = c.size() - 1;
+    roots.resize( n );
+    
+    //  the usual starting points, not on the real axis and not
+    //  symmetric to it
+    const Complex seed( 0.4, 0.9 );
+    Complex start( 1., 0. );
+    for ( std::size_t i = 0; i < n; ++i )
+    {
+        start *= seed;
+        roots[i] = start;
+    }
+    
+    for ( int iter = 0; iter < 1000; ++iter )
+    {
+        double change = 0.;
+        for ( std::size_t i = 0; i < n; ++i )
+        {
+            //  evaluate the monic polynomial at roots[i] (Horner)
+            Complex p( 1., 0. );
+            for ( std::size_t k = 1; k <= n; ++k )
+            {
+                p = p * roots[i] + c[k] / c[0];
+            }
+            
+            Complex q( 1., 0. );
+            for ( std::size_t j = 0; j < n; ++j )
+            {
+                if ( j != i )
+                {
+                    q *= roots[i] - roots[j];
+                }
+            }
+            if ( q == 0. )
+            {
+                return false;
+            }
+            
+            const Complex step = p / q;
+            roots[i] -= step;
+            change = std::max( change, std::abs( step ) / ( 1. + std::abs( roots[i] ) ) );
+        }
+        if ( change < 1e-15 )
+        {
+            return true;
+        }
+    }
+    
+    //  multiple roots converge slowly, accept what we have, the caller
+    //  checks the accuracy of the factors
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+//  refineMultipleRoots
+// ---------------------------------------------------------------------------
+//  Durand-Kerner finds a root of multiplicity m only to about the m-th
+//  root of the rounding error, as a cluster of m roots around it. Replace
+//  every cluster by m copies of the root of the (m-1)-th derivative of the
+//  polynomial near the cluster, which is a simple root and can be found
+//  accurately by Newton iteration.
+//
+static void refineMultipleRoots( const std::vector< double > & c, std::vector< Complex > & roots )
+{
+    const double radius = 1e-3;
+    std::vector< bool > done( roots.size(), false );
+    
+    for ( std::size_t i = 0; i < roots.size(); ++i )
+    {
+        if ( done[i] )
+        {
+            continue;
+        }
+        
+        std::vector< std::size_t > cluster( 1, i );
+        Complex centroid = roots[i];
+        for ( std::size_t j = i + 1; j < roots.size(); ++j )
+        {
+            if ( ! done[j] && std::abs( roots[j] - roots[i] ) < radius * ( 1. + std::abs( roots[i] ) ) )
+            {
+                cluster.push_back( j );
+                centroid += roots[j];
+            }
+        }
+        if ( cluster.size() == 1 )
+        {
+            continue;
+        }
+        centroid /= double( cluster.size() );
+        
+        //  coefficients of the (m-1)-th derivative, highest power first
+        std::vector< double > d( c );
+        for ( std::size_t m = 1; m < cluster.size(); ++m )
+        {
+            const std::size_t n = d.size() - 1;
+            for ( std::size_t k = 0; k < n; ++k )
+            {
+                d[k] *= double( n - k );
+            }
+            d.pop_back();
+        }
+        
+        Complex z = centroid;
+        for ( int iter = 0; iter < 50; ++iter )
+        {
+            Complex p( d[0], 0. ), dp( 0., 0. );
+            for ( std::size_t k = 1; k < d.size(); ++k )
+            {
+                dp = dp * z + p;
+                p = p * z + d[k];
+            }
+            if ( dp == 0. )
+            {
+                break;
+            }
+            const Complex step = p / dp;
+            z -= step;
+            if ( std::abs( step ) < 1e-16 * ( 1. + std::abs( z ) ) )
+            {
+                break;
+            }
+        }
+        
+        for ( std::size_t j = 0; j < cluster.size(); ++j )
+        {
+            roots[ cluster[j] ] = z;
+            done[ cluster[j] ] = true;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  quadraticFactors
+// ---------------------------------------------------------------------------
+//  Group roots in factors 1 + c1 z^-1 + c2 z^-2 with real coefficients:
+//  every complex root is paired with the root nearest to its conjugate
+//  (multiple roots are only found approximately, so the conjugate may be
+//  nearly real), the remaining real roots are paired in order, an odd
+//  real root is a first order factor (c2 is 0). Factors are stored as
+//  (c1, c2), imaginary parts of the products are dropped.
+//
+static void quadraticFactors( std::vector< Complex > roots,
+                              std::vector< std::pair< double, double > > & factors )
+{
+    const double tolerance = 1e-12;
+    factors.clear();
+    
+    while ( ! roots.empty() )
+    {
+        //  most complex root first
+        std::size_t i = 0;
+        for ( std::size_t j = 1; j < roots.size(); ++j )
+        {
+            if ( std::abs( roots[j].imag() ) > std::abs( roots[i].imag() ) )
+            {
+                i = j;
+            }
+        }
+        const Complex r = roots[i];
+        roots.erase( roots.begin() + i );
+        
+        if ( std::abs( r.imag() ) <= tolerance * ( 1. + std::abs( r ) ) || roots.empty() )
+        {
+            //  only real roots left, r is one of them
+            std::vector< double > reals( 1, r.real() );
+            for ( std::size_t j = 0; j < roots.size(); ++j )
+            {
+                reals.push_back( roots[j].real() );
+            }
+            roots.clear();
+            
+            std::sort( reals.begin(), reals.end() );
+            for ( std::size_t j = 0; j < reals.size(); j += 2 )
+            {
+                if ( j + 1 < reals.size() )
+                {
+                    factors.push_back( std::make_pair( -( reals[j] + reals[j+1] ), reals[j] * reals[j+1] ) );
+                }
+                else
+                {
+                    factors.push_back( std::make_pair( -reals[j], 0. ) );
+                }
+            }
+            break;
+        }
+        
+        std::size_t k = 0;
+        for ( std::size_t j = 1; j < roots.size(); ++j )
+        {
+            if ( std::abs( roots[j] - std::conj( r ) ) < std::abs( roots[k] - std::conj( r ) ) )
+            {
+                k = j;
+            }
+        }
+        const Complex s = roots[k];
+        roots.erase( roots.begin() + k );
+        factors.push_back( std::make_pair( -( r + s ).real(), ( r * s ).real() ) );
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  factorsMatch
+// ---------------------------------------------------------------------------
+//  Return true if the product of the factors is the polynomial in z^-1
+//  with coefficients c (lowest order first, c[0] is 1).
+//
+static bool factorsMatch( const std::vector< std::pair< double, double > > & factors,
+                          const std::vector< double > & c )
+{
+    std::vector< double > product( 1, 1. );
+    for ( std::size_t i = 0; i < factors.size(); ++i )
+    {
+        std::vector< double > next( product.size() + 2, 0. );
+        for ( std::size_t k = 0; k < product.size(); ++k )
+        {
+            next[k] += product[k];
+            next[k+1] += factors[i].first * product[k];
+            next[k+2] += factors[i].second * product[k];
+        }
+        product.swap( next );
+    }
+    
+    double largest = 1.;
+    for ( std::size_t k = 0; k < c.size(); ++k )
+    {
+        largest = std::max( largest, std::abs( c[k] ) );
+    }
+    for ( std::size_t k = 0; k < product.size(); ++k )
+    {
+        const double expected = k < c.size() ? c[k] : 0.;
+        if ( std::abs( product[k] - expected ) > 1e-9 * largest )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+//  factor
+// ---------------------------------------------------------------------------
+//  Factor the polynomial in z^-1 with coefficients c (lowest order first,
+//  c[0] is 1) into (c1, c2) pairs, see quadraticFactors. Trailing zero
+//  coefficients are dropped first. Return false if it cannot be done.
+//
+static bool factor( std::vector< double > c, std::vector< std::pair< double, double > > & factors )
+{
+    while ( c.size() > 1 && c.back() == 0. )
+    {
+        c.pop_back();
+    }
+    
+    factors.clear();
+    if ( c.size() == 1 )
+    {
+        return true;
+    }
+    
+    //  the roots of c[0] z^n + ... + c[n] are the roots in z of the
+    //  polynomial in z^-1
+    std::vector< Complex > roots;
+    if ( ! findRoots( c, roots ) )
+    {
+        return false;
+    }
+    refineMultipleRoots( c, roots );
+    quadraticFactors( roots, factors );
+    return factorsMatch( factors, c );
+}
+
+// ---------------------------------------------------------------------------
+//  initialize
+// ---------------------------------------------------------------------------
+//  Size the Direct-Form II ring buffer and factor the transfer function
+//  into second order sections. Zeros are paired with poles in the order
+//  of the poles' radius, so that the sections with the sharpest resonance
+//  come last. If the transfer function cannot be factored m_sections is
+//  left empty and the Direct-Form II is used.
+//
+void
+Filter::initialize( void )
+{
+    //  the current state and order older ones are needed
+    const std::size_t length = std::max( m_ffwdcoefs.size(), m_fbackcoefs.size() );
+    m_delayline.assign( 2 * length, 0. );
+    m_head = 0;
+    m_sections.clear();
+    m_sectionState.clear();
+    m_cascadeGain = m_gain;
+    
+    if ( m_ffwdcoefs.empty() || m_ffwdcoefs.front() == 0. )
+    {
+        return;
+    }
+    
+    std::vector< double > zeros( m_ffwdcoefs.size() );
+    std::transform( m_ffwdcoefs.begin(), m_ffwdcoefs.end(), zeros.begin(),
+                    std::bind2nd( std::divides<double>(), m_ffwdcoefs.front() ) );
+    
+    std::vector< std::pair< double, double > > zeroFactors, poleFactors;
+    if ( ! factor( zeros, zeroFactors ) || ! factor( m_fbackcoefs, poleFactors ) )
+    {
+        return;
+    }
+    
+    std::sort( poleFactors.begin(), poleFactors.end(),
+               []( const std::pair< double, double > & a, const std::pair< double, double > & b )
+               { return std::abs( a.second ) < std::abs( b.second ); } );
+    
+    const std::size_t count = std::max( std::max( zeroFactors.size(), poleFactors.size() ),
+                                        std::size_t( 1 ) );
+    for ( std::size_t i = 0; i < count; ++i )
+    {
+        Section section = { 0., 0., 0., 0. };
+        if ( i < zeroFactors.size() )
+        {
+            section.b1 = zeroFactors[i].first;
+            section.b2 = zeroFactors[i].second;
+        }
+        if ( i < poleFactors.size() )
+        {
+            section.a1 = poleFactors[i].first;
+            section.a2 = poleFactors[i].second;
+        }
+        m_sections.push_back( section );
+    }
+    m_sectionState.assign( 2 * m_sections.size(), 0. );
+    m_cascadeGain = m_gain * m_ffwdcoefs.front();
+}
+
+//  --- filtering ---
+
+// ---------------------------------------------------------------------------
+//  cascade
+// ---------------------------------------------------------------------------
+//  Filter a block of samples through NumSections sections in transposed
+//  Direct-Form II. The number of sections is a template parameter so that
+//  the section loop is unrolled and the states stay in registers.
+//
+template< int NumSections, typename SectionT, typename T >
+static void cascade( const SectionT * s, double * state, double gain,
+                     const T * in, T * out, int n )
+{
+    double z1[NumSections], z2[NumSections];
+    for ( int j = 0; j < NumSections; ++j )
+    {
+        z1[j] = state[2*j];
+        z2[j] = state[2*j+1];
+    }
+    
+    for ( int k = 0; k < n; ++k )
+    {
+        double x = gain * in[k];
+        for ( int j = 0; j < NumSections; ++j )
+        {
+            const double y = x + z1[j];
+            z1[j] = s[j].b1 * x - s[j].a1 * y + z2[j];
+            z2[j] = s[j].b2 * x - s[j].a2 * y;
+            x = y;
+        }
+        out[k] = (T) x;
+    }
+    
+    for ( int j = 0; j < NumSections; ++j )
+    {
+        state[2*j] = z1[j];
+        state[2*j+1] = z2[j];
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  processCascade
+// ---------------------------------------------------------------------------
+//  Filter a block of samples using the cascade of sections.
+//
+template< typename T >
+void
+Filter::processCascade( const T * in, T * out, int n )
+{
+    const Section * s = &m_sections[0];
+    double * state = &m_sectionState[0];
+    
+    switch ( m_sections.size() )
+    {
+        case 1: cascade< 1 >( s, state, m_cascadeGain, in, out, n ); break;
+        case 2: cascade< 2 >( s, state, m_cascadeGain, in, out, n ); break;
+        case 3: cascade< 3 >( s, state, m_cascadeGain, in, out, n ); break;
+        case 4: cascade< 4 >( s, state, m_cascadeGain, in, out, n ); break;
+        default:
+        {
+            //  high order, four sections at a time
+            cascade< 4 >( s, state, m_cascadeGain, in, out, n );
+            std::size_t j = 4;
+            for ( ; j + 4 <= m_sections.size(); j += 4 )
+                cascade< 4 >( s + j, state + 2 * j, 1., out, out, n );
+            for ( ; j < m_sections.size(); ++j )
+                cascade< 1 >( s + j, state + 2 * j, 1., out, out, n );
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  processDirect
+// ---------------------------------------------------------------------------
+//  Filter a block of samples using the Direct-Form II and the ring buffer.
+//
+template< typename T >
+void
+Filter::processDirect( const T * in, T * out, int n )
 { 
     // Implement the recurrence relation. m_ffwdcoefs holds the feed-forward
     // coefficients, m_fbackcoefs holds the feedback coeffs. The coefficient
     // vectors and delay lines are ordered by increasing age.
-
-    double wn = - std::inner_product( m_fbackcoefs.begin()+1, m_fbackcoefs.end(), 
-                                      m_delayline.begin(), -input );
-        //  negate input, then negate the inner product
-        
-    m_delayline.push_front( wn );
+    const std::size_t length = m_delayline.size() / 2;
     
-    double output = std::inner_product( m_ffwdcoefs.begin(), m_ffwdcoefs.end(), 
-                                        m_delayline.begin(), 0. );
-    m_delayline.pop_back();
+    for ( int k = 0; k < n; ++k )
+    {
+        const double * delay = &m_delayline[ m_head ];
+        double wn = - std::inner_product( m_fbackcoefs.begin()+1, m_fbackcoefs.end(), 
+                                          delay, - (double) in[k] );
+            //  negate input, then negate the inner product
+        
+        //  the oldest state is dropped, the new one goes in front, stored
+        //  twice so that the most recent states stay contiguous
+        m_head = ( m_head == 0 ? length : m_head ) - 1;
+        m_delayline[ m_head ] = m_delayline[ m_head + length ] = wn;
         
-    return output * m_gain;
+        double output = std::inner_product( m_ffwdcoefs.begin(), m_ffwdcoefs.end(), 
+                                            m_delayline.begin() + m_head, 0. );
+        out[k] = (T) ( output * m_gain );
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  process
+// ---------------------------------------------------------------------------
+//! Filter a block of samples. The output may be the same array as
+//! the input (filtering in place).
+//
+void
+Filter::process( const float * in, float * out, int n )
+{
+    if ( m_sections.empty() )
+        processDirect( in, out, n );
+    else
+        processCascade( in, out, n );
+}
+
+// ---------------------------------------------------------------------------
+//  process
+// ---------------------------------------------------------------------------
+//! Filter a block of samples. The output may be the same array as
+//! the input (filtering in place).
+//
+void
+Filter::process( const double * in, double * out, int n )
+{
+    if ( m_sections.empty() )
+        processDirect( in, out, n );
+    else
+        processCascade( in, out, n );
+}
+
+// ---------------------------------------------------------------------------
+//  apply
+// ---------------------------------------------------------------------------
+//! Compute a filtered sample from the next input sample.
+//!
+//
+double
+Filter::apply( double input )
+{ 
+    double output;
+    process( &input, &output, 1 );
+    return output;
 }
 
 //  --- access/mutation ---
@@ -192,6 +665,17 @@ Filter::denominator( void ) const
     return m_fbackcoefs;
 }
 
+// ---------------------------------------------------------------------------
+//  gain
+// ---------------------------------------------------------------------------
+//! Return the gain applied to the filtered signal.
+
+double 
+Filter::gain( void ) const
+{
+    return m_gain;
+}
+
 // ---------------------------------------------------------------------------
 //  clear
 // ---------------------------------------------------------------------------
@@ -201,6 +685,7 @@ void
 Filter::clear( void )
 {
     std::fill( m_delayline.begin(), m_delayline.end(), 0 );
+    std::fill( m_sectionState.begin(), m_sectionState.end(), 0 );
 }
 
 }   //  end of namespace Loris
@@ -40,7 +40,7 @@
 #include "Notifier.h"
 
 #include <algorithm>
-#include <deque>
+#include <cstddef>
 #include <vector>
 #include <functional>
 
@@ -68,11 +68,17 @@ namespace Loris {
 //! G is the additional filter gain, and is unity if unspecified.
 //!
 //!
-//! Filter is implemented using a std::deque to store the filter state, 
-//! and relies on the efficiency of that class. If deque is not implemented
-//! using some sort of circular buffer (as it should be -- deque is guaranteed
-//! to be efficient for repeated insertion and removal at both ends), then
-//! this filter class will be slow.
+//! The transfer function is factored into a cascade of second order
+//! sections (biquads) when the Filter is made, which is numerically better
+//! than the direct form for filters with poles close together, and faster:
+//! a cascade of up to four sections is unrolled and keeps its state in
+//! registers. If the transfer function cannot be factored (the leading
+//! feed-forward coefficient is zero, or the roots are not accurate
+//! enough), the Direct Form II is used, its delay line is a fixed-size
+//! ring buffer.
+//!
+//! Blocks of samples are filtered by process(), which is much cheaper than
+//! calling apply() for every sample.
 //
 class Filter
 {
@@ -141,6 +147,22 @@ public:
     //! \sa apply
     double operator() ( double input ) { return apply(input); }    
 
+    //! Filter a block of samples. The output may be the same array as
+    //! the input (filtering in place).
+    //!
+    //! \param in is the first of n input samples
+    //! \param out is where the n output samples are stored
+    //! \param n is the number of samples
+    void process( const float * in, float * out, int n );
+
+    //! Filter a block of samples. The output may be the same array as
+    //! the input (filtering in place).
+    //!
+    //! \param in is the first of n input samples
+    //! \param out is where the n output samples are stored
+    //! \param n is the number of samples
+    void process( const double * in, double * out, int n );
+
 //  --- access/mutation ---
 
 	//!	Provide access to the numerator (feed-forward) coefficients
@@ -167,6 +189,10 @@ public:
 	
 	const std::vector< double > denominator( void ) const;
 	
+	//!	Return the gain applied to the filtered signal.
+	
+	double gain( void ) const;
+	
     
     //! Clear the filter state. 
     void clear( void );
@@ -176,8 +202,10 @@ private:
     
 //  --- implementation ---
 
-    //! single delay line for Direct-Form II implementation
-    std::deque< double > m_delayline;
+    //! single delay line for Direct-Form II implementation, a ring
+    //! buffer storing every state twice, so that the order + 1 most recent
+    //! states always start at m_head (newest first)
+    std::vector< double > m_delayline;
         
     //! feed-forward coefficients
     std::vector< double > m_ffwdcoefs;  
@@ -188,6 +216,37 @@ private:
     //! filter gain (applied to output)
     double m_gain;      
 
+    //! newest state in m_delayline
+    std::size_t m_head;
+
+    //! second order section, 1 + b1 z^-1 + b2 z^-2 over 1 + a1 z^-1 + a2 z^-2,
+    //! first order sections have b2 and a2 equal to 0
+    struct Section
+    {
+        double b1, b2, a1, a2;
+    };
+
+    //! sections of the cascade form, empty if the Direct-Form II is used
+    std::vector< Section > m_sections;
+
+    //! two states of every section (transposed Direct-Form II)
+    std::vector< double > m_sectionState;
+
+    //! gain applied to the input of the cascade
+    double m_cascadeGain;
+
+    //! Size the delay line and factor the transfer function into
+    //! m_sections, called by the constructors.
+    void initialize( void );
+
+    //! Filter a block of samples using the Direct-Form II.
+    template< typename T >
+    void processDirect( const T * in, T * out, int n );
+
+    //! Filter a block of samples using the cascade of sections.
+    template< typename T >
+    void processCascade( const T * in, T * out, int n );
+
 };  //  end of class Filter
 
 
@@ -223,8 +282,9 @@ Filter::Filter( const double * ffwdbegin, const double * ffwdend, //    feed-for
 #endif
     m_ffwdcoefs( ffwdbegin, ffwdend ),
     m_fbackcoefs( fbackbegin, fbackend ),
-    m_delayline( std::max( ffwdend-ffwdbegin, fbackend-fbackbegin ) - 1, 0. ),
-    m_gain( gain )
+    m_gain( gain ),
+    m_head( 0 ),
+    m_cascadeGain( gain )
 {
     if ( *fbackbegin == 0. )
     {
@@ -243,6 +303,8 @@ Filter::Filter( const double * ffwdbegin, const double * ffwdend, //    feed-for
                         std::bind2nd( std::divides<double>(), *fbackbegin ) );
         m_fbackcoefs[0] = 1.;
     }
+
+    initialize();
 }
 
 
@@ -24,9 +24,10 @@
  *
  * Implementation of class Loris::FourierTransform, providing a simplified
  * uniform interface to the FFTW library (www.fftw.org), version 2.1.3
- * or newer (including version 3), or to the General Purpose FFT package
- * by Takuya OOURA, http://momonga.t.u-tokyo.ac.jp/~ooura/fft.html if
- * FFTW is unavailable. 
+ * or newer (including version 3), or if FFTW is unavailable, to vDSP
+ * (Accelerate framework) on Apple platforms and to the General Purpose 
+ * FFT package by Takuya OOURA, http://momonga.t.u-tokyo.ac.jp/~ooura/fft.html
+ * elsewhere. 
  *
  * Kelly Fitz, 2 Jun 2006
  * loris@cerlsoundgroup.org
@@ -44,8 +45,13 @@
 #include "LorisExceptions.h"
 #include "Notifier.h"
 
+#include <algorithm>
 #include <cmath>
 #include <complex>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #if defined(HAVE_M_PI) && (HAVE_M_PI)
 	const double Pi = M_PI;
@@ -141,11 +147,69 @@ using std::vector;
 
 #if defined(HAVE_FFTW3_H) && HAVE_FFTW3_H
 
+// ---------------------------------------------------------------------------
+//	plan cache (FFTW version 3)
+// ---------------------------------------------------------------------------
+//  Plans are made once per transform length and shared by all FTimpl 
+//  instances, which execute them on their own buffers using the FFTW
+//  new-array execute interface. Planning is far more expensive than 
+//  computing a transform (especially when measuring), and the FFTW
+//  planner is not thread-safe, so all planning (and wisdom import and
+//  export) is done under this lock. Plans are never destroyed.
+//
+static std::mutex & planMutex( void )
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+//  planner flags for plans made from now on, FFTW_ESTIMATE unless
+//  FourierTransform::setMeasurePlans() was called, guarded by planMutex:
+static unsigned int & planFlags( void )
+{
+    static unsigned int flags = FFTW_ESTIMATE;
+    return flags;
+}
+
+static fftw_plan sharedPlan( FourierTransform::size_type N )
+{
+    std::lock_guard< std::mutex > lock( planMutex() );
+    
+    static std::map< FourierTransform::size_type, fftw_plan > plans;
+    std::map< FourierTransform::size_type, fftw_plan >::iterator pos = plans.find( N );
+    if ( pos != plans.end() )
+    {
+        return pos->second;
+    }
+    
+    //  plan using scratch buffers (measuring overwrites them), 
+    //  fftw_malloc aligns all buffers in the same way, so the
+    //  plan can be executed on the buffers of any FTimpl:
+    fftw_complex * in = (fftw_complex *)fftw_malloc( sizeof( fftw_complex ) * N );
+    fftw_complex * out = (fftw_complex *)fftw_malloc( sizeof( fftw_complex ) * N );
+    fftw_plan plan = 0;
+    if ( 0 != in && 0 != out )
+    {
+        plan = fftw_plan_dft_1d( N, in, out, FFTW_FORWARD, planFlags() );
+    }
+    fftw_free( in );
+    fftw_free( out );
+    
+    //	verify:
+    if ( 0 == plan )
+    {
+        Throw( RuntimeError, "FourierTransform could not make a (fftw) plan." );
+    }
+    
+    plans[ N ] = plan;
+    return plan;
+}
+
 class FTimpl    //  FFTW version 3
 {
 private:
 
-	fftw_plan plan;
+	fftw_plan plan;         //  shared, see sharedPlan()
 	FourierTransform::size_type N;
 	fftw_complex * ftIn;   
 	fftw_complex * ftOut;
@@ -154,7 +218,7 @@ public:
    
 	// Construct an implementation instance:
 	// allocate an input buffer, and an output buffer
-	// and make a plan.
+	// and get the plan for this length.
 	FTimpl( FourierTransform::size_type sz ) : 
 	  plan( 0 ), N( sz ), ftIn( 0 ), ftOut( 0 ) 
 	{      
@@ -168,25 +232,23 @@ public:
 			throw RuntimeError( "cannot allocate Fourier transform buffers" );
 		}
 	  
-		//	create a plan:
-		plan = fftw_plan_dft_1d( N, ftIn, ftOut, FFTW_FORWARD, FFTW_ESTIMATE );
-
-		//	verify:
-		if ( 0 == plan )
+		//	get a plan:
+		try
 		{
-			Throw( RuntimeError, "FourierTransform could not make a (fftw) plan." );
+			plan = sharedPlan( N );
+		}
+		catch ( ... )
+		{
+			fftw_free( ftIn );
+			fftw_free( ftOut );
+			throw;
 		}
 	}
    
-	// Destroy the implementation instance:
-	// dump the plan.
+	// Destroy the implementation instance,
+	// the plan is shared and is kept.
 	~FTimpl( void )
 	{
-		if ( 0 != plan )
-		{
-            fftw_destroy_plan( plan );
-		}         
-		
 		fftw_free( ftIn );
 		fftw_free( ftOut );
 	}
@@ -217,7 +279,16 @@ public:
     // Compute a forward transform.
     void forward( void )
     {
-        fftw_execute( plan );
+        fftw_execute_dft( plan, ftIn, ftOut );
+    }
+
+    // Compute a forward transform of the N complex< double >'s
+    // in a buffer, replacing them by the transformed samples.
+    void transform( complex< double > * bufPtr )
+    {
+        loadInput( bufPtr );
+        forward();
+        copyOutput( bufPtr );
     }
     
 }; // end of class FTimpl for FFTW version 3
@@ -321,139 +392,308 @@ public:
     {
         fftw_one( plan, ftIn, ftOut );	
     }
+
+    // Compute a forward transform of the N complex< double >'s
+    // in a buffer, replacing them by the transformed samples.
+    void transform( complex< double > * bufPtr )
+    {
+        loadInput( bufPtr );
+        forward();
+        copyOutput( bufPtr );
+    }
     
 }; // end of class FTimpl for FFTW version 2
 
 #else
 
-#define SORRY_NO_FFTW  1
+//  Without FFTW, power of two transforms are computed by vDSP (part of 
+//  the Accelerate framework) on Apple platforms, unless LORIS_NO_ACCELERATE
+//  is defined, and by the General Purpose FFT Package by Takuya OOURA, 
+//  http://momonga.t.u-tokyo.ac.jp/~ooura/fft.html defined in fftsg.c, 
+//  elsewhere. Transforms of other lengths are computed from power of two 
+//  transforms by Bluestein's algorithm (see FTimpl below).
 
-//  function prototype, definition in fftsg.c
-extern "C" void cdft(int, int, double *, int *, double *);
+#if defined(__APPLE__) && ! defined(LORIS_NO_ACCELERATE)
+    #define LORIS_USE_VDSP  1
+    #include <Accelerate/Accelerate.h>
+#endif
 
-//  function prototype, definition below
-static void slowDFT( double * in, double * out, int N );
+#if defined(LORIS_USE_VDSP) && LORIS_USE_VDSP
 
-//  Uses General Purpose FFT (Fast Fourier/Cosine/Sine Transform) Package
-//  by Takuya OOURA, http://momonga.t.u-tokyo.ac.jp/~ooura/fft.html defined
-//  in fftsg.c.
+// ---------------------------------------------------------------------------
+//	FFT setup cache (vDSP version)
+// ---------------------------------------------------------------------------
+//  vDSP setups (twiddle factors) depend only on the length of the 
+//  transform, so they are made once per length and shared by all 
+//  PO2Transform instances, vDSP only reads them when transforming,
+//  so they can be used by many threads at once. Setups are never
+//  destroyed.
 //
-//  In the event that the size is not a power of two, uses a (very) slow
-//  direct DFT computation, defined below. In this case, the workspace
-//  array is not used, and the twiddle factor array is used to store the
-//  transform result.
+static FFTSetupD sharedSetup( int expon )
+{
+    static std::mutex mutex;
+    std::lock_guard< std::mutex > lock( mutex );
+    
+    static std::map< int, FFTSetupD > setups;
+    FFTSetupD & setup = setups[ expon ];
+    if ( 0 == setup )
+    {
+        setup = vDSP_create_fftsetupD( expon, kFFTRadix2 );
+        if ( 0 == setup )
+        {
+            Throw( RuntimeError, "FourierTransform could not make a (vDSP) setup." );
+        }
+    }
+    return setup;
+}
 
-class FTimpl    //  platform-neutral stand-alone implementation
+// ---------------------------------------------------------------------------
+//  PO2Transform (vDSP version)
+// ---------------------------------------------------------------------------
+//  Forward transform of a power of two length. vDSP transforms split
+//  complex data, so the interleaved samples are copied into separate
+//  real and imaginary buffers and back.
+//
+class PO2Transform
 {
 private:
 
-	double * mTxInOut;      //	input/output buffer for in-place transform                                
-	double * mTwiddle;      //	storage for twiddle factors
-	int * mWorkspace;		//	workspace storage
+	FFTSetupD mSetup;               //	shared setup
+	int mExpon;                     //	log2 of the length
+	std::vector< double > mReal;    //	split complex samples
+	std::vector< double > mImag;
 
-	FourierTransform::size_type N;
+public:
+
+	PO2Transform( FourierTransform::size_type N ) : 
+	  mSetup( 0 ), mExpon( 0 ), mReal( N ), mImag( N )
+	{
+	    isPO2( N, &mExpon );
+	    mSetup = sharedSetup( mExpon );
+	}
+	
+    // Compute a forward transform of the N interleaved complex
+    // samples in data, replacing them by the transformed samples.
+    void transform( double * data )
+    {
+        DSPDoubleSplitComplex split = { &mReal.front(), &mImag.front() };
+        DSPDoubleComplex * interleaved = reinterpret_cast< DSPDoubleComplex * >( data );
+        vDSP_ctozD( interleaved, 2, &split, 1, mReal.size() );
+        vDSP_fft_zipD( mSetup, &split, 1, mExpon, kFFTDirection_Forward );
+        vDSP_ztocD( &split, 1, interleaved, 2, mReal.size() );
+    }
+
+}; // end of class PO2Transform for vDSP
+
+#else
+
+//  function prototype, definition in fftsg.c
+extern "C" void cdft(int, int, double *, int *, double *);
+
+// ---------------------------------------------------------------------------
+//	twiddle factor cache (stand-alone version)
+// ---------------------------------------------------------------------------
+//  The twiddle factors and bit reversal workspace of a power of two 
+//  transform depend only on its length, so they are computed once per
+//  length and shared by all PO2Transform instances. cdft computes them 
+//  on its first call and only reads them afterwards, so they are 
+//  initialized here, under a lock, and can then be used by many threads
+//  at once. The tables are never destroyed.
+//
+struct FTtables
+{
+	std::vector< double > twiddle;  //	twiddle factors
+	std::vector< int > workspace;   //	bit reversal workspace
+};
+
+static FTtables & sharedTables( FourierTransform::size_type N )
+{
+    static std::mutex mutex;
+    std::lock_guard< std::mutex > lock( mutex );
     
-    bool mIsPO2;
-   
+    static std::map< FourierTransform::size_type, std::unique_ptr< FTtables > > tables;
+    std::unique_ptr< FTtables > & t = tables[ N ];
+    if ( ! t )
+    {
+        t.reset( new FTtables );
+        t->twiddle.resize( std::max< FourierTransform::size_type >( N/2, 1 ) );
+        t->workspace.resize( 2*int( std::sqrt((double)N) + 0.5 ) );
+        t->workspace[0] = 0;    // triggers setup
+        
+        std::vector< double > scratch( 2*N, 0. );
+        cdft( 2*N, -1, &scratch.front(), &t->workspace.front(), &t->twiddle.front() );
+    }
+    return *t;
+}
+
+// ---------------------------------------------------------------------------
+//  PO2Transform (stand-alone version)
+// ---------------------------------------------------------------------------
+//  Forward transform of a power of two length. std::complex< double > 
+//  is stored as a pair of doubles (real, imaginary), exactly like the 
+//  interleaved array expected by cdft, so the transform is computed 
+//  in-place.
+//
+class PO2Transform
+{
+private:
+
+	double * mTwiddle;      //	shared twiddle factors
+	int * mWorkspace;		//	shared workspace
+	
+	FourierTransform::size_type N;
+
 public:
 
-	// Construct an implementation instance:
-	// allocate buffers and workspace, and
-	// initialize the twiddle factors.
-	FTimpl( FourierTransform::size_type sz ) : 
-	  mTxInOut( 0 ), mTwiddle( 0 ), mWorkspace( 0 ), N( sz ), mIsPO2( isPO2( sz ) )
+	PO2Transform( FourierTransform::size_type sz ) : 
+	  mTwiddle( 0 ), mWorkspace( 0 ), N( sz )
 	{      
-        mTxInOut = new double[ 2*N ]; 	
-            //	input/output buffer for in-place transform
+        FTtables & tables = sharedTables( N );
+        mTwiddle = &tables.twiddle.front();
+        mWorkspace = &tables.workspace.front();
+	}
+	
+    // Compute a forward transform of the N interleaved complex
+    // samples in data, replacing them by the transformed samples.
+    void transform( double * data )
+    {
+        cdft( 2*N, -1, data, mWorkspace, mTwiddle );
+    }
+
+}; // end of class PO2Transform for cdft
+
+#endif
+
+// ---------------------------------------------------------------------------
+//	chirp cache (Bluestein's algorithm)
+// ---------------------------------------------------------------------------
+//  A transform of length N is the convolution of the samples multiplied
+//  by the chirp exp(-i pi n^2 / N) with the conjugate chirp, multiplied 
+//  by the chirp again. The convolution is circular over a power of two 
+//  length M >= 2N - 1, computed by power of two transforms, so the cost
+//  is O(M log M) instead of the O(N^2) of a direct DFT. The chirp and the
+//  transform of the conjugate chirp (scaled by 1/M, the scale of the 
+//  inverse transform) depend only on N, they are computed once per length
+//  and shared. They are never destroyed.
+//
+struct ChirpTables
+{
+    FourierTransform::size_type M;              //  length of the convolution
+	std::vector< complex< double > > chirp;     //	N chirp samples
+	std::vector< complex< double > > filter;    //	M samples of the transformed
+	                                            //  conjugate chirp, scaled
+};
+
+static FourierTransform::size_type bluesteinLength( FourierTransform::size_type N )
+{
+    FourierTransform::size_type M = 1;
+    while ( M < 2*N - 1 )
+    {
+        M *= 2;
+    }
+    return M;
+}
+
+static ChirpTables & sharedChirps( FourierTransform::size_type N )
+{
+    static std::mutex mutex;
+    std::lock_guard< std::mutex > lock( mutex );
+    
+    static std::map< FourierTransform::size_type, std::unique_ptr< ChirpTables > > tables;
+    std::unique_ptr< ChirpTables > & t = tables[ N ];
+    if ( ! t )
+    {
+        t.reset( new ChirpTables );
+        t->M = bluesteinLength( N );
+        t->chirp.resize( N );
+        t->filter.assign( t->M, 0. );
+        for ( FourierTransform::size_type n = 0; n < N; ++n )
+        {
+            //  n^2 is reduced modulo 2N, the chirp is periodic in it,
+            //  so the angle stays accurate for long transforms
+            const unsigned long long n2 = ( (unsigned long long) n * n ) % ( 2 * N );
+            t->chirp[ n ] = std::polar( 1.0, -Pi * n2 / N );
             
-        if ( mIsPO2 )
-        {    
-            mTwiddle = new double[ N/2 ]; 		
-                //	storage for twiddle factors
-                
-            mWorkspace = new int[ 2*int( std::sqrt((double)N) + 0.5 ) ];		
-                //	workspace 
-                
-            if ( 0 == mTxInOut || 0 == mTwiddle || 0 == mWorkspace )
+            t->filter[ n ] = std::conj( t->chirp[ n ] );
+            if ( n > 0 )
             {
-                delete [] mTxInOut;
-                delete [] mTwiddle;
-                delete [] mWorkspace;
-                Throw( RuntimeError, "FourierTransform: could not initialize tranform" );
+                t->filter[ t->M - n ] = t->filter[ n ];
             }
-
-            mWorkspace[0] = 0;  // first time only, triggers setup    
-                                // no need to do it now, it will happen the 
-                                // first time a transform is computed
-            // cdft_double( 2*N, -1, mTxInOut, mWorkspace, mTwiddle );
         }
-        else
+        
+        PO2Transform ft( t->M );
+        ft.transform( reinterpret_cast< double * >( &t->filter.front() ) );
+        const double scale = 1. / t->M;
+        for ( complex< double > & f : t->filter )
         {
-            mTwiddle = new double[ 2*N ]; 	
-                //	use for result in slowDFT 
-                
-            if ( 0 == mTxInOut || 0 == mTwiddle )
-            {
-                delete [] mTxInOut;
-                delete [] mTwiddle;
-                Throw( RuntimeError, "FourierTransform: could not initialize tranform" );
-            }
+            f *= scale;
         }
-	}
-   
-	// Destroy the implementation instance:
-	~FTimpl( void )
-	{
-        delete [] mTxInOut;
-        delete [] mTwiddle;
-        delete [] mWorkspace;
-	}
+    }
+    return *t;
+}
+
+class FTimpl    //  stand-alone implementation, vDSP or cdft
+{
+private:
+
+	PO2Transform mTransform;        //  of N, or of the convolution length
 	
-	// Copy complex< double >'s from a buffer into ftIn, 
-	// the buffer must be as long as ftIn.
-	void loadInput( const complex< double > * bufPtr )
-	{
-		for ( FourierTransform::size_type k = 0; k < N; ++k )
-		{
-			mTxInOut[ 2*k ] = bufPtr->real();
-			mTxInOut[ 2*k+1 ] = bufPtr->imag();
-			++bufPtr;
-		}
-	}
+	const ChirpTables * mChirps;    //  shared chirps, 0 if N is a power of two
+	std::vector< complex< double > > mConvolution;  //  convolution buffer
+	
+	FourierTransform::size_type N;
    
-	//  Copy complex< double >'s from ftOut into a buffer,
-	//  which must be as long as ftOut. Result might be
-    //  stored in the twiddle factor array if this is not
-    //  power of two length DFT.
-	void copyOutput( complex< double > * bufPtr ) const
-	{
-        double * result = mTxInOut;
-        if ( !mIsPO2 )
+public:
+
+	// Construct an implementation instance:
+	// get the shared tables for this length.
+	FTimpl( FourierTransform::size_type sz ) : 
+	  mTransform( isPO2( sz ) ? sz : bluesteinLength( sz ) ), 
+	  mChirps( isPO2( sz ) ? 0 : &sharedChirps( sz ) ), 
+	  N( sz )
+	{      
+        if ( 0 != mChirps )
         {
-            result = mTwiddle;
+            mConvolution.resize( mChirps->M );
         }
-
-		for ( FourierTransform::size_type k = 0; k < N; ++k )
-		{
-			*bufPtr = complex< double >( result[ 2*k ], result[ 2*k+1 ] );
-			++bufPtr;
-		}
 	}
-    
-    // Compute a forward transform.
-    void forward( void )
+	
+    // Compute a forward transform of the N complex< double >'s
+    // in a buffer, replacing them by the transformed samples.
+    void transform( complex< double > * bufPtr )
     {        
-        if ( mIsPO2 )
+        if ( 0 == mChirps )
         {
-            cdft( 2*N, -1, mTxInOut, mWorkspace, mTwiddle );
+            mTransform.transform( reinterpret_cast< double * >( bufPtr ) );
+            return;
         }
-        else
+        
+        //  chirped samples, zero padded:
+        const complex< double > * chirp = &mChirps->chirp.front();
+        for ( FourierTransform::size_type n = 0; n < N; ++n )
         {
-            slowDFT( mTxInOut, mTwiddle, N );
+            mConvolution[ n ] = bufPtr[ n ] * chirp[ n ];
+        }
+        std::fill( mConvolution.begin() + N, mConvolution.end(), 0. );
+        
+        //  convolve with the conjugate chirp, the inverse transform 
+        //  is the forward transform of the conjugate:
+        double * data = reinterpret_cast< double * >( &mConvolution.front() );
+        mTransform.transform( data );
+        const complex< double > * filter = &mChirps->filter.front();
+        for ( FourierTransform::size_type m = 0; m < mChirps->M; ++m )
+        {
+            mConvolution[ m ] = std::conj( mConvolution[ m ] * filter[ m ] );
+        }
+        mTransform.transform( data );
+        
+        for ( FourierTransform::size_type n = 0; n < N; ++n )
+        {
+            bufPtr[ n ] = std::conj( mConvolution[ n ] ) * chirp[ n ];
         }
     }
     
-}; // end of class platform-neutral stand-alone FTimpl 
+}; // end of class stand-alone FTimpl 
 
 #endif
 
@@ -554,89 +794,137 @@ FourierTransform::size( void ) const
 void
 FourierTransform::transform( void )
 {
-    // copy data into the transform input buffer:
-    _impl->loadInput( &_buffer.front() );
-    
     //	crunch:	
-    _impl->forward();
-    
-    // copy the data out of the transform output buffer:
-    _impl->copyOutput( &_buffer.front() );
+    _impl->transform( &_buffer.front() );
 }
 
 
-// --- slow non-power-of-two DFT implementation ---
-
-#if defined(SORRY_NO_FFTW) 
+// ---------------------------------------------------------------------------
+//	backend
+// ---------------------------------------------------------------------------
+//! Return the name of the library computing the transforms, chosen
+//! when Loris is built: "FFTW 3", "FFTW 2", "vDSP" or "Ooura".
+//
+const char *
+FourierTransform::backend( void )
+{
+#if defined(HAVE_FFTW3_H) && HAVE_FFTW3_H
+    return "FFTW 3";
+#elif defined(HAVE_FFTW_H) && HAVE_FFTW_H
+    return "FFTW 2";
+#elif defined(LORIS_USE_VDSP) && LORIS_USE_VDSP
+    return "vDSP";
+#else
+    return "Ooura";
+#endif
+}
 
 // ---------------------------------------------------------------------------
-//	slowDFT
+//	fastLength
 // ---------------------------------------------------------------------------
-//  Non-power-of-two DFT implementation. in and out cannot be the same,
-//  and each is 2*N long, storing interleaved complex numbers.
-//  This version is only used when FFTW is unavailable.
+//! Return the smallest transform length, not less than minLength,
+//! that the backend transforms fast. FFTW is fast for lengths with 
+//! no prime factor greater than 7, the other backends only for
+//! powers of two (other lengths are computed by Bluestein's 
+//! algorithm, using three transforms of twice the length).
+//!
+//! \param  minLength is the shortest acceptable length
+//! \return the fast length
 //
-static
-void slowDFT( double * in, double * out, int N )
+FourierTransform::size_type
+FourierTransform::fastLength( size_type minLength )
 {
-#if 1 
-    // slow DFT 
-    // This version of the direct DFT computation is tolerably
-    // speedy, even for rather long transforms (like 8k).
-    // There is only one expensive call to std::polar, and
-    // twiddle factors are updated by multiplying. This
-    // causes some loss in numerical accuracy, worse for
-    // longer transforms, but even for 10k long transforms,
-    // accuracy is within hundredths of a percent in my experiments.
-    
-    const std::complex< double > eminj2pioN = 
-        std::polar( 1.0, -2.0 * Pi / N );
-              
-    std::complex< double > Wn = 1;
-    for ( int n = 0; n < N; ++n )
+    size_type po2 = 1;
+    while ( po2 < minLength )
     {
-        std::complex< double > Wkn = 1;
-        std::complex< double > Xkn = 0;
-        for ( int k = 0; k < N; ++k )
-        {
-            Xkn += std::complex< double >( in[ 2*k ], in[ 2*k+1 ] ) * Wkn;
-            Wkn *= Wn;
-        }
-        
-        out[ 2*n ] = Xkn.real();
-        out[ 2*n+1 ] = Xkn.imag();
-        Wn *= eminj2pioN;
+        po2 *= 2;
     }
-
-#else 
-    // very, very slow
-    // This version of the direct DFT computation is slightly
-    // more accurate, increasingly so for longer transforms, 
-    // but it is so much slower (4-5x) that the small improvement
-    // in accuracy is probably not worth the extra wait. For
-    // short transforms, the accuracy of both algorithms is
-    // very high, and for long transforms, this algorithm is
-    // too slow.
-    //
-    // Both algorithms are retained here, so that this 
-    // tradeoff can be re-evaluated if necessary.
-
-    for ( int n = 0; n < N; ++n )
+    
+#if (defined(HAVE_FFTW3_H) && HAVE_FFTW3_H) || (defined(HAVE_FFTW_H) && HAVE_FFTW_H)
+    //  search the 7-smooth lengths below the power of two
+    size_type best = po2;
+    for ( size_type p7 = 1; p7 < best; p7 *= 7 )
     {
-        std::complex< double > Xkn = 0;
-        for ( int k = 0; k < N; ++k )
+        for ( size_type p5 = p7; p5 < best; p5 *= 5 )
         {
-            std::complex< double > Wkn = std::polar( 1.0, -2.0 * Pi * k * n / N );
-            Xkn += std::complex< double >( in[ 2*k ], in[ 2*k+1 ] ) * Wkn;
+            for ( size_type p3 = p5; p3 < best; p3 *= 3 )
+            {
+                size_type len = p3;
+                while ( len < minLength )
+                {
+                    len *= 2;
+                }
+                best = std::min( best, len );
+            }
         }
-        
-        out[ 2*n ] = Xkn.real();
-        out[ 2*n+1 ] = Xkn.imag();
     }
-    
-#endif    
+    return best;
+#else
+    return po2;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+//	setMeasurePlans
+// ---------------------------------------------------------------------------
+//! Make FFTW measure candidate plans for transform lengths that 
+//! are planned after this call, instead of estimating them. Planning
+//! takes much longer, but the transforms may be faster. Has no
+//! effect unless Loris is built with FFTW 3.
+//!
+//! \param  measure is true to measure, false to estimate (the default)
+//
+void
+FourierTransform::setMeasurePlans( bool measure )
+{
+#if defined(HAVE_FFTW3_H) && HAVE_FFTW3_H
+    std::lock_guard< std::mutex > lock( planMutex() );
+    planFlags() = measure ? FFTW_MEASURE : FFTW_ESTIMATE;
+#else
+    (void) measure;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+//	importWisdom
+// ---------------------------------------------------------------------------
+//! Import FFTW wisdom (previously measured plans) from a file.
+//!
+//! \param  path is the name of the wisdom file
+//! \return true if the wisdom was imported, false if the file could
+//!         not be read, or Loris is not built with FFTW 3.
+//
+bool
+FourierTransform::importWisdom( const std::string & path )
+{
+#if defined(HAVE_FFTW3_H) && HAVE_FFTW3_H
+    std::lock_guard< std::mutex > lock( planMutex() );
+    return 0 != fftw_import_wisdom_from_filename( path.c_str() );
+#else
+    (void) path;
+    return false;
+#endif
 }
 
-#endif  //  defined(SORRY_NO_FFTW)
+// ---------------------------------------------------------------------------
+//	exportWisdom
+// ---------------------------------------------------------------------------
+//! Export FFTW wisdom (plans measured so far) to a file.
+//!
+//! \param  path is the name of the wisdom file
+//! \return true if the wisdom was exported, false if the file could
+//!         not be written, or Loris is not built with FFTW 3.
+//
+bool
+FourierTransform::exportWisdom( const std::string & path )
+{
+#if defined(HAVE_FFTW3_H) && HAVE_FFTW3_H
+    std::lock_guard< std::mutex > lock( planMutex() );
+    return 0 != fftw_export_wisdom_to_filename( path.c_str() );
+#else
+    (void) path;
+    return false;
+#endif
+}
 
 }	//	end of namespace Loris
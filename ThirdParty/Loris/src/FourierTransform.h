@@ -26,9 +26,10 @@
  *
  * Definition of class Loris::FourierTransform, providing a simplified
  * uniform interface to the FFTW library (www.fftw.org), version 2.1.3
- * or newer (including version 3), or to the General Purpose FFT package
- * by Takuya OOURA, http://momonga.t.u-tokyo.ac.jp/~ooura/fft.html if
- * FFTW is unavailable. 
+ * or newer (including version 3), or if FFTW is unavailable, to vDSP
+ * (Accelerate framework) on Apple platforms and to the General Purpose 
+ * FFT package by Takuya OOURA, http://momonga.t.u-tokyo.ac.jp/~ooura/fft.html
+ * elsewhere. 
  *
  * Kelly Fitz, 2 Jun 2006
  * loris@cerlsoundgroup.org
@@ -37,6 +38,7 @@
  *
  */
 #include <complex>
+#include <string>
 #include <vector>
 
 //	begin namespace
@@ -61,12 +63,18 @@ class FTimpl;
 //! arithmetic operations. 
 //!
 //! Supports FFTW versions 2 and 3.
-//! Does not make use of FFTW "wisdom" to speed up transform computation.
+//! With FFTW 3, plans are made once per transform length and shared
+//! by all instances. Plans can be measured instead of estimated, and
+//! FFTW "wisdom" can be imported and exported to keep measured plans
+//! across runs.
 //!
-//! If FFTW is unavailable, uses instead the General Purpose FFT package
-//! by Takuya OOURA, http://momonga.t.u-tokyo.ac.jp/~ooura/fft.html defined
-//! in fftsg.c for power-of-two transforms, and a very slow direct DFT
-//! implementation for non-PO2 transforms. 
+//! If FFTW is unavailable, power-of-two transforms are computed by vDSP
+//! (Accelerate framework) on Apple platforms (unless LORIS_NO_ACCELERATE
+//! is defined), and elsewhere by the General Purpose FFT package by 
+//! Takuya OOURA, http://momonga.t.u-tokyo.ac.jp/~ooura/fft.html defined
+//! in fftsg.c. Their twiddle factors are computed once per transform 
+//! length and shared. Transforms of other lengths are computed from 
+//! power-of-two transforms by Bluestein's algorithm, in O(N log N).
 //
 class FourierTransform 
 {
@@ -202,6 +210,44 @@ public:
     //! 
     //! \return the length of the transform in samples.
     size_type size( void ) const ;
+
+//	--- planning ---
+
+    //! Return the name of the library computing the transforms, chosen
+    //! when Loris is built: "FFTW 3", "FFTW 2", "vDSP" or "Ooura".
+    static const char * backend( void );
+
+    //! Return the smallest transform length, not less than minLength,
+    //! that the backend transforms fast. FFTW is fast for lengths with 
+    //! no prime factor greater than 7, the other backends only for
+    //! powers of two (other lengths are computed by Bluestein's 
+    //! algorithm, using three transforms of twice the length).
+    //!
+    //! \param  minLength is the shortest acceptable length
+    //! \return the fast length
+    static size_type fastLength( size_type minLength );
+
+    //! Make FFTW measure candidate plans for transform lengths that 
+    //! are planned after this call, instead of estimating them. Planning
+    //! takes much longer, but the transforms may be faster. Has no
+    //! effect unless Loris is built with FFTW 3.
+    //!
+    //! \param  measure is true to measure, false to estimate (the default)
+    static void setMeasurePlans( bool measure );
+
+    //! Import FFTW wisdom (previously measured plans) from a file.
+    //!
+    //! \param  path is the name of the wisdom file
+    //! \return true if the wisdom was imported, false if the file could
+    //!         not be read, or Loris is not built with FFTW 3.
+    static bool importWisdom( const std::string & path );
+
+    //! Export FFTW wisdom (plans measured so far) to a file.
+    //!
+    //! \param  path is the name of the wisdom file
+    //! \return true if the wisdom was exported, false if the file could
+    //!         not be written, or Loris is not built with FFTW 3.
+    static bool exportWisdom( const std::string & path );
                 
 //	-- instance variables --
 private:
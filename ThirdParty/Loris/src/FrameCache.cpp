@@ -0,0 +1,99 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * FrameCache.C
+ *
+ * Implementation of class Loris::FrameCache, the Peaks selected from the
+ * spectra of short-time frames, kept by an Analyzer for the next analysis
+ * of the same sound.
+ *
+ */
+#if HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include "FrameCache.h"
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  FrameCache constructor
+// ---------------------------------------------------------------------------
+FrameCache::FrameCache( void ) :
+    m_origin( 0 )
+{
+}
+
+// ---------------------------------------------------------------------------
+//  clear
+// ---------------------------------------------------------------------------
+//! Remove all frames.
+void FrameCache::clear( void )
+{
+    m_frames.clear();
+}
+
+// ---------------------------------------------------------------------------
+//  configure
+// ---------------------------------------------------------------------------
+//! Drop all the frames if they were selected with other settings.
+//!
+//! \param  settings the parameters of an analysis the selected Peaks
+//!         of its frames depend on
+void FrameCache::configure( const std::vector< double > & settings )
+{
+    if ( settings != m_settings )
+    {
+        m_frames.clear();
+        m_settings = settings;
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  find
+// ---------------------------------------------------------------------------
+//! Return the Peaks of the frame centered at a position of the sound,
+//! or 0 if it is not cached. Safe to call from many threads while no
+//! frame is stored.
+//!
+//! \param  position center of the frame in samples of the sound
+const Peaks * FrameCache::find( long position ) const
+{
+    std::unordered_map< long, Peaks >::const_iterator it = m_frames.find( position );
+    return it != m_frames.end() ? &it->second : 0;
+}
+
+// ---------------------------------------------------------------------------
+//  store
+// ---------------------------------------------------------------------------
+//! Store the Peaks selected from a frame, replacing the frame at the
+//! position.
+//!
+//! \param  position center of the frame in samples of the sound
+//! \param  peaks Peaks selected from the spectrum of the frame, times
+//!         relative to it
+void FrameCache::store( long position, const Peaks & peaks )
+{
+    m_frames[ position ] = peaks;
+}
+
+}	//	end of namespace Loris
@@ -0,0 +1,117 @@
+#ifndef INCLUDE_FRAME_CACHE_H
+#define INCLUDE_FRAME_CACHE_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * FrameCache.h
+ *
+ * Definition of class Loris::FrameCache, the Peaks selected from the
+ * spectra of short-time frames, kept by an Analyzer for the next analysis
+ * of the same sound.
+ *
+ */
+
+#include "SpectralPeaks.h"
+
+#include <unordered_map>
+#include <vector>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	class FrameCache
+//
+//! Peaks selected from the reassigned spectra of the short-time frames
+//! of a sound (before they are thinned), kept by an Analyzer for the
+//! next analysis of the same sound. The stages after the transform are
+//! run again for every frame found: thinning, bandwidth and Partial
+//! formation. So an analysis changing only their parameters (amplitude
+//! floor, frequency resolution and drift, bandwidth) transforms no frame.
+//!
+//! A frame is found by the position of its center in the sound, so an
+//! analysis of another part of it (trimmed differently, for example)
+//! transforms only the frames the parts do not share. Frames are found
+//! only if the sound starts at a multiple of the frame spacing from the
+//! origin of the frames cached before (see setOrigin and 
+//! Analyzer::frameSpacing), and only frames whose window is inside the
+//! analysed samples are cached.
+//!
+//! The cache holds frames of one sound, transformed with one window, hop
+//! and rate: frames of an analysis transforming them differently drop all
+//! the frames cached before. The caller keeps a cache per sound (and per
+//! channel, direction or anything else changing the samples analysed).
+//
+class FrameCache
+{
+//	-- public interface --
+public:
+    //! Construct an empty cache.
+    FrameCache( void );
+
+    //! Set the position in the sound, in samples, of the first sample of
+    //! the next analysis.
+    //!
+    //! \param  origin position of the first sample analysed
+    void setOrigin( long origin ) { m_origin = origin; }
+
+    //! Return the position in the sound of the first sample analysed.
+    long origin( void ) const { return m_origin; }
+
+    //! Return the number of frames cached.
+    std::size_t numFrames( void ) const { return m_frames.size(); }
+
+    //! Remove all frames.
+    void clear( void );
+
+//	-- Analyzer access --
+    //! Drop all the frames if they were selected with other settings.
+    //!
+    //! \param  settings the parameters of an analysis the selected Peaks
+    //!         of its frames depend on
+    void configure( const std::vector< double > & settings );
+
+    //! Return the Peaks of the frame centered at a position of the sound,
+    //! or 0 if it is not cached. Safe to call from many threads while no
+    //! frame is stored.
+    //!
+    //! \param  position center of the frame in samples of the sound
+    const Peaks * find( long position ) const;
+
+    //! Store the Peaks selected from a frame, replacing the frame at the
+    //! position.
+    //!
+    //! \param  position center of the frame in samples of the sound
+    //! \param  peaks Peaks selected from the spectrum of the frame, times
+    //!         relative to it
+    void store( long position, const Peaks & peaks );
+
+//	-- private member variables --
+private:
+    std::unordered_map< long, Peaks > m_frames;
+    std::vector< double > m_settings;   //  configuration the frames were extracted with
+    long m_origin;
+};
+
+}	//	end of namespace Loris
+
+#endif /* ndef INCLUDE_FRAME_CACHE_H */
@@ -99,11 +99,13 @@ FundamentalFromPartials createEstimator( void )
 //! \param	numSamps The approximate number of estimate of the 
 //!			fundamental frequency from which to construct the 
 //!			frequency reference envelope.
+//! \param	numThreads The number of threads estimating the
+//!			fundamental frequency, 0 for one per hardware core.
 //
 FrequencyReference::FrequencyReference( PartialList::const_iterator begin, 
 										PartialList::const_iterator end, 
 										double minFreq, double maxFreq,
-										long numSamps ) :
+										long numSamps, unsigned int numThreads ) :
 	_env( new LinearEnvelope() )
 {
 	if ( numSamps < 1 )
@@ -117,14 +119,13 @@ FrequencyReference::FrequencyReference( PartialList::const_iterator begin,
 		std::swap( minFreq, maxFreq );
     }
     
-#ifdef Loris_Debug
-	debugger << "Finding frequency reference envelope in range " <<
-	debugger << minFreq << " to " << maxFreq << " Hz, from " <<
-	debugger << std::distance(begin,end) << " Partials" << std::endl;
-#endif
+	LORIS_DEBUGGER << "Finding frequency reference envelope in range " 
+	               << minFreq << " to " << maxFreq << " Hz, from " 
+	               << std::distance(begin,end) << " Partials" << std::endl;
 
 	
 	FundamentalFromPartials est = createEstimator();
+	est.setNumThreads( numThreads );
 	std::pair< double, double > span = PartialUtils::timeSpan( begin, end );
 	double dt = ( span.second - span.first ) / ( numSamps + 1 );
 	*_env = est.buildEnvelope( begin, end, 
@@ -160,11 +161,9 @@ FrequencyReference::FrequencyReference( PartialList::const_iterator begin,
 		std::swap( minFreq, maxFreq );
 	}
 	
-#ifdef Loris_Debug
-	debugger << "Finding frequency reference envelope in range " <<
-	debugger << minFreq << " to " << maxFreq << " Hz, from " <<
-	debugger << std::distance(begin,end) << " Partials" << std::endl;
-#endif
+	LORIS_DEBUGGER << "Finding frequency reference envelope in range " 
+	               << minFreq << " to " << maxFreq << " Hz, from " 
+	               << std::distance(begin,end) << " Partials" << std::endl;
     
 	FundamentalFromPartials est = createEstimator();
 	std::pair< double, double > span = PartialUtils::timeSpan( begin, end );
@@ -77,9 +77,13 @@ public:
 	//! \param	numSamps The approximate number of estimate of the 
 	//!			fundamental frequency from which to construct the 
 	//!			frequency reference envelope.
+	//! \param	numThreads The number of threads estimating the
+	//!			fundamental frequency, 0 for one per hardware core
+	//!			(see FundamentalFromPartials::setNumThreads).
 	FrequencyReference( PartialList::const_iterator begin, 
 						PartialList::const_iterator end, 
-						double minFreq, double maxFreq, long numSamps );
+						double minFreq, double maxFreq, long numSamps,
+						unsigned int numThreads = 1 );
 	 
 	//!	Construct a new fundamental FrequencyReference derived from the 
 	//!	specified half-open (STL-style) range of Partials that lies
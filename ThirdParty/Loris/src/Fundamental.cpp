@@ -45,6 +45,8 @@
 #include "KaiserWindow.h"
 #include "LinearEnvelope.h"
 #include "Notifier.h"
+#include "ParallelFor.h"
+#include "Partial.h"
 #include "PartialUtils.h"
 #include "ReassignedSpectrum.h"
 #include "SpectralPeakSelector.h"
@@ -267,9 +269,10 @@ FundamentalEstimator::setPrecision( double x )
 
 FundamentalFromSamples::FundamentalFromSamples( double winWidthHz, 
                                                 double precisionHz ) :
+    FundamentalEstimator( precisionHz ),
     m_cacheSampleRate( 0 ),
     m_windowWidth( winWidthHz ), 
-    FundamentalEstimator( precisionHz )
+    m_numThreads( 1 )
 {
 	VERIFY_ARG( FundamentalFromSamples, winWidthHz > 0 );
 }
@@ -308,27 +311,55 @@ FundamentalFromSamples::buildEnvelope( const double * sampsBeg,
         std::swap( tbeg, tend );
     }
 
-    LinearEnvelope env;
+    std::vector< double > times;
+    for ( double time = tbeg; time < tend; time += interval )
+    {
+        times.push_back( time );
+    }
     
-    std::vector< double > amplitudes, frequencies;
-
-    double time = tbeg;
-    while ( time < tend )
+    //  the estimates are independent, each thread takes every
+    //  numThreads-th time with its own spectrum analyzer (all
+    //  of them sharing the window, which is cached, see 
+    //  ReassignedSpectrum), buffers and workspace:
+    const unsigned int numThreads = 
+        std::min( resolveNumThreads( m_numThreads ),
+                  (unsigned int) std::max( times.size(), std::size_t( 1 ) ) );
+    std::vector< double > estimates( times.size(), 0. );
+    std::vector< char > confident( times.size(), 0 );
+    
+    parallelFor( numThreads, numThreads, [&]( std::size_t t )
     {
-        collectFreqsAndAmps( sampsBeg, sampsEnd-sampsBeg, sampleRate,
-                             frequencies, amplitudes, time );
-        if ( ! amplitudes.empty() )
+        std::unique_ptr< ReassignedSpectrum > spectrum = createSpectrumAnalyzer( sampleRate );
+        std::vector< double > amplitudes, frequencies;
+        F0Estimate::Workspace workspace;    //  reused by the estimates
+        
+        for ( std::size_t i = t; i < times.size(); i += numThreads )
         {
-            F0Estimate est( amplitudes, frequencies, lowerFreqBound, upperFreqBound, 
-                            m_precision );
+            collectFreqsAndAmps( sampsBeg, sampsEnd-sampsBeg, sampleRate,
+                                 frequencies, amplitudes, times[ i ], *spectrum );
+            if ( ! amplitudes.empty() )
+            {
+                F0Estimate est( amplitudes, frequencies, lowerFreqBound, upperFreqBound, 
+                                m_precision, &workspace );
 
-            if ( est.confidence() >= confidenceThreshold )
-            {   
-                env.insert( time, est.frequency() );
+                if ( est.confidence() >= confidenceThreshold )
+                {   
+                    estimates[ i ] = est.frequency();
+                    confident[ i ] = 1;
+                }
             }
         }
-        
-        time += interval;
+    } );
+    
+    //  the envelope is built in time order, the same for 
+    //  any number of threads:
+    LinearEnvelope env;
+    for ( std::size_t i = 0; i < times.size(); ++i )
+    {
+        if ( confident[ i ] )
+        {
+            env.insert( times[ i ], estimates[ i ] );
+        }
     }
     
     return env;            
@@ -350,8 +381,15 @@ FundamentalFromSamples::estimateAt( const double * sampsBeg,
 {
     std::vector< double > amplitudes, frequencies;
     
+    //  build the spectrum analyzer if necessary:
+    if ( m_cacheSampleRate != sampleRate ||
+         0 == m_spectrum.get() )
+    {
+        buildSpectrumAnalyzer( sampleRate );
+    }
+    
     collectFreqsAndAmps( sampsBeg, sampsEnd-sampsBeg, sampleRate,
-                         frequencies, amplitudes, time );
+                         frequencies, amplitudes, time, *m_spectrum );
                          
     F0Estimate est( amplitudes, frequencies, lowerFreqBound, upperFreqBound, m_precision );
 
@@ -385,6 +423,28 @@ void FundamentalFromSamples::setWindowWidth( double x )
     m_windowWidth = x; 
 }
 
+// ---------------------------------------------------------------------------
+//  numThreads
+// ---------------------------------------------------------------------------
+//! Return the number of threads used by buildEnvelope, 0 for one
+//! per hardware core.
+unsigned int FundamentalFromSamples::numThreads( void ) const
+{
+    return m_numThreads;
+}
+
+// ---------------------------------------------------------------------------
+//  setNumThreads
+// ---------------------------------------------------------------------------
+//! Set the number of threads used by buildEnvelope, 0 for one
+//! per hardware core.
+//! 
+//! \param n is the new value of this parameter.            
+void FundamentalFromSamples::setNumThreads( unsigned int n )
+{
+    m_numThreads = n; 
+}
+
 
 
 //  -- private auxiliary functions --
@@ -405,6 +465,22 @@ void FundamentalFromSamples::setWindowWidth( double x )
 //
 void 
 FundamentalFromSamples::buildSpectrumAnalyzer( double srate )
+{
+    m_spectrum.reset( createSpectrumAnalyzer( srate ).release() );
+    
+    //  remember the sample rate used to build this spectrum
+    //  analyzer:
+    m_cacheSampleRate = srate;
+}
+
+// ---------------------------------------------------------------------------
+//  createSpectrumAnalyzer
+// ---------------------------------------------------------------------------
+//! Return a new ReassignedSpectrum configured for the sample rate
+//! srate in Hz and the current parameters. 
+//
+std::unique_ptr< ReassignedSpectrum >
+FundamentalFromSamples::createSpectrumAnalyzer( double srate ) const
 {
  	//	configure the reassigned spectral analyzer, 
     //	always use odd-length windows:
@@ -416,17 +492,8 @@ FundamentalFromSamples::buildSpectrumAnalyzer( double srate )
         ++winlen;
     }
     
-    std::vector< double > window( winlen );
-    KaiserWindow::buildWindow( window, winshape );
-    
-    std::vector< double > windowDeriv( winlen );
-    KaiserWindow::buildTimeDerivativeWindow( windowDeriv, winshape );
-   
-    m_spectrum.reset( new ReassignedSpectrum( window, windowDeriv ) );    
-    
-    //  remember the sample rate used to build this spectrum
-    //  analyzer:
-    m_cacheSampleRate = srate;
+    //  the windows are cached by ReassignedSpectrum
+    return std::unique_ptr< ReassignedSpectrum >( new ReassignedSpectrum( winlen, winshape ) );    
 }
 
 // ---------------------------------------------------------------------------
@@ -454,21 +521,14 @@ FundamentalFromSamples::collectFreqsAndAmps( const double * samps,
                                              double sampleRate,
                                              std::vector< double > & frequencies, 
                                              std::vector< double > & amplitudes,
-                                             double time )
+                                             double time,
+                                             ReassignedSpectrum & spectrum ) const
 {
     amplitudes.clear();
     frequencies.clear();
-
-    //  build the spectrum analyzer if necessary:
-    if ( m_cacheSampleRate != sampleRate ||
-         0 == m_spectrum.get() )
-    {
-        buildSpectrumAnalyzer( sampleRate );
-    }
-    
     
     //	configure the peak selection and partial formation policies:    
-    unsigned long winlen = m_spectrum->window().size();
+    unsigned long winlen = spectrum.window().size();
     const double maxTimeCorrection = 0.25 * winlen / sampleRate;   //  one-quarter the window width
     SpectralPeakSelector selector( sampleRate, maxTimeCorrection );  
  	
@@ -484,10 +544,10 @@ FundamentalFromSamples::collectFreqsAndAmps( const double * samps,
     
     if ( winMiddle < sampsEnd )
     {
-        m_spectrum->transform( samps + sampsBegin, samps + winMiddle, samps + sampsEnd );
+        spectrum.transform( samps + sampsBegin, samps + winMiddle, samps + sampsEnd );
                      
         //	extract peaks from the spectrum, no fading:
-        Peaks peaks = selector.selectPeaks( *m_spectrum ); 
+        Peaks peaks = selector.selectPeaks( spectrum ); 
         
         if ( ! peaks.empty() )
         {
@@ -523,6 +583,97 @@ FundamentalFromSamples::collectFreqsAndAmps( const double * samps,
 // ---------------------------------------------------------------------------
 // ---------------------------------------------------------------------------
 
+// ---------------------------------------------------------------------------
+//  PartialSpans
+// ---------------------------------------------------------------------------
+//  The Partials of a range with the times between which they sound (their
+//  amplitude is zero beyond the fade at their ends) and their order by the 
+//  start of that span, found once and shared by all sweeps.
+//
+struct PartialSpans
+{
+    std::vector< const Partial * > partials;
+    std::vector< std::pair< double, double > > spans;
+    std::vector< std::size_t > byStart;
+    
+    PartialSpans( PartialList::const_iterator begin_partials, 
+                  PartialList::const_iterator end_partials )
+    {
+        for ( PartialList::const_iterator it = begin_partials; it != end_partials; ++it )
+        {
+            partials.push_back( &*it );
+            spans.push_back( std::make_pair( it->startTime() - Partial::ShortestSafeFadeTime,
+                                             it->endTime() + Partial::ShortestSafeFadeTime ) );
+            byStart.push_back( byStart.size() );
+        }
+        std::stable_sort( byStart.begin(), byStart.end(), 
+                          [this]( std::size_t a, std::size_t b )
+                          { return spans[ a ].first < spans[ b ].first; } );
+    }
+};
+
+// ---------------------------------------------------------------------------
+//  PartialSweep
+// ---------------------------------------------------------------------------
+//  Evaluates the Partials of a range along a sweep of non-decreasing times,
+//  visiting only the ones sounding at each time, each through a cursor
+//  walking its Breakpoints (see PartialCursor), instead of searching the
+//  Breakpoints of every Partial of the range. The Partials are visited in
+//  the order of the range. An earlier time starts the sweep again.
+//
+class PartialSweep
+{
+public:
+    explicit PartialSweep( const PartialSpans & spans ) :
+        m_spans( spans ),
+        m_nextStart( 0 ),
+        m_time( 0 )
+    {
+        m_cursors.reserve( spans.partials.size() );
+        for ( const Partial * p : spans.partials )
+        {
+            m_cursors.push_back( PartialCursor( *p ) );
+        }
+    }
+    
+    //  Call fn with the parameters at time of every Partial sounding then.
+    template< typename Fn >
+    void forEachAt( double time, Fn fn )
+    {
+        if ( time < m_time )
+        {
+            m_active.clear();
+            m_nextStart = 0;
+        }
+        m_time = time;
+        
+        //  Partials starting by time join the ones sounding, kept in the
+        //  order of the range, the ones that ended leave:
+        const std::vector< std::size_t > & byStart = m_spans.byStart;
+        for ( ; m_nextStart < byStart.size() && m_spans.spans[ byStart[ m_nextStart ] ].first <= time; ++m_nextStart )
+        {
+            const std::size_t idx = byStart[ m_nextStart ];
+            m_active.insert( std::lower_bound( m_active.begin(), m_active.end(), idx ), idx );
+        }
+        m_active.erase( std::remove_if( m_active.begin(), m_active.end(), 
+                                        [this, time]( std::size_t idx )
+                                        { return m_spans.spans[ idx ].second < time; } ),
+                        m_active.end() );
+        
+        for ( std::size_t idx : m_active )
+        {
+            fn( m_cursors[ idx ].parametersAt( time ) );
+        }
+    }
+    
+private:
+    const PartialSpans & m_spans;
+    std::vector< PartialCursor > m_cursors;     //  one for each Partial
+    std::size_t m_nextStart;                    //  next Partial to start, in byStart
+    std::vector< std::size_t > m_active;        //  Partials sounding, in range order
+    double m_time;                              //  the last time swept
+};
+
 // ---------------------------------------------------------------------------
 //  constructor
 // ---------------------------------------------------------------------------
@@ -535,19 +686,20 @@ FundamentalFromSamples::collectFreqsAndAmps( const double * samps,
 //! fundamental estimates will be made.
 
 FundamentalFromPartials::FundamentalFromPartials( double precisionHz ) :
-    FundamentalEstimator( precisionHz )
+    FundamentalEstimator( precisionHz ),
+    m_numThreads( 1 )
 {
 }
 
 // ---------------------------------------------------------------------------
 //  copy constructor
 // ---------------------------------------------------------------------------
-//! Construct a copy of an estimator. Nothing much to do since this class
-//! has no data members.
+//! Construct a copy of an estimator.
 //
 
 FundamentalFromPartials::FundamentalFromPartials( const FundamentalFromPartials & rhs ) :
-    FundamentalEstimator( rhs )
+    FundamentalEstimator( rhs ),
+    m_numThreads( rhs.m_numThreads )
 {
 }
 
@@ -562,17 +714,43 @@ FundamentalFromPartials::~FundamentalFromPartials( void )
 // ---------------------------------------------------------------------------
 //  assignment
 // ---------------------------------------------------------------------------
-//! Pass the assignment opertion up to the base class.
+//! Pass the assignment opertion up to the base class, and copy
+//! the number of threads.
 //
 
 FundamentalFromPartials &
 FundamentalFromPartials::operator=( const FundamentalFromPartials & rhs )
 {
     FundamentalEstimator::operator=( rhs );
+    m_numThreads = rhs.m_numThreads;
     
     return *this;
 }
 
+//  -- parameter access/mutation --
+
+// ---------------------------------------------------------------------------
+//  numThreads
+// ---------------------------------------------------------------------------
+//! Return the number of threads used by buildEnvelope, 0 for one
+//! per hardware core.
+unsigned int FundamentalFromPartials::numThreads( void ) const
+{
+    return m_numThreads;
+}
+
+// ---------------------------------------------------------------------------
+//  setNumThreads
+// ---------------------------------------------------------------------------
+//! Set the number of threads used by buildEnvelope, 0 for one
+//! per hardware core.
+//! 
+//! \param n is the new value of this parameter.            
+void FundamentalFromPartials::setNumThreads( unsigned int n )
+{
+    m_numThreads = n; 
+}
+
 //  -- fundamental frequency estimation --
 
 // ---------------------------------------------------------------------------
@@ -596,27 +774,59 @@ FundamentalFromPartials::buildEnvelope( PartialList::const_iterator begin_partia
         std::swap( tbeg, tend );
     }
 
+    std::vector< double > times;
+    for ( double time = tbeg; time < tend; time += interval )
+    {
+        times.push_back( time );
+    }
+    
     LinearEnvelope env;
+    if ( times.empty() )
+    {
+        return env;
+    }
     
-    std::vector< double > amplitudes, frequencies;
-
-    double time = tbeg;
-    while ( time < tend )
+    //  each thread sweeps a contiguous part of the times, with
+    //  its own sweep, buffers and workspace:
+    const PartialSpans spans( begin_partials, end_partials );
+    const unsigned int numThreads = 
+        std::min( resolveNumThreads( m_numThreads ), (unsigned int) times.size() );
+    std::vector< double > estimates( times.size(), 0. );
+    std::vector< char > confident( times.size(), 0 );
+    
+    parallelFor( numThreads, numThreads, [&]( std::size_t t )
     {
-        collectFreqsAndAmps( begin_partials, end_partials, frequencies, amplitudes, time );
-                  
-        if (! amplitudes.empty() )
-        {
-            F0Estimate est( amplitudes, frequencies, lowerFreqBound, upperFreqBound, 
-                            m_precision );
+        PartialSweep sweep( spans );
+        std::vector< double > amplitudes, frequencies;
+        F0Estimate::Workspace workspace;    //  reused by the estimates
         
-            if ( est.confidence() >= confidenceThreshold )
-            {   
-                env.insert( time, est.frequency() );
+        const std::size_t end = times.size() * ( t + 1 ) / numThreads;
+        for ( std::size_t i = times.size() * t / numThreads; i < end; ++i )
+        {
+            collectFreqsAndAmps( sweep, frequencies, amplitudes, times[ i ] );
+                      
+            if (! amplitudes.empty() )
+            {
+                F0Estimate est( amplitudes, frequencies, lowerFreqBound, upperFreqBound, 
+                                m_precision, &workspace );
+            
+                if ( est.confidence() >= confidenceThreshold )
+                {   
+                    estimates[ i ] = est.frequency();
+                    confident[ i ] = 1;
+                }
             }
         }
-        
-        time += interval;
+    } );
+    
+    //  the envelope is built in time order, the same for 
+    //  any number of threads:
+    for ( std::size_t i = 0; i < times.size(); ++i )
+    {
+        if ( confident[ i ] )
+        {
+            env.insert( times[ i ], estimates[ i ] );
+        }
     }
     
     return env;            
@@ -636,7 +846,9 @@ FundamentalFromPartials::estimateAt( PartialList::const_iterator begin_partials,
 {
     std::vector< double > amplitudes, frequencies;
     
-    collectFreqsAndAmps( begin_partials, end_partials, frequencies, amplitudes, time );
+    const PartialSpans spans( begin_partials, end_partials );
+    PartialSweep sweep( spans );
+    collectFreqsAndAmps( sweep, frequencies, amplitudes, time );
                          
     F0Estimate est( amplitudes, frequencies, lowerFreqBound, upperFreqBound, m_precision );
 
@@ -649,65 +861,60 @@ FundamentalFromPartials::estimateAt( PartialList::const_iterator begin_partials,
 // ---------------------------------------------------------------------------
 //  collectFreqsAndAmps
 // ---------------------------------------------------------------------------
-//! Perform spectral analysis on a sequence of samples, using
-//! an analysis window centered at the specified time in seconds.
-//! Collect the frequencies and amplitudes of the peaks and return
-//! them in the vectors provided. 
+//! Collect the frequencies and amplitudes of the Partials sounding
+//! at the specified time in seconds and return them in the vectors 
+//! provided. Partials not sounding have no amplitude, so they are
+//! not visited.
 //
    
 void 
-FundamentalFromPartials::collectFreqsAndAmps( PartialList::const_iterator begin_partials, 
-                                              PartialList::const_iterator end_partials,
+FundamentalFromPartials::collectFreqsAndAmps( PartialSweep & sweep,
                                               std::vector< double > & frequencies, 
                                               std::vector< double > & amplitudes,
-                                              double time )
+                                              double time ) const
 {
     amplitudes.clear();
     frequencies.clear();
     
-    if ( begin_partials != end_partials )
-    {            
-        //  determine the absolute amplitude threshold 
-        double thresh = std::pow( 10.0, - 0.05 * - m_ampFloor );
+    //  determine the absolute amplitude threshold 
+    double thresh = std::pow( 10.0, - 0.05 * - m_ampFloor );
+    
+    double max_amp = 0;        
+    sweep.forEachAt( time, [&]( const Breakpoint & bp )
+    {
+        //  compute the sinusoidal amplitude (without bandwidth energy)
+        double sine_amp = std::sqrt(1 - bp.bandwidth()) * bp.amplitude();        
+        double freq = bp.frequency();
         
-        double max_amp = 0;        
-        for ( PartialList::const_iterator it = begin_partials; it != end_partials; ++it )
+        if ( sine_amp > thresh &&
+             freq < m_freqCeiling )
         {
-            //  compute the sinusoidal amplitude (without bandwidth energy)
-            double sine_amp = std::sqrt(1 - it->bandwidthAt( time )) * it->amplitudeAt( time );        
-            double freq = it->frequencyAt( time );
-            
-            if ( sine_amp > thresh &&
-                 freq < m_freqCeiling )
-            {
-                amplitudes.push_back( sine_amp );
-                frequencies.push_back( freq );
-            }
-            
-            max_amp = std::max( sine_amp, max_amp );                        
+            amplitudes.push_back( sine_amp );
+            frequencies.push_back( freq );
         }
         
-        //  remove quietest ones - this isn't very efficient, 
-        //  but it is much faster than making two passes (and 
-        //  computing two sequences of sinusoidal amplitudes).
-        thresh = std::pow( 10.0, - 0.05 * m_ampRange ) * max_amp;
-        vector< double >::size_type N = amplitudes.size();
-        vector< double >::size_type k = 0;
-        while ( k < N )
+        max_amp = std::max( sine_amp, max_amp );                        
+    } );
+    
+    //  remove quietest ones - this isn't very efficient, 
+    //  but it is much faster than making two passes (and 
+    //  computing two sequences of sinusoidal amplitudes).
+    thresh = std::pow( 10.0, - 0.05 * m_ampRange ) * max_amp;
+    vector< double >::size_type N = amplitudes.size();
+    vector< double >::size_type k = 0;
+    while ( k < N )
+    {
+        if ( amplitudes[k] < thresh )
         {
-            if ( amplitudes[k] < thresh )
-            {
-                amplitudes.erase( amplitudes.begin() + k );
-                frequencies.erase( frequencies.begin() + k );
-                --N;
-            }
-            else
-            {
-                ++k;
-            }
+            amplitudes.erase( amplitudes.begin() + k );
+            frequencies.erase( frequencies.begin() + k );
+            --N;
+        }
+        else
+        {
+            ++k;
         }
     }
-    
 }
 
 }   //  end of namespace Loris
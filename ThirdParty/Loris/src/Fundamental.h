@@ -46,6 +46,7 @@
 //  begin namespace
 namespace Loris {
 
+class PartialSweep;
 class ReassignedSpectrum;
 
 // ---------------------------------------------------------------------------
@@ -470,7 +471,17 @@ public:
     //! \param  w is the new main lobe width in Hz            
     void setWindowWidth( double w );         
 
+    //! Return the number of threads estimating the fundamental at
+    //! the time points of buildEnvelope(), 0 for one per hardware
+    //! core. Default is 1.
+    unsigned int numThreads( void ) const;
     
+    //! Set the number of threads estimating the fundamental at the
+    //! time points of buildEnvelope(), 0 for one per hardware core.
+    //! Every thread has its own spectrum analyzer (the windows are
+    //! shared), the estimates are independent, so the envelope does
+    //! not depend on the number of threads. Default is 1.
+    void setNumThreads( unsigned int n );
 
 //  -- private auxiliary functions --
 
@@ -486,6 +497,15 @@ private:
     //! \param  srate is the sampling frequency in Hz, needed to compute
     //!         analysis window parameters    
     void buildSpectrumAnalyzer( double srate );
+
+    //  createSpectrumAnalyzer
+    //
+    //! Construct a spectrum analyzer configured like the one
+    //! built by buildSpectrumAnalyzer(), sharing its windows, for
+    //! the threads of buildEnvelope().
+    //!
+    //! \param  srate is the sampling frequency in Hz
+    std::unique_ptr< ReassignedSpectrum > createSpectrumAnalyzer( double srate ) const;
         
 
     //  collectFreqsAndAmps
@@ -508,13 +528,16 @@ private:
     //!         fundamental frequency
     //! \param  time is the time in seconds at which to collect frequencies
     //!         and amplitudes of spectral peaks
+    //! \param  spectrum is the spectrum analyzer to use, built for
+    //!         sampleRate
     
     void collectFreqsAndAmps( const double * samps,
                               unsigned long nsamps,
                               double sampleRate,
                               std::vector< double > & frequencies, 
                               std::vector< double > & amplitudes,
-                              double time );
+                              double time,
+                              ReassignedSpectrum & spectrum ) const;
 
 
 //  -- private member variables --
@@ -527,6 +550,8 @@ private:
     double m_windowWidth;       //! the width of the main lobe of the window to 
                                 //! be used in spectral analysis, in Hz
     
+    unsigned int m_numThreads;  //! number of threads estimating envelopes
+    
 //  disallow these until they are implemented
 
     FundamentalFromSamples( const FundamentalFromSamples & );
@@ -566,13 +591,26 @@ public:
     //! Destructor    
     ~FundamentalFromPartials( void );
     
-    //! Construct a copy of an estimator. Nothing much to do since this class
-    //! has no data members.
+    //! Construct a copy of an estimator.
     FundamentalFromPartials( const FundamentalFromPartials & );
     
-    //! Pass the assignment opertion up to the base class.
+    //! Pass the assignment opertion up to the base class, and copy
+    //! the number of threads.
     FundamentalFromPartials & operator= ( const FundamentalFromPartials & );
 
+//  -- parameter access/mutation --
+
+    //! Return the number of threads used by buildEnvelope, 0 for one
+    //! per hardware core. The default is 1.
+    unsigned int numThreads( void ) const;
+    
+    //! Set the number of threads used by buildEnvelope, 0 for one
+    //! per hardware core. Each thread sweeps a contiguous part of
+    //! the time span, the envelope is the same for any number.
+    //! 
+    //! \param n is the new value of this parameter.
+    void setNumThreads( unsigned int n );
+
 //  -- fundamental frequency estimation --
 
     //  buildEnvelope
@@ -710,8 +748,8 @@ private:
     //! Collect the frequencies and amplitudes of a range of partials 
     //! at the specified time and return them in the vectors provided. 
     //!
-    //! \param  begin_partials is the beginning of a sequence of Partials
-    //! \param  end_partials is the end of a sequence of Partials
+    //! \param  sweep evaluates the Partials sounding at the time, 
+    //!         see PartialSweep in Fundamental.cpp
     //! \param  frequencies is a vector in which to store a sequence of
     //!         frequencies to be used to estimate the most likely 
     //!         fundamental frequency
@@ -720,12 +758,14 @@ private:
     //!         fundamental frequency
     //! \param  time is the time in seconds at which to collect frequencies
     //!         and amplitudes of the Partials
-    void collectFreqsAndAmps( PartialList::const_iterator begin_partials, 
-                              PartialList::const_iterator end_partials,
+    void collectFreqsAndAmps( PartialSweep & sweep,
                               std::vector< double > & frequencies, 
                               std::vector< double > & amplitudes,
-                              double time );
+                              double time ) const;
+
+//  -- private member variables --
 
+    unsigned int m_numThreads;  //! number of threads estimating envelopes
 
 
 };   //  end of class FundamentalFromPartials
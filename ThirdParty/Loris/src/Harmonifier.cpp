@@ -121,6 +121,7 @@ void Harmonifier::harmonify( Partial & p ) const
 
     double fscale = (double)p.label() / _refPartial.label();
     
+    EnvelopeCursor weight( *_weight );
     for ( Partial::iterator it = p.begin(); it != p.end(); ++it )
     {
         Breakpoint & bp = it.breakpoint();            
@@ -135,7 +136,7 @@ void Harmonifier::harmonify( Partial & p ) const
                 std::min( ( BeginFade - bp.amplitude() ) * OneOverFadeSpan, 1. );
                 
             //  alpha is scaled by the weigthing envelope
-            alpha *= _weight->valueAt( it.time() );
+            alpha *= weight.valueAt( it.time() );
             
             double fRef = _refPartial.frequencyAt( it.time() );
             
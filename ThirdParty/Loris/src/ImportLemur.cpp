@@ -381,7 +381,7 @@ getPartial( std::istream & s, PartialList & partials, double bweCutoff )
 		}
 		/*
 		else {
-			debugger << "import rejecting a Partial of zero duration (" 
+			LORIS_DEBUGGER << "import rejecting a Partial of zero duration (" 
 					<< tkHeader.numPeaks << " peaks read)" << endl;
 		}
 		*/
@@ -164,9 +164,94 @@ public:
     using std::map< double, double >::value_type;
     using std::map< double, double >::iterator;
     using std::map< double, double >::const_iterator;
+    using std::map< double, double >::lower_bound;
 
 };  //  end of class LinearEnvelope
 
+// ---------------------------------------------------------------------------
+//  class EnvelopeCursor
+//
+//! An EnvelopeCursor evaluates an Envelope along a sweep of non-decreasing
+//! times, as when it is evaluated at the Breakpoints of a Partial. A
+//! LinearEnvelope is interpolated inline by a position that walks forward
+//! through its breakpoints, so a sweep costs amortized constant time per
+//! value instead of a virtual call and a map search. Other Envelopes are
+//! evaluated by their valueAt(). Earlier times are still evaluated
+//! correctly, by searching again.
+//!
+//! The Envelope must outlive the cursor and must not be changed while
+//! the cursor is used.
+//
+class EnvelopeCursor
+{
+//  -- public interface --
+public:
+    //! Construct a cursor at the beginning of an Envelope.
+    explicit EnvelopeCursor( const Envelope & env ) :
+        _env( env ),
+        _linear( dynamic_cast< const LinearEnvelope * >( &env ) )
+    {
+        if ( 0 != _linear )
+        {
+            _next = _linear->begin();
+        }
+    }
+    
+    //! Return the value of the Envelope at the specified time, the
+    //! same as Envelope::valueAt().
+    double valueAt( double t )
+    {
+        if ( 0 == _linear )
+        {
+            return _env.valueAt( t );
+        }
+        
+        //  same as LinearEnvelope::valueAt(), _next is the first 
+        //  breakpoint not before t
+        if ( _linear->empty() )
+        {
+            return 0.;
+        }
+        
+        LinearEnvelope::const_iterator begin = _linear->begin();
+        LinearEnvelope::const_iterator end = _linear->end();
+        if ( _next != begin )
+        {
+            LinearEnvelope::const_iterator prev = _next;
+            if ( (--prev)->first >= t )
+            {
+                _next = _linear->lower_bound( t );
+            }
+        }
+        while ( _next != end && _next->first < t )
+        {
+            ++_next;
+        }
+        
+        if ( _next == begin )
+        {
+            return _next->second;
+        }
+        
+        LinearEnvelope::const_iterator less = _next;
+        --less;
+        if ( _next == end )
+        {
+            return less->second;
+        }
+        
+        double alpha = (t - less->first) / (_next->first - less->first);
+        return ( alpha * _next->second ) + ( (1. - alpha) * less->second );
+    }
+    
+//  -- implementation --
+private:
+    const Envelope & _env;
+    const LinearEnvelope * _linear;         //  0 for other Envelopes
+    LinearEnvelope::const_iterator _next;   //  first breakpoint not before the last time
+    
+};  //  end of class EnvelopeCursor
+
 
 //  --  binary operators (inline nonmembers) --
 
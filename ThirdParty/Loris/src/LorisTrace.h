@@ -0,0 +1,130 @@
+#ifndef INCLUDE_LORIS_TRACE_H
+#define INCLUDE_LORIS_TRACE_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * LorisTrace.h
+ *
+ * Scoped trace zones for external profilers, so the time spent in the
+ * stages of analysis and synthesis can be told apart from the time of
+ * the host application in a profile of the whole process.
+ *
+ *   LORIS_TRACE_ZONE( "name" );
+ *
+ * marks the rest of the enclosing scope as a zone named by the string
+ * literal. Zones are compiled out unless one of these is defined to 1
+ * (and the profiler's headers and library are available):
+ *
+ *   LORIS_TRACE_TRACY     Tracy (tracy/Tracy.hpp, with TRACY_ENABLE)
+ *   LORIS_TRACE_ITT       Intel ITT API (ittnotify.h), VTune
+ *   LORIS_TRACE_SIGNPOST  os_signpost intervals of the Points of
+ *                         Interest category, Instruments on macOS
+ *
+ * The profiler's state of a zone is created the first time it is
+ * entered, zones on realtime threads may allocate once then.
+ *
+ */
+
+#define LORIS_TRACE_CONCAT2( a, b ) a##b
+#define LORIS_TRACE_CONCAT( a, b ) LORIS_TRACE_CONCAT2( a, b )
+
+#if defined(LORIS_TRACE_TRACY) && LORIS_TRACE_TRACY
+
+#include "tracy/Tracy.hpp"
+
+#define LORIS_TRACE_ZONE( name ) ZoneScopedN( name )
+
+#elif defined(LORIS_TRACE_ITT) && LORIS_TRACE_ITT
+
+#include <ittnotify.h>
+
+//  begin namespace
+namespace Loris {
+
+//! Return the ITT domain of all Loris zones.
+inline __itt_domain * traceDomain( void )
+{
+    static __itt_domain * const domain = __itt_domain_create( "Loris" );
+    return domain;
+}
+
+//! Task of the ITT domain lasting as long as this object.
+class TraceZone
+{
+public:
+    explicit TraceZone( __itt_string_handle * name )
+    {
+        __itt_task_begin( traceDomain(), __itt_null, __itt_null, name );
+    }
+    ~TraceZone( void )
+    {
+        __itt_task_end( traceDomain() );
+    }
+};
+
+}   //  end of namespace Loris
+
+#define LORIS_TRACE_ZONE( name )                                                        \
+    static __itt_string_handle * const LORIS_TRACE_CONCAT( lorisTraceName, __LINE__ ) = \
+        __itt_string_handle_create( name );                                             \
+    const Loris::TraceZone LORIS_TRACE_CONCAT( lorisTraceZone, __LINE__ )( LORIS_TRACE_CONCAT( lorisTraceName, __LINE__ ) )
+
+#elif defined(LORIS_TRACE_SIGNPOST) && LORIS_TRACE_SIGNPOST
+
+#include <os/signpost.h>
+
+//  begin namespace
+namespace Loris {
+
+//! Return the log of all Loris intervals.
+inline os_log_t traceLog( void )
+{
+    static const os_log_t log = os_log_create( "org.cerlsoundgroup.loris", OS_LOG_CATEGORY_POINTS_OF_INTEREST );
+    return log;
+}
+
+}   //  end of namespace Loris
+
+//  os_signpost needs the name as a literal where the interval begins
+//  and ends, so every zone has its own type
+#define LORIS_TRACE_ZONE( name )                                                        \
+    struct LORIS_TRACE_CONCAT( LorisTraceZone, __LINE__ )                               \
+    {                                                                                   \
+        os_signpost_id_t id;                                                            \
+        LORIS_TRACE_CONCAT( LorisTraceZone, __LINE__ )( void )                          \
+            : id( os_signpost_id_generate( Loris::traceLog() ) )                        \
+        {                                                                               \
+            os_signpost_interval_begin( Loris::traceLog(), id, name );                  \
+        }                                                                               \
+        ~LORIS_TRACE_CONCAT( LorisTraceZone, __LINE__ )( void )                         \
+        {                                                                               \
+            os_signpost_interval_end( Loris::traceLog(), id, name );                    \
+        }                                                                               \
+    } const LORIS_TRACE_CONCAT( lorisTraceZone, __LINE__ )
+
+#else
+
+#define LORIS_TRACE_ZONE( name ) do {} while ( false )
+
+#endif
+
+#endif  //  ndef INCLUDE_LORIS_TRACE_H
@@ -39,8 +39,10 @@
 #include "Morpher.h"
 #include "Breakpoint.h"
 #include "Envelope.h"
+#include "LinearEnvelope.h"
 #include "LorisExceptions.h"
 #include "Notifier.h"
+#include "ParallelFor.h"
 #include "Partial.h"
 #include "PartialList.h"
 #include "PartialUtils.h"
@@ -91,7 +93,8 @@ Morpher::Morpher( const Envelope & f ) :
     _logMorphShape( DefaultAmpShape ),
     _minBreakpointGapSec( DefaultBreakpointGap ),
     _doLogAmpMorphing( true ),
-    _doLogFreqMorphing( false )
+    _doLogFreqMorphing( false ),
+    _numThreads( 1 )
 {
 }
 
@@ -109,7 +112,8 @@ Morpher::Morpher( const Envelope & ff, const Envelope & af, const Envelope & bwf
     _logMorphShape( DefaultAmpShape ),
     _minBreakpointGapSec( DefaultBreakpointGap ),
     _doLogAmpMorphing( true ),
-    _doLogFreqMorphing( false )
+    _doLogFreqMorphing( false ),
+    _numThreads( 1 )
 {
 }
 
@@ -129,7 +133,8 @@ Morpher::Morpher( const Morpher & rhs ) :
     _logMorphShape( rhs._logMorphShape ),
     _minBreakpointGapSec( rhs._minBreakpointGapSec ),
     _doLogAmpMorphing( rhs._doLogAmpMorphing ),
-    _doLogFreqMorphing( rhs._doLogFreqMorphing )
+    _doLogFreqMorphing( rhs._doLogFreqMorphing ),
+    _numThreads( rhs._numThreads )
 {
 }
 
@@ -166,6 +171,7 @@ Morpher::operator= ( const Morpher & rhs )
         
         _doLogAmpMorphing = rhs._doLogAmpMorphing;
         _doLogFreqMorphing = rhs._doLogFreqMorphing;
+        _numThreads = rhs._numThreads;
         
     }
     return *this;
@@ -196,7 +202,7 @@ Morpher::operator= ( const Morpher & rhs )
 //! \return the morphed Partial
 //
 Partial
-Morpher::morphPartials( Partial src, Partial tgt, int assignLabel )
+Morpher::morphPartials( Partial src, Partial tgt, int assignLabel ) const
 {  
     if ( (src.numBreakpoints() == 0) && (tgt.numBreakpoints() == 0) )
     {
@@ -223,6 +229,18 @@ Morpher::morphPartials( Partial src, Partial tgt, int assignLabel )
     Partial newp;
     newp.setLabel( assignLabel );
     
+    //  Breakpoints of both Partials are visited in time order,
+    //  so the opposite Partial, the reference Partials and the 
+    //  morphing functions are evaluated by cursors walking 
+    //  forward, not by searching them at every Breakpoint:
+    PartialCursor srcCursor( src );
+    PartialCursor tgtCursor( tgt );
+    PartialCursor srcRefCursor( _srcRefPartial );
+    PartialCursor tgtRefCursor( _tgtRefPartial );
+    EnvelopeCursor freqFunction( *_freqFunction );
+    EnvelopeCursor ampFunction( *_ampFunction );
+    EnvelopeCursor bwFunction( *_bwFunction );
+    
 
     //  Merge Breakpoints from the two Partials,
     //  loop until there are no more Breakpoints to
@@ -240,7 +258,17 @@ Morpher::morphPartials( Partial src, Partial tgt, int assignLabel )
             //  the end of the new Partial by more than the gap time.
             if ( dontAddBefore <= src_iter.time() )
             {
-                appendMorphedSrc( src_iter.breakpoint(), tgt, src_iter.time(), newp );
+                const double time = src_iter.time();
+                Breakpoint tgtBkpt;
+                if ( 0 != tgt.numBreakpoints() )
+                {
+                    tgtBkpt = tgtCursor.parametersAt( time );
+                }
+                appendMorphedSrc( src_iter.breakpoint(), 
+                                  ( 0 != tgt.numBreakpoints() ) ? &tgtBkpt : 0, time,
+                                  freqFunction.valueAt( time ), ampFunction.valueAt( time ),
+                                  bwFunction.valueAt( time ), newp,
+                                  srcRefCursor, tgtRefCursor );
             }
 
             ++src_iter;
@@ -255,7 +283,17 @@ Morpher::morphPartials( Partial src, Partial tgt, int assignLabel )
             //  the end of the new Partial by more than the gap time.
             if ( dontAddBefore <= tgt_iter.time() )
             {
-                appendMorphedTgt( tgt_iter.breakpoint(), src, tgt_iter.time(), newp );
+                const double time = tgt_iter.time();
+                Breakpoint srcBkpt;
+                if ( 0 != src.numBreakpoints() )
+                {
+                    srcBkpt = srcCursor.parametersAt( time );
+                }
+                appendMorphedTgt( tgt_iter.breakpoint(), 
+                                  ( 0 != src.numBreakpoints() ) ? &srcBkpt : 0, time,
+                                  freqFunction.valueAt( time ), ampFunction.valueAt( time ),
+                                  bwFunction.valueAt( time ), newp,
+                                  srcRefCursor, tgtRefCursor );
             }
 
             ++tgt_iter;
@@ -316,13 +354,14 @@ Morpher::fixMorphedPhases( Partial & newp ) const
         //  the morphed partial
         Partial::iterator bppos = newp.begin();
         Partial::iterator lastPosCorrect = bppos;
-        MorphState curstate = GetMorphState( _freqFunction->valueAt( bppos.time() ) );
+        EnvelopeCursor freqFunction( *_freqFunction );
+        MorphState curstate = GetMorphState( freqFunction.valueAt( bppos.time() ) );
         
         //  consider each Breakpoint, look for a change in the
         //  morph state at the time of each Breakpoint
         while( ++bppos != newp.end() )
         {
-            MorphState nxtstate = GetMorphState( _freqFunction->valueAt( bppos.time() ) );   
+            MorphState nxtstate = GetMorphState( freqFunction.valueAt( bppos.time() ) );   
             if ( nxtstate != curstate )
             {
                 //  switch!
@@ -383,7 +422,7 @@ Morpher::crossfade( PartialList::const_iterator beginSrc,
                     Partial::label_type label /* default 0 */ )
 {
     Partial nullPartial;
-    debugger << "crossfading unlabeled (labeled 0) Partials" << endl;
+    LORIS_DEBUGGER << "crossfading unlabeled (labeled 0) Partials" << endl;
     
     long debugCounter;
 
@@ -420,7 +459,7 @@ Morpher::crossfade( PartialList::const_iterator beginSrc,
             }
         }
     }
-    debugger << "kept " << debugCounter << " from sound 1" << endl;
+    LORIS_DEBUGGER << "kept " << debugCounter << " from sound 1" << endl;
 
     //    crossfade Partials corresponding to a morph weight of 1:
     debugCounter = 0;
@@ -454,7 +493,7 @@ Morpher::crossfade( PartialList::const_iterator beginSrc,
             }
         }
     }
-    debugger << "kept " << debugCounter << " from sound 2" << endl;
+    LORIS_DEBUGGER << "kept " << debugCounter << " from sound 2" << endl;
 }
 
 // ---------------------------------------------------------------------------
@@ -1023,6 +1062,30 @@ void Morpher::setMinBreakpointGap( double x )
     _minBreakpointGapSec = x;
 }
 
+// ---------------------------------------------------------------------------
+//    numThreads
+// ---------------------------------------------------------------------------
+//    Return the number of threads used to morph corresponding
+//    Partials, 0 for one per hardware core. Default is 1.
+//
+unsigned int Morpher::numThreads( void ) const
+{
+    return _numThreads;
+}
+
+// ---------------------------------------------------------------------------
+//    setNumThreads
+// ---------------------------------------------------------------------------
+//    Set the number of threads used to morph corresponding Partials,
+//    0 for one per hardware core. Partials having different labels
+//    are morphed independently, so the morphed Partials do not 
+//    depend on the number of threads. Default is 1.
+//
+void Morpher::setNumThreads( unsigned int n )
+{
+    _numThreads = n;
+}
+
 // -- PartialList access --
 
 // ---------------------------------------------------------------------------
@@ -1060,13 +1123,20 @@ Morpher::partials( void ) const
 //    labels to pairs of Partials (MorphingPair) that should be morphed 
 //    into a single Partial that is assigned that label. 
 //
+//    Each pair is morphed independently of the others, pairs are spread 
+//    over numThreads() threads and the morphed Partials are collected
+//    in label order afterwards.
+//
 void Morpher::morph_aux( PartialCorrespondence & correspondence  )
 {
-    PartialCorrespondence::const_iterator it;
+    std::vector< PartialCorrespondence::value_type * > pairs;
+    pairs.reserve( correspondence.size() );
+    
+    PartialCorrespondence::iterator it;
     for ( it = correspondence.begin(); it != correspondence.end(); ++it )
     {
         Partial::label_type label = it->first;
-        MorphingPair match = it->second;
+        MorphingPair & match = it->second;
         Partial & src = match.src;
         Partial & tgt = match.tgt;
        
@@ -1074,7 +1144,7 @@ void Morpher::morph_aux( PartialCorrespondence & correspondence  )
         //  one of those Partials must have some Breakpoints
         Assert( src.numBreakpoints() != 0 || tgt.numBreakpoints() != 0 );
 
-        debugger << "morphing " << ( ( 0 < src.numBreakpoints() )?( 1 ):( 0 ) )
+        LORIS_DEBUGGER << "morphing " << ( ( 0 < src.numBreakpoints() )?( 1 ):( 0 ) )
                    << " and " << ( ( 0 < tgt.numBreakpoints() )?( 1 ):( 0 ) )
                    << " partials with label " <<    label << endl;
                    
@@ -1138,13 +1208,24 @@ void Morpher::morph_aux( PartialCorrespondence & correspondence  )
         //  in the other one. Hmmmmm.....
 
                
-        //  perform the morph between the two Partials, 
-        //  save the result if it has any Breakpoints
-        //  (it may not depending on the morphing functions):                          
-        Partial newp = morphPartials( src, tgt, label );
-        if ( partial_is_nonnull( newp ) )
+        pairs.push_back( &*it );
+    }
+    
+    //  perform the morph between the two Partials of each pair, 
+    //  save the result if it has any Breakpoints
+    //  (it may not depending on the morphing functions):                          
+    std::vector< Partial > morphed( pairs.size() );
+    parallelFor( pairs.size(), _numThreads,
+                 [&]( std::size_t i ) 
+                 { 
+                     morphed[ i ] = morphPartials( pairs[ i ]->second.src, pairs[ i ]->second.tgt, 
+                                                   pairs[ i ]->first ); 
+                 } );
+    for ( std::size_t i = 0; i < morphed.size(); ++i )
+    {
+        if ( partial_is_nonnull( morphed[ i ] ) )
         {
-            _partials.push_back( newp );
+            _partials.push_back( morphed[ i ] );
         }
     }
 }
@@ -1159,6 +1240,7 @@ void Morpher::morph_aux( PartialCorrespondence & correspondence  )
 //  Leave the phase alone, because I don't know what we can do with it.
 //
 static void adjustFrequency( Breakpoint & bp, const Partial & ref, 
+                             PartialCursor & refCursor,
                              Partial::label_type harmonicNum,
                              double thresholdDb,
                              double time )
@@ -1177,7 +1259,7 @@ static void adjustFrequency( Breakpoint & bp, const Partial & ref,
             double fscale = (double)harmonicNum / ref.label();
 
             double alpha = std::min( ( BeginFade - bp.amplitude() ) * OneOverFadeSpan, 1. );
-            double fRef = ref.frequencyAt( time );
+            double fRef = refCursor.parametersAt( time ).frequency();
             bp.setFrequency( ( alpha * ( fRef * fscale ) ) + 
                              ( (1 - alpha) * bp.frequency() ) );
         }
@@ -1406,31 +1488,30 @@ Morpher::interpolateParameters( const Breakpoint & srcBkpt, const Breakpoint & t
 // ---------------------------------------------------------------------------
 //! Compute morphed parameter values at the specified time, using
 //! the source Breakpoint (assumed to correspond exactly to the
-//! specified time) and the target Partial (whose parameters are
-//! examined at the specified time). Append the morphed Breakpoint
-//! to newp only if the source should contribute to the morph at
-//! the specified time.
+//! specified time) and the parameters of the target Partial at 
+//! that time. Append the morphed Breakpoint to newp only if the 
+//! source should contribute to the morph at the specified time.
 //!
 //! If the target Partial is a dummy Partial (no Breakpoints), fade the
 //! source instead of morphing.
 //!
 //! \param  srcBkpt is the Breakpoint corresponding to a morph function
 //!         value of 0.
-//! \param  tgtPartial is the Partial corresponding to a morph function
-//!         value of 1, evaluated at the specified time.
-//! \param  time is the time corresponding to srcBkpt (used
-//!         to evaluate the morphing functions and tgtPartial).
+//! \param  tgtBkpt is the target Partial evaluated at the specified 
+//!         time, 0 if the target is a dummy Partial (no Breakpoints).
+//! \param  time is the time corresponding to srcBkpt.
+//! \param  fweight, aweight, bweight are the morphing functions 
+//!         evaluated at the specified time.
 //! \param  newp is the morphed Partial under construction, the morphed
 //!         Breakpoint is added to this Partial.
+//! \param  srcRef, tgtRef evaluate the source and target reference 
+//!         Partials along the Breakpoint times of the morph.
 //
 void
-Morpher::appendMorphedSrc( Breakpoint srcBkpt, const Partial & tgtPartial, 
-                           double time, Partial & newp  )
+Morpher::appendMorphedSrc( Breakpoint srcBkpt, const Breakpoint * tgtBkpt, double time, 
+                           double fweight, double aweight, double bweight, Partial & newp,
+                           PartialCursor & srcRef, PartialCursor & tgtRef ) const
 {
-    double fweight = _freqFunction->valueAt( time );
-    double aweight = _ampFunction->valueAt( time );
-    double bweight = _bwFunction->valueAt( time );
-    
     //  Need to insert a null (0 amplitude) Breakpoint
     //  if src and tgt are 0 amplitude but the morphed
     //  Partial is not. In rare cases, it is possible
@@ -1439,8 +1520,8 @@ Morpher::appendMorphedSrc( Breakpoint srcBkpt, const Partial & tgtPartial,
     bool needNull = ( newp.numBreakpoints() != 0 ) &&
                     ( newp.last().amplitude() != 0 ) &&
                     ( srcBkpt.amplitude() == 0) &&
-                    ( tgtPartial.numBreakpoints() != 0 ) &&
-                    ( tgtPartial.amplitudeAt( time ) == 0 );
+                    ( 0 != tgtBkpt ) &&
+                    ( tgtBkpt->amplitude() == 0 );
 
     //  Don't insert Breakpoints at src times if all 
     //  morph functions equal 1 (or > MaxMorphParam),
@@ -1454,9 +1535,9 @@ Morpher::appendMorphedSrc( Breakpoint srcBkpt, const Partial & tgtPartial,
         
         // adjust source Breakpoint frequencies according to the reference
         // Partial (if a reference has been specified):
-        adjustFrequency( srcBkpt, _srcRefPartial, newp.label(), _freqFixThresholdDb, time );
+        adjustFrequency( srcBkpt, _srcRefPartial, srcRef, newp.label(), _freqFixThresholdDb, time );
             
-        if ( 0 == tgtPartial.numBreakpoints() )
+        if ( 0 == tgtBkpt )
         {
             //  no corresponding target Partial exists:
             if ( 0 == _tgtRefPartial.numBreakpoints() )
@@ -1470,28 +1551,28 @@ Morpher::appendMorphedSrc( Breakpoint srcBkpt, const Partial & tgtPartial,
                 //  reference Partial has been provided for tgt,
                 //  use it to construct a fake Breakpoint to morph
                 //  with the src:
-                Breakpoint tgtBkpt = _tgtRefPartial.parametersAt( time );
+                Breakpoint refBkpt = tgtRef.parametersAt( time );
                 double fscale = (double) newp.label() / _tgtRefPartial.label();
-                tgtBkpt.setFrequency( fscale * tgtBkpt.frequency() );
-                tgtBkpt.setPhase( fscale * tgtBkpt.phase() );
-                tgtBkpt.setAmplitude( 0 );
-                tgtBkpt.setBandwidth( 0 );
+                refBkpt.setFrequency( fscale * refBkpt.frequency() );
+                refBkpt.setPhase( fscale * refBkpt.phase() );
+                refBkpt.setAmplitude( 0 );
+                refBkpt.setBandwidth( 0 );
                 
                 // compute interpolated Breakpoint parameters:
-                newp.insert( time, interpolateParameters( srcBkpt, tgtBkpt, fweight, 
+                newp.insert( time, interpolateParameters( srcBkpt, refBkpt, fweight, 
                                                           aweight, bweight ) );
             }
         }    
         else
         {
-            Breakpoint tgtBkpt = tgtPartial.parametersAt( time );
+            Breakpoint tgtAdjusted = *tgtBkpt;
             
             // adjust target Breakpoint frequencies according to the reference
             // Partial (if a reference has been specified):
-            adjustFrequency( tgtBkpt, _tgtRefPartial, newp.label(), _freqFixThresholdDb, time );
+            adjustFrequency( tgtAdjusted, _tgtRefPartial, tgtRef, newp.label(), _freqFixThresholdDb, time );
             
             // compute interpolated Breakpoint parameters:
-            Breakpoint morphed = interpolateParameters( srcBkpt, tgtBkpt, fweight, 
+            Breakpoint morphed = interpolateParameters( srcBkpt, tgtAdjusted, fweight, 
                                                         aweight, bweight );
             newp.insert( time, morphed );
         }
@@ -1503,31 +1584,30 @@ Morpher::appendMorphedSrc( Breakpoint srcBkpt, const Partial & tgtPartial,
 // ---------------------------------------------------------------------------
 //! Compute morphed parameter values at the specified time, using
 //! the target Breakpoint (assumed to correspond exactly to the
-//! specified time) and the source Partial (whose parameters are
-//! examined at the specified time). Append the morphed Breakpoint
-//! to newp only if the target should contribute to the morph at
-//! the specified time.
+//! specified time) and the parameters of the source Partial at 
+//! that time. Append the morphed Breakpoint to newp only if the 
+//! target should contribute to the morph at the specified time.
 //!
 //! If the source Partial is a dummy Partial (no Breakpoints), fade the
 //! target instead of morphing.
 //!
 //! \param  tgtBkpt is the Breakpoint corresponding to a morph function
 //!         value of 1.
-//! \param  srcPartial is the Partial corresponding to a morph function
-//!         value of 0, evaluated at the specified time.
-//! \param  time is the time corresponding to srcBkpt (used
-//!         to evaluate the morphing functions and srcPartial).
+//! \param  srcBkpt is the source Partial evaluated at the specified 
+//!         time, 0 if the source is a dummy Partial (no Breakpoints).
+//! \param  time is the time corresponding to tgtBkpt.
+//! \param  fweight, aweight, bweight are the morphing functions 
+//!         evaluated at the specified time.
 //! \param  newp is the morphed Partial under construction, the morphed
 //!         Breakpoint is added to this Partial.
+//! \param  srcRef, tgtRef evaluate the source and target reference 
+//!         Partials along the Breakpoint times of the morph.
 //
 void
-Morpher::appendMorphedTgt( Breakpoint tgtBkpt, const Partial & srcPartial, 
-                           double time, Partial & newp  )
+Morpher::appendMorphedTgt( Breakpoint tgtBkpt, const Breakpoint * srcBkpt, double time, 
+                           double fweight, double aweight, double bweight, Partial & newp,
+                           PartialCursor & srcRef, PartialCursor & tgtRef ) const
 {    
-    double fweight = _freqFunction->valueAt( time );
-    double aweight = _ampFunction->valueAt( time );
-    double bweight = _bwFunction->valueAt( time );
-    
     //  Need to insert a null (0 amplitude) Breakpoint
     //  if src and tgt are 0 amplitude but the morphed
     //  Partial is not. In rare cases, it is possible
@@ -1536,8 +1616,8 @@ Morpher::appendMorphedTgt( Breakpoint tgtBkpt, const Partial & srcPartial,
     bool needNull = ( newp.numBreakpoints() != 0 ) &&
                     ( newp.last().amplitude() != 0 ) &&
                     ( tgtBkpt.amplitude() == 0) &&
-                    ( srcPartial.numBreakpoints() != 0 ) &&
-                    ( srcPartial.amplitudeAt( time ) == 0 );
+                    ( 0 != srcBkpt ) &&
+                    ( srcBkpt->amplitude() == 0 );
 
     //  Don't insert Breakpoints at src times if all 
     //  morph functions equal 0 (or < MinMorphParam),
@@ -1551,9 +1631,9 @@ Morpher::appendMorphedTgt( Breakpoint tgtBkpt, const Partial & srcPartial,
         
         // adjust target Breakpoint frequencies according to the reference
         // Partial (if a reference has been specified):
-        adjustFrequency( tgtBkpt, _tgtRefPartial, newp.label(), _freqFixThresholdDb, time );
+        adjustFrequency( tgtBkpt, _tgtRefPartial, tgtRef, newp.label(), _freqFixThresholdDb, time );
 
-        if ( 0 == srcPartial.numBreakpoints() )
+        if ( 0 == srcBkpt )
         {
             //  no corresponding source Partial exists:
             if ( 0 == _srcRefPartial.numBreakpoints() )
@@ -1567,28 +1647,28 @@ Morpher::appendMorphedTgt( Breakpoint tgtBkpt, const Partial & srcPartial,
                 //  reference Partial has been provided for src,
                 //  use it to construct a fake Breakpoint to morph
                 //  with the tgt:
-                Breakpoint srcBkpt = _srcRefPartial.parametersAt( time );
+                Breakpoint refBkpt = srcRef.parametersAt( time );
                 double fscale = (double) newp.label() / _srcRefPartial.label();
-                srcBkpt.setFrequency( fscale * srcBkpt.frequency() );
-                srcBkpt.setPhase( fscale * srcBkpt.phase() );
-                srcBkpt.setAmplitude( 0 );
-                srcBkpt.setBandwidth( 0 );
+                refBkpt.setFrequency( fscale * refBkpt.frequency() );
+                refBkpt.setPhase( fscale * refBkpt.phase() );
+                refBkpt.setAmplitude( 0 );
+                refBkpt.setBandwidth( 0 );
 
                 // compute interpolated Breakpoint parameters:
-                newp.insert( time, interpolateParameters( srcBkpt, tgtBkpt, fweight, 
+                newp.insert( time, interpolateParameters( refBkpt, tgtBkpt, fweight, 
                                                           aweight, bweight ) );
             }
         }
         else
         {
-            Breakpoint srcBkpt = srcPartial.parametersAt( time );
+            Breakpoint srcAdjusted = *srcBkpt;
 
             // adjust source Breakpoint frequencies according to the reference
             // Partial (if a reference has been specified):
-            adjustFrequency( srcBkpt, _srcRefPartial, newp.label(), _freqFixThresholdDb, time );
+            adjustFrequency( srcAdjusted, _srcRefPartial, srcRef, newp.label(), _freqFixThresholdDb, time );
 
             // compute interpolated Breakpoint parameters:           
-            Breakpoint morphed = interpolateParameters( srcBkpt, tgtBkpt, fweight, 
+            Breakpoint morphed = interpolateParameters( srcAdjusted, tgtBkpt, fweight, 
                                                         aweight, bweight );
             newp.insert( time, morphed );
         }
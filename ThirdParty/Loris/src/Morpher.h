@@ -111,6 +111,8 @@ class Morpher
                                     //! domain, if false (default) they  are morphed  
                                     //! in the linear domain.
     
+    unsigned int _numThreads;       //! threads morphing labels, 0 for all cores
+    
     
 //  -- public interface --
 public:
@@ -164,7 +166,7 @@ public:
     //!         value of 1, evaluated at the specified time.
     //! \param  assignLabel is the label assigned to the morphed Partial
     //! \return the morphed Partial
-    Partial morphPartials( Partial src, Partial tgt, int assignLabel );
+    Partial morphPartials( Partial src, Partial tgt, int assignLabel ) const;
     
     //! Bad legacy name for morphPartials.
     //! \deprecated Use morphPartials instead.
@@ -374,6 +376,16 @@ public:
     //! \throw  InvalidArgument if the specified gap is not positive
     void setMinBreakpointGap( double x );
 
+    //! Return the number of threads used to morph corresponding
+    //! Partials, 0 for one per hardware core. Default is 1.
+    unsigned int numThreads( void ) const;
+    
+    //! Set the number of threads used to morph corresponding Partials,
+    //! 0 for one per hardware core. Partials having different labels
+    //! are morphed independently, so the morphed Partials do not 
+    //! depend on the number of threads. Default is 1.
+    void setNumThreads( unsigned int n );
+
 
 //  -- reference Partial label access/mutation --
     
@@ -526,45 +538,47 @@ private:
     
     //! Compute morphed parameter values at the specified time, using
     //! the source Breakpoint (assumed to correspond exactly to the
-    //! specified time) and the target Partial (whose parameters are
-    //! examined at the specified time). Append the morphed Breakpoint
-    //! to newp only if the target should contribute to the morph at
-    //! the specified time.
-    //!
-    //! \pre    the target Partial may not be a dummy Partial (no Breakpoints).
+    //! specified time) and the parameters of the target Partial at 
+    //! that time. Append the morphed Breakpoint to newp only if the 
+    //! source should contribute to the morph at the specified time.
     //!
     //! \param  srcBkpt is the Breakpoint corresponding to a morph function
     //!         value of 0.
-    //! \param  tgtPartial is the Partial corresponding to a morph function
-    //!         value of 1, evaluated at the specified time.
-    //! \param  time is the time corresponding to srcBkpt (used
-    //!         to evaluate the morphing functions and tgtPartial).
+    //! \param  tgtBkpt is the target Partial evaluated at the specified 
+    //!         time, 0 if the target is a dummy Partial (no Breakpoints).
+    //! \param  time is the time corresponding to srcBkpt.
+    //! \param  fweight, aweight, bweight are the morphing functions 
+    //!         evaluated at the specified time.
     //! \param  newp is the morphed Partial under construction, the morphed
     //!         Breakpoint is added to this Partial.
+    //! \param  srcRef, tgtRef evaluate the source and target reference 
+    //!         Partials along the Breakpoint times of the morph.
     //
-    void appendMorphedSrc( Breakpoint srcBkpt, const Partial & tgtPartial, 
-                           double time, Partial & newp  );
+    void appendMorphedSrc( Breakpoint srcBkpt, const Breakpoint * tgtBkpt, double time, 
+                           double fweight, double aweight, double bweight, Partial & newp,
+                           PartialCursor & srcRef, PartialCursor & tgtRef ) const;
                            
     //! Compute morphed parameter values at the specified time, using
     //! the target Breakpoint (assumed to correspond exactly to the
-    //! specified time) and the source Partial (whose parameters are
-    //! examined at the specified time). Append the morphed Breakpoint
-    //! to newp only if the target should contribute to the morph at
-    //! the specified time.
-    //!
-    //! \pre    the source Partial may not be a dummy Partial (no Breakpoints).
+    //! specified time) and the parameters of the source Partial at 
+    //! that time. Append the morphed Breakpoint to newp only if the 
+    //! target should contribute to the morph at the specified time.
     //!
     //! \param  tgtBkpt is the Breakpoint corresponding to a morph function
     //!         value of 1.
-    //! \param  srcPartial is the Partial corresponding to a morph function
-    //!         value of 0, evaluated at the specified time.
-    //! \param  time is the time corresponding to srcBkpt (used
-    //!         to evaluate the morphing functions and srcPartial).
+    //! \param  srcBkpt is the source Partial evaluated at the specified 
+    //!         time, 0 if the source is a dummy Partial (no Breakpoints).
+    //! \param  time is the time corresponding to tgtBkpt.
+    //! \param  fweight, aweight, bweight are the morphing functions 
+    //!         evaluated at the specified time.
     //! \param  newp is the morphed Partial under construction, the morphed
     //!         Breakpoint is added to this Partial.
+    //! \param  srcRef, tgtRef evaluate the source and target reference 
+    //!         Partials along the Breakpoint times of the morph.
     //
-    void appendMorphedTgt( Breakpoint tgtBkpt, const Partial & srcPartial, 
-                           double time, Partial & newp  );
+    void appendMorphedTgt( Breakpoint tgtBkpt, const Breakpoint * srcBkpt, double time, 
+                           double fweight, double aweight, double bweight, Partial & newp,
+                           PartialCursor & srcRef, PartialCursor & tgtRef ) const;
                            
                            
 	//!	Parameterinterpolation helpers.
@@ -0,0 +1,279 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * NoiseBands.C
+ *
+ * Implementation of class Loris::NoiseBands, the residual of an analysis
+ * as energy envelopes of a few frequency bands, and of class
+ * Loris::RealtimeNoiseBands, which renders them as filtered noise.
+ *
+ */
+#if HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include "NoiseBands.h"
+#include "LorisExceptions.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(HAVE_M_PI) && (HAVE_M_PI)
+    const double Pi = M_PI;
+#else
+    const double Pi = 3.14159265358979324;
+#endif
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  bandEdge
+// ---------------------------------------------------------------------------
+//! Return the lower edge of a band in Hz, the edge of NumBands is the
+//! upper edge of the last band.
+double NoiseBands::bandEdge( int band )
+{
+    return lowestFrequency() * std::pow( highestFrequency() / lowestFrequency(), (double) band / NumBands );
+}
+
+// ---------------------------------------------------------------------------
+//  bandCenter
+// ---------------------------------------------------------------------------
+//! Return the center of a band in Hz (geometric mean of its edges).
+double NoiseBands::bandCenter( int band )
+{
+    return bandEdge( band ) * std::pow( highestFrequency() / lowestFrequency(), 0.5 / NumBands );
+}
+
+// ---------------------------------------------------------------------------
+//  bandOf
+// ---------------------------------------------------------------------------
+//! Return the band a frequency in Hz falls in, -1 if it is outside
+//! all of them.
+int NoiseBands::bandOf( double frequency )
+{
+    if ( frequency < lowestFrequency() || frequency >= highestFrequency() )
+        return -1;
+
+    const int band = (int) ( NumBands * std::log( frequency / lowestFrequency() )
+                                      / std::log( highestFrequency() / lowestFrequency() ) );
+    return std::min( band, (int) NumBands - 1 );
+}
+
+// ---------------------------------------------------------------------------
+//  addFrame
+// ---------------------------------------------------------------------------
+//! Append a frame, at a time after the last one.
+//!
+//! \param  time time of the frame in seconds
+//! \param  energies NumBands energies
+void NoiseBands::addFrame( double time, const float * energies )
+{
+    if ( ! m_times.empty() && time <= m_times.back() )
+        Throw( InvalidArgument, "Noise band frames must be added in time order." );
+
+    m_times.push_back( time );
+    m_energies.insert( m_energies.end(), energies, energies + NumBands );
+}
+
+// ---------------------------------------------------------------------------
+//  energiesAt
+// ---------------------------------------------------------------------------
+//! Compute the energies at a time, interpolated linearly between
+//! frames. They are zero before the first frame and after the last one.
+//!
+//! \param  time time in seconds
+//! \param  energies NumBands energies to fill
+void NoiseBands::energiesAt( double time, float * energies ) const
+{
+    if ( m_times.empty() || time < m_times.front() || time > m_times.back() )
+    {
+        std::fill_n( energies, (int) NumBands, 0.f );
+        return;
+    }
+
+    const std::size_t next = std::upper_bound( m_times.begin(), m_times.end(), time ) - m_times.begin();
+    if ( next >= m_times.size() )
+    {
+        std::copy_n( frameEnergies( m_times.size() - 1 ), (int) NumBands, energies );
+        return;
+    }
+
+    const float alpha = (float) ( ( time - m_times[next - 1] ) / ( m_times[next] - m_times[next - 1] ) );
+    const float * before = frameEnergies( next - 1 );
+    const float * after = frameEnergies( next );
+    for ( int b = 0; b < NumBands; ++b )
+        energies[b] = before[b] + alpha * ( after[b] - before[b] );
+}
+
+// ---------------------------------------------------------------------------
+//  clear
+// ---------------------------------------------------------------------------
+//! Remove all frames.
+void NoiseBands::clear( void )
+{
+    m_times.clear();
+    m_energies.clear();
+}
+
+// ---------------------------------------------------------------------------
+//  RealtimeNoiseBands constructor
+// ---------------------------------------------------------------------------
+RealtimeNoiseBands::RealtimeNoiseBands( void )
+{
+}
+
+// ---------------------------------------------------------------------------
+//  reset
+// ---------------------------------------------------------------------------
+//! Clear the filters, for a sound starting from silence.
+void RealtimeNoiseBands::reset( void )
+{
+    for ( Band & band : m_filters )
+    {
+        band.z1 = band.z2 = 0.f;
+        band.gain = 0.f;
+    }
+    m_sounding = false;
+}
+
+// ---------------------------------------------------------------------------
+//  updateFilters
+// ---------------------------------------------------------------------------
+//! Compute the band filters for a frequency scaling: a two pole bandpass
+//! (unity gain at the center) as wide as the band, moved with the
+//! Partials. White noise of unit variance through it has the power
+//! pi * center / ( Q * rate ) (its noise bandwidth is pi / 2 times its
+//! bandwidth), norm turns the energy of the band into the gain giving
+//! the filtered noise the power of a sinusoid of that energy.
+void RealtimeNoiseBands::updateFilters( double scaling )
+{
+    const double ratio = std::pow( NoiseBands::highestFrequency() / NoiseBands::lowestFrequency(), 1. / NoiseBands::NumBands );
+    const double Q = std::sqrt( ratio ) / ( ratio - 1. );
+
+    for ( int b = 0; b < NoiseBands::NumBands; ++b )
+    {
+        Band & band = m_filters[b];
+        const double center = NoiseBands::bandCenter( b ) * scaling;
+        band.audible = center * std::sqrt( ratio ) < 0.45 * m_sampleRate;
+        if ( ! band.audible )
+        {
+            band.z1 = band.z2 = 0.f;
+            band.gain = 0.f;
+            continue;
+        }
+
+        const double w0 = 2. * Pi * center / m_sampleRate;
+        const double alpha = std::sin( w0 ) / ( 2. * Q );
+        const double a0 = 1. + alpha;
+        band.b0 = (float) ( alpha / a0 );
+        band.a1 = (float) ( -2. * std::cos( w0 ) / a0 );
+        band.a2 = (float) ( ( 1. - alpha ) / a0 );
+        band.norm = (float) std::sqrt( Q * m_sampleRate / ( 2. * Pi * center ) );
+    }
+    m_scaling = scaling;
+}
+
+// ---------------------------------------------------------------------------
+//  render
+// ---------------------------------------------------------------------------
+//! Accumulate a block of noise into output. Band gains ramp linearly
+//! from the end of the previous block to the energies at endTime, the
+//! band filters are moved by frequency scaling, bands above Nyquist
+//! are not rendered.
+//!
+//! \param  output  The samples to accumulate into.
+//! \param  samples Number of samples to render.
+//! \param  endTime Time of the bands after the last sample, seconds.
+//! \param  scaling Frequency scaling of the sound (pitch of the note
+//!         relative to the original one).
+//! \param  gain    Gain at the beginning of the block.
+//! \param  gainStep Gain increment per sample.
+void RealtimeNoiseBands::render( float * output, int samples, double endTime, double scaling,
+                                 double gain, double gainStep )
+{
+    if ( ! isActive() || samples <= 0 )
+        return;
+
+    if ( scaling != m_scaling )
+        updateFilters( scaling );
+
+    float energies[NoiseBands::NumBands];
+    m_bands->energiesAt( endTime, energies );
+
+    float startGains[NoiseBands::NumBands];
+    float gainSteps[NoiseBands::NumBands];
+    m_sounding = false;
+    for ( int b = 0; b < NoiseBands::NumBands; ++b )
+    {
+        Band & band = m_filters[b];
+        const float target = band.audible ? (float) ( std::sqrt( std::max( energies[b], 0.f ) ) * band.norm * m_level ) : 0.f;
+        startGains[b] = band.gain;
+        gainSteps[b] = ( target - band.gain ) / samples;
+        band.gain = target;
+        m_sounding = m_sounding || target > 0.f;
+    }
+
+    //  the noise is shared by all the bands, a chunk of it at once
+    float noise[ChunkSize];
+    float mix[ChunkSize];
+    for ( int offset = 0; offset < samples; offset += ChunkSize )
+    {
+        const int n = std::min( (int) ChunkSize, samples - offset );
+        for ( int i = 0; i < n; ++i )
+        {
+            noise[i] = nextNoise();
+            mix[i] = 0.f;
+        }
+
+        for ( int b = 0; b < NoiseBands::NumBands; ++b )
+        {
+            Band & band = m_filters[b];
+            float g = startGains[b] + gainSteps[b] * offset;
+            const float step = gainSteps[b];
+            if ( ! band.audible || ( g == 0.f && step == 0.f ) )
+            {
+                //  silent bands start from silence again
+                band.z1 = band.z2 = 0.f;
+                continue;
+            }
+
+            float z1 = band.z1, z2 = band.z2;
+            for ( int i = 0; i < n; ++i )
+            {
+                const float x = noise[i];
+                const float y = band.b0 * x + z1;
+                z1 = z2 - band.a1 * y;
+                z2 = - band.b0 * x - band.a2 * y;
+                mix[i] += g * y;
+                g += step;
+            }
+            band.z1 = z1;
+            band.z2 = z2;
+        }
+
+        for ( int i = 0; i < n; ++i )
+            output[offset + i] += (float) ( gain + gainStep * ( offset + i ) ) * mix[i];
+    }
+}
+
+}	//	end of namespace Loris
@@ -0,0 +1,207 @@
+#ifndef INCLUDE_NOISE_BANDS_H
+#define INCLUDE_NOISE_BANDS_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * NoiseBands.h
+ *
+ * Definition of class Loris::NoiseBands, the residual of an analysis as
+ * energy envelopes of a few frequency bands, and of class
+ * Loris::RealtimeNoiseBands, which renders them as filtered noise.
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	class NoiseBands
+//
+//! Energy of the spectral peaks an analysis rejected (the energy
+//! AssociateBandwidth accumulates as surplus), summed in NumBands bands
+//! spaced logarithmically from LowestFrequency to HighestFrequency, one
+//! frame per analysis frame. It models the noise of a sound without
+//! Partials: RealtimeNoiseBands renders it as a few bands of filtered
+//! noise, at a cost which does not depend on the number of Partials.
+//!
+//! Energies are squared sinusoidal amplitudes, the way the bandwidth
+//! of Partials is computed, so a band of energy e sounds as noise of
+//! the power of a sinusoid of amplitude sqrt(e).
+//
+class NoiseBands
+{
+//	-- public interface --
+public:
+    //! Shared, immutable bands.
+    typedef std::shared_ptr<const NoiseBands> Ptr;
+
+    enum { NumBands = 24 };
+
+    //! Lower edge of the first band and upper edge of the last one, Hz.
+    static double lowestFrequency( void ) { return 50.; }
+    static double highestFrequency( void ) { return 20000.; }
+
+    //! Return the lower edge of a band in Hz, the edge of NumBands is the
+    //! upper edge of the last band.
+    static double bandEdge( int band );
+
+    //! Return the center of a band in Hz (geometric mean of its edges).
+    static double bandCenter( int band );
+
+    //! Return the band a frequency in Hz falls in, -1 if it is outside
+    //! all of them.
+    static int bandOf( double frequency );
+
+//	-- frames --
+    //! Append a frame, at a time after the last one.
+    //!
+    //! \param  time time of the frame in seconds
+    //! \param  energies NumBands energies
+    void addFrame( double time, const float * energies );
+
+    //! Return the number of frames.
+    std::size_t numFrames( void ) const { return m_times.size(); }
+
+    //! Return true if there are no frames.
+    bool empty( void ) const { return m_times.empty(); }
+
+    //! Return the time of a frame in seconds.
+    double frameTime( std::size_t frame ) const { return m_times[frame]; }
+
+    //! Return the NumBands energies of a frame.
+    const float * frameEnergies( std::size_t frame ) const { return m_energies.data() + frame * NumBands; }
+
+    //! Compute the energies at a time, interpolated linearly between
+    //! frames. They are zero before the first frame and after the last one.
+    //!
+    //! \param  time time in seconds
+    //! \param  energies NumBands energies to fill
+    void energiesAt( double time, float * energies ) const;
+
+    //! Remove all frames.
+    void clear( void );
+
+    //! Return a shared copy of the bands.
+    Ptr share( void ) const { return std::make_shared<const NoiseBands>( *this ); }
+
+//	-- private member variables --
+private:
+    std::vector<double> m_times;    //  frame times, ascending
+    std::vector<float> m_energies;  //  NumBands energies of each frame
+};
+
+// ---------------------------------------------------------------------------
+//	class RealtimeNoiseBands
+//
+//! Renders NoiseBands of a sound as white noise filtered by a bandpass
+//! per band, each scaled by the energy of its band. One noise generator
+//! feeds all the bands. It is the noise layer of a RealTimeSynthesizer,
+//! shared by all of its Partials. Nothing is allocated while rendering.
+//
+class RealtimeNoiseBands
+{
+//	-- public interface --
+public:
+    RealtimeNoiseBands( void );
+
+    //! Set the bands rendered, empty for none.
+    void setBands( NoiseBands::Ptr bands ) { m_bands = bands; reset(); }
+
+    //! Return the bands rendered, empty if there are none.
+    const NoiseBands::Ptr & bands( void ) const { return m_bands; }
+
+    //! Set the sample rate the noise is rendered at.
+    void setSampleRate( double rate ) { m_sampleRate = rate; m_scaling = 0.; }
+
+    //! Set the gain of the noise, 0 renders nothing (and costs nothing).
+    void setLevel( double level ) { m_level = level > 0. ? level : 0.; }
+
+    //! Return the gain of the noise.
+    double level( void ) const { return m_level; }
+
+    //! Return true if there is something to render.
+    bool isActive( void ) const { return m_bands && ! m_bands->empty() && ( m_level > 0. || m_sounding ); }
+
+    //! Clear the filters, for a sound starting from silence.
+    void reset( void );
+
+    //! Accumulate a block of noise into output. Band gains ramp linearly
+    //! from the end of the previous block to the energies at endTime, the
+    //! band filters are moved by frequency scaling, bands above Nyquist
+    //! are not rendered.
+    //!
+    //! \param  output  The samples to accumulate into.
+    //! \param  samples Number of samples to render.
+    //! \param  endTime Time of the bands after the last sample, seconds.
+    //! \param  scaling Frequency scaling of the sound (pitch of the note
+    //!         relative to the original one).
+    //! \param  gain    Gain at the beginning of the block.
+    //! \param  gainStep Gain increment per sample.
+    void render( float * output, int samples, double endTime, double scaling,
+                 double gain, double gainStep );
+
+//	-- private helpers --
+private:
+    //! Compute the band filters for a frequency scaling.
+    void updateFilters( double scaling );
+
+    //! Return the next sample of white noise, of unit variance.
+    float nextNoise( void )
+    {
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return (float) ( (int32_t) m_seed * ( 1.7320508 / 2147483648. ) );
+    }
+
+//	-- private member variables --
+private:
+    enum { ChunkSize = 64 };    //  samples of noise generated at once
+
+    //  bandpass of a band, with the gain turning its energy into the
+    //  amplitude of the filtered noise
+    struct Band
+    {
+        float b0 = 0.f, a1 = 0.f, a2 = 0.f;     //  b1 is 0 and b2 is -b0
+        float z1 = 0.f, z2 = 0.f;
+        float norm = 0.f;
+        float gain = 0.f;       //  gain at the end of the last block
+        bool audible = false;
+    };
+
+    NoiseBands::Ptr m_bands;
+    Band m_filters[NoiseBands::NumBands];
+    double m_sampleRate = 44100.;
+    double m_scaling = 0.;      //  scaling the filters were computed for
+    double m_level = 0.;
+    bool m_sounding = false;    //  some band gain was not zero at the end of the last block
+    uint32_t m_seed = 22222;
+};
+
+}	//	end of namespace Loris
+
+#endif /* ndef INCLUDE_NOISE_BANDS_H */
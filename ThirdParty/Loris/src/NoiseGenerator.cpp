@@ -108,7 +108,14 @@ NoiseGenerator::seed( double newSeed )
 //	DON'T use integer conversion, because long int ins't as long 
 //	as double's mantissa!
 //
-static inline double trunc( double x ) { double y; std::modf(x, &y); return y; }
+//	Doubles of magnitude 2^52 and more have no fraction, smaller ones are
+//	truncated exactly by conversion to a 64-bit integer, the same as by 
+//	std::modf() but without a call per random number.
+//
+static inline double trunc( double x ) 
+{ 
+	return std::fabs( x ) < 4503599627370496. ? double( (long long) x ) : x; 
+}
 
 inline double
 NoiseGenerator::uniform( void )
@@ -183,5 +190,24 @@ NoiseGenerator::sample( void )
 	return sample;
 }
 
+// ---------------------------------------------------------------------------
+//	generate
+// ---------------------------------------------------------------------------
+//!	Fill the half-open (STL-style) range of doubles with new samples,
+//!	the same samples as calling sample() for each, but without a
+//!	call per sample.
+//!
+//!	\param begin is the beginning of the range of samples
+//!	\param end is the end of the range of samples
+//
+void 
+NoiseGenerator::generate( double * begin, double * end )
+{
+	for ( double * it = begin; it != end; ++it )
+	{
+		*it = gaussian_normal();
+	}
+}
+
 
 }	//	end of namespace Loris
@@ -77,6 +77,16 @@ public:
 	//!	\sa sample
 	double operator() ( void ) 	{ return sample(); }
 	
+	//	generate
+	//
+	//!	Fill the half-open (STL-style) range of doubles with new samples,
+	//!	the same samples as calling sample() for each, but without a
+	//!	call per sample.
+	//!
+	//!	\param begin is the beginning of the range of samples
+	//!	\param end is the end of the range of samples
+	void generate( double * begin, double * end );
+	
 
 //	--- implementation ---
 private:
@@ -38,6 +38,9 @@
  *	streamed onto debugger are never posted nor are they otherwise
  *	accessible.
  *	
+ *	LORIS_DEBUGGER is used in place of debugger, so that debugging
+ *	information costs nothing when Debug_Loris is not defined.
+ *	
  *	Notifier.h may be included in c files. The stream declarations are
  *	omitted, but the notification handler routines are accessible.
  *	
@@ -85,6 +88,21 @@ static std::ostream & debugger = getDebuggerStream();
 	characters streamed onto debugger are never posted nor are they
 	otherwise accessible.
  */
+
+//	Loris streams debugging information onto LORIS_DEBUGGER instead of
+//	debugger, for example:
+//
+//		LORIS_DEBUGGER << "found " << n << " Partials" << endl;
+//
+//	When Debug_Loris is not defined, the statement is never executed and
+//	the compiler removes it, so nothing is formatted, not even the values
+//	streamed are computed. (The dead else branch keeps the statement safe
+//	in an unbraced if.)
+#if defined( Debug_Loris )
+#define LORIS_DEBUGGER Loris::debugger
+#else
+#define LORIS_DEBUGGER if ( true ) {} else Loris::debugger
+#endif
  
 //	for convenience, import endl and ends from std into Loris:
 using std::endl;
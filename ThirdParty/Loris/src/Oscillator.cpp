@@ -43,7 +43,9 @@
 #include "Partial.h"
 #include "Notifier.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <vector>
 
 #if defined(HAVE_M_PI) && (HAVE_M_PI)
@@ -184,22 +186,46 @@ Oscillator::oscillate(double* begin, double* end,
     const double dAmp = (targetAmp - m_instamplitude)  * dTime;
     const double dBw = (targetBw - m_instbandwidth)  * dTime;
 
-    //  Use temporary local variables for speed.
-    //  Probably not worth it when I am computing square roots
-    //  and cosines...
     double ph = m_determphase;
     double f = m_instfrequency;
     double a = m_instamplitude;
     double bw = m_instbandwidth;
 
-    //	Also use a more efficient sample loop when the bandwidth is zero.
-    if (0 < bw || 0 < dBw)
+    //  Samples are computed a chunk at a time. The phase step from
+    //  sample k to k + 1 is
+    //
+    //      ph(k + 1) - ph(k) = f + (2k + 1) * dFreqOver2,
+    //
+    //  so the phasor z(k) = exp(i ph(k)) is rotated every sample by
+    //  w(k) = exp(i (f + (2k + 1) * dFreqOver2)), and w is rotated by
+    //  the constant c = exp(i 2 dFreqOver2). The real part of z is the
+    //  cosine, so there are only multiplies and adds per sample. Both
+    //  phasors are computed exactly at the beginning of every chunk,
+    //  so rounding errors do not accumulate (see also PhasorKernel of
+    //  RealtimeOscillatorBank).
+    //
+    //  The noise of a chunk is generated and filtered at once, and
+    //  the amplitude modulation due to bandwidth of all its samples is 
+    //  computed before the samples, in a loop the compiler can
+    //  vectorize. There is no modulation when there is no bandwidth.
+    const bool noisy = (0 < bw || 0 < dBw);
+    const int ChunkSize = 64;
+    double mod[ChunkSize];
+
+    //  use math functions in namespace std:
+    using namespace std;
+
+    const double cr = cos(2. * dFreqOver2);
+    const double ci = sin(2. * dFreqOver2);
+
+    while (begin != end)
     {
-        double am, nz;
-        for (double* putItHere = begin; putItHere != end; ++putItHere)
+        const int n = (int) min<ptrdiff_t>(ChunkSize, end - begin);
+
+        if (noisy)
         {
-            //  use math functions in namespace std:
-            using namespace std;
+            m_modulator.generate(mod, mod + n);
+            m_filter.process(mod, mod, n);
 
             //  compute amplitude modulation due to bandwidth:
             //
@@ -209,54 +235,44 @@ Oscillator::oscillate(double* begin, double* end,
             //  carrier amp: sqrt( 1. - bandwidth ) * amp
             //  modulation index: sqrt( 2. * bandwidth ) * amp
             //
-            nz = m_filter.apply(m_modulator.sample());
-            am = sqrt(1. - bw) + (nz * sqrt(2. * bw));
-
-            //  compute a sample and add it into the buffer:
-            *putItHere += am * a * cos(ph);
-
-            //  update the instantaneous oscillator state:
-            f += dFreqOver2;
-            ph += f;   //  frequency is radians per sample
-            f += dFreqOver2;
-            a += dAmp;
-            bw += dBw;
-            if (bw < 0.)
+            for (int k = 0; k < n; ++k)
             {
-                bw = 0.;
+                const double bwk = max(0., bw + k * dBw);
+                mod[k] = sqrt(1. - bwk) + (mod[k] * sqrt(2. * bwk));
             }
-        }   // end of sample computation loop
-    }
-    else
-    {
-        for (double* putItHere = begin; putItHere != end; ++putItHere)
-        {
-            //  use math functions in namespace std:
-            using namespace std;
+        }
 
-            //	no modulation when there is no bandwidth
+        //  exact phasors at the beginning of the chunk
+        double zr = cos(ph), zi = sin(ph);
+        double wr = cos(f + dFreqOver2), wi = sin(f + dFreqOver2);
 
+        for (int k = 0; k < n; ++k)
+        {
             //  compute a sample and add it into the buffer:
-            *putItHere += a * cos(ph);
-
-            //  update the instantaneous oscillator state:
-            f += dFreqOver2;
-            ph += f;   //  frequency is radians per sample
-            f += dFreqOver2;
-            a += dAmp;
+            double s = (a + k * dAmp) * zr;
+            if (noisy)
+            {
+                s *= mod[k];
+            }
+            begin[k] += s;
+
+            //  rotate the phasor, and its rotation:
+            const double nzr = zr * wr - zi * wi;
+            zi = zr * wi + zi * wr;
+            zr = nzr;
+            const double nwr = wr * cr - wi * ci;
+            wi = wr * ci + wi * cr;
+            wr = nwr;
         }   // end of sample computation loop
 
-    }
+        //  advance the state to the end of the chunk in closed form:
+        ph = m2pi(ph + n * (f + n * dFreqOver2));
+        f += 2 * n * dFreqOver2;
+        a += n * dAmp;
+        bw = max(0., bw + n * dBw);
 
-
-    //	copy out of the local variables?
-    //	no need because we are assigning to the target
-    //	values below:
-    /*
-     m_instfrequency = f;
-     m_instamplitude = a;
-     m_instbandwidth = bw;
-     */
+        begin += n;
+    }
 
     //  wrap phase to prevent eventual loss of precision at
     //  high oscillation frequencies:
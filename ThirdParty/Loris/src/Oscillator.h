@@ -144,6 +144,13 @@ public:
         return m_filter;
     }
 
+    //! Return access to the noise generator of this oscillator,
+    //! (can use this access to seed it).
+    NoiseGenerator& modulator(void)
+    {
+        return m_modulator;
+    }
+
     // --- static members ---
 
     //! Static local function for obtaining a prototype Filter
@@ -0,0 +1,223 @@
+#ifndef INCLUDE_PARALLELFOR_H
+#define INCLUDE_PARALLELFOR_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ *	ParallelFor.h
+ *
+ *	Definition of Loris::parallelFor and Loris::parallelForEach, used
+ *  by the Partial operators (Channelizer, Distiller, Sieve, Resampler,
+ *  Dilator) to process independent Partials or labels concurrently.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cfenv>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	resolveNumThreads
+// ---------------------------------------------------------------------------
+//! Return the number of threads to use for a requested thread count:
+//! 0 means one thread per hardware core.
+//
+inline unsigned int resolveNumThreads( unsigned int numThreads )
+{
+    if ( 0 == numThreads )
+    {
+        numThreads = std::max( std::thread::hardware_concurrency(), 1u );
+    }
+    return numThreads;
+}
+
+// ---------------------------------------------------------------------------
+//	FloatingPointEnvironment
+// ---------------------------------------------------------------------------
+//! The floating point environment of the thread constructing it, rounding
+//! and, where the platform keeps them there (SSE, AArch64), flushing of
+//! denormals to zero. Threads started to help the calling thread apply it
+//! first, so they compute the way it does instead of the default way.
+//
+class FloatingPointEnvironment
+{
+public:
+    FloatingPointEnvironment( void ) { std::fegetenv( &m_env ); }
+    
+    //! Make this the environment of the calling thread.
+    void apply( void ) const { std::fesetenv( &m_env ); }
+    
+private:
+    std::fenv_t m_env;
+};
+
+// ---------------------------------------------------------------------------
+//	parallelFor
+// ---------------------------------------------------------------------------
+//! Call fn( i ) for every i in [0, count), using up to numThreads
+//! threads (0 for one per hardware core). Threads take indices in
+//! order until all are done, the calling thread is one of them.
+//! If fn throws, the remaining indices are skipped and the first
+//! exception (in thread order) is rethrown after all threads are done.
+//! If no more threads can be started, the ones running do the work.
+//! Threads started work in the floating point environment of the 
+//! calling thread (see FloatingPointEnvironment).
+//!
+//! \param  count is the number of indices
+//! \param  numThreads is the largest number of threads to use
+//! \param  fn is called with each index, concurrently for different
+//!         indices
+//
+template< typename Fn >
+void parallelFor( std::size_t count, unsigned int numThreads, Fn fn )
+{
+    numThreads = std::min( resolveNumThreads( numThreads ),
+                           (unsigned int) std::max( count, std::size_t( 1 ) ) );
+    if ( 1 == numThreads )
+    {
+        for ( std::size_t i = 0; i < count; ++i )
+        {
+            fn( i );
+        }
+        return;
+    }
+
+    std::atomic< std::size_t > next( 0 );
+    std::vector< std::exception_ptr > errors( numThreads );
+    const FloatingPointEnvironment environment;
+    auto work = [&]( unsigned int t )
+    {
+        if ( 0 != t )
+        {
+            environment.apply();
+        }
+        try
+        {
+            for ( std::size_t i = next++; i < count; i = next++ )
+            {
+                fn( i );
+            }
+        }
+        catch ( ... )
+        {
+            errors[ t ] = std::current_exception();
+            next = count;
+        }
+    };
+
+    std::vector< std::thread > threads;
+    for ( unsigned int t = 1; t < numThreads; ++t )
+    {
+        try
+        {
+            threads.emplace_back( work, t );
+        }
+        catch ( std::system_error & )
+        {
+            //  no more threads, the others will do the work:
+            break;
+        }
+    }
+    work( 0 );
+    for ( std::thread & thread : threads )
+    {
+        thread.join();
+    }
+    for ( std::exception_ptr & error : errors )
+    {
+        if ( error )
+        {
+            std::rethrow_exception( error );
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+//	parallelForEachIn
+// ---------------------------------------------------------------------------
+//! Helpers of parallelForEach: elements of a sequential range (a list)
+//! are collected in a vector first, a random access range (a vector or
+//! a deque) is indexed directly.
+//
+template< typename Iter, typename Fn >
+void parallelForEachIn( Iter begin, Iter end, unsigned int numThreads, Fn & fn,
+                        std::input_iterator_tag )
+{
+    std::vector< decltype( &*begin ) > elements;
+    for ( ; begin != end; ++begin )
+    {
+        elements.push_back( &*begin );
+    }
+    parallelFor( elements.size(), numThreads,
+                 [&]( std::size_t i ) { fn( *elements[ i ] ); } );
+}
+
+template< typename Iter, typename Fn >
+void parallelForEachIn( Iter begin, Iter end, unsigned int numThreads, Fn & fn,
+                        std::random_access_iterator_tag )
+{
+    parallelFor( std::size_t( end - begin ), numThreads,
+                 [&]( std::size_t i ) { fn( begin[ i ] ); } );
+}
+
+// ---------------------------------------------------------------------------
+//	parallelForEach
+// ---------------------------------------------------------------------------
+//! Call fn( element ) for every element on the half-open (STL-style)
+//! range [begin, end), using up to numThreads threads (0 for one per
+//! hardware core), see parallelFor. A sequential range is only
+//! traversed once, so any iterator type will do (Partials are usually
+//! in a list), random access ranges are not copied at all.
+//!
+//! \param  begin is the beginning of the range of elements
+//! \param  end is (one-past) the end of the range of elements
+//! \param  numThreads is the largest number of threads to use
+//! \param  fn is called with each element, concurrently for different
+//!         elements
+//
+template< typename Iter, typename Fn >
+void parallelForEach( Iter begin, Iter end, unsigned int numThreads, Fn fn )
+{
+    if ( 1 == numThreads )
+    {
+        while ( begin != end )
+        {
+            fn( *begin++ );
+        }
+        return;
+    }
+
+    parallelForEachIn( begin, end, numThreads, fn,
+                       typename std::iterator_traits< Iter >::iterator_category() );
+}
+
+}	//	end of namespace Loris
+
+#endif /* ndef INCLUDE_PARALLELFOR_H */
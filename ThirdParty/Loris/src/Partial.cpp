@@ -58,10 +58,10 @@ namespace Loris {
 //	comparitor for elements in Partial::container_type
 typedef Partial::container_type::value_type Partial_value_type;
 static 
-bool order_by_time( const Partial_value_type & x, const Partial_value_type & y )
+bool earlier_than( const Partial_value_type & x, double time )
 {
 	//	Partial_value_type is a (time,Breakpoint) pair
-	return x.first < y.first;
+	return x.first < time;
 }
 
 //	--- concering the type of Partial::container_type
@@ -77,7 +77,16 @@ bool order_by_time( const Partial_value_type & x, const Partial_value_type & y )
 //	is easy to change the container type, but it is a much harder
 //	project to find all the places in Loris that rely on iterators
 //	that remain valid after insertions and removals.
-#undef USE_VECTOR
+//
+//	Users of Partial in this library do not keep iterators across
+//	insertions and removals any more (Distiller's merge was the
+//	last one), so vector is the default. Every Breakpoint was a
+//	separate heap node with map, and iterating Partials in analysis,
+//	resampling, channelization and synthesis setup was pointer
+//	chasing. Define LORIS_PARTIAL_MAP to 1 to go back to map.
+#if !( defined(LORIS_PARTIAL_MAP) && LORIS_PARTIAL_MAP )
+	#define USE_VECTOR
+#endif
 
 
 // -- construction --
@@ -120,6 +129,20 @@ Partial::Partial( const Partial & other ) :
 //	++DebugCounter;
 }
 
+// ---------------------------------------------------------------------------
+//	Partial move constructor
+// ---------------------------------------------------------------------------
+//!	Return a new Partial that takes the Breakpoints and the label
+//!	of another Partial, without copying them. The other Partial
+//!	is left empty.
+//
+Partial::Partial( Partial && other ) :
+	_breakpoints( std::move( other._breakpoints ) ),
+	_label( other._label )
+{
+	other._breakpoints.clear();
+}
+
 // ---------------------------------------------------------------------------
 //	Partial destructor
 // ---------------------------------------------------------------------------
@@ -148,6 +171,24 @@ Partial::operator=( const Partial & rhs )
 	return *this;
 }
 
+// ---------------------------------------------------------------------------
+//	operator= (move)
+// ---------------------------------------------------------------------------
+//!	Make this Partial take the Breakpoints and the label of another 
+//!	Partial, without copying them. The other Partial is left empty.
+//
+Partial & 
+Partial::operator=( Partial && rhs )
+{
+	if ( this != &rhs )
+	{
+		_breakpoints = std::move( rhs._breakpoints );
+		_label = rhs._label;
+		rhs._breakpoints.clear();
+	}
+	return *this;
+}
+
 // -- container-dependent implementation --
 
 // ---------------------------------------------------------------------------
@@ -204,8 +245,7 @@ Partial::end( void )
 Partial::iterator 
 Partial::erase( Partial::iterator beg, Partial::iterator end )
 {
-	_breakpoints.erase( beg._iter, end._iter );
-	return end;
+	return _breakpoints.erase( beg._iter, end._iter );
 }
 
 // ---------------------------------------------------------------------------
@@ -220,8 +260,7 @@ Partial::findAfter( double time ) const
 {
 #if defined(USE_VECTOR) 
 	//	see note above
-	Partial_value_type dummy( time, Breakpoint() );
-	return std::upper_bound( _breakpoints.begin(), _breakpoints.end(), dummy, order_by_time );
+	return std::lower_bound( _breakpoints.begin(), _breakpoints.end(), time, earlier_than );
 #else
 	return _breakpoints.lower_bound( time );
 #endif
@@ -236,8 +275,7 @@ Partial::findAfter( double time )
 {
 #if defined(USE_VECTOR) 
 	//	see note above
-	Partial_value_type dummy( time, Breakpoint() );
-	return std::upper_bound( _breakpoints.begin(), _breakpoints.end(), dummy, order_by_time );
+	return std::lower_bound( _breakpoints.begin(), _breakpoints.end(), time, earlier_than );
 #else
 	return _breakpoints.lower_bound( time );
 #endif
@@ -255,22 +293,32 @@ Partial::insert( double time, const Breakpoint & bp )
 {
 #if defined(USE_VECTOR) 
 	//	see note above
+    
+    //  do not insert a Breakpoint closer than 1ns away
+    //  from the nearest existing Breakpoint (same as below
+    //  for map):
+    static const double MinTimeDif = 1.0E-9; // 1 ns
+    
 	//	find the position at which to insert the new Breakpoint:
-	Partial_value_type dummy( time, Breakpoint() );
-	Partial::container_type::iterator insertHere = 
-		std::lower_bound( _breakpoints.begin(), _breakpoints.end(), dummy, order_by_time );
-		
-	//	if the time at insertHere is equal to the insertion time,
-	//	simply replace the Breakpoint, otherwise insert:
-	if ( insertHere->first == time )
-	{
-		insertHere->second = bp;
-	}
-	else
-	{
-		insertHere = _breakpoints.insert( insertHere, Partial_value_type(time, bp) );
+	container_type::iterator pos = 
+		std::lower_bound( _breakpoints.begin(), _breakpoints.end(), time, earlier_than );
+    
+    //  a Breakpoint too close to the insertion time is replaced
+    //  in place, order is kept because there is no other Breakpoint
+    //  between its time and the insertion time:
+    if ( _breakpoints.end() != pos && MinTimeDif > pos->first - time )
+    {
+        *pos = Partial_value_type( time, bp );
+    }
+    else if ( _breakpoints.begin() != pos && MinTimeDif > time - (pos - 1)->first )
+    {
+        *(--pos) = Partial_value_type( time, bp );
+    }
+    else
+    {
+		pos = _breakpoints.insert( pos, Partial_value_type( time, bp ) );
 	}
-	return insertHere;
+	return pos;
 #else
     /*
     //  this allows Breakpoints to be inserted arbitrarily
@@ -745,6 +793,8 @@ static inline double wrapPi( double x )
     return x + ( TwoPi * ROUND(-x/TwoPi) );
 }
 
+static Breakpoint interpolateBefore( Partial::const_iterator it, double time );
+
 // ---------------------------------------------------------------------------
 //	parametersAt
 // ---------------------------------------------------------------------------
@@ -826,36 +876,79 @@ Partial::parametersAt( double time, double fadeTime ) const
 	{
         //	findAfter returns the position of the earliest
         //	Breakpoint later than time, or the end
-        //	position if no such Breakpoint exists:
-        Partial::const_iterator it = findAfter( time );
-	
-        //	interpolate between it and its predeccessor
+        //	position if no such Breakpoint exists
         //	(we checked already that it is not begin or end):
-        const Breakpoint & hi = it.breakpoint();
-		double hitime = it.time();
-        const Breakpoint & lo = (--it).breakpoint();
-        double lotime = it.time();
-        
-        double alpha = (time - lotime) / (hitime - lotime);
-		
-        //  frequency:
-        freq = (alpha * hi.frequency()) + ((1. - alpha) * lo.frequency());
-			   
-        //  amplitude:	
-        amp = (alpha * hi.amplitude()) + ((1. - alpha) * lo.amplitude());
-
-        //  bandwidth:
-        bw = (alpha * hi.bandwidth()) + ((1. - alpha) * lo.bandwidth());
-        
-        //  phase:
-        //  interpolated phase is computed from the interpolated frequency 
-        //  and offset from the phase of the preceding Breakpoint:
-        double favg = 0.5 * ( lo.frequency() + freq ); // + hi.frequency() );
-        double dp = 2. * Pi * (time - lotime) * favg;                   
-        ph = wrapPi( lo.phase() + dp );                        	
+        return interpolateBefore( findAfter( time ), time );
 	}
 	
 	return Breakpoint( freq, amp, bw, ph );
 }
 
+// ---------------------------------------------------------------------------
+//	interpolateBefore
+// ---------------------------------------------------------------------------
+//	Interpolate parameters at a time between the Breakpoint at a position
+//	and its predecessor, which must exist.
+//
+static Breakpoint interpolateBefore( Partial::const_iterator it, double time )
+{
+    const Breakpoint & hi = it.breakpoint();
+    double hitime = it.time();
+    const Breakpoint & lo = (--it).breakpoint();
+    double lotime = it.time();
+    
+    double alpha = (time - lotime) / (hitime - lotime);
+    
+    //  frequency:
+    double freq = (alpha * hi.frequency()) + ((1. - alpha) * lo.frequency());
+    
+    //  amplitude:	
+    double amp = (alpha * hi.amplitude()) + ((1. - alpha) * lo.amplitude());
+    
+    //  bandwidth:
+    double bw = (alpha * hi.bandwidth()) + ((1. - alpha) * lo.bandwidth());
+    
+    //  phase:
+    //  interpolated phase is computed from the interpolated frequency 
+    //  and offset from the phase of the preceding Breakpoint:
+    double favg = 0.5 * ( lo.frequency() + freq ); // + hi.frequency() );
+    double dp = 2. * Pi * (time - lotime) * favg;                   
+    double ph = wrapPi( lo.phase() + dp );                        	
+    
+    return Breakpoint( freq, amp, bw, ph );
+}
+
+// ---------------------------------------------------------------------------
+//	PartialCursor parametersAt
+// ---------------------------------------------------------------------------
+//!	Return the interpolated parameters of the Partial at the 
+//!	specified time, the same as Partial::parametersAt(). Inside the
+//!	Partial, the cursor walks forward to the first Breakpoint later
+//!	than the time, or searches again if the time is earlier than the
+//!	last one. Beyond its ends, nothing is searched anyway.
+//
+Breakpoint
+PartialCursor::parametersAt( double time, double fadeTime )
+{
+	if ( _partial.numBreakpoints() == 0 || _partial.startTime() >= time || _partial.endTime() <= time )
+	{
+		return _partial.parametersAt( time, fadeTime );
+	}
+	
+	if ( _next != _partial.begin() )
+	{
+		Partial::const_iterator prev = _next;
+		if ( (--prev).time() > time )
+		{
+			_next = _partial.findAfter( time );
+		}
+	}
+	while ( _next.time() <= time )
+	{
+		++_next;
+	}
+	
+	return interpolateBefore( _next, time );
+}
+
 }	//	end of namespace Loris
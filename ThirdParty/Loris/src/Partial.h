@@ -39,9 +39,10 @@
 #include "Breakpoint.h"
 #include "LorisExceptions.h"
 
+#include <iterator>
 #include <map>
-//#include <utility>
-//#include <vector>
+#include <utility>
+#include <vector>
 
 //	begin namespace
 namespace Loris {
@@ -98,12 +99,18 @@ public:
 //	-- types --
 
 	//!	underlying Breakpoint container type, used by 
-	//!	the iterator types defined below:
+	//!	the iterator types defined below. (time, Breakpoint)
+	//!	pairs are kept sorted by time in a contiguous vector,
+	//!	define LORIS_PARTIAL_MAP to 1 to use std::map instead.
+	//!	With the vector, insertion and removal invalidate
+	//!	iterators on the Partial.
+#if defined(LORIS_PARTIAL_MAP) && LORIS_PARTIAL_MAP
 	typedef std::map< double, Breakpoint > container_type;
-	
-	//	typedef std::vector< std::pair< double, Breakpoint > > container_type;
+#else
+	typedef std::vector< std::pair< double, Breakpoint > > container_type;
+#endif
 	//	see Partial.C for a discussion of issues surrounding the 
-	//	choice of std::map as a Breakpoint container.
+	//	choice of a Breakpoint container.
 
 	//! 32 bit type for labeling Partials
 	typedef int label_type;	
@@ -138,6 +145,13 @@ public:
 	//!	\param	other is the Partial to copy.
 	Partial( const Partial & other );
 	 
+	//!	Return a new Partial that takes the Breakpoints and the label
+	//!	of another Partial, without copying them. The other Partial
+	//!	is left empty.
+	//!
+	//!	\param	other is the Partial to move from.
+	Partial( Partial && other );
+	 
 	//!	Destroy this Partial.
 	~Partial( void );
 	 
@@ -150,6 +164,12 @@ public:
 	//!	\param	other is the Partial to copy.
 	Partial & operator=( const Partial & other );
 
+	//!	Make this Partial take the Breakpoints and the label of another 
+	//!	Partial, without copying them. The other Partial is left empty.
+	//!
+	//!	\param	other is the Partial to move from.
+	Partial & operator=( Partial && other );
+
 //	-- container-dependent implementation --
 
 	//!	Return an iterator refering to the position of the first
@@ -444,8 +464,9 @@ public:
 //	-- bidirectional iterator interface --
 
 	//! The iterator category, for copmpatibility with 
-	//! C++ standard library algorithms 
-	typedef BaseIterator::iterator_category	iterator_category;
+	//! C++ standard library algorithms (bidirectional for
+	//! any container type)
+	typedef std::bidirectional_iterator_tag	iterator_category;
 	
 	//! The type of element that can be accessed through this 
 	//! iterator (Breakpoint).
@@ -620,8 +641,9 @@ public:
 //	-- bidirectional iterator interface --
 
 	//! The iterator category, for copmpatibility with 
-	//! C++ standard library algorithms 
-	typedef BaseIterator::iterator_category	iterator_category;
+	//! C++ standard library algorithms (bidirectional for
+	//! any container type)
+	typedef std::bidirectional_iterator_tag	iterator_category;
 	
 	//! The type of element that can be accessed through this 
 	//! iterator (Breakpoint).
@@ -757,6 +779,47 @@ private:
 
 };	//	end of class Partial_ConstIterator
 
+// ---------------------------------------------------------------------------
+//	class PartialCursor
+//
+//!	A PartialCursor evaluates a Partial along a sweep of non-decreasing
+//!	times, as when it is evaluated at the Breakpoints of another Partial.
+//!	A position walks forward through the Breakpoints of the Partial, so
+//!	a sweep costs amortized constant time per value instead of a search
+//!	in the Breakpoint map. Earlier times are still evaluated correctly,
+//!	by searching again.
+//!
+//!	The Partial must outlive the cursor and must not be changed while
+//!	the cursor is used.
+//
+class PartialCursor
+{
+//	-- public interface --
+public:
+	//!	Construct a cursor at the beginning of a Partial.
+	explicit PartialCursor( const Partial & partial ) :
+		_partial( partial ),
+		_next( partial.begin() )
+	{
+	}
+	
+	//!	Return the interpolated parameters of the Partial at the 
+	//!	specified time, the same as Partial::parametersAt().
+	//!
+	//!	\param time is the time in seconds at which to evaluate the Partial
+	//!	\param fadeTime is the duration of the linear fade of amplitude
+	//!			at the ends of the Partial
+	//!	\throw Throw an InvalidPartial exception if the Partial has no
+	//!	Breakpoints.
+	Breakpoint parametersAt( double time, double fadeTime = Partial::ShortestSafeFadeTime );
+	
+//	-- implementation --
+private:
+	const Partial & _partial;
+	Partial::const_iterator _next;	//	first Breakpoint later than the last time
+	
+};	//	end of class PartialCursor
+
 // ---------------------------------------------------------------------------
 //	class InvalidPartial
 //
@@ -0,0 +1,918 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * PartialBank.C
+ *
+ * Implementation of class Loris::PartialBank, an immutable set of Partials
+ * prepared for real-time synthesis and shared by many synthesizers, and
+ * of class Loris::PartialMorph, a morph target of a PartialBank.
+ *
+ */
+#if HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include "PartialBank.h"
+#include "BreakpointUtils.h"
+#include "LorisExceptions.h"
+#include "Partial.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <type_traits>
+#include <utility>
+
+//  begin namespace
+namespace Loris {
+
+#if defined(HAVE_M_PI) && (HAVE_M_PI)
+	const double Pi = M_PI;
+#else
+	const double Pi = 3.14159265358979324;
+#endif
+
+const double PartialBank::CheckpointTime = 0.05;
+
+// ---------------------------------------------------------------------------
+//  startsBefore
+// ---------------------------------------------------------------------------
+//! Order of Partials in a bank: by the sample of their fade in breakpoint.
+static bool startsBefore( const PartialStruct & a, const PartialStruct & b )
+{
+    return a.startSample < b.startSample;
+}
+
+// ---------------------------------------------------------------------------
+//  PartialBank constructor
+// ---------------------------------------------------------------------------
+//!	Construct a bank from Partials. Empty Partials are skipped.
+//!
+//! \param  partials The Partials to synthesize, in any order. They are
+//!         sorted by their first sample, sorting them by start time
+//!         first saves only the sorting.
+//! \param  pitch original pitch of the partials
+//! \param  fadeTime fade in/out time in seconds
+//! \param  sampleRate sample rate used to compute breakpoint sample indices
+//! \param  encoding storage of Breakpoint parameters
+//! \param  phaseFree drop the phases of the Breakpoints, see isPhaseFree()
+PartialBank::PartialBank( const PartialList & partials, double pitch, double fadeTime, double sampleRate,
+                          Encoding encoding, bool phaseFree ) :
+    m_pitch( pitch ),
+    m_fadeTimeSec( fadeTime ),
+    m_srateHz( sampleRate ),
+    m_encoding( encoding ),
+    m_phaseFree( phaseFree )
+{
+    build( partials.begin(), partials.end() );
+}
+
+// ---------------------------------------------------------------------------
+//  PartialBank constructor (PartialVector)
+// ---------------------------------------------------------------------------
+//!	Construct a bank from Partials in contiguous storage, the same as
+//! from a PartialList of them.
+PartialBank::PartialBank( const PartialVector & partials, double pitch, double fadeTime, double sampleRate,
+                          Encoding encoding, bool phaseFree ) :
+    m_pitch( pitch ),
+    m_fadeTimeSec( fadeTime ),
+    m_srateHz( sampleRate ),
+    m_encoding( encoding ),
+    m_phaseFree( phaseFree )
+{
+    build( partials.begin(), partials.end() );
+}
+
+// ---------------------------------------------------------------------------
+//  build
+// ---------------------------------------------------------------------------
+//! Build the arrays from the Partials of a range, for the constructors.
+template< class Iter >
+void PartialBank::build( Iter begin, Iter end )
+{
+    std::size_t totalBreakpoints = 0, numPartials = 0;
+    for ( Iter it = begin; it != end; ++it )
+    {
+        if (it->numBreakpoints() > 0)
+            totalBreakpoints += it->numBreakpoints() + 2;// + fade in + fade out
+        ++numPartials;
+    }
+    
+    m_partials.reserve( numPartials );
+    m_sample.reserve( totalBreakpoints );
+    m_frequency.reserve( totalBreakpoints );
+    m_amplitude.reserve( totalBreakpoints );
+    m_bandwidth.reserve( totalBreakpoints );
+    m_phase.reserve( m_phaseFree ? 0 : totalBreakpoints );
+
+    for ( ; begin != end; ++begin )
+    {
+        const Partial & it = *begin;
+        if (it.numBreakpoints() <= 0) continue;
+
+        m_partials.push_back( PartialStruct() );
+        PartialStruct & pStruct = m_partials.back();
+
+        pStruct.numBreakpoints = it.numBreakpoints() + 2;// + fade in + fade out
+        pStruct.firstBreakpoint = (int) m_sample.size();
+        pStruct.label = it.label();
+        m_stereo = m_stereo || pStruct.channel() != PartialStruct::Center;
+
+        pStruct.startTime = ( m_fadeTimeSec < it.startTime() ) ? ( it.startTime() - m_fadeTimeSec ) : 0.;// compute fade in bp time
+        pStruct.endTime = it.endTime() + m_fadeTimeSec;// compute fade out bp time
+
+        // breakpoints
+        Partial::const_iterator jt = it.begin();
+        // fade in breakpoint, compute fade in time
+        append( pStruct.startTime, BreakpointUtils::makeNullBefore( jt.breakpoint(), it.startTime() - pStruct.startTime) );
+        pStruct.startSample = m_sample.back();
+
+        double sumF = 0;
+
+        for (; jt != it.end(); jt++)
+        {
+            sumF += jt->frequency();
+            pStruct.maxFrequency = std::max( pStruct.maxFrequency, (float) jt->frequency() );
+            append( jt.time(), jt.breakpoint() );
+        }
+
+        pStruct.avgFrequency = sumF / (float) it.numBreakpoints();
+
+        // fade out breakpoint
+        jt--;
+        append( jt.time() + m_fadeTimeSec, BreakpointUtils::makeNullAfter( jt.breakpoint(), m_fadeTimeSec ) );
+    }
+    
+    // synthesizers start partials by walking this array once per note, the
+    // order by start sample is the table of onsets (quantization done by the
+    // Resampler may swap partials starting close to each other)
+    if ( ! std::is_sorted( m_partials.begin(), m_partials.end(), startsBefore ) )
+    {
+        std::stable_sort( m_partials.begin(), m_partials.end(), startsBefore );
+        sortBreakpoints();
+    }
+    
+    // checkpoint phases are computed from the frequencies synthesizers decode
+    if ( m_encoding == CompactEncoding )
+        roundToCompact();
+    
+    computeMaxConcurrent();
+    computeCheckpoints();
+    computeFrequencyOrder();
+    for ( const PartialStruct & p : m_partials )
+        m_duration = std::max( m_duration, p.endTime );
+
+    m_numPartials = m_partials.size();
+    m_numBreakpoints = m_sample.size();
+    m_partialsPtr = m_partials.data();
+    m_samplePtr = m_sample.data();
+    if ( m_encoding == CompactEncoding )
+    {
+        encodeCompact();
+    }
+    else
+    {
+        m_parameterPtrs[0] = m_frequency.data();
+        m_parameterPtrs[1] = m_amplitude.data();
+        m_parameterPtrs[2] = m_bandwidth.data();
+        m_parameterPtrs[3] = m_phaseFree ? 0 : m_phase.data();
+    }
+    setBreakpointArrays();
+    m_numCheckpoints = m_checkpointFirst.size() - 1;
+    m_numCheckpointPartials = m_checkpointPartials.size();
+    m_checkpointFirstPtr = m_checkpointFirst.data();
+    m_checkpointPartialsPtr = m_checkpointPartials.data();
+    m_frequencyOrderPtr = m_frequencyOrder.data();
+}
+
+// ---------------------------------------------------------------------------
+//  sortBreakpoints
+// ---------------------------------------------------------------------------
+//! Store Breakpoints in the order of the Partials, after they were sorted
+//! by onset, so that Breakpoints played at once are close to each other.
+void PartialBank::sortBreakpoints( void )
+{
+    std::vector<int> sample;
+    std::vector<float> frequency, amplitude, bandwidth, phase;
+    sample.reserve( m_sample.size() );
+    frequency.reserve( m_sample.size() );
+    amplitude.reserve( m_sample.size() );
+    bandwidth.reserve( m_sample.size() );
+    phase.reserve( m_phase.size() );
+    
+    for ( PartialStruct & p : m_partials )
+    {
+        const int first = p.firstBreakpoint;
+        const int end = first + p.numBreakpoints;
+        p.firstBreakpoint = int( sample.size() );
+        sample.insert( sample.end(), m_sample.begin() + first, m_sample.begin() + end );
+        frequency.insert( frequency.end(), m_frequency.begin() + first, m_frequency.begin() + end );
+        amplitude.insert( amplitude.end(), m_amplitude.begin() + first, m_amplitude.begin() + end );
+        bandwidth.insert( bandwidth.end(), m_bandwidth.begin() + first, m_bandwidth.begin() + end );
+        if ( ! m_phaseFree )
+            phase.insert( phase.end(), m_phase.begin() + first, m_phase.begin() + end );
+    }
+    
+    m_sample.swap( sample );
+    m_frequency.swap( frequency );
+    m_amplitude.swap( amplitude );
+    m_bandwidth.swap( bandwidth );
+    m_phase.swap( phase );
+}
+
+// ---------------------------------------------------------------------------
+//  computeMaxConcurrent
+// ---------------------------------------------------------------------------
+//! Compute the largest number of Partials sounding at the same time, so
+//! that synthesizers can preallocate their list of active Partials. A Partial
+//! sounds from its fade in to its fade out breakpoint (both inclusive, so the
+//! count is an upper bound at block boundaries).
+void PartialBank::computeMaxConcurrent( void )
+{
+    // (sample, +1 for start / -1 for end), starts sort before ends at the same sample
+    std::vector< std::pair<int, int> > events;
+    events.reserve( 2 * m_partials.size() );
+    for ( const PartialStruct & p : m_partials )
+    {
+        events.push_back( std::make_pair( p.startSample, -1 ) );
+        events.push_back( std::make_pair( m_sample[p.firstBreakpoint + p.numBreakpoints - 1], 1 ) );
+    }
+    std::sort( events.begin(), events.end() );
+    
+    std::size_t sounding = 0;
+    m_maxConcurrent = 0;
+    for ( const auto & e : events )
+    {
+        if ( e.second < 0 )
+            m_maxConcurrent = std::max( m_maxConcurrent, ++sounding );
+        else
+            --sounding;
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  computeCheckpoints
+// ---------------------------------------------------------------------------
+//! Compute Partials playing at checkpoints, every CheckpointTime from
+//! sample 0. A Partial plays at a checkpoint if it is at or after its
+//! fade in breakpoint and before its fade out breakpoint. Its phase
+//! advances by the average frequency of every sample, as synthesizers
+//! advance it, and is not wrapped, so they can scale it by pitch.
+void PartialBank::computeCheckpoints( void )
+{
+    m_checkpointSamples = std::max( int( CheckpointTime * m_srateHz + 0.5 ), 1 );
+    const int interval = m_checkpointSamples;
+    
+    int lastSample = -1;
+    for ( const PartialStruct & p : m_partials )
+        lastSample = std::max( lastSample, m_sample[p.firstBreakpoint + p.numBreakpoints - 1] );
+    const std::size_t numCheckpoints = lastSample >= 0 ? std::size_t( lastSample / interval + 1 ) : 0;
+    
+    // checkpoints of a partial are first and last ones in [startSample, end)
+    m_checkpointFirst.assign( numCheckpoints + 1, 0 );
+    for ( const PartialStruct & p : m_partials )
+    {
+        const int end = m_sample[p.firstBreakpoint + p.numBreakpoints - 1];
+        for ( int c = ( std::max( p.startSample, 0 ) + interval - 1 ) / interval; c * interval < end; ++c )
+            m_checkpointFirst[c + 1]++;
+    }
+    for ( std::size_t c = 0; c < numCheckpoints; ++c )
+        m_checkpointFirst[c + 1] += m_checkpointFirst[c];
+    
+    // partials are visited by index, so every checkpoint lists them sorted
+    m_checkpointPartials.assign( m_checkpointFirst.back(), PartialCheckpoint() );
+    std::vector<std::uint32_t> filled( m_checkpointFirst.begin(), m_checkpointFirst.end() - 1 );
+    for ( std::size_t i = 0; i < m_partials.size(); ++i )
+    {
+        const PartialStruct & p = m_partials[i];
+        const int * sample = m_sample.data() + p.firstBreakpoint;
+        const float * frequency = m_frequency.data() + p.firstBreakpoint;
+        int k = 0;
+        double phase = 0.;  // advance to breakpoint k
+        
+        for ( int c = ( std::max( p.startSample, 0 ) + interval - 1 ) / interval; c * interval < sample[p.numBreakpoints - 1]; ++c )
+        {
+            const int at = c * interval;
+            for ( ; sample[k + 1] <= at; ++k )
+                phase += Pi * ( frequency[k] + frequency[k + 1] ) * ( sample[k + 1] - sample[k] ) / m_srateHz;
+            
+            const double x = double( at - sample[k] ) / ( sample[k + 1] - sample[k] );
+            const double atFrequency = frequency[k] + ( frequency[k + 1] - frequency[k] ) * x;
+            
+            PartialCheckpoint & checkpoint = m_checkpointPartials[filled[c]++];
+            checkpoint.partial = int( i );
+            checkpoint.breakpoint = k;
+            checkpoint.phase = phase + Pi * ( frequency[k] + atFrequency ) * ( at - sample[k] ) / m_srateHz;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  computeFrequencyOrder
+// ---------------------------------------------------------------------------
+//! Compute order of Partials by their highest frequency, so synthesizers
+//! can tell by a binary search how many Partials are below Nyquist at
+//! their pitch. Partials of equal frequency keep their onset order.
+void PartialBank::computeFrequencyOrder( void )
+{
+    m_frequencyOrder.resize( m_partials.size() );
+    for ( std::size_t i = 0; i < m_partials.size(); ++i )
+        m_frequencyOrder[i] = std::uint32_t( i );
+    std::stable_sort( m_frequencyOrder.begin(), m_frequencyOrder.end(),
+                      [this]( std::uint32_t a, std::uint32_t b ) { return m_partials[a].maxFrequency < m_partials[b].maxFrequency; } );
+}
+
+// ---------------------------------------------------------------------------
+//  numPartialsBelow
+// ---------------------------------------------------------------------------
+//! Return the number of Partials whose highest frequency is at most
+//! frequency, they are the first ones of frequencyOrder().
+std::size_t PartialBank::numPartialsBelow( double frequency ) const
+{
+    const PartialStruct * partials = m_partialsPtr;
+    return std::size_t( std::upper_bound( m_frequencyOrderPtr, m_frequencyOrderPtr + m_numPartials, frequency,
+                                          [partials]( double f, std::uint32_t idx ) { return f < partials[idx].maxFrequency; } )
+                        - m_frequencyOrderPtr );
+}
+
+// ---------------------------------------------------------------------------
+//  toPartials
+// ---------------------------------------------------------------------------
+//! Return the Partials of this bank the way it plays them.
+PartialList PartialBank::toPartials( void ) const
+{
+    PartialList partials;
+    const BreakpointArrays bp = m_breakpoints;
+    for ( std::size_t i = 0; i < m_numPartials; ++i )
+    {
+        const PartialStruct & p = m_partialsPtr[i];
+        Partial partial;
+        partial.setLabel( p.label );
+        for ( int b = p.firstBreakpoint; b < p.firstBreakpoint + p.numBreakpoints; ++b )
+        {
+            partial.insert( m_samplePtr[b] / m_srateHz,
+                            Breakpoint( bp.frequency( b ), bp.amplitude( b ), bp.bandwidth( b ), bp.phase( b ) ) );
+        }
+        partials.push_back( std::move( partial ) );
+    }
+    return partials;
+}
+
+// ---------------------------------------------------------------------------
+//  breakpointWindow
+// ---------------------------------------------------------------------------
+//! Return the range of Breakpoints read by synthesizers playing the bank
+//! from a sample to another one. Partials playing at the start were playing
+//! at the checkpoint before it or started after the checkpoint, Breakpoints
+//! of Partials are stored in onset order, so the range ends with the last
+//! Partial starting before the end sample.
+void PartialBank::breakpointWindow( int startSample, int endSample, std::size_t & first, std::size_t & last ) const
+{
+    first = last = 0;
+    if ( m_numPartials == 0 || endSample <= startSample )
+        return;
+    
+    const PartialStruct * partials = m_partialsPtr;
+    const PartialStruct * end = partials + m_numPartials;
+    auto startingAt = []( const PartialStruct & p, int sample ) { return p.startSample < sample; };
+    
+    std::size_t lower = m_numBreakpoints;
+    int from = std::max( startSample, 0 );
+    if ( m_numCheckpoints > 0 )
+    {
+        const std::size_t c = std::min( std::size_t( from / m_checkpointSamples ), m_numCheckpoints - 1 );
+        const PartialCheckpoint * playing = checkpointPartials( c );
+        for ( std::size_t i = 0; i < numCheckpointPartials( c ); ++i )
+            lower = std::min( lower, std::size_t( partials[playing[i].partial].firstBreakpoint + playing[i].breakpoint ) );
+        from = int( c ) * m_checkpointSamples;
+    }
+    const PartialStruct * starting = std::lower_bound( partials, end, from, startingAt );
+    if ( starting != end )
+        lower = std::min( lower, std::size_t( starting->firstBreakpoint ) );
+    
+    const PartialStruct * after = std::lower_bound( partials, end, endSample, startingAt );
+    std::size_t upper = 0;
+    if ( after != partials )
+        upper = std::size_t( ( after - 1 )->firstBreakpoint + ( after - 1 )->numBreakpoints );
+    
+    first = std::min( lower, upper );
+    last = upper;
+}
+
+// ---------------------------------------------------------------------------
+//  breakpointMemory
+// ---------------------------------------------------------------------------
+//! Return the memory of a range of Breakpoints in each Breakpoint array:
+//! samples, frequencies, amplitudes, bandwidths and phases.
+void PartialBank::breakpointMemory( std::size_t first, std::size_t last, MemoryRange * ranges ) const
+{
+    last = std::min( last, m_numBreakpoints );
+    first = std::min( first, last );
+    const std::size_t parameterSize = m_encoding == CompactEncoding ? sizeof(std::uint16_t) : sizeof(float);
+    
+    ranges[0].data = m_samplePtr + first;
+    ranges[0].size = ( last - first ) * sizeof(int);
+    for ( int i = 0; i < 4; ++i )
+    {
+        const bool stored = parameterArraySize( i ) > 0;
+        ranges[1 + i].data = stored ? static_cast<const char *>( m_parameterPtrs[i] ) + first * parameterSize : 0;
+        ranges[1 + i].size = stored ? ( last - first ) * parameterSize : 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  append
+// ---------------------------------------------------------------------------
+//! Append one breakpoint to the arrays. Time is converted to sample index
+//! here so synthesis does not need to do this for every block.
+void PartialBank::append( double time, const Breakpoint & bp )
+{
+    m_sample.push_back( int( (time * m_srateHz) + 0.5 ) );  //  cheap rounding
+    m_frequency.push_back( (float) bp.frequency() );
+    m_amplitude.push_back( (float) bp.amplitude() );
+    m_bandwidth.push_back( (float) bp.bandwidth() );
+    if ( ! m_phaseFree )
+        m_phase.push_back( (float) bp.phase() );
+}
+
+// ---------------------------------------------------------------------------
+//  roundToCompact
+// ---------------------------------------------------------------------------
+//! Round the float arrays to the values of the compact encoding.
+void PartialBank::roundToCompact( void )
+{
+    for ( std::size_t i = 0; i < m_sample.size(); ++i )
+    {
+        m_frequency[i] = BreakpointArrays::decodeFrequency( BreakpointArrays::encodeFrequency( m_frequency[i] ) );
+        m_amplitude[i] = BreakpointArrays::decodeAmplitude( BreakpointArrays::encodeAmplitude( m_amplitude[i] ) );
+        m_bandwidth[i] = BreakpointArrays::decodeBandwidth( BreakpointArrays::encodeBandwidth( m_bandwidth[i] ) );
+    }
+    for ( float & phase : m_phase )
+        phase = BreakpointArrays::decodePhase( BreakpointArrays::encodePhase( phase ) );
+}
+
+// ---------------------------------------------------------------------------
+//  encodeCompact
+// ---------------------------------------------------------------------------
+//! Encode the float arrays as compact ones, one after another in m_compact,
+//! and free them.
+void PartialBank::encodeCompact( void )
+{
+    const std::size_t n = m_sample.size();
+    m_compact.resize( ( m_phaseFree ? 3 : 4 ) * n );
+    std::uint16_t * frequency = m_compact.data();
+    std::uint16_t * amplitude = frequency + n;
+    std::uint16_t * bandwidth = amplitude + n;
+    std::uint16_t * phase = m_phaseFree ? 0 : bandwidth + n;
+    for ( std::size_t i = 0; i < n; ++i )
+    {
+        frequency[i] = BreakpointArrays::encodeFrequency( m_frequency[i] );
+        amplitude[i] = BreakpointArrays::encodeAmplitude( m_amplitude[i] );
+        bandwidth[i] = BreakpointArrays::encodeBandwidth( m_bandwidth[i] );
+    }
+    for ( std::size_t i = 0; i < m_phase.size(); ++i )
+        phase[i] = BreakpointArrays::encodePhase( m_phase[i] );
+    
+    std::vector<float>().swap( m_frequency );
+    std::vector<float>().swap( m_amplitude );
+    std::vector<float>().swap( m_bandwidth );
+    std::vector<float>().swap( m_phase );
+    
+    m_parameterPtrs[0] = frequency;
+    m_parameterPtrs[1] = amplitude;
+    m_parameterPtrs[2] = bandwidth;
+    m_parameterPtrs[3] = phase;
+}
+
+// ---------------------------------------------------------------------------
+//  parameterArraySize
+// ---------------------------------------------------------------------------
+//! Return the size in bytes of a Breakpoint parameter array, index
+//! of m_parameterPtrs.
+std::size_t PartialBank::parameterArraySize( int parameter ) const
+{
+    if ( parameter == 3 && m_phaseFree )
+        return 0;
+    return m_numBreakpoints * ( m_encoding == CompactEncoding ? sizeof(std::uint16_t) : sizeof(float) );
+}
+
+// ---------------------------------------------------------------------------
+//  setBreakpointArrays
+// ---------------------------------------------------------------------------
+//! Set the view of the Breakpoint arrays from their pointers.
+void PartialBank::setBreakpointArrays( void )
+{
+    if ( m_encoding == CompactEncoding )
+        m_breakpoints = BreakpointArrays( m_samplePtr,
+                                          static_cast<const std::uint16_t *>( m_parameterPtrs[0] ),
+                                          static_cast<const std::uint16_t *>( m_parameterPtrs[1] ),
+                                          static_cast<const std::uint16_t *>( m_parameterPtrs[2] ),
+                                          static_cast<const std::uint16_t *>( m_parameterPtrs[3] ) );
+    else
+        m_breakpoints = BreakpointArrays( m_samplePtr,
+                                          static_cast<const float *>( m_parameterPtrs[0] ),
+                                          static_cast<const float *>( m_parameterPtrs[1] ),
+                                          static_cast<const float *>( m_parameterPtrs[2] ),
+                                          static_cast<const float *>( m_parameterPtrs[3] ) );
+}
+
+// ---------------------------------------------------------------------------
+//  create
+// ---------------------------------------------------------------------------
+//!	Construct a bank and return it as shared pointer.
+PartialBank::Ptr PartialBank::create( const PartialList & partials, double pitch, double fadeTime, double sampleRate,
+                                      Encoding encoding, bool phaseFree )
+{
+    return std::make_shared<const PartialBank>( partials, pitch, fadeTime, sampleRate, encoding, phaseFree );
+}
+
+// ---------------------------------------------------------------------------
+//  create (PartialVector)
+// ---------------------------------------------------------------------------
+PartialBank::Ptr PartialBank::create( const PartialVector & partials, double pitch, double fadeTime, double sampleRate,
+                                      Encoding encoding, bool phaseFree )
+{
+    return std::make_shared<const PartialBank>( partials, pitch, fadeTime, sampleRate, encoding, phaseFree );
+}
+
+// ---------------------------------------------------------------------------
+//  BreakpointArrays encoding
+// ---------------------------------------------------------------------------
+//  Round a code to the 16 bit range, codes of 0 are used for 0 only.
+static std::uint16_t clampCode( double code, double min )
+{
+    return std::uint16_t( std::floor( std::min( std::max( code, min ), 65535. ) + 0.5 ) );
+}
+
+std::uint16_t BreakpointArrays::encodeFrequency( double frequency )
+{
+    if ( ! ( frequency > 0. ) )
+        return 0;
+    return clampCode( std::log2( frequency / MinFrequency ) * FrequencySteps + 1, 1. );
+}
+
+std::uint16_t BreakpointArrays::encodeAmplitude( double amplitude )
+{
+    if ( ! ( amplitude > 0. ) )
+        return 0;
+    return clampCode( ( std::log2( amplitude ) - MinAmplitudeOctave ) * AmplitudeSteps + 1, 1. );
+}
+
+std::uint16_t BreakpointArrays::encodeBandwidth( double bandwidth )
+{
+    return clampCode( bandwidth * 65535, 0. );
+}
+
+std::uint16_t BreakpointArrays::encodePhase( double phase )
+{
+    // wrapped to [-Pi, Pi), code 65536 is -Pi again
+    const double turns = phase * ( 0.5 / Pi ) + 0.5;
+    return std::uint16_t( int( std::floor( ( turns - std::floor( turns ) ) * 65536 + 0.5 ) ) & 0xffff );
+}
+
+// ---------------------------------------------------------------------------
+//  helpers
+// ---------------------------------------------------------------------------
+static_assert( std::is_trivially_copyable<PartialStruct>::value,
+               "PartialStruct is stored in bank images as is" );
+static_assert( std::is_trivially_copyable<PartialCheckpoint>::value,
+               "PartialCheckpoint is stored in bank images as is" );
+
+//  Round offset up to the image alignment.
+static std::uint64_t alignOffset( std::uint64_t offset, std::uint64_t alignment )
+{
+    return ( offset + alignment - 1 ) / alignment * alignment;
+}
+
+// ---------------------------------------------------------------------------
+//  imageHeader
+// ---------------------------------------------------------------------------
+//! Compute header of the image of this bank. Each array starts at a page
+//! aligned offset, so arrays of a mapped image are aligned as well.
+PartialBank::ImageHeader PartialBank::imageHeader( void ) const
+{
+    ImageHeader header;
+    std::memset( &header, 0, sizeof(header) );
+    std::memcpy( header.magic, "LPBK", 4 );
+    header.byteOrder = ImageByteOrder;
+    header.version = ImageVersion;
+    header.alignment = ImageAlignment;
+    header.encoding = std::uint32_t( m_encoding );
+    header.flags = m_phaseFree ? std::uint32_t( PhaseFreeImage ) : 0;
+    header.numPartials = m_numPartials;
+    header.numBreakpoints = m_numBreakpoints;
+    header.maxConcurrent = m_maxConcurrent;
+    header.pitch = m_pitch;
+    header.fadeTime = m_fadeTimeSec;
+    header.sampleRate = m_srateHz;
+    header.duration = m_duration;
+    header.checkpointSamples = std::uint64_t( m_checkpointSamples );
+    header.numCheckpoints = m_numCheckpoints;
+    header.numCheckpointPartials = m_numCheckpointPartials;
+
+    const std::uint64_t sizes[9] = {
+        m_numPartials * sizeof(PartialStruct),
+        m_numBreakpoints * sizeof(int),
+        parameterArraySize( 0 ),
+        parameterArraySize( 1 ),
+        parameterArraySize( 2 ),
+        parameterArraySize( 3 ),
+        ( m_numCheckpoints + 1 ) * sizeof(std::uint32_t),
+        m_numCheckpointPartials * sizeof(PartialCheckpoint),
+        m_numPartials * sizeof(std::uint32_t) };
+
+    std::uint64_t offset = sizeof(header);
+    for ( int i = 0; i < 9; ++i )
+    {
+        header.offsets[i] = alignOffset( offset, ImageAlignment );
+        offset = header.offsets[i] + sizes[i];
+    }
+    return header;
+}
+
+// ---------------------------------------------------------------------------
+//  imageSize
+// ---------------------------------------------------------------------------
+//! Return the size in bytes of the image of this bank.
+std::size_t PartialBank::imageSize( void ) const
+{
+    const ImageHeader header = imageHeader();
+    return std::size_t( header.offsets[8] + m_numPartials * sizeof(std::uint32_t) );
+}
+
+// ---------------------------------------------------------------------------
+//  writeImage
+// ---------------------------------------------------------------------------
+//! Write the image of this bank.
+//!
+//! \param  dest memory of imageSize() bytes the image is written to
+void PartialBank::writeImage( void * dest ) const
+{
+    const ImageHeader header = imageHeader();
+    char * image = static_cast<char *>( dest );
+
+    // padding is zeroed, so equal banks have equal images
+    std::memset( image, 0, imageSize() );
+    std::memcpy( image, &header, sizeof(header) );
+    std::memcpy( image + header.offsets[0], m_partialsPtr, m_numPartials * sizeof(PartialStruct) );
+    std::memcpy( image + header.offsets[1], m_samplePtr, m_numBreakpoints * sizeof(int) );
+    for ( int i = 0; i < 4; ++i )
+    {
+        if ( parameterArraySize( i ) > 0 )
+            std::memcpy( image + header.offsets[2 + i], m_parameterPtrs[i], parameterArraySize( i ) );
+    }
+    std::memcpy( image + header.offsets[6], m_checkpointFirstPtr, ( m_numCheckpoints + 1 ) * sizeof(std::uint32_t) );
+    std::memcpy( image + header.offsets[7], m_checkpointPartialsPtr, m_numCheckpointPartials * sizeof(PartialCheckpoint) );
+    std::memcpy( image + header.offsets[8], m_frequencyOrderPtr, m_numPartials * sizeof(std::uint32_t) );
+}
+
+// ---------------------------------------------------------------------------
+//  readImageHeader
+// ---------------------------------------------------------------------------
+//! Read the header of an image, checking it is a bank image this version
+//! reads. Offsets of the arrays are checked by fromImage().
+PartialBank::ImageHeader PartialBank::readImageHeader( const void * image, std::size_t size )
+{
+    ImageHeader header;
+    if ( image == 0 || size < sizeof(header) )
+        Throw( InvalidArgument, "Partial bank image is too small." );
+    std::memcpy( &header, image, sizeof(header) );
+
+    if ( std::memcmp( header.magic, "LPBK", 4 ) != 0 || header.byteOrder != ImageByteOrder )
+        Throw( InvalidArgument, "Data is not a partial bank image." );
+    if ( header.version != ImageVersion || header.alignment != ImageAlignment
+         || header.encoding > std::uint32_t( CompactEncoding ) || ( header.flags & ~std::uint32_t( PhaseFreeImage ) ) != 0 )
+        Throw( InvalidArgument, "Unsupported partial bank image version." );
+    return header;
+}
+
+// ---------------------------------------------------------------------------
+//  imageHeaderSize
+// ---------------------------------------------------------------------------
+//! Return the size in bytes of the header of images.
+std::size_t PartialBank::imageHeaderSize( void )
+{
+    return sizeof(ImageHeader);
+}
+
+// ---------------------------------------------------------------------------
+//  imageInfo
+// ---------------------------------------------------------------------------
+//! Describe a bank from the header of its image. The rest of the image is
+//! not checked, fromImage() may still reject it.
+//!
+//! \param  header The beginning of the image.
+//! \param  size size of header in bytes, at least imageHeaderSize()
+//! \return The description.
+//! \throw  InvalidArgument if header is not the header of a valid bank image.
+PartialBank::ImageInfo PartialBank::imageInfo( const void * header, std::size_t size )
+{
+    const ImageHeader h = readImageHeader( header, size );
+
+    ImageInfo info;
+    info.encoding = Encoding( h.encoding );
+    info.numPartials = std::size_t( h.numPartials );
+    info.numBreakpoints = std::size_t( h.numBreakpoints );
+    info.pitch = h.pitch;
+    info.sampleRate = h.sampleRate;
+    info.duration = h.duration;
+    info.imageSize = std::size_t( h.offsets[8] + h.numPartials * sizeof(std::uint32_t) );
+    info.phaseFree = ( h.flags & PhaseFreeImage ) != 0;
+    return info;
+}
+
+// ---------------------------------------------------------------------------
+//  fromImage
+// ---------------------------------------------------------------------------
+//!	Construct a bank using an image written by writeImage(). Arrays
+//! of the bank point into the image, nothing is copied.
+//!
+//! \param  image The image, aligned at least to 8 bytes.
+//! \param  size size of the image in bytes
+//! \param  owner keeps the image alive as long as the bank exists
+//!         (for example a memory mapped file), may be empty if
+//!         the image outlives the bank.
+//! \return The bank.
+//! \throw  InvalidArgument if the image is not a valid bank image.
+PartialBank::Ptr PartialBank::fromImage( const void * image, std::size_t size, std::shared_ptr<const void> owner )
+{
+    const ImageHeader header = readImageHeader( image, size );
+
+    std::shared_ptr<PartialBank> bank( new PartialBank );
+    bank->m_pitch = header.pitch;
+    bank->m_fadeTimeSec = header.fadeTime;
+    bank->m_srateHz = header.sampleRate;
+    bank->m_duration = header.duration;
+    bank->m_encoding = Encoding( header.encoding );
+    bank->m_phaseFree = ( header.flags & PhaseFreeImage ) != 0;
+    bank->m_maxConcurrent = std::size_t( header.maxConcurrent );
+    bank->m_numPartials = std::size_t( header.numPartials );
+    bank->m_numBreakpoints = std::size_t( header.numBreakpoints );
+    bank->m_checkpointSamples = int( header.checkpointSamples );
+    bank->m_numCheckpoints = std::size_t( header.numCheckpoints );
+    bank->m_numCheckpointPartials = std::size_t( header.numCheckpointPartials );
+    if ( header.checkpointSamples < 1 || header.checkpointSamples > 0x7fffffff )
+        Throw( InvalidArgument, "Partial bank image is damaged." );
+
+    // the layout is computed again, so it is checked against the header
+    const ImageHeader expected = bank->imageHeader();
+    if ( std::memcmp( expected.offsets, header.offsets, sizeof(header.offsets) ) != 0
+         || bank->imageSize() > size )
+        Throw( InvalidArgument, "Partial bank image is damaged." );
+
+    const char * data = static_cast<const char *>( image );
+    bank->m_partialsPtr = reinterpret_cast<const PartialStruct *>( data + header.offsets[0] );
+    bank->m_samplePtr = reinterpret_cast<const int *>( data + header.offsets[1] );
+    for ( int i = 0; i < 4; ++i )
+        bank->m_parameterPtrs[i] = bank->parameterArraySize( i ) > 0 ? data + header.offsets[2 + i] : 0;
+    bank->setBreakpointArrays();
+    bank->m_checkpointFirstPtr = reinterpret_cast<const std::uint32_t *>( data + header.offsets[6] );
+    bank->m_checkpointPartialsPtr = reinterpret_cast<const PartialCheckpoint *>( data + header.offsets[7] );
+    bank->m_frequencyOrderPtr = reinterpret_cast<const std::uint32_t *>( data + header.offsets[8] );
+
+    // synthesis trusts breakpoint ranges and the order of partials, streaming the
+    // order of their breakpoints
+    for ( std::size_t i = 0; i < bank->m_numPartials; ++i )
+    {
+        const PartialStruct & p = bank->m_partialsPtr[i];
+        const PartialStruct * previous = i > 0 ? &bank->m_partialsPtr[i - 1] : 0;
+        if ( p.firstBreakpoint < 0 || p.numBreakpoints < 2
+             || std::size_t( p.firstBreakpoint ) + std::size_t( p.numBreakpoints ) > bank->m_numBreakpoints
+             || ( previous && startsBefore( p, *previous ) )
+             || ( previous && p.firstBreakpoint < previous->firstBreakpoint + previous->numBreakpoints ) )
+            Throw( InvalidArgument, "Partial bank image is damaged." );
+        bank->m_stereo = bank->m_stereo || p.channel() != PartialStruct::Center;
+    }
+    
+    // and checkpoint lists and the breakpoints they point to
+    const std::uint32_t * first = bank->m_checkpointFirstPtr;
+    if ( first[0] != 0 || first[bank->m_numCheckpoints] != bank->m_numCheckpointPartials )
+        Throw( InvalidArgument, "Partial bank image is damaged." );
+    for ( std::size_t c = 0; c < bank->m_numCheckpoints; ++c )
+    {
+        if ( first[c + 1] < first[c] )
+            Throw( InvalidArgument, "Partial bank image is damaged." );
+    }
+    for ( std::size_t i = 0; i < bank->m_numCheckpointPartials; ++i )
+    {
+        const PartialCheckpoint & checkpoint = bank->m_checkpointPartialsPtr[i];
+        if ( checkpoint.partial < 0 || std::size_t( checkpoint.partial ) >= bank->m_numPartials
+             || checkpoint.breakpoint < 0 || checkpoint.breakpoint >= bank->m_partialsPtr[checkpoint.partial].numBreakpoints - 1 )
+            Throw( InvalidArgument, "Partial bank image is damaged." );
+    }
+    
+    // and the frequency order, which is binary searched
+    const std::uint32_t * order = bank->m_frequencyOrderPtr;
+    for ( std::size_t i = 0; i < bank->m_numPartials; ++i )
+    {
+        if ( order[i] >= bank->m_numPartials
+             || ( i > 0 && bank->m_partialsPtr[order[i]].maxFrequency < bank->m_partialsPtr[order[i - 1]].maxFrequency ) )
+            Throw( InvalidArgument, "Partial bank image is damaged." );
+    }
+
+    bank->m_image = std::move( owner );
+    bank->m_isImage = true;
+    return bank;
+}
+
+// ---------------------------------------------------------------------------
+//  PartialMorph constructor
+// ---------------------------------------------------------------------------
+//!	Construct a morph from a bank toward a target bank. Target Partials
+//! are found by label once per Partial of the source, the parameters at
+//! each Breakpoint are interpolated between the Breakpoints of the target
+//! around its time (its fade Breakpoints included, so the target fades in
+//! and out like it is played).
+//!
+//! \param  source The bank morphed, its Breakpoints are used.
+//! \param  target The bank morphed to, sampled at the time of the
+//!         Breakpoints of the source.
+PartialMorph::PartialMorph( const PartialBank & source, const PartialBank & target ) :
+    m_frequency( source.numBreakpoints() ),
+    m_amplitude( source.numBreakpoints(), 0.f ),
+    m_bandwidth( source.numBreakpoints() )
+{
+    // unmatched Partials keep their own frequency and bandwidth
+    const BreakpointArrays sourceBreakpoints = source.breakpoints();
+    for ( std::size_t b = 0; b < source.numBreakpoints(); ++b )
+    {
+        m_frequency[b] = sourceBreakpoints.frequency( int( b ) );
+        m_bandwidth[b] = sourceBreakpoints.bandwidth( int( b ) );
+    }
+    
+
+    // harmonic labels only, channel labels do not tell Partials apart
+    std::multimap< int, const PartialStruct * > targetPartials;
+    for ( std::size_t i = 0; i < target.size(); ++i )
+    {
+        const PartialStruct & q = target.partials()[i];
+        if ( q.label > 0 )
+            targetPartials.insert( std::make_pair( q.label, &q ) );
+    }
+    
+    const double pitchRatio = ( source.pitch() > 0. && target.pitch() > 0. ) ? source.pitch() / target.pitch() : 1.;
+    const double rateRatio = ( source.sampleRate() > 0. ) ? target.sampleRate() / source.sampleRate() : 1.;
+    
+    for ( std::size_t i = 0; i < source.size(); ++i )
+    {
+        const PartialStruct & p = source.partials()[i];
+        const auto candidates = targetPartials.equal_range( p.label );
+        if ( p.label <= 0 || candidates.first == candidates.second )
+            continue;
+        
+        for ( int k = 0; k < p.numBreakpoints; ++k )
+        {
+            const int b = p.firstBreakpoint + k;
+            const double at = source.breakpointSamples()[b] * rateRatio;
+            
+            // the first target Partial with the label playing at the time
+            for ( auto it = candidates.first; it != candidates.second; ++it )
+            {
+                const PartialStruct & q = *it->second;
+                const int * sample = target.breakpointSamples() + q.firstBreakpoint;
+                if ( at < sample[0] || at > sample[q.numBreakpoints - 1] )
+                    continue;
+                
+                const int j = std::max( int( std::upper_bound( sample, sample + q.numBreakpoints - 1, at ) - sample ), 1 );
+                const int t = q.firstBreakpoint + j;
+                const double x = sample[j] > sample[j - 1] ? ( at - sample[j - 1] ) / ( sample[j] - sample[j - 1] ) : 1.;
+                const BreakpointArrays bp = target.breakpoints();
+                
+                m_frequency[b] = float( pitchRatio * ( bp.frequency( t - 1 ) + ( bp.frequency( t ) - bp.frequency( t - 1 ) ) * x ) );
+                m_amplitude[b] = float( bp.amplitude( t - 1 ) + ( bp.amplitude( t ) - bp.amplitude( t - 1 ) ) * x );
+                m_bandwidth[b] = float( bp.bandwidth( t - 1 ) + ( bp.bandwidth( t ) - bp.bandwidth( t - 1 ) ) * x );
+                break;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  create
+// ---------------------------------------------------------------------------
+//!	Construct a morph and return it as shared pointer.
+PartialMorph::Ptr PartialMorph::create( const PartialBank & source, const PartialBank & target )
+{
+    return std::make_shared<const PartialMorph>( source, target );
+}
+
+}   //  end of namespace Loris
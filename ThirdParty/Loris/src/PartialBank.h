@@ -0,0 +1,619 @@
+#ifndef INCLUDE_PARTIAL_BANK_H
+#define INCLUDE_PARTIAL_BANK_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * PartialBank.h
+ *
+ * Definition of class Loris::PartialBank, an immutable set of Partials
+ * prepared for real-time synthesis and shared by many synthesizers, and
+ * of class Loris::PartialMorph, a morph target of a PartialBank.
+ *
+ */
+
+#include "PartialList.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//	begin namespace
+namespace Loris {
+
+class Breakpoint;
+
+// Using this struct because iterating over partials and especially Breakpoint is very
+// expensive. So I wrote this data container. It holds read-only data only, playback
+// state is kept by each RealTimeSynthesizer separately. Breakpoints are not stored
+// here, they are in the structure-of-arrays of the PartialBank starting at index
+// firstBreakpoint. It is stored as is in bank images, so it has to stay trivially
+// copyable and its layout must not change without changing the image version.
+struct PartialStruct
+{
+    enum { NoBreakpointProcessed = 0, FirstBreakpoint };
+    
+    // Output channel of a Partial of a stereo sound. Center is heard in
+    // both channels, Side in the left one and inverted in the right one.
+    // The channel is carried by negative labels, see channelLabel(), so
+    // Partials labeled by the Channelizer (and older data) are Center.
+    enum Channel { Center = 0, Left, Right, Side, NumChannels };
+
+    double startTime = 0.0;
+    double endTime = 0.0;
+    int startSample = 0;        // sample of the fade in breakpoint
+    int firstBreakpoint = 0;    // index of the fade in breakpoint in bank arrays
+    int numBreakpoints = 0;
+    int label = 0;
+    float avgFrequency = 0;
+    float maxFrequency = 0;     // highest frequency of its Breakpoints, Hz
+    
+    //! Return the output channel of this Partial.
+    Channel channel( void ) const { return labelChannel( label ); }
+    
+    //! Return the label marking Partials of a channel.
+    static int channelLabel( Channel channel ) { return - (int) channel; }
+    
+    //! Return the channel of Partials with a label, Center for labels
+    //! not made by channelLabel().
+    static Channel labelChannel( int label )
+    {
+        return ( label < 0 && label > - (int) NumChannels ) ? (Channel) -label : Center;
+    }
+};
+
+// State of a Partial playing at a checkpoint of a PartialBank, so that its
+// playback can start there without walking the Partial from its beginning.
+// It is stored as is in bank images, like PartialStruct.
+struct PartialCheckpoint
+{
+    int partial = 0;            // index of the Partial in the bank
+    int breakpoint = 0;         // its last Breakpoint at or before the checkpoint
+    double phase = 0.0;         // phase advance from the fade in Breakpoint to the
+                                // checkpoint at original pitch and rate, radians
+                                // (not wrapped, so it can be scaled)
+};
+
+// ---------------------------------------------------------------------------
+//	class BreakpointArrays
+//
+//! Breakpoint arrays of a PartialBank, read through this view so that
+//! synthesis works with banks of either encoding (see PartialBank::Encoding).
+//! Compact Breakpoints are decoded as they are read, synthesizers read a
+//! Breakpoint once per segment, not for every sample. The view is a few
+//! pointers, it is copied freely.
+//
+class BreakpointArrays
+{
+public:
+    //! Construct a view of no arrays.
+    BreakpointArrays( void ) {}
+
+    //! Construct a view of float arrays.
+    BreakpointArrays( const int * sample, const float * frequency, const float * amplitude,
+                      const float * bandwidth, const float * phase ) :
+        m_sample( sample ), m_frequency( frequency ), m_amplitude( amplitude ),
+        m_bandwidth( bandwidth ), m_phase( phase ) {}
+
+    //! Construct a view of compact arrays.
+    BreakpointArrays( const int * sample, const std::uint16_t * frequency, const std::uint16_t * amplitude,
+                      const std::uint16_t * bandwidth, const std::uint16_t * phase ) :
+        m_sample( sample ), m_frequency16( frequency ), m_amplitude16( amplitude ),
+        m_bandwidth16( bandwidth ), m_phase16( phase ) {}
+
+    //! Return the view of the arrays starting at a Breakpoint, for
+    //! example at PartialStruct::firstBreakpoint.
+    BreakpointArrays from( int first ) const
+    {
+        BreakpointArrays arrays( *this );
+        arrays.m_sample += first;
+        if ( isCompact() )
+        {
+            arrays.m_frequency16 += first;
+            arrays.m_amplitude16 += first;
+            arrays.m_bandwidth16 += first;
+            if ( m_phase16 )
+                arrays.m_phase16 += first;
+        }
+        else
+        {
+            arrays.m_frequency += first;
+            arrays.m_amplitude += first;
+            arrays.m_bandwidth += first;
+            if ( m_phase )
+                arrays.m_phase += first;
+        }
+        return arrays;
+    }
+
+    //! Return true if the arrays are compact.
+    bool isCompact( void ) const { return m_frequency16 != 0; }
+
+    //! Return the target sample array, the same in both encodings (it is searched).
+    const int * samples( void ) const { return m_sample; }
+
+    //! Return true if there is a phase array, see PartialBank::isPhaseFree().
+    bool hasPhases( void ) const { return m_phase16 != 0 || m_phase != 0; }
+
+    //! Return the parameters of a Breakpoint, phases are 0 without a phase array.
+    int sample( int i ) const { return m_sample[i]; }
+    float frequency( int i ) const { return m_frequency16 ? decodeFrequency( m_frequency16[i] ) : m_frequency[i]; }
+    float amplitude( int i ) const { return m_amplitude16 ? decodeAmplitude( m_amplitude16[i] ) : m_amplitude[i]; }
+    float bandwidth( int i ) const { return m_bandwidth16 ? decodeBandwidth( m_bandwidth16[i] ) : m_bandwidth[i]; }
+    float phase( int i ) const { return m_phase16 ? decodePhase( m_phase16[i] ) : m_phase ? m_phase[i] : 0.f; }
+
+//	-- compact encoding --
+    //! Frequencies are logarithmic, FrequencySteps per octave from
+    //! MinFrequency Hz (0.3 cent steps up to 65 kHz), code 0 is 0 Hz.
+    enum { FrequencySteps = 4096, MinFrequency = 1 };
+
+    //! Amplitudes are logarithmic, AmplitudeSteps per octave (0.003 dB steps)
+    //! from 2^MinAmplitudeOctave (-168 dB up to +24 dB), code 0 is silence.
+    enum { AmplitudeSteps = 2048, MinAmplitudeOctave = -28 };
+
+    //! Encode a parameter of a Breakpoint, values out of range are clamped.
+    static std::uint16_t encodeFrequency( double frequency );
+    static std::uint16_t encodeAmplitude( double amplitude );
+    static std::uint16_t encodeBandwidth( double bandwidth );
+    static std::uint16_t encodePhase( double phase );
+
+    //! Decode a parameter of a Breakpoint.
+    static float decodeFrequency( std::uint16_t code )
+    {
+        return code == 0 ? 0.f : float( MinFrequency * std::exp2( ( code - 1 ) * ( 1. / FrequencySteps ) ) );
+    }
+    static float decodeAmplitude( std::uint16_t code )
+    {
+        return code == 0 ? 0.f : float( std::exp2( ( code - 1 ) * ( 1. / AmplitudeSteps ) + MinAmplitudeOctave ) );
+    }
+    static float decodeBandwidth( std::uint16_t code ) { return float( code * ( 1. / 65535 ) ); }
+    static float decodePhase( std::uint16_t code ) { return float( ( code - 32768 ) * ( 3.14159265358979324 / 32768 ) ); }
+
+private:
+    const int * m_sample = 0;
+    const float * m_frequency = 0;
+    const float * m_amplitude = 0;
+    const float * m_bandwidth = 0;
+    const float * m_phase = 0;
+    const std::uint16_t * m_frequency16 = 0;
+    const std::uint16_t * m_amplitude16 = 0;
+    const std::uint16_t * m_bandwidth16 = 0;
+    const std::uint16_t * m_phase16 = 0;
+};
+
+// ---------------------------------------------------------------------------
+//	class PartialBank
+//
+//! A PartialBank is the read-only form of a PartialList used by
+//! RealTimeSynthesizer. It is built once (not on the audio thread) and
+//! then shared through a reference counted pointer by all synthesizers
+//! (voices) playing the same sound, so the breakpoint data is stored
+//! only once no matter how many voices there are.
+//!
+//! Fade in/out Breakpoints are inserted at either end of each Partial.
+//! Partials with start times earlier than the Partial fade time will
+//! have shorter onset fades.
+//!
+//! Breakpoints of all Partials are stored as structure-of-arrays: target
+//! sample index (rounded once for the sample rate of the bank), frequency,
+//! amplitude, bandwidth and phase are each in their own contiguous array,
+//! so the render loop reads compact streams only. Banks of CompactEncoding
+//! store frequency, amplitude, bandwidth and phase in 16 bits each
+//! (logarithmic frequency and amplitude), 12 bytes per Breakpoint instead
+//! of 20, so that large banks stay in cache; they are decoded as they are
+//! read through breakpoints().
+//!
+//! Phase-free banks store no phases at all, 4 bytes less per Breakpoint in
+//! either encoding. Synthesizers start their Partials at scattered phases
+//! instead of fixing them to the analysed ones, see isPhaseFree().
+//!
+//! A bank can be stored as an image, whose layout is the same as the
+//! in-memory one: a header followed by the PartialStruct array and the
+//! breakpoint arrays, each starting at a page aligned offset. An image
+//! read by memory mapping a file is used in place, without any parsing
+//! or copying, and its pages are shared by everyone mapping the same file.
+//! Numbers are stored in native byte order, images are meant as a local
+//! cache and are rejected on machines with other byte order. The header
+//! of an image has a fixed size and describes the bank (see ImageInfo), so
+//! a library of banks can be browsed reading the headers only.
+//!
+//! Every checkpointSamples() samples the bank lists the Partials playing
+//! there, with their Breakpoint and phase advance, so synthesizers can
+//! start playing anywhere in the sound with exact phases after walking
+//! only the Breakpoints between the checkpoint and the start.
+//!
+//! Breakpoints are stored in the onset order of their Partials, so the
+//! Breakpoints played in a stretch of time are in one range of each array
+//! (see breakpointWindow()). A mapped image of a long sound can be streamed:
+//! only the pages of the ranges voices play soon need to be resident.
+//
+class PartialBank
+{
+//	-- public interface --
+public:
+    //! Shared, immutable bank.
+    typedef std::shared_ptr<const PartialBank> Ptr;
+
+    //! Storage of Breakpoint parameters, see BreakpointArrays.
+    enum Encoding { FloatEncoding = 0, CompactEncoding };
+
+    //! Description of a bank read from the header of its image.
+    struct ImageInfo
+    {
+        Encoding encoding;
+        std::size_t numPartials;
+        std::size_t numBreakpoints;
+        double pitch;
+        double sampleRate;
+        double duration;            // seconds, see duration()
+        std::size_t imageSize;      // bytes of the whole image
+        bool phaseFree;             // see isPhaseFree()
+    };
+
+//	-- construction --
+    //!	Construct a bank from Partials. Empty Partials are skipped.
+    //!
+    //! \param  partials The Partials to synthesize, in any order.
+    //! \param  pitch original pitch of the partials
+    //! \param  fadeTime fade in/out time in seconds
+    //! \param  sampleRate sample rate used to compute breakpoint sample indices
+    //! \param  encoding storage of Breakpoint parameters
+    //! \param  phaseFree drop the phases of the Breakpoints, see isPhaseFree()
+    PartialBank( const PartialList & partials, double pitch, double fadeTime, double sampleRate,
+                 Encoding encoding = FloatEncoding, bool phaseFree = false );
+
+    //!	Construct a bank from Partials in contiguous storage, the same as
+    //! from a PartialList of them.
+    PartialBank( const PartialVector & partials, double pitch, double fadeTime, double sampleRate,
+                 Encoding encoding = FloatEncoding, bool phaseFree = false );
+
+    //!	Construct a bank and return it as shared pointer.
+    static Ptr create( const PartialList & partials, double pitch, double fadeTime, double sampleRate,
+                       Encoding encoding = FloatEncoding, bool phaseFree = false );
+
+    //!	Construct a bank from Partials in contiguous storage and return it
+    //! as shared pointer.
+    static Ptr create( const PartialVector & partials, double pitch, double fadeTime, double sampleRate,
+                       Encoding encoding = FloatEncoding, bool phaseFree = false );
+
+    //!	Construct a bank using an image written by writeImage(). Arrays
+    //! of the bank point into the image, nothing is copied.
+    //!
+    //! \param  image The image, aligned at least to 8 bytes.
+    //! \param  size size of the image in bytes
+    //! \param  owner keeps the image alive as long as the bank exists
+    //!         (for example a memory mapped file), may be empty if
+    //!         the image outlives the bank.
+    //! \return The bank.
+    //! \throw  InvalidArgument if the image is not a valid bank image.
+    static Ptr fromImage( const void * image, std::size_t size, std::shared_ptr<const void> owner );
+
+    //  Arrays may point to an image or to the bank's own vectors, so
+    //  banks are not copied, they are shared by Ptr.
+    PartialBank( const PartialBank & ) = delete;
+    PartialBank & operator=( const PartialBank & ) = delete;
+
+//	-- image --
+    //! Return the size in bytes of the image of this bank.
+    std::size_t imageSize( void ) const;
+
+    //! Write the image of this bank.
+    //!
+    //! \param  dest memory of imageSize() bytes the image is written to
+    void writeImage( void * dest ) const;
+
+    //! Return the size in bytes of the header of images, the bytes
+    //! imageInfo() reads.
+    static std::size_t imageHeaderSize( void );
+
+    //! Describe a bank from the header of its image, without reading
+    //! the rest of it.
+    //!
+    //! \param  header The beginning of the image.
+    //! \param  size size of header in bytes, at least imageHeaderSize()
+    //! \return The description.
+    //! \throw  InvalidArgument if header is not the header of a valid
+    //!         bank image.
+    static ImageInfo imageInfo( const void * header, std::size_t size );
+
+//	-- access --
+    //! Return the prepared Partials, size() of them, sorted by startSample.
+    const PartialStruct * partials( void ) const { return m_partialsPtr; }
+
+    //! Return the number of Partials.
+    std::size_t size( void ) const { return m_numPartials; }
+
+    //! Return true if there are no Partials in the bank.
+    bool empty( void ) const { return m_numPartials == 0; }
+
+    //! Return true if some Partials are not in the Center channel, see
+    //! PartialStruct::channel().
+    bool isStereo( void ) const { return m_stereo; }
+
+    //! Return the original pitch of the Partials.
+    double pitch( void ) const { return m_pitch; }
+
+    //! Return the fade time used to build the bank.
+    double fadeTime( void ) const { return m_fadeTimeSec; }
+
+    //! Return the sample rate used to compute breakpoint sample indices.
+    double sampleRate( void ) const { return m_srateHz; }
+
+    //! Return the end of the fade out of the Partial ending last, in seconds.
+    double duration( void ) const { return m_duration; }
+
+    //! Return the largest number of Partials sounding at the same time.
+    std::size_t maxConcurrentPartials( void ) const { return m_maxConcurrent; }
+
+    //! Return the total number of breakpoints (including fade breakpoints).
+    std::size_t numBreakpoints( void ) const { return m_numBreakpoints; }
+
+    //! Return the storage of Breakpoint parameters.
+    Encoding encoding( void ) const { return m_encoding; }
+
+    //! Return true if the bank stores no phases. Its Breakpoints have phase
+    //! 0, synthesizers start its Partials at scattered phases, so they are
+    //! not coherent with the analysed sound (inaudible for most sustained 
+    //! sounds), and Partials need no phase fixing before they are stored.
+    bool isPhaseFree( void ) const { return m_phaseFree; }
+
+    //! Return the Breakpoint arrays, index by PartialStruct::firstBreakpoint + i.
+    BreakpointArrays breakpoints( void ) const { return m_breakpoints; }
+
+    //! Return the target sample array of Breakpoints, in both encodings.
+    const int * breakpointSamples( void ) const { return m_samplePtr; }
+
+    //! Memory of a range of an array.
+    struct MemoryRange
+    {
+        const void * data;
+        std::size_t size;
+    };
+
+    //! Number of Breakpoint arrays, sample and parameter ones.
+    enum { NumBreakpointArrays = 5 };
+
+    //! Return the range of Breakpoints read by synthesizers playing the bank
+    //! from a sample to another one, the first one and one past the last one.
+    //! Partials playing from before the start sample are included from their
+    //! Breakpoint at the start, later ones as a whole.
+    //!
+    //! \param  startSample first sample played
+    //! \param  endSample sample after the last one played
+    //! \param  first receives the index of the first Breakpoint
+    //! \param  last receives the index after the last Breakpoint
+    void breakpointWindow( int startSample, int endSample, std::size_t & first, std::size_t & last ) const;
+
+    //! Return the memory of a range of Breakpoints in each Breakpoint array.
+    //! The phase range of phase-free banks is empty (no data, size 0).
+    //!
+    //! \param  first index of the first Breakpoint
+    //! \param  last index after the last Breakpoint
+    //! \param  ranges receives NumBreakpointArrays ranges
+    void breakpointMemory( std::size_t first, std::size_t last, MemoryRange * ranges ) const;
+
+    //! Return true if the arrays of the bank point into an image.
+    bool isImage( void ) const { return m_isImage; }
+
+    //! Return the number of samples between checkpoints, the first one is at sample 0.
+    int checkpointSamples( void ) const { return m_checkpointSamples; }
+
+    //! Return the number of checkpoints.
+    std::size_t numCheckpoints( void ) const { return m_numCheckpoints; }
+
+    //! Return the Partials playing at a checkpoint, sorted by their index.
+    //!
+    //! \param  checkpoint index of the checkpoint, less than numCheckpoints()
+    const PartialCheckpoint * checkpointPartials( std::size_t checkpoint ) const
+    {
+        return m_checkpointPartialsPtr + m_checkpointFirstPtr[checkpoint];
+    }
+
+    //! Return the number of Partials playing at a checkpoint.
+    std::size_t numCheckpointPartials( std::size_t checkpoint ) const
+    {
+        return std::size_t( m_checkpointFirstPtr[checkpoint + 1] - m_checkpointFirstPtr[checkpoint] );
+    }
+
+    //! Return indices of the Partials sorted by PartialStruct::maxFrequency,
+    //! lowest first, size() of them.
+    const std::uint32_t * frequencyOrder( void ) const { return m_frequencyOrderPtr; }
+
+    //! Return the number of Partials whose highest frequency is at most
+    //! frequency (they come first in frequencyOrder()). Binary search.
+    std::size_t numPartialsBelow( double frequency ) const;
+
+    //! Return the Partials of this bank the way it plays them, with their
+    //! fade in and fade out Breakpoints, times rounded to samples and
+    //! values in the precision of its encoding. Breakpoints rounded to the
+    //! same sample are merged, the later one is kept. This is how a bank,
+    //! mapped from an image too, is exported as Partials (to SDIF).
+    PartialList toPartials( void ) const;
+
+    //! Time between checkpoints of banks built from Partials, in seconds.
+    static const double CheckpointTime;
+
+//	-- implementation --
+private:
+    //! Header of a bank image. Array offsets are from the image start.
+    struct ImageHeader
+    {
+        char magic[4];                      // "LPBK"
+        std::uint32_t byteOrder;            // ImageByteOrder in writer's byte order
+        std::uint32_t version;              // ImageVersion
+        std::uint32_t alignment;            // ImageAlignment
+        std::uint32_t encoding;             // Encoding
+        std::uint32_t flags;                // ImageFlags, 0 in images written before them
+        std::uint64_t numPartials;
+        std::uint64_t numBreakpoints;
+        std::uint64_t maxConcurrent;
+        double pitch;
+        double fadeTime;
+        double sampleRate;
+        double duration;
+        std::uint64_t checkpointSamples;
+        std::uint64_t numCheckpoints;
+        std::uint64_t numCheckpointPartials;
+        std::uint64_t offsets[9];           // partials, sample, frequency, amplitude, bandwidth, phase,
+                                            // checkpoint first, checkpoint partials, frequency order
+    };
+
+    enum { ImageByteOrder = 0x01020304, ImageVersion = 7, ImageAlignment = 4096 };
+    enum ImageFlags { PhaseFreeImage = 1 };
+
+    double m_pitch = 0.;                    // original pitch of partial data
+    double m_fadeTimeSec = 0.;              // fade in/out time
+    double m_srateHz = 0.;                  // sample rate of breakpoint indices
+    double m_duration = 0.;                 // end time of the last partial, seconds
+    std::size_t m_maxConcurrent = 0;        // most partials sounding at once
+    bool m_stereo = false;                  // some partials are not Center
+    Encoding m_encoding = FloatEncoding;    // storage of breakpoint parameters
+    bool m_phaseFree = false;               // no phase array
+    bool m_isImage = false;                 // arrays point into an image
+
+    //  storage of a bank built from Partials, empty for banks using an image
+    std::vector<PartialStruct> m_partials;  // prepared partials
+    std::vector<int> m_sample;              // target sample of breakpoint
+    std::vector<float> m_frequency;         // Hz
+    std::vector<float> m_amplitude;         // absolute
+    std::vector<float> m_bandwidth;         // noise energy / total energy
+    std::vector<float> m_phase;             // radians, empty in phase-free banks
+    std::vector<std::uint16_t> m_compact;   // compact frequency, amplitude, bandwidth and phase arrays
+    std::vector<std::uint32_t> m_checkpointFirst;           // first entry of checkpoint, numCheckpoints + 1
+    std::vector<PartialCheckpoint> m_checkpointPartials;    // partials playing at checkpoints
+    std::vector<std::uint32_t> m_frequencyOrder;            // partials by highest frequency
+
+    //  arrays used by accessors, point to the vectors or into the image
+    std::size_t m_numPartials = 0;
+    std::size_t m_numBreakpoints = 0;
+    const PartialStruct * m_partialsPtr = 0;
+    const int * m_samplePtr = 0;
+    const void * m_parameterPtrs[4] = {};   // frequency, amplitude, bandwidth and phase arrays,
+                                            // of float or std::uint16_t by encoding, no phase
+                                            // array in phase-free banks
+    BreakpointArrays m_breakpoints;         // view of the arrays
+    int m_checkpointSamples = 1;
+    std::size_t m_numCheckpoints = 0;
+    std::size_t m_numCheckpointPartials = 0;
+    const std::uint32_t * m_checkpointFirstPtr = 0;
+    const PartialCheckpoint * m_checkpointPartialsPtr = 0;
+    const std::uint32_t * m_frequencyOrderPtr = 0;
+    std::shared_ptr<const void> m_image;    // keeps the image alive
+
+    //! Construct an empty bank, fromImage() fills it.
+    PartialBank( void ) {}
+
+    //! Build the arrays from the Partials of a range, for the constructors.
+    template< class Iter >
+    void build( Iter begin, Iter end );
+
+    //! Append one breakpoint to the arrays.
+    void append( double time, const Breakpoint & bp );
+
+    //! Store Breakpoints in the order of the Partials.
+    void sortBreakpoints( void );
+
+    //! Round the float arrays to the compact encoding, so that everything
+    //! computed from them matches what synthesizers decode.
+    void roundToCompact( void );
+
+    //! Encode the float arrays as compact ones and free them.
+    void encodeCompact( void );
+
+    //! Return the size in bytes of a Breakpoint parameter array, index
+    //! of m_parameterPtrs.
+    std::size_t parameterArraySize( int parameter ) const;
+
+    //! Set the view of the Breakpoint arrays from their pointers.
+    void setBreakpointArrays( void );
+
+    //! Compute header of the image of this bank.
+    ImageHeader imageHeader( void ) const;
+
+    //! Read and check the header of an image, see fromImage().
+    static ImageHeader readImageHeader( const void * image, std::size_t size );
+
+    //! Compute the largest number of Partials sounding at the same time.
+    void computeMaxConcurrent( void );
+
+    //! Compute Partials playing at checkpoints.
+    void computeCheckpoints( void );
+
+    //! Compute order of Partials by their highest frequency.
+    void computeFrequencyOrder( void );
+
+};	//	end of class PartialBank
+
+// ---------------------------------------------------------------------------
+//	class PartialMorph
+//
+//! A PartialMorph holds the parameters of a morph target sound at every
+//! Breakpoint of a PartialBank, so that a RealTimeSynthesizer can move the
+//! Breakpoints it plays toward them by any amount, on the fly, without
+//! searching anything. Like the bank, it is built once (not on the audio
+//! thread) and shared by all synthesizers playing the bank.
+//!
+//! Partials correspond by their label: a Partial of the bank takes the
+//! parameters the target Partial with the same (harmonic, see Channelizer)
+//! label has at the time of each of its Breakpoints. Frequencies of the
+//! target are scaled to the pitch of the bank. Partials without a
+//! counterpart, and unlabeled ones, fade out at their own frequency as the
+//! morph reaches the target. Partials of the target without a counterpart
+//! are not heard.
+//
+class PartialMorph
+{
+//	-- public interface --
+public:
+    //! Shared, immutable morph.
+    typedef std::shared_ptr<const PartialMorph> Ptr;
+
+    //!	Construct a morph from a bank toward a target bank.
+    //!
+    //! \param  source The bank morphed, its Breakpoints are used.
+    //! \param  target The bank morphed to, sampled at the time of the
+    //!         Breakpoints of the source.
+    PartialMorph( const PartialBank & source, const PartialBank & target );
+
+    //!	Construct a morph and return it as shared pointer.
+    static Ptr create( const PartialBank & source, const PartialBank & target );
+
+    //! Return the number of Breakpoints, the same as the one of the source bank.
+    std::size_t numBreakpoints( void ) const { return m_frequency.size(); }
+
+    //! Target arrays, index like the Breakpoint arrays of the source bank.
+    const float * frequencies( void ) const { return m_frequency.data(); }
+    const float * amplitudes( void ) const { return m_amplitude.data(); }
+    const float * bandwidths( void ) const { return m_bandwidth.data(); }
+
+//	-- implementation --
+private:
+    std::vector<float> m_frequency;         // Hz, scaled to the pitch of the source
+    std::vector<float> m_amplitude;         // absolute
+    std::vector<float> m_bandwidth;         // noise energy / total energy
+
+};	//	end of class PartialMorph
+
+}	//	end of namespace Loris
+
+#endif /* ndef INCLUDE_PARTIAL_BANK_H */
@@ -63,6 +63,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 
 // ---------------------------------------------------------------------------
 // ---------------------------------------------------------------------------
@@ -105,63 +106,21 @@ PartialBuilder::PartialBuilder( double drift, const Envelope & env ) :
 // --- local helpers for Partial building ---
 
 // ---------------------------------------------------------------------------
-//	end_frequency
+//	eligible
 // ---------------------------------------------------------------------------
-//	Return the frequency of the last Breakpoint in a Partial.
+//	Return the entry of an eligible Partial, from its last Breakpoint.
+//	Frequencies are compared normalized by the warping envelope, at the
+//	time of the end of the Partial and of the peak, see buildPartials().
 //
-static inline double end_frequency( const Partial & partial )
+PartialBuilder::EligiblePartial
+PartialBuilder::eligible( Partial * partial ) const
 {
-	return partial.last().frequency();
+    const double frequency = partial->last().frequency();
+    const EligiblePartial entry = 
+        { frequency, frequency / mFreqWarping->valueAt( partial->endTime() ), partial };
+    return entry;
 }
 
-// ---------------------------------------------------------------------------
-//	freq_distance
-// ---------------------------------------------------------------------------
-//	Helper function, used in formPartials().
-//	Returns the (positive) frequency distance between a Breakpoint 
-//	and the last Breakpoint in a Partial.
-//
-inline double 
-PartialBuilder::freq_distance( const Partial & partial, const SpectralPeak & pk )
-{
-    double normBpFreq = pk.frequency() / mFreqWarping->valueAt( pk.time() );
-    
-    double normPartialEndFreq = 
-        partial.last().frequency() / mFreqWarping->valueAt( partial.endTime() );
-    
-	return std::fabs( normPartialEndFreq - normBpFreq );
-}
-
-// ---------------------------------------------------------------------------
-//	better_match
-// ---------------------------------------------------------------------------
-//	Predicate for choosing the better of two proposed
-//	Partial-to-Breakpoint matches. Note: sometimes this
-//  is used to compare two candidate Breakpoint matches
-//  to the same Partial, other times to candidate Partials
-//  to the same Breakpoint.
-//
-//	Return true if the first match is better, otherwise
-//	return false.
-//
-
-bool PartialBuilder::better_match( const Partial & part, const SpectralPeak & pk1,
-                                   const SpectralPeak & pk2 )
-{
-	Assert( part.numBreakpoints() > 0 );
-	
-	return freq_distance( part, pk1 ) < freq_distance( part, pk2 );
-}	                                   
-                                   
-bool PartialBuilder::better_match( const Partial & part1, 
-                                   const Partial & part2, const SpectralPeak & pk )
-{
-	Assert( part1.numBreakpoints() > 0 );
-	Assert( part2.numBreakpoints() > 0 );
-	
-	return freq_distance( part1, pk ) < freq_distance( part2, pk );
-}	
-
 // --- Partial building members ---
 
 // ---------------------------------------------------------------------------
@@ -191,27 +150,38 @@ PartialBuilder::buildPartials( Peaks & peaks, double frameTime )
 	//	peaks this way)
 	std::sort( peaks.begin(), peaks.end(), SpectralPeak::sort_increasing_freq );
 	
-	PartialPtrs::iterator eligible = mEligiblePartials.begin();
-	for ( Peaks::iterator bpIter = peaks.begin(); bpIter != peaks.end(); ++bpIter ) 
+	//	peak frequencies normalized by the warping envelope, once per peak,
+	//	the eligible Partials have theirs cached:
+	mPeakFrequencies.resize( peaks.size() );
+	for ( std::size_t i = 0; i < peaks.size(); ++i )
 	{
-		//const Breakpoint & bp = bpIter->breakpoint;
-		const double peakTime = frameTime + bpIter->time();
+		mPeakFrequencies[ i ] = peaks[ i ].frequency() / mFreqWarping->valueAt( peaks[ i ].time() );
+	}
+	
+	//	matching is a merge of the peaks with the eligible Partials, both
+	//	sorted by frequency:
+	const EligiblePartial * const eligibleEnd = mEligiblePartials.data() + mEligiblePartials.size();
+	const EligiblePartial * eligible = mEligiblePartials.data();
+	for ( std::size_t i = 0; i < peaks.size(); ++i ) 
+	{
+		const SpectralPeak & peak = peaks[ i ];
+		const double peakTime = frameTime + peak.time();
+		const double normFrequency = mPeakFrequencies[ i ];
 		
 		// 	find the Partial that is nearest in frequency to the Peak:
-		PartialPtrs::iterator nextEligible = eligible;
-		if ( eligible != mEligiblePartials.end() &&
-			 end_frequency( **eligible ) < bpIter->frequency() )
+		const EligiblePartial * nextEligible = eligible;
+		if ( eligible != eligibleEnd && eligible->frequency < peak.frequency() )
 		{
 			++nextEligible;
-			while ( nextEligible != mEligiblePartials.end() &&
-					end_frequency( **nextEligible ) < bpIter->frequency() )
+			while ( nextEligible != eligibleEnd && nextEligible->frequency < peak.frequency() )
 			{
 				++nextEligible;
 				++eligible;
 			}
 			
-			if ( nextEligible != mEligiblePartials.end() &&
-				 better_match( **nextEligible, **eligible, *bpIter ) )
+			if ( nextEligible != eligibleEnd &&
+				 std::fabs( nextEligible->normFrequency - normFrequency ) < 
+				 std::fabs( eligible->normFrequency - normFrequency ) )
 			{
 				eligible = nextEligible;
 			}
@@ -220,42 +190,30 @@ PartialBuilder::buildPartials( Peaks & peaks, double frameTime )
 		// 	INVARIANT:
 		//
 		//	eligible is the position of the nearest (in frequency)
-		//	eligible Partial (pointer) or it is mEligiblePartials.end().
+		//	eligible Partial or it is eligibleEnd.
 		//
 		//	nextEligible is the eligible Partial with frequency 
-		//	greater than bp, or it is mEligiblePartials.end().  
-              
-#if defined(Debug_Loris) && Debug_Loris
-        /*
-		if ( nextEligible != mEligiblePartials.end() )
-		{
-			debugger << matchFrequency << "( " << end_frequency( **eligible )
-					 << ", " << end_frequency( **nextEligible ) << ")" << endl;
-		}
-        */
-#endif
+		//	greater than bp, or it is eligibleEnd.  
 								
 		//	create a new Partial if there is no eligible Partial,
 		//	or the frequency difference to the eligible Partial is 
 		//	too great, or the next peak is a better match for the 
 		//	eligible Partial, otherwise add this peak to the eligible
 		//	Partial:
-		Peaks::iterator nextPeak = //Peaks::iterator( bpIter ); ++nextPeak;
-								   ++Peaks::iterator( bpIter ); //  some compilers choke on this?
 
         //  decide whether this match should be made:
         //  - can only make the match if eligible is not the end of the list
         //  - the match is only good if it is close enough in frequency
         //  - even if the match is good, only match if the next one is not better
         bool makeMatch = false;
-        if ( eligible != mEligiblePartials.end() )
+        if ( eligible != eligibleEnd )
         {
-            bool matchIsGood =  mFreqDrift > 
-                std::fabs( end_frequency( **eligible ) - bpIter->frequency() );
+            bool matchIsGood = mFreqDrift > std::fabs( eligible->frequency - peak.frequency() );
             if ( matchIsGood )
             {
-                bool nextIsBetter = ( nextPeak != peaks.end() &&
-                                      better_match( **eligible, *nextPeak, *bpIter ) ); 
+                bool nextIsBetter = ( i + 1 < peaks.size() &&
+                                      std::fabs( eligible->normFrequency - mPeakFrequencies[ i + 1 ] ) < 
+                                      std::fabs( eligible->normFrequency - normFrequency ) ); 
                 if ( ! nextIsBetter )
                 {
                     makeMatch = true;
@@ -263,38 +221,112 @@ PartialBuilder::buildPartials( Peaks & peaks, double frameTime )
             }                       
         }
         
-        Breakpoint bp = bpIter->createBreakpoint();
+        Breakpoint bp = peak.createBreakpoint();
         
+        Partial * partial;
         if ( makeMatch )
         {
             //  invariant:
             //  if makeMatch is true, then eligible is the position of a valid Partial
-            (*eligible)->insert( peakTime, bp );
-			mNewlyEligible.push_back( *eligible );
+            partial = eligible->partial;
+            partial->insert( peakTime, bp );
 			
 			++matchCount;
         }
         else
         {
-            Partial p;
-            p.insert( peakTime, bp );
-            mCollectedPartials.push_back( p );
-            mNewlyEligible.push_back( & mCollectedPartials.back() );
+            //  construct the new Partial in place, copying a temporary
+            //  would allocate its Breakpoints twice:
+            mCollectedPartials.push_back( Partial() );
+            partial = & mCollectedPartials.back();
+            partial->insert( peakTime, bp );
         }
+        mNewlyEligible.push_back( this->eligible( partial ) );
         
 		//	update eligible, nextEligible is the eligible Partial
-		//	with frequency greater than bp, or it is mEligiblePartials.end():
+		//	with frequency greater than bp, or it is eligibleEnd:
 		eligible = nextEligible;
 	}			 
 	 	
-	mEligiblePartials = mNewlyEligible;
+	//  swap rather than copy, mNewlyEligible is cleared by the next
+	//  call and both keep their capacity:
+	mEligiblePartials.swap( mNewlyEligible );
 	
     /*
-	debugger << "PartialBuilder::buildPartials: matched " << matchCount << endl;
-	debugger << "PartialBuilder::buildPartials: " << mNewlyEligible.size() << " newly eligible partials" << endl;
+	LORIS_DEBUGGER << "PartialBuilder::buildPartials: matched " << matchCount << endl;
+	LORIS_DEBUGGER << "PartialBuilder::buildPartials: " << mNewlyEligible.size() << " newly eligible partials" << endl;
     */
 }
 
+// ---------------------------------------------------------------------------
+//	buildHarmonicPartials
+// ---------------------------------------------------------------------------
+//	Append spectral peaks to Partials by harmonic of the specified
+//	fundamental frequency of the current frame. The loudest peak nearest
+//	to each harmonic extends the Partial of that harmonic if it was 
+//	extended in the previous frame, otherwise it spawns a new Partial,
+//	labeled by the harmonic number. Other peaks are not used.
+//
+//	Eligible Partials are kept in mEligiblePartials too, so takeFinished()
+//	and finishBuilding() work the same way.
+//
+void 
+PartialBuilder::buildHarmonicPartials( Peaks & peaks, double frameTime, double fundamental )
+{
+	mNewlyEligible.clear();
+	if ( ! ( fundamental > 0 ) )
+	{
+	    mEligiblePartials.clear();
+	    mHarmonicPartials.clear();
+	    return;
+	}
+	
+	std::sort( peaks.begin(), peaks.end(), SpectralPeak::sort_increasing_freq );
+	
+	//  peaks of a harmonic are adjacent, the loudest of them is taken:
+	Peaks::iterator bpIter = peaks.begin();
+	while ( bpIter != peaks.end() ) 
+	{
+	    const long harmonic = std::lround( bpIter->frequency() / fundamental );
+	    Peaks::iterator loudest = bpIter;
+	    for ( ++bpIter; bpIter != peaks.end() && 
+	                    std::lround( bpIter->frequency() / fundamental ) == harmonic; ++bpIter )
+	    {
+	        if ( bpIter->amplitude() > loudest->amplitude() )
+	        {
+	            loudest = bpIter;
+	        }
+	    }
+	    if ( harmonic < 1 )
+	    {
+	        continue;
+	    }
+	    
+	    if ( harmonic >= long( mHarmonicPartials.size() ) )
+	    {
+	        mHarmonicPartials.resize( harmonic + 1, 0 );
+	    }
+	    
+	    Partial * partial = mHarmonicPartials[ harmonic ];
+	    if ( 0 == partial )
+	    {
+	        mCollectedPartials.push_back( Partial() );
+	        partial = & mCollectedPartials.back();
+	        partial->setLabel( harmonic );
+	    }
+	    partial->insert( frameTime + loudest->time(), loudest->createBreakpoint() );
+	    mNewlyEligible.push_back( eligible( partial ) );
+	}
+	
+	//  only the Partials extended in this frame stay eligible:
+	std::fill( mHarmonicPartials.begin(), mHarmonicPartials.end(), (Partial *) 0 );
+	for ( const EligiblePartial & entry : mNewlyEligible )
+	{
+	    mHarmonicPartials[ entry.partial->label() ] = entry.partial;
+	}
+	mEligiblePartials.swap( mNewlyEligible );
+}
+
 // ---------------------------------------------------------------------------
 //	finishBuilding
 // ---------------------------------------------------------------------------
@@ -313,6 +345,64 @@ PartialBuilder::finishBuilding( PartialList & product )
     //  reset the builder state:
     mEligiblePartials.clear();
     mNewlyEligible.clear();
+    mPeakFrequencies.clear();
+    mSortedEligible.clear();
+    mHarmonicPartials.clear();
+}
+
+// ---------------------------------------------------------------------------
+//	takeFinished
+// ---------------------------------------------------------------------------
+//  Return the Partials that cannot be extended anymore, because they
+//  were not extended by the last call to buildPartials(), by appending 
+//  them to the supplied PartialList. This can be used to get Partials 
+//  while building is still in progress, the remaining Partials are
+//  returned by finishBuilding().
+//
+//  Partials are spliced, so the eligible Partials (pointers) are not
+//  invalidated.
+//
+void
+PartialBuilder::takeFinished( PartialList & product )
+{
+    PartialPtrs & eligible = mSortedEligible;
+    eligible.clear();
+    for ( const EligiblePartial & entry : mEligiblePartials )
+    {
+        eligible.push_back( entry.partial );
+    }
+    std::sort( eligible.begin(), eligible.end(), std::less< Partial * >() );
+    
+    PartialList::iterator it = mCollectedPartials.begin();
+    while ( it != mCollectedPartials.end() )
+    {
+        PartialList::iterator next = it;
+        ++next;
+        
+        if ( ! std::binary_search( eligible.begin(), eligible.end(), &*it, std::less< Partial * >() ) )
+        {
+            product.splice( product.end(), mCollectedPartials, it );
+        }
+        it = next;
+    }
+}
+
+// ---------------------------------------------------------------------------
+//	extendedPartials
+// ---------------------------------------------------------------------------
+//  Return the Partials extended or spawned by the last call to 
+//  buildPartials() or buildHarmonicPartials(), whose last Breakpoint
+//  is the one of that frame, by appending them to the supplied 
+//  PartialPtrs. Live analysis reads the Partials this way as they 
+//  grow, and may erase all but the last Breakpoint of them.
+//
+void
+PartialBuilder::extendedPartials( PartialPtrs & product ) const
+{
+    for ( const EligiblePartial & entry : mEligiblePartials )
+    {
+        product.push_back( entry.partial );
+    }
 }
 
 
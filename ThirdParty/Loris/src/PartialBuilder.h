@@ -95,6 +95,17 @@ public:
     //  process.
 	void buildPartials( Peaks & peaks, double frameTime );
 
+    //  buildHarmonicPartials
+    //
+    //	Append spectral peaks to Partials by harmonic of the specified
+    //	fundamental frequency (in Hz) of the current frame, instead of 
+    //	by frequency distance: the loudest peak nearest to each harmonic
+    //	extends the Partial of that harmonic if it was extended in the
+    //	previous frame, otherwise it spawns a new Partial, labeled by 
+    //	the harmonic number. Other peaks are not used. The frequency
+    //	warping envelope and the drift are not used either.
+	void buildHarmonicPartials( Peaks & peaks, double frameTime, double fundamental );
+
     //  finishBuilding
     //
 	//	Un-do the frequency warping performed in buildPartials, and return 
@@ -104,17 +115,42 @@ public:
     //  supplied PartialList.
 	void finishBuilding( PartialList & product );
 
-private:
-
-// --- auxiliary member functions ---
+    //  takeFinished
+    //
+    //  Return the Partials that cannot be extended anymore, because they
+    //  were not extended by the last call to buildPartials(), by appending 
+    //  them to the supplied PartialList. This can be used to get Partials 
+    //  while building is still in progress, the remaining Partials are
+    //  returned by finishBuilding().
+    void takeFinished( PartialList & product );
+
+    //  extendedPartials
+    //
+    //  Return the Partials extended or spawned by the last call to 
+    //  buildPartials() or buildHarmonicPartials(), whose last Breakpoint
+    //  is the one of that frame, by appending them to the supplied 
+    //  PartialPtrs. Live analysis reads the Partials this way as they 
+    //  grow, and may erase all but the last Breakpoint of them.
+    void extendedPartials( PartialPtrs & product ) const;
 
-    double freq_distance( const Partial & partial, const SpectralPeak & pk );
+private:
 
-    bool better_match( const Partial & part, const SpectralPeak & pk1,
-		   	           const SpectralPeak & pk2 );
-    bool better_match( const Partial & part1, 
-	  		           const Partial & part2, const SpectralPeak & pk );                       
-                       
+// --- eligible partials ---
+
+    //  An eligible Partial with the frequency of its last Breakpoint, and
+    //  that frequency normalized by the warping envelope at the end time 
+    //  of the Partial, read once when the Breakpoint is inserted, so 
+    //  matching does not walk the Breakpoints of the Partial.
+    struct EligiblePartial
+    {
+        double frequency;
+        double normFrequency;
+        Partial * partial;
+    };
+    
+    typedef std::vector< EligiblePartial > EligiblePartials;
+    
+    EligiblePartial eligible( Partial * partial ) const;
                        
 // --- collected partials ---
 
@@ -122,8 +158,14 @@ private:
 
 // --- builder state variables ---
 		
-	PartialPtrs mEligiblePartials;
-    PartialPtrs mNewlyEligible;                 // 	keep track of eligible partials here
+	EligiblePartials mEligiblePartials;         //  by increasing frequency
+    EligiblePartials mNewlyEligible;            // 	keep track of eligible partials here
+    std::vector< double > mPeakFrequencies;     //  normalized frequencies of the peaks
+                                                //  of a frame, reused
+    PartialPtrs mSortedEligible;                //  eligible partials by address, reused
+                                                //  by takeFinished()
+    PartialPtrs mHarmonicPartials;              //  eligible partial of each harmonic
+                                                //  number, or 0, by buildHarmonicPartials()
 
 // --- parameters ---
     	
@@ -0,0 +1,99 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * PartialFilter.C
+ *
+ * Implementation of class Loris::PartialFilter, a gain curve over frequency
+ * applied to Partials as they are synthesized.
+ *
+ */
+#if HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include "PartialFilter.h"
+
+#include <algorithm>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  PartialFilter constructor
+// ---------------------------------------------------------------------------
+//! Construct a flat filter.
+PartialFilter::PartialFilter( void ) :
+    m_entriesPerOctave( ( TableSize - 1 ) / std::log2( highestFrequency() / lowestFrequency() ) )
+{
+    std::fill_n( m_gains, (int) TableSize, 1.f );
+}
+
+// ---------------------------------------------------------------------------
+//  addPeak
+// ---------------------------------------------------------------------------
+//! Add a peak (or a notch, for a negative gain) to the curve, a bell in
+//! log frequency, like a formant.
+//!
+//! \param  frequency Centre of the peak in Hz.
+//! \param  gainDb Gain at the centre in dB.
+//! \param  octaves Width of the peak, octaves between the frequencies
+//!         the gain is half of gainDb at.
+void PartialFilter::addPeak( double frequency, double gainDb, double octaves )
+{
+    if ( gainDb == 0. || frequency <= 0. || octaves <= 0. )
+        return;
+    
+    //  gain in dB is a gaussian of the distance in octaves
+    const double spread = octaves / ( 2. * std::sqrt( 2. * std::log( 2. ) ) );
+    for ( int i = 0; i < TableSize; ++i )
+    {
+        const double distance = std::log2( entryFrequency( i ) / frequency ) / spread;
+        m_gains[i] *= (float) std::pow( 10., gainDb * std::exp( -0.5 * distance * distance ) / 20. );
+    }
+    m_flat = false;
+}
+
+// ---------------------------------------------------------------------------
+//  addShelf
+// ---------------------------------------------------------------------------
+//! Add a shelf to the curve, rising over an octave around a frequency.
+//!
+//! \param  frequency Middle of the shelf slope in Hz.
+//! \param  gainDb Gain of the shelf in dB.
+//! \param  high true for frequencies above the shelf, false for the
+//!         ones below it.
+void PartialFilter::addShelf( double frequency, double gainDb, bool high )
+{
+    if ( gainDb == 0. || frequency <= 0. )
+        return;
+    
+    //  a raised cosine over the octave of the slope
+    for ( int i = 0; i < TableSize; ++i )
+    {
+        const double octaves = std::log2( entryFrequency( i ) / frequency ) * ( high ? 1. : -1. );
+        const double x = std::max( -0.5, std::min( 0.5, octaves ) );
+        const double weight = 0.5 + 0.5 * std::sin( 3.14159265358979324 * x );
+        m_gains[i] *= (float) std::pow( 10., gainDb * weight / 20. );
+    }
+    m_flat = false;
+}
+
+}	//	end of namespace Loris
@@ -0,0 +1,109 @@
+#ifndef INCLUDE_PARTIAL_FILTER_H
+#define INCLUDE_PARTIAL_FILTER_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * PartialFilter.h
+ *
+ * Definition of class Loris::PartialFilter, a gain curve over frequency
+ * applied to Partials as they are synthesized.
+ *
+ */
+
+#include <cmath>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	class PartialFilter
+//
+//! Equalizer of the Partials of a RealTimeSynthesizer: a gain curve over
+//! the frequency they sound at, tabulated at TableSize frequencies spaced
+//! logarithmically from lowestFrequency() to highestFrequency() (flat
+//! beyond them). Every Partial is scaled by the gain at its frequency,
+//! looked up once per block, instead of filtering the output sample by
+//! sample. The curve is fixed in Hz, so formants stay where they are when
+//! notes are transposed.
+//
+class PartialFilter
+{
+//	-- public interface --
+public:
+    enum { TableSize = 256 };
+    
+    //! Lowest and highest frequency of the table, Hz.
+    static double lowestFrequency( void ) { return 20.; }
+    static double highestFrequency( void ) { return 20000.; }
+    
+    //! Construct a flat filter.
+    PartialFilter( void );
+    
+    //! Add a peak (or a notch, for a negative gain) to the curve, a bell in
+    //! log frequency, like a formant.
+    //!
+    //! \param  frequency Centre of the peak in Hz.
+    //! \param  gainDb Gain at the centre in dB.
+    //! \param  octaves Width of the peak, octaves between the frequencies
+    //!         the gain is half of gainDb at.
+    void addPeak( double frequency, double gainDb, double octaves );
+    
+    //! Add a shelf to the curve, rising over an octave around a frequency.
+    //!
+    //! \param  frequency Middle of the shelf slope in Hz.
+    //! \param  gainDb Gain of the shelf in dB.
+    //! \param  high true for frequencies above the shelf, false for the
+    //!         ones below it.
+    void addShelf( double frequency, double gainDb, bool high );
+    
+    //! Return true if the gain is 1 at all frequencies.
+    bool isFlat( void ) const noexcept { return m_flat; }
+    
+    //! Return the gain at a frequency in Hz, interpolated linearly between
+    //! the entries of the table.
+    float gainAt( double frequency ) const noexcept
+    {
+        if ( m_flat || ! ( frequency > lowestFrequency() ) )
+            return m_gains[0];
+        
+        const double x = std::log2( frequency / lowestFrequency() ) * m_entriesPerOctave;
+        if ( x >= TableSize - 1 )
+            return m_gains[TableSize - 1];
+        const int i = (int) x;
+        return m_gains[i] + (float) ( x - i ) * ( m_gains[i + 1] - m_gains[i] );
+    }
+    
+//	-- private helpers --
+private:
+    //! Return the frequency of an entry of the table in Hz.
+    double entryFrequency( int entry ) const { return lowestFrequency() * std::exp2( entry / m_entriesPerOctave ); }
+    
+//	-- private member variables --
+private:
+    float m_gains[TableSize];       //  linear gains
+    double m_entriesPerOctave;      //  entries of the table per octave
+    bool m_flat = true;
+};
+
+}	//	end of namespace Loris
+
+#endif /* ndef INCLUDE_PARTIAL_FILTER_H */
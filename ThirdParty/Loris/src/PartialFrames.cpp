@@ -0,0 +1,207 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * PartialFrames.C
+ *
+ * Implementation of class Loris::PartialFrames, the Partials of a
+ * PartialBank resampled to a uniform frame grid, as frames of frequencies
+ * and amplitudes of all of them.
+ *
+ */
+#if HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include "PartialFrames.h"
+#include "LorisExceptions.h"
+
+#include <algorithm>
+#include <cmath>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  PartialFrames constructor
+// ---------------------------------------------------------------------------
+//! Build frames of the Partials of a bank, from time 0 to the end of
+//! the last Partial. Parts of Partials before time 0 are left out.
+//!
+//! \param  bank The bank.
+//! \param  hopTime time between frames in seconds, the hop of the analysis
+//! 	hrow  InvalidArgument if the hop is not positive.
+PartialFrames::PartialFrames( const PartialBank & bank, double hopTime ) :
+    m_hopTime( hopTime )
+{
+    if ( ! ( hopTime > 0. ) )
+        Throw( InvalidArgument, "Partial frames need a positive hop time." );
+
+    const double hopSamples = hopTime * bank.sampleRate();
+    const BreakpointArrays breakpoints = bank.breakpoints();
+    const int * samples = bank.breakpointSamples();
+
+    //  frames a Partial plays, from the first one at or after its fade in
+    //  to the last one at or before its fade out
+    const std::size_t numPartials = bank.size();
+    std::vector<long> firstFrame( numPartials ), lastFrame( numPartials );
+    long numFrames = 0;
+    for ( std::size_t i = 0; i < numPartials; ++i )
+    {
+        const PartialStruct & p = bank.partials()[i];
+        const int endSample = samples[p.firstBreakpoint + p.numBreakpoints - 1];
+        firstFrame[i] = std::max( 0L, (long) std::ceil( p.startSample / hopSamples ) );
+        lastFrame[i] = (long) std::floor( endSample / hopSamples );
+        numFrames = std::max( numFrames, lastFrame[i] + 1 );
+    }
+
+    //  Partials come in the order of their start, each takes the first
+    //  column free for two frames before its first one
+    std::vector<int> column( numPartials, -1 );
+    std::vector<long> columnEnd;    //  last frame of the Partial of each column
+    for ( std::size_t i = 0; i < numPartials; ++i )
+    {
+        if ( firstFrame[i] > lastFrame[i] )
+            continue;   //  shorter than a hop, between frames
+
+        std::size_t c = 0;
+        while ( c < columnEnd.size() && columnEnd[c] + 2 >= firstFrame[i] )
+            ++c;
+        if ( c == columnEnd.size() )
+            columnEnd.push_back( 0 );
+        columnEnd[c] = lastFrame[i];
+        column[i] = (int) c;
+    }
+
+    m_numFrames = (std::size_t) numFrames;
+    m_numColumns = ( columnEnd.size() + ColumnAlignment - 1 ) / ColumnAlignment * ColumnAlignment;
+    const std::size_t cells = m_numFrames * m_numColumns;
+    m_frequency.assign( cells, 0.f );
+    m_amplitude.assign( cells, 0.f );
+    m_active.assign( cells, 0 );
+    m_partial.assign( cells, -1 );
+
+    //  Partials are sampled by walking their Breakpoints once
+    for ( std::size_t i = 0; i < numPartials; ++i )
+    {
+        if ( column[i] < 0 )
+            continue;
+
+        const PartialStruct & p = bank.partials()[i];
+        int b = p.firstBreakpoint;
+        const int last = p.firstBreakpoint + p.numBreakpoints - 1;
+        for ( long frame = firstFrame[i]; frame <= lastFrame[i]; ++frame )
+        {
+            const double sample = frame * hopSamples;
+            while ( b < last - 1 && samples[b + 1] <= sample )
+                ++b;
+
+            const int next = std::min( b + 1, last );
+            const double span = samples[next] - samples[b];
+            const float alpha = span > 0. ? (float) std::min( 1., std::max( 0., ( sample - samples[b] ) / span ) ) : 0.f;
+            const std::size_t cell = (std::size_t) frame * m_numColumns + column[i];
+            m_frequency[cell] = breakpoints.frequency( b ) + alpha * ( breakpoints.frequency( next ) - breakpoints.frequency( b ) );
+            m_amplitude[cell] = breakpoints.amplitude( b ) + alpha * ( breakpoints.amplitude( next ) - breakpoints.amplitude( b ) );
+            m_active[cell] = 1;
+            m_partial[cell] = (std::int32_t) i;
+        }
+    }
+
+    //  silent cells take the frequency of the Partial after them, so it
+    //  fades in at its own frequency, except the cell right after a Partial
+    //  and the cells after the last one, which keep the frequency it faded
+    //  out at (Partials of a column are two frames apart)
+    for ( std::size_t c = 0; c < m_numColumns; ++c )
+    {
+        float held = 0.f;
+        std::size_t lastActive = 0;
+        bool found = false;
+        for ( std::size_t frame = m_numFrames; frame-- > 0; )
+        {
+            const std::size_t cell = frame * m_numColumns + c;
+            if ( m_active[cell] )
+            {
+                held = m_frequency[cell];
+                lastActive = found ? lastActive : frame;
+                found = true;
+            }
+            else
+            {
+                m_frequency[cell] = held;
+            }
+        }
+
+        for ( std::size_t frame = 1; found && frame < m_numFrames; ++frame )
+        {
+            const std::size_t cell = frame * m_numColumns + c;
+            if ( ! m_active[cell] && ( m_active[cell - m_numColumns] || frame > lastActive ) )
+                m_frequency[cell] = m_frequency[cell - m_numColumns];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  create
+// ---------------------------------------------------------------------------
+//! Build frames and return them as shared pointer.
+PartialFrames::Ptr PartialFrames::create( const PartialBank & bank, double hopTime )
+{
+    return std::make_shared<const PartialFrames>( bank, hopTime );
+}
+
+// ---------------------------------------------------------------------------
+//  interpolate
+// ---------------------------------------------------------------------------
+//! Interpolate frequencies and amplitudes of all columns at a time,
+//! linearly between the frames around it. Amplitudes are zero before
+//! the first frame and after the last one.
+//!
+//! \param  time time in seconds
+//! \param  frequency numColumns() frequencies to fill
+//! \param  amplitude numColumns() amplitudes to fill
+void PartialFrames::interpolate( double time, float * frequency, float * amplitude ) const
+{
+    const double position = time / m_hopTime;
+    if ( m_numFrames == 0 || position < 0. || position > m_numFrames - 1 )
+    {
+        if ( m_numFrames > 0 )
+            std::copy_n( frequencies( position < 0. ? 0 : m_numFrames - 1 ), m_numColumns, frequency );
+        else
+            std::fill_n( frequency, m_numColumns, 0.f );
+        std::fill_n( amplitude, m_numColumns, 0.f );
+        return;
+    }
+
+    //  the same for every column, no branch: compilers vectorize it
+    const std::size_t frame = std::min( (std::size_t) position, m_numFrames - 1 );
+    const std::size_t next = std::min( frame + 1, m_numFrames - 1 );
+    const float alpha = (float) ( position - frame );
+    const float * f0 = frequencies( frame );
+    const float * f1 = frequencies( next );
+    const float * a0 = amplitudes( frame );
+    const float * a1 = amplitudes( next );
+    for ( std::size_t c = 0; c < m_numColumns; ++c )
+    {
+        frequency[c] = f0[c] + alpha * ( f1[c] - f0[c] );
+        amplitude[c] = a0[c] + alpha * ( a1[c] - a0[c] );
+    }
+}
+
+}	//	end of namespace Loris
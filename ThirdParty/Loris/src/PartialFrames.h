@@ -0,0 +1,132 @@
+#ifndef INCLUDE_PARTIAL_FRAMES_H
+#define INCLUDE_PARTIAL_FRAMES_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * PartialFrames.h
+ *
+ * Definition of class Loris::PartialFrames, the Partials of a PartialBank
+ * resampled to a uniform frame grid, as frames of frequencies and
+ * amplitudes of all of them.
+ *
+ */
+
+#include "PartialBank.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	class PartialFrames
+//
+//! The Partials of a PartialBank sampled at a uniform hop, usually the hop
+//! of the analysis which found them, as a matrix of frames by columns:
+//! each frame (row) holds the frequency and amplitude of every column,
+//! with a mask of the columns a Partial plays. Breakpoints of a bank are
+//! at irregular times per Partial, so interpolating all of them walks
+//! each Partial separately; interpolating frames is one sweep over two
+//! contiguous rows, the same operation for every column, which compilers
+//! vectorize and which feeds oscillator lanes and spectral engines with
+//! all Partials at once.
+//!
+//! Partials which do not overlap in time share a column, with at least two
+//! silent frames between them, so there are about as many columns as the
+//! most Partials sounding at once (padded to ColumnAlignment). Silent
+//! cells have zero amplitude and the frequency of the Partial of their
+//! column fading in or out next to them, so Partials fade at their own
+//! frequency when frames are interpolated, without any test of the mask.
+//!
+//! Like the bank, frames are built once (not on the audio thread) and
+//! shared by everyone playing the bank. It is an optional layout, it
+//! takes numFrames() * numColumns() cells however sparse the bank is.
+//
+class PartialFrames
+{
+//	-- public interface --
+public:
+    //! Shared, immutable frames.
+    typedef std::shared_ptr<const PartialFrames> Ptr;
+
+    //! Columns are padded to a multiple of it, the lanes of an oscillator bank.
+    enum { ColumnAlignment = 4 };
+
+    //! Build frames of the Partials of a bank, from time 0 to the end of
+    //! the last Partial. Parts of Partials before time 0 are left out.
+    //!
+    //! \param  bank The bank.
+    //! \param  hopTime time between frames in seconds, the hop of the analysis
+    //! 	hrow  InvalidArgument if the hop is not positive.
+    PartialFrames( const PartialBank & bank, double hopTime );
+
+    //! Build frames and return them as shared pointer.
+    static Ptr create( const PartialBank & bank, double hopTime );
+
+    //! Return the time between frames in seconds.
+    double hopTime( void ) const { return m_hopTime; }
+
+    //! Return the number of frames, the first one is at time 0.
+    std::size_t numFrames( void ) const { return m_numFrames; }
+
+    //! Return the number of columns of a frame, a multiple of ColumnAlignment.
+    std::size_t numColumns( void ) const { return m_numColumns; }
+
+    //! Return the numColumns() frequencies (Hz) of a frame.
+    const float * frequencies( std::size_t frame ) const { return m_frequency.data() + frame * m_numColumns; }
+
+    //! Return the numColumns() amplitudes of a frame, 0 for silent cells.
+    const float * amplitudes( std::size_t frame ) const { return m_amplitude.data() + frame * m_numColumns; }
+
+    //! Return the numColumns() mask bytes of a frame, 1 where a Partial plays.
+    const std::uint8_t * active( std::size_t frame ) const { return m_active.data() + frame * m_numColumns; }
+
+    //! Return the numColumns() indices of the Partials (in the bank) of a
+    //! frame, -1 for silent cells.
+    const std::int32_t * partials( std::size_t frame ) const { return m_partial.data() + frame * m_numColumns; }
+
+    //! Interpolate frequencies and amplitudes of all columns at a time,
+    //! linearly between the frames around it. Amplitudes are zero before
+    //! the first frame and after the last one.
+    //!
+    //! \param  time time in seconds
+    //! \param  frequency numColumns() frequencies to fill
+    //! \param  amplitude numColumns() amplitudes to fill
+    void interpolate( double time, float * frequency, float * amplitude ) const;
+
+//	-- private member variables --
+private:
+    double m_hopTime;
+    std::size_t m_numFrames = 0;
+    std::size_t m_numColumns = 0;
+    std::vector<float> m_frequency;         //  frames of numColumns cells
+    std::vector<float> m_amplitude;
+    std::vector<std::uint8_t> m_active;
+    std::vector<std::int32_t> m_partial;
+};
+
+}	//	end of namespace Loris
+
+#endif /* ndef INCLUDE_PARTIAL_FRAMES_H */
@@ -0,0 +1,135 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * PartialGains.C
+ *
+ * Implementation of class Loris::PartialGains, gains of the individual
+ * Partials of a PartialBank applied as they are synthesized.
+ *
+ */
+#if HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include "PartialGains.h"
+#include "PartialBank.h"
+
+#include <algorithm>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  create
+// ---------------------------------------------------------------------------
+//! Return gains of 1 for all Partials of a bank, all chunks are one chunk.
+PartialGains::Ptr PartialGains::create( const PartialBank & bank )
+{
+    std::shared_ptr< Chunk > unity = std::make_shared< Chunk >();
+    std::fill( unity->gains, unity->gains + ChunkSize, 1.f );
+    
+    std::shared_ptr< PartialGains > gains( new PartialGains() );
+    gains->m_bank = &bank;
+    gains->m_size = bank.size();
+    gains->m_chunks.assign( ( bank.size() + ChunkSize - 1 ) / ChunkSize, unity );
+    return gains;
+}
+
+// ---------------------------------------------------------------------------
+//  withGain
+// ---------------------------------------------------------------------------
+//! Return these gains with some Partials set to a gain.
+PartialGains::Ptr PartialGains::withGain( const std::vector< std::size_t > & partials, float gain ) const
+{
+    std::shared_ptr< PartialGains > edited = copy();
+    std::vector< bool > copied( m_chunks.size(), false );
+    for ( std::size_t partial : partials )
+    {
+        if ( partial < m_size )
+            edited->set( partial, gain, copied );
+    }
+    return edited;
+}
+
+// ---------------------------------------------------------------------------
+//  withLabelGain
+// ---------------------------------------------------------------------------
+//! Return these gains with the Partials of a label set to a gain.
+PartialGains::Ptr PartialGains::withLabelGain( const PartialBank & bank, int label, float gain ) const
+{
+    std::shared_ptr< PartialGains > edited = copy();
+    std::vector< bool > copied( m_chunks.size(), false );
+    const std::size_t n = std::min( m_size, bank.size() );
+    for ( std::size_t partial = 0; partial < n; ++partial )
+    {
+        if ( bank.partials()[partial].label == label )
+            edited->set( partial, gain, copied );
+    }
+    return edited;
+}
+
+// ---------------------------------------------------------------------------
+//  rebased
+// ---------------------------------------------------------------------------
+//! Return these gains for another bank of the same Partials.
+PartialGains::Ptr PartialGains::rebased( const PartialBank & bank ) const
+{
+    if ( bank.size() != m_size )
+        return nullptr;
+    
+    std::shared_ptr< PartialGains > gains = copy();
+    gains->m_bank = &bank;
+    return gains;
+}
+
+// ---------------------------------------------------------------------------
+//  copy
+// ---------------------------------------------------------------------------
+//! Return a copy of these gains, sharing all chunks.
+std::shared_ptr< PartialGains > PartialGains::copy( void ) const
+{
+    std::shared_ptr< PartialGains > gains( new PartialGains() );
+    gains->m_bank = m_bank;
+    gains->m_size = m_size;
+    gains->m_numEdited = m_numEdited;
+    gains->m_chunks = m_chunks;
+    return gains;
+}
+
+// ---------------------------------------------------------------------------
+//  set
+// ---------------------------------------------------------------------------
+//! Set the gain of a Partial of a copy, its chunk is copied the first time.
+void PartialGains::set( std::size_t partial, float gain, std::vector< bool > & copied )
+{
+    const std::size_t c = partial / ChunkSize;
+    if ( ! copied[c] )
+    {
+        m_chunks[c] = std::make_shared< Chunk >( *m_chunks[c] );
+        copied[c] = true;
+    }
+    
+    float & g = m_chunks[c]->gains[partial % ChunkSize];
+    m_numEdited += ( gain != 1.f ) - ( g != 1.f );
+    g = gain;
+}
+
+}	//	end of namespace Loris
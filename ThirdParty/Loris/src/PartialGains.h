@@ -0,0 +1,130 @@
+#ifndef INCLUDE_PARTIAL_GAINS_H
+#define INCLUDE_PARTIAL_GAINS_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010, 2014 by Kelly Fitz, Lippold Haken and Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * PartialGains.h
+ *
+ * Definition of class Loris::PartialGains, gains of the individual Partials
+ * of a PartialBank applied as they are synthesized.
+ *
+ */
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//	begin namespace
+namespace Loris {
+
+class PartialBank;
+
+// ---------------------------------------------------------------------------
+//	class PartialGains
+//
+//! Gains of the Partials of a PartialBank, by their index in the bank, for
+//! edits of single Partials or groups of them (muting, deleting, changing
+//! their level) without preparing the bank again. A RealTimeSynthesizer
+//! playing the bank scales every Partial by its gain, looked up at every
+//! block and ramped over it, so an edit is heard from the next block on.
+//!
+//! Gains are immutable and shared, like the bank. An edit makes new gains
+//! that share the unchanged chunks of ChunkSize Partials with the gains it
+//! was made from and copy only the chunks of the Partials edited, so it
+//! costs the same for a bank of ten Partials and of many thousands.
+//
+class PartialGains
+{
+//	-- public interface --
+public:
+    typedef std::shared_ptr< const PartialGains > Ptr;
+    
+    enum { ChunkSize = 256 };
+    
+    //! Return gains of 1 for all Partials of a bank.
+    static Ptr create( const PartialBank & bank );
+    
+    //! Return these gains with some Partials set to a gain.
+    //!
+    //! \param  partials Indices of the Partials in the bank, the ones
+    //!         beyond size() are ignored.
+    //! \param  gain The gain, 0 mutes the Partials.
+    Ptr withGain( const std::vector< std::size_t > & partials, float gain ) const;
+    
+    //! Return these gains with the Partials of a label set to a gain.
+    //!
+    //! \param  bank The bank of the gains, see appliesTo().
+    //! \param  label The label of the Partials.
+    //! \param  gain The gain, 0 mutes the Partials.
+    Ptr withLabelGain( const PartialBank & bank, int label, float gain ) const;
+    
+    //! Return these gains for another bank of the same Partials, a bank
+    //! mapped from the image of the bank of the gains. All chunks are
+    //! shared, nullptr if the banks have a different number of Partials.
+    Ptr rebased( const PartialBank & bank ) const;
+    
+    //! Return true if the gains are for a bank. They are for the bank they
+    //! were created for, it is only compared, never read through them.
+    bool appliesTo( const PartialBank & bank ) const noexcept { return m_bank == &bank; }
+    
+    //! Return the number of Partials of the bank.
+    std::size_t size( void ) const noexcept { return m_size; }
+    
+    //! Return the gain of a Partial.
+    //!
+    //! \param  partial Index of the Partial in the bank, less than size().
+    float gain( std::size_t partial ) const noexcept
+    {
+        return m_chunks[partial / ChunkSize]->gains[partial % ChunkSize];
+    }
+    
+    //! Return true if the gains of all Partials are 1.
+    bool isIdentity( void ) const noexcept { return m_numEdited == 0; }
+    
+//	-- private helpers --
+private:
+    struct Chunk
+    {
+        float gains[ChunkSize];
+    };
+    
+    PartialGains( void ) {}
+    
+    //! Return a copy of these gains, sharing all chunks.
+    std::shared_ptr< PartialGains > copy( void ) const;
+    
+    //! Set the gain of a Partial of a copy, its chunk is copied the first
+    //! time, see copy().
+    void set( std::size_t partial, float gain, std::vector< bool > & copied );
+    
+//	-- private member variables --
+private:
+    const PartialBank * m_bank = nullptr;                   //  bank the gains are for, compared only
+    std::size_t m_size = 0;
+    std::size_t m_numEdited = 0;                            //  Partials of gain other than 1
+    std::vector< std::shared_ptr< Chunk > > m_chunks;       //  gains by ChunkSize Partials, shared
+                                                            //  chunks are never changed
+};
+
+}	//	end of namespace Loris
+
+#endif /* ndef INCLUDE_PARTIAL_GAINS_H */
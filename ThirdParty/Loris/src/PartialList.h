@@ -39,6 +39,7 @@
 //	a definition of Partial for PartialList to be unambiguous.
 #include "Partial.h"
 #include <list>
+#include <vector>
 
 //	begin namespace
 namespace Loris {
@@ -56,6 +57,25 @@ typedef std::list< Loris::Partial > PartialList;
 typedef std::list< Loris::Partial >::iterator PartialListIterator;
 typedef std::list< Loris::Partial >::const_iterator PartialListConstIterator;
 
+// ---------------------------------------------------------------------------
+//	class PartialVector
+//
+//	PartialVector is a typedef for a std::vector<> of Loris Partials, the
+//	contiguous alternative to PartialList for collections which are built
+//	once and then edited in place (prepared for synthesis, scaled,
+//	shifted). A Partial is addressed by its index, a handle which stays
+//	valid as long as Partials are only appended, and ranges of it are
+//	split between threads without collecting them first (see
+//	parallelForEach). Operators taking ranges of Partials (Channelizer,
+//	Sieve, Resampler, Dilator, PartialUtils) and containers (Distiller)
+//	work on both, PartialBank is built from either. Analyzer and SdifFile
+//	produce a PartialList, PartialVector( list.begin(), list.end() ) is the
+//	adapter.
+//
+typedef std::vector< Loris::Partial > PartialVector;
+typedef std::vector< Loris::Partial >::iterator PartialVectorIterator;
+typedef std::vector< Loris::Partial >::const_iterator PartialVectorConstIterator;
+
 }	//	end of namespace Loris
 
 #endif /* ndef INCLUDE_PARTIALLIST_H */
@@ -44,6 +44,7 @@
 #include "BreakpointEnvelope.h"
 #include "BreakpointUtils.h"
 #include "Envelope.h"
+#include "LinearEnvelope.h"
 #include "Partial.h"
 
 #include "phasefix.h"
@@ -118,10 +119,11 @@ PartialMutator::operator=( const PartialMutator & rhs )
 void 
 AmplitudeScaler::operator()( Partial & p ) const
 {
+	EnvelopeCursor cursor( *env );
 	for ( Partial::iterator pos = p.begin(); pos != p.end(); ++pos ) 
 	{		
 		pos.breakpoint().setAmplitude( pos.breakpoint().amplitude() * 
-									          env->valueAt( pos.time() ) );
+									          cursor.valueAt( pos.time() ) );
 	}	
 }
 
@@ -134,10 +136,11 @@ AmplitudeScaler::operator()( Partial & p ) const
 void 
 BandwidthScaler::operator()( Partial & p ) const
 {
+	EnvelopeCursor cursor( *env );
 	for ( Partial::iterator pos = p.begin(); pos != p.end(); ++pos ) 
 	{		
 		pos.breakpoint().setBandwidth( pos.breakpoint().bandwidth() * 
-									   env->valueAt( pos.time() ) );
+									   cursor.valueAt( pos.time() ) );
 	}	
 }
 
@@ -150,9 +153,10 @@ BandwidthScaler::operator()( Partial & p ) const
 void 
 BandwidthSetter::operator()( Partial & p ) const
 {
+	EnvelopeCursor cursor( *env );
 	for ( Partial::iterator pos = p.begin(); pos != p.end(); ++pos ) 
 	{		
-		pos.breakpoint().setBandwidth( env->valueAt( pos.time() ) );
+		pos.breakpoint().setBandwidth( cursor.valueAt( pos.time() ) );
 	}	
 }
 
@@ -165,10 +169,11 @@ BandwidthSetter::operator()( Partial & p ) const
 void 
 FrequencyScaler::operator()( Partial & p ) const
 {
+	EnvelopeCursor cursor( *env );
 	for ( Partial::iterator pos = p.begin(); pos != p.end(); ++pos ) 
 	{		
 		pos.breakpoint().setFrequency( pos.breakpoint().frequency() * 
-									   env->valueAt( pos.time() ) );
+									   cursor.valueAt( pos.time() ) );
 	}	
 }
 
@@ -182,6 +187,7 @@ FrequencyScaler::operator()( Partial & p ) const
 void 
 NoiseRatioScaler::operator()( Partial & p ) const
 {
+	EnvelopeCursor cursor( *env );
 	for ( Partial::iterator pos = p.begin(); pos != p.end(); ++pos ) 
 	{		
 		//	compute new bandwidth value:
@@ -189,7 +195,7 @@ NoiseRatioScaler::operator()( Partial & p ) const
 		if ( bw < 1. ) 
 		{
 			double ratio = bw  / (1. - bw);
-			ratio *= env->valueAt( pos.time() );
+			ratio *= cursor.valueAt( pos.time() );
 			bw = ratio / ( 1. + ratio );
 		}
 		else 
@@ -210,11 +216,12 @@ NoiseRatioScaler::operator()( Partial & p ) const
 void 
 PitchShifter::operator()( Partial & p ) const
 {
+	EnvelopeCursor cursor( *env );
 	for ( Partial::iterator pos = p.begin(); pos != p.end(); ++pos ) 
 	{		
 		//	compute frequency scale:
 		double scale = 
-			std::pow( 2., ( 0.01 * env->valueAt( pos.time() ) ) / 12. );				
+			std::pow( 2., ( 0.01 * cursor.valueAt( pos.time() ) ) / 12. );				
 		pos.breakpoint().setFrequency( pos.breakpoint().frequency() * scale );
 	}	
 }
@@ -43,6 +43,7 @@
  */
 
 #include "Envelope.h"
+#include "ParallelFor.h"
 #include "Partial.h"
 
 #include <functional>
@@ -163,6 +164,28 @@ void scaleAmplitude( Iter b, Iter e, const Arg & arg )
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	scaleAmplitude (parallel)
+// ---------------------------------------------------------------------------
+//! Scale the amplitude of a sequence of Partials, as scaleAmplitude( b, e, arg ).
+//! Partials are mutated concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param	b is the beginning of a sequence of Partials to mutate.
+//! \param	e is the end of a sequence of Partials to mutate.
+//! \param	arg is either a constant scale factor or an Envelope
+//!			describing the time-varying scale factor.
+//! \param	numThreads is the largest number of threads to use.
+//
+template< class Iter, class Arg >
+void scaleAmplitude( Iter b, Iter e, const Arg & arg, unsigned int numThreads )
+{
+	const AmplitudeScaler scaler( arg );
+	parallelForEach( b, e, numThreads, [&scaler]( Partial & p ) { scaler( p ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	BandwidthScaler
 //	
@@ -223,6 +246,28 @@ void scaleBandwidth( Iter b, Iter e, const Arg & arg )
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	scaleBandwidth (parallel)
+// ---------------------------------------------------------------------------
+//! Scale the bandwidth of a sequence of Partials, as scaleBandwidth( b, e, arg ).
+//! Partials are mutated concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param	b is the beginning of a sequence of Partials to mutate.
+//! \param	e is the end of a sequence of Partials to mutate.
+//! \param	arg is either a constant scale factor or an Envelope
+//!			describing the time-varying scale factor.
+//! \param	numThreads is the largest number of threads to use.
+//
+template< class Iter, class Arg >
+void scaleBandwidth( Iter b, Iter e, const Arg & arg, unsigned int numThreads )
+{
+	const BandwidthScaler scaler( arg );
+	parallelForEach( b, e, numThreads, [&scaler]( Partial & p ) { scaler( p ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	BandwidthSetter
 //	
@@ -283,6 +328,28 @@ void setBandwidth( Iter b, Iter e, const Arg & arg )
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	setBandwidth (parallel)
+// ---------------------------------------------------------------------------
+//! Set the bandwidth of a sequence of Partials, as setBandwidth( b, e, arg ).
+//! Partials are mutated concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param	b is the beginning of a sequence of Partials to mutate.
+//! \param	e is the end of a sequence of Partials to mutate.
+//! \param	arg is either a constant bandwidth or an Envelope
+//!			describing the time-varying bandwidth.
+//! \param	numThreads is the largest number of threads to use.
+//
+template< class Iter, class Arg >
+void setBandwidth( Iter b, Iter e, const Arg & arg, unsigned int numThreads )
+{
+	const BandwidthSetter setter( arg );
+	parallelForEach( b, e, numThreads, [&setter]( Partial & p ) { setter( p ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	FrequencyScaler
 //	
@@ -343,6 +410,28 @@ void scaleFrequency( Iter b, Iter e, const Arg & arg )
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	scaleFrequency (parallel)
+// ---------------------------------------------------------------------------
+//! Scale the frequency of a sequence of Partials, as scaleFrequency( b, e, arg ).
+//! Partials are mutated concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param	b is the beginning of a sequence of Partials to mutate.
+//! \param	e is the end of a sequence of Partials to mutate.
+//! \param	arg is either a constant scale factor or an Envelope
+//!			describing the time-varying scale factor.
+//! \param	numThreads is the largest number of threads to use.
+//
+template< class Iter, class Arg >
+void scaleFrequency( Iter b, Iter e, const Arg & arg, unsigned int numThreads )
+{
+	const FrequencyScaler scaler( arg );
+	parallelForEach( b, e, numThreads, [&scaler]( Partial & p ) { scaler( p ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	NoiseRatioScaler
 //	
@@ -403,6 +492,28 @@ void scaleNoiseRatio( Iter b, Iter e, const Arg & arg )
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	scaleNoiseRatio (parallel)
+// ---------------------------------------------------------------------------
+//! Scale the relative noise content of a sequence of Partials, as scaleNoiseRatio( b, e, arg ).
+//! Partials are mutated concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param	b is the beginning of a sequence of Partials to mutate.
+//! \param	e is the end of a sequence of Partials to mutate.
+//! \param	arg is either a constant scale factor or an Envelope
+//!			describing the time-varying scale factor.
+//! \param	numThreads is the largest number of threads to use.
+//
+template< class Iter, class Arg >
+void scaleNoiseRatio( Iter b, Iter e, const Arg & arg, unsigned int numThreads )
+{
+	const NoiseRatioScaler scaler( arg );
+	parallelForEach( b, e, numThreads, [&scaler]( Partial & p ) { scaler( p ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	PitchShifter
 //	
@@ -466,6 +577,28 @@ void shiftPitch( Iter b, Iter e, const Arg & arg )
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	shiftPitch (parallel)
+// ---------------------------------------------------------------------------
+//! Shift the pitch of a sequence of Partials, as shiftPitch( b, e, arg ).
+//! Partials are mutated concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param	b is the beginning of a sequence of Partials to mutate.
+//! \param	e is the end of a sequence of Partials to mutate.
+//! \param	arg is either a constant pitch shift in cents or an Envelope
+//!			describing the time-varying pitch shift in cents.
+//! \param	numThreads is the largest number of threads to use.
+//
+template< class Iter, class Arg >
+void shiftPitch( Iter b, Iter e, const Arg & arg, unsigned int numThreads )
+{
+	const PitchShifter shifter( arg );
+	parallelForEach( b, e, numThreads, [&shifter]( Partial & p ) { shifter( p ); } );
+}
+
 //	These ones are not derived from PartialMutator, because
 //	they don't use an Envelope and cannot be time-varying.
 
@@ -545,6 +678,30 @@ void crop( Iter b, Iter e, double t1, double t2 )
 	}
 }
 
+// ---------------------------------------------------------------------------
+//	crop (parallel)
+// ---------------------------------------------------------------------------
+//! Trim a sequence of Partials to a time span, as crop( b, e, t1, t2 ).
+//! Partials are mutated concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param	b is the beginning of a sequence of Partials to crop.
+//! \param	e is the end of a sequence of Partials to crop.
+//! \param	t1 is the beginning of the time span to which the Partials
+//!         should be cropped.
+//! \param	t2 is the end of the time span to which the Partials
+//!         should be cropped.
+//! \param	numThreads is the largest number of threads to use.
+//
+template< class Iter >
+void crop( Iter b, Iter e, double t1, double t2, unsigned int numThreads )
+{
+	const Cropper cropper( t1, t2 );
+	parallelForEach( b, e, numThreads, [&cropper]( Partial & p ) { cropper( p ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	TimeShifter
 //	
@@ -601,6 +758,27 @@ void shiftTime( Iter b, Iter e, double offset )
 		shifter( *b++ );
 	}
 }
+
+// ---------------------------------------------------------------------------
+//	shiftTime (parallel)
+// ---------------------------------------------------------------------------
+//! Shift the time of a sequence of Partials, as shiftTime( b, e, offset ).
+//! Partials are mutated concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param	b is the beginning of a sequence of Partials to shift.
+//! \param	e is the end of a sequence of Partials to shift.
+//! \param	offset is a constant offset in seconds.
+//! \param	numThreads is the largest number of threads to use.
+//
+template< class Iter >
+void shiftTime( Iter b, Iter e, double offset, unsigned int numThreads )
+{
+	const TimeShifter shifter( offset );
+	parallelForEach( b, e, numThreads, [&shifter]( Partial & p ) { shifter( p ); } );
+}
 	
 // ---------------------------------------------------------------------------
 //	timeSpan
@@ -725,6 +903,28 @@ void fixPhaseBefore( Iter b, Iter e, double t )
     }
 }
 
+// ---------------------------------------------------------------------------
+//	fixPhaseBefore (parallel range)
+// ---------------------------------------------------------------------------
+//! Fix the phases of a range of Partials, as fixPhaseBefore( b, e, t ).
+//! Partials are fixed concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param b    The beginning of a range of Partials whose phases 
+//!             should be fixed.
+//! \param e    The end of a range of Partials whose phases 
+//!             should be fixed.
+//! \param t    The time before which phases should be adjusted.
+//! \param numThreads The largest number of threads to use.
+//
+template < class Iter >
+void fixPhaseBefore( Iter b, Iter e, double t, unsigned int numThreads )
+{
+    parallelForEach( b, e, numThreads, [&]( Partial & p ) { fixPhaseBefore( p, t ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	fixPhaseAfter
 // ---------------------------------------------------------------------------
@@ -772,6 +972,28 @@ void fixPhaseAfter( Iter b, Iter e, double t )
     }
 }
 
+// ---------------------------------------------------------------------------
+//	fixPhaseAfter (parallel range)
+// ---------------------------------------------------------------------------
+//! Fix the phases of a range of Partials, as fixPhaseAfter( b, e, t ).
+//! Partials are fixed concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param b    The beginning of a range of Partials whose phases 
+//!             should be fixed.
+//! \param e    The end of a range of Partials whose phases 
+//!             should be fixed.
+//! \param t    The time after which phases should be adjusted.
+//! \param numThreads The largest number of threads to use.
+//
+template < class Iter >
+void fixPhaseAfter( Iter b, Iter e, double t, unsigned int numThreads )
+{
+    parallelForEach( b, e, numThreads, [&]( Partial & p ) { fixPhaseAfter( p, t ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	fixPhaseForward
 // ---------------------------------------------------------------------------
@@ -828,6 +1050,31 @@ void fixPhaseForward( Iter b, Iter e, double tbeg, double tend )
     }
 }
 
+// ---------------------------------------------------------------------------
+//	fixPhaseForward (parallel range)
+// ---------------------------------------------------------------------------
+//! Fix the phases of a range of Partials, as fixPhaseForward( b, e, tbeg, tend ).
+//! Partials are fixed concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param b    The beginning of a range of Partials whose phases 
+//!             should be fixed.
+//! \param e    The end of a range of Partials whose phases 
+//!             should be fixed.
+//! \param tbeg The phases and frequencies of Breakpoints later than the 
+//!             one nearest this time will be modified.
+//! \param tend The phases and frequencies of Breakpoints earlier than the 
+//!             one nearest this time will be modified.
+//! \param numThreads The largest number of threads to use.
+//
+template < class Iter >
+void fixPhaseForward( Iter b, Iter e, double tbeg, double tend, unsigned int numThreads )
+{
+    parallelForEach( b, e, numThreads, [&]( Partial & p ) { fixPhaseForward( p, tbeg, tend ); } );
+}
+
 
 // ---------------------------------------------------------------------------
 //	fixPhaseAt
@@ -884,6 +1131,28 @@ void fixPhaseAt( Iter b, Iter e, double t )
     }
 }
 
+// ---------------------------------------------------------------------------
+//	fixPhaseAt (parallel range)
+// ---------------------------------------------------------------------------
+//! Fix the phases of a range of Partials, as fixPhaseAt( b, e, t ).
+//! Partials are fixed concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param b    The beginning of a range of Partials whose phases 
+//!             should be fixed.
+//! \param e    The end of a range of Partials whose phases 
+//!             should be fixed.
+//! \param t    The time at which phases should be made correct.
+//! \param numThreads The largest number of threads to use.
+//
+template < class Iter >
+void fixPhaseAt( Iter b, Iter e, double t, unsigned int numThreads )
+{
+    parallelForEach( b, e, numThreads, [&]( Partial & p ) { fixPhaseAt( p, t ); } );
+}
+
 // ---------------------------------------------------------------------------
 //	fixPhaseBetween
 // ---------------------------------------------------------------------------
@@ -962,6 +1231,31 @@ void fixPhaseBetween( Iter b, Iter e, double t1, double t2 )
     }
 }
 
+// ---------------------------------------------------------------------------
+//	fixPhaseBetween (parallel range)
+// ---------------------------------------------------------------------------
+//! Fix the phases of a range of Partials, as fixPhaseBetween( b, e, t1, t2 ).
+//! Partials are fixed concurrently by up to numThreads threads (0
+//! for one per hardware core), see parallelForEach. Partials in a
+//! random access container (std::vector< Partial >) are not collected
+//! first.
+//!
+//! \param b    The beginning of a range of Partials whose phases 
+//!             should be fixed.
+//! \param e    The end of a range of Partials whose phases 
+//!             should be fixed.
+//! \param t1   The time before which Partial frequencies and phases will 
+//!             not be modified.
+//! \param t2   The time after which Partial frequencies and phases will 
+//!             not be modified.
+//! \param numThreads The largest number of threads to use.
+//
+template < class Iter >
+void fixPhaseBetween( Iter b, Iter e, double t1, double t2, unsigned int numThreads )
+{
+    parallelForEach( b, e, numThreads, [&]( Partial & p ) { fixPhaseBetween( p, t1, t2 ); } );
+}
+
 
 	
 //	-- predicates --
@@ -0,0 +1,221 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis, 
+ * manipulation, and synthesis of digitized sounds using the Reassigned 
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * Pruner.C
+ *
+ * Implementation of class Pruner.
+ *
+ */
+
+#if HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
+#include "Pruner.h"
+#include "LorisExceptions.h"
+#include "Notifier.h"
+#include "Partial.h"
+#include "PartialUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	Pruner constructor
+// ---------------------------------------------------------------------------
+//! Construct a new Pruner.
+//!
+//!   \param   floorDb is the absolute amplitude floor in dB (relative
+//!            to full scale), Partials not reaching it are pruned.
+//!   \param   maskingDb is the masking threshold in dB relative to the
+//!            peak amplitude of a neighbor Partial, must not be positive.
+//!            Use a very low value (like -200) to disable masking.
+//!   \param   minBreakpoints is the minimum number of Breakpoints of
+//!            Partials that are kept.
+//!   \throw   InvalidArgument if maskingDb is positive.
+//
+Pruner::Pruner( double floorDb, double maskingDb, std::size_t minBreakpoints ) :
+	_floor( std::pow( 10., 0.05 * floorDb ) ),
+	_masking( std::pow( 10., 0.05 * maskingDb ) ),
+	_minBreakpoints( minBreakpoints )
+{
+	if ( maskingDb > 0. )
+	{
+		Throw( InvalidArgument, "the Pruner masking threshold must not be positive" );
+	}
+}
+
+//	Summary of a Partial considered for masking.
+struct PrunedPartial
+{
+	std::size_t index;
+	double logFrequency;    //  octaves
+	double peak;
+	double startTime, endTime;
+	bool masked;
+};
+
+// ---------------------------------------------------------------------------
+//	prune
+// ---------------------------------------------------------------------------
+//! Remove the Partials not worth synthesizing from a PartialList.
+//! The order of the remaining Partials is unaltered.
+//!
+//! \param  partials is the collection of Partials to prune in-place
+//! \return the number of Partials removed
+//
+std::size_t 
+Pruner::prune( PartialList & partials ) const
+{
+	const std::size_t sizeBefore = partials.size();
+	const std::vector< bool > isPruned = findPruned( partials );
+	
+	std::size_t index = 0;
+	for ( PartialList::iterator it = partials.begin(); it != partials.end(); ++index )
+	{
+		if ( isPruned[ index ] )
+		{
+			it = partials.erase( it );
+		}
+		else
+		{
+			++it;
+		}
+	}
+	
+	LORIS_DEBUGGER << "Pruner removed " << sizeBefore - partials.size() 
+	         << " of " << sizeBefore << " Partials" << endl;
+	
+	return sizeBefore - partials.size();
+}
+
+// ---------------------------------------------------------------------------
+//	pruned
+// ---------------------------------------------------------------------------
+//! Return copies of the Partials worth synthesizing, in their order,
+//! the same Partials prune() would keep. Partials which are pruned
+//! are never copied.
+//!
+//! \param  partials is the collection of Partials to select from
+//! \return the Partials kept, in contiguous storage
+//
+PartialVector 
+Pruner::pruned( const PartialList & partials ) const
+{
+	const std::vector< bool > isPruned = findPruned( partials );
+	
+	PartialVector kept;
+	kept.reserve( std::count( isPruned.begin(), isPruned.end(), false ) );
+	
+	std::size_t index = 0;
+	for ( PartialList::const_iterator it = partials.begin(); it != partials.end(); ++it, ++index )
+	{
+		if ( ! isPruned[ index ] )
+		{
+			kept.push_back( *it );
+		}
+	}
+	
+	LORIS_DEBUGGER << "Pruner kept " << kept.size() 
+	         << " of " << partials.size() << " Partials" << endl;
+	
+	return kept;
+}
+
+// ---------------------------------------------------------------------------
+//	findPruned
+// ---------------------------------------------------------------------------
+//! Flag the Partials not worth synthesizing.
+//!
+//! \param  partials is the collection of Partials to consider
+//! \return a flag for each Partial, in order, true if it is pruned
+//
+std::vector< bool > 
+Pruner::findPruned( const PartialList & partials ) const
+{
+	//	neighbors are within a third of an octave:
+	const double bandOctaves = 1. / 3.;
+	
+	std::vector< bool > isPruned( partials.size(), false );
+	
+	//	flag short and quiet Partials, summarize the others:
+	std::vector< PrunedPartial > kept;
+	std::size_t index = 0;
+	for ( PartialList::const_iterator it = partials.begin(); it != partials.end(); ++it, ++index )
+	{
+		const double peak = PartialUtils::peakAmplitude( *it );
+		const double frequency = PartialUtils::avgFrequency( *it );
+		if ( it->numBreakpoints() < _minBreakpoints || peak < _floor || frequency <= 0. )
+		{
+			isPruned[ index ] = true;
+			continue;
+		}
+		
+		PrunedPartial p = { index, std::log( frequency ) / std::log( 2. ), peak, 
+		                    it->startTime(), it->endTime(), false };
+		kept.push_back( p );
+	}
+	
+	//	find masked Partials, neighbors are found in 
+	//	frequency order:
+	std::sort( kept.begin(), kept.end(), 
+	           []( const PrunedPartial & a, const PrunedPartial & b ) 
+	           { return a.logFrequency < b.logFrequency; } );
+	
+	std::vector< PrunedPartial >::iterator lower = kept.begin();
+	for ( PrunedPartial & p : kept )
+	{
+		while ( lower->logFrequency < p.logFrequency - bandOctaves )
+		{
+			++lower;
+		}
+		
+		for ( std::vector< PrunedPartial >::iterator q = lower; 
+		      q != kept.end() && q->logFrequency <= p.logFrequency + bandOctaves; 
+		      ++q )
+		{
+			if ( &*q != &p && 
+			     p.peak < _masking * q->peak && 
+			     q->startTime <= p.startTime && p.endTime <= q->endTime )
+			{
+				p.masked = true;
+				break;
+			}
+		}
+	}
+	
+	for ( PrunedPartial & p : kept )
+	{
+		if ( p.masked )
+		{
+			isPruned[ p.index ] = true;
+		}
+	}
+	
+	return isPruned;
+}
+
+}	//	end of namespace Loris
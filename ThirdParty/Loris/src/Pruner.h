@@ -0,0 +1,142 @@
+#ifndef INCLUDE_PRUNER_H
+#define INCLUDE_PRUNER_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis, 
+ * manipulation, and synthesis of digitized sounds using the Reassigned 
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * Pruner.h
+ *
+ * Definition of class Pruner.
+ *
+ */
+
+#include "PartialList.h"
+
+#include <cstddef>
+#include <vector>
+
+//  begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  class Pruner
+//
+//! A Pruner removes Partials that are not worth synthesizing.
+//!
+//! Analysis of noisy sounds yields many tiny Partials that cost
+//! oscillator time but cannot be heard. A Pruner removes Partials
+//! 
+//! - having fewer Breakpoints than a minimum number,
+//! - whose peak amplitude is below an absolute amplitude floor,
+//! - or whose peak amplitude is below a masking threshold relative
+//!   to the peak amplitude of a neighbor: a Partial sounding during
+//!   the whole life of the pruned one, with average frequency within
+//!   a third of an octave (about a critical band) of its average
+//!   frequency.
+//!
+//! Only Partials as a whole are considered, Breakpoints of the
+//! Partials that are kept are not modified.
+//!
+//!   \sa Sieve, Synthesizer
+//
+class Pruner
+{
+//  -- instance variables --
+
+    double _floor;                  //! absolute amplitude floor
+    double _masking;                //! amplitude ratio to a louder neighbor
+                                    //! below which a Partial is masked, 
+                                    //! 0 for no masking
+    std::size_t _minBreakpoints;    //! Partials with fewer Breakpoints are pruned
+    
+//  -- public interface --
+public:
+
+//  -- global defaults and constants --
+
+    enum
+    {
+        //! Default absolute amplitude floor in dB, same as the 
+        //! default amplitude floor of the Analyzer.
+        DefaultFloorDb = -90,
+        
+        //! Default masking threshold in dB relative to a neighbor.
+        DefaultMaskingDb = -40,
+        
+        //! Default minimum number of Breakpoints.
+        DefaultMinBreakpoints = 3
+    };
+    
+//  -- construction --
+
+    //! Construct a new Pruner.
+    //!
+    //!   \param   floorDb is the absolute amplitude floor in dB (relative
+    //!            to full scale), Partials not reaching it are pruned.
+    //!   \param   maskingDb is the masking threshold in dB relative to the
+    //!            peak amplitude of a neighbor Partial, must not be positive.
+    //!            Use a very low value (like -200) to disable masking.
+    //!   \param   minBreakpoints is the minimum number of Breakpoints of
+    //!            Partials that are kept.
+    //!   \throw   InvalidArgument if maskingDb is positive.
+    explicit Pruner( double floorDb = DefaultFloorDb, 
+                     double maskingDb = DefaultMaskingDb,
+                     std::size_t minBreakpoints = DefaultMinBreakpoints );
+    
+    //  Use compiler-generated copy, assign, and destroy.
+    
+//  -- pruning --
+
+    //! Remove the Partials not worth synthesizing from a PartialList.
+    //! The order of the remaining Partials is unaltered.
+    //!
+    //! \param  partials is the collection of Partials to prune in-place
+    //! \return the number of Partials removed
+    std::size_t prune( PartialList & partials ) const;
+    
+    //! Function call operator: same as prune( PartialList & partials ).
+    std::size_t operator() ( PartialList & partials ) const
+    {
+        return prune( partials );
+    }
+    
+    //! Return copies of the Partials worth synthesizing, in their order,
+    //! the same Partials prune() would keep. Partials which are pruned
+    //! are never copied.
+    //!
+    //! \param  partials is the collection of Partials to select from
+    //! \return the Partials kept, in contiguous storage
+    PartialVector pruned( const PartialList & partials ) const;
+
+//  -- implementation --
+private:
+
+    //! Flag the Partials not worth synthesizing.
+    //!
+    //! \param  partials is the collection of Partials to consider
+    //! \return a flag for each Partial, in order, true if it is pruned
+    std::vector< bool > findPruned( const PartialList & partials ) const;
+
+};  //  end of class Pruner
+
+}   //  end of namespace Loris
+
+#endif /* ndef INCLUDE_PRUNER_H */
@@ -33,8 +33,10 @@
 #endif
 #include "RealtimeOscillator.h"
 #include "Filter.h"
+#include "LorisTrace.h"
 #include "Partial.h"
 #include "Notifier.h"
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #if defined(HAVE_M_PI) && (HAVE_M_PI)
@@ -43,11 +45,98 @@ const double Pi = M_PI;
 const double Pi = 3.14159265358979324;
 #endif
 const double TwoPi = 2*Pi;
-#define USE_SSE2
-#include "sse_mathfun.h"
+#include "RealtimeSimd.h"
 
 //  begin namespace
 namespace Loris {
+    // ---------------------------------------------------------------------------
+    //  RealtimeNoise construction
+    // ---------------------------------------------------------------------------
+    //  Seed the lanes and take the coefficients of the Oscillator prototype
+    //  filter.
+    //
+    RealtimeNoise::RealtimeNoise( unsigned int seed )
+    {
+        const Filter & proto = Oscillator::prototype_filter();
+        const std::vector< double > ffwd = proto.numerator();
+        const std::vector< double > fback = proto.denominator();
+        Assert( ffwd.size() <= 4 && fback.size() <= 4 );
+        
+        for (int i = 0; i < 4; i++)
+        {
+            m_ffwd[i] = i < (int) ffwd.size() ? (float) ( proto.gain() * ffwd[i] ) : 0.f;
+            m_fback[i] = i < (int) fback.size() ? (float) fback[i] : 0.f;
+        }
+        
+        for (int lane = 0; lane < NumLanes; lane++)
+        {
+            //  scramble seed and lane (MurmurHash3 finalizer), xorshift
+            //  must not start at 0
+            unsigned int h = seed * 0x9e3779b9u + ( lane + 1 ) * 0x85ebca6bu;
+            h ^= h >> 16;
+            h *= 0x7feb352du;
+            h ^= h >> 15;
+            h *= 0x846ca68bu;
+            h ^= h >> 16;
+            m_state[lane] = h != 0 ? h : 1;
+            
+            for (int i = 0; i < 3; i++)
+                m_delay[i][lane] = 0.f;
+        }
+    }
+    
+    // ---------------------------------------------------------------------------
+    //  generate
+    // ---------------------------------------------------------------------------
+    //  Compute the next n samples of all lanes. Every lane runs its own
+    //  xorshift32 generator, whose upper 23 bits are the mantissa of a float
+    //  in [1, 2), mapped to [-sqrt(3), sqrt(3)) for unity variance. The
+    //  noise is filtered by the prototype filter in transposed direct form
+    //  II, which behaves better than direct form in float.
+    //
+    void
+    RealtimeNoise::generate( float * out, int n ) noexcept
+    {
+        simd::v4su x = simd::loadUInt( m_state );
+        simd::v4sf s1 = simd::load( m_delay[0] );
+        simd::v4sf s2 = simd::load( m_delay[1] );
+        simd::v4sf s3 = simd::load( m_delay[2] );
+        
+        const simd::v4sf b0 = simd::set1( m_ffwd[0] );
+        const simd::v4sf b1 = simd::set1( m_ffwd[1] );
+        const simd::v4sf b2 = simd::set1( m_ffwd[2] );
+        const simd::v4sf b3 = simd::set1( m_ffwd[3] );
+        const simd::v4sf a1 = simd::set1( m_fback[1] );
+        const simd::v4sf a2 = simd::set1( m_fback[2] );
+        const simd::v4sf a3 = simd::set1( m_fback[3] );
+        
+        const simd::v4su one = simd::set1UInt( 0x3f800000 );   //  1.f
+        const simd::v4sf scale = simd::set1( (float) ( 2. * std::sqrt( 3. ) ) );
+        const simd::v4sf offset = simd::set1( (float) ( -3. * std::sqrt( 3. ) ) );
+        
+        for (int k = 0; k < n; k++)
+        {
+            x = simd::xorUInt( x, simd::shiftLeft< 13 >( x ) );
+            x = simd::xorUInt( x, simd::shiftRight< 17 >( x ) );
+            x = simd::xorUInt( x, simd::shiftLeft< 5 >( x ) );
+            
+            const simd::v4sf u = simd::asFloat( simd::orUInt( simd::shiftRight< 9 >( x ), one ) );
+            const simd::v4sf in = simd::add( simd::mul( u, scale ), offset );
+            
+            const simd::v4sf y = simd::add( simd::mul( b0, in ), s1 );
+            s1 = simd::add( simd::sub( simd::mul( b1, in ), simd::mul( a1, y ) ), s2 );
+            s2 = simd::add( simd::sub( simd::mul( b2, in ), simd::mul( a2, y ) ), s3 );
+            s3 = simd::sub( simd::mul( b3, in ), simd::mul( a3, y ) );
+            
+            simd::store( out + k * NumLanes, y );
+        }
+        
+        simd::storeUInt( m_state, x );
+        simd::store( m_delay[0], s1 );
+        simd::store( m_delay[1], s2 );
+        simd::store( m_delay[2], s3 );
+    }
+    
     // ---------------------------------------------------------------------------
     //  RealtimeOscillator construction
     // ---------------------------------------------------------------------------
@@ -55,9 +144,36 @@ namespace Loris {
     //
     RealtimeOscillator::RealtimeOscillator( void ) :
     Oscillator(),
-    m_frequencyScaling ( 1 )
+    m_frequencyScaling ( 1 ),
+    m_gain( 1 ),
+    m_dGain( 0 ),
+    m_noise( RealtimeNoise::NumLanes + 1 ),  //  not the seed of the bank
+    m_noiseUsed( NoiseBlock )
     {
     }
+    
+    // ---------------------------------------------------------------------------
+    //  modulation
+    // ---------------------------------------------------------------------------
+    //  Return the amplitude modulation of the next sample due to bandwidth:
+    //
+    //  This will give the right amplitude modulation when scaled
+    //  by the Partial amplitude:
+    //
+    //  carrier amp: sqrt( 1. - bandwidth ) * amp
+    //  modulation index: sqrt( 2. * bandwidth ) * amp
+    //
+    float
+    RealtimeOscillator::modulation( double bw ) noexcept
+    {
+        if ( m_noiseUsed == NoiseBlock )
+        {
+            m_noise.generate( m_noiseBuffer, NoiseBlock );
+            m_noiseUsed = 0;
+        }
+        const double nz = m_noiseBuffer[ RealtimeNoise::NumLanes * m_noiseUsed++ ];
+        return (float) ( std::sqrt( 1. - bw ) + ( nz * std::sqrt( 2. * bw ) ) );
+    }
     // ---------------------------------------------------------------------------
     //  resetEnvelopes
     // ---------------------------------------------------------------------------
@@ -181,9 +297,16 @@ namespace Loris {
     RealtimeOscillator::oscillate( float * begin, float * end,
                           const Breakpoint & bp, double srate, int dSample) noexcept
     {
-        double targetFreq = m_frequencyScaling * bp.frequency() * TwoPi / srate;     //  radians per sample
-        double targetAmp = bp.amplitude();
-        double targetBw = bp.bandwidth();
+        oscillate( begin, end, bp.frequency(), bp.amplitude(), bp.bandwidth(), srate, dSample );
+    }
+
+    void
+    RealtimeOscillator::oscillate( float * begin, float * end, double frequency, double amplitude,
+                          double bandwidth, double srate, int dSample) noexcept
+    {
+        double targetFreq = m_frequencyScaling * frequency * TwoPi / srate;     //  radians per sample
+        double targetAmp = amplitude;
+        double targetBw = bandwidth;
         
         //  clamp bandwidth:
         if ( targetBw > 1. )
@@ -207,128 +330,794 @@ namespace Loris {
         //	frequency, after adding only half the frequency step
         
         const double dAmp = (targetAmp - m_instamplitude)  * dTime;
-//        const double dBw = (targetBw - m_instbandwidth)  * dTime;
-        //  Use temporary local variables for speed.
-        //  Probably not worth it when I am computing square roots
-        //  and cosines...
-        double ph = m_determphase;
-//        double f = m_instfrequency;
-//        double a = m_instamplitude;
-//        double bw = m_instbandwidth;
-        
-        // Ignore bandwidth
-        //	Also use a more efficient sample loop when the bandwidth is zero.
-//        if (false 0 < bw || 0 < dBw )
-//        {
-//            double am, nz;
-//            for ( double * putItHere = begin; putItHere != end; ++putItHere )
-//            {
-//                //  use math functions in namespace std:
-//                using namespace std;
-//                
-//                //  compute amplitude modulation due to bandwidth:
-//                //
-//                //  This will give the right amplitude modulation when scaled
-//                //  by the Partial amplitude:
-//                //
-//                //  carrier amp: sqrt( 1. - bandwidth ) * amp
-//                //  modulation index: sqrt( 2. * bandwidth ) * amp
-//                //
-//                nz = m_filter.apply( m_modulator.sample() );
-//                am = sqrt( 1. - bw ) + ( nz * sqrt( 2. * bw ) );
-//                
-//                //  compute a sample and add it into the buffer:
-//                *putItHere += am * a * cos( ph );
-//                
-//                //  update the instantaneous oscillator state:
-//                f += dFreqOver2;
-//                ph += f;   //  frequency is radians per sample
-//                f += dFreqOver2;
-//                a += dAmp;
-//                bw += dBw;
-//                if (bw < 0.)
-//                {
-//                    bw = 0.;
-//                }
-//            }   // end of sample computation loop
-//        }
-//        else
-        {
-//          Vectorized loop
-            
-            double a4[4] = { m_instamplitude };
-            double f4[4] = { m_instfrequency };
-            V4SF ph4 = { (float) m_determphase };
-
-            for (int i = 1; i < 4; i++)
+        const double dBw = (targetBw - m_instbandwidth)  * dTime;
+        
+        //	Noise modulation only when there is bandwidth, the noise
+        //  comes from a RealtimeNoise a block at a time.
+        const bool noisy = 0 < m_instbandwidth || 0 < dBw;
+        const bool rampFrequency = dFreqOver2 != 0;
+        const bool rampAmplitude = dAmp != 0 || m_dGain != 0;
+        
+        if ( m_instamplitude == 0 && targetAmp == 0 )
+        {
+            //  silent (fading in from a null Breakpoint, or above
+            //  Nyquist), only the phase moves, and no noise is taken
+            const double n = end - begin;
+            m_determphase += n * ( m_instfrequency + n * dFreqOver2 );
+            m_instfrequency += 2 * n * dFreqOver2;
+            m_gain += n * m_dGain;
+        }
+        else if ( noisy )
+        {
+            if ( rampFrequency )
+                oscillateSegment< true, true, true >( begin, end, dFreqOver2, dAmp, dBw );
+            else
+                oscillateSegment< true, false, true >( begin, end, dFreqOver2, dAmp, dBw );
+        }
+        else if ( rampFrequency )
+        {
+            if ( rampAmplitude )
+                oscillateSegment< false, true, true >( begin, end, dFreqOver2, dAmp, dBw );
+            else
+                oscillateSegment< false, true, false >( begin, end, dFreqOver2, dAmp, dBw );
+        }
+        else
+        {
+            if ( rampAmplitude )
+                oscillateSegment< false, false, true >( begin, end, dFreqOver2, dAmp, dBw );
+            else
+                oscillateSegment< false, false, false >( begin, end, dFreqOver2, dAmp, dBw );
+        }
+        
+        //  wrap phase to prevent eventual loss of precision at
+        //  high oscillation frequencies:
+        //  (Doesn't really matter much exactly how we wrap it,
+        //  as long as it brings the phase nearer to zero.)
+        m_determphase = m2pi( m_determphase );
+        
+        //  set the bandwidth to its target value, just in case it
+        //  didn't arrive exactly (overshooting bandwidth could be
+        //  bad, and it does happen), frequency and amplitude are
+        //  where the segment left them:
+        m_instbandwidth = targetBw;
+    }
+    
+    // ---------------------------------------------------------------------------
+    //  oscillateSegment
+    // ---------------------------------------------------------------------------
+    //  Accumulate the samples of oscillate() into a range and leave the
+    //  oscillator state (phase unwrapped) at its end. Four samples are
+    //  computed at once with SSE2, the few left one at a time. Frequency is
+    //  not stepped unless it ramps, amplitude and gain are one product
+    //  unless one of them ramps, and only noisy segments are modulated,
+    //  taking noise for samples of non-zero amplitude only.
+    //
+    template < bool Noisy, bool RampFrequency, bool RampAmplitude >
+    void
+    RealtimeOscillator::oscillateSegment( float * begin, float * end, double dFreqOver2,
+                                          double dAmp, double dBw ) noexcept
+    {
+        double bw = m_instbandwidth;
+        double a4[4] = { m_instamplitude };
+        double f4[4] = { m_instfrequency };
+        double g4[4] = { m_gain };
+        float ph4[4] = { (float) m_determphase };
+        const double level = m_instamplitude * m_gain;
+        
+        //  state of sample to from the one before it
+        auto advance = [&]( int to, int from )
+        {
+            if ( RampFrequency )
             {
-                f4[i] = f4[i - 1] + dFreqOver2;
-                ph4.f[i] = ph4.f[i - 1] + f4[i];
-                f4[i] = f4[i] + dFreqOver2;
-                a4[i] = a4[i - 1] + dAmp;
+                f4[to] = f4[from] + dFreqOver2;
+                ph4[to] = ph4[from] + f4[to];
+                f4[to] = f4[to] + dFreqOver2;
             }
+            else
+            {
+                f4[to] = f4[from];
+                ph4[to] = ph4[from] + f4[to];
+            }
+            if ( RampAmplitude )
+            {
+                a4[to] = a4[from] + dAmp;
+                g4[to] = g4[from] + m_dGain;
+            }
+        };
+        
+        static_assert( RampAmplitude || ! Noisy, "noisy segments check the amplitude of every sample" );
+        auto sample = [&]( int i, float cosine ) -> double
+        {
+            const double a = RampAmplitude ? a4[i] * g4[i] : level;
+            if ( ! Noisy )
+                return a * cosine;
+            
+            const double value = a4[i] == 0 ? 0 : a * cosine * modulation( bw );
+            bw = std::max( bw + dBw, 0. );
+            return value;
+        };
+        
+        for (int i = 1; i < 4; i++)
+            advance( i, i - 1 );
+        
+        float cosVal[4];
+        float * putItHere = begin;
+        for ( ; putItHere + 4  < end; putItHere += 4 )
+        {
+            simd::store( cosVal, simd::cos( simd::load( ph4 ) ) );
+            for (int i = 0; i < 4; i++)
+                putItHere[i] += sample( i, cosVal[i] );
+            
+            advance( 0, 3 );
+            for (int i = 1; i < 4; i++)
+                advance( i, i - 1 );
+        }
+        
+        for ( ; putItHere != end; ++putItHere )
+        {
+            *putItHere += sample( 0, std::cos( ph4[0] ) );
+            advance( 0, 0 );
+        }
+        
+        m_determphase = ph4[0];
+        m_instfrequency = f4[0];
+        if ( RampAmplitude )
+        {
+            m_instamplitude = a4[0];
+            m_gain = g4[0];
+        }
+    }
+    
+    //  64 samples per cycle at the reduced rate
+    const double RealtimeOscillatorBank::MaxDecimatedFrequency = TwoPi / 64;
+
+    // ---------------------------------------------------------------------------
+    //  RealtimeOscillatorBank construction
+    // ---------------------------------------------------------------------------
+    //  All lanes are silent.
+    //
+    RealtimeOscillatorBank::RealtimeOscillatorBank( void ) :
+        m_noise( 1 ),
+        m_kernel( CosineKernel ),
+        m_instructions( supportedInstructions() )
+    {
+        for (int i = 0; i < NumLanes; i++)
+        {
+            clearLane( i );
+            setLaneGain( i, 1., 0. );
+        }
+    }
+
+    // ---------------------------------------------------------------------------
+    //  setLane
+    // ---------------------------------------------------------------------------
+    //  Set the state of one lane. Frequency is in radians per sample,
+    //  the increments are added every sample.
+    //
+    void
+    RealtimeOscillatorBank::setLane( int lane, double phase, double frequency, double amplitude,
+                                     double dFrequency, double dAmplitude,
+                                     double bandwidth, double dBandwidth ) noexcept
+    {
+        m_phase[lane] = (float) m2pi( phase );
+        m_frequency[lane] = (float) frequency;
+        m_amplitude[lane] = (float) amplitude;
+        m_dFrequencyOver2[lane] = (float) ( 0.5 * dFrequency );
+        m_dAmplitude[lane] = (float) dAmplitude;
+        m_bandwidth[lane] = (float) bandwidth;
+        m_dBandwidth[lane] = (float) dBandwidth;
+    }
+
+    // ---------------------------------------------------------------------------
+    //  clearLane
+    // ---------------------------------------------------------------------------
+    //  Silence one lane.
+    //
+    void
+    RealtimeOscillatorBank::clearLane( int lane ) noexcept
+    {
+        setLane( lane, 0., 0., 0., 0., 0. );
+    }
+
+    // ---------------------------------------------------------------------------
+    //  setLaneGain
+    // ---------------------------------------------------------------------------
+    //  Set the gain applied to one lane and its increment per sample. The
+    //  gain is kept when the lane is set or cleared.
+    //
+    void
+    RealtimeOscillatorBank::setLaneGain( int lane, double gain, double dGain ) noexcept
+    {
+        m_gain[lane] = (float) gain;
+        m_dGain[lane] = (float) dGain;
+    }
+
+    // ---------------------------------------------------------------------------
+    //  hasBandwidth
+    // ---------------------------------------------------------------------------
+    //  Return true if some lane has bandwidth now or gets some while
+    //  rendering (as Oscillator decides it).
+    //
+    bool
+    RealtimeOscillatorBank::hasBandwidth( void ) const noexcept
+    {
+        for (int i = 0; i < NumLanes; i++)
+        {
+            if ( 0 < m_bandwidth[i] || 0 < m_dBandwidth[i] )
+                return true;
+        }
+        return false;
+    }
+
+    // ---------------------------------------------------------------------------
+    //  modulation
+    // ---------------------------------------------------------------------------
+    //  Compute the amplitude modulation due to bandwidth of all lanes for the
+    //  next n samples, same as RealtimeOscillator::modulation(), and advance
+    //  the bandwidths. Lanes without bandwidth are not modulated (exactly 1).
+    //
+    void
+    RealtimeOscillatorBank::modulation( float * mod, int n ) noexcept
+    {
+        m_noise.generate( mod, n );
+        
+        simd::v4sf bw = simd::load( m_bandwidth );
+        const simd::v4sf dBw = simd::load( m_dBandwidth );
+        const simd::v4sf zero = simd::zero();
+        const simd::v4sf one = simd::set1( 1.f );
+        
+        for (int k = 0; k < n; k++)
+        {
+            const simd::v4sf b = simd::min( bw, one );
+            const simd::v4sf nz = simd::load( mod + k * NumLanes );
+            const simd::v4sf am = simd::add( simd::sqrt( simd::sub( one, b ) ),
+                                        simd::mul( nz, simd::sqrt( simd::add( b, b ) ) ) );
+            simd::store( mod + k * NumLanes, am );
+            bw = simd::max( simd::add( bw, dBw ), zero );
+        }
+        
+        simd::store( m_bandwidth, bw );
+    }
+
+    // ---------------------------------------------------------------------------
+    //  oscillate
+    // ---------------------------------------------------------------------------
+    //  Accumulate the sum of all lanes into the specified half-open range
+    //  of floats using the selected kernel.
+    //
+    void
+    RealtimeOscillatorBank::oscillate( float * begin, float * end ) noexcept
+    {
+        LORIS_TRACE_ZONE( "RealtimeOscillatorBank::oscillate" );
+        if ( m_kernel == PhasorKernel )
+            oscillatePhasor( begin, end );
+#if LORIS_REALTIME_AVX2
+        else if ( m_instructions == AVX2Instructions )
+            oscillateCosineAVX2( begin, end );
+#endif
+        else
+            oscillateCosine( begin, end );
+    }
+
+    // ---------------------------------------------------------------------------
+    //  interpolatePoints (helper)
+    // ---------------------------------------------------------------------------
+    //  Accumulate the count - 1 intervals of Factor samples between
+    //  consecutive points, interpolated linearly, into out.
+    //
+    template< int Factor >
+    static void interpolatePoints( float * out, const float * points, int count ) noexcept
+    {
+        for ( int i = 0; i + 1 < count; ++i, out += Factor )
+        {
+            const float a = points[i];
+            const float step = ( points[i + 1] - a ) * ( 1.f / Factor );
+            for ( int k = 0; k < Factor; ++k )
+                out[k] += a + step * k;
+        }
+    }
+
+    // ---------------------------------------------------------------------------
+    //  oscillate (decimated)
+    // ---------------------------------------------------------------------------
+    //  Accumulate the sum of all lanes into the specified half-open range
+    //  of floats, computing a point every factor samples and one at end,
+    //  and interpolating linearly between them. The last step before end
+    //  may be shorter. The point at end is the value the lanes start the
+    //  next range with, so ranges join without a step.
+    //
+    void
+    RealtimeOscillatorBank::oscillate( float * begin, float * end, int factor ) noexcept
+    {
+        const int n = (int) ( end - begin );
+        if ( factor < 2 || n < 2 * factor || ! isDecimable( n, factor ) )
+        {
+            oscillate( begin, end );
+            return;
+        }
+        
+        LORIS_TRACE_ZONE( "RealtimeOscillatorBank::oscillate decimated" );
+        
+        //  the last point of a chunk is interpolated to the first one of
+        //  the next chunk
+        auto interpolate = [begin]( int from, float a, float b, int length )
+        {
+            float * out = begin + from;
+            const float step = ( b - a ) / length;
+            for ( int k = 0; k < length; ++k )
+                out[k] += a + step * k;
+        };
+        
+        float points[DecimatedChunkSize];
+        float pending = 0.f;
+        int pendingAt = -1;
+        int position = 0;
+        while ( position < n )
+        {
+            const int count = std::min( (int) DecimatedChunkSize, ( n - position + factor - 1 ) / factor );
+            const int uniform = position + count * factor > n ? count - 1 : count;
+            std::fill_n( points, count, 0.f );
+            oscillateSteps( points, uniform, factor );
+            if ( uniform < count )
+                oscillateSteps( points + uniform, 1, n - position - uniform * factor );
+            
+            if ( pendingAt >= 0 )
+                interpolate( pendingAt, pending, points[0], position - pendingAt );
+            if ( factor == 2 )
+                interpolatePoints< 2 >( begin + position, points, count );
+            else if ( factor == 4 )
+                interpolatePoints< 4 >( begin + position, points, count );
+            else
+                for ( int i = 0; i + 1 < count; ++i )
+                    interpolate( position + i * factor, points[i], points[i + 1], factor );
+            pending = points[count - 1];
+            pendingAt = position + ( count - 1 ) * factor;
+            position = std::min( position + count * factor, n );
+        }
+        
+        float last = 0.f;
+        oscillateSteps( &last, 1, 0 );
+        interpolate( pendingAt, pending, last, n - pendingAt );
+    }
+
+    // ---------------------------------------------------------------------------
+    //  isDecimable
+    // ---------------------------------------------------------------------------
+    //  Return true if no lane has bandwidth and every lane stays below
+    //  MaxDecimatedFrequency at 1 / factor of the rate over n samples.
+    //
+    bool
+    RealtimeOscillatorBank::isDecimable( int n, int factor ) const noexcept
+    {
+        if ( hasBandwidth() )
+            return false;
+        
+        for (int i = 0; i < NumLanes; i++)
+        {
+            const double last = m_frequency[i] + 2. * n * m_dFrequencyOver2[i];
+            if ( std::max( std::fabs( (double) m_frequency[i] ), std::fabs( last ) ) * factor > MaxDecimatedFrequency )
+                return false;
+        }
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------
+    //  oscillateSteps
+    // ---------------------------------------------------------------------------
+    //  Accumulate count samples of all lanes, step samples apart, into
+    //  consecutive values. The kernels advance by one sample, so the lanes
+    //  are scaled to steps of step samples: the phase trajectory
+    //  ph + k * (f + k * dFreqOver2) is the same in k samples of the steps,
+    //  of frequency step * f and half frequency step step^2 * dFreqOver2.
+    //  Amplitudes and gains are not scaled, only their steps.
+    //
+    void
+    RealtimeOscillatorBank::oscillateSteps( float * values, int count, int step ) noexcept
+    {
+        if ( count <= 0 )
+            return;
+        
+        float frequency[NumLanes], dFrequencyOver2[NumLanes], dAmplitude[NumLanes], dGain[NumLanes];
+        std::copy_n( m_frequency, (int) NumLanes, frequency );
+        std::copy_n( m_dFrequencyOver2, (int) NumLanes, dFrequencyOver2 );
+        std::copy_n( m_dAmplitude, (int) NumLanes, dAmplitude );
+        std::copy_n( m_dGain, (int) NumLanes, dGain );
+        
+        const float s = (float) step;
+        for (int i = 0; i < NumLanes; i++)
+        {
+            m_frequency[i] *= s;
+            m_dFrequencyOver2[i] *= s * s;
+            m_dAmplitude[i] *= s;
+            m_dGain[i] *= s;
+        }
+        
+        oscillate( values, values + count );
+        
+        //  frequencies after count * step samples
+        for (int i = 0; i < NumLanes; i++)
+            m_frequency[i] = frequency[i] + 2.f * count * s * dFrequencyOver2[i];
+        std::copy_n( dFrequencyOver2, (int) NumLanes, m_dFrequencyOver2 );
+        std::copy_n( dAmplitude, (int) NumLanes, m_dAmplitude );
+        std::copy_n( dGain, (int) NumLanes, m_dGain );
+    }
+
+    // ---------------------------------------------------------------------------
+    //  supportedInstructions
+    // ---------------------------------------------------------------------------
+    //  Return the best instruction set of this processor, the processor is
+    //  only asked once.
+    //
+    RealtimeOscillatorBank::Instructions
+    RealtimeOscillatorBank::supportedInstructions( void ) noexcept
+    {
+#if LORIS_SIMD_NEON
+        return NEONInstructions;
+#elif LORIS_REALTIME_AVX2
+        static const bool avx2 = hasAVX2();
+        return avx2 ? AVX2Instructions : SSE2Instructions;
+#else
+        return SSE2Instructions;
+#endif
+    }
+
+    // ---------------------------------------------------------------------------
+    //  setInstructions
+    // ---------------------------------------------------------------------------
+    //  Select the instruction set samples are computed with. SSE2 is the
+    //  baseline of x86, use the best one instead of any other the processor
+    //  does not have.
+    //
+    void
+    RealtimeOscillatorBank::setInstructions( Instructions instructions ) noexcept
+    {
+        const Instructions best = supportedInstructions();
+        if ( instructions == SSE2Instructions && best == AVX2Instructions )
+            m_instructions = instructions;
+        else
+            m_instructions = best;
+    }
+
+    // ---------------------------------------------------------------------------
+    //  oscillateCosine
+    // ---------------------------------------------------------------------------
+    //  Accumulate the sum of all lanes into the specified half-open range
+    //  of floats. Four samples of all four lanes are computed at once, then
+    //  transposed so that the lanes can be summed up vertically.
+    //
+    //  Samples are computed in closed form from the lane state at the beginning
+    //  of a chunk of samples,
+    //
+    //      ph(k) = ph + k * (f + k * dFreqOver2),  a(k) = (a + k * dAmp) * (g + k * dGain),
+    //
+    //  which is the same trajectory as updating the phase with the average
+    //  frequency of every sample, but rounding errors of float additions do
+    //  not accumulate sample by sample. The state is advanced, and phase
+    //  wrapped, at the end of every chunk only.
+    //
+    void
+    RealtimeOscillatorBank::oscillateCosine( float * begin, float * end ) noexcept
+    {
+        const int ChunkSize = 256;
+        
+        simd::v4sf ph = simd::load( m_phase );
+        simd::v4sf f = simd::load( m_frequency );
+        simd::v4sf a = simd::load( m_amplitude );
+        const simd::v4sf dFreqOver2 = simd::load( m_dFrequencyOver2 );
+        const simd::v4sf dAmp = simd::load( m_dAmplitude );
+        simd::v4sf g = simd::load( m_gain );
+        const simd::v4sf dGain = simd::load( m_dGain );
+        const simd::v4sf twoPi = simd::set1( (float) TwoPi );
+
+        //  samples of all lanes k samples after the beginning of the chunk
+        auto lanesAt = [&]( float k ) -> simd::v4sf
+        {
+            const simd::v4sf kv = simd::set1( k );
+            const simd::v4sf phk = simd::add( ph, simd::mul( kv, simd::add( f, simd::mul( kv, dFreqOver2 ) ) ) );
+            const simd::v4sf ak = simd::mul( simd::add( a, simd::mul( kv, dAmp ) ),
+                                        simd::add( g, simd::mul( kv, dGain ) ) );
+            return simd::mul( ak, simd::cos( phk ) );
+        };
+
+        //  amplitude modulation of the chunk due to bandwidth
+        const bool noisy = hasBandwidth();
+        simd::v4sf mod[ChunkSize];
+
+        while ( begin != end )
+        {
+            const int n = ( end - begin < ChunkSize ) ? (int) ( end - begin ) : ChunkSize;
+            float * const chunkEnd = begin + n;
+            float k = 0;
+            
+            if ( noisy )
+                modulation( (float *) mod, n );
 
-            V4SF cosVal;
             float * putItHere = begin;
-            for ( ; putItHere + 4  < end; putItHere += 4 )
+            for ( ; putItHere + 4 <= chunkEnd; putItHere += 4, k += 4 )
             {
-                cosVal.v = cos_ps(ph4.v);
-                for (int i = 0; i < 4; i++)
+                simd::v4sf s0 = lanesAt( k );
+                simd::v4sf s1 = lanesAt( k + 1 );
+                simd::v4sf s2 = lanesAt( k + 2 );
+                simd::v4sf s3 = lanesAt( k + 3 );
+                
+                if ( noisy )
                 {
-                    putItHere[i] += (a4[i] == 0 ? 0 : a4[i] * cosVal.f[i]);
+                    const simd::v4sf * m = mod + ( putItHere - begin );
+                    s0 = simd::mul( s0, m[0] );
+                    s1 = simd::mul( s1, m[1] );
+                    s2 = simd::mul( s2, m[2] );
+                    s3 = simd::mul( s3, m[3] );
                 }
 
-                f4[0] = f4[3] + dFreqOver2;
-                ph4.f[0] = ph4.f[3] + f4[0];
-                f4[0] = f4[0] + dFreqOver2;
-                a4[0] = a4[3] + dAmp;
-                for (int i = 1; i < 4; i++)
-                {
-                    f4[i] = f4[i - 1] + dFreqOver2;
-                    ph4.f[i] = ph4.f[i - 1] + f4[i];
-                    f4[i] = f4[i] + dFreqOver2;
-                    a4[i] = a4[i - 1] + dAmp;
-                }
+                //  rows are samples now, make them lanes and sum the lanes up
+                simd::transpose( s0, s1, s2, s3 );
+                simd::v4sf sum = simd::add( simd::add( s0, s1 ), simd::add( s2, s3 ) );
+                simd::store( putItHere, simd::add( simd::load( putItHere ), sum ) );
             }   // end of sample computation loop
 
-            for ( ; putItHere != end; ++putItHere )
+            for ( ; putItHere != chunkEnd; ++putItHere, k += 1 )
             {
-                //  use math functions in namespace std:
-                using namespace std;
+                simd::v4sf s = lanesAt( k );
+                if ( noisy )
+                    s = simd::mul( s, mod[ putItHere - begin ] );
+                *putItHere += simd::sumLanes( s );
+            }
 
-                //	no modulation when there is no bandwidth
+            //  advance the state to the end of the chunk
+            const simd::v4sf kn = simd::set1( (float) n );
+            ph = simd::add( ph, simd::mul( kn, simd::add( f, simd::mul( kn, dFreqOver2 ) ) ) );
+            f = simd::add( f, simd::mul( simd::add( kn, kn ), dFreqOver2 ) );
+            a = simd::add( a, simd::mul( kn, dAmp ) );
+            g = simd::add( g, simd::mul( kn, dGain ) );
 
-                //  compute a sample and add it into the buffer:
-                *putItHere += (a4[0] == 0 ? 0 : a4[0] * cos(ph4.f[0]));
+            //  wrap phases to prevent eventual loss of precision at
+            //  high oscillation frequencies:
+            const simd::v4sf cycles = simd::round( simd::div( ph, twoPi ) );
+            ph = simd::sub( ph, simd::mul( cycles, twoPi ) );
 
+            begin = chunkEnd;
+        }
 
-                //  update the instantaneous oscillator state:
-                f4[0] += dFreqOver2;
-                ph4.f[0] += f4[0];   //  frequency is radians per sample
-                f4[0] += dFreqOver2;
-                a4[0] += dAmp;
+        simd::store( m_phase, ph );
+        simd::store( m_frequency, f );
+        simd::store( m_amplitude, a );
+        simd::store( m_gain, g );
+    }
 
-            }   // end of
+    // ---------------------------------------------------------------------------
+    //  oscillatePhasor
+    // ---------------------------------------------------------------------------
+    //  Accumulate the sum of all lanes into the specified half-open range
+    //  of floats, following the phase trajectory of oscillateCosine() by a
+    //  recurrence. The phase step from sample k to k + 1 is
+    //
+    //      ph(k + 1) - ph(k) = f + (2k + 1) * dFreqOver2,
+    //
+    //  so the phasor z(k) = exp(i ph(k)) is rotated every sample by
+    //  w(k) = exp(i (f + (2k + 1) * dFreqOver2)), and w is rotated by the
+    //  constant c = exp(i 2 dFreqOver2) (the chirp). The real part of z is
+    //  the cosine. Both phasors are computed exactly from the closed form
+    //  phase at the beginning of every chunk, which renormalizes them.
+    //
+    void
+    RealtimeOscillatorBank::oscillatePhasor( float * begin, float * end ) noexcept
+    {
+        const int ChunkSize = PhasorChunkSize;
+        
+        simd::v4sf ph = simd::load( m_phase );
+        simd::v4sf f = simd::load( m_frequency );
+        simd::v4sf a = simd::load( m_amplitude );
+        const simd::v4sf dFreqOver2 = simd::load( m_dFrequencyOver2 );
+        const simd::v4sf dAmp = simd::load( m_dAmplitude );
+        simd::v4sf g = simd::load( m_gain );
+        const simd::v4sf dGain = simd::load( m_dGain );
+        const simd::v4sf twoPi = simd::set1( (float) TwoPi );
+        
+        //  rotation of the rotation, the same for all chunks
+        simd::v4sf cr, ci;
+        simd::sincos( simd::add( dFreqOver2, dFreqOver2 ), &ci, &cr );
+        
+        //  amplitude modulation of the chunk due to bandwidth
+        const bool noisy = hasBandwidth();
+        simd::v4sf mod[ChunkSize];
+        
+        while ( begin != end )
+        {
+            const int n = ( end - begin < ChunkSize ) ? (int) ( end - begin ) : ChunkSize;
+            float * const chunkEnd = begin + n;
+            
+            if ( noisy )
+                modulation( (float *) mod, n );
+            
+            //  exact phasors at the beginning of the chunk
+            simd::v4sf zr, zi, wr, wi;
+            simd::sincos( ph, &zi, &zr );
+            simd::sincos( simd::add( f, dFreqOver2 ), &wi, &wr );
+            simd::v4sf ak = a;
+            simd::v4sf gk = g;
+            
+            //  sample of all lanes, then advance the recurrence by a sample
+            auto nextLanes = [&]() -> simd::v4sf
+            {
+                const simd::v4sf s = simd::mul( simd::mul( ak, gk ), zr );
+                const simd::v4sf nzr = simd::sub( simd::mul( zr, wr ), simd::mul( zi, wi ) );
+                zi = simd::add( simd::mul( zr, wi ), simd::mul( zi, wr ) );
+                zr = nzr;
+                const simd::v4sf nwr = simd::sub( simd::mul( wr, cr ), simd::mul( wi, ci ) );
+                wi = simd::add( simd::mul( wr, ci ), simd::mul( wi, cr ) );
+                wr = nwr;
+                ak = simd::add( ak, dAmp );
+                gk = simd::add( gk, dGain );
+                return s;
+            };
+            
+            float * putItHere = begin;
+            for ( ; putItHere + 4 <= chunkEnd; putItHere += 4 )
+            {
+                simd::v4sf s0 = nextLanes();
+                simd::v4sf s1 = nextLanes();
+                simd::v4sf s2 = nextLanes();
+                simd::v4sf s3 = nextLanes();
+                
+                if ( noisy )
+                {
+                    const simd::v4sf * m = mod + ( putItHere - begin );
+                    s0 = simd::mul( s0, m[0] );
+                    s1 = simd::mul( s1, m[1] );
+                    s2 = simd::mul( s2, m[2] );
+                    s3 = simd::mul( s3, m[3] );
+                }
+                
+                //  rows are samples now, make them lanes and sum the lanes up
+                simd::transpose( s0, s1, s2, s3 );
+                simd::v4sf sum = simd::add( simd::add( s0, s1 ), simd::add( s2, s3 ) );
+                simd::store( putItHere, simd::add( simd::load( putItHere ), sum ) );
+            }   // end of sample computation loop
+            
+            for ( ; putItHere != chunkEnd; ++putItHere )
+            {
+                simd::v4sf s = nextLanes();
+                if ( noisy )
+                    s = simd::mul( s, mod[ putItHere - begin ] );
+                *putItHere += simd::sumLanes( s );
+            }
+            
+            //  advance the state to the end of the chunk in closed form,
+            //  as oscillateCosine() does
+            const simd::v4sf kn = simd::set1( (float) n );
+            ph = simd::add( ph, simd::mul( kn, simd::add( f, simd::mul( kn, dFreqOver2 ) ) ) );
+            f = simd::add( f, simd::mul( simd::add( kn, kn ), dFreqOver2 ) );
+            a = simd::add( a, simd::mul( kn, dAmp ) );
+            g = simd::add( g, simd::mul( kn, dGain ) );
+            
+            const simd::v4sf cycles = simd::round( simd::div( ph, twoPi ) );
+            ph = simd::sub( ph, simd::mul( cycles, twoPi ) );
+            
+            begin = chunkEnd;
+        }
+        
+        simd::store( m_phase, ph );
+        simd::store( m_frequency, f );
+        simd::store( m_amplitude, a );
+        simd::store( m_gain, g );
+    }
 
-            ph = ph4.f[0];
-            targetAmp = a4[0];
-            targetFreq = f4[0];
+    // ---------------------------------------------------------------------------
+    //  RealtimeHarmonics oscillate
+    // ---------------------------------------------------------------------------
+    //  Accumulate the sum of the harmonics into the specified half-open range
+    //  of floats, GroupSize samples at once. The phases of the fundamental
+    //  are accumulated in double and wrapped, their sines and cosines are
+    //  computed in the lanes, and the harmonics are summed by accumulate()
+    //  or accumulateAVX2(). The last group may be partly computed, the
+    //  samples past the end are not stored.
+    //
+    double
+    RealtimeHarmonics::oscillate( float * begin, float * end, double phase, double frequency, double dFrequency,
+                                  const Harmonic * harmonics, int count,
+                                  RealtimeOscillatorBank::Instructions instructions ) noexcept
+    {
+        double advance = frequency + 0.5 * dFrequency;
+        for ( int done = 0; begin + done < end; done += GroupSize )
+        {
+            const int n = std::min( (int) GroupSize, (int) ( end - begin - done ) );
+            float phases[GroupSize];
+            for ( int k = 0; k < GroupSize; ++k )
+            {
+                phases[k] = (float) phase;
+                if ( k < n )
+                {
+                    phase += advance;
+                    advance += dFrequency;
+                }
+                if ( k % 4 == 3 )
+                    phase -= TwoPi * std::floor( phase * ( 1. / TwoPi ) );
+            }
+            
+            float fr[GroupSize], fi[GroupSize];
+            for ( int k = 0; k < GroupSize; k += 4 )
+            {
+                simd::v4sf c, s;
+                simd::sincos( simd::load( phases + k ), &s, &c );
+                simd::store( fr + k, c );
+                simd::store( fi + k, s );
+            }
             
+            float samples[GroupSize];
+#if LORIS_REALTIME_AVX2
+            if ( instructions == RealtimeOscillatorBank::AVX2Instructions )
+                accumulateAVX2( samples, fr, fi, harmonics, count, done );
+            else
+#endif
+                accumulate( samples, fr, fi, harmonics, count, done );
+            
+            for ( int k = 0; k < n; ++k )
+                begin[done + k] += samples[k];
         }
+        return phase;
+    }
+
+    // ---------------------------------------------------------------------------
+    //  RealtimeHarmonics accumulate
+    // ---------------------------------------------------------------------------
+    //  Sum the harmonics over GroupSize samples, given the cosines and sines
+    //  of the phases of the fundamental. Every harmonic is rotated by them
+    //  from the one before:
+    //
+    //      exp(i k ph) = exp(i (k - 1) ph) * exp(i ph)
+    //
+    //  Harmonic k sounds cos(k ph + p) = Re(exp(i k ph) * exp(i p)) for the
+    //  phase p it is given, which is folded into its amplitude. The rotations
+    //  of the vectors of the group do not depend on each other, so they are
+    //  computed together.
+    //
+    void
+    RealtimeHarmonics::accumulate( float * samples, const float * fr, const float * fi,
+                                   const Harmonic * harmonics, int count, int offset ) noexcept
+    {
+        enum { Vectors = GroupSize / 4 };
+        static const float ramp[4] = { 0.f, 1.f, 2.f, 3.f };
         
-        //  wrap phase to prevent eventual loss of precision at
-        //  high oscillation frequencies:
-        //  (Doesn't really matter much exactly how we wrap it,
-        //  as long as it brings the phase nearer to zero.)
-        m_determphase = m2pi( ph );
-        
-        //  set the state variables to their target values,
-        //  just in case they didn't arrive exactly (overshooting
-        //  amplitude or, especially, bandwidth, could be bad, and
-        //  it does happen):
-        m_instfrequency = targetFreq;
-        m_instamplitude = targetAmp;
-        m_instbandwidth = targetBw;
+        simd::v4sf steps[Vectors], zr[Vectors], zi[Vectors], hr[Vectors], hi[Vectors], sum[Vectors];
+        for ( int v = 0; v < Vectors; ++v )
+        {
+            steps[v] = simd::add( simd::load( ramp ), simd::set1( 4.f * v ) );
+            zr[v] = simd::load( fr + 4 * v );
+            zi[v] = simd::load( fi + 4 * v );
+            hr[v] = simd::set1( 1.f );
+            hi[v] = simd::zero();
+            sum[v] = simd::zero();
+        }
+        
+        int number = 0;
+        for ( int h = 0; h < count; ++h )
+        {
+            const Harmonic & harmonic = harmonics[h];
+            for ( ; number < harmonic.number; ++number )
+            {
+                for ( int v = 0; v < Vectors; ++v )
+                {
+                    const simd::v4sf r = simd::sub( simd::mul( hr[v], zr[v] ), simd::mul( hi[v], zi[v] ) );
+                    hi[v] = simd::add( simd::mul( hr[v], zi[v] ), simd::mul( hi[v], zr[v] ) );
+                    hr[v] = r;
+                }
+            }
+            
+            const double amplitude = harmonic.amplitude + harmonic.dAmplitude * offset;
+            const simd::v4sf ac = simd::set1( (float) ( amplitude * harmonic.phaseCos ) );
+            const simd::v4sf as = simd::set1( (float) ( amplitude * harmonic.phaseSin ) );
+            const simd::v4sf dc = simd::set1( (float) ( harmonic.dAmplitude * harmonic.phaseCos ) );
+            const simd::v4sf ds = simd::set1( (float) ( harmonic.dAmplitude * harmonic.phaseSin ) );
+            for ( int v = 0; v < Vectors; ++v )
+            {
+                const simd::v4sf c = simd::add( ac, simd::mul( dc, steps[v] ) );
+                const simd::v4sf s = simd::add( as, simd::mul( ds, steps[v] ) );
+                sum[v] = simd::add( sum[v], simd::sub( simd::mul( c, hr[v] ), simd::mul( s, hi[v] ) ) );
+            }
+        }
+        
+        for ( int v = 0; v < Vectors; ++v )
+            simd::store( samples + 4 * v, sum[v] );
     }
-    
+
 }   //  end of namespace Loris
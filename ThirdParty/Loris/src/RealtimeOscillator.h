@@ -46,11 +46,59 @@
 	#endif
 #endif
 
+//  x86 processors may have AVX2, the cosine kernel of RealtimeOscillatorBank
+//  has a version for it (RealtimeOscillatorAVX2.cpp) chosen at runtime
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define LORIS_REALTIME_AVX2 1
+#else
+    #define LORIS_REALTIME_AVX2 0
+#endif
+
 //  begin namespace
 namespace Loris {
 
 class Breakpoint;
 
+// ---------------------------------------------------------------------------
+//  class RealtimeNoise
+//
+//! Class RealtimeNoise generates NumLanes independent streams of
+//! bandlimited noise, the stochastic modulators of bandwidth-enhanced
+//! realtime oscillators. It is the counterpart of the NoiseGenerator and
+//! Filter pair of Oscillator made for SIMD: each lane has its own xorshift
+//! random number generator and its own state of the prototype filter of
+//! Oscillator, and all lanes are computed at once, a block of samples
+//! at a time.
+//!
+//! The random numbers are uniformly distributed with zero mean and unity
+//! variance, instead of Gaussian. The narrow lowpass filter makes the
+//! filtered noise nearly Gaussian anyway.
+//
+class RealtimeNoise
+{
+//  --- interface ---
+public:
+    //! Number of noise streams computed at once (SSE lanes of floats).
+    enum { NumLanes = 4 };
+
+    //! Construct a noise generator, lanes of generators constructed with
+    //! different seeds are independent.
+    explicit RealtimeNoise( unsigned int seed = 1 );
+
+    //! Compute the next n samples of all lanes into out, n * NumLanes
+    //! floats, lanes of a sample are consecutive
+    //! (out[k * NumLanes + lane]).
+    void generate( float * out, int n ) noexcept;
+
+//  --- implementation ---
+private:
+    unsigned int m_state[NumLanes];     //  xorshift state, never 0
+    float m_delay[3][NumLanes];         //  transposed direct form II delays
+    float m_ffwd[4];                    //  prototype filter coefficients,
+    float m_fback[4];                   //  m_fback[0] is 1, gain is in m_ffwd
+
+};  //  end of class RealtimeNoise
+
 // ---------------------------------------------------------------------------
 //  class Oscillator
 //
@@ -69,6 +117,23 @@ class RealtimeOscillator : public Oscillator
 //  --- implementation ---
 
     double m_frequencyScaling;
+    double m_gain;                      //  multiplies the amplitude
+    double m_dGain;                     //  gain step per sample
+    
+    //  noise is generated a block at a time, only the first lane is used
+    enum { NoiseBlock = 64 };
+    RealtimeNoise m_noise;
+    float m_noiseBuffer[NoiseBlock * RealtimeNoise::NumLanes];
+    int m_noiseUsed;                    //  samples of m_noiseBuffer used
+    
+    //! Return the amplitude modulation of the next sample for bandwidth bw.
+    float modulation( double bw ) noexcept;
+
+    //! Accumulate the samples of a segment of oscillate(), with the
+    //! modulation and ramps it needs chosen at compile time.
+    template < bool Noisy, bool RampFrequency, bool RampAmplitude >
+    void oscillateSegment( float * begin, float * end, double dFreqOver2,
+                           double dAmp, double dBw ) noexcept;
 
 //  --- interface ---
 public:
@@ -100,6 +165,12 @@ public:
     //! Set internal frequency scaling.
     void setFrequencyScaling( double scaling ) noexcept;
 
+    //! Set the gain the amplitude is multiplied by, and its increment
+    //! added every sample oscillate() renders (to apply an output gain
+    //! ramp while rendering). The gain is 1 initially, it is not changed
+    //! by resetting or restoring envelopes.
+    void setGain( double gain, double dGain ) noexcept { m_gain = gain; m_dGain = dGain; }
+
     //! Accumulate bandwidth-enhanced sinusoidal samples modulating the
     //! oscillator state from its current values of radian frequency, amplitude,
     //! and bandwidth to the specified target values. Accumulate samples into
@@ -109,6 +180,12 @@ public:
     //! checked to prevent aliasing and bogus bandwidth enhancement.
     void oscillate( float * begin, float * end, const Breakpoint & bp, double srate, int dSample ) noexcept;
 
+    //! Same as above, but the target Breakpoint is given by its
+    //! frequency (Hz), amplitude and bandwidth directly (so the caller
+    //! does not need to construct a Breakpoint from compact data).
+    void oscillate( float * begin, float * end, double frequency, double amplitude,
+                    double bandwidth, double srate, int dSample ) noexcept;
+
 // --- accessors ---
 
     //! Return the instantaneous envelope parameters
@@ -122,6 +199,246 @@ public:
     
 };  //  end of class RealtimeOscillator
 
+// ---------------------------------------------------------------------------
+//  class RealtimeOscillatorBank
+//
+//! Class RealtimeOscillatorBank renders several bandwidth-enhanced
+//! oscillators at once, one oscillator in each SIMD lane, so the lanes run
+//! across Partials instead of across consecutive samples of one Partial.
+//! Every lane has its own instantaneous radian frequency, amplitude,
+//! bandwidth and phase, and its own per-sample increments of frequency,
+//! amplitude and bandwidth. The sum of all lanes is accumulated into the
+//! sample buffer.
+//!
+//! Each lane is modulated by its own stream of bandlimited noise from a
+//! RealtimeNoise, the noise is computed only while some lane has bandwidth.
+//! The bank does not know about Breakpoints: the caller runs it up to the
+//! nearest Breakpoint of any lane and then reloads the lanes which reached
+//! their Breakpoint.
+//
+class RealtimeOscillatorBank
+{
+//  --- interface ---
+public:
+    //! Number of oscillators rendered at once (SSE lanes of floats).
+    enum { NumLanes = 4 };
+
+    //! Ways of computing the samples of the lanes.
+    enum Kernel
+    {
+        //! Cosine of the phase of every sample (default).
+        CosineKernel,
+        //! Complex phasor rotated every sample, the rotation itself is
+        //! rotated to follow linear frequency ramps. Only multiplies and
+        //! adds per sample, the phasor is computed exactly again every
+        //! PhasorChunkSize samples, so rounding errors do not accumulate.
+        PhasorKernel
+    };
+
+    //! Samples between exact phasors of PhasorKernel.
+    enum { PhasorChunkSize = 64 };
+
+    //! Highest frequency of a lane, in radians per sample of the reduced
+    //! rate, oscillate( float *, float *, int ) computes at a fraction of
+    //! the rate: 64 samples per cycle, the images of linear interpolation
+    //! are 72 dB below the lane.
+    static const double MaxDecimatedFrequency;
+
+    //! Instruction sets the samples can be computed with. SSE2 and NEON
+    //! are chosen when compiling (for x86 and AArch64), AVX2 is chosen at
+    //! runtime if the processor has it. AVX2 computes eight lanes of
+    //! CosineKernel at once, two samples of every lane, in the same order
+    //! of operations as SSE2, so all instruction sets render the same samples.
+    enum Instructions
+    {
+        SSE2Instructions,
+        AVX2Instructions,
+        NEONInstructions
+    };
+
+//  --- construction ---
+
+    //! Construct a new bank with all lanes silent.
+    RealtimeOscillatorBank( void );
+
+// --- oscillation ---
+
+    //! Set the state of one lane. Frequency is in radians per sample,
+    //! the increments are added every sample. Bandwidth is clamped to
+    //! [0, 1] while rendering.
+    void setLane( int lane, double phase, double frequency, double amplitude,
+                  double dFrequency, double dAmplitude,
+                  double bandwidth = 0., double dBandwidth = 0. ) noexcept;
+
+    //! Silence one lane.
+    void clearLane( int lane ) noexcept;
+
+    //! Set the gain the amplitude of one lane is multiplied by, and its
+    //! increment added every sample (to fade the lane in or out). The
+    //! gain is kept when the lane is set or cleared, it is 1 initially.
+    void setLaneGain( int lane, double gain, double dGain ) noexcept;
+
+    //! Accumulate the sum of all lanes into the half-open (STL-style) range
+    //! of floats, starting at begin and ending before end, and advance the
+    //! state of every lane by (end - begin) samples. Phases are wrapped
+    //! when done.
+    void oscillate( float * begin, float * end ) noexcept;
+
+    //! Accumulate the sum of all lanes like oscillate( float *, float * ),
+    //! computing the lanes only every factor samples (and at end) and
+    //! interpolating linearly in between, for lanes far below Nyquist.
+    //! The state of every lane is advanced exactly as by oscillate(). All
+    //! samples are computed if some lane has bandwidth (the noise of the
+    //! lanes is bandlimited per sample, not in Hz) or goes above
+    //! MaxDecimatedFrequency at the reduced rate, or the range is shorter
+    //! than two steps.
+    void oscillate( float * begin, float * end, int factor ) noexcept;
+
+    //! Select the way samples are computed, both follow the same phase
+    //! trajectory.
+    void setKernel( Kernel kernel ) noexcept { m_kernel = kernel; }
+
+    //! Return the way samples are computed.
+    Kernel kernel( void ) const noexcept { return m_kernel; }
+
+    //! Return the best instruction set of this processor, the one a new
+    //! bank uses.
+    static Instructions supportedInstructions( void ) noexcept;
+
+    //! Select the instruction set samples are computed with, an instruction
+    //! set the processor does not have is replaced by supportedInstructions().
+    void setInstructions( Instructions instructions ) noexcept;
+
+    //! Return the instruction set samples are computed with.
+    Instructions instructions( void ) const noexcept { return m_instructions; }
+
+// --- accessors ---
+
+    //! Return the instantaneous phase of a lane.
+    double phase( int lane ) const noexcept { return m_phase[lane]; }
+
+    //! Return the instantaneous frequency (radians per sample) of a lane.
+    double frequency( int lane ) const noexcept { return m_frequency[lane]; }
+
+    //! Return the instantaneous amplitude of a lane.
+    double amplitude( int lane ) const noexcept { return m_amplitude[lane]; }
+
+    //! Return the instantaneous bandwidth of a lane.
+    double bandwidth( int lane ) const noexcept { return m_bandwidth[lane]; }
+
+//  --- implementation ---
+private:
+    //! oscillate() using CosineKernel.
+    void oscillateCosine( float * begin, float * end ) noexcept;
+
+    //! oscillate() using PhasorKernel.
+    void oscillatePhasor( float * begin, float * end ) noexcept;
+
+#if LORIS_REALTIME_AVX2
+    //! oscillateCosine() using AVX2, in RealtimeOscillatorAVX2.cpp.
+    void oscillateCosineAVX2( float * begin, float * end ) noexcept;
+
+    //! Return true if the processor (and operating system) support AVX2.
+    static bool hasAVX2( void ) noexcept;
+#endif
+
+    //! Return true if some lane needs noise modulation.
+    bool hasBandwidth( void ) const noexcept;
+
+    //! Return true if n samples may be computed every factor samples,
+    //! see oscillate( float *, float *, int ).
+    bool isDecimable( int n, int factor ) const noexcept;
+
+    //! Accumulate count samples of all lanes into consecutive values,
+    //! advancing the lanes by step samples after each, 0 for none.
+    void oscillateSteps( float * values, int count, int step ) noexcept;
+
+    //! Points computed at once by oscillate( float *, float *, int ).
+    enum { DecimatedChunkSize = 256 };
+
+    //! Compute the amplitude modulation of all lanes for the next n samples
+    //! into mod (lanes of a sample are consecutive) and advance bandwidths.
+    void modulation( float * mod, int n ) noexcept;
+
+    RealtimeNoise m_noise;              //  stochastic modulators of lanes
+
+    Kernel m_kernel;                    //  how samples are computed
+    Instructions m_instructions;        //  what samples are computed with
+    float m_phase[NumLanes];            //  radians
+    float m_frequency[NumLanes];        //  radians per sample
+    float m_amplitude[NumLanes];        //  absolute
+    float m_dFrequencyOver2[NumLanes];  //  half of the frequency step per sample
+    float m_dAmplitude[NumLanes];       //  amplitude step per sample
+    float m_gain[NumLanes];             //  amplitude multiplier
+    float m_dGain[NumLanes];            //  gain step per sample
+    float m_bandwidth[NumLanes];        //  noise energy / total energy
+    float m_dBandwidth[NumLanes];       //  bandwidth step per sample
+
+};  //  end of class RealtimeOscillatorBank
+
+// ---------------------------------------------------------------------------
+//  class RealtimeHarmonics
+//
+//! Class RealtimeHarmonics renders harmonics of one fundamental phase, for
+//! Partials that follow their harmonic of the fundamental. Harmonic k is
+//! computed from harmonic k - 1 by angle addition, a complex multiply per
+//! harmonic and sample instead of an oscillator, and only one sine and
+//! cosine per sample. The SIMD lanes run across consecutive samples, AVX2
+//! computes eight of them at once in the same order of operations as SSE2,
+//! so both render the same samples.
+//
+class RealtimeHarmonics
+{
+//  --- interface ---
+public:
+    //! A harmonic of the fundamental.
+    struct Harmonic
+    {
+        int number = 1;             //  multiple of the fundamental phase
+        float phaseCos = 1.f;       //  cosine and sine of the phase added to the
+        float phaseSin = 0.f;       //  multiple of the fundamental phase
+        double amplitude = 0.;      //  amplitude of the first sample,
+        double dAmplitude = 0.;     //  and its step per sample
+    };
+
+    //! Accumulate the sum of the harmonics into the half-open (STL-style)
+    //! range of floats, starting at begin and ending before end. The
+    //! fundamental follows the phase trajectory of RealtimeOscillatorBank,
+    //! the amplitudes of the harmonics their steps.
+    //!
+    //! \param  phase Phase of the fundamental at begin.
+    //! \param  frequency Frequency (radians per sample) of the fundamental at begin.
+    //! \param  dFrequency Frequency step per sample.
+    //! \param  harmonics The harmonics, by ascending number.
+    //! \param  count Number of harmonics.
+    //! \param  instructions Instruction set, one the processor has (see
+    //!         RealtimeOscillatorBank::instructions()).
+    //! \return Phase of the fundamental at end, wrapped.
+    static double oscillate( float * begin, float * end, double phase, double frequency, double dFrequency,
+                             const Harmonic * harmonics, int count,
+                             RealtimeOscillatorBank::Instructions instructions ) noexcept;
+
+//  --- implementation ---
+private:
+    //! Samples computed at once.
+    enum { GroupSize = 16 };
+
+    //! Sum the harmonics over GroupSize samples into samples, given the
+    //! cosines and sines of the phase of the fundamental.
+    //!
+    //! \param  offset Sample of the group, from the one the amplitudes of
+    //!         the harmonics are given at.
+    static void accumulate( float * samples, const float * fr, const float * fi,
+                            const Harmonic * harmonics, int count, int offset ) noexcept;
+
+#if LORIS_REALTIME_AVX2
+    //! accumulate() using AVX2, in RealtimeOscillatorAVX2.cpp.
+    static void accumulateAVX2( float * samples, const float * fr, const float * fi,
+                                const Harmonic * harmonics, int count, int offset ) noexcept;
+#endif
+
+};  //  end of class RealtimeHarmonics
+
 }   //  end of namespace Loris
 
 #endif /* ndef INCLUDE_REALTIME_OSCILLATOR_H */
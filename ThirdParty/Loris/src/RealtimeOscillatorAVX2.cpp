@@ -0,0 +1,389 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * RealtimeOscillatorAVX2.cpp
+ *
+ * AVX2 version of the cosine kernel of Loris::RealtimeOscillatorBank, and
+ * of the harmonic sum of Loris::RealtimeHarmonics.
+ *
+ * Only the functions of this file are compiled for AVX2 (the rest of the
+ * library stays SSE2), and they are only called if the processor has AVX2.
+ * Every operation is the one of the SSE2 kernel (and of cos_ps from
+ * sse_mathfun.h), done in the same order and without fused multiply-adds,
+ * so both kernels render the same samples.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "RealtimeOscillator.h"
+
+#if LORIS_REALTIME_AVX2
+
+#include <cmath>
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+    //  MSVC compiles AVX2 intrinsics without /arch:AVX2
+    #define LORIS_AVX2_TARGET
+#else
+    #define LORIS_AVX2_TARGET __attribute__(( target( "avx2" ) ))
+#endif
+
+#if defined(HAVE_M_PI) && (HAVE_M_PI)
+static const float TwoPi = (float) ( 2 * M_PI );
+#else
+static const float TwoPi = (float) ( 2 * 3.14159265358979324 );
+#endif
+
+//  begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  cos256
+// ---------------------------------------------------------------------------
+//  Cosine of every lane, cos_ps of sse_mathfun.h for eight lanes.
+//
+LORIS_AVX2_TARGET static inline __m256
+cos256( __m256 x )
+{
+    const __m256i one = _mm256_set1_epi32( 1 );
+    const __m256i two = _mm256_set1_epi32( 2 );
+    const __m256i four = _mm256_set1_epi32( 4 );
+
+    //  take the absolute value and scale by 4/Pi
+    x = _mm256_and_ps( x, _mm256_castsi256_ps( _mm256_set1_epi32( ~0x80000000 ) ) );
+    __m256 y = _mm256_mul_ps( x, _mm256_set1_ps( 1.27323954473516f ) );
+
+    //  j = (j+1) & (~1) (see the cephes sources)
+    __m256i emm2 = _mm256_cvttps_epi32( y );
+    emm2 = _mm256_add_epi32( emm2, one );
+    emm2 = _mm256_and_si256( emm2, _mm256_set1_epi32( ~1 ) );
+    y = _mm256_cvtepi32_ps( emm2 );
+
+    emm2 = _mm256_sub_epi32( emm2, two );
+
+    //  swap sign flag and polynomial selection mask
+    const __m256 signBit = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_andnot_si256( emm2, four ), 29 ) );
+    const __m256 polyMask = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32( _mm256_and_si256( emm2, two ), _mm256_setzero_si256() ) );
+
+    //  extended precision modular arithmetic,
+    //  x = ((x - y * DP1) - y * DP2) - y * DP3
+    const __m256 xmm1 = _mm256_mul_ps( y, _mm256_set1_ps( -0.78515625f ) );
+    const __m256 xmm2 = _mm256_mul_ps( y, _mm256_set1_ps( -2.4187564849853515625e-4f ) );
+    const __m256 xmm3 = _mm256_mul_ps( y, _mm256_set1_ps( -3.77489497744594108e-8f ) );
+    x = _mm256_add_ps( x, xmm1 );
+    x = _mm256_add_ps( x, xmm2 );
+    x = _mm256_add_ps( x, xmm3 );
+
+    //  first polynomial (0 <= x <= Pi/4)
+    const __m256 z = _mm256_mul_ps( x, x );
+    y = _mm256_mul_ps( _mm256_set1_ps( 2.443315711809948E-005f ), z );
+    y = _mm256_add_ps( y, _mm256_set1_ps( -1.388731625493765E-003f ) );
+    y = _mm256_mul_ps( y, z );
+    y = _mm256_add_ps( y, _mm256_set1_ps( 4.166664568298827E-002f ) );
+    y = _mm256_mul_ps( y, z );
+    y = _mm256_mul_ps( y, z );
+    y = _mm256_sub_ps( y, _mm256_mul_ps( z, _mm256_set1_ps( 0.5f ) ) );
+    y = _mm256_add_ps( y, _mm256_set1_ps( 1.f ) );
+
+    //  second polynomial (Pi/4 <= x <= 0)
+    __m256 y2 = _mm256_mul_ps( _mm256_set1_ps( -1.9515295891E-4f ), z );
+    y2 = _mm256_add_ps( y2, _mm256_set1_ps( 8.3321608736E-3f ) );
+    y2 = _mm256_mul_ps( y2, z );
+    y2 = _mm256_add_ps( y2, _mm256_set1_ps( -1.6666654611E-1f ) );
+    y2 = _mm256_mul_ps( y2, z );
+    y2 = _mm256_mul_ps( y2, x );
+    y2 = _mm256_add_ps( y2, x );
+
+    //  select the correct result from the two polynomials, update the sign
+    y2 = _mm256_and_ps( polyMask, y2 );
+    y = _mm256_andnot_ps( polyMask, y );
+    y = _mm256_add_ps( y, y2 );
+    return _mm256_xor_ps( y, signBit );
+}
+
+// ---------------------------------------------------------------------------
+//  ChunkState
+// ---------------------------------------------------------------------------
+//  State of the four lanes at the beginning of a chunk, repeated in both
+//  halves of the vectors: the low half has the lanes of sample k, the
+//  high half the lanes of sample k + 1.
+//
+struct ChunkState
+{
+    __m256 ph, f, a, dFreqOver2, dAmp, g, dGain;
+};
+
+LORIS_AVX2_TARGET static inline __m256
+twice( __m128 x )
+{
+    return _mm256_insertf128_ps( _mm256_castps128_ps256( x ), x, 1 );
+}
+
+// ---------------------------------------------------------------------------
+//  lanesAt
+// ---------------------------------------------------------------------------
+//  Samples of all lanes kv samples after the beginning of the chunk, kv
+//  holds the sample index of every lane.
+//
+LORIS_AVX2_TARGET static inline __m256
+lanesAt( const ChunkState & s, __m256 kv )
+{
+    const __m256 phk = _mm256_add_ps( s.ph, _mm256_mul_ps( kv, _mm256_add_ps( s.f, _mm256_mul_ps( kv, s.dFreqOver2 ) ) ) );
+    const __m256 ak = _mm256_mul_ps( _mm256_add_ps( s.a, _mm256_mul_ps( kv, s.dAmp ) ),
+                                     _mm256_add_ps( s.g, _mm256_mul_ps( kv, s.dGain ) ) );
+    return _mm256_mul_ps( ak, cos256( phk ) );
+}
+
+// ---------------------------------------------------------------------------
+//  sumLanes8
+// ---------------------------------------------------------------------------
+//  Sum the lanes of the samples k to k + 7 in v0 to v3 (two samples each),
+//  as (l0 + l1) + (l2 + l3) like the transposed sum of the SSE2 kernel, and
+//  return the sums in sample order.
+//
+LORIS_AVX2_TARGET static inline __m256
+sumLanes8( __m256 v0, __m256 v1, __m256 v2, __m256 v3 )
+{
+    //  the low halves hold samples k, k + 2, k + 4, k + 6, the high
+    //  halves k + 1, k + 3, k + 5, k + 7
+    const __m256 sums = _mm256_hadd_ps( _mm256_hadd_ps( v0, v1 ), _mm256_hadd_ps( v2, v3 ) );
+    return _mm256_permutevar8x32_ps( sums, _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 ) );
+}
+
+// ---------------------------------------------------------------------------
+//  oscillateCosineAVX2
+// ---------------------------------------------------------------------------
+//  oscillateCosine() computing two samples of the four lanes in every
+//  vector, eight samples at a time. Samples left over are computed four,
+//  then one at a time, summed like the SSE2 kernel sums them.
+//
+LORIS_AVX2_TARGET void
+RealtimeOscillatorBank::oscillateCosineAVX2( float * begin, float * end ) noexcept
+{
+    const int ChunkSize = 256;
+
+    __m128 ph = _mm_loadu_ps( m_phase );
+    __m128 f = _mm_loadu_ps( m_frequency );
+    __m128 a = _mm_loadu_ps( m_amplitude );
+    const __m128 dFreqOver2 = _mm_loadu_ps( m_dFrequencyOver2 );
+    const __m128 dAmp = _mm_loadu_ps( m_dAmplitude );
+    __m128 g = _mm_loadu_ps( m_gain );
+    const __m128 dGain = _mm_loadu_ps( m_dGain );
+    const __m128 twoPi = _mm_set1_ps( TwoPi );
+
+    ChunkState s;
+    s.dFreqOver2 = twice( dFreqOver2 );
+    s.dAmp = twice( dAmp );
+    s.dGain = twice( dGain );
+
+    //  sample offsets of the lanes of a vector
+    const __m256 offsets = _mm256_setr_ps( 0, 0, 0, 0, 1, 1, 1, 1 );
+    const __m256 two = _mm256_set1_ps( 2.f );
+
+    //  amplitude modulation of the chunk due to bandwidth, lanes of
+    //  a sample are consecutive
+    const bool noisy = hasBandwidth();
+    float mod[ChunkSize * NumLanes];
+
+    while ( begin != end )
+    {
+        const int n = ( end - begin < ChunkSize ) ? (int) ( end - begin ) : ChunkSize;
+        float * const chunkEnd = begin + n;
+        float k = 0;
+
+        if ( noisy )
+            modulation( mod, n );
+
+        s.ph = twice( ph );
+        s.f = twice( f );
+        s.a = twice( a );
+        s.g = twice( g );
+
+        float * putItHere = begin;
+        for ( ; putItHere + 8 <= chunkEnd; putItHere += 8, k += 8 )
+        {
+            const __m256 kv = _mm256_add_ps( _mm256_set1_ps( k ), offsets );
+            __m256 v0 = lanesAt( s, kv );
+            __m256 v1 = lanesAt( s, _mm256_add_ps( kv, two ) );
+            __m256 v2 = lanesAt( s, _mm256_add_ps( kv, _mm256_set1_ps( 4.f ) ) );
+            __m256 v3 = lanesAt( s, _mm256_add_ps( kv, _mm256_set1_ps( 6.f ) ) );
+
+            if ( noisy )
+            {
+                const float * m = mod + ( putItHere - begin ) * NumLanes;
+                v0 = _mm256_mul_ps( v0, _mm256_loadu_ps( m ) );
+                v1 = _mm256_mul_ps( v1, _mm256_loadu_ps( m + 8 ) );
+                v2 = _mm256_mul_ps( v2, _mm256_loadu_ps( m + 16 ) );
+                v3 = _mm256_mul_ps( v3, _mm256_loadu_ps( m + 24 ) );
+            }
+
+            const __m256 sum = sumLanes8( v0, v1, v2, v3 );
+            _mm256_storeu_ps( putItHere, _mm256_add_ps( _mm256_loadu_ps( putItHere ), sum ) );
+        }   // end of sample computation loop
+
+        if ( putItHere + 4 <= chunkEnd )
+        {
+            const __m256 kv = _mm256_add_ps( _mm256_set1_ps( k ), offsets );
+            __m256 v0 = lanesAt( s, kv );
+            __m256 v1 = lanesAt( s, _mm256_add_ps( kv, two ) );
+
+            if ( noisy )
+            {
+                const float * m = mod + ( putItHere - begin ) * NumLanes;
+                v0 = _mm256_mul_ps( v0, _mm256_loadu_ps( m ) );
+                v1 = _mm256_mul_ps( v1, _mm256_loadu_ps( m + 8 ) );
+            }
+
+            const __m256 zero = _mm256_setzero_ps();
+            const __m128 sum = _mm256_castps256_ps128( sumLanes8( v0, v1, zero, zero ) );
+            _mm_storeu_ps( putItHere, _mm_add_ps( _mm_loadu_ps( putItHere ), sum ) );
+            putItHere += 4;
+            k += 4;
+        }
+
+        for ( ; putItHere != chunkEnd; ++putItHere, k += 1 )
+        {
+            __m128 v = _mm256_castps256_ps128( lanesAt( s, _mm256_set1_ps( k ) ) );
+            if ( noisy )
+                v = _mm_mul_ps( v, _mm_loadu_ps( mod + ( putItHere - begin ) * NumLanes ) );
+
+            //  (l0 + l2) + (l1 + l3), as simd::sumLanes
+            v = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+            v = _mm_add_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+            *putItHere += _mm_cvtss_f32( v );
+        }
+
+        //  advance the state to the end of the chunk
+        const __m128 kn = _mm_set1_ps( (float) n );
+        ph = _mm_add_ps( ph, _mm_mul_ps( kn, _mm_add_ps( f, _mm_mul_ps( kn, dFreqOver2 ) ) ) );
+        f = _mm_add_ps( f, _mm_mul_ps( _mm_add_ps( kn, kn ), dFreqOver2 ) );
+        a = _mm_add_ps( a, _mm_mul_ps( kn, dAmp ) );
+        g = _mm_add_ps( g, _mm_mul_ps( kn, dGain ) );
+
+        //  wrap phases to prevent eventual loss of precision at
+        //  high oscillation frequencies:
+        const __m128 cycles = _mm_cvtepi32_ps( _mm_cvtps_epi32( _mm_div_ps( ph, twoPi ) ) );
+        ph = _mm_sub_ps( ph, _mm_mul_ps( cycles, twoPi ) );
+
+        begin = chunkEnd;
+    }
+
+    _mm_storeu_ps( m_phase, ph );
+    _mm_storeu_ps( m_frequency, f );
+    _mm_storeu_ps( m_amplitude, a );
+    _mm_storeu_ps( m_gain, g );
+
+    //  clear upper halves of the ymm registers, or SSE code running after
+    //  the kernel pays for a transition of the AVX state at every instruction
+    //  (compilers do not insert vzeroupper in functions with a target attribute)
+    _mm256_zeroupper();
+}
+
+// ---------------------------------------------------------------------------
+//  RealtimeHarmonics accumulateAVX2
+// ---------------------------------------------------------------------------
+//  Sum the harmonics over GroupSize samples, eight of them in a vector,
+//  by the operations of RealtimeHarmonics::accumulate().
+//
+LORIS_AVX2_TARGET void
+RealtimeHarmonics::accumulateAVX2( float * samples, const float * fr, const float * fi,
+                                   const Harmonic * harmonics, int count, int offset ) noexcept
+{
+    enum { Vectors = GroupSize / 8 };
+    static const float ramp[8] = { 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f };
+    
+    __m256 steps[Vectors], zr[Vectors], zi[Vectors], hr[Vectors], hi[Vectors], sum[Vectors];
+    for ( int v = 0; v < Vectors; ++v )
+    {
+        steps[v] = _mm256_add_ps( _mm256_loadu_ps( ramp ), _mm256_set1_ps( 8.f * v ) );
+        zr[v] = _mm256_loadu_ps( fr + 8 * v );
+        zi[v] = _mm256_loadu_ps( fi + 8 * v );
+        hr[v] = _mm256_set1_ps( 1.f );
+        hi[v] = _mm256_setzero_ps();
+        sum[v] = _mm256_setzero_ps();
+    }
+    
+    int number = 0;
+    for ( int h = 0; h < count; ++h )
+    {
+        const Harmonic & harmonic = harmonics[h];
+        for ( ; number < harmonic.number; ++number )
+        {
+            for ( int v = 0; v < Vectors; ++v )
+            {
+                const __m256 r = _mm256_sub_ps( _mm256_mul_ps( hr[v], zr[v] ), _mm256_mul_ps( hi[v], zi[v] ) );
+                hi[v] = _mm256_add_ps( _mm256_mul_ps( hr[v], zi[v] ), _mm256_mul_ps( hi[v], zr[v] ) );
+                hr[v] = r;
+            }
+        }
+        
+        const double amplitude = harmonic.amplitude + harmonic.dAmplitude * offset;
+        const __m256 ac = _mm256_set1_ps( (float) ( amplitude * harmonic.phaseCos ) );
+        const __m256 as = _mm256_set1_ps( (float) ( amplitude * harmonic.phaseSin ) );
+        const __m256 dc = _mm256_set1_ps( (float) ( harmonic.dAmplitude * harmonic.phaseCos ) );
+        const __m256 ds = _mm256_set1_ps( (float) ( harmonic.dAmplitude * harmonic.phaseSin ) );
+        for ( int v = 0; v < Vectors; ++v )
+        {
+            const __m256 c = _mm256_add_ps( ac, _mm256_mul_ps( dc, steps[v] ) );
+            const __m256 s = _mm256_add_ps( as, _mm256_mul_ps( ds, steps[v] ) );
+            sum[v] = _mm256_add_ps( sum[v], _mm256_sub_ps( _mm256_mul_ps( c, hr[v] ), _mm256_mul_ps( s, hi[v] ) ) );
+        }
+    }
+    
+    for ( int v = 0; v < Vectors; ++v )
+        _mm256_storeu_ps( samples + 8 * v, sum[v] );
+    
+    //  (compilers do not insert vzeroupper in functions with a target attribute)
+    _mm256_zeroupper();
+}
+
+// ---------------------------------------------------------------------------
+//  hasAVX2
+// ---------------------------------------------------------------------------
+//  Return true if the processor has AVX2 and the operating system saves
+//  the AVX registers.
+//
+bool
+RealtimeOscillatorBank::hasAVX2( void ) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid( info, 1 );
+    const bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+    const bool avx = ( info[2] & ( 1 << 28 ) ) != 0;
+    if ( ! ( osxsave && avx ) || ( _xgetbv( 0 ) & 6 ) != 6 )
+        return false;
+    __cpuidex( info, 7, 0 );
+    return ( info[1] & ( 1 << 5 ) ) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+#endif
+}
+
+}   //  end of namespace Loris
+
+#endif  /* LORIS_REALTIME_AVX2 */
@@ -0,0 +1,306 @@
+#ifndef INCLUDE_REALTIME_SIMD_H
+#define INCLUDE_REALTIME_SIMD_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * RealtimeSimd.h
+ *
+ * Four lane float and integer vector operations used by the realtime
+ * oscillators, implemented with SSE2 on x86 and with NEON on AArch64.
+ *
+ * The math functions come from sse_mathfun.h or neon_mathfun.h, which
+ * define non-inline functions, so this header may only be included by
+ * RealtimeOscillator.cpp.
+ *
+ */
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+    #define LORIS_SIMD_NEON 1
+    #include "neon_mathfun.h"
+#elif defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define LORIS_SIMD_SSE2 1
+    #define USE_SSE2
+    #include "sse_mathfun.h"
+#else
+    #error "The realtime oscillators need SSE2 or AArch64 NEON."
+#endif
+
+//  begin namespace
+namespace Loris {
+
+namespace simd {
+
+#if LORIS_SIMD_NEON
+typedef float32x4_t v4sf;   //  four floats
+typedef uint32x4_t v4su;    //  four unsigned ints
+#else
+typedef __m128 v4sf;        //  four floats
+typedef __m128i v4su;       //  four unsigned ints
+#endif
+
+// ---------------------------------------------------------------------------
+//  float operations
+// ---------------------------------------------------------------------------
+
+//! Load four floats, p need not be aligned.
+inline v4sf load( const float * p )
+{
+#if LORIS_SIMD_NEON
+    return vld1q_f32( p );
+#else
+    return _mm_loadu_ps( p );
+#endif
+}
+
+//! Store four floats, p need not be aligned.
+inline void store( float * p, v4sf v )
+{
+#if LORIS_SIMD_NEON
+    vst1q_f32( p, v );
+#else
+    _mm_storeu_ps( p, v );
+#endif
+}
+
+//! Return x in all lanes.
+inline v4sf set1( float x )
+{
+#if LORIS_SIMD_NEON
+    return vdupq_n_f32( x );
+#else
+    return _mm_set1_ps( x );
+#endif
+}
+
+//! Return 0 in all lanes.
+inline v4sf zero( void )
+{
+#if LORIS_SIMD_NEON
+    return vdupq_n_f32( 0.f );
+#else
+    return _mm_setzero_ps();
+#endif
+}
+
+inline v4sf add( v4sf a, v4sf b )
+{
+#if LORIS_SIMD_NEON
+    return vaddq_f32( a, b );
+#else
+    return _mm_add_ps( a, b );
+#endif
+}
+
+inline v4sf sub( v4sf a, v4sf b )
+{
+#if LORIS_SIMD_NEON
+    return vsubq_f32( a, b );
+#else
+    return _mm_sub_ps( a, b );
+#endif
+}
+
+//! Multiply, never fused with an addition, so that SSE2 and NEON agree.
+inline v4sf mul( v4sf a, v4sf b )
+{
+#if LORIS_SIMD_NEON
+    return vmulq_f32( a, b );
+#else
+    return _mm_mul_ps( a, b );
+#endif
+}
+
+inline v4sf div( v4sf a, v4sf b )
+{
+#if LORIS_SIMD_NEON
+    return vdivq_f32( a, b );
+#else
+    return _mm_div_ps( a, b );
+#endif
+}
+
+inline v4sf min( v4sf a, v4sf b )
+{
+#if LORIS_SIMD_NEON
+    return vminq_f32( a, b );
+#else
+    return _mm_min_ps( a, b );
+#endif
+}
+
+inline v4sf max( v4sf a, v4sf b )
+{
+#if LORIS_SIMD_NEON
+    return vmaxq_f32( a, b );
+#else
+    return _mm_max_ps( a, b );
+#endif
+}
+
+inline v4sf sqrt( v4sf a )
+{
+#if LORIS_SIMD_NEON
+    return vsqrtq_f32( a );
+#else
+    return _mm_sqrt_ps( a );
+#endif
+}
+
+//! Round to the nearest integer (ties to even), as float.
+inline v4sf round( v4sf a )
+{
+#if LORIS_SIMD_NEON
+    return vcvtq_f32_s32( vcvtnq_s32_f32( a ) );
+#else
+    return _mm_cvtepi32_ps( _mm_cvtps_epi32( a ) );
+#endif
+}
+
+//! Cosine of every lane.
+inline v4sf cos( v4sf x )
+{
+    return cos_ps( x );
+}
+
+//! Sine and cosine of every lane.
+inline void sincos( v4sf x, v4sf * s, v4sf * c )
+{
+    sincos_ps( x, s, c );
+}
+
+//! Transpose four vectors, seen as the rows of a 4 by 4 matrix.
+inline void transpose( v4sf & r0, v4sf & r1, v4sf & r2, v4sf & r3 )
+{
+#if LORIS_SIMD_NEON
+    const float32x4x2_t t01 = vtrnq_f32( r0, r1 );
+    const float32x4x2_t t23 = vtrnq_f32( r2, r3 );
+    r0 = vcombine_f32( vget_low_f32( t01.val[0] ), vget_low_f32( t23.val[0] ) );
+    r1 = vcombine_f32( vget_low_f32( t01.val[1] ), vget_low_f32( t23.val[1] ) );
+    r2 = vcombine_f32( vget_high_f32( t01.val[0] ), vget_high_f32( t23.val[0] ) );
+    r3 = vcombine_f32( vget_high_f32( t01.val[1] ), vget_high_f32( t23.val[1] ) );
+#else
+    _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+#endif
+}
+
+//! Return the sum of the lanes, (a0 + a2) + (a1 + a3).
+inline float sumLanes( v4sf a )
+{
+#if LORIS_SIMD_NEON
+    const float32x4_t s = vaddq_f32( a, vextq_f32( a, a, 2 ) );
+    return vgetq_lane_f32( s, 0 ) + vgetq_lane_f32( s, 1 );
+#else
+    a = _mm_add_ps( a, _mm_movehl_ps( a, a ) );
+    a = _mm_add_ss( a, _mm_shuffle_ps( a, a, 1 ) );
+    return _mm_cvtss_f32( a );
+#endif
+}
+
+// ---------------------------------------------------------------------------
+//  unsigned int operations
+// ---------------------------------------------------------------------------
+
+//! Load four unsigned ints, p need not be aligned.
+inline v4su loadUInt( const unsigned int * p )
+{
+#if LORIS_SIMD_NEON
+    return vld1q_u32( p );
+#else
+    return _mm_loadu_si128( (const __m128i *) p );
+#endif
+}
+
+//! Store four unsigned ints, p need not be aligned.
+inline void storeUInt( unsigned int * p, v4su v )
+{
+#if LORIS_SIMD_NEON
+    vst1q_u32( p, v );
+#else
+    _mm_storeu_si128( (__m128i *) p, v );
+#endif
+}
+
+//! Return x in all lanes.
+inline v4su set1UInt( unsigned int x )
+{
+#if LORIS_SIMD_NEON
+    return vdupq_n_u32( x );
+#else
+    return _mm_set1_epi32( (int) x );
+#endif
+}
+
+inline v4su xorUInt( v4su a, v4su b )
+{
+#if LORIS_SIMD_NEON
+    return veorq_u32( a, b );
+#else
+    return _mm_xor_si128( a, b );
+#endif
+}
+
+inline v4su orUInt( v4su a, v4su b )
+{
+#if LORIS_SIMD_NEON
+    return vorrq_u32( a, b );
+#else
+    return _mm_or_si128( a, b );
+#endif
+}
+
+//! Shift every lane left by Bits.
+template< int Bits >
+inline v4su shiftLeft( v4su a )
+{
+#if LORIS_SIMD_NEON
+    return vshlq_n_u32( a, Bits );
+#else
+    return _mm_slli_epi32( a, Bits );
+#endif
+}
+
+//! Shift every lane right by Bits, shifting in zeros.
+template< int Bits >
+inline v4su shiftRight( v4su a )
+{
+#if LORIS_SIMD_NEON
+    return vshrq_n_u32( a, Bits );
+#else
+    return _mm_srli_epi32( a, Bits );
+#endif
+}
+
+//! Reinterpret the bits of every lane as a float.
+inline v4sf asFloat( v4su a )
+{
+#if LORIS_SIMD_NEON
+    return vreinterpretq_f32_u32( a );
+#else
+    return _mm_castsi128_ps( a );
+#endif
+}
+
+}   //  end of namespace simd
+
+}   //  end of namespace Loris
+
+#endif /* ndef INCLUDE_REALTIME_SIMD_H */
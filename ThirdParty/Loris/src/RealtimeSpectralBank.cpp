@@ -0,0 +1,377 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken,
+ * Copyright (c) 2014 Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * RealtimeSpectralBank.cpp
+ *
+ * Implementation of class Loris::RealtimeSpectralBank, inverse FFT
+ * overlap-add synthesis of many sinusoids at once.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "RealtimeSpectralBank.h"
+#include "LorisTrace.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(HAVE_M_PI) && (HAVE_M_PI)
+const double Pi = M_PI;
+#else
+const double Pi = 3.14159265358979324;
+#endif
+
+//  begin namespace
+namespace Loris {
+
+//  Kernel table points per bin.
+static const int KernelOversampling = 64;
+
+//  Coefficients of the 4-term Blackman-Harris window centred at sample 0,
+//  w(m) = sum of c[j] * cos( 2 Pi j m / FrameSize ), -92 dB sidelobes are
+//  below the kernel of KernelBins bins.
+static const double BlackmanHarris[4] = { 0.35875, 0.48829, 0.14128, 0.01168 };
+
+// ---------------------------------------------------------------------------
+//  floor_int
+// ---------------------------------------------------------------------------
+//  Return the floor of a number of magnitude less than 2^31, without a
+//  call to std::floor.
+//
+static inline int floor_int( double x )
+{
+    const int i = (int) x;
+    return i - ( x < i );
+}
+
+// ---------------------------------------------------------------------------
+//  cos_turns
+// ---------------------------------------------------------------------------
+//  Approximate the cosine of an angle in turns (cycles) with an error less
+//  than 1e-9, without the calls of std::polar (see cos_turns in
+//  F0Estimate.cpp).
+//
+static inline double cos_turns( double t )
+{
+    //  reduce the angle to r in [-1/2, 1/2] turn, then
+    //  cos(2 Pi r) = sin(2 Pi (1/4 - |r|)), an angle in [-Pi/2, Pi/2]
+    const double r = t - floor_int( t + 0.5 );
+    const double x = 2 * Pi * ( 0.25 - std::abs( r ) );
+    const double x2 = x * x;
+
+    //  Taylor series of sin up to x^13
+    double p = 1. / 6227020800.;
+    p = 1. / 39916800. - x2 * p;
+    p = 1. / 362880. - x2 * p;
+    p = 1. / 5040. - x2 * p;
+    p = 1. / 120. - x2 * p;
+    p = 1. / 6. - x2 * p;
+    p = 1. - x2 * p;
+    return x * p;
+}
+
+//  Return magnitude * exp( i phase ).
+static inline std::complex< double > phasor( double magnitude, double phase )
+{
+    const double t = phase * ( 0.5 / Pi );
+    return std::complex< double >( magnitude * cos_turns( t ), magnitude * cos_turns( t - 0.25 ) );
+}
+
+// ---------------------------------------------------------------------------
+//  kernelTable
+// ---------------------------------------------------------------------------
+//  Spectrum of the window at distances from 0 to KernelBins bins, divided
+//  by FrameSize so that the forward transform of a conjugated spectrum is
+//  its inverse. The window is a sum of
+//  cosines, so its spectrum is a sum of shifted Dirichlet kernels of the
+//  frame, whose real part is sin( Pi x ) / tan( Pi x / N ) (the imaginary
+//  part is the window at the edge of the frame times sin( Pi x ), far
+//  below the sidelobes).
+//
+static const std::vector< double > & kernelTable( void )
+{
+    struct Table
+    {
+        std::vector< double > values;
+        Table( void )
+        {
+            const double N = RealtimeSpectralBank::FrameSize;
+            auto dirichlet = [N]( double x )
+            {
+                return x == 0. ? N : std::sin( Pi * x ) / std::tan( Pi * x / N );
+            };
+
+            values.resize( RealtimeSpectralBank::KernelBins * KernelOversampling + 2 );
+            for ( std::size_t i = 0; i < values.size(); ++i )
+            {
+                const double x = (double) i / KernelOversampling;
+                double w = 0.;
+                for ( int j = 0; j < 4; ++j )
+                    w += 0.5 * BlackmanHarris[j] * ( dirichlet( x - j ) + dirichlet( x + j ) );
+                values[i] = w / N;
+            }
+        }
+    };
+    static const Table table;
+    return table.values;
+}
+
+// ---------------------------------------------------------------------------
+//  synthesisWindow
+// ---------------------------------------------------------------------------
+//  Triangle of two hops divided by the analysis window, from sample
+//  1 - Hop to sample Hop - 1 of the frame. Triangles a hop apart add up
+//  to one.
+//
+static const std::vector< float > & synthesisWindow( void )
+{
+    struct Table
+    {
+        std::vector< float > values;
+        Table( void )
+        {
+            const int H = RealtimeSpectralBank::Hop;
+            for ( int m = 1 - H; m < H; ++m )
+            {
+                double w = 0.;
+                for ( int j = 0; j < 4; ++j )
+                    w += BlackmanHarris[j] * std::cos( 2 * Pi * j * m / RealtimeSpectralBank::FrameSize );
+                values.push_back( (float) ( ( 1. - std::abs( m ) / (double) H ) / w ) );
+            }
+        }
+    };
+    static const Table table;
+    return table.values;
+}
+
+// ---------------------------------------------------------------------------
+//  RealtimeSpectralBank construction
+// ---------------------------------------------------------------------------
+//  Build the tables shared by all banks, so that nothing but the transform
+//  is computed when synthesizing.
+//
+RealtimeSpectralBank::RealtimeSpectralBank( void ) :
+    m_transform( FrameSize ),
+    m_spectra( PartialStruct::NumChannels * 2 * SpectrumSize ),
+    m_framed( 0 ),
+    m_stride( 0 ),
+    m_seed( 2463534242u )
+{
+    kernelTable();
+    synthesisWindow();
+    std::fill_n( m_pendingLength, (int) PartialStruct::NumChannels, 0 );
+    prepare( 0 );
+}
+
+// ---------------------------------------------------------------------------
+//  prepare
+// ---------------------------------------------------------------------------
+//  Every channel has room for a block and the frames overlapping it on
+//  both sides.
+//
+void RealtimeSpectralBank::prepare( int maximumBlockSize )
+{
+    m_stride = std::max( maximumBlockSize, 0 ) + 2 * Hop;
+    m_pending.assign( PartialStruct::NumChannels * m_stride, 0.f );
+    clear();
+}
+
+// ---------------------------------------------------------------------------
+//  reserve
+// ---------------------------------------------------------------------------
+//  Pending samples are copied to the longer channels.
+//
+void RealtimeSpectralBank::reserve( int samples )
+{
+    if ( samples + 2 * Hop <= m_stride )
+        return;
+
+    const int stride = samples + 2 * Hop;
+    std::vector< float > pending( PartialStruct::NumChannels * stride, 0.f );
+    for ( int c = 0; c < PartialStruct::NumChannels; ++c )
+        std::copy_n( &m_pending[c * m_stride], m_pendingLength[c], &pending[c * stride] );
+    m_pending.swap( pending );
+    m_stride = stride;
+}
+
+// ---------------------------------------------------------------------------
+//  clear
+// ---------------------------------------------------------------------------
+//
+void RealtimeSpectralBank::clear( void ) noexcept
+{
+    std::fill( m_pending.begin(), m_pending.end(), 0.f );
+    std::fill( m_spectra.begin(), m_spectra.end(), 0. );
+    std::fill_n( m_pendingLength, (int) PartialStruct::NumChannels, 0 );
+    m_framed = 0;
+}
+
+// ---------------------------------------------------------------------------
+//  addPartial
+// ---------------------------------------------------------------------------
+//  The sinusoid has the carrier amplitude of the bandwidth-enhanced
+//  oscillator, sqrt( 1 - bandwidth ) * amplitude. The noise is a sinusoid
+//  of random phase in each frame, frames of independent phases crossfaded
+//  by the triangles have 2/3 of the energy in average, so its amplitude is
+//  sqrt( 3 * bandwidth ) * amplitude for the noise energy of the oscillator,
+//  bandwidth * amplitude^2.
+//
+void RealtimeSpectralBank::addPartial( int channel, double frequency, double amplitude, double bandwidth, double phase ) noexcept
+{
+    std::complex< double > a = phasor( 0.5 * amplitude * std::sqrt( 1. - bandwidth ), phase );
+    if ( bandwidth > 0. )
+    {
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        a += phasor( 0.5 * amplitude * std::sqrt( 3. * bandwidth ), 2 * Pi * ( m_seed >> 8 ) * ( 1. / 16777216. ) );
+    }
+
+    //  a cosine is half at the positive and half at the negative frequency,
+    //  the spectrum is conjugated; the window is symmetric, so is its
+    //  spectrum, bins -k of the negative frequency have the weights of bins
+    //  k of the positive one
+    const double bin = frequency * ( FrameSize / ( 2 * Pi ) );
+    const int first = floor_int( bin ) + 1 - KernelBins;
+    const double * table = kernelTable().data();
+    double weights[2 * KernelBins];
+    for ( int j = 0; j < 2 * KernelBins; ++j )
+    {
+        const double x = std::abs( first + j - bin ) * KernelOversampling;
+        const int i = (int) x;
+        weights[j] = table[i] + ( table[i + 1] - table[i] ) * ( x - i );
+    }
+
+    //  bins beyond Nyquist are kept apart and wrapped by overlapAdd(), so
+    //  the bins of both kernels are contiguous; the negative kernel is the
+    //  positive one reversed
+    double * re = &m_spectra[channel * 2 * SpectrumSize] + SpectrumCentre;
+    double * im = re + SpectrumSize;
+    for ( int j = 0; j < 2 * KernelBins; ++j )
+    {
+        re[first + j] += a.real() * weights[j];
+        im[first + j] -= a.imag() * weights[j];
+    }
+    const int last = - first - 2 * KernelBins + 1;
+    for ( int j = 0; j < 2 * KernelBins; ++j )
+    {
+        re[last + j] += a.real() * weights[2 * KernelBins - 1 - j];
+        im[last + j] += a.imag() * weights[2 * KernelBins - 1 - j];
+    }
+    m_framed |= 1 << channel;
+}
+
+// ---------------------------------------------------------------------------
+//  overlapAdd
+// ---------------------------------------------------------------------------
+//  Samples of the frame before its centre are at the end of the transform
+//  (the window is centred at sample 0).
+//
+void RealtimeSpectralBank::overlapAdd( int position ) noexcept
+{
+    LORIS_TRACE_ZONE( "RealtimeSpectralBank::overlapAdd" );
+    const float * window = synthesisWindow().data();
+
+    for ( int c = 0; c < PartialStruct::NumChannels; ++c )
+    {
+        if ( ! ( m_framed & ( 1 << c ) ) )
+            continue;
+
+        //  the kernels of frequencies near 0 and Nyquist overlap their
+        //  images, bins wrap around the frame
+        double * spectrum = &m_spectra[c * 2 * SpectrumSize];
+        const double * re = spectrum + SpectrumCentre;
+        const double * im = re + SpectrumSize;
+        for ( int k = 0; k <= FrameSize / 2; ++k )
+            m_transform[k] = std::complex< double >( re[k], im[k] );
+        for ( int k = 1 - FrameSize / 2; k < 0; ++k )
+            m_transform[k + FrameSize] = std::complex< double >( re[k], im[k] );
+        for ( int k = FrameSize / 2 + 1; k <= SpectrumCentre; ++k )
+            m_transform[k] += std::complex< double >( re[k], im[k] );
+        for ( int k = - SpectrumCentre; k <= - FrameSize / 2; ++k )
+            m_transform[k + FrameSize] += std::complex< double >( re[k], im[k] );
+        std::fill_n( spectrum, 2 * SpectrumSize, 0. );
+        m_transform.transform();
+
+        float * out = delayed( c ) + position;
+        for ( int m = 1 - Hop; m < Hop; ++m )
+            out[m] += (float) m_transform[m & ( FrameSize - 1 )].real() * window[m + Hop - 1];
+        m_pendingLength[c] = std::max( m_pendingLength[c], Latency + position + Hop );
+    }
+    m_framed = 0;
+}
+
+// ---------------------------------------------------------------------------
+//  written
+// ---------------------------------------------------------------------------
+//
+void RealtimeSpectralBank::written( int channels, int samples ) noexcept
+{
+    for ( int c = 0; c < PartialStruct::NumChannels; ++c )
+        if ( channels & ( 1 << c ) )
+            m_pendingLength[c] = std::max( m_pendingLength[c], Latency + samples );
+}
+
+// ---------------------------------------------------------------------------
+//  flush
+// ---------------------------------------------------------------------------
+//  Pending samples past the length of a channel are zero, only the ones
+//  before it are moved and the ones left behind cleared.
+//
+int RealtimeSpectralBank::flush( float * const * outputs, int samples ) noexcept
+{
+    int channels = 0;
+    for ( int c = 0; c < PartialStruct::NumChannels; ++c )
+    {
+        const int length = m_pendingLength[c];
+        if ( length == 0 || samples <= 0 )
+            continue;
+
+        float * pending = &m_pending[c * m_stride];
+        const int n = std::min( samples, length );
+        float * output = outputs[c];
+        for ( int i = 0; i < n; ++i )
+            output[i] += pending[i];
+        std::copy( pending + n, pending + length, pending );
+        std::fill( pending + length - n, pending + length, 0.f );
+        m_pendingLength[c] = length - n;
+        channels |= 1 << c;
+    }
+    return channels;
+}
+
+// ---------------------------------------------------------------------------
+//  isSilent
+// ---------------------------------------------------------------------------
+//
+bool RealtimeSpectralBank::isSilent( void ) const noexcept
+{
+    for ( int length : m_pendingLength )
+        if ( length > 0 )
+            return false;
+    return true;
+}
+
+}   //  end of namespace Loris
@@ -0,0 +1,164 @@
+#ifndef INCLUDE_REALTIME_SPECTRAL_BANK_H
+#define INCLUDE_REALTIME_SPECTRAL_BANK_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken,
+ * Copyright (c) 2014 Tomas Medek
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * RealtimeSpectralBank.h
+ *
+ * Definition of class Loris::RealtimeSpectralBank, inverse FFT overlap-add
+ * synthesis of many sinusoids at once.
+ *
+ */
+
+#include "FourierTransform.h"
+#include "PartialBank.h"
+
+#include <complex>
+#include <vector>
+
+// from juce_PlatformDefs.h
+#ifdef _MSC_VER
+	#ifdef noexcept
+		#undef noexcept
+	#endif
+	#define noexcept  throw()
+#endif
+
+//  begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  class RealtimeSpectralBank
+//
+//! Class RealtimeSpectralBank renders many sinusoids at once by inverse
+//! FFT overlap-add. Every frame, each sinusoid adds the spectrum of a
+//! Blackman-Harris windowed sinusoid of its frequency, amplitude and phase
+//! at the centre of the frame to the spectrum of its channel, which is
+//! only KernelBins bins on both sides of its frequency (and the same around
+//! its negative frequency), taken from a table. One transform of the frame
+//! gives the windowed sum of all sinusoids, the window is replaced by a
+//! triangle spanning two hops, so the frames add up to sinusoids whose
+//! amplitudes and frequencies are interpolated from frame to frame.
+//!
+//! The cost per sinusoid is a few complex multiply-adds per hop instead of
+//! one oscillator sample per sample, so dense sounds cost mostly the
+//! transform of each channel, but the samples of a frame are only complete
+//! when the next frame is added: the output is delayed by Latency samples.
+//! Samples are accumulated into pending samples of each channel, the
+//! caller may render samples into them as well (see delayed()), and moves
+//! them to its outputs by flush().
+//!
+//! Bandwidth is rendered as a kernel of random phase in every frame, the
+//! noise is as wide as the window, not narrowband like the noise of the
+//! bandwidth-enhanced oscillator, but it has the same energy.
+//
+class RealtimeSpectralBank
+{
+//  --- interface ---
+public:
+    //! Samples of a frame, hop between frames, latency of the output in
+    //! samples and bins of the kernel on each side of a frequency.
+    enum { FrameSize = 512, Hop = FrameSize / 4, Latency = Hop, KernelBins = 4 };
+
+//  --- construction ---
+
+    //! Construct a new bank with no pending samples, able to take blocks
+    //! of any length once prepare() is called.
+    RealtimeSpectralBank( void );
+
+    //! Size the pending samples for blocks of up to maximumBlockSize
+    //! samples and clear them. Do not call it while synthesizing.
+    void prepare( int maximumBlockSize );
+
+    //! Make the pending samples long enough for a block, keeping them. It
+    //! allocates only if prepare() was given a shorter block.
+    void reserve( int samples );
+
+    //! Return the longest block the pending samples have room for.
+    int maximumBlockSize( void ) const noexcept { return m_stride - 2 * Hop; }
+
+    //! Silence the pending samples and the spectra of the frame.
+    void clear( void ) noexcept;
+
+// --- synthesis ---
+
+    //! Add a sinusoid at the centre of the next frame to the spectrum of
+    //! its channel.
+    //!
+    //! \param  channel PartialStruct::Channel of the sinusoid.
+    //! \param  frequency Radians per sample, at most Pi.
+    //! \param  amplitude Absolute amplitude.
+    //! \param  bandwidth Noise energy / total energy, from 0 to 1.
+    //! \param  phase Phase at the centre of the frame.
+    void addPartial( int channel, double frequency, double amplitude, double bandwidth, double phase ) noexcept;
+
+    //! Transform the spectra of the channels sinusoids were added to and
+    //! add the frames to the pending samples, centred at position samples
+    //! of the block being synthesized. The spectra are cleared.
+    void overlapAdd( int position ) noexcept;
+
+    //! Return the pending samples of a channel at the beginning of the block
+    //! being synthesized, samples added there are flushed Latency samples
+    //! later. They are at least as long as the block given to reserve().
+    float * delayed( int channel ) noexcept { return &m_pending[channel * m_stride + Latency]; }
+
+    //! Tell the pending samples of channels up to a sample of the block were
+    //! written to by the caller, see delayed().
+    //!
+    //! \param  channels Bit 1 << channel for each channel written.
+    //! \param  samples Samples from the beginning of the block.
+    void written( int channels, int samples ) noexcept;
+
+    //! Accumulate the next pending samples of every channel into its output
+    //! and move the rest of them to the beginning.
+    //!
+    //! \param  outputs PartialStruct::NumChannels pointers to the samples
+    //!         to accumulate into, each at least samples long.
+    //! \param  samples Number of samples.
+    //! \return Bit 1 << channel for each output samples were added to.
+    int flush( float * const * outputs, int samples ) noexcept;
+
+    //! Return true if no samples are pending.
+    bool isSilent( void ) const noexcept;
+
+//  --- implementation ---
+private:
+    //! Bins of the spectra, from -SpectrumCentre to SpectrumCentre so that
+    //! no kernel of a frequency up to Nyquist wraps around.
+    enum { SpectrumCentre = FrameSize / 2 + KernelBins, SpectrumSize = 2 * SpectrumCentre + 1 };
+
+    FourierTransform m_transform;                   //  frame being transformed
+    std::vector< double > m_spectra;                //  real and imaginary bins of the next frame
+                                                    //  of each channel, conjugated so that the
+                                                    //  forward transform is the inverse
+    int m_framed;                                   //  bits of channels added to the next frame
+    std::vector< float > m_pending;                 //  samples of each channel not flushed yet,
+    int m_stride;                                   //  this many for each channel
+    int m_pendingLength[PartialStruct::NumChannels];//  samples that may not be zero
+    unsigned int m_seed;                            //  xorshift32 state of noise phases
+
+};  //  end of class RealtimeSpectralBank
+
+}   //  end of namespace Loris
+
+#endif /* ndef INCLUDE_REALTIME_SPECTRAL_BANK_H */
@@ -39,6 +39,7 @@
 #include "BreakpointUtils.h"
 #include "Envelope.h"
 #include "LorisExceptions.h"
+#include "LorisTrace.h"
 #include "Notifier.h"
 #include "Partial.h"
 #include "Resampler.h"
@@ -46,10 +47,33 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <assert.h>
 
 //  begin namespace
 namespace Loris {
+
+const double RealTimeSynthesizer::DefaultLoopFadeTime = 0.01;
+const int RealTimeSynthesizer::AutomaticSpectralPartials = 64;
+const int RealTimeSynthesizer::DefaultSpectralBlockSize = 1024;
+const double RealTimeSynthesizer::DefaultHarmonicTolerance = 5.;
+const double RealTimeSynthesizer::HarmonicMaxBandwidth = 0.01;
+const double RealTimeSynthesizer::MinMultiRate = 22050.;
+const double RealTimeSynthesizer::MinAmplitude = 1.0E-7;
+
+// ---------------------------------------------------------------------------
+//  scatteredPhase - helper
+// ---------------------------------------------------------------------------
+//  Return the phase a Partial of a phase-free bank starts with. Phases are
+//  scattered by golden ratio steps of the first Breakpoint, so Partials 
+//  starting together do not add up to a click, and every rendering of
+//  the bank is the same.
+static double scatteredPhase( const PartialStruct & p )
+{
+    const double turns = p.firstBreakpoint * 0.6180339887498949;
+    return 2 * Pi * ( turns - std::floor( turns ) );
+}
+
 // ---------------------------------------------------------------------------
 //  Synthesizer constructor
 // ---------------------------------------------------------------------------
@@ -87,53 +111,319 @@ RealTimeSynthesizer::RealTimeSynthesizer( std::vector<float> & buffer ) :
 //!         by given partials.
 void RealTimeSynthesizer::setup(PartialList & partials, double pitch) noexcept
 {
-    this->partials.clear();
-    this->pitch = pitch;
+    setup( PartialBank::create( partials, pitch, m_fadeTimeSec, m_srateHz ) );
+}
+
+// ---------------------------------------------------------------------------
+//  setup
+// ---------------------------------------------------------------------------
+//!	Prepare internal structures for synthesis of a shared PartialBank.
+//! The bank is not copied, only the playback state for each of its
+//! partials is allocated. reset() is also called. Previous data is overwritten.
+//!
+//! \param  bank The prepared Partials to synthesize.
+//! \return Nothing.
+//! \pre    The bank was built for the sample rate of this synthesizer.
+//! \post   This RealTimeSynthesizer's is ready for synthesise the sound specified
+//!         by given bank.
+void RealTimeSynthesizer::setup(PartialBank::Ptr bank) noexcept
+{
     clearPartialsBeingProcessed();
+
+    this->bank = bank;
+    this->pitch = bank->pitch();
+    morph = nullptr;
+    states.assign( bank->size(), PartialState() );
+    partialsBeingProcessed.assign( bank->maxConcurrentPartials(), 0 );
+    cutoffScaling = 0.;
+    measureHarmonics();
     
-    // assuming I am getting sorted partials by time
-    for (auto it : partials)
+    clearLoop();
+    lastSample = 0;
+    partialSamples = 0.;
+    for (std::size_t i = 0; i < bank->size(); i++)
     {
-        if (it.numBreakpoints() <= 0) continue;
-        
-        PartialStruct pStruct;
-        
-        pStruct.numBreakpoints = it.numBreakpoints() + 2;// + fade in + fade out
+        const PartialStruct & p = bank->partials()[i];
+        if (p.numBreakpoints > 0)
+        {
+            const int endSample = bank->breakpointSamples()[p.firstBreakpoint + p.numBreakpoints - 1];
+            lastSample = std::max( lastSample, endSample );
+            partialSamples += endSample - p.startSample;
+        }
+    }
 
-        pStruct.breakpoints.reserve(pStruct.numBreakpoints);
-        pStruct.label = it.label();
-        
-        pStruct.startTime = ( m_fadeTimeSec < it.startTime() ) ? ( it.startTime() - m_fadeTimeSec ) : 0.;// compute fade in bp time
-        pStruct.endTime = it.endTime() + m_fadeTimeSec;// compute fade out bp time
+    // delayed samples are allocated here, not by the first block
+    if ( selectedEngine != OscillatorEngine )
+        m_spectral.reserve( DefaultSpectralBlockSize );
 
-        
-        // breakpoints
-        Partial::const_iterator jt = it.begin();
-        // fade in breakpoint, compute fade in time
-        pStruct.breakpoints.push_back(std::make_pair(pStruct.startTime, BreakpointUtils::makeNullBefore( jt.breakpoint(), it.startTime() - pStruct.startTime)));
-        
+    reset();
+}
 
+// ---------------------------------------------------------------------------
+//  setup
+// ---------------------------------------------------------------------------
+//!	Prepare for synthesis of what another synthesizer was set up with:
+//! its bank, morph, noise bands and loop, at its sample rate. What
+//! setup() and setLoop() derived from the bank (harmonic Partials, loop
+//! entries) is shared, not computed again, only the playback state is
+//! allocated, so voices playing one bank are set up at the cost of one.
+//! reset() is also called.
+//!
+//! \param  prepared A synthesizer set up with a bank, it may be
+//!         destroyed afterwards.
+//! \return Nothing.
+void RealTimeSynthesizer::setup(const RealTimeSynthesizer & prepared) noexcept
+{
+    clearPartialsBeingProcessed();
+    
+    setSampleRate( prepared.m_srateHz );
+    
+    bank = prepared.bank;
+    pitch = prepared.pitch;
+    morph = prepared.morph;
+    m_noise.setBands( prepared.m_noise.bands() );
+    states.assign( bank ? bank->size() : 0, PartialState() );
+    partialsBeingProcessed.assign( prepared.partialsBeingProcessed.size(), 0 );
+    cutoffScaling = 0.;
+    
+    harmonicCents = prepared.harmonicCents;
+    harmonicNumbers = prepared.harmonicNumbers;
+    harmonicFundamental = prepared.harmonicFundamental;
+    numHarmonicPartials = prepared.numHarmonicPartials;
+    harmonicLanes.reserve( numHarmonicPartials );
+    harmonics.reserve( numHarmonicPartials );
+    
+    loopStartSample = prepared.loopStartSample;
+    loopEndSample = prepared.loopEndSample;
+    loopPartialIdx = prepared.loopPartialIdx;
+    loopEntries = prepared.loopEntries;
+    loopFadeSamples = prepared.loopFadeSamples;
+    lastSample = prepared.lastSample;
+    partialSamples = prepared.partialSamples;
+    
+    if ( selectedEngine != OscillatorEngine )
+        m_spectral.reserve( DefaultSpectralBlockSize );
+    
+    reset();
+}
+
+// ---------------------------------------------------------------------------
+//  statistics
+// ---------------------------------------------------------------------------
+//!	Return statistics of the bank set up. Every sounding Partial costs an
+//! oscillator sample per output sample, so the render cost of a voice
+//! follows the number of Partials sounding at once and the sample rate.
+//!
+//! \return Statistics, all zero if no bank was set up.
+RealTimeSynthesizer::Statistics RealTimeSynthesizer::statistics() const noexcept
+{
+    Statistics stats;
+    if ( ! bank )
+        return stats;
+    
+    stats.numPartials = bank->size();
+    stats.numBreakpoints = bank->numBreakpoints();
+    stats.maxConcurrentPartials = bank->maxConcurrentPartials();
+    stats.meanConcurrentPartials = lastSample > 0 ? partialSamples / lastSample : 0.;
+    stats.duration = duration();
+    stats.peakPartialSamples = stats.maxConcurrentPartials * m_srateHz;
+    stats.meanPartialSamples = stats.meanConcurrentPartials * m_srateHz;
+    stats.bankBytes = bank->imageSize();
+    stats.stateBytes = states.capacity() * sizeof( PartialState )
+                     + partialsBeingProcessed.capacity() * sizeof( int )
+                     + ( loopEntries ? loopEntries->capacity() * sizeof( LoopEntry ) : 0 )
+                     + ( harmonicNumbers ? harmonicNumbers->capacity() * sizeof( int ) : 0 )
+                     + harmonicLanes.capacity() * sizeof( HarmonicLane )
+                     + harmonics.capacity() * sizeof( RealtimeHarmonics::Harmonic );
+    return stats;
+}
+
+// ---------------------------------------------------------------------------
+//  setHarmonicTolerance
+// ---------------------------------------------------------------------------
+//!	Set how far the frequency of a harmonic Partial may stray from its
+//! harmonic of the fundamental, the Partials of the bank set up are
+//! measured again.
+//!
+//! \param  cents The tolerance in cents.
+//! \return Nothing.
+void RealTimeSynthesizer::setHarmonicTolerance(double cents) noexcept
+{
+    harmonicCents = std::max( cents, 0. );
+    if ( bank )
+        measureHarmonics();
+}
+
+// ---------------------------------------------------------------------------
+//  measureHarmonics
+// ---------------------------------------------------------------------------
+//!	Find the fundamental of the bank, its longest Partial labeled 1, and
+//! the Partials harmonic to it: every Breakpoint of a harmonic Partial is
+//! within the harmonic tolerance of its label times the frequency of the
+//! fundamental at the same sample (interpolated as it is played), and has
+//! no more bandwidth than HarmonicMaxBandwidth.
+void RealTimeSynthesizer::measureHarmonics() noexcept
+{
+    const PartialStruct * partials = bank->partials();
+    const int numPartials = (int) bank->size();
+    
+    std::shared_ptr<std::vector<int>> numbers = std::make_shared<std::vector<int>>( numPartials, 0 );
+    harmonicNumbers = numbers;
+    numHarmonicPartials = 0;
+    harmonicFundamental = -1;
+    for (int i = 0; i < numPartials; i++)
+    {
+        const PartialStruct & p = partials[i];
+        if ( p.label == 1 && p.numBreakpoints > 1
+             && ( harmonicFundamental < 0 || p.endTime - p.startTime > partials[harmonicFundamental].endTime - partials[harmonicFundamental].startTime ) )
+            harmonicFundamental = i;
+    }
+    if ( harmonicFundamental < 0 )
+        return;
+    
+    const PartialStruct & f = partials[harmonicFundamental];
+    const int * fSample = bank->breakpointSamples() + f.firstBreakpoint;
+    const BreakpointArrays fbp = bank->breakpoints().from( f.firstBreakpoint );
+    const double ratio = std::pow( 2., harmonicCents / 1200. );
+    
+    for (int i = 0; i < numPartials; i++)
+    {
+        const PartialStruct & p = partials[i];
+        if ( p.label < 1 || ( p.label == 1 && i != harmonicFundamental ) || p.numBreakpoints == 0 )
+            continue;
         
-        double sumF = 0;
-        
-        for (; jt != it.end(); jt++)
+        const int * bpSample = bank->breakpointSamples() + p.firstBreakpoint;
+        const BreakpointArrays bp = bank->breakpoints().from( p.firstBreakpoint );
+        bool harmonic = true;
+        for (int b = 0; b < p.numBreakpoints && harmonic; b++)
         {
-            sumF += jt->frequency();
-            pStruct.breakpoints.push_back(std::make_pair(jt.time(), jt.breakpoint()));
+            const int sample = bpSample[b];
+            if ( bp.bandwidth( b ) > HarmonicMaxBandwidth || sample < fSample[0] || sample > fSample[f.numBreakpoints - 1] )
+            {
+                harmonic = false;
+                break;
+            }
+            
+            const int next = std::min( (int) ( std::upper_bound( fSample, fSample + f.numBreakpoints, sample ) - fSample ),
+                                       f.numBreakpoints - 1 );
+            const int span = fSample[next] - fSample[next - 1];
+            const double x = span > 0 ? (double) ( sample - fSample[next - 1] ) / span : 1.;
+            const double fundamental = fbp.frequency( next - 1 ) + x * ( fbp.frequency( next ) - fbp.frequency( next - 1 ) );
+            const double deviation = fundamental > 0. ? bp.frequency( b ) / ( p.label * fundamental ) : 0.;
+            harmonic = deviation <= ratio && deviation >= 1. / ratio;
         }
         
-        pStruct.avgFrequency = sumF / (float) it.numBreakpoints();
+        if ( harmonic )
+        {
+            (*numbers)[i] = p.label;
+            numHarmonicPartials++;
+        }
+    }
+    harmonicLanes.reserve( numHarmonicPartials );
+    harmonics.reserve( numHarmonicPartials );
+}
+
+// ---------------------------------------------------------------------------
+//  fundamentalAt
+// ---------------------------------------------------------------------------
+//!	Return the frequency of the fundamental in Hz at a sample of the bank,
+//! interpolated between its Breakpoints, or the one of its nearest end
+//! outside of it.
+//!
+//! \param  sample Sample of the bank.
+double RealTimeSynthesizer::fundamentalAt( double sample ) const noexcept
+{
+    const PartialStruct & f = bank->partials()[harmonicFundamental];
+    const int * fSample = bank->breakpointSamples() + f.firstBreakpoint;
+    const BreakpointArrays fbp = bank->breakpoints().from( f.firstBreakpoint );
+    if ( sample <= fSample[0] )
+        return fbp.frequency( 0 );
+    if ( sample >= fSample[f.numBreakpoints - 1] )
+        return fbp.frequency( f.numBreakpoints - 1 );
+    
+    const int next = (int) ( std::upper_bound( fSample, fSample + f.numBreakpoints, sample ) - fSample );
+    const int span = fSample[next] - fSample[next - 1];
+    const double x = span > 0 ? ( sample - fSample[next - 1] ) / span : 1.;
+    return fbp.frequency( next - 1 ) + x * ( fbp.frequency( next ) - fbp.frequency( next - 1 ) );
+}
+
+// ---------------------------------------------------------------------------
+//  setLoop
+// ---------------------------------------------------------------------------
+//!	Set loop of the sound. The state of every Partial playing at the loop
+//! start is computed here: its envelope is interpolated between the
+//! Breakpoints around the start, its phase is the one of the previous
+//! Breakpoint advanced by the average frequency. The list of playing
+//! Partials is made longer for the crossfade, so wrapping never allocates.
+//!
+//! \param  startTime Loop start in seconds (time of the Partials).
+//! \param  endTime Loop end in seconds, no loop if it is not after start.
+//! \param  fadeTime Crossfade of Partials not playing at both ends in seconds,
+//!         at most half of the loop.
+//! \return Nothing.
+void RealTimeSynthesizer::setLoop(double startTime, double endTime, double fadeTime)
+{
+    clearLoop();
+    
+    const int start = (int) std::floor( std::max( startTime, 0. ) * m_srateHz + 0.5 );
+    const int end = (int) std::floor( endTime * m_srateHz + 0.5 );
+    if ( ! bank || end <= start )
+        return;
+    
+    const PartialStruct * partials = bank->partials();
+    const int * samples = bank->breakpointSamples();
+    const BreakpointArrays bp = bank->breakpoints();
+    
+    // partials are sorted by start sample, the ones after these start in the loop
+    std::shared_ptr<std::vector<LoopEntry>> entries = std::make_shared<std::vector<LoopEntry>>();
+    int idx = 0;
+    for (; idx < (int) bank->size() && partials[idx].startSample <= start; idx++)
+    {
+        const PartialStruct & p = partials[idx];
+        const int * first = samples + p.firstBreakpoint;
+        const int * last = first + p.numBreakpoints;
+        if ( p.numBreakpoints < 2 || *(last - 1) <= start )
+            continue;
         
-        // fade out breakpoint
-        jt--;
-        pStruct.breakpoints.push_back(std::make_pair(jt.time() + m_fadeTimeSec, BreakpointUtils::makeNullAfter( jt.breakpoint(), m_fadeTimeSec )));
+        // segment containing the loop start
+        const int k = (int) ( std::upper_bound( first, last, start ) - first ) - 1;
+        const int b = p.firstBreakpoint + k;
+        const double x = (double) ( start - samples[b] ) / ( samples[b + 1] - samples[b] );
         
-        this->partials.push_back(pStruct);
-//        pStruct.breakpoints[0].second.setAmplitude(pStruct.breakpoints[1].second.amplitude());
+        LoopEntry entry;
+        entry.partial = idx;
+        entry.breakpoint = k;
+        const double frequency = bp.frequency( b ) + ( bp.frequency( b + 1 ) - bp.frequency( b ) ) * x;
+        const double phase = ( bank->isPhaseFree() ? scatteredPhase( p ) : bp.phase( b ) ) 
+                             + Pi * ( bp.frequency( b ) + frequency ) * ( start - samples[b] ) * OneOverSrate;
+        entry.envelope = Breakpoint( frequency,
+                                     bp.amplitude( b ) + ( bp.amplitude( b + 1 ) - bp.amplitude( b ) ) * x,
+                                     bp.bandwidth( b ) + ( bp.bandwidth( b + 1 ) - bp.bandwidth( b ) ) * x,
+                                     std::fmod( phase, 2 * Pi ) );
+        entries->push_back( entry );
     }
-
+    loopEntries = entries;
     
+    loopStartSample = start;
+    loopEndSample = end;
+    loopPartialIdx = idx;
+    loopFadeSamples = std::min( (int) std::floor( std::max( fadeTime, 0. ) * m_srateHz + 0.5 ), ( end - start ) / 2 );
+    
+    // partials fading in and out are playing at once during the crossfade
     reset();
+    partialsBeingProcessed.assign( bank->maxConcurrentPartials() + entries->size(), 0 );
+}
+
+// ---------------------------------------------------------------------------
+//  clearLoop
+// ---------------------------------------------------------------------------
+//!	Remove loop of the sound, see setLoop().
+void RealTimeSynthesizer::clearLoop() noexcept
+{
+    loopStartSample = loopEndSample = 0;
+    loopPartialIdx = 0;
+    loopEntries.reset();
+    loopFadeSamples = 0;
 }
 
 // ---------------------------------------------------------------------------
@@ -149,20 +439,45 @@ void RealTimeSynthesizer::setSampleRate(double rate)
 
     //  better to compute this only once:
     OneOverSrate = 1. / m_srateHz;
+    cutoffScaling = 0.;
+    m_noise.setSampleRate( m_srateHz );
+    setModifiers( m_modifiers );    // crop in samples
 }
     
 // ---------------------------------------------------------------------------
 //  reset
 // ---------------------------------------------------------------------------
-//!	Reset RealtimeSynthesizer to render sound from the beging.
+//!	Reset RealtimeSynthesizer to render sound from the beging, or from
+//! any time of it. Nothing is searched but the first Partial starting
+//! after that time, the Partials playing there enter when the first
+//! block reaches it, see enterSeek().
 //!
+//! \param  startOffset Number of samples of the next synthesized blocks
+//!         preceding the beginning of the sound. Partials start with their
+//!         sample delta, the same way they start within any block.
+//! \param  startTime Time of the sound in seconds the rendering starts at.
 //! \post   Sound is rendered in original pitch.
 //! \return Nothing.
-void RealTimeSynthesizer::reset() noexcept
+void RealTimeSynthesizer::reset(int startOffset, double startTime) noexcept
 {
     partialIdx = 0;
-    processedSamples = 0;
+    processedSamples = -std::max( startOffset, 0 );
+    seekSample = std::min( (int) std::floor( std::max( startTime, 0. ) * m_srateHz + 0.5 ), lastSample );
+    seekSamples = (int) std::floor( seekSample * timeStretch + 0.5 );
+    seekPending = bank && seekSample > 0;
+    originSample = 0;
+    originBankSample = seekSample;
     clearPartialsBeingProcessed();
+    chooseEngine();
+    m_noise.reset();
+    
+    // partials starting at the seek sample or later start as usual
+    if ( seekPending )
+    {
+        const PartialStruct * partials = bank->partials();
+        partialIdx = (int) ( std::lower_bound( partials, partials + bank->size(), seekSample,
+                                               []( const PartialStruct & p, int sample ) { return p.startSample < sample; } ) - partials );
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -174,170 +489,1551 @@ void RealTimeSynthesizer::reset() noexcept
 //! \return Nothing.
 void RealTimeSynthesizer::setPitch(double frequency) noexcept
 {
-    m_osc.setFrequencyScaling(frequency / pitch);
+    m_osc.setFrequencyScaling(frequency / pitch * frequencyRatio);
+    glideScaling = 0.;
 }
 
 // ---------------------------------------------------------------------------
-//  synthesizeNext
+//  glidePitch
 // ---------------------------------------------------------------------------
-//!	Synthesize next block of samples of the partials. The synthesizer
-//! will resize the inner buffer as necessary. Previous contents of the buffer
-//! are overwritten.
+//!	Change pitch of sound smoothly during the next synthesized block.
 //!
-//! \param  sample Number of samples to synthesize.
+//! \param  New pitch in frequency of the sound at the end of the next block.
 //! \return Nothing.
-//! \post   Internal state of synthesizer changes - it is ready to synthesize
-//!         next block of samples starting at 'previous count of samples' + samples.
-void RealTimeSynthesizer::synthesizeNext( int samples ) noexcept
+void RealTimeSynthesizer::glidePitch(double frequency) noexcept
 {
-    //TODO: check processedSamples overflow
-    processedSamples += samples;// for performance reason this is computed at the beginning
-    PartialStruct *partial;
-    
-    // prepare buffer for new data
-    if (buffer->capacity() < samples)
-        buffer->reserve(samples);
-    memset(buffer->data(), 0, samples * sizeof(decltype(buffer->data())));
-    
-    
-    // process partials being processed
-    int size = partialsBeingProcessed.size();
-    for (int i = 0; i < size; i++)
+    glideScaling = frequency / pitch * frequencyRatio;
+}
+
+// ---------------------------------------------------------------------------
+//  setModifiers
+// ---------------------------------------------------------------------------
+//!	Set the render-time modifiers of the Partials. The frequency ratio is
+//! a part of the frequency scaling, it glides to a new ratio over the next
+//! block (with the glide of the pitch, if there is one). The crop is
+//! mapped to samples of the bank once, here. Harmonifying starts with the
+//! fundamental at the current position, it is looked up again at every
+//! block.
+//!
+//! \param  modifiers The modifiers, default ones change nothing.
+//! \return Nothing.
+void RealTimeSynthesizer::setModifiers(const PartialModifiers & modifiers) noexcept
+{
+    const double ratio = modifiers.frequencyRatio();
+    if ( ratio > 0. && ratio != frequencyRatio )
     {
-        partial = partialsBeingProcessed.front();
-        synthesize( *partial, buffer->data(), samples );
-        
-        if ( partial->state.lastBreakpointIdx < partial->numBreakpoints - 1)
-            partialsBeingProcessed.push( partial );
-        
-        partialsBeingProcessed.pop();
+        const double scaling = glideScaling > 0. ? glideScaling : m_osc.frequencyScaling();
+        glideScaling = scaling * ratio / frequencyRatio;
+        frequencyRatio = ratio;
     }
     
-    // partials to be processed
-    int partialSize = partials.size();
-    for (; partialIdx < partialSize; partialIdx++)
-    {
-        partial = &(partials[partialIdx]);
-        
-        // setup partial for synthesis
-        partial->state.currentSamp = index_type( (partial->startTime * m_srateHz) + 0.5 );   //  cheap rounding
+    m_modifiers = modifiers;
+    tiltExponent = modifiers.spectralTilt * std::log2( 10. ) / 20.;
+    cropStartSample = (int) std::floor( std::max( modifiers.cropStart, 0. ) * m_srateHz + 0.5 );
+    cropEndSample = (int) std::floor( modifiers.cropEnd * m_srateHz + 0.5 );
+    if ( bank && isHarmonifying() )
+        blockFundamental = fundamentalAt( bankPosition() );
+}
 
-        if (partial->state.currentSamp > processedSamples)
-            break;
-        
-        partial->state.lastBreakpointIdx = PartialStruct::NoBreakpointProcessed;
-        partial->state.envelope = partial->breakpoints[0].second;
-        partial->state.breakpointFinished = true;
+// ---------------------------------------------------------------------------
+//  setPlaybackRate
+// ---------------------------------------------------------------------------
+//!	Change speed the partials are played at, without changing their pitch.
+//! Breakpoints already reached keep their time, the others are mapped from
+//! the current position of the sound, so that the remaining part of every
+//! Breakpoint segment is stretched, not the whole sound.
+//!
+//! \param  rate Speed of the sound, 1 for original timing.
+//! \return Nothing.
+void RealTimeSynthesizer::setPlaybackRate(double rate) noexcept
+{
+    if ( rate <= 0. || 1. / rate == timeStretch )
+        return;
+    
+    originBankSample = bankPosition();
+    originSample = processedSamples;
+    timeStretch = 1. / rate;
+}
 
-        //  cache the previous frequency (in Hz) so that it can be used to reset the phase when necessary
-        partial->state.prevFrequency = m_osc.frequencyScaling() * partial->breakpoints[1].second._frequency;// 0 is null breakpoint
-        
-        int sampleCount = processedSamples - partial->state.currentSamp; // how much sample to be processed during this call
-        int sampleDelta = samples - sampleCount; // delta when partial should start
+// ---------------------------------------------------------------------------
+//  prepare
+// ---------------------------------------------------------------------------
+//!	Size the inner buffer for blocks of up to maximumBlockSize samples,
+//! so that synthesizeNext(int) does not allocate, and the pending samples
+//! of the spectral bank.
+//!
+//! \param  maximumBlockSize Largest number of samples synthesized at once.
+//! \return Nothing.
+void RealTimeSynthesizer::prepare( int maximumBlockSize )
+{
+    buffer->assign( std::max( maximumBlockSize, 0 ), 0.f );
+    m_spectral.prepare( maximumBlockSize );
+}
 
-        synthesize( *partial, buffer->data() + sampleDelta, sampleCount );
-        
-        if ( partial->state.lastBreakpointIdx < partial->numBreakpoints - 1)
-            partialsBeingProcessed.push(partial);
-    }
+// ---------------------------------------------------------------------------
+//  setEngine
+// ---------------------------------------------------------------------------
+//!	Select the way playing Partials are rendered. Samples already delayed
+//! by the engine used before are still flushed.
+//!
+//! \param  engine The engine.
+//! \return Nothing.
+void RealTimeSynthesizer::setEngine(Engine engine)
+{
+    selectedEngine = engine;
+    if ( selectedEngine != OscillatorEngine )
+        m_spectral.reserve( DefaultSpectralBlockSize );
+    chooseEngine();
 }
+
+// ---------------------------------------------------------------------------
+//  chooseEngine
+// ---------------------------------------------------------------------------
+//! Choose the engine of AutomaticEngine for the bank set up. It is chosen
+//! for the whole sound, so the engines are never switched while Partials
+//! are playing (frames overlapping a switch would have to be crossfaded).
+void RealTimeSynthesizer::chooseEngine() noexcept
+{
+    int partials = bank ? (int) bank->maxConcurrentPartials() : 0;
+    if ( maxPartialsRendered > 0 )
+        partials = std::min( partials, maxPartialsRendered );
     
+    activeEngine = selectedEngine;
+    if ( selectedEngine == AutomaticEngine )
+        activeEngine = partials >= AutomaticSpectralPartials ? SpectralEngine : OscillatorEngine;
+}
+
 // ---------------------------------------------------------------------------
-//  synthesize
+//  synthesizeNext
 // ---------------------------------------------------------------------------
-//! Synthesize a bandwidth-enhanced sinusoidal Partial.
+//!	Synthesize next block of samples of the partials into the inner
+//! buffer. Only the first samples of the buffer are overwritten, the
+//! buffer is resized (allocated) only if it is shorter, see prepare().
 //!
-//! \param  buffer  The samples buffer.
-//! \param  samples Number of samples to be synthesized.
-//! \param  p       The Partial to synthesize.
+//! \param  sample Number of samples to synthesize.
 //! \return Nothing.
-//! \pre    The buffer has to have capacity to contain all samples.
-//! \post   This RealTimeSynthesizer's sample buffer (vector) contain synthesised
-//!         partials and storeed inner state of synthesiser.
+//! \post   Internal state of synthesizer changes - it is ready to synthesize
+//!         next block of samples starting at 'previous count of samples' + samples.
+void RealTimeSynthesizer::synthesizeNext( int samples ) noexcept
+{
+    if ( samples <= 0 )
+        return;
+    
+    // prepare buffer for new data, clear only what is synthesized
+    if ( (int) buffer->size() < samples )
+        buffer->resize( samples );
+    std::fill_n( buffer->data(), samples, 0.f );
+    
+    synthesizeNext( buffer->data(), samples );
+}
+
+// ---------------------------------------------------------------------------
+//  synthesizeNext
+// ---------------------------------------------------------------------------
+//!	Synthesize next block of samples of the partials and accumulate them
+//! into the given samples, multiplied by a gain ramping linearly from gain
+//! to targetGain over the block. The block is split where the loop wraps
+//! and where a sound started by reset() at a later time begins, the gain
+//! and the glide of pitch are interpolated there.
+//!
+//! \param  output  The samples to accumulate into, at least samples long.
+//! \param  samples Number of samples to synthesize.
+//! \param  gain    Gain at the beginning of the block.
+//! \param  targetGain Gain at the end of the block.
+//! \return Nothing.
+//! \post   Internal state of synthesizer changes - it is ready to synthesize
+//!         next block of samples starting at 'previous count of samples' + samples.
+void RealTimeSynthesizer::synthesizeNext( float * output, int samples, double gain, double targetGain ) noexcept
+{
+    // all channels are mixed into the same samples
+    float * outputs[PartialStruct::NumChannels];
+    std::fill_n( outputs, (int) PartialStruct::NumChannels, output );
+    synthesizeNext( outputs, samples, gain, targetGain );
+}
+
+// ---------------------------------------------------------------------------
+//  synthesizeNext
+// ---------------------------------------------------------------------------
+//!	Synthesize next block of samples of the partials and accumulate each
+//! Partial into the output of its channel, see
+//! synthesizeNext(float *, int, double, double).
 //!
-void RealTimeSynthesizer::synthesize( PartialStruct &p, float * buffer, const int samples) noexcept
+//! \param  outputs PartialStruct::NumChannels pointers to the samples to
+//!         accumulate into, each at least samples long.
+//! \param  samples Number of samples to synthesize.
+//! \param  gain    Gain at the beginning of the block.
+//! \param  targetGain Gain at the end of the block.
+//! \return Nothing.
+void RealTimeSynthesizer::synthesizeNext( float * const * outputs, int samples, double gain, double targetGain ) noexcept
 {
-    if (p.state.lastBreakpointIdx == PartialStruct::NoBreakpointProcessed)
-        m_osc.resetEnvelopes( p.state.envelope, m_srateHz );
-    else
-        m_osc.restoreEnvelopes( p.state.envelope );
-        
-    int sampleCounter = 0;
-	int sampleDiff = 0;
-    int i;
-    for (i = p.state.lastBreakpointIdx + 1;  i < p.numBreakpoints; ++i )
+    LORIS_TRACE_ZONE( "RealTimeSynthesizer::synthesizeNext" );
+    float * output[PartialStruct::NumChannels];
+    channelsWritten = 0;
+    partialsCulled = 0;
+    std::copy( outputs, outputs + PartialStruct::NumChannels, output );
+    
+    const double startScaling = m_osc.frequencyScaling();
+    const double endScaling = glideScaling;
+    const double startMorph = morphWeight;
+    const double endMorph = glideMorph;
+    const double startBrightness = brightnessExponent;
+    const double endBrightness = glideBrightnessExponent;
+    const bool brightnessGlide = brightnessGliding;
+    const int blockLength = samples;
+    bool wrapped = false;
+    
+    while ( ( seekPending || ( looping && hasLoop() ) ) && bank && samples > 0 )
     {
-        index_type tgtSamp = index_type( (p.breakpoints[i].first * m_srateHz) + 0.5 );   //  cheap rounding
-        
-        sampleCounter += sampleDiff = tgtSamp - p.state.currentSamp;
-        
-        if (sampleCounter > samples)// if this breakpoint is longer...
-        {
-            // cropp it...
-            sampleDiff -= (sampleCounter - samples); // substract the overflowing number of samples to get max possible sample diff
-            sampleCounter = samples; // we can process max "samples" count
-        }
+        // the seeked sound begins at sample 0 of this synthesizer, the loop end
+        // is mapped to its time again after every wrap and every change of
+        // playback rate
+        const int toEvent = seekPending ? -processedSamples : voiceSample( loopEndSample ) - processedSamples;
+        if ( toEvent < 0 || toEvent >= samples || ( wrapped && toEvent == 0 ) )
+            break;
         
-        Breakpoint *bp = &(p.breakpoints[i].second);
-        //  if the current oscillator amplitude is
-        //  zero, and the target Breakpoint amplitude
-        //  is not, reset the oscillator phase so that
-        //  it matches exactly the target Breakpoint 
-        //  phase at tgtSamp:
-//        if ( m_osc.amplitude() == 0. && p.state.breakpointFinished )
-        if ( i == PartialStruct::NoBreakpointProcessed + 1 && p.state.breakpointFinished )
+        if ( toEvent > 0 )
         {
-            //  recompute the phase so that it is correct
-            //  at the target Breakpoint (need to do this
-            //  because the null Breakpoint phase was computed
-            //  from an interval in seconds, not samples, so
-            //  it might be inaccurate):
-            //
-            //  double favg = 0.5 * ( prevFrequency + it.breakpoint().frequency() );
-            //  double dphase = 2 * Pi * favg * ( tgtSamp - currentSamp ) / m_srateHz;
+            const double x = (double) toEvent / samples;
+            const double splitGain = gain + ( targetGain - gain ) * x;
+            if ( endScaling > 0. )
+                glideScaling = startScaling + ( endScaling - startScaling ) * ( blockLength - samples + toEvent ) / blockLength;
+            if ( endMorph >= 0. )
+                glideMorph = startMorph + ( endMorph - startMorph ) * ( blockLength - samples + toEvent ) / blockLength;
+            if ( brightnessGlide )
+            {
+                glideBrightnessExponent = startBrightness + ( endBrightness - startBrightness ) * ( blockLength - samples + toEvent ) / blockLength;
+                brightnessGliding = true;
+            }
             
-            double dphase = Pi * ( p.state.prevFrequency + m_osc.frequencyScaling() * bp->frequency() ) * ( tgtSamp - p.state.currentSamp ) * OneOverSrate;
+            synthesizeBlock( output, toEvent, gain, splitGain );
             
-            // If we transposed/pitch-shifted the sound using sample rate change, the transpose octave above would
-            // mean create new signal with every second sample missing, so the partial would start earlier. If we
-            // would like to have partial transposed but in the same time t0 as original,  what the new phase will be?
-            // It will be the original phase with the phase change during the delta of time. What delta of time is it?
-            // The start time in sample-removing pitch shifted signal would be half of time if we transpose octave up so the
-            // delta time is t0 - t0/transposeFactor. So the new phase goes like this (here we do not have time t0 so we get
-            // it from partial[iSamp]/float(fs)).
-            double phaseFixed = (bp->phase() + 2*Pi*p.avgFrequency*p.state.currentSamp*OneOverSrate*(m_osc.frequencyScaling()-1));
-
-            m_osc.setPhase( phaseFixed - dphase );
+            for ( float * & channel : output )
+                channel += toEvent;
+            samples -= toEvent;
+            gain = splitGain;
         }
         
-        int samplesToBp = tgtSamp - p.state.currentSamp;
-        m_osc.oscillate( buffer, buffer + sampleDiff, *bp, m_srateHz, samplesToBp );
+        if ( seekPending )
+            enterSeek();
+        else
+        {
+            wrapLoop();
+            wrapped = true;
+        }
+    }
+    
+    glideScaling = endScaling;
+    glideMorph = endMorph;
+    glideBrightnessExponent = endBrightness;
+    brightnessGliding = brightnessGlide;
+    synthesizeBlock( output, samples, gain, targetGain );
+}
 
-		buffer += sampleDiff;// move buffer pointer
+// ---------------------------------------------------------------------------
+//  synthesizeBlock
+// ---------------------------------------------------------------------------
+//! Synthesize a block of samples of the partials which does not pass
+//! the loop end, see synthesizeNext(float * const *, int, double, double).
+//! Unless the engine is OscillatorEngine, the block is rendered into the
+//! pending samples of the spectral bank and the samples pending since
+//! latency() samples ago are moved to the outputs. A block longer than the
+//! pending samples were allocated for is rendered by the oscillators with
+//! no delay instead, which is heard as a glitch but does not allocate.
+void RealTimeSynthesizer::synthesizeBlock( float * const * outputs, int samples, double gain, double targetGain ) noexcept
+{
+    if ( selectedEngine == OscillatorEngine || samples > m_spectral.maximumBlockSize() )
+    {
+        renderBlock( outputs, samples, gain, targetGain, OscillatorEngine );
         
-		p.state.currentSamp += sampleDiff;
-        p.state.breakpointFinished = tgtSamp == p.state.currentSamp;
+        // samples delayed by the engine used before
+        if ( ! m_spectral.isSilent() )
+            channelsWritten |= m_spectral.flush( outputs, samples );
+        return;
+    }
+    
+    float * delayed[PartialStruct::NumChannels];
+    for (int c = 0; c < PartialStruct::NumChannels; c++)
+        delayed[c] = m_spectral.delayed( c );
+    
+    const int written = channelsWritten;
+    channelsWritten = 0;
+    renderBlock( delayed, samples, gain, targetGain, activeEngine );
+    m_spectral.written( channelsWritten, samples );
+    channelsWritten = written | m_spectral.flush( outputs, samples );
+}
 
-        if (p.state.breakpointFinished)
+// ---------------------------------------------------------------------------
+//  renderBlock
+// ---------------------------------------------------------------------------
+//! Render a block of samples of the partials into outputs by an engine,
+//! with no latency, see synthesizeBlock().
+void RealTimeSynthesizer::renderBlock( float * const * outputs, int samples, double gain, double targetGain, Engine engine ) noexcept
+{
+    //TODO: check processedSamples overflow
+    processedSamples += samples;// for performance reason this is computed at the beginning
+    int idx;
+    
+    if ( ! bank || samples <= 0 )
+        return;
+    
+    outputGain = gain;
+    outputGainStep = ( targetGain - gain ) / samples;
+    
+    // partials starting in the block use the scaling of its end
+    blockSamples = samples;
+    blockScaling = m_osc.frequencyScaling();
+    blockScalingStep = 0.;
+    if ( glideScaling > 0. && glideScaling != blockScaling )
+    {
+        blockScalingStep = ( glideScaling - blockScaling ) / samples;
+        m_osc.setFrequencyScaling( glideScaling );
+    }
+    glideScaling = 0.;
+    
+    // morph amount ramps over the block the same way, Breakpoints take it at
+    // their sample
+    blockMorph = morphWeight;
+    blockMorphStep = 0.;
+    if ( glideMorph >= 0. )
+    {
+        blockMorphStep = ( glideMorph - morphWeight ) / samples;
+        morphWeight = glideMorph;
+    }
+    glideMorph = -1.;
+    
+    // Breakpoints reached in the block are harmonified by the fundamental at
+    // its end, one lookup per block
+    if ( isHarmonifying() )
+        blockFundamental = fundamentalAt( bankPosition() );
+    
+    // brightness ramps with the gains of the partials
+    blockBrightness = brightnessExponent;
+    if ( brightnessGliding )
+        brightnessExponent = glideBrightnessExponent;
+    brightnessGliding = false;
+    blockBrightnessEnd = brightnessExponent;
+    
+    // other synthesizers of a chord may have evaluated the Breakpoints of the block
+    if ( envelopeFrame )
+        envelopeFrame->begin( envelopeKey( samples ) );
+    
+    // partials start with the scaling of the block end, they are culled if
+    // they are above Nyquist over the whole block
+    updateCutoff( std::min( blockScaling, m_osc.frequencyScaling() ) );
+    
+    // the residual costs the same whatever the number of partials
+    if ( m_noise.isActive() )
+        renderNoise( outputs[PartialStruct::Center], samples );
+    
+    const PartialStruct * partials = bank->partials();
+    
+    // crossfade after the loop wrapped goes on over the block
+    loopFadeEnd = loopFadeLeft > samples ? (float) ( loopFadeLeft - samples ) / crossfadeSamples : 0.f;
+    loopFadeLeft = std::max( loopFadeLeft - samples, 0 );
+    
+    // process partials being processed, NumLanes partials at once, partials
+    // over the budget are followed only; partials of a stereo bank are grouped
+    // by channel, so lanes share an output and only the accumulate differs
+    int * active = partialsBeingProcessed.data();
+    const int numRendered = selectPartials();
+    if ( engine == SpectralEngine )
+    {
+        // partials starting in the block start at the frames
+        renderFrames( samples, numRendered );
+        removeFinished();
+        return;
+    }
+    
+    // harmonic partials are moved after the others and rendered from the fundamental
+    // while it plays, see setHarmonicRendering()
+    int * lanesEnd = active + numRendered;
+    if ( renderHarmonics && numHarmonicPartials > 0 && ! isMorphing()
+         && std::find( active, active + numPartialsBeingProcessed, harmonicFundamental ) != active + numPartialsBeingProcessed )
+    {
+        lanesEnd = std::partition( active, lanesEnd, [this]( int idx ) { return (*harmonicNumbers)[idx] == 0; } );
+        if ( lanesEnd < active + numRendered )
         {
-            //  remember the frequency, may need it to reset the
-            //  phase if a Null Breakpoint is encountered:
-//            m_osc.resetEnvelopes(*bp, m_srateHz);
-//            p.state.prevFrequency = bp->frequency();
-            
-            p.state.prevFrequency = m_osc.envelopes().frequency();
-//                m_osc.setPhase(bp->phase());
+            synthesizeHarmonics( lanesEnd, (int) ( active + numRendered - lanesEnd ), outputs[PartialStruct::Center], samples );
+            channelsWritten |= 1 << PartialStruct::Center;
         }
+    }
+    
+    // low partials are grouped by the rate they are rendered at, lowest first
+    int maxFactor = 1;
+    while ( multiRate && maxFactor < 4 && m_srateHz / ( 2 * maxFactor ) >= MinMultiRate )
+        maxFactor *= 2;
+    
+    int * channelBegin = active;
+    for (int c = 0; c < PartialStruct::NumChannels && channelBegin < lanesEnd; c++)
+    {
+        int * channelEnd = lanesEnd;
+        if ( bank->isStereo() && c < PartialStruct::NumChannels - 1 )
+            channelEnd = std::partition( channelBegin, channelEnd,
+                                         [partials, c]( int idx ) { return partials[idx].channel() == c; } );
         
-        if (sampleCounter == samples)
+        // mono bank renders everything as Center
+        int * tierBegin = channelBegin;
+        for (int factor = maxFactor; factor >= 1; factor /= 2)
         {
-            i--; // there is still something to be done in this break point
-            break;
+            // a tier fills whole groups, the partials left over go to the next one
+            int * tierEnd = channelEnd;
+            if ( factor > 1 )
+            {
+                tierEnd = std::partition( tierBegin, channelEnd,
+                                          [this, factor, maxFactor]( int idx ) { return decimationFactor( idx, maxFactor ) >= factor; } );
+                tierEnd -= ( tierEnd - tierBegin ) % RealtimeOscillatorBank::NumLanes;
+            }
+            
+            for (int * it = tierBegin; it < tierEnd; it += RealtimeOscillatorBank::NumLanes)
+            {
+                const int groupSize = std::min( (int) RealtimeOscillatorBank::NumLanes, (int) ( tierEnd - it ) );
+                synthesizeLanes( it, groupSize, outputs[c], samples, factor );
+                channelsWritten |= 1 << c;
+            }
+            tierBegin = tierEnd;
         }
-	}
+        channelBegin = channelEnd;
+    }
+    for (int i = numRendered; i < numPartialsBeingProcessed; i++)
+    {
+        idx = active[i];
+        skip( partials[idx], states[idx], samples );
+    }
+    
+    removeFinished();
+    startPartials( outputs, samples, samples );
+}
+
+// ---------------------------------------------------------------------------
+//  decimationFactor
+// ---------------------------------------------------------------------------
+//! Return the tier of a playing Partial in the block rendered by
+//! renderBlock(): the largest factor up to maxFactor its frequency times
+//! the factor is at most RealtimeOscillatorBank::MaxDecimatedFrequency at,
+//! taking the frequency scaling at the end of the block if it glides up.
+//! The oscillator bank renders a segment going higher at the full rate.
+//! Partials with noise are at the full rate, they are not regrouped.
+int RealTimeSynthesizer::decimationFactor( int idx, int maxFactor ) const noexcept
+{
+    if ( states[idx].envelope.bandwidth() > 0. )
+        return 1;
+    
+    const double glide = blockScaling > 0. ? m_osc.frequencyScaling() / blockScaling : 1.;
+    const double frequency = states[idx].envelope.frequency() * std::max( 1., glide );
+    int factor = maxFactor;
+    while ( factor > 1 && frequency * factor > RealtimeOscillatorBank::MaxDecimatedFrequency )
+        factor /= 2;
+    return factor;
+}
+
+// ---------------------------------------------------------------------------
+//  scaleBlockGains
+// ---------------------------------------------------------------------------
+//! Scale the gains of a Partial over the block by its brightness, the
+//! PartialFilter, the spectral surface and the PartialGains. The gain of
+//! the filter at the frequency of the Partial at the beginning of the block
+//! is reached at its end, from the gain of the last block, one lookup per
+//! Partial and block, and so are the gain of the surface and its edited
+//! gain. Partials ramp back to 1 when the gains are removed.
+//!
+//! \param  idx Index of the Partial.
+//! \param  gain Gain at the beginning of the block.
+//! \param  targetGain Gain at the end of the block.
+void RealTimeSynthesizer::scaleBlockGains( int idx, double & gain, double & targetGain ) noexcept
+{
+    if ( isBrightening() )
+    {
+        const PartialStruct & p = bank->partials()[idx];
+        gain *= brightnessGain( p, blockBrightness );
+        targetGain *= brightnessGain( p, blockBrightnessEnd );
+    }
+    if ( m_filter )
+    {
+        PartialState & state = states[idx];
+        gain *= state.filterGain;
+        state.filterGain = filterGain( state.envelope.frequency() );
+        targetGain *= state.filterGain;
+    }
+    if ( isCrossSynthesizing() || states[idx].surfaceGain != 1.f )
+    {
+        PartialState & state = states[idx];
+        gain *= state.surfaceGain;
+        state.surfaceGain = isCrossSynthesizing() ? surfaceGain( state.envelope.frequency() ) : 1.f;
+        targetGain *= state.surfaceGain;
+    }
+    const float edit = m_gains ? m_gains->gain( idx ) : 1.f;
+    PartialState & state = states[idx];
+    if ( edit != 1.f || state.editGain != 1.f )
+    {
+        gain *= state.editGain;
+        state.editGain = edit;
+        targetGain *= edit;
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  renderNoise
+// ---------------------------------------------------------------------------
+//! Accumulate the noise bands of the block rendered by renderBlock() into
+//! output, with the gain of the block. The bands are read at the time of
+//! the bank at the block end and take the pitch there, samples preceding
+//! the beginning of the sound (see reset()) stay silent.
+void RealTimeSynthesizer::renderNoise( float * output, int samples ) noexcept
+{
+    const int silent = std::min( std::max( samples - processedSamples, 0 ), samples );
+    if ( silent == samples )
+        return;
+    
+    m_noise.render( output + silent, samples - silent, bankPosition() * OneOverSrate, m_osc.frequencyScaling(),
+                    outputGain + outputGainStep * silent, outputGainStep );
+    channelsWritten |= 1 << PartialStruct::Center;
+}
+
+// ---------------------------------------------------------------------------
+//  removeFinished
+// ---------------------------------------------------------------------------
+//! Remove finished partials and the ones faded out after the loop wrapped
+//! from the playing ones (swap with the last one, order does not matter),
+//! and the ones faded out by the end of the crop.
+void RealTimeSynthesizer::removeFinished() noexcept
+{
+    const PartialStruct * partials = bank->partials();
+    int * active = partialsBeingProcessed.data();
+    for (int i = 0; i < numPartialsBeingProcessed; )
+    {
+        const int idx = active[i];
+        PartialState & state = states[idx];
+        if ( state.lastBreakpointIdx < partials[idx].numBreakpoints - 1 && ! ( state.loopFade < 0 && state.targetGain == 0.f )
+             && ! isFadedByCrop( partials[idx], state ) )
+            i++;
+        else
+        {
+            state.loopFade = 0;
+            active[i] = active[--numPartialsBeingProcessed];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  startPartials
+// ---------------------------------------------------------------------------
+//! Start the Partials which start up to a sample of the block. The bank is
+//! sorted by start sample so the next one to start is always at partialIdx
+//! and nothing is searched (after reset() too, so retriggered notes pay
+//! only for partials starting in the block).
+//!
+//! \param  outputs Outputs to render the Partials into up to the end of
+//!         the block, null to set them up only (for renderFrames()).
+//! \param  samples Number of samples of the block.
+//! \param  end Sample of the block, Partials starting at it start too.
+void RealTimeSynthesizer::startPartials( float * const * outputs, int samples, int end ) noexcept
+{
+    const PartialStruct * partials = bank->partials();
+    int * active = partialsBeingProcessed.data();
+    const int endSample = processedSamples - samples + end;
+    
+    const int partialSize = (int) bank->size();
+    if ( numAudiblePartials == 0 && ! isMorphing() )
+    {
+        // whole bank is above Nyquist at this pitch, partials starting in the
+        // block are found by a binary search and skipped
+        const int firstIdx = partialIdx;
+        partialIdx = (int) ( std::partition_point( partials + partialIdx, partials + partialSize,
+                                                   [this, endSample]( const PartialStruct & p ) { return voiceSample( p.startSample ) <= endSample; } )
+                             - partials );
+        partialsCulled += partialIdx - firstIdx;
+    }
+    for (; partialIdx < partialSize && voiceSample( partials[partialIdx].startSample ) <= endSample; partialIdx++)
+    {
+        const PartialStruct & partial = partials[partialIdx];
+        PartialState & state = states[partialIdx];
+        
+        // partials which would only be kept silent by the oscillator are not
+        // played at all, so high notes drop most of their partials here
+        if ( isAboveNyquist( partial ) )
+        {
+            ++partialsCulled;
+            continue;
+        }
+        
+        // nor are the ones out of the crop
+        if ( isCropped( partial ) )
+            continue;
+        
+        // partial left by a wrap of a short loop may be still fading out,
+        // it starts again in its place in the list
+        const bool listed = state.loopFade < 0;
+        state.loopFade = 0;
+        
+        // setup partial for synthesis
+        state.currentSamp = voiceSample( partial.startSample );
+        
+        const BreakpointArrays bp = bank->breakpoints().from( partial.firstBreakpoint );
+        state.lastBreakpointIdx = PartialStruct::NoBreakpointProcessed;
+        double frequency = bp.frequency( 0 ), amplitude = bp.amplitude( 0 ), bandwidth = bp.bandwidth( 0 );
+        if ( isHarmonifying() )
+            harmonifyBreakpoint( partial, frequency );
+        if ( isModifying() )
+            modifyBreakpoint( partial.startSample, frequency, amplitude, bandwidth );
+        m_osc.resetEnvelopes( Breakpoint( frequency, amplitude, bandwidth, bp.phase( 0 ) ), m_srateHz );
+        state.envelope = m_osc.envelopes(); // radians per sample from now on
+        state.breakpointFinished = true;
+        state.gain = state.targetGain = 1.f;
+        state.editGain = m_gains ? m_gains->gain( partialIdx ) : 1.f;
+        state.surfaceGain = isCrossSynthesizing() ? surfaceGain( state.envelope.frequency() ) : 1.f;
+
+        //  cache the previous frequency (in Hz) so that it can be used to reset the phase when necessary
+        state.prevFrequency = m_osc.frequencyScaling() * bp.frequency( 1 );// 0 is null breakpoint
+        
+        if ( outputs )
+        {
+            int sampleCount = processedSamples - state.currentSamp; // how much sample to be processed during this call
+            int sampleDelta = samples - sampleCount; // delta when partial should start
+
+            // partials starting in the block take the brightness of its end,
+            // the filter and the surface at their first frequency and their
+            // edited gain
+            double bright = isBrightening() ? brightnessGain( partial, blockBrightnessEnd ) : 1.;
+            if ( m_filter )
+            {
+                state.filterGain = filterGain( state.envelope.frequency() );
+                bright *= state.filterGain;
+            }
+            bright *= state.surfaceGain * state.editGain;
+            m_osc.setGain( ( outputGain + sampleDelta * outputGainStep ) * bright, outputGainStep * bright );
+            synthesize( partial, state, outputs[partial.channel()] + sampleDelta, sampleCount );
+            channelsWritten |= 1 << partial.channel();
+        }
+        
+        if ( state.lastBreakpointIdx < partial.numBreakpoints - 1 && ! listed )
+        {
+            // list is sized for maximum of concurrent partials, so it is never full
+            assert( numPartialsBeingProcessed < (int) partialsBeingProcessed.size() );
+            if ( numPartialsBeingProcessed < (int) partialsBeingProcessed.size() )
+                active[numPartialsBeingProcessed++] = partialIdx;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  renderFrames
+// ---------------------------------------------------------------------------
+//! Render the playing Partials and the ones starting in the block by the
+//! frames of the spectral bank centred in it. Frames are centred at
+//! multiples of the hop in time of this synthesizer, whatever the blocks
+//! are. Every Partial is followed to the centre of each frame by skip(),
+//! exactly as the oscillator bank would play it, and adds its envelope
+//! there (faded by its gain and the output gain at the centre) to the
+//! frame. Partials start at the first frame after their start.
+//!
+//! \param  samples Number of samples of the block.
+//! \param  numRendered Number of Partials to be rendered, see selectPartials().
+void RealTimeSynthesizer::renderFrames( int samples, int numRendered ) noexcept
+{
+    LORIS_TRACE_ZONE( "RealTimeSynthesizer::renderFrames" );
+    const PartialStruct * partials = bank->partials();
+    int * active = partialsBeingProcessed.data();
+    const int blockStart = processedSamples - samples;
+    const int hop = RealtimeSpectralBank::Hop;
+    const int firstStarted = numPartialsBeingProcessed;
+    
+    for (int position = ( hop - blockStart % hop ) % hop; position < samples; position += hop)
+    {
+        startPartials( nullptr, samples, position );
+        
+        const int centre = blockStart + position;
+        const double x = (double) position / samples;
+        const double gain = outputGain + position * outputGainStep;
+        auto addPartial = [&]( int idx )
+        {
+            PartialState & state = states[idx];
+            skip( partials[idx], state, centre - state.currentSamp, state.currentSamp - blockStart );
+            
+            // partials past their last Breakpoint are silent
+            const Breakpoint & envelope = state.envelope;
+            double amplitude = envelope.amplitude() * gain * ( state.gain + ( state.targetGain - state.gain ) * x );
+            if ( isBrightening() )
+            {
+                const double brightStart = brightnessGain( partials[idx], blockBrightness );
+                amplitude *= brightStart + ( brightnessGain( partials[idx], blockBrightnessEnd ) - brightStart ) * x;
+            }
+            if ( m_filter )
+                amplitude *= filterGain( envelope.frequency() );
+            if ( isCrossSynthesizing() )
+                amplitude *= surfaceGain( envelope.frequency() );
+            if ( m_gains )
+                amplitude *= m_gains->gain( idx );
+            if ( amplitude > 0. && envelope.frequency() < Pi )
+                m_spectral.addPartial( partials[idx].channel(), envelope.frequency(), amplitude,
+                                       envelope.bandwidth(), envelope.phase() );
+        };
+        
+        // partials over the budget are not rendered, the ones started in
+        // this block are
+        for (int i = 0; i < numRendered; i++)
+            addPartial( active[i] );
+        for (int i = firstStarted; i < numPartialsBeingProcessed; i++)
+            addPartial( active[i] );
+        
+        m_spectral.overlapAdd( position );
+    }
+    
+    // every partial goes on from the end of the block, fades are done
+    startPartials( nullptr, samples, samples );
+    for (int i = 0; i < numPartialsBeingProcessed; i++)
+    {
+        PartialState & state = states[active[i]];
+        skip( partials[active[i]], state, processedSamples - state.currentSamp, state.currentSamp - blockStart );
+        state.gain = state.targetGain;
+    }
+}
+    
+// ---------------------------------------------------------------------------
+//  wrapLoop
+// ---------------------------------------------------------------------------
+//! Go on from the loop start. Partials playing at both ends of the loop
+//! jump to their segment at the loop start, keeping their envelope and
+//! phase, so their lanes ramp from there to the next Breakpoint. The ones
+//! playing at the end only fade out, the ones playing at the start only
+//! fade in from their precomputed state. The mapping of Breakpoint times
+//! is rebased, so the sample clock of this synthesizer goes on.
+void RealTimeSynthesizer::wrapLoop() noexcept
+{
+    int * active = partialsBeingProcessed.data();
+    updateCutoff( m_osc.frequencyScaling() );
+    
+    // partials playing now fade out, unless they are playing at the start too
+    for (int i = 0; i < numPartialsBeingProcessed; i++)
+        states[active[i]].loopFade = -1;
+    
+    const double scaling = m_osc.frequencyScaling() * 2 * Pi * OneOverSrate;
+    for (const LoopEntry & entry : *loopEntries)
+    {
+        PartialState & state = states[entry.partial];
+        
+        if ( state.loopFade < 0 )
+        {
+            // playing at both ends
+            state.loopFade = 0;
+        }
+        else if ( isAboveNyquist( bank->partials()[entry.partial] ) )
+        {
+            ++partialsCulled;
+            continue;
+        }
+        else
+        {
+            state.envelope = entry.envelope;
+            state.envelope.setFrequency( scaling * entry.envelope.frequency() );
+            if ( isModifying() )
+            {
+                double amplitude = entry.envelope.amplitude(), bandwidth = entry.envelope.bandwidth();
+                modifyBreakpoint( loopStartSample, entry.envelope.frequency(), amplitude, bandwidth );
+                state.envelope.setAmplitude( amplitude );
+                state.envelope.setBandwidth( bandwidth );
+            }
+            state.gain = state.targetGain = 0.f;
+            state.loopFade = 1;
+            
+            // list is sized for the partials entering the loop too, see setLoop()
+            assert( numPartialsBeingProcessed < (int) partialsBeingProcessed.size() );
+            if ( numPartialsBeingProcessed < (int) partialsBeingProcessed.size() )
+                active[numPartialsBeingProcessed++] = entry.partial;
+        }
+        
+        state.currentSamp = processedSamples;
+        state.lastBreakpointIdx = entry.breakpoint;
+        state.breakpointFinished = false;   // phase is not fixed again
+    }
+    
+    partialIdx = loopPartialIdx;
+    originSample = processedSamples;
+    originBankSample = loopStartSample;
+    loopFadeLeft = crossfadeSamples = loopFadeSamples;
+}
+
+// ---------------------------------------------------------------------------
+//  enterSeek
+// ---------------------------------------------------------------------------
+//! Start the sound at the time given to reset(). The Partials playing at
+//! the nearest checkpoint before it, and the ones starting between the
+//! checkpoint and the seek sample, are followed from there to the seek
+//! sample, Breakpoint by Breakpoint, and start fading in over the fade
+//! time of the bank. Nothing is allocated, the list of playing Partials
+//! is sized for the maximum of concurrent Partials.
+void RealTimeSynthesizer::enterSeek() noexcept
+{
+    seekPending = false;
+    updateCutoff( m_osc.frequencyScaling() );
+    
+    const int numCheckpoints = (int) bank->numCheckpoints();
+    if ( numCheckpoints == 0 )
+        return;
+    
+    const int interval = bank->checkpointSamples();
+    const int c = std::min( seekSample / interval, numCheckpoints - 1 );
+    const PartialCheckpoint * checkpoint = bank->checkpointPartials( c );
+    const int numListed = (int) bank->numCheckpointPartials( c );
+    for (int i = 0; i < numListed; i++)
+    {
+        // partials starting at the seek sample start as usual
+        if ( checkpoint[i].partial < partialIdx )
+            enterPartial( checkpoint[i].partial, checkpoint[i].breakpoint, checkpoint[i].phase, c * interval );
+    }
+    
+    // partials starting after the checkpoint are followed from their start
+    const PartialStruct * partials = bank->partials();
+    const int afterCheckpoint = (int) ( std::upper_bound( partials, partials + partialIdx, c * interval,
+                                                          []( int sample, const PartialStruct & p ) { return sample < p.startSample; } ) - partials );
+    for (int idx = afterCheckpoint; idx < partialIdx; idx++)
+        enterPartial( idx, 0, 0., partials[idx].startSample );
+    
+    loopFadeLeft = crossfadeSamples = std::max( (int) std::floor( bank->fadeTime() * m_srateHz + 0.5 ), 1 );
+}
+
+// ---------------------------------------------------------------------------
+//  enterPartial
+// ---------------------------------------------------------------------------
+//! Start playing a Partial at the seek sample. Its phase advance goes on
+//! from the given state to the seek sample, it is scaled to the pitch and
+//! the playback rate of this synthesizer and added to the phase the Partial
+//! starts with in a sound rendered from the beginning, see fixedPhase().
+//!
+//! \param  idx Index of the Partial.
+//! \param  k Breakpoint the Partial is at, at the sample at.
+//! \param  phase Unwrapped phase advance from the fade in Breakpoint to at.
+//! \param  at Sample of the bank the state is given at.
+void RealTimeSynthesizer::enterPartial( int idx, int k, double phase, int at ) noexcept
+{
+    const PartialStruct & p = bank->partials()[idx];
+    if ( isAboveNyquist( p ) )
+    {
+        ++partialsCulled;
+        return;
+    }
+    if ( isCropped( p ) )
+        return;
+    
+    const int * sample = bank->breakpointSamples() + p.firstBreakpoint;
+    const BreakpointArrays bp = bank->breakpoints().from( p.firstBreakpoint );
+    
+    // frequency at a sample of segment k
+    auto frequencyAt = [&]( int k, int n ) -> double
+    {
+        return n > sample[k] ? bp.frequency( k ) + ( bp.frequency( k + 1 ) - bp.frequency( k ) ) * (double) ( n - sample[k] ) / ( sample[k + 1] - sample[k] )
+                             : bp.frequency( k );
+    };
+    
+    // segment containing the seek sample, the partial may have finished before it
+    for (; k + 1 < p.numBreakpoints && sample[k + 1] <= seekSample; k++)
+    {
+        phase += Pi * ( frequencyAt( k, at ) + bp.frequency( k + 1 ) ) * ( sample[k + 1] - at ) * OneOverSrate;
+        at = sample[k + 1];
+    }
+    if ( k + 1 >= p.numBreakpoints )
+        return;
+    
+    const double x = (double) ( seekSample - sample[k] ) / ( sample[k + 1] - sample[k] );
+    const double seekFrequency = frequencyAt( k, seekSample );
+    phase += Pi * ( frequencyAt( k, at ) + seekFrequency ) * ( seekSample - at ) * OneOverSrate;
+    
+    // phase at the fade in breakpoint of a sound rendered from the beginning
+    PartialState & state = states[idx];
+    state.currentSamp = voiceSample( p.startSample );
+    state.prevFrequency = m_osc.frequencyScaling() * bp.frequency( 1 );
+    const double startPhase = fixedPhase( p, state );
+    
+    double amplitude = bp.amplitude( k ) + ( bp.amplitude( k + 1 ) - bp.amplitude( k ) ) * x;
+    double bandwidth = bp.bandwidth( k ) + ( bp.bandwidth( k + 1 ) - bp.bandwidth( k ) ) * x;
+    if ( isModifying() )
+        modifyBreakpoint( seekSample, seekFrequency, amplitude, bandwidth );
+    
+    const double scaling = m_osc.frequencyScaling() * 2 * Pi * OneOverSrate;
+    state.envelope = Breakpoint( scaling * seekFrequency, amplitude, bandwidth,
+                                 std::fmod( startPhase + m_osc.frequencyScaling() * timeStretch * phase, 2 * Pi ) );
+    state.currentSamp = processedSamples;
+    state.lastBreakpointIdx = k;
+    state.breakpointFinished = false;   // phase is not fixed again
+    state.gain = state.targetGain = 0.f;
+    state.loopFade = 1;
+    
+    assert( numPartialsBeingProcessed < (int) partialsBeingProcessed.size() );
+    if ( numPartialsBeingProcessed < (int) partialsBeingProcessed.size() )
+        partialsBeingProcessed[numPartialsBeingProcessed++] = idx;
+}
+
+// ---------------------------------------------------------------------------
+//  updateCutoff
+// ---------------------------------------------------------------------------
+//! Compute the highest frequency of the bank audible at a frequency scaling.
+//! The Partials of the bank are sorted by their highest frequency too, so
+//! the number of Partials below it is found by a binary search, once per
+//! change of pitch and not for every Partial.
+void RealTimeSynthesizer::updateCutoff( double scaling ) noexcept
+{
+    if ( scaling == cutoffScaling || ! bank )
+        return;
+    
+    cutoffScaling = scaling;
+    audibleFrequency = scaling > 0. ? 0.5 * m_srateHz / scaling : std::numeric_limits<double>::max();
+    numAudiblePartials = (int) bank->numPartialsBelow( audibleFrequency );
+}
+
+// ---------------------------------------------------------------------------
+//  synthesize
+// ---------------------------------------------------------------------------
+//! Synthesize a bandwidth-enhanced sinusoidal Partial.
+//!
+//! \param  buffer  The samples buffer.
+//! \param  samples Number of samples to be synthesized.
+//! \param  p       The Partial to synthesize.
+//! \param  state   Playback state of the Partial.
+//! \return Nothing.
+//! \pre    The buffer has to have capacity to contain all samples.
+//! \post   This RealTimeSynthesizer's sample buffer (vector) contain synthesised
+//!         partials and storeed inner state of synthesiser.
+//!
+void RealTimeSynthesizer::synthesize( const PartialStruct &p, PartialState &state, float * buffer, const int samples) noexcept
+{
+    m_osc.restoreEnvelopes( state.envelope );
+        
+    // breakpoint streams of this partial
+    const int * bpSample = bank->breakpointSamples() + p.firstBreakpoint;
+    const BreakpointArrays bp = bank->breakpoints().from( p.firstBreakpoint );
+    
+    int sampleCounter = 0;
+	int sampleDiff = 0;
+    int i;
+    for (i = state.lastBreakpointIdx + 1;  i < p.numBreakpoints; ++i )
+    {
+        const int tgtSamp = voiceSample( bpSample[i] );
+        
+        sampleCounter += sampleDiff = tgtSamp - state.currentSamp;
+        
+        if (sampleCounter > samples)// if this breakpoint is longer...
+        {
+            // cropp it...
+            sampleDiff -= (sampleCounter - samples); // substract the overflowing number of samples to get max possible sample diff
+            sampleCounter = samples; // we can process max "samples" count
+        }
+        
+        //  if the current oscillator amplitude is
+        //  zero, and the target Breakpoint amplitude
+        //  is not, reset the oscillator phase so that
+        //  it matches exactly the target Breakpoint 
+        //  phase at tgtSamp:
+//        if ( m_osc.amplitude() == 0. && state.breakpointFinished )
+        if ( i == PartialStruct::NoBreakpointProcessed + 1 && state.breakpointFinished )
+        {
+            m_osc.setPhase( fixedPhase( p, state ) );
+        }
+        
+        double frequency = bp.frequency( i ), amplitude = bp.amplitude( i ), bandwidth = bp.bandwidth( i );
+        if ( isMorphing() )
+            morphBreakpoint( p.firstBreakpoint + i, morphWeight, frequency, amplitude, bandwidth );
+        if ( isHarmonifying() )
+            harmonifyBreakpoint( p, frequency );
+        if ( isModifying() )
+            modifyBreakpoint( bpSample[i], frequency, amplitude, bandwidth );
+        
+        int samplesToBp = tgtSamp - state.currentSamp;
+        m_osc.oscillate( buffer, buffer + sampleDiff, frequency, amplitude, bandwidth, m_srateHz, samplesToBp );
+
+		buffer += sampleDiff;// move buffer pointer
+        
+		state.currentSamp += sampleDiff;
+        state.breakpointFinished = tgtSamp == state.currentSamp;
+
+        if (state.breakpointFinished)
+        {
+            //  remember the frequency, may need it to reset the
+            //  phase if a Null Breakpoint is encountered:
+//            m_osc.resetEnvelopes(*bp, m_srateHz);
+//            state.prevFrequency = bp->frequency();
+            
+            state.prevFrequency = m_osc.envelopes().frequency();
+//                m_osc.setPhase(bp->phase());
+        }
+        
+        if (sampleCounter == samples)
+        {
+            // there is still something to be done in this break point, unless the
+            // block ends right at it (its phase must not be fixed again)
+            if ( ! state.breakpointFinished )
+                i--;
+            break;
+        }
+	}
+    
+    state.envelope = m_osc.envelopes();
+    state.lastBreakpointIdx = i;
+}
+
+// ---------------------------------------------------------------------------
+//  synthesizeLanes
+// ---------------------------------------------------------------------------
+//! Synthesize up to RealtimeOscillatorBank::NumLanes Partials at once,
+//! one Partial in each lane of the oscillator bank. The Partials must
+//! already be playing, so that all of them start at the beginning of
+//! the buffer.
+//!
+//! \param  indices Indices of the Partials to synthesize.
+//! \param  count   Number of indices, at most RealtimeOscillatorBank::NumLanes.
+//! \param  buffer  The samples buffer.
+//! \param  samples Number of samples to be synthesized.
+//! \param  factor  Lanes are computed every factor samples, see setMultiRate().
+//! \return Nothing.
+//! \pre    The buffer has to have capacity to contain all samples.
+void RealTimeSynthesizer::synthesizeLanes( const int * indices, int count, float * buffer, const int samples, int factor ) noexcept
+{
+    const PartialStruct * partials = bank->partials();
+    
+    for (int lane = 0; lane < RealtimeOscillatorBank::NumLanes; lane++)
+    {
+        LaneTarget & target = laneTargets[lane];
+        target.partial = lane < count ? indices[lane] : -1;
+        
+        if (target.partial < 0)
+        {
+            m_lanes.clearLane( lane );
+            continue;
+        }
+        
+        const PartialState & state = states[target.partial];
+        double gain = state.gain * outputGain;
+        double targetGain = state.targetGain * ( outputGain + samples * outputGainStep );
+        scaleBlockGains( target.partial, gain, targetGain );
+        m_lanes.setLaneGain( lane, gain, ( targetGain - gain ) / samples );
+        
+        if (0 == loadLane( lane, partials[target.partial], states[target.partial], 0 ))
+            target.partial = -1;
+    }
+    
+    int done = 0;
+    while (done < samples)
+    {
+        // run all lanes up to the nearest breakpoint of any of them
+        int n = samples - done;
+        int active = 0;
+        for (const LaneTarget & target : laneTargets)
+        {
+            if (target.partial < 0) continue;
+            n = std::min( n, target.remaining );
+            active++;
+        }
+        
+        if (active == 0)
+            break;
+        
+        m_lanes.oscillate( buffer + done, buffer + done + n, factor );
+        done += n;
+        
+        for (int lane = 0; lane < RealtimeOscillatorBank::NumLanes; lane++)
+        {
+            LaneTarget & target = laneTargets[lane];
+            if (target.partial < 0) continue;
+            
+            PartialState & state = states[target.partial];
+            state.currentSamp += n;
+            target.remaining -= n;
+            
+            if (target.remaining == 0)
+            {
+                // breakpoint reached, set the state to its target values exactly
+                state.envelope = Breakpoint( target.frequency, target.amplitude, target.bandwidth, m_lanes.phase( lane ) );
+                state.lastBreakpointIdx++;
+                state.breakpointFinished = true;
+                
+                if (0 == loadLane( lane, partials[target.partial], state, done ))
+                    target.partial = -1;
+            }
+        }
+    }
+    
+    // remember where the lanes are in unfinished segments
+    for (int lane = 0; lane < RealtimeOscillatorBank::NumLanes; lane++)
+    {
+        const LaneTarget & target = laneTargets[lane];
+        if (target.partial < 0) continue;
+        
+        PartialState & state = states[target.partial];
+        state.envelope = Breakpoint( m_lanes.frequency( lane ), m_lanes.amplitude( lane ), m_lanes.bandwidth( lane ), m_lanes.phase( lane ) );
+        state.breakpointFinished = false;
+    }
+    
+    // fades are done
+    for (int i = 0; i < count; i++)
+        states[indices[i]].gain = states[indices[i]].targetGain;
+}
+
+// ---------------------------------------------------------------------------
+//  synthesizeHarmonics
+// ---------------------------------------------------------------------------
+//! Synthesize harmonic Partials from the phase of the fundamental. Every
+//! Partial is followed by skip(), which interpolates its envelopes as the
+//! oscillator bank would, only its frequency is replaced by its harmonic
+//! of the fundamental. The block is split at the Breakpoints of all of them,
+//! so envelopes ramp linearly in between. The phase of a Partial at the
+//! block start is kept as the phase added to its harmonic and its phase at
+//! the end is set from it, so Partials move between the oscillators and
+//! this without a jump.
+void RealTimeSynthesizer::synthesizeHarmonics( const int * indices, int count, float * buffer, const int samples ) noexcept
+{
+    const PartialStruct * partials = bank->partials();
+    
+    // the fundamental is followed by a copy of its state unless it is rendered here
+    PartialState fundamentalCopy = states[harmonicFundamental];
+    PartialState * fundamental = &fundamentalCopy;
+    
+    harmonicLanes.clear();
+    for (int i = 0; i < count; i++)
+    {
+        const int idx = indices[i];
+        PartialState & state = states[idx];
+        if (idx == harmonicFundamental)
+            fundamental = &state;
+        
+        // phase at the fade in Breakpoint is fixed the way skip() fixes it
+        if ( state.lastBreakpointIdx == PartialStruct::NoBreakpointProcessed && state.breakpointFinished )
+            state.envelope.setPhase( fixedPhase( partials[idx], state ) );
+        
+        HarmonicLane lane;
+        lane.partial = idx;
+        lane.number = (*harmonicNumbers)[idx];
+        lane.phase = state.envelope.phase();
+        lane.gain = state.gain * outputGain;
+        double targetGain = state.targetGain * ( outputGain + samples * outputGainStep );
+        scaleBlockGains( idx, lane.gain, targetGain );
+        lane.gainStep = ( targetGain - lane.gain ) / samples;
+        harmonicLanes.push_back( lane );
+    }
+    std::sort( harmonicLanes.begin(), harmonicLanes.end(),
+               []( const HarmonicLane & a, const HarmonicLane & b ) { return a.number < b.number; } );
+    
+    harmonics.resize( harmonicLanes.size() );
+    for (std::size_t i = 0; i < harmonicLanes.size(); i++)
+    {
+        harmonics[i].number = harmonicLanes[i].number;
+        harmonics[i].phaseCos = (float) std::cos( harmonicLanes[i].phase );
+        harmonics[i].phaseSin = (float) std::sin( harmonicLanes[i].phase );
+    }
+    
+    // phase of the fundamental is counted from the block start
+    double phase = 0.;
+    for (int done = 0; done < samples;)
+    {
+        // up to the nearest Breakpoint of any Partial
+        int n = samples - done;
+        for (const HarmonicLane & lane : harmonicLanes)
+            n = std::min( n, samplesToBreakpoint( partials[lane.partial], states[lane.partial] ) );
+        n = std::max( std::min( n, samplesToBreakpoint( partials[harmonicFundamental], *fundamental ) ), 1 );
+        
+        const double frequency = fundamental->envelope.frequency();
+        for (std::size_t i = 0; i < harmonicLanes.size(); i++)
+        {
+            const HarmonicLane & lane = harmonicLanes[i];
+            PartialState & state = states[lane.partial];
+            const double amplitude = state.envelope.amplitude() * ( lane.gain + lane.gainStep * done );
+            skip( partials[lane.partial], state, n, done );
+            harmonics[i].amplitude = amplitude;
+            harmonics[i].dAmplitude = ( state.envelope.amplitude() * ( lane.gain + lane.gainStep * ( done + n ) ) - amplitude ) / n;
+        }
+        if (fundamental == &fundamentalCopy)
+            skip( partials[harmonicFundamental], fundamentalCopy, n, done );
+        
+        // harmonics above Nyquist anywhere in the segment are silent, as oscillators keep them
+        const double endFrequency = fundamental->envelope.frequency();
+        const double highest = std::max( frequency, endFrequency );
+        for (RealtimeHarmonics::Harmonic & harmonic : harmonics)
+            if ( harmonic.number * highest > Pi )
+                harmonic.amplitude = harmonic.dAmplitude = 0.;
+        
+        phase = RealtimeHarmonics::oscillate( buffer + done, buffer + done + n, phase, frequency,
+                                              ( endFrequency - frequency ) / n, harmonics.data(), (int) harmonics.size(),
+                                              m_lanes.instructions() );
+        done += n;
+    }
+    
+    // skip() advanced the phases by the frequencies of the Partials, they go on from
+    // their harmonics instead
+    for (const HarmonicLane & lane : harmonicLanes)
+    {
+        PartialState & state = states[lane.partial];
+        double end = lane.phase + lane.number * phase;
+        end -= 2 * Pi * std::floor( end * ( 0.5 / Pi ) );
+        state.envelope.setPhase( end );
+        state.gain = state.targetGain;
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  loadLane
+// ---------------------------------------------------------------------------
+//! Load the next Breakpoint segment of a playing Partial into a lane of
+//! the oscillator bank. Segments of zero length are skipped.
+//!
+//! \return Number of samples to the target Breakpoint, 0 if the Partial
+//!         has no more Breakpoints (the lane is silenced then).
+int RealTimeSynthesizer::loadLane( int lane, const PartialStruct &p, PartialState &state, int position ) noexcept
+{
+    for (int i = state.lastBreakpointIdx + 1; i < p.numBreakpoints; ++i)
+    {
+        if ( i == PartialStruct::NoBreakpointProcessed + 1 && state.breakpointFinished )
+            state.envelope.setPhase( fixedPhase( p, state ) );
+        
+        double tgtFrequency, tgtAmplitude, tgtBandwidth;
+        const int samplesToBp = breakpointTarget( p, i, tgtFrequency, tgtAmplitude, tgtBandwidth ) - state.currentSamp;
+        if (samplesToBp <= 0)
+        {
+            // nothing to render, oscillator state is kept as RealtimeOscillator does
+            state.lastBreakpointIdx = i;
+            state.breakpointFinished = true;
+            continue;
+        }
+        
+        LaneTarget & target = laneTargets[lane];
+        target.remaining = samplesToBp;
+        target.frequency = m_osc.frequencyScaling() * tgtFrequency * 2 * Pi * OneOverSrate;
+        target.amplitude = tgtAmplitude;
+        target.bandwidth = std::min( std::max( tgtBandwidth, 0. ), 1. );
+        
+        //  don't alias:
+        if ( target.frequency > Pi )
+            target.amplitude = 0.;
+        
+        double amplitude = state.envelope.amplitude();
+        if ( state.envelope.frequency() > Pi )
+            amplitude = 0.;
+        
+        const double dTime = 1. / samplesToBp;
+        double dFrequency = ( target.frequency - state.envelope.frequency() ) * dTime;
+        if ( blockScalingStep != 0. )
+        {
+            // head for the frequency at the Breakpoint or at the end of the block,
+            // whichever comes first, the lane is loaded again at both
+            const int n = std::min( samplesToBp, blockSamples - position );
+            const double unscaled = tgtFrequency * 2 * Pi * OneOverSrate;
+            const double frequency = glideFrequency( state.envelope.frequency(), unscaled, position, n, samplesToBp );
+            if ( n == samplesToBp )
+                target.frequency = frequency;
+            dFrequency = ( frequency - state.envelope.frequency() ) / n;
+        }
+        
+        m_lanes.setLane( lane, state.envelope.phase(), state.envelope.frequency(), amplitude,
+                         dFrequency,
+                         ( target.amplitude - amplitude ) * dTime,
+                         state.envelope.bandwidth(),
+                         ( target.bandwidth - state.envelope.bandwidth() ) * dTime );
+        return samplesToBp;
+    }
+    
+    m_lanes.clearLane( lane );
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+//  skip
+// ---------------------------------------------------------------------------
+//! Follow a playing Partial for a number of samples without rendering it:
+//! envelopes are interpolated and the phase is advanced exactly as the
+//! oscillator bank would do it, so the Partial can be rendered again later.
+//!
+//! \param  position Sample of the block the Partial is at, the glide of
+//!         frequency scaling and morph amount are followed from there.
+void RealTimeSynthesizer::skip( const PartialStruct &p, PartialState &state, int samples, int position ) noexcept
+{
+    for (int i = state.lastBreakpointIdx + 1; i < p.numBreakpoints && samples > 0; ++i)
+    {
+        if ( i == PartialStruct::NoBreakpointProcessed + 1 && state.breakpointFinished )
+            state.envelope.setPhase( fixedPhase( p, state ) );
+        
+        // same targets as loadLane()
+        double tgtFrequency, amplitude, bandwidth;
+        const int samplesToBp = breakpointTarget( p, i, tgtFrequency, amplitude, bandwidth ) - state.currentSamp;
+        const int n = std::max( std::min( samplesToBp, samples ), 0 );
+        double frequency = m_osc.frequencyScaling() * tgtFrequency * 2 * Pi * OneOverSrate;
+        if ( frequency > Pi )
+            amplitude = 0.;
+        bandwidth = std::min( std::max( bandwidth, 0. ), 1. );
+        
+        const double startFrequency = state.envelope.frequency();
+        if (n < samplesToBp)
+        {
+            // stop inside the segment
+            const double x = (double) n / samplesToBp;
+            frequency = startFrequency + ( frequency - startFrequency ) * x;
+            amplitude = state.envelope.amplitude() + ( amplitude - state.envelope.amplitude() ) * x;
+            bandwidth = state.envelope.bandwidth() + ( bandwidth - state.envelope.bandwidth() ) * x;
+        }
+        if ( blockScalingStep != 0. && n > 0 )
+            frequency = glideFrequency( startFrequency, tgtFrequency * 2 * Pi * OneOverSrate, position, n, samplesToBp );
+        position += n;
+        
+        // phase advances by the average frequency of every sample, it is
+        // wrapped without fmod, which costs more than the rest of the segment
+        double phase = state.envelope.phase() + 0.5 * n * ( startFrequency + frequency );
+        phase -= 2 * Pi * std::floor( phase * ( 0.5 / Pi ) );
+        state.envelope = Breakpoint( frequency, amplitude, bandwidth, phase );
+        state.currentSamp += n;
+        samples -= n;
+        
+        state.breakpointFinished = n >= samplesToBp;
+        if ( ! state.breakpointFinished )
+            break;
+        state.lastBreakpointIdx = i;
+    }
+}
+
+// ---------------------------------------------------------------------------
+//  breakpointTarget
+// ---------------------------------------------------------------------------
+//! Return the sample of a Breakpoint of a playing Partial in time of this
+//! synthesizer, and its frequency (Hz, not scaled), amplitude and bandwidth
+//! morphed and modified. Breakpoints are morphed by the amount at their
+//! sample in the block being synthesized. The target is taken from the
+//! EnvelopeFrame if a synthesizer playing the bank the same way evaluated
+//! it in the block, and left there for the others otherwise.
+//!
+//! \param  i Index of the Breakpoint in the Partial.
+int RealTimeSynthesizer::breakpointTarget( const PartialStruct &p, int i, double & frequency, double & amplitude, double & bandwidth ) noexcept
+{
+    const int b = p.firstBreakpoint + i;
+    EnvelopeFrame::Target * target = nullptr;
+    if ( envelopeFrame )
+    {
+        target = &envelopeFrame->entry( b );
+        if ( envelopeFrame->holds( *target, b ) )
+        {
+            frequency = target->frequency;
+            amplitude = target->amplitude;
+            bandwidth = target->bandwidth;
+            return target->sample;
+        }
+    }
+    
+    const BreakpointArrays & bp = bank->breakpoints();
+    const int bankSample = bank->breakpointSamples()[b];
+    const int sample = voiceSample( bankSample );
+    frequency = bp.frequency( b );
+    amplitude = bp.amplitude( b );
+    bandwidth = bp.bandwidth( b );
+    if ( isMorphing() )
+        morphBreakpoint( b, morphAt( sample - ( processedSamples - blockSamples ) ), frequency, amplitude, bandwidth );
+    if ( isHarmonifying() )
+        harmonifyBreakpoint( p, frequency );
+    if ( isModifying() )
+        modifyBreakpoint( bankSample, frequency, amplitude, bandwidth );
+    if ( amplitude < MinAmplitude )
+        amplitude = 0.;
+    
+    if ( target )
+    {
+        envelopeFrame->stamp( *target, b );
+        target->sample = sample;
+        target->frequency = frequency;
+        target->amplitude = amplitude;
+        target->bandwidth = bandwidth;
+    }
+    return sample;
+}
+
+// ---------------------------------------------------------------------------
+//  envelopeKey
+// ---------------------------------------------------------------------------
+//! Return what Breakpoint targets of the block being synthesized depend on,
+//! see EnvelopeFrame.
+//!
+//! \param  samples Number of samples of the block.
+EnvelopeFrame::Key RealTimeSynthesizer::envelopeKey( int samples ) const noexcept
+{
+    EnvelopeFrame::Key key;
+    key.bank = bank.get();
+    key.morph = isMorphing() ? morph.get() : nullptr;
+    key.blockStart = processedSamples - samples;
+    key.blockSamples = samples;
+    key.originSample = originSample;
+    key.originBankSample = originBankSample;
+    key.timeStretch = timeStretch;
+    if ( key.morph )
+    {
+        key.morph0 = blockMorph;
+        key.morphStep = blockMorphStep;
+    }
+    if ( isModifying() )
+    {
+        key.amplitudeScale = m_modifiers.amplitudeScale;
+        key.tiltExponent = tiltExponent;
+        key.bandwidthScale = m_modifiers.bandwidthScale;
+        key.noiseRatioScale = m_modifiers.noiseRatioScale;
+        key.cropStartSample = m_modifiers.hasCrop() ? cropStartSample : 0;
+        key.cropEndSample = m_modifiers.hasCrop() ? cropEndSample : -1;
+    }
+    if ( isHarmonifying() )
+    {
+        key.harmonify = m_modifiers.harmonify;
+        key.fundamental = blockFundamental;
+    }
+    return key;
+}
+
+// ---------------------------------------------------------------------------
+//  glideFrequency
+// ---------------------------------------------------------------------------
+//! Return the frequency a Partial has after n samples from the sample
+//! position of the block, while frequency scaling glides over the block.
+//! The unscaled frequency moves linearly to the Breakpoint, the scaling
+//! linearly over the block, the frequency is their product at both ends.
+//!
+//! \param  frequency Frequency at position (radians per sample, scaled).
+//! \param  target Frequency of the Breakpoint (radians per sample, not scaled).
+//! \param  position Sample of the block.
+//! \param  n Number of samples, at most samplesToBp.
+//! \param  samplesToBp Samples from position to the Breakpoint.
+//! \return Frequency after n samples (radians per sample, scaled).
+double RealTimeSynthesizer::glideFrequency( double frequency, double target, int position, int n, int samplesToBp ) const noexcept
+{
+    const double unscaled = frequency / scalingAt( position );
+    return scalingAt( position + n ) * ( unscaled + ( target - unscaled ) * n / samplesToBp );
+}
+
+// ---------------------------------------------------------------------------
+//  selectPartials
+// ---------------------------------------------------------------------------
+//! Set the target gain of every playing Partial for the next block and
+//! move the Partials that need to be rendered to the front of
+//! partialsBeingProcessed.
+//!
+//! \return Number of Partials to be rendered, the others are skipped.
+int RealTimeSynthesizer::selectPartials() noexcept
+{
+    int * active = partialsBeingProcessed.data();
+    int * end = active + numPartialsBeingProcessed;
+    int * loudest = end;
+    
+    if (maxPartialsRendered > 0 && numPartialsBeingProcessed > maxPartialsRendered)
+    {
+        // the loudest partials first, nth_element does not allocate
+        loudest = active + maxPartialsRendered;
+        std::nth_element( active, loudest, end,
+                          [this]( int a, int b ) { return loudness( a ) > loudness( b ); } );
+    }
+    
+    for (int * it = active; it != end; ++it)
+    {
+        PartialState & state = states[*it];
+        state.targetGain = it < loudest ? 1.f : 0.f;
+        
+        // crossfade after the loop wrapped
+        if ( state.loopFade < 0 )
+            state.targetGain *= loopFadeEnd;
+        else if ( state.loopFade > 0 )
+            state.targetGain *= 1.f - loopFadeEnd;
+    }
+    
+    // silent partials staying silent are not rendered
+    int * rendered = std::partition( active, end, [this]( int idx )
+        {
+            return states[idx].gain > 0.f || states[idx].targetGain > 0.f;
+        } );
+    return (int) ( rendered - active );
+}
+
+// ---------------------------------------------------------------------------
+//  loudness
+// ---------------------------------------------------------------------------
+//! Return the amplitude a Partial is ranked by when the number of
+//! Partials rendered is limited.
+double RealTimeSynthesizer::loudness( int idx ) const noexcept
+{
+    const PartialStruct & p = bank->partials()[idx];
+    const PartialState & state = states[idx];
+    
+    // partials fading in are ranked by the amplitude they are heading to
+    double amplitude = state.envelope.amplitude();
+    const int next = state.lastBreakpointIdx + 1;
+    if (next < p.numBreakpoints)
+    {
+        const int b = p.firstBreakpoint + next;
+        double target = bank->breakpoints().amplitude( b );
+        if ( isMorphing() )
+            target += morphWeight * ( morph->amplitudes()[b] - target );
+        if ( isModifying() )
+        {
+            double bandwidth = 0.;
+            modifyBreakpoint( bank->breakpointSamples()[b], bank->breakpoints().frequency( b ), target, bandwidth );
+        }
+        amplitude = std::max( amplitude, target );
+    }
+    return amplitude;
+}
+
+// ---------------------------------------------------------------------------
+//  setMaxPartials
+// ---------------------------------------------------------------------------
+//! Set the largest number of partials rendered at once, 0 (default) for
+//! no limit. When more partials are playing, only the loudest ones are
+//! rendered, the others fade out during the next block and are followed
+//! only, until they are loud enough to fade back in.
+//!
+//! \param  count Largest number of partials rendered, 0 for all.
+//! \return Nothing.
+void RealTimeSynthesizer::setMaxPartials(int count) noexcept
+{
+    maxPartialsRendered = std::max( count, 0 );
+}
+
+// ---------------------------------------------------------------------------
+//  fixedPhase
+// ---------------------------------------------------------------------------
+//! Compute the phase a Partial has to start with at the fade in Breakpoint
+//! so that it matches exactly the phase of the first Breakpoint. Partials
+//! of phase-free banks have no phase to match, they start scattered.
+double RealTimeSynthesizer::fixedPhase( const PartialStruct &p, const PartialState &state ) const noexcept
+{
+    if ( bank->isPhaseFree() )
+        return scatteredPhase( p );
+    
+    const int i = PartialStruct::NoBreakpointProcessed + 1;
+    const int tgtSamp = voiceSample( bank->breakpointSamples()[p.firstBreakpoint + i] );
+    const float frequency = bank->breakpoints().frequency( p.firstBreakpoint + i );
+    
+    //  recompute the phase so that it is correct
+    //  at the target Breakpoint (need to do this
+    //  because the null Breakpoint phase was computed
+    //  from an interval in seconds, not samples, so
+    //  it might be inaccurate):
+    //
+    //  double favg = 0.5 * ( prevFrequency + it.breakpoint().frequency() );
+    //  double dphase = 2 * Pi * favg * ( tgtSamp - currentSamp ) / m_srateHz;
+    
+    double dphase = Pi * ( state.prevFrequency + m_osc.frequencyScaling() * frequency ) * ( tgtSamp - state.currentSamp ) * OneOverSrate;
+    
+    // If we transposed/pitch-shifted the sound using sample rate change, the transpose octave above would
+    // mean create new signal with every second sample missing, so the partial would start earlier. If we
+    // would like to have partial transposed but in the same time t0 as original,  what the new phase will be?
+    // It will be the original phase with the phase change during the delta of time. What delta of time is it?
+    // The start time in sample-removing pitch shifted signal would be half of time if we transpose octave up so the
+    // delta time is t0 - t0/transposeFactor. So the new phase goes like this (here we do not have time t0 so we get
+    // it from partial[iSamp]/float(fs)).
+    // Played at other rate, the partial starts at other time than in the bank, its phase goes on from
+    // there at the scaled frequency: the phase change is f*(scaling*t1 - t0) for start t0 in the bank
+    // and t1 in this synthesizer, the ratio is 1 at original rate.
+    double phaseFixed = firstPhase( p, state.currentSamp + seekSamples );
+    
+    return phaseFixed - dphase;
+}
+
+// ---------------------------------------------------------------------------
+//  firstPhase
+// ---------------------------------------------------------------------------
+//! Return the phase a Partial has at its first Breakpoint when it starts
+//! at a sample of this synthesizer, counted from the beginning of the sound.
+double RealTimeSynthesizer::firstPhase( const PartialStruct &p, int startSample ) const noexcept
+{
+    const float phase = bank->breakpoints().phase( p.firstBreakpoint + PartialStruct::NoBreakpointProcessed + 1 );
     
-    p.state.envelope = m_osc.envelopes();
-    p.state.lastBreakpointIdx = i;
+    const double startRatio = startSample != 0 ? (double) p.startSample / startSample : 1.;
+    return (phase + 2*Pi*p.avgFrequency*startSample*OneOverSrate*(m_osc.frequencyScaling()-startRatio));
 }
     
 }   //  end of namespace Loris
@@ -35,9 +35,16 @@
  
 #include "Synthesizer.h"
 #include "RealtimeOscillator.h"
+#include "RealtimeSpectralBank.h"
+#include "PartialBank.h"
+#include "NoiseBands.h"
+#include "PartialFilter.h"
+#include "PartialGains.h"
+#include "SpectralSurface.h"
 
+#include <algorithm>
+#include <limits>
 #include <vector>
-#include <queue>
 #include <cmath>
 
 #if defined(HAVE_M_PI) && (HAVE_M_PI)
@@ -48,29 +55,179 @@ const double Pi = 3.14159265358979324;
 
 //	begin namespace
 namespace Loris {
-// Using this struct because iterating over partials and especially Breakpoint is very
-// expensive. So I wrote this data container.
-struct PartialStruct
+// Per synthesizer playback state of one PartialStruct of a PartialBank.
+struct PartialState
 {
-    enum { NoBreakpointProcessed = 0, FirstBreakpoint };
-    
-    double startTime = 0.0;
-    double endTime = 0.0;
-    int numBreakpoints = 0;
-    int label = 0;
-    float avgFrequency = 0;
+    int currentSamp = 0;
+    int lastBreakpointIdx = PartialStruct::NoBreakpointProcessed;
+    Breakpoint envelope;
+    double prevFrequency;
+    bool breakpointFinished = true;
+    float gain = 1.f;           // gain at the beginning of the block
+    float targetGain = 1.f;     // gain at the end of the block, 0 fades the partial out
+    int loopFade = 0;           // -1 fading out after the loop wrapped, 1 fading in, 0 none
+    float filterGain = 1.f;     // gain of the PartialFilter at the end of the last block
+    float editGain = 1.f;       // gain of the PartialGains at the end of the last block
+    float surfaceGain = 1.f;    // gain of the SpectralSurface at the end of the last block
+};
 
-    std::vector<std::pair<double, Breakpoint>> breakpoints;
+// ---------------------------------------------------------------------------
+//	struct PartialModifiers
+//
+//! Render-time counterparts of the PartialUtils operations that rewrite
+//! every Breakpoint of a PartialList (scaleAmplitude, scaleBandwidth,
+//! scaleNoiseRatio, scaleFrequency, shiftPitch and crop), of Harmonifier,
+//! and a spectral tilt. A RealTimeSynthesizer applies them to the Breakpoints as they
+//! are reached, the shared bank is not touched, so they can change at any
+//! block without rebuilding anything.
+//
+struct PartialModifiers
+{
+    double amplitudeScale = 1.;     // scales amplitudes, like PartialUtils::scaleAmplitude()
+    double spectralTilt = 0.;       // dB per octave above the pitch of the sound
+    double bandwidthScale = 1.;     // scales bandwidths, like PartialUtils::scaleBandwidth()
+    double noiseRatioScale = 1.;    // scales noise to sinusoidal energy ratios,
+                                    // like PartialUtils::scaleNoiseRatio()
+    double frequencyScale = 1.;     // scales frequencies, like PartialUtils::scaleFrequency()
+    double pitchShift = 0.;         // cents, like PartialUtils::shiftPitch()
+    double harmonify = 0.;          // blends frequencies toward their label times the
+                                    // fundamental, like Harmonifier weighted by it
+    double cropStart = 0.;          // seconds of the sound Partials are heard in, like
+    double cropEnd = 0.;            // PartialUtils::crop(), no crop unless end is after start
+    
+    //! Return true if Partials are heard only between cropStart and cropEnd.
+    bool hasCrop() const noexcept { return cropEnd > cropStart; }
     
-    struct SynthesizerState
+    //! Return the ratio frequencies are scaled by.
+    double frequencyRatio() const noexcept { return frequencyScale * std::pow( 2., pitchShift / 1200. ); }
+    
+    //! Return true if amplitudes and bandwidths are not changed.
+    bool isEnvelopeIdentity() const noexcept
     {
-        int currentSamp = 0;
-        int lastBreakpointIdx = NoBreakpointProcessed;
-        Breakpoint envelope;
-        double prevFrequency;
-        bool breakpointFinished = true;
-    } state;
+        return amplitudeScale == 1. && spectralTilt == 0. && bandwidthScale == 1. && noiseRatioScale == 1.
+               && ! hasCrop();
+    }
+    
+    //! Return true if nothing is changed.
+    bool isIdentity() const noexcept
+    {
+        return isEnvelopeIdentity() && frequencyScale == 1. && pitchShift == 0. && harmonify == 0.;
+    }
+};
+
+// ---------------------------------------------------------------------------
+//	class EnvelopeFrame
+//
+//! Breakpoint targets of a PartialBank evaluated for one block, shared by
+//! RealTimeSynthesizers playing the bank the same way (the notes of a
+//! chord struck together). The target of a Breakpoint (its sample, and
+//! its frequency, amplitude and bandwidth after morphing and modifiers)
+//! depends on the timing, morph and modifiers of a synthesizer, but not
+//! on its pitch, which is applied to the frequency afterwards. The first
+//! synthesizer reaching a Breakpoint in a block evaluates it, the others
+//! with the same Key find it here and only scale its frequency.
+//!
+//! Targets are kept in a table indexed by Breakpoint, direct mapped: a
+//! Breakpoint whose entry was taken by another one is evaluated again, so
+//! the table never fills up. A frame is not locked, synthesizers sharing
+//! it must render their blocks one after another, on one thread.
+//
+class EnvelopeFrame
+{
+public:
+    //! Everything the targets of a block depend on, synthesizers with an
+    //! equal key evaluate every Breakpoint the same way.
+    struct Key
+    {
+        const PartialBank * bank = nullptr;
+        const PartialMorph * morph = nullptr;
+        int blockStart = 0;             // sample of the synthesizer the block starts at
+        int blockSamples = 0;
+        int originSample = 0;           // mapping of Breakpoint samples, see setPlaybackRate()
+        double originBankSample = 0.;
+        double timeStretch = 1.;
+        double morph0 = 0.;             // morph amount at the block start,
+        double morphStep = 0.;          // and its increment per sample
+        double amplitudeScale = 1.;     // envelope modifiers
+        double tiltExponent = 0.;
+        double bandwidthScale = 1.;
+        double noiseRatioScale = 1.;
+        int cropStartSample = 0;
+        int cropEndSample = 0;
+        double harmonify = 0.;          // harmonify amount of the modifiers,
+        double fundamental = 0.;        // and the frequency of the fundamental
+
+        bool operator==( const Key & other ) const noexcept
+        {
+            return bank == other.bank && morph == other.morph && blockStart == other.blockStart
+                   && blockSamples == other.blockSamples && originSample == other.originSample
+                   && originBankSample == other.originBankSample && timeStretch == other.timeStretch
+                   && morph0 == other.morph0 && morphStep == other.morphStep
+                   && amplitudeScale == other.amplitudeScale && tiltExponent == other.tiltExponent
+                   && bandwidthScale == other.bandwidthScale && noiseRatioScale == other.noiseRatioScale
+                   && cropStartSample == other.cropStartSample && cropEndSample == other.cropEndSample
+                   && harmonify == other.harmonify && fundamental == other.fundamental;
+        }
+    };
+
+    //! Target of a Breakpoint, frequency in Hz and not scaled.
+    struct Target
+    {
+        int breakpoint = -1;    // index in the arrays of the bank
+        unsigned stamp = 0;     // block it was evaluated in
+        int sample = 0;         // in time of the synthesizers
+        double frequency = 0.;
+        double amplitude = 0.;
+        double bandwidth = 0.;
+    };
+
+    //! Construct a frame of a number of entries, rounded up to a power of two.
+    explicit EnvelopeFrame( int capacity = DefaultCapacity )
+    {
+        int size = 1;
+        while ( size < capacity )
+            size <<= 1;
+        m_targets.resize( size );
+        m_mask = size - 1;
+    }
+
+    //! Start a block, targets evaluated for another key are forgotten.
+    void begin( const Key & key ) noexcept
+    {
+        if ( ! ( key == m_key ) )
+        {
+            m_key = key;
+            ++m_stamp;
+        }
+    }
+
+    //! Return the entry of a Breakpoint, see holds().
+    Target & entry( int breakpoint ) noexcept { return m_targets[breakpoint & m_mask]; }
+
+    //! Return true if an entry holds a Breakpoint evaluated in this block.
+    bool holds( const Target & target, int breakpoint ) const noexcept
+    {
+        return target.breakpoint == breakpoint && target.stamp == m_stamp;
+    }
+
+    //! Mark an entry as holding a Breakpoint evaluated in this block.
+    void stamp( Target & target, int breakpoint ) const noexcept
+    {
+        target.breakpoint = breakpoint;
+        target.stamp = m_stamp;
+    }
+
+    //! Default number of entries, a few Breakpoints of every Partial
+    //! playing in a block of dense banks.
+    enum { DefaultCapacity = 2048 };
+
+private:
+    std::vector<Target> m_targets;
+    int m_mask = 0;
+    Key m_key;
+    unsigned m_stamp = 0;
 };
+
 // ---------------------------------------------------------------------------
 //	class RealTimeSynthesizer
 //
@@ -122,15 +279,138 @@ public:
     //!         by given partials.
     void setup(PartialList & partials, double pitch) noexcept;
 
+    //!	Prepare internal structures for synthesis of a shared PartialBank.
+    //! The bank is not copied, only the playback state for each of its
+    //! partials is allocated. reset() is also called. Previous data is overwritten.
+    //!
+    //! \param  bank The prepared Partials to synthesize.
+    //! \return Nothing.
+    //! \pre    The bank was built for the sample rate of this synthesizer.
+    //! \post   This RealTimeSynthesizer's is ready for synthesise the sound specified
+    //!         by given bank.
+    void setup(PartialBank::Ptr bank) noexcept;
+    
+    //!	Prepare for synthesis of what another synthesizer was set up with:
+    //! its bank, morph, noise bands and loop, at its sample rate. What
+    //! setup() and setLoop() derived from the bank (harmonic Partials, loop
+    //! entries) is shared, not computed again, only the playback state is
+    //! allocated, so voices playing one bank are set up at the cost of one.
+    //! reset() is also called.
+    //!
+    //! \param  prepared A synthesizer set up with a bank, it may be
+    //!         destroyed afterwards.
+    //! \return Nothing.
+    void setup(const RealTimeSynthesizer & prepared) noexcept;
+    
+    //! Statistics of the bank set up and the cost of playing it, so that
+    //! analysis and pruning settings can be compared by their CPU and
+    //! memory use. Counts of Partials include the ones above Nyquist and
+    //! are not limited by setMaxPartials().
+    struct Statistics
+    {
+        std::size_t numPartials = 0;
+        std::size_t numBreakpoints = 0;         // including fade Breakpoints
+        std::size_t maxConcurrentPartials = 0;  // most Partials sounding at once
+        double meanConcurrentPartials = 0.;     // Partials sounding on average over the sound
+        double duration = 0.;                   // seconds, see duration()
+        double peakPartialSamples = 0.;         // oscillator samples per second at the peak,
+        double meanPartialSamples = 0.;         // and on average, at the sample rate
+        std::size_t bankBytes = 0;              // shared bank, see PartialBank::imageSize()
+        std::size_t stateBytes = 0;             // playback state of this synthesizer
+    };
+    
+    //! Return statistics of the bank set up, computed by setup(). The
+    //! playback state includes the loop entries of setLoop().
+    //!
+    //! \return Statistics, all zero if no bank was set up.
+    Statistics statistics() const noexcept;
+    
+    //!	Set the morph target of the bank, see setMorphAmount(). Setting up
+    //! the bank clears it. Do not call it while synthesizing.
+    //!
+    //! \param  morph Morph built for the bank set up, empty for none.
+    //! \return Nothing.
+    void setMorph(PartialMorph::Ptr morph) noexcept { this->morph = morph; }
+    
+    //!	Set how far the Partials are morphed to the morph target, 0 (default)
+    //! plays the bank, 1 the target. Frequency, amplitude and bandwidth of
+    //! every Breakpoint are interpolated as the Breakpoint is reached, so the
+    //! amount can change at any block and playing Partials glide to it over
+    //! their current Breakpoint segment. Nothing in the shared bank is touched.
+    //!
+    //! \param  amount Part of the way to the target, from 0 to 1.
+    //! \return Nothing.
+    void setMorphAmount(double amount) noexcept
+    {
+        morphWeight = std::max( 0., std::min( 1., amount ) );
+        glideMorph = -1.;
+    }
+    
+    //!	Change the morph amount smoothly during the next synthesized block,
+    //! like glidePitch() does with pitch. The amount ramps linearly over the
+    //! block, Breakpoints reached in it are morphed by the amount at their
+    //! sample (or at the end of the block, for the ones beyond it).
+    //!
+    //! \param  amount Part of the way to the target at the end of the next
+    //!         block, from 0 to 1.
+    //! \return Nothing.
+    void glideMorphAmount(double amount) noexcept { glideMorph = std::max( 0., std::min( 1., amount ) ); }
+    
+    //! Return how far the Partials are morphed to the morph target (at the
+    //! end of the block synthesized last, when gliding).
+    double morphAmount() const noexcept { return morphWeight; }
+    
+    //!	Set loop of the sound, for sustained notes of short samples. When
+    //! the sound reaches the loop end, it goes on from the loop start:
+    //! Partials playing at both continue with their phase, the others
+    //! crossfade, the ones playing at the end fade out, the ones playing
+    //! at the start fade in from the state precomputed here. Nothing is
+    //! searched when the loop wraps. Setting up the bank clears the loop.
+    //! Do not call it while synthesizing, it allocates.
+    //!
+    //! \param  startTime Loop start in seconds (time of the Partials).
+    //! \param  endTime Loop end in seconds, no loop if it is not after start.
+    //! \param  fadeTime Crossfade of Partials not playing at both ends in seconds,
+    //!         at most half of the loop.
+    //! \return Nothing.
+    //! \pre    The bank is set up.
+    void setLoop(double startTime, double endTime, double fadeTime = DefaultLoopFadeTime);
+    
+    //!	Remove loop of the sound, see setLoop().
+    void clearLoop() noexcept;
+    
+    //! Return true if the sound has a loop.
+    bool hasLoop() const noexcept { return loopEndSample > loopStartSample; }
+    
+    //!	Enable or disable wrapping at the loop end (enabled by default), for
+    //! sustain loops: a released note plays the rest of the sound. It is kept
+    //! by reset() and setLoop().
+    //!
+    //! \param  enable Wrap when the loop end is reached.
+    //! \return Nothing.
+    void setLooping(bool enable) noexcept { looping = enable; }
+    
+    //! Return true if the sound wraps at the loop end.
+    bool isLooping() const noexcept { return looping; }
+
     //!	Set sample rate.
     //!
     //! \param  rate new sample rate
     //! \return Nothing.
     void setSampleRate(double rate) override;
     
-    //!	Synthesize next block of samples of the partials. The synthesizer
-    //! will resize the inner buffer as necessary. Previous contents of the buffer
-    //! are overwritten.
+    //!	Size the inner buffer for blocks of up to maximumBlockSize samples,
+    //! so that synthesizeNext(int) does not allocate, and the samples the
+    //! output is delayed by (see latency()), which are cleared. Do not call
+    //! it while synthesizing.
+    //!
+    //! \param  maximumBlockSize Largest number of samples synthesized at once.
+    //! \return Nothing.
+    void prepare(int maximumBlockSize);
+    
+    //!	Synthesize next block of samples of the partials into the inner
+    //! buffer. Only the first samples of the buffer are overwritten, the
+    //! buffer is resized (allocated) only if it is shorter, see prepare().
     //!
     //! \param  sample Number of samples to synthesize.
     //! \return Nothing.
@@ -138,11 +418,60 @@ public:
     //!         next block of samples starting at 'previous count of samples' + samples.
     void synthesizeNext(int samples) noexcept;
     
-    //!	Reset RealtimeSynthesizer to render sound from the beging.
+    //!	Synthesize next block of samples of the partials and accumulate them
+    //! into the given samples, instead of the inner buffer. The samples are
+    //! multiplied by a gain ramping linearly from gain to targetGain over the
+    //! block, it is folded into the partial amplitudes so no pass over the
+    //! samples is added. The ramp of partials faded out by setMaxPartials()
+    //! is multiplied by it at both ends of the block.
     //!
+    //! \param  output  The samples to accumulate into, at least samples long.
+    //! \param  samples Number of samples to synthesize.
+    //! \param  gain    Gain at the beginning of the block.
+    //! \param  targetGain Gain at the end of the block.
+    //! \return Nothing.
+    //! \post   Internal state of synthesizer changes - it is ready to synthesize
+    //!         next block of samples starting at 'previous count of samples' + samples.
+    void synthesizeNext(float * output, int samples, double gain = 1., double targetGain = 1.) noexcept;
+    
+    //!	Synthesize next block of samples of the partials like
+    //! synthesizeNext(float *, int, double, double), accumulating each
+    //! Partial into the output of its channel (see PartialStruct::channel()).
+    //! Partials of a channel are rendered together, so a stereo bank costs
+    //! the same as a mono one. Outputs may be the same samples.
+    //!
+    //! \param  outputs PartialStruct::NumChannels pointers to the samples
+    //!         to accumulate into, each at least samples long.
+    //! \param  samples Number of samples to synthesize.
+    //! \param  gain    Gain at the beginning of the block.
+    //! \param  targetGain Gain at the end of the block.
+    //! \return Nothing.
+    void synthesizeNext(float * const * outputs, int samples, double gain = 1., double targetGain = 1.) noexcept;
+    
+    //! Return true if the Partials are not all in the Center channel.
+    bool isStereo() const noexcept { return bank && bank->isStereo(); }
+    
+    //! Return the bank set up, nullptr if there is none.
+    const PartialBank * partialBank() const noexcept { return bank.get(); }
+    
+    //! Return the sample of the bank played now, so its Breakpoints can
+    //! be read ahead (see PartialBank::breakpointWindow()).
+    int bankSample() const noexcept { return (int) bankPosition(); }
+    
+    //!	Reset RealtimeSynthesizer to render sound from the beging, or from
+    //! any time of it. Partials playing at that time enter it with the state
+    //! they have there, computed from the nearest checkpoint of the bank
+    //! (see PartialBank::checkpointPartials()), so they fade in over the
+    //! fade time of the bank without synthesizing the sound before it.
+    //!
+    //! \param  startOffset Number of samples of the next synthesized blocks
+    //!         preceding the beginning of the sound, so that a note can start
+    //!         at any sample of a block without splitting it.
+    //! \param  startTime Time of the sound (of the Partials) in seconds the
+    //!         rendering starts at, 0 for the beginning.
     //! \post   Sound is rendered in original pitch.
     //! \return Nothing.
-    void reset() noexcept;
+    void reset(int startOffset = 0, double startTime = 0.) noexcept;
     
     //!	Change pitch of sound.
     //!
@@ -150,43 +479,813 @@ public:
     //! \return Nothing.
     void setPitch(double frequency) noexcept;
     
+    //!	Change pitch of sound smoothly during the next synthesized block, for
+    //! pitch bend and vibrato. The frequency scaling ramps linearly over the
+    //! block inside the oscillators, every playing partial follows it exactly
+    //! at Breakpoints and at the end of the block. Only the playback state of
+    //! this synthesizer is changed, the shared bank is not.
+    //!
+    //! \param  New pitch in frequency of the sound at the end of the next block.
+    //! \return Nothing.
+    void glidePitch(double frequency) noexcept;
+    
+    //!	Set the brightness of the Partials, for per-note expression: every
+    //! Partial is scaled by a gain of dBPerOctave per octave of its average
+    //! frequency above the pitch of the sound. Unlike the spectral tilt of
+    //! PartialModifiers, which is applied to Breakpoints as they are
+    //! reached, the gain is folded into the gain of the Partial ramped over
+    //! each block, so it follows the expression at once and costs a gain
+    //! per Partial per block, nothing per sample.
+    //!
+    //! \param  dBPerOctave Tilt of the Partials, 0 (default) for none.
+    //! \return Nothing.
+    void setBrightness(double dBPerOctave) noexcept
+    {
+        brightnessExponent = dBPerOctave * std::log2( 10. ) / 20.;
+        brightnessGliding = false;
+    }
+    
+    //!	Change the brightness smoothly during the next synthesized block,
+    //! like glidePitch() does with pitch: gains of the Partials ramp
+    //! linearly over the block to the brightness at its end.
+    //!
+    //! \param  dBPerOctave Tilt of the Partials at the end of the next block.
+    //! \return Nothing.
+    void glideBrightness(double dBPerOctave) noexcept
+    {
+        glideBrightnessExponent = dBPerOctave * std::log2( 10. ) / 20.;
+        brightnessGliding = true;
+    }
+    
+    //! Return the brightness of the Partials in dB per octave (at the end
+    //! of the block synthesized last, when gliding).
+    double brightness() const noexcept { return brightnessExponent * 20. / std::log2( 10. ); }
+    
+    //!	Set the equalizer of the Partials, see PartialFilter. Every Partial
+    //! is scaled by the gain of the filter at the frequency it sounds at,
+    //! looked up at every block and ramped over it with the gain of the
+    //! Partial, so the filter follows pitch and glides without filtering
+    //! any samples. The curve is in Hz, transposed notes keep its formants.
+    //!
+    //! \param  filter The filter, nullptr (default) for none. It is not
+    //!         copied, it must not change or be destroyed while it is set.
+    //! \return Nothing.
+    void setPartialFilter(const PartialFilter * filter) noexcept { m_filter = filter && ! filter->isFlat() ? filter : nullptr; }
+    
+    //!	Set the gains of single Partials of the bank, see PartialGains.
+    //! Every Partial is scaled by its gain, looked up at every block and
+    //! ramped over it with the gain of the Partial, so Partials muted or
+    //! changed in level are heard so from the next block on, without
+    //! preparing the bank again.
+    //!
+    //! \param  gains The gains, nullptr (default) for none. Gains of
+    //!         another bank are ignored. They are not copied, they must
+    //!         not change or be destroyed while they are set.
+    //! \return Nothing.
+    void setPartialGains(const PartialGains * gains) noexcept
+    {
+        m_gains = gains && bank && gains->appliesTo( *bank ) && ! gains->isIdentity() ? gains : nullptr;
+    }
+    
+    //!	Set the spectral surface the Partials are cross-synthesized with, see
+    //! SpectralSurface. Every Partial is scaled by the amplitude of the
+    //! surface at the time of the bank and the frequency the Partial sounds
+    //! at, looked up in its grid at every block and ramped over it with the
+    //! gain of the Partial, like SpectralSurface::scaleAmplitudes() does
+    //! offline. The stretch and effect of the surface are those set here,
+    //! not its own ones, so they can change at any block.
+    //!
+    //! \param  surface The surface, nullptr (default) for none. Surfaces
+    //!         not sampled into a grid are ignored. It is not copied, it
+    //!         must not change or be destroyed while it is set.
+    //! \return Nothing.
+    void setSpectralSurface(const SpectralSurface * surface) noexcept { m_surface = surface && surface->hasGrid() ? surface : nullptr; }
+    
+    //!	Set the amount of cross-synthesis with the spectral surface, from 0
+    //! (default, Partials are not changed) to 1 (Partials are scaled by the
+    //! surface), see setSpectralSurface().
+    //!
+    //! \param  effect The amount, clamped to 0 to 1.
+    //! \return Nothing.
+    void setSurfaceEffect(double effect) noexcept { surfaceEffect = std::max( 0., std::min( 1., effect ) ); }
+    
+    //! Return the amount of cross-synthesis with the spectral surface.
+    double surfaceAmount() const noexcept { return surfaceEffect; }
+    
+    //!	Set the stretch of the spectral surface, see setSpectralSurface()
+    //! and SpectralSurface::setTimeStretch().
+    //!
+    //! \param  time Stretch in time, 2 plays the surface twice as slowly
+    //!         as the bank, 1 (default) at the same time.
+    //! \param  frequency Stretch in frequency, 2 moves its spectrum an
+    //!         octave up, 1 (default) none. Stretches not above 0 are ignored.
+    //! \return Nothing.
+    void setSurfaceStretch(double time, double frequency) noexcept
+    {
+        if ( time > 0. )
+            surfaceTimeStretch = time;
+        if ( frequency > 0. )
+            surfaceFrequencyStretch = frequency;
+    }
+    
+    //!	Change speed the partials are played at, without changing their pitch,
+    //! like Dilator does offline but without touching the shared bank. The
+    //! Breakpoint times are mapped to the time of this synthesizer as they are
+    //! reached, the new rate applies from the current position of the sound on,
+    //! so the speed can change at any block. It is kept by reset().
+    //!
+    //! \param  rate Speed of the sound, 2 plays it twice as fast, 0.5 twice as
+    //!         long, 1 (default) at original timing. Rates not above 0 are ignored.
+    //! \return Nothing.
+    void setPlaybackRate(double rate) noexcept;
+    
+    //! Return speed the partials are played at, see setPlaybackRate().
+    double playbackRate() const noexcept { return 1. / timeStretch; }
+    
  	
 //	-- parameter access and mutation --
+    //! Set the largest number of partials rendered at once, 0 (default) for
+    //! no limit. When more partials are playing, only the loudest ones (by
+    //! their current envelope amplitude, or the amplitude of the Breakpoint
+    //! they are heading to, if larger) are rendered. The others fade out
+    //! during the next block and are then only followed, not rendered,
+    //! until they are loud enough to fade back in. Partials starting in a
+    //! block are rendered in it and ranked from the next block, so up to
+    //! that many partials more may be rendered in a block.
+    //!
+    //! \param  count Largest number of partials rendered, 0 for all.
+    //! \return Nothing.
+    void setMaxPartials(int count) noexcept;
+    
+    //! Return the largest number of partials rendered at once, 0 for all.
+    int maxPartials() const noexcept { return maxPartialsRendered; }
+    
+    //! Return the number of partials playing now (rendered or only followed).
+    int numPlayingPartials() const noexcept { return numPartialsBeingProcessed; }
+    
+    //! Return length of the sound in seconds, the time of the last
+    //! Breakpoint of all partials.
+    double duration() const noexcept { return lastSample * OneOverSrate; }
+    
+    //! Return how far the sound is rendered, 0 at the beginning (after
+    //! reset()) and 1 when the last Breakpoint of all partials is reached.
+    double progress() const noexcept
+    {
+        return lastSample > 0 ? std::max( 0., std::min( 1., bankPosition() / lastSample ) ) : 1.;
+    }
+    
+    //! Return the channels the last synthesizeNext() added samples to, bit
+    //! 1 << channel for each PartialStruct::Channel. Outputs of the others
+    //! were not touched, 0 if the block was silent.
+    int writtenChannels() const noexcept { return channelsWritten; }
+    
+    //! Return the number of Partials the last synthesizeNext() did not play
+    //! because they were above the Nyquist frequency, see isAboveNyquist().
+    int culledPartials() const noexcept { return partialsCulled; }
+    
+    //! Return true if the sound has ended: no partial is playing nor waiting
+    //! to start and the sound will not wrap to the loop start. Everything
+    //! synthesized from now on is silent, until reset().
+    bool isFinished() const noexcept
+    {
+        return numPartialsBeingProcessed == 0 && ! seekPending && ! ( looping && hasLoop() )
+               && ( ! bank || partialIdx >= (int) bank->size() || isPastCrop() ) && m_spectral.isSilent();
+    }
+    
+    //! Ways of rendering the playing Partials.
+    enum Engine
+    {
+        //! Oscillator bank, every Partial costs an oscillator sample per
+        //! sample (default).
+        OscillatorEngine,
+        //! Inverse FFT overlap-add of RealtimeSpectralBank, every Partial
+        //! costs a few multiply-adds per hop, the output is delayed by
+        //! RealtimeSpectralBank::Latency samples.
+        SpectralEngine,
+        //! SpectralEngine for banks of at least AutomaticSpectralPartials
+        //! Partials playing at once (limited by setMaxPartials()),
+        //! OscillatorEngine delayed by the same latency for the others.
+        AutomaticEngine
+    };
+    
+    //! Select the way playing Partials are rendered, the engine of
+    //! AutomaticEngine is chosen by reset(). Do not call it while
+    //! synthesizing, the latency may change. The delayed samples of the
+    //! engines other than OscillatorEngine are allocated here for blocks of
+    //! up to DefaultSpectralBlockSize samples, or the size given to prepare().
+    //!
+    //! \param  engine The engine.
+    //! \return Nothing.
+    void setEngine(Engine engine);
+    
+    //! Return the way playing Partials are rendered.
+    Engine engine() const noexcept { return selectedEngine; }
+    
+    //! Return the number of samples the output is delayed by, 0 for
+    //! OscillatorEngine.
+    int latency() const noexcept { return selectedEngine == OscillatorEngine ? 0 : (int) RealtimeSpectralBank::Latency; }
+    
+    //! Playing Partials AutomaticEngine renders by SpectralEngine from.
+    static const int AutomaticSpectralPartials;
+    
+    //! Samples of the blocks the delayed samples are allocated for if
+    //! prepare() was not called. Longer blocks are rendered by the
+    //! oscillators without delay, the audio thread never allocates them.
+    static const int DefaultSpectralBlockSize;
+    
+    //! Select the way the oscillator bank computes samples of playing
+    //! partials, RealtimeOscillatorBank::CosineKernel by default.
+    //!
+    //! \param  kernel The kernel.
+    //! \return Nothing.
+    void setOscillatorKernel(RealtimeOscillatorBank::Kernel kernel) noexcept { m_lanes.setKernel( kernel ); }
+    
+    //! Return the way the oscillator bank computes samples.
+    RealtimeOscillatorBank::Kernel oscillatorKernel() const noexcept { return m_lanes.kernel(); }
+    
+    //! Select the instruction set the oscillator bank computes samples
+    //! with (the best one of the processor by default), all of them
+    //! render the same samples.
+    //!
+    //! \param  instructions The instruction set, replaced by the best
+    //!         one of the processor if it does not have it.
+    //! \return Nothing.
+    void setOscillatorInstructions(RealtimeOscillatorBank::Instructions instructions) noexcept { m_lanes.setInstructions( instructions ); }
+    
+    //! Return the instruction set the oscillator bank computes samples with.
+    RealtimeOscillatorBank::Instructions oscillatorInstructions() const noexcept { return m_lanes.instructions(); }
+    
+    //! Render the harmonic Partials of the bank from one phase of the
+    //! fundamental (off by default). A Partial is harmonic if it has no
+    //! noise and its frequency stays within the harmonic tolerance of its
+    //! label times the frequency of the fundamental (the longest Partial
+    //! labeled 1, see Channelizer), measured when the bank is set up.
+    //! While the fundamental plays, every sample of the harmonic Partials
+    //! costs a complex multiply per harmonic instead of an oscillator,
+    //! harmonic k is computed from harmonic k - 1 by angle addition. They
+    //! sound at exactly k times the fundamental, but with their own phase
+    //! and envelopes. Morphing Partials are rendered by the oscillators.
+    //!
+    //! \param  enable True to render the harmonic Partials from the fundamental.
+    //! \return Nothing.
+    void setHarmonicRendering(bool enable) noexcept { renderHarmonics = enable; }
+    
+    //! Return true if harmonic Partials are rendered from the fundamental.
+    bool isHarmonicRendering() const noexcept { return renderHarmonics; }
+    
+    //! Set how far the frequency of a harmonic Partial may stray from its
+    //! harmonic of the fundamental, DefaultHarmonicTolerance by default.
+    //! The Partials of the bank set up are measured again.
+    //!
+    //! \param  cents The tolerance in cents.
+    //! \return Nothing.
+    void setHarmonicTolerance(double cents) noexcept;
+    
+    //! Return the tolerance of harmonic Partials in cents.
+    double harmonicTolerance() const noexcept { return harmonicCents; }
+    
+    //! Return the number of Partials of the bank set up that are harmonic,
+    //! including the fundamental.
+    int harmonicPartials() const noexcept { return numHarmonicPartials; }
+    
+    //! Default tolerance of harmonic Partials in cents.
+    static const double DefaultHarmonicTolerance;
+    
+    //! Largest bandwidth of a harmonic Partial, the noise of Partials
+    //! rendered from the fundamental is left out.
+    static const double HarmonicMaxBandwidth;
+    
+    //! Render low Partials at a fraction of the sample rate (off by
+    //! default). At every block the Partials rendered by the oscillators
+    //! are grouped by their frequency into tiers of the full rate, half of
+    //! it and a quarter of it, as far as the reduced rate is not below
+    //! MinMultiRate. A group of a lower tier computes its lanes only every
+    //! two or four samples and interpolates linearly in between (see
+    //! RealtimeOscillatorBank::oscillate( float *, float *, int )), so most
+    //! Partials of a typical bank cost a fraction of an oscillator sample
+    //! per sample at high sample rates. Segments of Partials with noise are
+    //! rendered at the full rate.
+    //!
+    //! \param  enable True to render low Partials at reduced rates.
+    //! \return Nothing.
+    void setMultiRate(bool enable) noexcept { multiRate = enable; }
+    
+    //! Return true if low Partials are rendered at reduced rates.
+    bool isMultiRate() const noexcept { return multiRate; }
+    
+    //! Lowest reduced rate of setMultiRate() in Hz, the images of the
+    //! interpolation are around it and its multiples.
+    static const double MinMultiRate;
+    
+    //! Breakpoint amplitudes below this one (about -140 dB), morphed and
+    //! modified, are rendered as zero, so envelopes fading out end in
+    //! silence instead of denormal numbers.
+    static const double MinAmplitude;
+    
+    //! Set the residual of the sound, rendered as a few bands of filtered
+    //! noise shared by all Partials (see RealtimeNoiseBands) into the Center
+    //! channel. It follows the time of the bank and the pitch of the sound.
+    //! It is kept when another bank is set up.
+    //!
+    //! \param  bands Residual of the analysis of the Partials, empty for none.
+    //! \return Nothing.
+    void setNoiseBands(NoiseBands::Ptr bands) noexcept { m_noise.setBands( bands ); }
+    
+    //! Set the gain of the noise bands, 0 renders none. The gain ramps to it
+    //! over the next block.
+    //!
+    //! \param  level Gain of the noise, 1 for the level of the residual.
+    //! \return Nothing.
+    void setNoiseLevel(double level) noexcept { m_noise.setLevel( level ); }
+    
+    //! Return the noise bands set, empty if there are none.
+    const NoiseBands::Ptr & noiseBands() const noexcept { return m_noise.bands(); }
+    
+    //! Set the render-time modifiers of the Partials. Amplitudes and
+    //! bandwidths are modified as Breakpoints are reached, so playing
+    //! Partials ramp to them over their current Breakpoint segment, like
+    //! morphing does. Frequencies are scaled with the pitch and glide to
+    //! the new ratio over the next block, like glidePitch(). Partials ending
+    //! before the crop start or starting after the crop end are not started
+    //! at all, Breakpoints outside of the crop have no amplitude, so the
+    //! others fade in and out over their segments crossing its bounds. It
+    //! is kept by reset() and when another bank is set up.
+    //!
+    //! \param  modifiers The modifiers, default ones change nothing.
+    //! \return Nothing.
+    void setModifiers(const PartialModifiers & modifiers) noexcept;
+    
+    //! Return the render-time modifiers of the Partials.
+    const PartialModifiers & modifiers() const noexcept { return m_modifiers; }
+    
+    //! Default crossfade of Partials when a loop wraps, in seconds.
+    static const double DefaultLoopFadeTime;
+
+    //! Share the evaluation of Breakpoints with other synthesizers playing
+    //! the same bank from the same sample, at any pitch (see EnvelopeFrame).
+    //! Breakpoints another synthesizer evaluated in the block are not
+    //! walked, morphed nor modified again, only their frequency is scaled.
+    //! The samples rendered do not change. Synthesizers sharing a frame
+    //! must render one after another, on one thread.
+    //!
+    //! \param  frame The frame, not owned, nullptr (default) for none.
+    //! \return Nothing.
+    void setEnvelopeFrame(EnvelopeFrame * frame) noexcept { envelopeFrame = frame; }
+
+    //! Return the frame Breakpoints are shared by, nullptr if there is none.
+    EnvelopeFrame * sharedEnvelopeFrame() const noexcept { return envelopeFrame; }
+
+    //! Return the number of samples synthesized since reset(), negative
+    //! before the sound starts. Synthesizers of a bank at the same sample
+    //! evaluate Breakpoints the same way, unless their playback rate,
+    //! morph or modifiers differ.
+    int renderedSamples() const noexcept { return processedSamples; }
+    
 //	-- implementation --
 private:
     
     //	-- synthesis --
+    //! Synthesize a block of samples of the partials which does not pass
+    //! the loop end, see synthesizeNext(float * const *, int, double, double).
+    void synthesizeBlock( float * const * outputs, int samples, double gain, double targetGain ) noexcept;
+    
+    //! Accumulate the noise bands of the block rendered by renderBlock()
+    //! into output, from where the sound begins.
+    void renderNoise( float * output, int samples ) noexcept;
+    
+    //! Render a block of samples of the partials into outputs by an engine,
+    //! with no latency, see synthesizeBlock().
+    void renderBlock( float * const * outputs, int samples, double gain, double targetGain, Engine engine ) noexcept;
+    
+    //! Render the playing Partials and the ones starting in the block by
+    //! the frames of the spectral bank centred in it.
+    //!
+    //! \param  samples Number of samples of the block.
+    //! \param  numRendered Number of Partials to be rendered, see selectPartials().
+    void renderFrames( int samples, int numRendered ) noexcept;
+    
+    //! Remove finished partials and the ones faded out after the loop
+    //! wrapped from the playing ones.
+    void removeFinished() noexcept;
+    
+    //! Start the Partials which start up to a sample of the block.
+    //!
+    //! \param  outputs Outputs to render the Partials into up to the end of
+    //!         the block, null to set them up only (for renderFrames()).
+    //! \param  samples Number of samples of the block.
+    //! \param  end Sample of the block, Partials starting at it start too.
+    void startPartials( float * const * outputs, int samples, int end ) noexcept;
+    
+    //! Choose the engine of AutomaticEngine for the bank set up.
+    void chooseEngine() noexcept;
+    
+    //! Go on from the loop start: jump playing Partials, start fading in
+    //! the ones entering and fading out the ones leaving.
+    void wrapLoop() noexcept;
+    
+    //! Start the sound at the time given to reset(): Partials playing there
+    //! enter with their state at it and start fading in.
+    void enterSeek() noexcept;
+    
+    //! Start playing a Partial at the seek sample, from its state at a
+    //! checkpoint (or its start) in the bank.
+    //!
+    //! \param  idx Index of the Partial.
+    //! \param  k Breakpoint the Partial is at, at the sample at.
+    //! \param  phase Unwrapped phase advance of the Partial from its fade
+    //!         in Breakpoint to the sample at, in time and pitch of the bank.
+    //! \param  at Sample of the bank the state is given at.
+    void enterPartial( int idx, int k, double phase, int at ) noexcept;
+    
     //! Synthesize a bandwidth-enhanced sinusoidal Partial.
     //!
     //! \param  buffer  The samples buffer.
     //! \param  samples Number of samples to be synthesized.
     //! \param  p       The Partial to synthesize.
+    //! \param  state   Playback state of the Partial.
     //! \return Nothing.
     //! \pre    The buffer has to have capacity to contain all samples.
     //! \post   This RealTimeSynthesizer's sample buffer (vector) contain synthesised
     //!         partials and storeed inner state of synthesiser.
     //!
-    void synthesize( PartialStruct &p, float * buffer, const int samples) noexcept;
+    void synthesize( const PartialStruct &p, PartialState &state, float * buffer, const int samples) noexcept;
+
+    //! Synthesize up to RealtimeOscillatorBank::NumLanes Partials at once,
+    //! one Partial in each lane of the oscillator bank. The Partials must
+    //! already be playing, so that all of them start at the beginning of
+    //! the buffer.
+    //!
+    //! \param  indices Indices of the Partials to synthesize.
+    //! \param  count   Number of indices, at most RealtimeOscillatorBank::NumLanes.
+    //! \param  buffer  The samples buffer.
+    //! \param  samples Number of samples to be synthesized.
+    //! \param  factor  Lanes are computed every factor samples, see setMultiRate().
+    //! \return Nothing.
+    //! \pre    The buffer has to have capacity to contain all samples.
+    void synthesizeLanes( const int * indices, int count, float * buffer, const int samples, int factor = 1 ) noexcept;
+    
+    //! Return the tier of a playing Partial in the block, the largest factor
+    //! of setMultiRate() its frequency is low enough for at the end of the
+    //! glide of the block, 1 for the full rate.
+    int decimationFactor( int idx, int maxFactor ) const noexcept;
+
+    //! Synthesize harmonic Partials from the phase of the fundamental, see
+    //! setHarmonicRendering(). The fundamental must be playing, it is
+    //! followed without being rendered unless it is among the Partials.
+    //! Envelopes and gains ramp linearly between Breakpoints, as in the
+    //! oscillator bank.
+    //!
+    //! \param  indices Indices of the Partials to synthesize, all harmonic.
+    //! \param  count   Number of indices.
+    //! \param  buffer  The samples buffer.
+    //! \param  samples Number of samples to be synthesized.
+    //! \return Nothing.
+    void synthesizeHarmonics( const int * indices, int count, float * buffer, const int samples ) noexcept;
+    
+    //! Return the number of samples from the sample a playing Partial is at
+    //! to its next Breakpoint, INT_MAX after its last one.
+    int samplesToBreakpoint( const PartialStruct &p, const PartialState &state ) const noexcept
+    {
+        const int next = state.lastBreakpointIdx + 1;
+        return next < p.numBreakpoints ? voiceSample( bank->breakpointSamples()[p.firstBreakpoint + next] ) - state.currentSamp
+                                       : std::numeric_limits<int>::max();
+    }
+    
+    //! Find the fundamental of the bank and the Partials harmonic to it.
+    void measureHarmonics() noexcept;
+    
+    //! Load the next Breakpoint segment of a playing Partial into a lane of
+    //! the oscillator bank. Segments of zero length are skipped.
+    //!
+    //! \param  position Sample of the block the lane starts at, the frequency
+    //!         ramp follows the glide of frequency scaling from there.
+    //! \return Number of samples to the target Breakpoint, 0 if the Partial
+    //!         has no more Breakpoints (the lane is silenced then).
+    int loadLane( int lane, const PartialStruct &p, PartialState &state, int position ) noexcept;
+    
+    //! Return the sample of a Breakpoint of a playing Partial in time of this
+    //! synthesizer, and its frequency (Hz, not scaled), amplitude and
+    //! bandwidth morphed and modified, from the EnvelopeFrame if it holds it.
+    //!
+    //! \param  i Index of the Breakpoint in the Partial.
+    int breakpointTarget( const PartialStruct &p, int i, double & frequency, double & amplitude, double & bandwidth ) noexcept;
+
+    //! Return what Breakpoint targets of the block being synthesized depend
+    //! on, see EnvelopeFrame.
+    EnvelopeFrame::Key envelopeKey( int samples ) const noexcept;
+
+    //! Return the frequency a Partial has after n samples from the sample
+    //! position of the block, heading from frequency (scaled at position) to
+    //! the unscaled target frequency of a Breakpoint samplesToBp samples away,
+    //! while frequency scaling glides over the block.
+    double glideFrequency( double frequency, double target, int position, int n, int samplesToBp ) const noexcept;
+    
+    //! Return true if the Partials of the block are scaled by brightness.
+    bool isBrightening() const noexcept { return blockBrightness != 0. || blockBrightnessEnd != 0.; }
+    
+    //! Return the gain of the PartialFilter at a frequency in radians per
+    //! sample.
+    float filterGain( double frequency ) const noexcept { return m_filter->gainAt( frequency * m_srateHz / ( 2. * Pi ) ); }
+    
+    //! Return true if the Partials are cross-synthesized with a spectral
+    //! surface.
+    bool isCrossSynthesizing() const noexcept { return m_surface && surfaceEffect > 0.; }
+    
+    //! Return the gain of the spectral surface at a frequency in radians per
+    //! sample, at the current position of the bank.
+    float surfaceGain( double frequency ) const noexcept
+    {
+        const double amplitude = m_surface->gridAmplitudeAt( bankPosition() * OneOverSrate / surfaceTimeStretch,
+                                                             frequency * m_srateHz / ( 2. * Pi ) / surfaceFrequencyStretch );
+        return (float) ( 1. - surfaceEffect + surfaceEffect * amplitude );
+    }
+    
+    //! Scale the gains of a Partial over the block by its brightness, the
+    //! PartialFilter at its current frequency, the spectral surface and its
+    //! PartialGains, see setBrightness(), setPartialFilter(),
+    //! setSpectralSurface() and setPartialGains().
+    //!
+    //! \param  idx Index of the Partial.
+    //! \param  gain Gain at the beginning of the block.
+    //! \param  targetGain Gain at the end of the block.
+    void scaleBlockGains( int idx, double & gain, double & targetGain ) noexcept;
+    
+    //! Return the gain of the brightness of a Partial, for an exponent of
+    //! the block, see setBrightness().
+    double brightnessGain( const PartialStruct &p, double exponent ) const noexcept
+    {
+        return exponent != 0. && p.avgFrequency > 0.f && pitch > 0. ? std::pow( p.avgFrequency / pitch, exponent ) : 1.;
+    }
+    
+    //! Return true if Breakpoints are moved toward the morph target.
+    bool isMorphing() const noexcept { return ( morphWeight > 0. || blockMorph > 0. ) && morph; }
+    
+    //! Move the parameters of a Breakpoint toward the morph target by the
+    //! morph amount.
+    //!
+    //! \param  b Index of the Breakpoint in the arrays of the bank.
+    //! \param  weight Morph amount, see morphAt().
+    void morphBreakpoint( int b, double weight, double & frequency, double & amplitude, double & bandwidth ) const noexcept
+    {
+        frequency += weight * ( morph->frequencies()[b] - frequency );
+        amplitude += weight * ( morph->amplitudes()[b] - amplitude );
+        bandwidth += weight * ( morph->bandwidths()[b] - bandwidth );
+    }
+    
+    //! Return the morph amount at a sample of the block being synthesized,
+    //! samples out of it get the amount at its nearest end.
+    double morphAt( int position ) const noexcept
+    {
+        return blockMorph + blockMorphStep * std::max( 0, std::min( position, blockSamples ) );
+    }
+    
+    //! Return true if Breakpoint frequencies are blended toward harmonics of
+    //! the fundamental, see PartialModifiers::harmonify.
+    bool isHarmonifying() const noexcept { return m_modifiers.harmonify > 0. && harmonicFundamental >= 0; }
+    
+    //! Blend the frequency of a Breakpoint toward the label of its Partial
+    //! times the fundamental of the block, like Harmonifier does offline.
+    //! Unlabeled Partials are not changed.
+    //!
+    //! \param  p The Partial of the Breakpoint.
+    //! \param  frequency Frequency of the Breakpoint in Hz, not scaled.
+    void harmonifyBreakpoint( const PartialStruct &p, double & frequency ) const noexcept
+    {
+        if ( p.label > 0 )
+            frequency += m_modifiers.harmonify * ( p.label * blockFundamental - frequency );
+    }
+    
+    //! Return the frequency of the fundamental (see measureHarmonics()) in
+    //! Hz at a sample of the bank, interpolated between its Breakpoints, or
+    //! the one of its nearest end outside of it.
+    double fundamentalAt( double sample ) const noexcept;
+    
+    //! Return true if Breakpoints are changed by the modifiers, other than
+    //! in frequency (which is folded into the frequency scaling).
+    bool isModifying() const noexcept { return ! m_modifiers.isEnvelopeIdentity(); }
+    
+    //! Apply the modifiers to the amplitude and bandwidth of a Breakpoint.
+    //!
+    //! \param  sample Sample of the bank the Breakpoint is at.
+    //! \param  frequency Frequency of the Breakpoint in Hz, not scaled.
+    void modifyBreakpoint( int sample, double frequency, double & amplitude, double & bandwidth ) const noexcept
+    {
+        if ( m_modifiers.hasCrop() && ( sample < cropStartSample || sample > cropEndSample ) )
+            amplitude = 0.;
+        amplitude *= m_modifiers.amplitudeScale;
+        if ( tiltExponent != 0. && frequency > 0. && pitch > 0. )
+            amplitude *= std::pow( frequency / pitch, tiltExponent );
+        
+        bandwidth *= m_modifiers.bandwidthScale;
+        if ( m_modifiers.noiseRatioScale != 1. )
+        {
+            const double ratio = bandwidth < 1. ? m_modifiers.noiseRatioScale * bandwidth / ( 1. - bandwidth ) : -1.;
+            bandwidth = ratio >= 0. ? ratio / ( 1. + ratio ) : 1.;
+        }
+    }
+    
+    //! Return true if a Partial is not heard at all in the crop of the
+    //! modifiers, so it is not started.
+    bool isCropped( const PartialStruct &p ) const noexcept
+    {
+        return m_modifiers.hasCrop()
+               && ( p.startSample > cropEndSample
+                    || bank->breakpointSamples()[p.firstBreakpoint + p.numBreakpoints - 1] < cropStartSample );
+    }
+    
+    //! Return true if a playing Partial has reached a Breakpoint after the
+    //! end of the crop of the modifiers, so it has faded out (and stays
+    //! silent towards the next one).
+    bool isFadedByCrop( const PartialStruct &p, const PartialState &state ) const noexcept
+    {
+        return m_modifiers.hasCrop() && state.lastBreakpointIdx >= 0
+               && bank->breakpointSamples()[p.firstBreakpoint + state.lastBreakpointIdx] > cropEndSample;
+    }
+    
+    //! Return true if the sound is past the end of the crop of the modifiers,
+    //! no Partial starting from now on is heard.
+    bool isPastCrop() const noexcept { return m_modifiers.hasCrop() && bankPosition() > cropEndSample; }
+    
+    //! Return true if a Partial is above the Nyquist frequency at the
+    //! scaling given to updateCutoff(), so the oscillator would only keep it
+    //! silent. Partials are not culled while morphing, the target may be lower.
+    bool isAboveNyquist( const PartialStruct &p ) const noexcept
+    {
+        return ! isMorphing() && p.maxFrequency > audibleFrequency;
+    }
+    
+    //! Compute the highest frequency of the bank audible at a frequency
+    //! scaling and the number of Partials below it, unless the scaling
+    //! did not change.
+    void updateCutoff( double scaling ) noexcept;
+    
+    //! Return the frequency scaling at a sample of the block being synthesized.
+    double scalingAt( int position ) const noexcept { return blockScaling + blockScalingStep * position; }
+
+    //! Return the sample of this synthesizer a sample of the bank is played at.
+    int voiceSample( int bankSample ) const noexcept
+    {
+        return originSample + (int) std::floor( ( bankSample - originBankSample ) * timeStretch + 0.5 );
+    }
+    
+    //! Return the sample of the bank played at processedSamples.
+    double bankPosition() const noexcept { return originBankSample + ( processedSamples - originSample ) / timeStretch; }
+
+    //! Follow a playing Partial for a number of samples without rendering it:
+    //! envelopes are interpolated and the phase is advanced exactly as the
+    //! oscillator bank would do it, so the Partial can be rendered again later.
+    //!
+    //! \param  position Sample of the block the Partial is at.
+    void skip( const PartialStruct &p, PartialState &state, int samples, int position = 0 ) noexcept;
+    
+    //! Set the target gain of every playing Partial for the next block and
+    //! move the Partials that need to be rendered to the front of
+    //! partialsBeingProcessed.
+    //!
+    //! \return Number of Partials to be rendered, the others are skipped.
+    int selectPartials() noexcept;
+    
+    //! Return the amplitude a Partial is ranked by when the number of
+    //! Partials rendered is limited.
+    double loudness( int idx ) const noexcept;
+
+    //! Compute the phase a Partial has to start with at the fade in Breakpoint
+    //! so that it matches exactly the phase of the first Breakpoint. Partials
+    //! of phase-free banks have no phase to match, they start scattered.
+    double fixedPhase( const PartialStruct &p, const PartialState &state ) const noexcept;
+    
+    //! Return the phase a Partial has at its first Breakpoint when it starts
+    //! at a sample of this synthesizer, counted from the beginning of the sound.
+    double firstPhase( const PartialStruct &p, int startSample ) const noexcept;
     
     void clearPartialsBeingProcessed() noexcept
 	{
-		while (!partialsBeingProcessed.empty())
-			partialsBeingProcessed.pop();
+        for (int i = 0; i < numPartialsBeingProcessed; i++)
+            states[partialsBeingProcessed[i]].loopFade = 0;
+		numPartialsBeingProcessed = 0;
+        loopFadeLeft = 0;
 	}
     
     RealtimeOscillator m_osc; 	//  the Synthesizer has-a Oscillator that it uses to render
                                 //  all the Partials one by one.
+    RealtimeOscillatorBank m_lanes;  //  renders playing Partials NumLanes at once
+    
+    // Target of the Breakpoint segment in a lane of m_lanes.
+    struct LaneTarget
+    {
+        int partial = -1;       // index of partial in lane, -1 if lane is silent
+        int remaining = 0;      // samples to target breakpoint
+        double frequency = 0.;  // radians per sample
+        double amplitude = 0.;
+        double bandwidth = 0.;
+    };
+    LaneTarget laneTargets[RealtimeOscillatorBank::NumLanes];
+    
+    // Harmonic Partial rendered by synthesizeHarmonics().
+    struct HarmonicLane
+    {
+        int partial = 0;        // index of partial in bank
+        int number = 0;         // harmonic of the fundamental
+        double phase = 0.;      // phase at the beginning of the block
+        double gain = 0.;       // gain at the beginning of the block,
+        double gainStep = 0.;   // and its increment per sample
+    };
+    std::vector<HarmonicLane> harmonicLanes; // by harmonic number, reserved for all harmonic
+                                             // partials at setup
+    std::vector<RealtimeHarmonics::Harmonic> harmonics; // rendered for harmonicLanes
+    
+    RealtimeSpectralBank m_spectral;        //  renders by SpectralEngine, and delays the output
+    RealtimeNoiseBands m_noise;             //  renders the residual, shared by all Partials
+    Engine selectedEngine = OscillatorEngine;
+    Engine activeEngine = OscillatorEngine; //  engine rendering the sound, never AutomaticEngine
+    
+    // State a Partial playing at the loop start enters the loop with.
+    struct LoopEntry
+    {
+        int partial = 0;        // index of partial in bank
+        int breakpoint = 0;     // last Breakpoint at or before the loop start
+        Breakpoint envelope;    // at the loop start, frequency in Hz
+    };
     
     double OneOverSrate = 0;
     typedef unsigned long index_type;
     
     double pitch = 0.;                      // original pitch of partial data
     
-    std::vector<PartialStruct> partials;
+    PartialBank::Ptr bank;                  // shared partials, read-only
+    PartialMorph::Ptr morph;                // shared morph target of the bank, may be empty
+    double morphWeight = 0.;                // how far Breakpoints move toward the morph target
+    double glideMorph = -1.;                // morph amount at the end of the next block,
+                                            // negative unless gliding
+    double blockMorph = 0.;                 // morph amount at the beginning of the block
+    double blockMorphStep = 0.;             // its increment per sample, 0 unless gliding
+    double brightnessExponent = 0.;         // gains of Partials are (avgFrequency / pitch)^brightnessExponent
+    double glideBrightnessExponent = 0.;    // exponent at the end of the next block,
+    bool brightnessGliding = false;         // if gliding
+    double blockBrightness = 0.;            // exponent at the beginning of the block
+    double blockBrightnessEnd = 0.;         // and at its end
+    const PartialFilter * m_filter = nullptr;   // equalizer of the partials, not owned, may be null
+    const PartialGains * m_gains = nullptr;     // gains of single partials, not owned, may be null
+    const SpectralSurface * m_surface = nullptr;    // cross-synthesized surface, not owned, may be null
+    double surfaceEffect = 0.;              // amount of cross-synthesis with m_surface
+    double surfaceTimeStretch = 1.;         // stretch of m_surface in time
+    double surfaceFrequencyStretch = 1.;    // and in frequency
+    std::vector<PartialState> states;       // playback state of each partial in bank
     int partialIdx;                         // last loaded partial
-    int processedSamples = 0;               // internal sample position counter
-    std::queue<PartialStruct* > partialsBeingProcessed; // partials not finished yet
+    int processedSamples = 0;               // internal sample position counter, negative
+                                            // before the sound starts (see reset())
+    int lastSample = 0;                     // sample of the last Breakpoint of the bank
+    double timeStretch = 1.;                // samples synthesized per sample of the bank
+    int originSample = 0;                   // sample the playback rate last changed at,
+    double originBankSample = 0.;           // and sample of the bank played there
+                                            // (the loop start after a wrap)
+    int loopStartSample = 0;                // loop of the bank, none if end is not after start
+    int loopEndSample = 0;
+    int loopPartialIdx = 0;                 // first partial starting after the loop start
+    std::shared_ptr<const std::vector<LoopEntry>> loopEntries; // partials playing at the loop
+                                            // start, shared by synthesizers set up alike
+    bool looping = true;                    // wrap at the loop end
+    int loopFadeSamples = 0;                // length of crossfade after a wrap
+    int loopFadeLeft = 0;                   // samples of the crossfade not synthesized yet
+    float loopFadeEnd = 0.f;                // part of the crossfade left at the end of the block
+    int crossfadeSamples = 0;               // length of the crossfade going on, after a wrap
+                                            // or a seek
+    int seekSample = 0;                     // sample of the bank rendering started at
+    int seekSamples = 0;                    // and its sample in time of this synthesizer
+    bool seekPending = false;               // partials playing at seekSample did not enter yet
+    std::vector<int> partialsBeingProcessed;// indices of partials not finished yet, sized for
+                                            // maximum of concurrent partials at setup
+    int numPartialsBeingProcessed = 0;      // valid entries in partialsBeingProcessed
+    int maxPartialsRendered = 0;            // CPU budget in partials, 0 for no limit
+    int channelsWritten = 0;                // channels written by the last synthesizeNext()
+    int partialsCulled = 0;                 // partials above Nyquist skipped by the last synthesizeNext()
     std::vector<float> *buffer;             // sample buffer
+    double outputGain = 1.;                 // gain at the beginning of the block being synthesized
+    double outputGainStep = 0.;             // gain increment per sample of the block
+    double glideScaling = 0.;               // frequency scaling at the end of the next block,
+                                            // 0 if it does not change
+    int blockSamples = 0;                   // length of the block being synthesized
+    double blockScaling = 1.;               // frequency scaling at the beginning of the block
+    double blockScalingStep = 0.;           // its increment per sample, 0 unless gliding
+    double cutoffScaling = 0.;              // frequency scaling audibleFrequency was computed for
+    double audibleFrequency = 0.;           // highest frequency of the bank below Nyquist, Hz
+    int numAudiblePartials = 0;             // partials of the bank below it
+    double partialSamples = 0.;             // samples sounded by all partials of the bank
+    PartialModifiers m_modifiers;           // render-time modifiers of the partials
+    double frequencyRatio = 1.;             // of the modifiers, part of the frequency scaling
+    double tiltExponent = 0.;               // amplitudes are scaled by (frequency / pitch)^tiltExponent
+    int cropStartSample = 0;                // crop of the modifiers, samples of the bank
+    int cropEndSample = 0;
+    bool renderHarmonics = false;           // harmonic partials are rendered from the fundamental
+    bool multiRate = false;                 // low partials are rendered at reduced rates
+    double harmonicCents = DefaultHarmonicTolerance; // tolerance of harmonic partials
+    std::shared_ptr<const std::vector<int>> harmonicNumbers; // harmonic of each partial of
+                                            // the bank, 0 if not harmonic, shared like loopEntries
+    int harmonicFundamental = -1;           // index of the fundamental, -1 if the bank has none
+    double blockFundamental = 0.;           // its frequency in Hz at the end of the block,
+                                            // while harmonifying
+    int numHarmonicPartials = 0;            // partials with a harmonic number
+    EnvelopeFrame * envelopeFrame = nullptr;// Breakpoints shared with other synthesizers, not owned
     std::vector<double> xxx;                // buffer to satisfy Synthesizer constructor
     
 };	//	end of class RealTimeSynthesizer
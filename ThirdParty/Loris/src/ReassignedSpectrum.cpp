@@ -37,14 +37,18 @@
 #endif
 
 #include "ReassignedSpectrum.h"
+#include "KaiserWindow.h"
 #include "Notifier.h"
 #include "LorisExceptions.h"
 #include <algorithm>	//	for std::transform(), others
 #include <functional>	//	for bind1st, multiplies, etc.
 #include <cstdlib>	    //	for std::abs()
+#include <mutex>	    //	for the window cache
 #include <numeric>	    //	for std::accumulate()
 
 #include <cmath>	//	for M_PI (except when its not there), fmod, fabs
+
+#include <emmintrin.h>  //  SSE2, for reassignBins()
 #if defined(HAVE_M_PI) && (HAVE_M_PI)
 	const double Pi = M_PI;
 #else
@@ -67,10 +71,38 @@ using namespace std;
 //	begin namespace
 namespace Loris {
 
-static unsigned long nextPO2( unsigned long N )
+// ---------------------------------------------------------------------------
+//	ReassignmentWindows
+// ---------------------------------------------------------------------------
+//	The windows a ReassignedSpectrum transforms with, built once and 
+//	never modified, so that they can be shared.
+//
+struct ReassignmentWindows
 {
-    return (unsigned long)ceil( log( double(N) ) / log( 2. ) );
-}
+	//	the original short-time analysis window samples
+	std::vector< double > window;                           //  W(n)
+	
+	//	the complex window used to compute the 
+    //	magnitude/phase transform
+	std::vector< std::complex< double > > cplxWin_W_Wtd;    //  real W(n), imag nW'(n)
+
+	//	the complex window used to compute the 
+    //	time/frequency correction transform
+	std::vector< std::complex< double > > cplxWin_Wd_Wt;    //  real W'(n), imag nW(n)
+};
+
+//	Kaiser windows built recently, by length and shape, the most 
+//	recently used last. Only a few are kept, analyses use one
+//	window, the fundamental estimators another.
+struct CachedWindows
+{
+	unsigned long length;
+	double shape;
+	std::shared_ptr< const ReassignmentWindows > windows;
+};
+static std::mutex s_windowsMutex;
+static std::vector< CachedWindows > s_windowsCache;
+static const std::size_t MaxCachedWindows = 8;
                           
 // ---------------------------------------------------------------------------
 //	ReassignedSpectrum constructor
@@ -80,13 +112,15 @@ static unsigned long nextPO2( unsigned long N )
 //!	window length.
 //
 ReassignedSpectrum::ReassignedSpectrum( const std::vector< double > & window ) :
-	mMagnitudeTransform( 1 << ( 1 + nextPO2( window.size() ) ) ),
-	mCorrectionTransform( 1 << ( 1 + nextPO2( window.size() ) ) )
+	mMagnitudeTransform( transformLength( window.size() ) ),
+	mCorrectionTransform( transformLength( window.size() ) )
 {	
     //  Build and store the window functions.
-	buildReassignmentWindows( window );                        
+    std::shared_ptr< ReassignmentWindows > windows( new ReassignmentWindows );
+	buildReassignmentWindows( window, *windows );                        
+	mWindows = windows;
 
-	debugger << "ReassignedSpectrum: length is " << mMagnitudeTransform.size() << endl;
+	LORIS_DEBUGGER << "ReassignedSpectrum: length is " << mMagnitudeTransform.size() << endl;
 }
 
 // ---------------------------------------------------------------------------
@@ -98,15 +132,114 @@ ReassignedSpectrum::ReassignedSpectrum( const std::vector< double > & window ) :
 //!	window length.
 ReassignedSpectrum::ReassignedSpectrum( const std::vector< double > & window,
                                         const std::vector< double > & windowDerivative ) :
-	mMagnitudeTransform( 1 << ( 1 + nextPO2( window.size() ) ) ),
-	mCorrectionTransform( 1 << ( 1 + nextPO2( window.size() ) ) )
+	mMagnitudeTransform( transformLength( window.size() ) ),
+	mCorrectionTransform( transformLength( window.size() ) )
 {
     //  Build and store the window functions.
-	buildReassignmentWindows( window, windowDerivative );  
+    std::shared_ptr< ReassignmentWindows > windows( new ReassignmentWindows );
+	buildReassignmentWindows( window, windowDerivative, *windows );  
+	mWindows = windows;
 
-	debugger << "ReassignedSpectrum: length is " << mMagnitudeTransform.size() << endl;
+	LORIS_DEBUGGER << "ReassignedSpectrum: length is " << mMagnitudeTransform.size() << endl;
 }
 
+// ---------------------------------------------------------------------------
+//	ReassignedSpectrum constructor
+// ---------------------------------------------------------------------------
+//! Construct a new instance using a Kaiser window of the specified 
+//! length and shape, and its time derivative, shared with the other
+//! instances using the same window.
+//!	Transform lengths are the smallest power of two greater than twice the
+//!	window length, unless transformLength is specified (see
+//!	transformLength()).
+ReassignedSpectrum::ReassignedSpectrum( unsigned long windowLength, double kaiserShape,
+                                        size_type transformLen ) :
+	mMagnitudeTransform( transformLen > 0 ? transformLen : transformLength( windowLength ) ),
+	mCorrectionTransform( mMagnitudeTransform.size() ),
+	mWindows( kaiserWindows( windowLength, kaiserShape ) )
+{
+    if ( mMagnitudeTransform.size() < windowLength )
+    {
+        Throw( InvalidArgument, "Transform length must not be less than the window length." );
+    }
+
+	LORIS_DEBUGGER << "ReassignedSpectrum: length is " << mMagnitudeTransform.size() << endl;
+}
+
+// ---------------------------------------------------------------------------
+//	transformLength
+// ---------------------------------------------------------------------------
+//! Return the length of the transforms of a window, zero-padded 
+//! to at least oversampling times its length, and rounded up. 
+//! The defaults give the length used unless one is specified, 
+//! the smallest power of two not less than twice the window length.
+//!
+//! \param  windowLength is the length of the window in samples
+//! \param  oversampling is the zero-padding factor, at least 1
+//! \param  rounding is how the padded length is rounded up
+//! \return the transform length
+//! \throw  InvalidArgument if oversampling is less than 1
+//
+ReassignedSpectrum::size_type
+ReassignedSpectrum::transformLength( unsigned long windowLength, double oversampling,
+                                     LengthRounding rounding )
+{
+    if ( !( oversampling >= 1. ) )
+    {
+        Throw( InvalidArgument, "Transform oversampling must be at least 1." );
+    }
+    
+    const size_type minLength = 
+        std::max< size_type >( 2, (size_type)ceil( oversampling * windowLength ) );
+    
+    if ( FastLength == rounding )
+    {
+        //  even lengths, so that there is a bin at the Nyquist frequency
+        return 2 * FourierTransform::fastLength( ( minLength + 1 ) / 2 );
+    }
+    
+    size_type po2 = 1;
+    while ( po2 < minLength )
+    {
+        po2 *= 2;
+    }
+    return po2;
+}
+
+
+// ---------------------------------------------------------------------------
+//	windowRotated - helper
+// ---------------------------------------------------------------------------
+//	Window the samples on the half open range [sampsBegin, sampsEnd) into
+//	the transform buffer, rotated (circularly shifted) left by rotateBy
+//	samples to align phase, and zero the rest of the buffer. 
+//
+//	Each windowed sample is written directly to its rotated position, 
+//	so the buffer is visited only once: the samples from the window 
+//	center on go to the beginning of the buffer, the samples before
+//	the center go to the end, and the zeros are in between. The samples
+//	are real, so they scale the complex window (no complex multiply).
+//
+template< class Sample >
+static void
+windowRotated( const Sample * sampsBegin, const Sample * sampsEnd,
+               std::vector< std::complex< double > >::const_iterator win,
+               long rotateBy, FourierTransform & ft )
+{
+    auto scaleWindow = []( Sample x, const std::complex< double > & w ) 
+    { 
+        return std::complex< double >( x * w.real(), x * w.imag() ); 
+    };
+    
+    FourierTransform::iterator it = 
+        std::transform( sampsBegin + rotateBy, sampsEnd, win + rotateBy, 
+                        ft.begin(), scaleWindow );
+    
+    FourierTransform::iterator tail = ft.end() - rotateBy;
+    std::fill( it, tail, 0. );
+    
+    std::transform( sampsBegin, sampsBegin + rotateBy, win, tail, scaleWindow );
+}
 
 // ---------------------------------------------------------------------------
 //	transform
@@ -132,6 +265,51 @@ void
 ReassignedSpectrum::transform( const double * sampsBegin, 
                                const double * sampCenter, 
                                const double * sampsEnd )
+{
+    transformSamples( sampsBegin, sampCenter, sampsEnd );
+}
+
+// ---------------------------------------------------------------------------
+//	transform
+// ---------------------------------------------------------------------------
+//!	Compute the reassigned Fourier transform of the single precision
+//!	samples on the half open range [sampsBegin, sampsEnd), aligning 
+//!	sampCenter with the center of the analysis window. The samples 
+//!	are converted as they are windowed, the transform is computed in 
+//!	double precision.
+//!
+//! \param  sampsBegin pointer representing the beginning of 
+//!         the (half-open) range of samples to transform
+//! \param  sampCenter the sample in the range that is to be 
+//!         aligned with the center of the analysis window
+//! \param  sampsEnd pointer representing the end of 
+//!         the (half-open) range of samples to transform
+//!
+//! \pre    sampsBegin must not be past sampCenter
+//! \pre    sampsEnd must be past sampCenter
+//! \post   the transform buffers store the reassigned 
+//!         short-time transform data for the specified 
+//!         samples
+//
+void
+ReassignedSpectrum::transform( const float * sampsBegin, 
+                               const float * sampCenter, 
+                               const float * sampsEnd )
+{
+    transformSamples( sampsBegin, sampCenter, sampsEnd );
+}
+
+// ---------------------------------------------------------------------------
+//	transformSamples
+// ---------------------------------------------------------------------------
+//	Compute the reassigned Fourier transform of samples of either 
+//	precision, see transform().
+//
+template< class Sample >
+void
+ReassignedSpectrum::transformSamples( const Sample * sampsBegin, 
+                                      const Sample * sampCenter, 
+                                      const Sample * sampsEnd )
 {
     if ( sampCenter < sampsBegin ||  sampCenter >= sampsEnd )
     {
@@ -159,14 +337,8 @@ ReassignedSpectrum::transform( const double * sampsBegin,
 	long rotateBy = sampCenter - sampsBegin;
 		
 	//	window and rotate input and compute normal transform:
-	//	window the samples into the FT buffer:
-	FourierTransform::iterator it = 
-		std::transform( sampsBegin, sampsEnd, mCplxWin_W_Wtd.begin() + winBeginOffset, 
-						mMagnitudeTransform.begin(), std::multiplies< std::complex< double > >() );
-	//	fill the rest with zeros:
-	std::fill( it, mMagnitudeTransform.end(), 0. );
-	//	rotate to align phase:
-	std::rotate( mMagnitudeTransform.begin(), mMagnitudeTransform.begin() + rotateBy, mMagnitudeTransform.end() );
+	windowRotated( sampsBegin, sampsEnd, mWindows->cplxWin_W_Wtd.begin() + winBeginOffset, 
+	               rotateBy, mMagnitudeTransform );
 
 	//	compute transform:
 	mMagnitudeTransform.transform();
@@ -174,12 +346,9 @@ ReassignedSpectrum::transform( const double * sampsBegin,
 	//	compute the dual reassignment transform:
 	//	window the samples into the reassignment FT buffer,
 	//	using the complex-valued reassignment window:
-	it = std::transform( sampsBegin, sampsEnd, mCplxWin_Wd_Wt.begin() + winBeginOffset, 
-						 mCorrectionTransform.begin(), std::multiplies< std::complex<double> >() );
-	//	fill the rest with zeros:
-	std::fill( it, mCorrectionTransform.end(), 0. );
-	//	rotate to align phase:
-	std::rotate( mCorrectionTransform.begin(), mCorrectionTransform.begin() + rotateBy, mCorrectionTransform.end() );
+	windowRotated( sampsBegin, sampsEnd, mWindows->cplxWin_Wd_Wt.begin() + winBeginOffset, 
+	               rotateBy, mCorrectionTransform );
+	               
 	//	compute the transform:
 	mCorrectionTransform.transform();
 }
@@ -205,7 +374,7 @@ ReassignedSpectrum::size( void ) const
 const std::vector< double > &
 ReassignedSpectrum::window( void ) const 
 { 
-    return mWindow; 
+    return mWindows->window; 
 }
 
 // ---------------------------------------------------------------------------
@@ -309,7 +478,7 @@ ReassignedSpectrum::frequencyCorrection( long idx ) const
 	double magSquared = std::norm( X_h );
 
 	//	need to scale by the oversampling factor
-	double oversampling = (double)mCorrectionTransform.size() / mCplxWin_W_Wtd.size();
+	double oversampling = (double)mCorrectionTransform.size() / mWindows->cplxWin_W_Wtd.size();
 	return - oversampling * num / magSquared;
 }
 
@@ -336,10 +505,108 @@ ReassignedSpectrum::timeCorrection( long idx ) const
 	//	No need to scale by the oversampling factor.
 	//	No, seems to sound bad, why?
 	//	(try alienthreat)
-	// double oversampling = (double)mCorrectionTransform.size() / mCplxWin_W_Wtd.size();
+	// double oversampling = (double)mCorrectionTransform.size() / mWindows->cplxWin_W_Wtd.size();
 	return num / magSquared;
 }
 
+// ---------------------------------------------------------------------------
+//	reassignBins
+// ---------------------------------------------------------------------------
+//! Compute reassignment data of the transform indices in the half-open
+//! range [begin, end) in one pass over the transform buffers, two
+//! indices at a time. For each index, the arrays receive the same
+//! values as reassignedFrequency() and reassignedTime() return, and
+//! the squared magnitude (the square of reassignedMagnitude()).
+//!
+//! \param  begin the first frequency sample to evaluate
+//! \param  end the frequency sample past the last one to evaluate
+//! \param  frequencies receives end - begin reassigned frequencies
+//!         in fractional frequency samples
+//! \param  times receives end - begin time corrections in 
+//!         fractional samples
+//! \param  powers receives end - begin squared magnitudes
+//!
+//! \pre    0 < begin <= end < size()
+//
+//  The circular even and odd parts of both transforms are computed
+//  here directly, with the same operations in the same order as 
+//  circEvenPartAt(), circOddPartAt(), frequencyCorrection() and 
+//  timeCorrection() use, so the results are identical.
+//
+void 
+ReassignedSpectrum::reassignBins( long begin, long end, double * frequencies,
+                                  double * times, double * powers ) const
+{
+    Assert( 0 < begin && begin <= end && end < (long)size() );
+
+    const long N = mMagnitudeTransform.size();
+    const double * mag = reinterpret_cast< const double * >( &mMagnitudeTransform[0] );
+    const double * corr = reinterpret_cast< const double * >( &mCorrectionTransform[0] );
+    const double negOversampling = 
+        - ( (double)mCorrectionTransform.size() / mWindows->cplxWin_W_Wtd.size() );
+
+#if defined(USE_PARABOLIC_INTERPOLATION)
+    //  frequencies are interpolated, not reassigned, compute them one by one
+    const long vectorEnd = begin;
+#else
+    const long vectorEnd = begin + ( ( end - begin ) & ~1L );
+#endif
+    
+    const __m128d half = _mm_set1_pd( 0.5 );
+    const __m128d negHalf = _mm_set1_pd( -0.5 );
+    const __m128d negOvers = _mm_set1_pd( negOversampling );
+    
+    long idx = begin;
+    for ( ; idx < vectorEnd; idx += 2 )
+    {
+        //  bins idx and idx+1, and their circular flips N-idx and N-idx-1,
+        //  split into real and imaginary parts:
+        const __m128d a0 = _mm_loadu_pd( mag + 2*idx );
+        const __m128d a1 = _mm_loadu_pd( mag + 2*(idx+1) );
+        const __m128d b0 = _mm_loadu_pd( mag + 2*(N-idx) );
+        const __m128d b1 = _mm_loadu_pd( mag + 2*(N-idx-1) );
+        const __m128d c0 = _mm_loadu_pd( corr + 2*idx );
+        const __m128d c1 = _mm_loadu_pd( corr + 2*(idx+1) );
+        const __m128d d0 = _mm_loadu_pd( corr + 2*(N-idx) );
+        const __m128d d1 = _mm_loadu_pd( corr + 2*(N-idx-1) );
+        
+        const __m128d reA = _mm_unpacklo_pd( a0, a1 ), imA = _mm_unpackhi_pd( a0, a1 );
+        const __m128d reB = _mm_unpacklo_pd( b0, b1 ), imB = _mm_unpackhi_pd( b0, b1 );
+        const __m128d reC = _mm_unpacklo_pd( c0, c1 ), imC = _mm_unpackhi_pd( c0, c1 );
+        const __m128d reD = _mm_unpacklo_pd( d0, d1 ), imD = _mm_unpackhi_pd( d0, d1 );
+        
+        //  X_h and X_Dh are circular even parts, X_Th is the odd part:
+        const __m128d hRe = _mm_mul_pd( half, _mm_add_pd( reA, reB ) );
+        const __m128d hIm = _mm_mul_pd( half, _mm_sub_pd( imA, imB ) );
+        const __m128d dhRe = _mm_mul_pd( half, _mm_add_pd( reC, reD ) );
+        const __m128d dhIm = _mm_mul_pd( half, _mm_sub_pd( imC, imD ) );
+        const __m128d thRe = _mm_mul_pd( half, _mm_add_pd( imC, imD ) );
+        const __m128d thIm = _mm_mul_pd( negHalf, _mm_sub_pd( reC, reD ) );
+        
+        const __m128d magSquared = _mm_add_pd( _mm_mul_pd( hRe, hRe ), _mm_mul_pd( hIm, hIm ) );
+        const __m128d numF = _mm_sub_pd( _mm_mul_pd( hRe, dhIm ), _mm_mul_pd( hIm, dhRe ) );
+        const __m128d numT = _mm_add_pd( _mm_mul_pd( hRe, thRe ), _mm_mul_pd( hIm, thIm ) );
+        
+        const __m128d bins = _mm_set_pd( double(idx + 1), double(idx) );
+        const __m128d fcorr = _mm_div_pd( _mm_mul_pd( negOvers, numF ), magSquared );
+        
+        _mm_storeu_pd( frequencies, _mm_add_pd( bins, fcorr ) );
+        _mm_storeu_pd( times, _mm_div_pd( numT, magSquared ) );
+        _mm_storeu_pd( powers, magSquared );
+        frequencies += 2;
+        times += 2;
+        powers += 2;
+    }
+    
+    //  odd one left over (or interpolated frequencies):
+    for ( ; idx < end; ++idx )
+    {
+        *frequencies++ = reassignedFrequency( idx );
+        *times++ = reassignedTime( idx );
+        *powers++ = norm( circEvenPartAt( mMagnitudeTransform, idx ) );
+    }
+}
+
 // ---------------------------------------------------------------------------
 //	reassignedFrequency
 // ---------------------------------------------------------------------------
@@ -508,7 +775,7 @@ ReassignedSpectrum::convergence( long idx ) const
 	double term1 = (X_TDh * conj(X_h)).real() / norm( X_h );
 	double term2 = ((X_Th * X_Dh) / (X_h * X_h)).real();
 		  		  
-	double scaleBy = 2. * Pi / mCplxWin_W_Wtd.size();
+	double scaleBy = 2. * Pi / mWindows->cplxWin_W_Wtd.size();
 
     double bw = fabs( 1.0 + (scaleBy * (term1 - term2)) );
     bw = min( 1.0, bw );
@@ -610,7 +877,7 @@ static inline void applyFreqRamp( vector< double > & w  )
 // ---------------------------------------------------------------------------
 //	applyTimeRamp
 // ---------------------------------------------------------------------------
-//	Make a copy of mWindow scaled by a ramp from -N/2 to N/2 for computing
+//	Make a copy of the window scaled by a ramp from -N/2 to N/2 for computing
 //	time corrections in samples.
 //
 static inline void applyTimeRamp( vector< double > & w )
@@ -637,25 +904,27 @@ static inline void applyTimeRamp( vector< double > & w )
 //  Input is the unmodified window function.
 //
 void 
-ReassignedSpectrum::buildReassignmentWindows( const std::vector< double > & window )
+ReassignedSpectrum::buildReassignmentWindows( const std::vector< double > & window,
+                                              ReassignmentWindows & windows )
 {
-    mWindow.resize( window.size(), 0. );
+    std::vector< double > & scaledWindow = windows.window;
+    scaledWindow.resize( window.size(), 0. );
 	
     // Scale the window so that the reported magnitudes
 	// are correct.
 	double winsum = std::accumulate( window.begin(), window.end(), 0. );    
-    std::transform( window.begin(), window.end(), mWindow.begin(), 
+    std::transform( window.begin(), window.end(), scaledWindow.begin(), 
 			        std::bind1st( std::multiplies<double>(), 2/winsum ) );                    
     
 
     //  Construct the ramped windows from the scaled window.
-	std::vector< double > tramp = mWindow;
+	std::vector< double > tramp = scaledWindow;
 	applyTimeRamp( tramp );
 	
-	std::vector< double > framp = mWindow;
+	std::vector< double > framp = scaledWindow;
 	applyFreqRamp( framp );
 
-	std::vector< double > tframp( mWindow.size(), 0. );
+	std::vector< double > tframp( scaledWindow.size(), 0. );
 	
 #if defined(COMPUTE_MIXED_PHASE_DERIVATIVE)
 
@@ -669,14 +938,14 @@ ReassignedSpectrum::buildReassignmentWindows( const std::vector< double > & wind
 
     //  Copy the windows into real and imaginary parts of 
     //  complex window vectors.
-    mCplxWin_W_Wtd.resize( mWindow.size(), 0. );
-    mCplxWin_Wd_Wt.resize( mWindow.size(), 0. );
+    windows.cplxWin_W_Wtd.resize( scaledWindow.size(), 0. );
+    windows.cplxWin_Wd_Wt.resize( scaledWindow.size(), 0. );
 
 	std::transform( framp.begin(), framp.end(), tramp.begin(),
-					mCplxWin_Wd_Wt.begin(), make_complex< double >() );	
+					windows.cplxWin_Wd_Wt.begin(), make_complex< double >() );	
     
-	std::transform( mWindow.begin(), mWindow.end(), tframp.begin(),
-					mCplxWin_W_Wtd.begin(), make_complex< double >() );	
+	std::transform( scaledWindow.begin(), scaledWindow.end(), tframp.begin(),
+					windows.cplxWin_W_Wtd.begin(), make_complex< double >() );	
 }
 
 // ---------------------------------------------------------------------------
@@ -694,15 +963,16 @@ ReassignedSpectrum::buildReassignmentWindows( const std::vector< double > & wind
 
 void 
 ReassignedSpectrum::buildReassignmentWindows( const std::vector< double > & window,
-                                              const std::vector< double > & windowDerivative )  
+                                              const std::vector< double > & windowDerivative,
+                                              ReassignmentWindows & windows )  
 {
-
-    mWindow.resize( window.size(), 0. );
+    std::vector< double > & scaledWindow = windows.window;
+    scaledWindow.resize( window.size(), 0. );
 	
     // Scale the windows so that the reported magnitudes
 	// are correct.
 	double winsum = std::accumulate( window.begin(), window.end(), 0. );    
-    std::transform( window.begin(), window.end(), mWindow.begin(), 
+    std::transform( window.begin(), window.end(), scaledWindow.begin(), 
 			        std::bind1st( std::multiplies<double>(), 2/winsum ) ); 
                     
                         
@@ -716,10 +986,10 @@ ReassignedSpectrum::buildReassignmentWindows( const std::vector< double > & wind
                     
 
     //  Construct the ramped windows from the scaled window.
-	std::vector< double > tramp = mWindow;
+	std::vector< double > tramp = scaledWindow;
 	applyTimeRamp( tramp );
 	
-	std::vector< double > tframp( mWindow.size(), 0. );	
+	std::vector< double > tframp( scaledWindow.size(), 0. );	
 	
 #if defined(COMPUTE_MIXED_PHASE_DERIVATIVE)
 
@@ -733,15 +1003,59 @@ ReassignedSpectrum::buildReassignmentWindows( const std::vector< double > & wind
 
     //  Copy the windows into real and imaginary parts of 
     //  complex window vectors.
-    mCplxWin_W_Wtd.resize( mWindow.size(), 0. );
-    mCplxWin_Wd_Wt.resize( mWindow.size(), 0. );
+    windows.cplxWin_W_Wtd.resize( scaledWindow.size(), 0. );
+    windows.cplxWin_Wd_Wt.resize( scaledWindow.size(), 0. );
 
 	std::transform( framp.begin(), framp.end(), tramp.begin(),
-					mCplxWin_Wd_Wt.begin(), make_complex< double >() );	
+					windows.cplxWin_Wd_Wt.begin(), make_complex< double >() );	
     
-	std::transform( mWindow.begin(), mWindow.end(), tframp.begin(),
-					mCplxWin_W_Wtd.begin(), make_complex< double >() );	
+	std::transform( scaledWindow.begin(), scaledWindow.end(), tframp.begin(),
+					windows.cplxWin_W_Wtd.begin(), make_complex< double >() );	
 }
 
+// ---------------------------------------------------------------------------
+//	kaiserWindows (private)
+// ---------------------------------------------------------------------------
+//	Return the windows built from a Kaiser window of the specified length
+//	and shape, and its time derivative. Windows built recently are kept 
+//	(strongly, so that analyses repeated with the same parameters find 
+//	them) and shared by all instances, the computations of the Bessel
+//	functions are not repeated, and every thread of an analysis uses the
+//	same window buffers.
+//
+std::shared_ptr< const ReassignmentWindows > 
+ReassignedSpectrum::kaiserWindows( unsigned long length, double shape )
+{
+    std::lock_guard< std::mutex > lock( s_windowsMutex );
+    
+    for ( std::vector< CachedWindows >::iterator it = s_windowsCache.begin(); 
+          it != s_windowsCache.end(); ++it )
+    {
+        if ( it->length == length && it->shape == shape )
+        {
+            //  most recently used last:
+            std::rotate( it, it + 1, s_windowsCache.end() );
+            return s_windowsCache.back().windows;
+        }
+    }
+    
+    std::vector< double > window( length );
+    KaiserWindow::buildWindow( window, shape );
+    
+    std::vector< double > windowDeriv( length );
+    KaiserWindow::buildTimeDerivativeWindow( windowDeriv, shape );
+    
+    std::shared_ptr< ReassignmentWindows > windows( new ReassignmentWindows );
+    buildReassignmentWindows( window, windowDeriv, *windows );
+    
+    if ( s_windowsCache.size() >= MaxCachedWindows )
+    {
+        s_windowsCache.erase( s_windowsCache.begin() );
+    }
+    CachedWindows cached = { length, shape, windows };
+    s_windowsCache.push_back( cached );
+    
+    return windows;
+}
 
 }	//	end of namespace Loris
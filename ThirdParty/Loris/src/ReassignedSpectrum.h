@@ -34,11 +34,14 @@
  */
 
 #include "FourierTransform.h"
+#include <memory>
 #include <vector>
 
 //	begin namespace
 namespace Loris {
 
+struct ReassignmentWindows;
+
 // ---------------------------------------------------------------------------
 //	class ReassignedSpectrum
 //
@@ -67,7 +70,48 @@ public:
 	ReassignedSpectrum( const std::vector< double > & window,
                         const std::vector< double > & windowDerivative );
     
-	// compiler-generated copy, assign, and destroy are sufficient
+    //! Construct a new instance using a Kaiser window of the specified 
+    //! length and shape, and its time derivative (see KaiserWindow).
+    //! The windows are built once for every length and shape (the few
+    //! used last are kept) and are shared, read-only, by all instances 
+    //! using them, so spectra of a concurrent analysis, or of analyses 
+    //! repeated with the same window, build and store them only once.
+    //!	Transform lengths are the smallest power of two greater than twice the
+    //!	window length, unless transformLength is specified (see
+    //!	transformLength()).
+	ReassignedSpectrum( unsigned long windowLength, double kaiserShape,
+	                    size_type transformLength = 0 );
+    
+	// compiler-generated copy, assign, and destroy are sufficient,
+	// copies share the windows
+
+//	--- transform lengths ---
+
+    //! How transformLength() rounds a padded window length up.
+    enum LengthRounding
+    {
+        PowerOfTwo,     //!< to the next power of two (the default)
+        FastLength      //!< to the next even length transformed fast
+                        //!< (see FourierTransform::fastLength)
+    };
+
+    //! Return the length of the transforms of a window, zero-padded 
+    //! to at least oversampling times its length, and rounded up. 
+    //! The defaults give the length used unless one is specified, 
+    //! the smallest power of two not less than twice the window length.
+    //! Less padding, or rounding to fast lengths, gives shorter
+    //! transforms that are computed faster, at the expense of coarser
+    //! sampled spectra (the reassigned frequencies are not quantized
+    //! to the transform bins, an oversampling of 1 often suffices).
+    //!
+    //! \param  windowLength is the length of the window in samples
+    //! \param  oversampling is the zero-padding factor, at least 1
+    //! \param  rounding is how the padded length is rounded up
+    //! \return the transform length
+    //! \throw  InvalidArgument if oversampling is less than 1
+    static size_type transformLength( unsigned long windowLength, 
+                                      double oversampling = 2.,
+                                      LengthRounding rounding = PowerOfTwo );
 
 //	--- operations ---
 
@@ -89,6 +133,26 @@ public:
     //!         samples
 	void transform( const double * sampsBegin, const double * pos, const double * sampsEnd );
 	
+    //!	Compute the reassigned Fourier transform of the single precision
+    //!	samples on the half open range [sampsBegin, sampsEnd), aligning 
+    //!	sampCenter with the center of the analysis window. The samples 
+    //!	are converted as they are windowed, the transform is computed in 
+    //!	double precision.
+    //!
+    //! \param  sampsBegin pointer representing the beginning of 
+    //!         the (half-open) range of samples to transform
+    //! \param  sampCenter the sample in the range that is to be 
+    //!         aligned with the center of the analysis window
+    //! \param  sampsEnd pointer representing the end of 
+    //!         the (half-open) range of samples to transform
+    //!
+    //! \pre    sampsBegin must not be past sampCenter
+    //! \pre    sampsEnd must be past sampCenter
+    //! \post   the transform buffers store the reassigned 
+    //!         short-time transform data for the specified 
+    //!         samples
+	void transform( const float * sampsBegin, const float * pos, const float * sampsEnd );
+	
 //	--- inquiry ---
 
     //! Return the length of the Fourier transforms.
@@ -161,6 +225,24 @@ public:
     //!	that's the kind of ramp we used on our window.
 	double timeCorrection( long sample ) const;
 
+    //! Compute reassignment data of the transform indices in the half-open
+    //! range [begin, end) in one pass over the transform buffers, two
+    //! indices at a time. For each index, the arrays receive the same
+    //! values as reassignedFrequency() and reassignedTime() return, and
+    //! the squared magnitude (the square of reassignedMagnitude()).
+    //!
+    //! \param  begin the first frequency sample to evaluate
+    //! \param  end the frequency sample past the last one to evaluate
+    //! \param  frequencies receives end - begin reassigned frequencies
+    //!         in fractional frequency samples
+    //! \param  times receives end - begin time corrections in 
+    //!         fractional samples
+    //! \param  powers receives end - begin squared magnitudes
+    //!
+    //! \pre    0 < begin <= end < size()
+    void reassignBins( long begin, long end, double * frequencies,
+                       double * times, double * powers ) const;
+
 //	--- legacy support ---
 
     //  These members are deprecated, and included only
@@ -181,6 +263,14 @@ public:
 	
 private:
 
+//	-- transform helpers --
+
+    //	Compute the reassigned Fourier transform of samples of either 
+    //	precision, see transform().
+    template< class Sample >
+    void transformSamples( const Sample * sampsBegin, const Sample * sampCenter, 
+                           const Sample * sampsEnd );
+
 //	-- window building helpers --
 
     //	Build a pair of complex-valued windows, one having the frequency-ramp 
@@ -190,7 +280,8 @@ private:
     //  in the imaginary part.
     //
     //  Input is the unmodified window function.
-    void buildReassignmentWindows( const std::vector< double > & window );
+    static void buildReassignmentWindows( const std::vector< double > & window,
+                                          ReassignmentWindows & windows );
     
     //	Build a pair of complex-valued windows, one having the frequency-ramp 
     //  (time-derivative) window in the real part and the time-ramp window in the 
@@ -200,8 +291,14 @@ private:
     //
     //  Input is the unmodified window function and its time derivative, so the
     //  DFT kludge is unnecessary.
-    void buildReassignmentWindows( const std::vector< double > & window,
-                                   const std::vector< double > & windowDerivative );    
+    static void buildReassignmentWindows( const std::vector< double > & window,
+                                          const std::vector< double > & windowDerivative,
+                                          ReassignmentWindows & windows );    
+    
+    //  Return the windows built from a Kaiser window of the specified length
+    //  and shape, from the cache shared by all instances if they were built
+    //  recently.
+    static std::shared_ptr< const ReassignmentWindows > kaiserWindows( unsigned long length, double shape );
 
 //	-- instance variables --
 
@@ -211,16 +308,9 @@ private:
 	//! the FourierTransform for computing time and frequency corrections
 	FourierTransform mCorrectionTransform;
 	
-	//! the original short-time analysis window samples
-	std::vector< double > mWindow;                          //  W(n)
-	
-	//! the complex window used to compute the 
-    //! magnitude/phase transform
-	std::vector< std::complex< double > > mCplxWin_W_Wtd;   //  real W(n), imag nW'(n)
-
-	//! the complex window used to compute the 
-    //! time/frequency correction transform
-	std::vector< std::complex< double > > mCplxWin_Wd_Wt;   //  real W'(n), imag nW(n)
+	//! the analysis windows, never modified, possibly shared
+	//! with other instances
+	std::shared_ptr< const ReassignmentWindows > mWindows;
 		
 };	//	end of class ReassignedSpectrum
 
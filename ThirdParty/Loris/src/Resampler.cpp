@@ -92,7 +92,9 @@ TODO
 //
 Resampler::Resampler( double sampleInterval ) :
     interval_( sampleInterval ),
-    phaseCorrect_( true )
+    phaseCorrect_( true ),
+    numThreads_( 1 ),
+    phasesFixed_( false )
 {
     if ( sampleInterval <= 0. )
     {
@@ -137,7 +139,7 @@ void Resampler::setPhaseCorrect( bool correctPhase )
 void 
 Resampler::resample( Partial & p ) const
 {
-	debugger << "resampling Partial labeled " << p.label()
+	LORIS_DEBUGGER << "resampling Partial labeled " << p.label()
 	         << " having " << p.numBreakpoints() 
 			 << " Breakpoints" << endl;
 
@@ -162,7 +164,7 @@ Resampler::resample( Partial & p ) const
 	//	store the new Partial:
 	p = newp;
     
-	debugger << "resampled Partial has " << p.numBreakpoints() 
+	LORIS_DEBUGGER << "resampled Partial has " << p.numBreakpoints() 
 			 << " Breakpoints" << endl;
     
     
@@ -198,7 +200,7 @@ Resampler::resample( Partial & p ) const
 void 
 Resampler::resample( Partial & p, const LinearEnvelope & timingEnv ) const
 {
-	debugger << "resampling Partial labeled " << p.label()
+	LORIS_DEBUGGER << "resampling Partial labeled " << p.label()
 	         << " having " << p.numBreakpoints() 
 			 << " Breakpoints" << endl;
 
@@ -214,17 +216,20 @@ Resampler::resample( Partial & p, const LinearEnvelope & timingEnv ) const
 	double firstInsertTime = interval_ * int( 0.5 + timingEnv.begin()->first / interval_ );
     double lastInsertTime = (--timingEnv.end())->first + ( 0.5 * interval_ );
 	
-	//  resample:
+	//  resample, the timing envelope is swept forward, and so
+	//  is the Partial unless the timing envelope turns back:
+	EnvelopeCursor timing( timingEnv );
+	PartialCursor sampler( p );
 	for (  double insertTime = firstInsertTime; 
 	       insertTime <= lastInsertTime; 
 	       insertTime += interval_ ) 
 	{
 	    //  sample time is obtained from the timing envelope, if specified, 
 	    //  otherwise same as the insert time:
-	    double sampleTime = timingEnv.valueAt( insertTime );	    	            
+	    double sampleTime = timing.valueAt( insertTime );	    	            
         
         //  make a resampled Breakpoint:
-        Breakpoint newbp = p.parametersAt( sampleTime );
+        Breakpoint newbp = sampler.parametersAt( sampleTime );
                 
         Partial::iterator ret_pos = newp.insert( insertTime, newbp );
                 
@@ -260,7 +265,7 @@ Resampler::resample( Partial & p, const LinearEnvelope & timingEnv ) const
 	//	store the new Partial:
     p = newp;
     
-    debugger << "resampled Partial has " << p.numBreakpoints() 
+    LORIS_DEBUGGER << "resampled Partial has " << p.numBreakpoints() 
 			 << " Breakpoints" << endl;
 }
 
@@ -278,7 +283,7 @@ Resampler::resample( Partial & p, const LinearEnvelope & timingEnv ) const
 //
 void Resampler::quantize( Partial & p ) const
 {
-	debugger << "quantizing Partial labeled " << p.label()
+	LORIS_DEBUGGER << "quantizing Partial labeled " << p.label()
 	         << " having " << p.numBreakpoints() 
 			 << " Breakpoints" << endl;
 
@@ -288,15 +293,18 @@ void Resampler::quantize( Partial & p ) const
     //  unless the phases start correct), then quantize the Breakpoint
     //  times, then afterwards, adjust the frequencies to match
     //  the interpolated phases:
-    if ( phaseCorrect_ )
+    if ( phaseCorrect_ && ! phasesFixed_ )
     {
-        fixPhaseForward( p.begin(), --p.end() );
+        fixPhases( p );
     }
 
 	//	create the new Partial:
 	Partial newp;
 	newp.setLabel( p.label() );
 	
+	//  the quantized times increase with the Breakpoint times, 
+	//  the Partial is sampled by a cursor sweeping it forward:
+	PartialCursor sampler( p );
 	Partial::const_iterator iter = p.begin();        
 	while( iter != p.end() )
 	{            
@@ -325,7 +333,7 @@ void Resampler::quantize( Partial & p ) const
             //  sample the Partial with a long fade time so that 
             //  the amplitudes at the ends keep their original values:
             const double a_long_time = 1.;
-            Breakpoint newbp = p.parametersAt( qt, a_long_time );
+            Breakpoint newbp = sampler.parametersAt( qt, a_long_time );
             Partial::iterator new_pos = newp.insert( qt, newbp );
             
             //  tricky: if the quantized position (iter) is a null Breakpoint, 
@@ -358,13 +366,30 @@ void Resampler::quantize( Partial & p ) const
     }
     
     
-	debugger << "quantized Partial has " << newp.numBreakpoints() 
+	LORIS_DEBUGGER << "quantized Partial has " << newp.numBreakpoints() 
 			 << " Breakpoints" << endl;
 
 	//	store the new Partial:
 	p = newp;
 }
 
+// ---------------------------------------------------------------------------
+//	fixPhases
+// ---------------------------------------------------------------------------
+//! Fix the phases of the specified Partial forward from its 
+//! first Breakpoint, the first step of phase-correct 
+//! quantization. It does not depend on the resampling interval.
+//!
+//! \param  p is the Partial to fix
+//
+void Resampler::fixPhases( Partial & p ) const
+{
+    if ( p.numBreakpoints() != 0 )
+    {
+        fixPhaseForward( p.begin(), --p.end() );
+    }
+}
+
 // ---------------------------------------------------------------------------
 //	insert_resampled_at (helper)
 // ---------------------------------------------------------------------------
@@ -389,8 +414,8 @@ insert_resampled_at( Partial & newp, const Partial & p,
     
     Partial::iterator ret_pos = newp.insert( insertTime, newbp );
     
-    debugger << "inserted Breakpoint having amplitude " << newbp.amplitude() 
-             << " at time " << insertTime << endl;
+    LORIS_DEBUGGER << "inserted Breakpoint having amplitude " << newbp.amplitude() 
+                   << " at time " << insertTime << endl;
              
     return ret_pos;             
 }
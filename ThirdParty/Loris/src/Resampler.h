@@ -39,6 +39,7 @@
 
 #include "PartialList.h"
 #include "LinearEnvelope.h"
+#include "ParallelFor.h"
 
 //	begin namespace
 namespace Loris {
@@ -97,6 +98,28 @@ public:
     //!         (if true) frequency/phase correction should be
     //!         applied after resampling.
     void setPhaseCorrect( bool correctPhase );
+    
+    //! Return the number of threads used to resample or quantize
+    //! sequences of Partials, 0 for one per hardware core. 
+    //! Default is 1.
+    unsigned int numThreads( void ) const { return numThreads_; }
+    
+    //! Set the number of threads used to resample or quantize
+    //! sequences of Partials, 0 for one per hardware core.
+    //! Partials are resampled independently, so the result 
+    //! does not depend on the number of threads. Default is 1.
+    void setNumThreads( unsigned int n ) { numThreads_ = n; }
+    
+    //! Return true if phase-correct quantization takes the phases
+    //! of Partials as already fixed by fixPhases. Default is false.
+    bool phasesFixed( void ) const { return phasesFixed_; }
+    
+    //! Specify that Partials given to quantize have their phases
+    //! fixed by fixPhases already, so phase-correct quantization
+    //! does not fix them again. Fixing phases does not depend on
+    //! the resampling interval, Partials fixed once can be quantized
+    //! for several intervals. Default is false.
+    void setPhasesFixed( bool fixed ) { phasesFixed_ = fixed; }
     	
 //	--- resampling ---
 
@@ -154,6 +177,13 @@ public:
     //!
     //! \param  p is the Partial to resample
     void quantize( Partial & p ) const;
+    
+    //! Fix the phases of the specified Partial forward from its 
+    //! first Breakpoint, the first step of phase-correct 
+    //! quantization. It does not depend on the resampling interval.
+    //!
+    //! \param  p is the Partial to fix
+    void fixPhases( Partial & p ) const;
 
 	 
 	//! Resample all Partials in the specified (half-open) range using this
@@ -245,6 +275,23 @@ public:
    inline 
 	void quantize( PartialList::iterator begin, PartialList::iterator end  ) const;
 #endif	 
+
+    //! Fix the phases of all Partials in the specified (half-open) 
+    //! range, see fixPhases( Partial & ).
+    //!	
+    //!	\param begin is the beginning of the range of Partials to fix
+    //!	\param end is (one-past) the end of the range of Partials to fix
+    //!	
+    //!	If compiled with NO_TEMPLATE_MEMBERS defined, then begin and end
+    //!	must be PartialList::iterators, otherwise they can be any type
+    //!	of iterators over a sequence of Partials.
+#if ! defined(NO_TEMPLATE_MEMBERS)
+	template<typename Iter>
+	void fixPhases( Iter begin, Iter end ) const;
+#else
+   inline 
+	void fixPhases( PartialList::iterator begin, PartialList::iterator end  ) const;
+#endif	 
    	 
 // -- static members --
 
@@ -291,6 +338,12 @@ private:
     //! boolean flag selecting phase-corrected resampling
     //! (default is true)
     bool phaseCorrect_;
+    
+    unsigned int numThreads_;
+    
+    //! boolean flag telling that quantized Partials have their
+    //! phases fixed already (default is false)
+    bool phasesFixed_;
 	
 };	//	end of class Resampler
 
@@ -321,10 +374,8 @@ inline
 void Resampler::resample( PartialList::iterator begin, PartialList::iterator end  ) const
 #endif	 
 {
-	while ( begin != end )
-	{
-		resample( *begin++ );
-	}
+	parallelForEach( begin, end, numThreads_,
+	                 [this]( Partial & p ) { resample( p ); } );
 }
 
 // ---------------------------------------------------------------------------
@@ -358,10 +409,8 @@ void Resampler::resample( PartialList::iterator begin, PartialList::iterator end
                           const LinearEnvelope & timingEnv  ) const
 #endif	 
 {
-	while ( begin != end )
-	{
-		resample( *begin++, timingEnv );
-	}
+	parallelForEach( begin, end, numThreads_,
+	                 [&]( Partial & p ) { resample( p, timingEnv ); } );
 }
 
 // ---------------------------------------------------------------------------
@@ -387,10 +436,33 @@ inline
 void Resampler::quantize( PartialList::iterator begin, PartialList::iterator end  ) const
 #endif	 
 {
-	while ( begin != end )
-	{
-		quantize( *begin++ );
-	}
+	parallelForEach( begin, end, numThreads_,
+	                 [this]( Partial & p ) { quantize( p ); } );
+}
+
+// ---------------------------------------------------------------------------
+//	fixPhases (sequence of Partials)
+// ---------------------------------------------------------------------------
+//! Fix the phases of all Partials in the specified (half-open) 
+//! range, see fixPhases( Partial & ).
+//!	
+//!	\param begin is the beginning of the range of Partials to fix
+//!	\param end is (one-past) the end of the range of Partials to fix
+//!	
+//!	If compiled with NO_TEMPLATE_MEMBERS defined, then begin and end
+//!	must be PartialList::iterators, otherwise they can be any type
+//!	of iterators over a sequence of Partials.
+//
+#if ! defined(NO_TEMPLATE_MEMBERS)
+template<typename Iter>
+void Resampler::fixPhases( Iter begin, Iter end ) const
+#else
+inline 
+void Resampler::fixPhases( PartialList::iterator begin, PartialList::iterator end  ) const
+#endif	 
+{
+	parallelForEach( begin, end, numThreads_,
+	                 [this]( Partial & p ) { fixPhases( p ); } );
 }
 
 
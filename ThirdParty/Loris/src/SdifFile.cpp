@@ -78,8 +78,10 @@ SDIF spec: http://www.cnmat.berkeley.edu/SDIF/
 #endif
 
 #include "SdifFile.h"
+#include "BigEndian.h"
 #include "LorisExceptions.h"
 #include "Notifier.h"
+#include "ParallelFor.h"
 #include "Partial.h"
 #include "PartialList.h"
 #include "PartialPtrs.h"
@@ -87,6 +89,7 @@ SDIF spec: http://www.cnmat.berkeley.edu/SDIF/
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <list>
 #include <string>
 #include <vector>
@@ -301,8 +304,6 @@ static SDIFresult SDIF_Write1(const void *block, size_t n, FILE *f) {
 static SDIFresult SDIF_Write2(const void *block, size_t n, FILE *f) {
 #if !defined(WORDS_BIGENDIAN)
     SDIFresult r;
-    const char *q = (const char *)block;
-    int	i, m = 2*n;
 
     if ((n << 1) > BUFSIZE) {
 	/* Too big for buffer */
@@ -311,13 +312,10 @@ static SDIFresult SDIF_Write2(const void *block, size_t n, FILE *f) {
 	return SDIF_Write2(((char *) block) + (num<<1), n-num, f);
     }
 
-    for (i = 0; i < m; i += 2) {
-	p[i] = q[i+1];
-	p[i+1] = q[i];
-    }
-
-    return (fwrite(p,2,n,f)==n) ? ESDIF_SUCCESS : ESDIF_WRITE_FAILED;
+    memcpy(p, block, n << 1);
+    BigEndian::swap(n, 2, p);
 
+    return (fwrite(p,2,n,f) == n) ? ESDIF_SUCCESS : ESDIF_WRITE_FAILED;
 #else
     return (fwrite (block,2,n,f) == n) ? ESDIF_SUCCESS : ESDIF_WRITE_FAILED;
 #endif
@@ -328,23 +326,16 @@ static SDIFresult SDIF_Write2(const void *block, size_t n, FILE *f) {
 static SDIFresult SDIF_Write4(const void *block, size_t n, FILE *f) {
 #if !defined(WORDS_BIGENDIAN)
     SDIFresult r;
-   const char *q = (const char *)block;
-    int i, m = 4*n;
 
-    if ((n << 2) > BUFSIZE) 
-    {
-		int num = BUFSIZE >> 2;
-		if (r = SDIF_Write4(block, num, f)) return r;
-		return SDIF_Write4(((char *) block) + (num<<2), n-num, f);
+    if ((n << 2) > BUFSIZE) {
+	/* Too big for buffer */
+	int num = BUFSIZE >> 2;
+	if (r = SDIF_Write4(block, num, f)) return r;
+	return SDIF_Write4(((char *) block) + (num<<2), n-num, f);
     }
 
-    for (i = 0; i < m; i += 4) 
-    {
-		p[i] = q[i+3];
-		p[i+3] = q[i];
-		p[i+1] = q[i+2];
-		p[i+2] = q[i+1];
-    }
+    memcpy(p, block, n << 2);
+    BigEndian::swap(n, 4, p);
 
     return (fwrite(p,4,n,f) == n) ? ESDIF_SUCCESS : ESDIF_WRITE_FAILED;
 #else
@@ -357,25 +348,16 @@ static SDIFresult SDIF_Write4(const void *block, size_t n, FILE *f) {
 static SDIFresult SDIF_Write8(const void *block, size_t n, FILE *f) {
 #if !defined(WORDS_BIGENDIAN)
     SDIFresult r;
-   const char *q = (const char *)block;
-    int i, m = 8*n;
 
     if ((n << 3) > BUFSIZE) {
+	/* Too big for buffer */
 	int num = BUFSIZE >> 3;
 	if (r = SDIF_Write8(block, num, f)) return r;
 	return SDIF_Write8(((char *) block) + (num<<3), n-num, f);
     }
 
-    for (i = 0; i < m; i += 8) {
-	p[i] = q[i+7];
-	p[i+7] = q[i];
-	p[i+1] = q[i+6];
-	p[i+6] = q[i+1];
-	p[i+2] = q[i+5];
-	p[i+5] = q[i+2];
-	p[i+3] = q[i+4];
-	p[i+4] = q[i+3];
-    }
+    memcpy(p, block, n << 3);
+    BigEndian::swap(n, 8, p);
 
     return (fwrite(p,8,n,f) == n) ? ESDIF_SUCCESS : ESDIF_WRITE_FAILED;
 #else
@@ -390,24 +372,11 @@ static SDIFresult SDIF_Read1(void *block, size_t n, FILE *f) {
 
 
 static SDIFresult SDIF_Read2(void *block, size_t n, FILE *f) {
-
 #if !defined(WORDS_BIGENDIAN)
-    SDIFresult r;
-    char *q = (char *)block;
-    int i, m = 2*n;
+    /* Read in place and swap the whole block at once */
+    if (fread(block,2,n,f) != n) return ESDIF_READ_FAILED;
 
-    if ((n << 1) > BUFSIZE) {
-	int num = BUFSIZE >> 1;
-	if (r = SDIF_Read2(block, num, f)) return r;
-	return SDIF_Read2(((char *) block) + (num<<1), n-num, f);
-    }
-
-    if (fread(p,2,n,f) != n) return ESDIF_READ_FAILED;
-
-    for (i = 0; i < m; i += 2) {
-	q[i] = p[i+1];
-	q[i+1] = p[i];
-    }
+    BigEndian::swap(n, 2, (char *)block);
 
     return ESDIF_SUCCESS;
 #else
@@ -419,27 +388,12 @@ static SDIFresult SDIF_Read2(void *block, size_t n, FILE *f) {
 
 static SDIFresult SDIF_Read4(void *block, size_t n, FILE *f) {
 #if !defined(WORDS_BIGENDIAN)
-    SDIFresult r;
-    char *q = (char *)block;
-    int i, m = 4*n;
+    /* Read in place and swap the whole block at once */
+    if (fread(block,4,n,f) != n) return ESDIF_READ_FAILED;
 
-    if ((n << 2) > BUFSIZE) {
-	int num = BUFSIZE >> 2;
-	if (r = SDIF_Read4(block, num, f)) return r;
-	return SDIF_Read4(((char *) block) + (num<<2), n-num, f);
-    }
-
-    if (fread(p,4,n,f) != n) return ESDIF_READ_FAILED;
-
-    for (i = 0; i < m; i += 4) {
-	q[i] = p[i+3];
-	q[i+3] = p[i];
-	q[i+1] = p[i+2];
-	q[i+2] = p[i+1];
-    }
+    BigEndian::swap(n, 4, (char *)block);
 
     return ESDIF_SUCCESS;
-
 #else
     return (fread(block,4,n,f) == n) ? ESDIF_SUCCESS : ESDIF_READ_FAILED;
 #endif
@@ -449,31 +403,12 @@ static SDIFresult SDIF_Read4(void *block, size_t n, FILE *f) {
 
 static SDIFresult SDIF_Read8(void *block, size_t n, FILE *f) {
 #if !defined(WORDS_BIGENDIAN)
-    SDIFresult r;
-    char *q = (char *)block;
-    int i, m = 8*n;
+    /* Read in place and swap the whole block at once */
+    if (fread(block,8,n,f) != n) return ESDIF_READ_FAILED;
 
-    if ((n << 3) > BUFSIZE) {
-	int num = BUFSIZE >> 3;
-	if (r = SDIF_Read8(block, num, f)) return r;
-	return SDIF_Read8(((char *) block) + (num<<3), n-num, f);
-    }
-
-    if (fread(p,8,n,f) != n) return ESDIF_READ_FAILED;
-
-    for (i = 0; i < m; i += 8) {
-	q[i] = p[i+7];
-	q[i+7] = p[i];
-	q[i+1] = p[i+6];
-	q[i+6] = p[i+1];
-	q[i+2] = p[i+5];
-	q[i+5] = p[i+2];
-	q[i+3] = p[i+4];
-	q[i+4] = p[i+3];
-    }
+    BigEndian::swap(n, 8, (char *)block);
 
     return ESDIF_SUCCESS;
-
 #else
     return (fread(block,8,n,f) == n) ? ESDIF_SUCCESS : ESDIF_READ_FAILED;
 #endif
@@ -880,7 +815,7 @@ static SDIFresult SDIF_CloseRead(FILE *f) {
 
 // import_sdif reads SDIF data from the specified file path and
 // stores data in its PartialList and MarkerContainer arguments.
-static void import_sdif( const std::string &, SdifFile::partials_type &, 
+static void import_sdif( const std::string &, unsigned int, SdifFile::partials_type &, 
 						 SdifFile::markers_type & );
 
 // export_sdif writes the data in its  PartialList and MarkerContainer 
@@ -893,11 +828,13 @@ static void export_sdif( const std::string &, const SdifFile::partials_type &,
 //	SdifFile constructor from filename
 // ---------------------------------------------------------------------------
 //	Initialize an instance of SdifFile by importing Partial data from 
-//	from the file having the specified filename or path.
+//	from the file having the specified filename or path. Partials are
+//	built from the rows read from the file in numThreads threads, 0
+//	for one per hardware core.
 //
-SdifFile::SdifFile( const std::string & filename )
+SdifFile::SdifFile( const std::string & filename, unsigned int numThreads )
 {
-	import_sdif( filename, partials_, markers_ );
+	import_sdif( filename, numThreads, partials_, markers_ );
 }
 
 // ---------------------------------------------------------------------------
@@ -1029,7 +966,7 @@ public:
 		const char* errPtr = error_string_array[errNum];								\
 		if (errPtr)																\
 		{																		\
-	        debugger << "SDIF error " << errPtr << endl;						\
+	        LORIS_DEBUGGER << "SDIF error " << errPtr << endl;						\
 			std::string s(report);												\
 			s.append(", SDIF error message: ");									\
 			s.append(errPtr);													\
@@ -1038,6 +975,21 @@ public:
 	}	
 
 // -- SDIF reading helpers --
+// ---------------------------------------------------------------------------
+//	TrackRows
+// ---------------------------------------------------------------------------
+//	Rows of Loris matrices having the same partial index, collected in
+//	the order they are read. Partials are built from them after the 
+//	whole file is read, independently of each other.
+//
+struct TrackRows
+{
+	std::vector< std::pair< double, Breakpoint > > breakpoints;
+	int label;
+	
+	TrackRows( void ) : label( 0 ) {}
+};
+
 // ---------------------------------------------------------------------------
 //	processRow64
 // ---------------------------------------------------------------------------
@@ -1045,7 +997,7 @@ public:
 //
 static void
 processRow64( const sdif_signature msig, const RowOfLorisData64 & rowData, const double frameTime, 
-				  std::vector< Partial > & partialsVector )
+				  std::vector< TrackRows > & tracksVector )
 {	
 
 //
@@ -1057,25 +1009,26 @@ processRow64( const sdif_signature msig, const RowOfLorisData64 & rowData, const
 //
 // Make sure we have enough partials for this partial's index.
 //
-	if (partialsVector.size() <= rowData.index)
+	if (tracksVector.size() <= rowData.index)
 	{
-		partialsVector.resize( long(rowData.index) + 500 );
+		tracksVector.resize( long(rowData.index) + 500 );
 	}
 
 //
-// Create a new breakpoint and insert it.
+// Create a new breakpoint and collect it for insertion.
 //	
 	if (SDIF_Char4Eq(msig, lorisEnhancedSignature) || SDIF_Char4Eq(msig, lorisSineOnlySignature)) 
 	{
 		Breakpoint newbp( rowData.freqOrLabel, rowData.amp, rowData.noise, rowData.phase );
-		partialsVector[long(rowData.index)].insert( frameTime + rowData.timeOffset, newbp );
+		tracksVector[long(rowData.index)].breakpoints.push_back( 
+			std::make_pair( frameTime + rowData.timeOffset, newbp ) );
 	}
 //
 // Set partial label.
 //
 	else if (SDIF_Char4Eq(msig, lorisLabelsSignature)) 
 	{
-		partialsVector[long(rowData.index)].setLabel( (int) rowData.freqOrLabel );
+		tracksVector[long(rowData.index)].label = (int) rowData.freqOrLabel;
 	}
 		
 }
@@ -1088,7 +1041,7 @@ processRow64( const sdif_signature msig, const RowOfLorisData64 & rowData, const
 //
 static void
 processRow32( const sdif_signature msig, const RowOfLorisData32 & rowData, const double frameTime, 
-				  std::vector< Partial > & partialsVector )
+				  std::vector< TrackRows > & tracksVector )
 {	
 
 //
@@ -1100,25 +1053,26 @@ processRow32( const sdif_signature msig, const RowOfLorisData32 & rowData, const
 //
 // Make sure we have enough partials for this partial's index.
 //
-	if (partialsVector.size() <= rowData.index)
+	if (tracksVector.size() <= rowData.index)
 	{
-		partialsVector.resize( long(rowData.index) + 500 );
+		tracksVector.resize( long(rowData.index) + 500 );
 	}
 
 //
-// Create a new breakpoint and insert it.
+// Create a new breakpoint and collect it for insertion.
 //	
 	if (SDIF_Char4Eq(msig, lorisEnhancedSignature) || SDIF_Char4Eq(msig, lorisSineOnlySignature)) 
 	{
 		Breakpoint newbp( rowData.freqOrLabel, rowData.amp, rowData.noise, rowData.phase );
-		partialsVector[long(rowData.index)].insert( frameTime + rowData.timeOffset, newbp );
+		tracksVector[long(rowData.index)].breakpoints.push_back( 
+			std::make_pair( frameTime + rowData.timeOffset, newbp ) );
 	}
 //
 // Set partial label.
 //
 	else if (SDIF_Char4Eq(msig, lorisLabelsSignature)) 
 	{
-		partialsVector[long(rowData.index)].setLabel( (int) rowData.freqOrLabel );
+		tracksVector[long(rowData.index)].label = (int) rowData.freqOrLabel;
 	}
 		
 }
@@ -1243,9 +1197,13 @@ readMarkers( FILE * file, SDIF_FrameHeader fh, SdifFile::markers_type & markersV
 // Let exceptions propagate.
 //
 static void
-readLorisMatrices( FILE *file, std::vector< Partial > & partialsVector, SdifFile::markers_type & markersVector )
+readLorisMatrices( FILE *file, std::vector< TrackRows > & tracksVector, SdifFile::markers_type & markersVector )
 {
 	SDIFresult ret;
+	
+	//	matrix data is read and byte-swapped a whole matrix at a time:
+	std::vector< sdif_float64 > matrixData64;
+	std::vector< sdif_float32 > matrixData32;
 
 //
 // Read all frames matching the file selection.
@@ -1288,37 +1246,48 @@ readLorisMatrices( FILE *file, std::vector< Partial > & partialsVector, SdifFile
 				continue;		
 			}
 			
-			// Read each row of matrix data.
-			for (int row = 0; row < mh.rowCount; row++)
+			// Read all matrix data at once, then each row of it.
+			const size_t numElements = size_t(mh.rowCount) * mh.columnCount;
+			if (mh.matrixDataType == SDIF_FLOAT64)
 			{
-			
-				if (mh.matrixDataType == SDIF_FLOAT64)
+				matrixData64.resize( numElements );
+				if (numElements > 0)
+				{
+					ret = SDIF_Read8(&matrixData64[0], numElements, file);
+					ThrowIfSdifError( ret, "Error reading SDIF file" );
+				}
+				
+				for (int row = 0; row < mh.rowCount; row++)
 				{
 					// Fill a rowData structure with one row from the matrix.
 					RowOfLorisData64 rowData64 = { 0.0 };
-					sdif_float64 *rowDataPtr = &rowData64.index;
-					for (int col = 1; col <= mh.columnCount; col++)
-					{
-						SDIF_Read8(rowDataPtr++,1,file);
-					}
+					const sdif_float64 *rowBegin = &matrixData64[0] + size_t(row) * mh.columnCount;
+					std::copy( rowBegin, rowBegin + mh.columnCount, &rowData64.index );
 					
 					// Add rowData as a new breakpoint in a partial, or,
 					// if its a RBEL matrix, read label mapping.
-					processRow64(mh.matrixType, rowData64, fh.time, partialsVector);
+					processRow64(mh.matrixType, rowData64, fh.time, tracksVector);
 				}
-				else
+			}
+			else
+			{
+				matrixData32.resize( numElements );
+				if (numElements > 0)
+				{
+					ret = SDIF_Read4(&matrixData32[0], numElements, file);
+					ThrowIfSdifError( ret, "Error reading SDIF file" );
+				}
+				
+				for (int row = 0; row < mh.rowCount; row++)
 				{
 					// Fill a rowData structure with one row from the matrix.
 					RowOfLorisData32 rowData32 = { 0.0 };
-					sdif_float32 *rowDataPtr = &rowData32.index;
-					for (int col = 1; col <= mh.columnCount; col++)
-					{
-						SDIF_Read4(rowDataPtr++,1,file);
-					}
+					const sdif_float32 *rowBegin = &matrixData32[0] + size_t(row) * mh.columnCount;
+					std::copy( rowBegin, rowBegin + mh.columnCount, &rowData32.index );
 					
 					// Add rowData as a new breakpoint in a partial, or,
 					// if its a RBEL matrix, read label mapping.
-					processRow32(mh.matrixType, rowData32, fh.time, partialsVector);
+					processRow32(mh.matrixType, rowData32, fh.time, tracksVector);
 				}
 			}
 			
@@ -1342,6 +1311,7 @@ readLorisMatrices( FILE *file, std::vector< Partial > & partialsVector, SdifFile
 // Let exceptions propagate.
 //
 static void import_sdif( const std::string &infilename, 
+						 unsigned int numThreads,
 						 SdifFile::partials_type & partials, 
 						 SdifFile::markers_type & markers)
 {
@@ -1372,17 +1342,34 @@ static void import_sdif( const std::string &infilename,
 	try 
 	{
 	
-		// Build up partialsVector.
-		std::vector< Partial > partialsVector;
+		// Collect rows of each partial index.
+		std::vector< TrackRows > tracksVector;
 		SdifFile::markers_type markersVector;
-		readLorisMatrices( file, partialsVector, markersVector );
+		readLorisMatrices( file, tracksVector, markersVector );
+		
+		// Build up partialsVector, Breakpoints are inserted in the 
+		// order they were read, the same as if they were inserted
+		// while reading.
+		std::vector< Partial > partialsVector( tracksVector.size() );
+		parallelFor( tracksVector.size(), numThreads,
+		             [&]( std::size_t i ) 
+		             {
+		                 TrackRows & track = tracksVector[i];
+		                 for (size_t k = 0; k < track.breakpoints.size(); ++k)
+		                 {
+		                     partialsVector[i].insert( track.breakpoints[k].first, 
+		                                               track.breakpoints[k].second );
+		                 }
+		                 partialsVector[i].setLabel( track.label );
+		                 std::vector< std::pair< double, Breakpoint > >().swap( track.breakpoints );
+		             } );
 		
-		// Copy partialsVector to partials list.
+		// Move partialsVector to partials list.
 		for (int i = 0; i < partialsVector.size(); ++i)
 		{
 			if (partialsVector[i].numBreakpoints() > 0)
 			{
-				partials.push_back( partialsVector[i] );
+				partials.push_back( std::move( partialsVector[i] ) );
 			}
 		}
 		
@@ -111,7 +111,12 @@ public:
 
     //! Initialize an instance of SdifFile by importing Partial data from
     //! the file having the specified filename or path.
- 	explicit SdifFile( const std::string & filename );
+    //!
+    //! Rows of the file are read a whole matrix at a time, the Partials
+    //! are built from them afterwards in numThreads threads, 0 for one 
+    //! per hardware core. Partials are built independently, so they do
+    //! not depend on the number of threads. Default is 1.
+ 	explicit SdifFile( const std::string & filename, unsigned int numThreads = 1 );
  
     //! Initialize an instance of SdifFile with copies of the Partials
     //! on the specified half-open (STL-style) range.
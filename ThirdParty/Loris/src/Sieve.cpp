@@ -40,11 +40,16 @@
 #include "Breakpoint.h"
 #include "LorisExceptions.h"
 #include "Notifier.h"
+#include "ParallelFor.h"
 #include "Partial.h"
 #include "PartialList.h"
 #include "PartialUtils.h"
 
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <utility>
+#include <vector>
 
 //	begin namespace
 namespace Loris {
@@ -65,7 +70,8 @@ namespace Loris {
 //!   \throw  InvalidArgument if partialFadeTime is negative.
 //
 Sieve::Sieve( double partialFadeTime ) :
-	_fadeTime( partialFadeTime )
+	_fadeTime( partialFadeTime ),
+	_numThreads( 1 )
 {
 	if ( _fadeTime < 0.0 )
 	{
@@ -77,15 +83,23 @@ Sieve::Sieve( double partialFadeTime ) :
 //	to Partials by label (increasing) and duration (decreasing), so
 //	that Partial ptrs are arranged by label, with the lowest labels
 //	first, and then with the longest Partials having each label
-//	before the shorter ones.
+//	before the shorter ones. Partials of the same duration are
+//	arranged by start time, so the one kept does not depend on 
+//	the other Partials sorted (see Distiller::setSifting).
 struct SortPartialPtrs :
 	public std::binary_function< const Partial *, const Partial *, bool >
 {
 	bool operator()( const Partial * lhs, const Partial * rhs ) const 
 		{ 
-			return 	( lhs->label() != rhs->label() ) ?
-					( lhs->label() < rhs->label() ) :
-					( lhs->duration() > rhs->duration() );
+			if ( lhs->label() != rhs->label() )
+			{
+				return lhs->label() < rhs->label();
+			}
+			if ( lhs->duration() != rhs->duration() )
+			{
+				return lhs->duration() > rhs->duration();
+			}
+			return lhs->startTime() < rhs->startTime();
 		}
 };
 
@@ -103,60 +117,44 @@ struct PartialPtrLabelNE :
 
 
 // ---------------------------------------------------------------------------
-//	find_overlapping (template function)
+//	KeptPartials (helper class)
 // ---------------------------------------------------------------------------
-//	Iterate over a range of Partials (presumably) with same labeling.
-//	The range is specified by iterators over a collection of pointers
-//	to Partials (not Partials themselves). Return the first position
-//	in the specified range corresponding to a Partial that overlaps
-//	(in time) the specified Partial, p, or the end of the range if
-//	no Partials in the range overlap.
+//	Time intervals of the Partials of one label that are kept by sifting,
+//	for finding the one overlapping a Partial in logarithmic time.
 //
 //	Overlap is defined by the minimum time gap between Partials
 //	(minGapTime), so Partials that have less then minGapTime
-//	between them are considered overlapping.
+//	between them are considered overlapping. Kept Partials do not
+//	overlap each other, so they are in the same order by start time
+//	and by end time. They are indexed by end time, and the only one
+//	that can overlap a Partial is the first one ending after the
+//	Partial starts (less the gap).
 //
-template <typename Iter>	//	Iter is the position of a Partial *
-Iter
-find_overlapping( Partial & p, double minGapTime, Iter start, Iter end)
+class KeptPartials
 {
-	for ( Iter it = start; it != end; ++it ) 
+public:
+	//	Return true if a kept Partial overlaps p.
+	bool overlaps( const Partial & p, double minGapTime ) const
 	{
-		//	skip if other partial is already sifted out.
-		if ( (*it)->label() == 0 )
-			continue;
+		std::multimap< double, double >::const_iterator it = 
+			_startByEnd.upper_bound( p.startTime() - minGapTime );
+		if ( it == _startByEnd.end() )
+			return false;
 		
-		//	skip the source Partial:
-		//	(identity test: compare addresses)
-		//	(this is a sanity check, should not happen since
-		//	src should be at position end)
-		Assert( (*it) != &p );
-
 		//  test for overlap:
-		if ( p.startTime() < (*it)->endTime() + minGapTime &&
-			 p.endTime() + minGapTime > (*it)->startTime() )
-		{
-			//  Does the overlapping Partial have longer duration?
-			//	(this should never be true, since the Partials
-			//	are sorted by duration)
-			Assert( p.duration() <= (*it)->duration() );
-			
-#if Debug_Loris
-			debugger << "Partial starting " << p.startTime() << ", " 
-					 << p.begin().breakpoint().frequency() << " ending " 
-					 << p.endTime()  << ", " << (--p.end()).breakpoint().frequency() 
-					 << " zapped by overlapping Partial starting " 
-					 << (*it)->startTime() << ", " << (*it)->begin().breakpoint().frequency()
-					 << " ending " << (*it)->endTime() << ", " 
-					 << (--(*it)->end()).breakpoint().frequency()  << endl;
-#endif
-			return it;
-		}
+		return p.startTime() < it->first + minGapTime &&
+			   p.endTime() + minGapTime > it->second;
 	}
 	
-	//	no overlapping Partial found:
-	return end;
-}
+	//	Keep p, it must not overlap any kept Partial.
+	void keep( const Partial & p )
+	{
+		_startByEnd.insert( std::make_pair( p.endTime(), p.startTime() ) );
+	}
+	
+private:
+	std::multimap< double, double > _startByEnd;
+};
 
 // ---------------------------------------------------------------------------
 //	sift_ptrs (private helper)
@@ -185,9 +183,13 @@ Sieve::sift_ptrs( PartialPtrs & ptrs  )
 	PartialPtrs::iterator sift_begin = ptrs.begin();
 	PartialPtrs::iterator sift_end = ptrs.end();
 
-	int zapped = 0;
+	std::atomic< int > zapped( 0 );
 	
-	// 	iterate over labels and sift each one:
+	//	ranges of Partials having the same (non-zero) label,
+	//	sifted concurrently:
+	std::vector< std::pair< PartialPtrs::iterator, PartialPtrs::iterator > > labels;
+	
+	// 	iterate over labels and collect each one:
 	PartialPtrs::iterator lowerbound = sift_begin;
 	while ( lowerbound != sift_end )
 	{
@@ -198,37 +200,48 @@ Sieve::sift_ptrs( PartialPtrs & ptrs  )
 		PartialPtrs::iterator upperbound = 
 			std::find_if( lowerbound, sift_end, PartialPtrLabelNE(label) );
 
-#ifdef Debug_Loris
-		//	don't want to compute this iterator distance unless debugging:
-		debugger << "sifting Partials labeled " << label << endl;
-		debugger << "Sieve found " << std::distance( lowerbound, upperbound ) << 
+		//	the iterator distance is computed only when debugging:
+		LORIS_DEBUGGER << "sifting Partials labeled " << label << endl;
+		LORIS_DEBUGGER << "Sieve found " << std::distance( lowerbound, upperbound ) << 
 					" Partials labeled " << label << endl;
-#endif
 		//  sift all partials with this label, unless the
 		//	label is 0:
 		if ( label != 0 )
 		{
-			PartialPtrs::iterator it;
-			for ( it = lowerbound; it != upperbound; ++it ) 
-			{
-				//	find_overlapping only needs to consider Partials on the
-				//	half-open range [lowerbound, it), because all 
-				//	Partials after it are shorter, thanks to the
-				//	sorting of the sift_set:
-				if( it != find_overlapping( **it, minGapTime, lowerbound, it ) )
-				{
-					(*it)->setLabel(0);
-					++zapped;
-				}
-			} 
+			labels.push_back( std::make_pair( lowerbound, upperbound ) );
 		}
 		
 		//	advance Partial set iterator:
 		lowerbound = upperbound;
 	}
+	
+	parallelFor( labels.size(), _numThreads, [&]( std::size_t i )
+	{
+		PartialPtrs::iterator lowerbound = labels[ i ].first;
+		PartialPtrs::iterator upperbound = labels[ i ].second;
+		PartialPtrs::iterator it;
+		
+		//	only the Partials before it need to be considered,
+		//	because all Partials after it are shorter, thanks to
+		//	the sorting of the sift_set; the ones already sifted
+		//	out are not kept:
+		KeptPartials kept;
+		for ( it = lowerbound; it != upperbound; ++it ) 
+		{
+			if ( kept.overlaps( **it, minGapTime ) )
+			{
+				(*it)->setLabel(0);
+				++zapped;
+			}
+			else
+			{
+				kept.keep( **it );
+			}
+		} 
+	} );
 
 #ifdef Debug_Loris
-	debugger << "Sifted out (relabeled) " << zapped << " of " << ptrs.size() << "." << endl;
+	LORIS_DEBUGGER << "Sifted out (relabeled) " << zapped.load() << " of " << ptrs.size() << "." << endl;
 #endif
 }
 
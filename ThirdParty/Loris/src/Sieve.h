@@ -74,6 +74,9 @@ class Sieve
                       //! a Partial when determining overlap, to accomodate 
                       //! the fade to and from zero amplitude.
     
+    unsigned int _numThreads; //! number of threads sifting labels, 0 for
+                              //! one per hardware core, default is 1
+    
 //  -- public interface --
 public:
 
@@ -112,6 +115,18 @@ public:
      
     //  Use compiler-generated copy, assign, and destroy.
     
+//  -- parameters --
+
+    //! Return the number of threads used to sift Partials,
+    //! 0 for one per hardware core. Default is 1.
+    unsigned int numThreads( void ) const { return _numThreads; }
+    
+    //! Set the number of threads used to sift Partials, 0 for
+    //! one per hardware core. Partials having different labels are
+    //! sifted independently, so the result does not depend on the 
+    //! number of threads. Default is 1.
+    void setNumThreads( unsigned int n ) { _numThreads = n; }
+    
 //  -- sifting --
 
     //! Sift labeled Partials on the specified half-open (STL-style)
@@ -0,0 +1,196 @@
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * Simplifier.C
+ *
+ * Implementation of class Simplifier.
+ *
+ */
+
+#if HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
+#include "Simplifier.h"
+#include "Breakpoint.h"
+#include "LorisExceptions.h"
+#include "Notifier.h"
+#include "phasefix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(HAVE_M_PI) && (HAVE_M_PI)
+	const double Pi = M_PI;
+#else
+	const double Pi = 3.14159265358979324;
+#endif
+
+//	begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//	Simplifier constructor
+// ---------------------------------------------------------------------------
+//! Construct a new Simplifier.
+//!
+//!   \param   cents is the frequency tolerance in cents.
+//!   \param   dB is the amplitude tolerance in dB.
+//!   \throw   InvalidArgument if a tolerance is negative.
+//
+Simplifier::Simplifier( double cents, double dB ) :
+	_cents( cents ),
+	_dB( dB ),
+	_numThreads( 1 )
+{
+	if ( cents < 0 || dB < 0 )
+	{
+		Throw( InvalidArgument, "Simplifier tolerances must not be negative." );
+	}
+}
+
+// ---------------------------------------------------------------------------
+//	simplify
+// ---------------------------------------------------------------------------
+//! Remove the Breakpoints of a Partial that its envelopes do not
+//! need, and fix the frequencies of the ones left so that synthesis
+//! matches their phases.
+//!
+//! \param  p is the Partial to simplify in-place
+//! \return the number of Breakpoints removed
+//
+std::size_t
+Simplifier::simplify( Partial & p ) const
+{
+	const std::size_t n = p.numBreakpoints();
+	if ( n < 3 )
+	{
+		return 0;
+	}
+
+	std::vector< double > times;
+	std::vector< Breakpoint > bps;
+	times.reserve( n );
+	bps.reserve( n );
+	for ( Partial::const_iterator it = p.begin(); it != p.end(); ++it )
+	{
+		times.push_back( it.time() );
+		bps.push_back( it.breakpoint() );
+	}
+
+	//	nulls are phase resets, they and the Breakpoints on
+	//	both sides of them stay where they are
+	std::vector< bool > fixed( n, false );
+	fixed.front() = fixed.back() = true;
+	for ( std::size_t i = 0; i < n; ++i )
+	{
+		if ( 0 == bps[ i ].amplitude() )
+		{
+			fixed[ i ] = true;
+			fixed[ i - ( i > 0 ) ] = true;
+			fixed[ std::min( i + 1, n - 1 ) ] = true;
+		}
+	}
+
+	//	logarithms of the tolerance ratios, an error in phase (radians)
+	//	or in bandwidth (moving energy between sinusoid and noise) is
+	//	as large as the amplitude tolerance, amplitudes below the floor
+	//	of analysis are all the same
+	const double maxLogFrequency = _cents * std::log( 2. ) / 1200.;
+	const double maxLogAmplitude = _dB * std::log( 10. ) / 20.;
+	const double maxBandwidth = 1. - std::pow( 10., -0.1 * _dB );
+	const double maxPhase = std::exp( maxLogAmplitude ) - 1.;
+	const double amplitudeFloor = std::pow( 10., -90. / 20. );
+
+	//	true if the Breakpoints between first and last are on the
+	//	line joining them, and the phase travelled along it (up to
+	//	last) stays with the one travelled along the envelopes
+	auto fits = [&]( std::size_t first, std::size_t last )
+	{
+		const Breakpoint & a = bps[ first ];
+		const Breakpoint & b = bps[ last ];
+		double travel = 0;
+		for ( std::size_t k = first + 1; k <= last; ++k )
+		{
+			const double alpha = ( times[ k ] - times[ first ] ) / ( times[ last ] - times[ first ] );
+			const Breakpoint & bp = bps[ k ];
+			const double f = a.frequency() + alpha * ( b.frequency() - a.frequency() );
+			const double amp = a.amplitude() + alpha * ( b.amplitude() - a.amplitude() );
+			const double bw = a.bandwidth() + alpha * ( b.bandwidth() - a.bandwidth() );
+
+			travel += Pi * ( bps[ k - 1 ].frequency() + bp.frequency() ) * ( times[ k ] - times[ k - 1 ] );
+			const double lineTravel = Pi * ( a.frequency() + f ) * ( times[ k ] - times[ first ] );
+			if ( std::fabs( lineTravel - travel ) > maxPhase )
+			{
+				return false;
+			}
+
+			if ( k < last &&
+				 ( std::fabs( std::log( f / bp.frequency() ) ) > maxLogFrequency ||
+				   ( std::fabs( amp - bp.amplitude() ) > amplitudeFloor &&
+					 std::fabs( std::log( amp / bp.amplitude() ) ) > maxLogAmplitude ) ||
+				   std::fabs( bw - bp.bandwidth() ) > maxBandwidth ) )
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	//	from each kept Breakpoint, keep the farthest one the line
+	//	to which fits all the Breakpoints in between
+	std::vector< bool > kept( n, false );
+	kept.front() = true;
+	std::size_t last = 0;
+	while ( last < n - 1 )
+	{
+		std::size_t next = last + 1;
+		while ( ! fixed[ next ] && next + 1 - last <= MaxRun && fits( last, next + 1 ) )
+		{
+			++next;
+		}
+		kept[ next ] = true;
+		last = next;
+	}
+
+	Partial simplified;
+	simplified.setLabel( p.label() );
+	for ( std::size_t i = 0; i < n; ++i )
+	{
+		if ( kept[ i ] )
+		{
+			simplified.insert( times[ i ], bps[ i ] );
+		}
+	}
+
+	const std::size_t removed = n - simplified.numBreakpoints();
+	if ( removed > 0 )
+	{
+		//	the phases are reached by frequencies within the tolerance
+		fixFrequency( simplified, 100. * ( std::exp( maxLogFrequency ) - 1. ) );
+		p = simplified;
+	}
+	return removed;
+}
+
+}	//	end of namespace Loris
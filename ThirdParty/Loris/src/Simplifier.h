@@ -0,0 +1,144 @@
+#ifndef INCLUDE_SIMPLIFIER_H
+#define INCLUDE_SIMPLIFIER_H
+/*
+ * This is the Loris C++ Class Library, implementing analysis,
+ * manipulation, and synthesis of digitized sounds using the Reassigned
+ * Bandwidth-Enhanced Additive Sound Model.
+ *
+ * Loris is Copyright (c) 1999-2010 by Kelly Fitz and Lippold Haken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * Simplifier.h
+ *
+ * Definition of class Simplifier.
+ *
+ */
+
+#include "ParallelFor.h"
+#include "Partial.h"
+#include "PartialList.h"
+
+#include <cstddef>
+
+//  begin namespace
+namespace Loris {
+
+// ---------------------------------------------------------------------------
+//  class Simplifier
+//
+//! A Simplifier removes the Breakpoints of Partials that linear
+//! interpolation between their neighbors reproduces.
+//!
+//! Analysis yields a Breakpoint per hop for every Partial, even where
+//! its envelopes are nearly straight for long stretches. A Simplifier
+//! keeps, from each kept Breakpoint, the farthest later one such that
+//! every Breakpoint in between deviates from the line joining them by
+//! no more than a frequency tolerance in cents and an amplitude
+//! tolerance in dB. The phase travelled along the line and bandwidth
+//! (as a fraction of energy) may deviate as much as the amplitude
+//! tolerance. The ends of Partials and null Breakpoints, with their
+//! neighbors, are always kept, and runs are at most MaxRun
+//! Breakpoints long.
+//!
+//! Phases of the kept Breakpoints are not changed: their frequencies
+//! are adjusted by fixFrequency (by at most the frequency tolerance)
+//! so that synthesis reaches them. Phases should be made consistent
+//! first (see Resampler::fixPhases).
+//!
+//!   \sa Pruner, Resampler
+//
+class Simplifier
+{
+//  -- instance variables --
+
+    double _cents;                  //! frequency tolerance in cents
+    double _dB;                     //! amplitude tolerance in dB
+    unsigned int _numThreads;       //! threads simplifying sequences
+                                    //! of Partials, 0 for one per core
+
+//  -- public interface --
+public:
+
+//  -- global defaults and constants --
+
+    enum
+    {
+        //! Longest run of Breakpoints replaced by a line: a kept
+        //! Breakpoint is at most MaxRun Breakpoints after the last one.
+        MaxRun = 32
+    };
+
+    //! Default frequency and amplitude tolerances, about the smallest
+    //! changes heard in steady tones.
+    static double defaultCents( void ) { return 5.; }
+    static double defaultDb( void ) { return 0.5; }
+
+//  -- construction --
+
+    //! Construct a new Simplifier.
+    //!
+    //!   \param   cents is the frequency tolerance in cents.
+    //!   \param   dB is the amplitude tolerance in dB.
+    //!   \throw   InvalidArgument if a tolerance is negative.
+    explicit Simplifier( double cents = defaultCents(), double dB = defaultDb() );
+
+    //  Use compiler-generated copy, assign, and destroy.
+
+//  -- access --
+
+    //! Return the frequency tolerance in cents.
+    double cents( void ) const { return _cents; }
+
+    //! Return the amplitude tolerance in dB.
+    double dB( void ) const { return _dB; }
+
+    //! Return the number of threads used to simplify sequences
+    //! of Partials.
+    unsigned int numThreads( void ) const { return _numThreads; }
+
+    //! Set the number of threads used to simplify sequences of
+    //! Partials, 0 for one per hardware core. Partials are simplified
+    //! independently, so the result does not depend on the number of
+    //! threads. Default is 1.
+    void setNumThreads( unsigned int n ) { _numThreads = n; }
+
+//  -- simplification --
+
+    //! Remove the Breakpoints of a Partial that its envelopes do not
+    //! need, and fix the frequencies of the ones left so that synthesis
+    //! matches their phases.
+    //!
+    //! \param  p is the Partial to simplify in-place
+    //! \return the number of Breakpoints removed
+    std::size_t simplify( Partial & p ) const;
+
+    //! Simplify all Partials in the specified (half-open) range.
+    //!
+    //! \param  begin is the beginning of the range of Partials
+    //! \param  end is (one-past) the end of the range of Partials
+    template< typename Iter >
+    void simplify( Iter begin, Iter end ) const
+    {
+        parallelForEach( begin, end, _numThreads,
+                         [this]( Partial & p ) { simplify( p ); } );
+    }
+
+};  //  end of class Simplifier
+
+}   //  end of namespace Loris
+
+#endif /* ndef INCLUDE_SIMPLIFIER_H */
@@ -58,6 +58,7 @@
 #include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <memory>
 
 #if defined(HAVE_M_PI) && (HAVE_M_PI)
     const double Pi = M_PI;
@@ -556,30 +557,87 @@ static double envExp( long intValue )
 }   //  end of envExp( )
 
 // ---------------------------------------------------------------------------
-//  getPhaseRefTime
+//  envExpMagnitude( )
 // ---------------------------------------------------------------------------
-//  Find the time at which to reference phase.
-//  The time will be shortly after amplitude onset, if we are before the onset.
+//  Return envExp() of the 7-bit log magnitude in the top 8 bits of a 24-bit 
+//  packed value. There are only 128 of them, computed once, so decoding a
+//  file does not exponentiate every magnitude.
 //
-static double getPhaseRefTime( int label, const Partial & p, double time  )
+static double envExpMagnitude( long packed )
 {
-// Keep array of previous values to optimize spc export.
-// This depends on this routine being called in increasing-time order.
-    static double prevPRT[LargestLabel + 1];
-    if ( prevPRT[label] > time && time > spcEI.startTime )
-        return prevPRT[ label ]; 
-            
-// Go forward to nonzero amplitude.
-    while ( p.amplitudeAt( time, Fade ) < spcEI.ampEpsilon && time < spcEI.endTime + spcEI.hop)
+    struct Table
+    {
+        double values[128];
+        Table( void )
+        {
+            for ( long j = 0; j < 128; ++j )
+                values[j] = envExp( j << 9 );
+        }
+    };
+    static const Table table;
+
+    //  (packed >> 7) & 0xfe00, shifted down by 9 bits:
+    return table.values[ (packed >> 16) & 0x7f ];
+}
+
+// ---------------------------------------------------------------------------
+//  EnvelopeSweep
+// ---------------------------------------------------------------------------
+//  Parameters of a Partial at the frame times of the export, which increase
+//  from frame to frame. Cursors walk forward through the Breakpoints, so a
+//  frame does not search the envelope, and the values at the end of the
+//  Partial and of the export, used near the end, are evaluated once.
+//
+struct EnvelopeSweep
+{
+    explicit EnvelopeSweep( const Partial & p ) :
+        partial( p ),
+        cursor( p ),
+        search( p ),
+        atPartialEnd( p.parametersAt( p.endTime(), Fade ) ),
+        atEnd( p.parametersAt( spcEI.endTime, Fade ) )
     {
-        time += spcEI.hop;
     }
+    
+    void advance( double time );
+    
+    const Partial & partial;
+    PartialCursor cursor;       //  evaluates the frame times
+    PartialCursor search;       //  evaluates the search for the phase reference time
+    Breakpoint atPartialEnd;    //  parameters at the end of the Partial
+    Breakpoint atEnd;           //  parameters at the end of the export
+    Breakpoint atTime;          //  parameters at the frame time
+    Breakpoint atRef;           //  parameters at the phase reference time
+    double phaseRefTime = 0.;
+};
 
-    prevPRT[ label ] = time;
+// ---------------------------------------------------------------------------
+//  advance
+// ---------------------------------------------------------------------------
+//  Evaluate the Partial at the time of the next frame and find the time at 
+//  which to reference phase. The time will be shortly after amplitude onset,
+//  if we are before the onset.
+//
+void EnvelopeSweep::advance( double time )
+{
+    atTime = cursor.parametersAt( time, Fade );
 
-// Use phase value at initial onset time.
-    return time;
-        
+//  Keep the previous time while it is ahead, the first frame searches.
+    if ( phaseRefTime > time && time > spcEI.startTime )
+        return; 
+            
+//  Go forward to nonzero amplitude.
+    double refTime = time;
+    double amp = atTime.amplitude();
+    while ( amp < spcEI.ampEpsilon && refTime < spcEI.endTime + spcEI.hop)
+    {
+        refTime += spcEI.hop;
+        amp = search.parametersAt( refTime, Fade ).amplitude();
+    }
+
+//  Use phase value at initial onset time.
+    phaseRefTime = refTime;
+    atRef = ( refTime == time ) ? atTime : search.parametersAt( refTime, Fade );
 }
 
 // ---------------------------------------------------------------------------
@@ -587,7 +645,7 @@ static double getPhaseRefTime( int label, const Partial & p, double time  )
 // ---------------------------------------------------------------------------
 //  Find amplitude, frequency, bandwidth, phase value.  
 //
-static void afbp( const Partial & p, double time, double phaseRefTime,
+static void afbp( const EnvelopeSweep & sweep, double time, 
                   double magMult, double freqMult, 
                   double & amp, double & freq, double & bw, double & phase)
 {   
@@ -598,33 +656,37 @@ static void afbp( const Partial & p, double time, double phaseRefTime,
 // Compute weighting factor between "normal" envelope point and static point.
     if ( spcEI.endApproachTime && time > spcEI.endTime - spcEI.endApproachTime )
     {
+        const Partial & p = sweep.partial;
+        const Breakpoint * bp = &sweep.atTime;
         if ( time > p.endTime() && p.endTime() > spcEI.endTime - 2 * spcEI.hop)
+        {
             time = p.endTime();
+            bp = &sweep.atPartialEnd;
+        }
         double wt = ( spcEI.endTime - time ) / spcEI.endApproachTime;
-        amp   = magMult  * ( wt * p.amplitudeAt( time, Fade ) + 
-                             (1.0 - wt) * p.amplitudeAt( spcEI.endTime, Fade )  );
-        freq  = freqMult * ( wt * p.frequencyAt( time ) + (1.0 - wt) * p.frequencyAt( spcEI.endTime )  );
-        bw    =            ( wt * p.bandwidthAt( time ) + (1.0 - wt) * p.bandwidthAt( spcEI.endTime )  );
-        phase = p.phaseAt( time );
+        amp   = magMult  * ( wt * bp->amplitude() + (1.0 - wt) * sweep.atEnd.amplitude() );
+        freq  = freqMult * ( wt * bp->frequency() + (1.0 - wt) * sweep.atEnd.frequency() );
+        bw    =            ( wt * bp->bandwidth() + (1.0 - wt) * sweep.atEnd.bandwidth() );
+        phase = bp->phase();
     }
     
 // If we are before the phase reference time, or on the final frame,
 // use zero amp and offset phase.
-    else if ( time < phaseRefTime - spcEI.hop / 2 || time > spcEI.endTime - spcEI.hop / 2 )
+    else if ( time < sweep.phaseRefTime - spcEI.hop / 2 || time > spcEI.endTime - spcEI.hop / 2 )
     {
         amp = 0.;
-        freq = freqMult * p.frequencyAt( phaseRefTime );
+        freq = freqMult * sweep.atRef.frequency();
         bw = 0.;
-        phase = p.phaseAt( phaseRefTime ) - 2. * Pi * (phaseRefTime - time) * freq;
+        phase = sweep.atRef.phase() - 2. * Pi * (sweep.phaseRefTime - time) * freq;
     }
     
 // Use envelope values at "time".
     else
     {
-        amp = magMult * p.amplitudeAt( time, Fade );
-        freq = freqMult * p.frequencyAt( time );
-        bw = p.bandwidthAt( time );
-        phase = p.phaseAt( time );
+        amp = magMult * sweep.atTime.amplitude();
+        freq = freqMult * sweep.atTime.frequency();
+        bw = sweep.atTime.bandwidth();
+        phase = sweep.atTime.phase();
     }
 }
 
@@ -715,10 +777,8 @@ static void packEnvelopes( const SpcFile::partials_type & partials,
 //  Assert( partials.size() == spcEI.fileNumPartials );
 
     int frames = int( ( spcEI.endTime - spcEI.startTime ) / spcEI.hop ) + 1;
-    unsigned long dataSize = 
-        frames * spcEI.fileNumPartials * ( 24 / 8 ) * (spcEI.enhanced ? 2 : 1);
-    bytes.clear();
-    bytes.reserve( dataSize );
+    const int valueBytes = ( 24 / 8 ) * (spcEI.enhanced ? 2 : 1);
+    unsigned long dataSize = frames * spcEI.fileNumPartials * valueBytes;
     
     // get the reference partial; the lowest-nonzero-labeled partial with any breakpoints
     SpcFile::partials_type::const_iterator pos = 
@@ -728,57 +788,72 @@ static void packEnvelopes( const SpcFile::partials_type & partials,
     int refLabel = refPar.label();
     Assert( (refLabel - 1) == (pos - partials.begin()) );
     
-    // write out one frame at a time:
-    for (double tim = spcEI.startTime; tim <= spcEI.endTime; tim += spcEI.hop ) 
+    //  one sweep for every partial with breakpoints, the labels
+    //  of the empty ones frequency-multiply the reference partial,
+    //  (index sweeps by label - 1, the pad partials too):
+    std::vector< std::unique_ptr< EnvelopeSweep > > sweeps( spcEI.fileNumPartials );
+    std::vector< double > freqMults( spcEI.fileNumPartials, 1. );
+    std::vector< double > magMults( spcEI.fileNumPartials, 1. );
+    std::vector< const EnvelopeSweep * > labelSweeps( spcEI.fileNumPartials );
+    for (int label = 1; label <= spcEI.fileNumPartials; ++label ) 
     {
+#ifndef PO2
+        if ( label <= (int) partials.size() && partials[ label - 1 ].size() != 0 )
+#else
+        if ( partials[ label - 1 ].size() != 0 )
+#endif
+        {
+            sweeps[ label - 1 ].reset( new EnvelopeSweep( partials[ label - 1 ] ) );
+        }
+    }
+    for (int label = 1; label <= spcEI.fileNumPartials; ++label ) 
+    {
+        if ( sweeps[ label - 1 ] )
+        {
+            labelSweeps[ label - 1 ] = sweeps[ label - 1 ].get();
+        }
+        else
+        {
+            labelSweeps[ label - 1 ] = sweeps[ refLabel - 1 ].get();
+            freqMults[ label - 1 ] = (double) label / (double) refLabel; 
+            magMults[ label - 1 ] = 0.0;
+        }
+    }
+    
+    //  frames are packed into the buffer in place:
+    bytes.resize( dataSize );
+    Byte * out = bytes.data();
+    
+    // write out one frame at a time, as many as the header counts:
+    double tim = spcEI.startTime;
+    for ( int frame = 0; frame < frames; ++frame, tim += spcEI.hop ) 
+    {
+        for ( std::unique_ptr< EnvelopeSweep > & sweep : sweeps )
+        {
+            if ( sweep )
+                sweep->advance( tim );
+        }
+        
         //  for each frame, write one value for every partial:
         //  (this loop extends to the pad partials)
         for (unsigned int label = 1; label <= spcEI.fileNumPartials; ++label ) 
         {
+            //  find amplitude, frequency, bandwidth, phase value
             double amp, freq, bw, phase;
-            //  find partial with the correct label
-            //  if partial with the correct is empty, 
-            //  frequency-multiply the reference partial
-#ifndef PO2
-            if ( label > partials.size() || partials[ label - 1 ].size() == 0 )
-#else
-            if ( partials[ label - 1 ].size() == 0 )
-#endif
-            {
-                //  find the reference time for the phase
-                double phaseRefTime = getPhaseRefTime( label, refPar, tim );
-                
-                //  find amplitude, frequency, bandwidth, phase value
-                double freqMult = (double) label / (double) refLabel; 
-                double magMult = 0.0;
-                afbp( refPar, tim, phaseRefTime, magMult, freqMult, amp, freq, bw, phase );
-            }
-            else
-            {
-                //  find the reference time for the phase
-                double phaseRefTime = getPhaseRefTime( label, partials[ label - 1 ], tim );
-                
-                //  find amplitude, frequency, bandwidth, phase value
-                afbp( partials[ label - 1 ], tim, phaseRefTime, 1, 1, amp, freq, bw, phase );
-            }
+            afbp( *labelSweeps[ label - 1 ], tim, magMults[ label - 1 ], freqMults[ label - 1 ], 
+                  amp, freq, bw, phase );
             
             //  pack log amplitude and log frequency into 24-bit lval,
-            //  log bandwidth and phase into 24-bit rval:
-            Byte leftbytes[3], rightbytes[3];
-            pack( amp, freq, bw, phase, leftbytes, rightbytes);
-    
-            //  pack integer samples into the Byte vector without 
-            //  byte swapping, they are already correctly packed
-            //  (see pack above): 
-            bytes.insert( bytes.end(), leftbytes, leftbytes + 3 );
-            if ( spcEI.enhanced )
-            {
-                bytes.insert( bytes.end(), rightbytes, rightbytes + 3 );
-            }               
+            //  log bandwidth and phase into 24-bit rval, integer samples 
+            //  go into the Byte vector without byte swapping, they are 
+            //  already correctly packed (see pack above): 
+            Byte rightbytes[3];
+            pack( amp, freq, bw, phase, out, spcEI.enhanced ? out + 3 : rightbytes );
+            out += valueBytes;
         }
     }
     
-    Assert( bytes.size() == dataSize );
+    Assert( out == bytes.data() + bytes.size() );
 }
 
 // ---------------------------------------------------------------------------
@@ -1036,8 +1111,8 @@ configureExportStruct( const SpcFile::partials_type & plist, double midipitch,
     if ( spcEI.numPartials < 1 || spcEI.numPartials > LargestLabel )
         Throw( FileIOException, "Partials must be distilled and labeled between 1 and 512." );
 
-    debugger << "startTime = " << spcEI.startTime << " endTime = " << spcEI.endTime 
-             << " hop = " << spcEI.hop << " partials = " << spcEI.numPartials << endl;
+    LORIS_DEBUGGER << "startTime = " << spcEI.startTime << " endTime = " << spcEI.endTime 
+                   << " hop = " << spcEI.hop << " partials = " << spcEI.numPartials << endl;
 }
 
 // ---------------------------------------------------------------------------
@@ -1087,8 +1162,8 @@ processEnhancedPoint( Byte * leftbytes, Byte * rightbytes,
 // Unpack values.  
 //
     double freq = envExp( left & 0xffff ) * 22050.0;
-    double sineMag =     envExp( (left >> 7)  & 0xfe00 );
-    double noiseMag = envExp( (right >> 7) & 0xfe00 ) / 64.;
+    double sineMag =     envExpMagnitude( left );
+    double noiseMag = envExpMagnitude( right ) / 64.;
     double phase = ( right & 0xffff ) * ( 2. * Pi / 0xffff );
     
     double total = sineMag * sineMag + noiseMag * noiseMag;
@@ -1139,7 +1214,7 @@ processSineOnlyPoint( Byte * bytes,
 // Unpack values.  
 //
     double freq = envExp( packed & 0xffff ) * 22050.0;
-    double amp =     envExp( (packed >> 7)  & 0xfe00 );
+    double amp =     envExpMagnitude( packed );
     double noise = 0.;
     double phase = 0.;
 
@@ -1286,9 +1361,10 @@ SpcFile::readSpcData( const std::string & filename )
     partials_.clear();
     growPartials( numPartials );
     Byte * bytes = &soundDataChunk.sampleBytes.front();
+    const int numFilePartials = fileNumPartials( numPartials );
     for ( int frame = 0; frame < numFrames; ++frame ) 
     {
-        for ( int partial = 0; partial < fileNumPartials( numPartials ); ++partial )
+        for ( int partial = 0; partial < numFilePartials; ++partial )
         {
             if (enhanced)
             {
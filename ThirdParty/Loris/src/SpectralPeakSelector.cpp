@@ -45,6 +45,7 @@
 #include "ReassignedSpectrum.h"
 
 
+#include <algorithm>
 #include <cmath>    //  for abs and fabs
 
 
@@ -83,23 +84,149 @@ Peaks
 SpectralPeakSelector::selectPeaks( ReassignedSpectrum & spectrum, 
                                    double minFrequency )
 {
+    Peaks peaks;
+    selectPeaks( spectrum, minFrequency, peaks );
+    return peaks;
+}
+
+// ---------------------------------------------------------------------------
+//	selectPeaks
+// ---------------------------------------------------------------------------
+//	Collect the same peaks into the specified collection, replacing its
+//	contents but keeping its capacity.
+//
+void
+SpectralPeakSelector::selectPeaks( ReassignedSpectrum & spectrum, 
+                                   double minFrequency, Peaks & peaks )
+{
+    peaks.clear();
+    
 #if defined(USE_REASSIGNMENT_MINS) && USE_REASSIGNMENT_MINS
 
-    return selectReassignmentMinima( spectrum, minFrequency );
+    selectReassignmentMinima( spectrum, minFrequency, peaks );
     
 #else
 
-    return selectMagnitudePeaks( spectrum, minFrequency );
+    selectMagnitudePeaks( spectrum, minFrequency, peaks );
     
 #endif
 }
 
+// ---------------------------------------------------------------------------
+//	selectHarmonicPeaks
+// ---------------------------------------------------------------------------
+//	Collect the peaks within halfWidth of the harmonics of fundamental into
+//	the specified collection, replacing its contents but keeping its capacity.
+//
+//	Only the frequency samples that may hold a peak near a harmonic (with 
+//	two samples to spare on either side, for the changes of the frequency
+//	reassignment at the edges) are reassigned. Neighbourhoods are at most 
+//	half the fundamental wide on either side, so they do not overlap and 
+//	no peak is collected twice.
+//
+void
+SpectralPeakSelector::selectHarmonicPeaks( ReassignedSpectrum & spectrum, double minFrequency,
+                                           double fundamental, double halfWidth, Peaks & peaks )
+{
+	using namespace std; // for abs and fabs
+
+    peaks.clear();
+    if ( ! ( fundamental > 0 ) || ! ( halfWidth > 0 ) )
+    {
+        return;
+    }
+    halfWidth = min( halfWidth, 0.5 * fundamental );
+    
+	const double sampsToHz = mSampleRate / spectrum.size();
+	const double oneOverSR = 1. / mSampleRate;
+	const double maxCorrectionSamples = mMaxTimeOffset * mSampleRate;
+	
+	const long numBins = spectrum.size() / 2;
+	const long endBin = numBins - 2;
+    mFrequencies.resize( numBins );
+    mTimeCorrections.resize( numBins );
+    mPowers.resize( numBins );
+	const double * frequencies = mFrequencies.data();
+	
+	for ( long k = max( 1L, long( ceil( ( minFrequency - halfWidth ) / fundamental ) ) ); ; ++k )
+	{
+	    const double lower = max( k * fundamental - halfWidth, minFrequency );
+	    const double upper = k * fundamental + halfWidth;
+	    const long first = max( 1L, long( lower / sampsToHz ) - 2 );
+	    const long last = min( endBin, long( upper / sampsToHz ) + 3 );
+	    if ( first >= last )
+	    {
+	        break;
+	    }
+	    
+	    //  peaks at j are found from samples j and j + 1:
+	    spectrum.reassignBins( first, last + 1, &mFrequencies[ first ], 
+	                           &mTimeCorrections[ first ], &mPowers[ first ] );
+	    
+	    double fsample = frequencies[ first ];
+	    for ( long j = first; j < last; ++j )
+	    {
+	        //  same as selectReassignmentMinima:
+	        const double next_fsample = frequencies[ j+1 ];
+	        if ( fsample > j && next_fsample < j + 1 )
+	        {
+	            double freq;
+	            long peakidx;
+	            if ( (fsample-j) < (j+1-next_fsample) )
+	            {
+	                freq = fsample * sampsToHz;
+	                peakidx = j;
+	            }
+	            else
+	            {
+	                freq = next_fsample * sampsToHz;
+	                peakidx = j+1;
+	            }
+	            
+	            double timeCorrectionSamps = mTimeCorrections[ peakidx ];
+	            if ( freq >= lower && freq < upper && fabs(timeCorrectionSamps) < maxCorrectionSamples )
+	            {
+	                double mag = spectrum.reassignedMagnitude( peakidx );
+	                double phase = spectrum.reassignedPhase( peakidx );
+	                double bw = spectrum.convergence( j );
+	                double time = timeCorrectionSamps * oneOverSR;
+	                Breakpoint bp( freq, mag, bw, phase );
+	                peaks.push_back( SpectralPeak( time, bp ) );
+	            }
+	        }
+	        fsample = next_fsample;
+	    }
+	}
+}
+
+// ---------------------------------------------------------------------------
+//	reassignBins (private)
+// ---------------------------------------------------------------------------
+//  Compute reassigned frequencies, time corrections and squared
+//  magnitudes of the lower half of the spectrum into the arrays 
+//  (indexed by frequency sample) and return the number of frequency 
+//  samples computed. The spectrum computes all of them in one pass,
+//  instead of evaluating the transforms again for every bin.
+//
+long
+SpectralPeakSelector::reassignBins( const ReassignedSpectrum & spectrum )
+{
+    const long numBins = spectrum.size() / 2;
+    mFrequencies.resize( numBins );
+    mTimeCorrections.resize( numBins );
+    mPowers.resize( numBins );
+    
+    //  bin 0 is never used
+    spectrum.reassignBins( 1, numBins, &mFrequencies[1], &mTimeCorrections[1], &mPowers[1] );
+    return numBins;
+}
+
 // ---------------------------------------------------------------------------
 //	selectReassignmentMinima (private)
 // ---------------------------------------------------------------------------
-Peaks
+void
 SpectralPeakSelector::selectReassignmentMinima( ReassignedSpectrum & spectrum, 
-                                                double minFrequency )
+                                                double minFrequency, Peaks & peaks )
 {
 	using namespace std; // for abs and fabs
 
@@ -108,14 +235,17 @@ SpectralPeakSelector::selectReassignmentMinima( ReassignedSpectrum & spectrum,
 	const double minFreqSample = minFrequency / sampsToHz;
 	const double maxCorrectionSamples = mMaxTimeOffset * mSampleRate;
 	
-	Peaks peaks;
+	const long numBins = reassignBins( spectrum );
+	const double * frequencies = mFrequencies.data();
 	
 	int start_j = 1, end_j = (spectrum.size() / 2) - 2;
 	
 	double fsample = start_j;
 	do 
 	{
-	    fsample = spectrum.reassignedFrequency( start_j++ );
+	    fsample = ( start_j < numBins ) ? 
+	        frequencies[ start_j ] : spectrum.reassignedFrequency( start_j );
+	    ++start_j;
 	} while( fsample < minFreqSample );
 	
 	for ( int j = start_j; j < end_j; ++j ) 
@@ -124,7 +254,7 @@ SpectralPeakSelector::selectReassignmentMinima( ReassignedSpectrum & spectrum,
 	    // look for changes in the frequency reassignment,
 	    // from positive to negative correction, indicating
 	    // a concentration of energy in the spectrum:
-	    double next_fsample = spectrum.reassignedFrequency( j+1 );
+	    double next_fsample = frequencies[ j+1 ];
 	    if ( fsample > j && next_fsample < j + 1 )
 	    {
 	        //  choose the smaller correction of fsample or next_fsample:
@@ -147,7 +277,7 @@ SpectralPeakSelector::selectReassignmentMinima( ReassignedSpectrum & spectrum,
             if ( freq >= minFrequency )
             {            	         
                 //	keep only peaks with small time corrections:
-                double timeCorrectionSamps = spectrum.reassignedTime( peakidx );
+                double timeCorrectionSamps = mTimeCorrections[ peakidx ];
                 if ( fabs(timeCorrectionSamps) < maxCorrectionSamples )
                 {
                     double mag = spectrum.reassignedMagnitude( peakidx );
@@ -173,20 +303,17 @@ SpectralPeakSelector::selectReassignmentMinima( ReassignedSpectrum & spectrum,
 	}
     
 	/*
-	debugger << "SpectralPeakSelector::selectReassignmentMinima: found " 
+	LORIS_DEBUGGER << "SpectralPeakSelector::selectReassignmentMinima: found " 
              << peaks.size() << " peaks" << endl;
 	*/
-    	
-	return peaks;
-
 }
 
 // ---------------------------------------------------------------------------
 //	selectMagnitudePeaks (private)
 // ---------------------------------------------------------------------------
-Peaks
+void
 SpectralPeakSelector::selectMagnitudePeaks( ReassignedSpectrum & spectrum,
-                                            double minFrequency )
+                                            double minFrequency, Peaks & peaks )
 {
 	using namespace std; // for abs and fabs
 
@@ -195,28 +322,32 @@ SpectralPeakSelector::selectMagnitudePeaks( ReassignedSpectrum & spectrum,
 	const double minFreqSample = minFrequency / sampsToHz;
 	const double maxCorrectionSamples = mMaxTimeOffset * mSampleRate;
 	
-	Peaks peaks;
+	const long numBins = reassignBins( spectrum );
+	const double * frequencies = mFrequencies.data();
+	const double * powers = mPowers.data();
 	
 	int start_j = 1, end_j = (spectrum.size() / 2) - 2;
 	
 	double fsample = start_j;
 	do 
 	{
-	    fsample = spectrum.reassignedFrequency( start_j++ );
+	    fsample = ( start_j < numBins ) ? 
+	        frequencies[ start_j ] : spectrum.reassignedFrequency( start_j );
+	    ++start_j;
 	} while( fsample < minFreqSample );
 	
 	for ( int j = start_j; j < end_j; ++j ) 
 	{	 
-		if ( spectrum.reassignedMagnitude(j) > spectrum.reassignedMagnitude(j-1) && 
-			 spectrum.reassignedMagnitude(j) > spectrum.reassignedMagnitude(j+1) ) 
+	    //  squared magnitudes have the same peaks:
+		if ( powers[j] > powers[j-1] && powers[j] > powers[j+1] ) 
 		{				
 			//	skip low-frequency peaks:
-			double fsample = spectrum.reassignedFrequency( j );
+			double fsample = frequencies[ j ];
 			if ( fsample < minFreqSample )
 				continue;
 
 			//	skip peaks with large time corrections:
-			double timeCorrectionSamps = spectrum.reassignedTime( j );
+			double timeCorrectionSamps = mTimeCorrections[ j ];
 			if ( fabs(timeCorrectionSamps) > maxCorrectionSamples )
 				continue;
 				
@@ -239,10 +370,9 @@ SpectralPeakSelector::selectMagnitudePeaks( ReassignedSpectrum & spectrum,
 	}
 	
     /*
-	debugger << "SpectralPeakSelector::selectMagnitudePeaks: found " 
+	LORIS_DEBUGGER << "SpectralPeakSelector::selectMagnitudePeaks: found " 
              << peaks.size() << " peaks" << endl;
     */         		
-	return peaks;
 }
 
 
@@ -36,6 +36,8 @@
  
 #include "SpectralPeaks.h"
 
+#include <vector>
+
 //	begin namespace
 namespace Loris {
 
@@ -64,6 +66,20 @@ public:
     //  separate class, but for now, they are just separate functions.
     Peaks selectPeaks( ReassignedSpectrum & spectrum, double minFrequency = 0 );
     
+	//	Collect the same peaks into the specified collection, replacing its
+	//	contents. Its capacity is kept, so a collection reused for every
+	//	frame is allocated only when a frame has more peaks than any before.
+    void selectPeaks( ReassignedSpectrum & spectrum, double minFrequency, Peaks & peaks );
+    
+	//	Collect the peaks within halfWidth (in Hz, at most half the fundamental)
+	//	of the harmonics of fundamental (in Hz) into the specified collection,
+	//	replacing its contents, ignoring those having frequencies below the
+	//	specified minimum, and those having large time corrections. Only the
+	//	frequency samples around the harmonics are reassigned, the spectrum
+	//	between them is never evaluated. Reassignment minima are used.
+    void selectHarmonicPeaks( ReassignedSpectrum & spectrum, double minFrequency, 
+                              double fundamental, double halfWidth, Peaks & peaks );
+    
     	
 // --- implementation ---
 private:
@@ -73,14 +89,25 @@ private:
     //
     //  Currently, the reassignment minima are used.
     
-    Peaks selectReassignmentMinima( ReassignedSpectrum & spectrum, double minFrequency );
-    Peaks selectMagnitudePeaks( ReassignedSpectrum & spectrum, double minFrequency );
+    void selectReassignmentMinima( ReassignedSpectrum & spectrum, double minFrequency, Peaks & peaks );
+    void selectMagnitudePeaks( ReassignedSpectrum & spectrum, double minFrequency, Peaks & peaks );
+    
+    //  Compute reassigned frequencies, time corrections and squared
+    //  magnitudes of the lower half of the spectrum into the arrays
+    //  below (indexed by frequency sample) and return the number of
+    //  frequency samples computed.
+    long reassignBins( const ReassignedSpectrum & spectrum );
         
 
 // --- member data ---
 	
 	double mSampleRate;
 	double mMaxTimeOffset;
+	
+	//  reassignment data of the current spectrum, reused for every frame
+	std::vector< double > mFrequencies;     //  fractional frequency samples
+	std::vector< double > mTimeCorrections; //  fractional samples
+	std::vector< double > mPowers;          //  squared magnitudes
 
 	
 };	//	end of class SpectralPeakSelector
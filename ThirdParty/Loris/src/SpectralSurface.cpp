@@ -42,6 +42,7 @@
 #include "Partial.h"
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
 
 namespace Loris {
@@ -108,25 +109,30 @@ findemfaster( double freq, double time, const std::vector< Partial > & parray )
 		{
 			p1 = &parray[i];
 			cacheLastHit = i;
+			if ( i + 1 < parray.size() )
+			{
+				p2 = &parray[i+1];
+			}
+			else
+			{
+				p2 = 0;
+			}
 		}
 		else
 		{
+			//	below the lowest Partial, like searching up the list
 			p1 = 0;
+			p2 = &parray[0];
 			cacheLastHit = 0;
 		}
-		if ( i + 1 < parray.size() )
-		{
-			p2 = &parray[i+1];
-		}
-		else
-		{
-			p2 = 0;
-		}
 	}
 	// debugger << "findemfaster caching " <<  cacheLastHit << endl;
 	return std::make_pair(p1, p2);
 }
 
+//  Rows of the grid above the highest frequency of the surface.
+static const int GridRowsAbove = 10;
+
 // ---------------------------------------------------------------------------
 //    smoothInTime - local helper
 // ---------------------------------------------------------------------------
@@ -149,41 +155,52 @@ static double smoothInTime( const Partial & p, double t )
 }
 	
 // ---------------------------------------------------------------------------
-//    surfaceAt - local helper
+//    interpolateAt - local helper
 // ---------------------------------------------------------------------------
-static double surfaceAt( double f, double t, const std::vector< Partial > & parray )
+//  Interpolate the surface at frequency f between the Partial below
+//  (frequency f1, smoothed amplitude a1) and the one above (f2, a2),
+//  either of which may be missing.
+//
+static double interpolateAt( double f, bool below, double f1, double a1,
+                             bool above, double f2, double a2 )
 {
-	std::pair< const Partial *, const Partial * > both = findemfaster( f, t, parray );
-	const Partial * p1 = both.first;
-	const Partial * p2 = both.second;
-	
 	double moo1 = 0, moo2 = 0, interp = 0;
 	
-	if ( 0 != p1 && 0 != p2 )
+	if ( below && above )
 	{
-		interp = (f - p1->frequencyAt( t )) / ( p2->frequencyAt( t ) - p1->frequencyAt( t ) );
-		moo1 = smoothInTime( *p1, t );
-		moo2 = smoothInTime( *p2, t );
+		interp = (f - f1) / ( f2 - f1 );
+		moo1 = a1;
+		moo2 = a2;
 	}
-	else if ( 0 != p2 )
+	else if ( above )
 	{
 		interp = 1;
-		moo2 = smoothInTime( *p2, t );
+		moo2 = a2;
 		moo1 = moo2;
 	}
-	else if ( 0 != p1 )
+	else if ( below )
 	{
-		interp = 1. / (f - p1->frequencyAt( t ));
-		moo1 = smoothInTime( *p1, t );
+		interp = 1. / (f - f1);
+		moo1 = a1;
 		moo2 = 0;
 	}
-	else
-	{
-		moo1 = moo2 = interp = 0;
-	}
 	return ((1-interp)*moo1 + interp*moo2);
 }
 
+// ---------------------------------------------------------------------------
+//    surfaceAt - local helper
+// ---------------------------------------------------------------------------
+static double surfaceAt( double f, double t, const std::vector< Partial > & parray )
+{
+	std::pair< const Partial *, const Partial * > both = findemfaster( f, t, parray );
+	const Partial * p1 = both.first;
+	const Partial * p2 = both.second;
+	
+	return interpolateAt( f, 
+                          0 != p1, p1 ? p1->frequencyAt( t ) : 0, p1 ? smoothInTime( *p1, t ) : 0,
+                          0 != p2, p2 ? p2->frequencyAt( t ) : 0, p2 ? smoothInTime( *p2, t ) : 0 );
+}
+
 // ---------------------------------------------------------------------------
 //    scaleAmplitudes
 // ---------------------------------------------------------------------------
@@ -205,7 +222,7 @@ void SpectralSurface::scaleAmplitudes( Partial & p )
         double f = bp.frequency();
         double t = iter.time();	
             
-        double ampscale = surfaceAt( FreqScale * f, TimeScale * t, mPartials ) / mMaxSurfaceAmp;
+        double ampscale = amplitudeAt( FreqScale * f, TimeScale * t ) / mMaxSurfaceAmp;
 
         double a = bp.amplitude() * ( (1.-mEffect) + (mEffect*ampscale) );
         bp.setAmplitude( a );
@@ -235,13 +252,121 @@ void SpectralSurface::setAmplitudes( Partial & p )
             double f = bp.frequency();
             double t = iter.time();	
                 
-            double surfaceAmp = surfaceAt( FreqScale * f, TimeScale * t, mPartials );
+            double surfaceAmp = amplitudeAt( FreqScale * f, TimeScale * t );
             double a = ( bp.amplitude()*(1.-mEffect) ) + ( mEffect*surfaceAmp );
             bp.setAmplitude( a );
         }
     }
 }
 
+// --- grid ---
+
+// ---------------------------------------------------------------------------
+//    sampleGrid
+// ---------------------------------------------------------------------------
+//! Sample the surface into a regular grid, with frames timeStep
+//! apart from 0 to the end of the surface and rows frequencyStep
+//! apart from 0 Hz to the highest frequency of the surface. From
+//! then on the surface is the bilinear interpolation of the grid,
+//! scaleAmplitudes and setAmplitudes look it up instead of 
+//! searching the Partials of the surface. Beyond the grid, the
+//! surface has the amplitude of its nearest edge.
+//!
+//! \pre    both steps must be positive
+//! \param  timeStep seconds between frames of the grid
+//! \param  frequencyStep Hz between rows of the grid
+//! \throw  InvalidArgument if a step is not positive.
+//
+void SpectralSurface::sampleGrid( double timeStep, double frequencyStep )
+{
+	if ( 0 >= timeStep || 0 >= frequencyStep )
+	{
+		Throw( InvalidArgument,     
+               "SpectralSurface grid steps must be positive." );
+	}
+	
+	double endTime = 0, maxFrequency = 0;
+	for ( const Partial & p : mPartials )
+	{
+        endTime = std::max( endTime, p.endTime() );
+        for ( Partial::const_iterator it = p.begin(); it != p.end(); ++it )
+        {
+            maxFrequency = std::max( maxFrequency, it.breakpoint().frequency() );
+        }
+	}
+	
+	const int frames = 1 + (int) std::ceil( endTime / timeStep );
+	//  above the highest Partial the surface fades slowly, it is sampled
+	//  over a few more rows
+	const int rows = 1 + GridRowsAbove + (int) std::ceil( maxFrequency / frequencyStep );
+	std::vector< float > grid( (size_t) frames * rows );
+	
+	//  the frequency and smoothed amplitude of every Partial are computed
+	//  once per frame, rows walk up through them like findemfaster 
+	//  searching up from the lowest Partial
+	std::vector< double > freqs( mPartials.size() ), amps( mPartials.size() );
+	for ( int frame = 0; frame < frames; ++frame )
+	{
+        const double t = frame * timeStep;
+        for ( std::vector< Partial >::size_type i = 0; i < mPartials.size(); ++i )
+        {
+            freqs[i] = mPartials[i].frequencyAt( t );
+            amps[i] = smoothInTime( mPartials[i], t );
+        }
+        
+        std::vector< double >::size_type i = 0;
+        for ( int row = 0; row < rows; ++row )
+        {
+            const double f = row * frequencyStep;
+            while ( i < freqs.size() && freqs[i] < f )
+            {
+                ++i;
+            }
+            const bool below = i > 0, above = i < freqs.size();
+            const double a = interpolateAt( f, below, below ? freqs[i-1] : 0, below ? amps[i-1] : 0,
+                                            above, above ? freqs[i] : 0, above ? amps[i] : 0 );
+            
+            //  no negative amplitudes just above the highest Partial
+            grid[ (size_t) frame * rows + row ] = (float) std::max( 0.0, a / mMaxSurfaceAmp );
+        }
+	}
+	
+	mGrid.swap( grid );
+	mGridFrames = frames;
+	mGridRows = rows;
+	mGridTimeStep = timeStep;
+	mGridFrequencyStep = frequencyStep;
+}
+
+// ---------------------------------------------------------------------------
+//    gridAmplitudeAt
+// ---------------------------------------------------------------------------
+//! Return the amplitude of the surface at a time and frequency,
+//! not stretched, relative to the largest amplitude on the surface
+//! (from 0 to 1), interpolated in the grid. It neither allocates
+//! nor locks, so a RealTimeSynthesizer may call it while rendering.
+//!
+//! \pre    the surface was sampled by sampleGrid
+//! \param  time the time in seconds
+//! \param  frequency the frequency in Hz
+//
+float SpectralSurface::gridAmplitudeAt( double time, double frequency ) const noexcept
+{
+	const double x = std::min( std::max( time / mGridTimeStep, 0.0 ), (double) ( mGridFrames - 1 ) );
+	const double y = std::min( std::max( frequency / mGridFrequencyStep, 0.0 ), (double) ( mGridRows - 1 ) );
+	
+	//  rows are at least two, a surface ending at 0 has a single frame
+	const int frame = std::min( (int) x, std::max( mGridFrames - 2, 0 ) );
+	const int row = std::min( (int) y, mGridRows - 2 );
+	const float fx = (float) ( x - frame ), fy = (float) ( y - row );
+	
+	const float * lo = &mGrid[ (size_t) frame * mGridRows + row ];
+	const float * hi = mGridFrames > 1 ? lo + mGridRows : lo;
+	const float a = lo[0] + fy * ( lo[1] - lo[0] );
+	const float b = hi[0] + fy * ( hi[1] - hi[0] );
+	return a + fx * ( b - a );
+}
+
 // --- access/mutation ---
 
 // ---------------------------------------------------------------------------
@@ -372,6 +497,22 @@ void SpectralSurface::addPartialAux( const Partial & p )
     mMaxSurfaceAmp = std::max( mMaxSurfaceAmp, peakAmp( p ) );
 }
 
+// ---------------------------------------------------------------------------
+//    amplitudeAt
+// ---------------------------------------------------------------------------
+// Helper returning the amplitude of the surface at a frequency and
+// time (not stretched), looked up in the grid if the surface was 
+// sampled, searched in the Partials otherwise.
+//
+double SpectralSurface::amplitudeAt( double f, double t ) const
+{
+    if ( hasGrid() )
+    {
+        return mMaxSurfaceAmp * gridAmplitudeAt( t, f );
+    }
+    return surfaceAt( f, t, mPartials );
+}
+
 
 }	//end namespace
 
@@ -53,11 +53,30 @@ namespace Loris {
 //! SpectralSurface represents a smoothed time-frequency surface that 
 //! can be used to perform cross-synthesis, the filtering of one sound 
 //! by the time-varying spectrum of another.
+//!
+//! The surface can be sampled once into a regular time-frequency grid
+//! (see sampleGrid), that is looked up by bilinear interpolation instead 
+//! of searching the Partials of the surface, fast enough for a 
+//! RealTimeSynthesizer to cross-synthesize the Partials it plays.
 //
 class SpectralSurface
 {
 //	-- public interface --
 public:
+
+//  -- global defaults and constants --
+
+	enum 
+	{
+		//! Default time in milliseconds between the frames of the
+		//! grid sampled by sampleGrid. Divide by 1000 to use as a
+		//! member function parameter.
+		DefaultGridTimeMs = 10,
+		
+		//! Default frequency in Hz between the rows of the grid
+		//! sampled by sampleGrid.
+		DefaultGridFrequencyHz = 20
+	};
 	
 //	-- lifecycle --
 
@@ -150,6 +169,37 @@ public:
     inline
 	void setAmplitudes( PartialList::iterator b, PartialList::iterator e );
 #endif
+
+// --- grid ---
+
+    //! Sample the surface into a regular grid, with frames timeStep
+    //! apart from 0 to the end of the surface and rows frequencyStep
+    //! apart from 0 Hz to the highest frequency of the surface. From
+    //! then on the surface is the bilinear interpolation of the grid,
+    //! scaleAmplitudes and setAmplitudes look it up instead of 
+    //! searching the Partials of the surface. Beyond the grid, the
+    //! surface has the amplitude of its nearest edge.
+    //!
+    //! \pre    both steps must be positive
+    //! \param  timeStep seconds between frames of the grid
+    //! \param  frequencyStep Hz between rows of the grid
+    //! \throw  InvalidArgument if a step is not positive.
+	void sampleGrid( double timeStep = DefaultGridTimeMs / 1000.0,
+                     double frequencyStep = DefaultGridFrequencyHz );
+    
+    //! Return true if the surface was sampled into a grid by 
+    //! sampleGrid.
+	bool hasGrid( void ) const { return ! mGrid.empty(); }
+    
+    //! Return the amplitude of the surface at a time and frequency,
+    //! not stretched, relative to the largest amplitude on the surface
+    //! (from 0 to 1), interpolated in the grid. It neither allocates
+    //! nor locks, so a RealTimeSynthesizer may call it while rendering.
+    //!
+    //! \pre    the surface was sampled by sampleGrid
+    //! \param  time the time in seconds
+    //! \param  frequency the frequency in Hz
+	float gridAmplitudeAt( double time, double frequency ) const noexcept;
 	
 // --- access/mutation ---
 
@@ -223,12 +273,23 @@ private:
     double mMaxSurfaceAmp;              //! the maximum amplitude of any Breakpoint on 
                                         //! the surface, used for normalizing the surface
                                         //! amplitude for scaleAmplitudes
+    std::vector< float > mGrid;         //! amplitudes of the surface relative to 
+                                        //! mMaxSurfaceAmp, frame after frame, empty
+                                        //! until the surface is sampled
+    int mGridFrames;                    //! frames (time) of the grid
+    int mGridRows;                      //! rows (frequency) of the grid
+    double mGridTimeStep;               //! seconds between frames of the grid
+    double mGridFrequencyStep;          //! Hz between rows of the grid
     
 // --- private helpers ---
 
     //  helper used by constructor for adding Partials one by one
     void addPartialAux( const Partial & p );
     
+    //  helper returning the amplitude of the surface at a frequency 
+    //  and time (not stretched), looked up in the grid if there is one
+    double amplitudeAt( double f, double t ) const;
+    
 };
 
 // ---------------------------------------------------------------------------
@@ -256,7 +317,11 @@ SpectralSurface::SpectralSurface( PartialList::iterator b,
 	mStretchFreq( 1.0 ),
 	mStretchTime( 1.0 ),
 	mEffect( 1.0 ),
-    mMaxSurfaceAmp( 0.0 )
+    mMaxSurfaceAmp( 0.0 ),
+    mGridFrames( 0 ),
+    mGridRows( 0 ),
+    mGridTimeStep( 0.0 ),
+    mGridFrequencyStep( 0.0 )
 {
     //  add only labeled Partials:
     while ( b != e )
@@ -44,12 +44,14 @@
 #include "Envelope.h"
 #include "LorisExceptions.h"
 #include "Notifier.h"
+#include "ParallelFor.h"
 #include "Partial.h"
 #include "Resampler.h"
 #include "phasefix.h"
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 
 #if defined(HAVE_M_PI) && (HAVE_M_PI)
     const double Pi = M_PI;
@@ -79,7 +81,9 @@ namespace Loris {
 Synthesizer::Synthesizer( std::vector<double> & buffer ) :
     m_sampleBuffer( & buffer ),
     m_fadeTimeSec( DefaultParameters().fadeTime ),
-    m_srateHz( DefaultParameters().sampleRate )
+    m_srateHz( DefaultParameters().sampleRate ),
+    m_numThreads( DefaultParameters().numThreads ),
+    m_firstSample( 0 )
 {
 }
 
@@ -102,13 +106,15 @@ Synthesizer::Synthesizer( std::vector<double> & buffer ) :
 //!	\throw	InvalidArgument if any of the parameters is invalid.
 //
 Synthesizer::Synthesizer( Parameters params, std::vector<double> & buffer ) :
-    m_sampleBuffer( & buffer )
+    m_sampleBuffer( & buffer ),
+    m_firstSample( 0 )
 {
     //  make sure that the parameters are valid before proceeding
     if ( IsValidParameters( params ) )
     {
         m_fadeTimeSec = params.fadeTime;
         m_srateHz = params.sampleRate;
+        m_numThreads = params.numThreads;
         m_osc.filter() = params.filter;
     }
 }
@@ -132,7 +138,9 @@ Synthesizer::Synthesizer( Parameters params, std::vector<double> & buffer ) :
 Synthesizer::Synthesizer( double samplerate, std::vector<double> & buffer ) :
     m_sampleBuffer( & buffer ),
     m_fadeTimeSec( DefaultParameters().fadeTime ),
-    m_srateHz( samplerate )
+    m_srateHz( samplerate ),
+    m_numThreads( DefaultParameters().numThreads ),
+    m_firstSample( 0 )
 {
     //  check to make sure that the sample rate is valid:
     if ( m_srateHz <= 0. ) 
@@ -168,7 +176,9 @@ Synthesizer::Synthesizer( double samplerate, std::vector<double> & buffer,
                           double fade ) :
     m_sampleBuffer( & buffer ),
     m_fadeTimeSec( fade ),
-    m_srateHz( samplerate )
+    m_srateHz( samplerate ),
+    m_numThreads( DefaultParameters().numThreads ),
+    m_firstSample( 0 )
 {
     //  check to make sure that the sample rate is valid:
     if ( m_srateHz <= 0. ) 
@@ -216,7 +226,7 @@ Synthesizer::synthesize( Partial p )
 {
     if ( p.numBreakpoints() == 0 )
     {
-        debugger << "Synthesizer ignoring a partial that contains no Breakpoints" << endl;
+        LORIS_DEBUGGER << "Synthesizer ignoring a partial that contains no Breakpoints" << endl;
         return;
     }
     
@@ -225,10 +235,10 @@ Synthesizer::synthesize( Partial p )
         Throw( InvalidPartial, "Tried to synthesize a Partial having start time less than 0." );
     }
 
-    debugger << "synthesizing Partial from " << p.startTime() * m_srateHz 
-             << " to " << p.endTime() * m_srateHz << " starting phase "
-             << p.initialPhase() << " starting frequency " 
-             << p.first().frequency() << endl;
+    LORIS_DEBUGGER << "synthesizing Partial from " << p.startTime() * m_srateHz 
+                   << " to " << p.endTime() * m_srateHz << " starting phase "
+                   << p.initialPhase() << " starting frequency " 
+                   << p.first().frequency() << endl;
              
     //  better to compute this only once:
     const double OneOverSrate = 1. / m_srateHz;
@@ -241,19 +251,21 @@ Synthesizer::synthesize( Partial p )
     quantizer.quantize( p );
     
 
-    //  resize the sample buffer if necessary:
+    //  resize the sample buffer if necessary (the buffer
+    //  begins at m_firstSample):
     typedef unsigned long index_type;
     index_type endSamp = index_type( ( p.endTime() + m_fadeTimeSec ) * m_srateHz );
-    if ( endSamp+1 > m_sampleBuffer->size() )
+    if ( endSamp+1 > m_firstSample + m_sampleBuffer->size() )
     {
         //  pad by one sample:
-        m_sampleBuffer->resize( endSamp+1 );
+        m_sampleBuffer->resize( endSamp+1 - m_firstSample );
     }
     
     //  compute the starting time for synthesis of this Partial,
     //  m_fadeTimeSec before the Partial's startTime, but not before 0:
     double itime = ( m_fadeTimeSec < p.startTime() ) ? ( p.startTime() - m_fadeTimeSec ) : 0.;
     index_type currentSamp = index_type( (itime * m_srateHz) + 0.5 );   //  cheap rounding
+    Assert( currentSamp >= m_firstSample );
     
     //  reset the oscillator:
     //  all that really needs to happen here is setting the frequency
@@ -297,7 +309,8 @@ Synthesizer::synthesize( Partial p )
             m_osc.setPhase( it.breakpoint().phase() - dphase );
         }
 
-        m_osc.oscillate( bufferBegin + currentSamp, bufferBegin + tgtSamp,
+        m_osc.oscillate( bufferBegin + ( currentSamp - m_firstSample ), 
+                         bufferBegin + ( tgtSamp - m_firstSample ),
                          it.breakpoint(), m_srateHz );
         
         currentSamp = tgtSamp;
@@ -308,7 +321,8 @@ Synthesizer::synthesize( Partial p )
     }
 
     //  render a fade out segment:  
-    m_osc.oscillate( bufferBegin + currentSamp, bufferBegin + endSamp,
+    m_osc.oscillate( bufferBegin + ( currentSamp - m_firstSample ), 
+                     bufferBegin + ( endSamp - m_firstSample ),
                      BreakpointUtils::makeNullAfter( p.last(), m_fadeTimeSec ), m_srateHz );
     
 }
@@ -337,6 +351,96 @@ Synthesizer::samples( void )
     return *m_sampleBuffer;
 }
 
+// ---------------------------------------------------------------------------
+//  synthesizeParallel
+// ---------------------------------------------------------------------------
+//  Synthesize the Partials concurrently. They are ordered by start time and
+//  rendered in groups of RenderGroupSize by copies of this Synthesizer, each
+//  group into a buffer spanning only its samples. Groups are rendered in 
+//  rounds of one group per thread, and the buffers of a round are added to
+//  the sample buffer in order of the groups, so the samples do not depend 
+//  on the number of threads and no more than one buffer per thread is held.
+//  The buffers are added by all threads too, each adding every buffer to 
+//  tiles of ReduceTileSize samples of the sample buffer.
+
+static const std::size_t RenderGroupSize = 32;
+static const std::size_t ReduceTileSize = 16384;
+
+void
+Synthesizer::synthesizeParallel( std::vector< const Partial * > & partials )
+{
+    partials.erase( std::remove_if( partials.begin(), partials.end(),
+                                    []( const Partial * p ) { return 0 == p->numBreakpoints(); } ),
+                    partials.end() );
+    std::stable_sort( partials.begin(), partials.end(),
+                      []( const Partial * a, const Partial * b ) 
+                      { return a->startTime() < b->startTime(); } );
+    
+    typedef std::vector< double >::size_type index_type;
+    const std::size_t numGroups = ( partials.size() + RenderGroupSize - 1 ) / RenderGroupSize;
+    const std::size_t roundSize = std::min< std::size_t >( numGroups, resolveNumThreads( m_numThreads ) );
+    std::vector< std::vector< double > > buffers( roundSize );
+    std::vector< index_type > firstSamples( roundSize );
+    
+    for ( std::size_t round = 0; round < numGroups; round += roundSize )
+    {
+        const std::size_t count = std::min( roundSize, numGroups - round );
+        parallelFor( count, m_numThreads, [&]( std::size_t i )
+        {
+            const std::size_t begin = ( round + i ) * RenderGroupSize;
+            const std::size_t end = std::min( begin + RenderGroupSize, partials.size() );
+            
+            //  the group begins with the fade in of its first Partial, less
+            //  one sample for the rounding of its start time by quantization
+            double itime = std::max( partials[ begin ]->startTime() - m_fadeTimeSec, 0. );
+            firstSamples[ i ] = index_type( std::max( itime * m_srateHz - 1., 0. ) );
+            
+            //  noise of each group is seeded by the group, so that
+            //  groups are not correlated (seeds spread over the
+            //  range of the generator, (0, 2^31 - 1))
+            Synthesizer group( *this );
+            group.m_osc.modulator().seed( 1. + double( ( ( round + i + 1 ) * 2654435761ULL ) % 2147483646ULL ) );
+            group.m_sampleBuffer = & buffers[ i ];
+            group.m_firstSample = firstSamples[ i ];
+            group.m_sampleBuffer->clear();
+            for ( std::size_t k = begin; k < end; ++k )
+            {
+                group.synthesize( *partials[ k ] );
+            }
+        } );
+        
+        //  samples of the round, relative to the sample buffer
+        index_type roundBegin = firstSamples[ 0 ] - m_firstSample, roundEnd = roundBegin;
+        for ( std::size_t i = 0; i < count; ++i )
+        {
+            roundBegin = std::min( roundBegin, firstSamples[ i ] - m_firstSample );
+            roundEnd = std::max( roundEnd, firstSamples[ i ] - m_firstSample + buffers[ i ].size() );
+        }
+        if ( roundEnd > m_sampleBuffer->size() )
+        {
+            m_sampleBuffer->resize( roundEnd );
+        }
+        
+        //  every sample adds the buffers in order of the groups, whatever the tiles
+        const std::size_t numTiles = ( roundEnd - roundBegin + ReduceTileSize - 1 ) / ReduceTileSize;
+        parallelFor( numTiles, m_numThreads, [&]( std::size_t tile )
+        {
+            const index_type tileBegin = roundBegin + tile * ReduceTileSize;
+            const index_type tileEnd = std::min( tileBegin + ReduceTileSize, roundEnd );
+            for ( std::size_t i = 0; i < count; ++i )
+            {
+                const index_type offset = firstSamples[ i ] - m_firstSample;
+                const index_type begin = std::max( tileBegin, offset );
+                const index_type end = std::min( tileEnd, offset + buffers[ i ].size() );
+                for ( index_type n = begin; n < end; ++n )
+                {
+                    (*m_sampleBuffer)[ n ] += buffers[ i ][ n - offset ];
+                }
+            }
+        } );
+    }
+}
+
 // -- parameter access and mutation --
 
 // ---------------------------------------------------------------------------
@@ -359,6 +463,35 @@ Synthesizer::sampleRate( void ) const
     return m_srateHz;
 }
 
+// ---------------------------------------------------------------------------
+//  numThreads
+// ---------------------------------------------------------------------------
+//! Return the number of threads used to synthesize a range of
+//! Partials, 0 for one per hardware core. 
+unsigned int
+Synthesizer::numThreads( void ) const 
+{
+    return m_numThreads;
+}
+
+// ---------------------------------------------------------------------------
+//  setNumThreads
+// ---------------------------------------------------------------------------
+//! Set the number of threads used to synthesize a range of 
+//! Partials, 0 for one per hardware core. Partials are then
+//! rendered in groups ordered by start time, each into a buffer
+//! of its own, and the buffers are added to the sample buffer
+//! in order, so the samples do not depend on the number of
+//! threads (they differ by rounding from the samples rendered
+//! by one thread).
+//!
+//! \param  n The new number of threads.
+void
+Synthesizer::setNumThreads( unsigned int n )
+{
+    m_numThreads = n;
+}
+
 
 // ---------------------------------------------------------------------------
 //  setFadeTime
@@ -431,6 +564,7 @@ static const double Default_SampleRate_Hz = 44100;
 Synthesizer::Parameters::Parameters( void ) :
     fadeTime( Default_FadeTime_Ms * 0.001 ),
     sampleRate( Default_SampleRate_Hz ),
+    numThreads( 1 ),
     // enhancement( Default_Enhancement_Flag ),
     filter( Oscillator::prototype_filter() )
 {
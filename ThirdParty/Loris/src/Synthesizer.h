@@ -164,6 +164,9 @@ public:
 	//!	time will have shorter onset fades.  Partials are not rendered at
 	//! frequencies above the half-sample rate. 
 	//!
+	//! Unless numThreads() is 1, the Partials are rendered concurrently
+	//! (see setNumThreads()), they must not be modified meanwhile.
+	//!
 	//! \param  begin_partials The beginning of the range of Partials 
 	//!         to synthesize.
 	//! \param 	end_partials The end of the range of Partials 
@@ -221,6 +224,21 @@ public:
 	//!	\param	rate The new synthesis sample rate.
 	//!	\throw	InvalidArgument if the specified rate is nonpositive.
 	virtual void setSampleRate( double rate );
+	
+	//! Return the number of threads used to synthesize a range of
+	//! Partials, 0 for one per hardware core. 
+	unsigned int numThreads( void ) const;
+	
+	//! Set the number of threads used to synthesize a range of 
+	//! Partials, 0 for one per hardware core. Partials are then
+	//! rendered in groups ordered by start time, each into a buffer
+	//! of its own, and the buffers are added to the sample buffer
+	//! in order, so the samples do not depend on the number of
+	//! threads (they differ by rounding from the samples rendered
+	//! by one thread).
+	//!
+	//! \param  n The new number of threads.
+	void setNumThreads( unsigned int n );
 	//! Return access to the Filter used by this Synthesizer's 
 	//! Oscillator to implement bandwidth-enhanced sinusoidal 
 	//! synthesis. (Can use this access to make changes to the
@@ -244,6 +262,7 @@ public:
 	{
 		double fadeTime;
 		double sampleRate;
+		unsigned int numThreads;    //  see setNumThreads, default is 1
 		// EnhancementFlag enhancement;
 		
 		Filter filter;
@@ -289,6 +308,14 @@ protected:
 	
 	double m_fadeTimeSec;               	//  Partial fade in/out time in seconds
 	double m_srateHz;                     	//	sample rate in Hz
+	unsigned int m_numThreads;              //  threads rendering a range of Partials
+	
+	std::vector< double >::size_type m_firstSample;   //  index of the sample at the
+	                                                  //  beginning of the buffer
+	
+	//	Synthesize the Partials concurrently, see setNumThreads. They are
+	//	ordered by start time, empty ones are removed.
+	void synthesizeParallel( std::vector< const Partial * > & partials );
 		
 };	//	end of class Synthesizer
 // ---------------------------------------------------------------------------
@@ -336,9 +363,21 @@ Synthesizer::synthesize( PartialList::iterator begin_partials,
         m_sampleBuffer->resize( Nsamps );
     }
     
-    while ( begin_partials != end_partials ) 
+    if ( 1 == m_numThreads )
+    {
+        while ( begin_partials != end_partials ) 
+        {
+            synthesize( *(begin_partials++) ); 
+        }
+    }
+    else
     {
-        synthesize( *(begin_partials++) ); 
+        std::vector< const Partial * > partials;
+        while ( begin_partials != end_partials ) 
+        {
+            partials.push_back( &*(begin_partials++) ); 
+        }
+        synthesizeParallel( partials );
     }
 }
 // ---------------------------------------------------------------------------
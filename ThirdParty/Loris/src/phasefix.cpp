@@ -105,6 +105,60 @@ static double phaseTravel( Partial::const_iterator bp0, Partial::const_iterator
 	                    bp1.time() - bp0.time() );
 }
 
+// ---------------------------------------------------------------------------
+//	BreakpointBlock
+//
+//	Consecutive Breakpoints of a Partial gathered with their times and
+//	frequencies into contiguous arrays, a block at a time. Phase travel 
+//	of all segments of a block is computed in one flat loop that the
+//	compiler can vectorize, instead of walking the Partial for each
+//	segment. Blocks live on the stack, so short ranges cost no 
+//	allocation.
+//
+struct BreakpointBlock
+{
+    enum { Capacity = 64 };
+    
+    Partial::iterator pos[ Capacity + 1 ];
+    double times[ Capacity + 1 ];
+    double freqs[ Capacity + 1 ];
+    double travel[ Capacity ];
+    int numSegments;
+    
+    //	Gather at most Capacity segments beginning at from and ending 
+    //	not later than stopHere, return the position of the last
+    //	Breakpoint gathered (the first one of the next block).
+    Partial::iterator gather( Partial::iterator from, Partial::iterator stopHere )
+    {
+        numSegments = 0;
+        store( 0, from );
+        while ( numSegments < Capacity && from != stopHere )
+        {
+            store( ++numSegments, ++from );
+        }
+        return from;
+    }
+    
+    //	Compute the phase travel over each gathered segment, the same 
+    //	as phaseTravel does.
+    void computeTravel( void )
+    {
+        for ( int i = 0; i < numSegments; ++i )
+        {
+            double favg = .5 * ( freqs[ i ] + freqs[ i + 1 ] );
+            travel[ i ] = 2 * Pi * favg * ( times[ i + 1 ] - times[ i ] );
+        }
+    }
+    
+private:
+    void store( int i, Partial::iterator it )
+    {
+        pos[ i ] = it;
+        times[ i ] = it.time();
+        freqs[ i ] = it.breakpoint().frequency();
+    }
+};
+
 // -- phase correction -- 
 
 // ---------------------------------------------------------------------------
@@ -192,32 +246,38 @@ void fixPhaseBackward( Partial::iterator stopHere, Partial::iterator pos )
 //
 void fixPhaseForward( Partial::iterator pos, Partial::iterator stopHere )
 {
+    //  phases are only fixed from frequencies, which are not modified,
+    //  so the phase travel of a whole block is computed up front:
+    BreakpointBlock block;
     while ( pos != stopHere )
     {
-        Partial::iterator posPrev = pos++;
+        pos = block.gather( pos, stopHere );
+        block.computeTravel();
         
-        //  update phase based on the phase travel between 
-        //  posPrev and pos UNLESS pos is Null:
-        if ( BreakpointUtils::isNonNull( pos.breakpoint() ) )
+        for ( int i = 0; i < block.numSegments; ++i )
         {
-            // pos is the position of a non-Null Breakpoint, 
-            // posPrev is its predecessor:            
-            double travel = phaseTravel( posPrev, pos );
+            Breakpoint & prev = block.pos[ i ].breakpoint();
+            Breakpoint & next = block.pos[ i + 1 ].breakpoint();
             
-            if ( BreakpointUtils::isNonNull( posPrev.breakpoint() ) )
-            {                        
-                // if its predecessor of pos is non-Null, then fix
-                // the phase of the Breakpoint at pos.
-                pos.breakpoint().setPhase( wrapPi( posPrev.breakpoint().phase() + travel ) );
-            }
-            else
+            //  update phase based on the phase travel between 
+            //  prev and next UNLESS next is Null:
+            if ( BreakpointUtils::isNonNull( next ) )
             {
-                // if the predecessor of pos is Null, then
-                // correct the predecessor's phase so that 
-                // it correctly resets the synthesis phase 
-                // so that the phase of the Breakpoint at 
-                // pos is achieved in synthesis.
-                posPrev.breakpoint().setPhase( wrapPi( pos.breakpoint().phase() - travel ) );
+                if ( BreakpointUtils::isNonNull( prev ) )
+                {                        
+                    // if the predecessor of next is non-Null, then fix
+                    // the phase of next.
+                    next.setPhase( wrapPi( prev.phase() + block.travel[ i ] ) );
+                }
+                else
+                {
+                    // if the predecessor of next is Null, then
+                    // correct the predecessor's phase so that 
+                    // it correctly resets the synthesis phase 
+                    // so that the phase of next is achieved 
+                    // in synthesis.
+                    prev.setPhase( wrapPi( next.phase() - block.travel[ i ] ) );
+                }
             }
         }
     }
@@ -259,12 +319,17 @@ void fixPhaseBetween( Partial::iterator b, Partial::iterator e )
     {
         //	Accumulate the actual phase travel over the Breakpoint
         //	span, and count the envelope segments.
+        BreakpointBlock block;
         double travel = 0;
         Partial::iterator next = b;
         do
         {
-            Partial::iterator prev = next++;
-            travel += phaseTravel( prev, next );
+            next = block.gather( next, e );
+            block.computeTravel();
+            for ( int i = 0; i < block.numSegments; ++i )
+            {
+                travel += block.travel[ i ];
+            }
         } while( next != e );
 
         //	Compute the desired amount of phase travel:
@@ -297,25 +362,35 @@ void fixPhaseBetween( Partial::iterator b, Partial::iterator e )
         
         double delta = ( 2 * ( desired - travel ) / ( tN + tNm1 - t1 - t0 ) ) / ( 2 * Pi );
         
-        //	Perturb the Breakpoint frequencies.
+        //	Perturb the Breakpoint frequencies, a block at a time, 
+        //	the first Breakpoint of each block is b or was perturbed
+        //	with the previous block:
         next = b;
-        Partial::iterator prev = next++;
-        while ( next != e )
+        do
         {
-            next.breakpoint().setFrequency( next.breakpoint().frequency() + delta );
-            
-            double newtravel = phaseTravel( prev, next );            
-            next.breakpoint().setPhase( wrapPi( prev.breakpoint().phase() + newtravel ) );
+            next = block.gather( next, e );
+            int numPerturbed = ( next == e ) ? block.numSegments - 1 : block.numSegments;
+            for ( int i = 1; i <= numPerturbed; ++i )
+            {
+                block.freqs[ i ] += delta;
+            }
+            block.computeTravel();
             
-            prev = next++;
-        }
+            for ( int i = 0; i < numPerturbed; ++i )
+            {
+                Breakpoint & prev = block.pos[ i ].breakpoint();
+                Breakpoint & bp = block.pos[ i + 1 ].breakpoint();
+                bp.setFrequency( block.freqs[ i + 1 ] );
+                bp.setPhase( wrapPi( prev.phase() + block.travel[ i ] ) );
+            }
+        } while( next != e );
     }
     else
     {
         // Preconditions not met, cannot fix the phase travel.
         // Should raise exception?
-        debugger << "cannot fix phase between " << b.time() << " and " << e.time()
-                 << ", there are no Breakpoints between those times" << endl;
+        LORIS_DEBUGGER << "cannot fix phase between " << b.time() << " and " << e.time()
+                       << ", there are no Breakpoints between those times" << endl;
     }
 
 }
@@ -403,8 +478,8 @@ void matchPhaseFwd( Breakpoint & bp0, Breakpoint & bp1,
         double ftgt = ( travel / ( Pi * dt ) ) - f0;
         
         #ifdef Loris_Debug
-        debugger << "matchPhaseFwd: correcting " << bp1.frequency() << " to " << ftgt 
-                 << " (phase " << wrapPi( bp1.phase() ) << "), ";
+        LORIS_DEBUGGER << "matchPhaseFwd: correcting " << bp1.frequency() << " to " << ftgt 
+                       << " (phase " << wrapPi( bp1.phase() ) << "), ";
         #endif
         
         //	If the target is not a null breakpoint, may need to 
@@ -425,7 +500,7 @@ void matchPhaseFwd( Breakpoint & bp0, Breakpoint & bp1,
         bp1.setPhase( phi );
 
         #ifdef Loris_Debug
-        debugger << "achieved " << ftgt << " (phase " << phi << ")" << endl;
+        LORIS_DEBUGGER << "achieved " << ftgt << " (phase " << phi << ")" << endl;
         #endif
     }
 }
@@ -99,52 +99,145 @@ bool TeragonPluginBase::isMetaParameter(int index) const {
 
 // State save/restore //////////////////////////////////////////////////////////
 
+// Binary state starts with this magic and the format version, followed by the
+// number of records and one record per parameter: its safe name, its type, the
+// size of its value and the value. Values of unknown types are skipped by size.
+static const int kBinaryStateMagic = 0x54505331; // "TPS1"
+static const int kBinaryStateVersion = 1;
+
+enum StateRecordType {
+    kStateRecordDouble = 0,
+    kStateRecordInteger = 1,
+    kStateRecordData = 2, // raw bytes of string and blob parameters
+    kStateRecordNone = -1
+};
+
+static int getStateRecordType(Parameter *parameter) {
+    // Do not serialize the version parameter, it must be set by the plugin
+    // and not overridden. Void parameters don't contain any interesting values.
+    if(parameter->getSafeName() == "Version" ||
+       dynamic_cast<VoidParameter *>(parameter) != nullptr) {
+        return kStateRecordNone;
+    }
+    if(dynamic_cast<StringParameter *>(parameter) != nullptr ||
+       dynamic_cast<BlobParameter *>(parameter) != nullptr) {
+        return kStateRecordData;
+    }
+    if(dynamic_cast<IntegerParameter *>(parameter) != nullptr) {
+        return kStateRecordInteger;
+    }
+    return kStateRecordDouble;
+}
+
 void TeragonPluginBase::getStateInformation(MemoryBlock &destData) {
-    // Save all parameters in the set, handling string/blob/numeric types with
-    // correct serialization to XML.
-    XmlElement xml(getName());
+    // Save all parameters in the set as binary records, blobs are stored as
+    // they are, without any encoding. The number of records is written when
+    // they are all known.
+    destData.setSize(0);
+    MemoryOutputStream records(destData, false);
+    records.writeInt(kBinaryStateMagic);
+    records.writeInt(kBinaryStateVersion);
+    records.writeInt(0);
+    int numRecords = 0;
     for(size_t i = 0; i < parameters.size(); ++i) {
         Parameter *parameter = parameters[i];
-        const String attributeName = parameter->getSafeName();
-        // Do not serialize the version parameter, it must be set by the plugin
-        // and not overridden
-        if(attributeName == "Version") {
+        const int type = getStateRecordType(parameter);
+        if(type == kStateRecordNone) {
             continue;
         }
 
-        if(dynamic_cast<StringParameter *>(parameter) != nullptr) {
-            // Convert parameter strings to juce strings
-            const String value = parameter->getDisplayText();
-            xml.setAttribute(attributeName, value);
-        }
-        else if(dynamic_cast<BlobParameter *>(parameter) != nullptr) {
-            // Use base64 encoding for binary blob data
-            BlobParameter *blobParameter = dynamic_cast<BlobParameter *>(parameter);
-            size_t blobSize = blobParameter->getDataSize();
-            char *encodedBlob = new char[base64_enc_len(blobSize)];
-            base64_encode(encodedBlob, (char*)blobParameter->getData(), blobSize);
-            xml.setAttribute(attributeName, encodedBlob);
-            delete [] encodedBlob;
-        }
-        else if(dynamic_cast<IntegerParameter *>(parameter) != nullptr) {
-            // Serialize integer parameters with the proper call
-            xml.setAttribute(attributeName, (int)parameter->getValue());
+        records.writeString(parameter->getSafeName());
+        records.writeByte((char)type);
+        if(type == kStateRecordData) {
+            if(dynamic_cast<BlobParameter *>(parameter) != nullptr) {
+                BlobParameter *blobParameter = dynamic_cast<BlobParameter *>(parameter);
+                records.writeInt((int)blobParameter->getDataSize());
+                records.write(blobParameter->getData(), blobParameter->getDataSize());
+            }
+            else {
+                const String value = parameter->getDisplayText();
+                records.writeInt((int)value.getNumBytesAsUTF8());
+                records.write(value.toRawUTF8(), value.getNumBytesAsUTF8());
+            }
         }
-        else if(dynamic_cast<VoidParameter *>(parameter) != nullptr) {
-            // Skip void parameters, these don't contain any interesting values
-            continue;
+        else if(type == kStateRecordInteger) {
+            records.writeInt(sizeof(int));
+            records.writeInt((int)parameter->getValue());
         }
         else {
-            // All other parameters can be serialized as doubles
-            xml.setAttribute(attributeName, (double)parameter->getValue());
+            records.writeInt(sizeof(double));
+            records.writeDouble((double)parameter->getValue());
         }
+        ++numRecords;
     }
 
-    // Save XML data to disk (via the host, that is)
-    copyXmlToBinary(xml, destData);
+    // Save binary data to disk (via the host, that is)
+    const int64 end = records.getPosition();
+    records.setPosition(8);
+    records.writeInt(numRecords);
+    records.setPosition(end);
 }
 
 void TeragonPluginBase::setStateInformation(const void *data, int sizeInBytes) {
+    MemoryInputStream stream(data, (size_t)sizeInBytes, false);
+    if(sizeInBytes >= 12 && stream.readInt() == kBinaryStateMagic) {
+        setBinaryStateInformation(stream);
+    }
+    else {
+        // State saved by versions writing XML
+        setXmlStateInformation(data, sizeInBytes);
+    }
+}
+
+void TeragonPluginBase::setBinaryStateInformation(MemoryInputStream &stream) {
+    // Newer versions of the format may only add record types, which are skipped
+    if(stream.readInt() < 1) {
+        return;
+    }
+
+    const int numRecords = stream.readInt();
+    for(int record = 0; record < numRecords && !stream.isExhausted(); ++record) {
+        const String name = stream.readString();
+        const int type = stream.readByte();
+        const int size = stream.readInt();
+        if(size < 0 || size > stream.getNumBytesRemaining()) {
+            break; // truncated state, parameters read so far are applied
+        }
+        const int64 next = stream.getPosition() + size;
+
+        // Records are written in the order of the set, so the record index is
+        // looked at first. Parameters missing in states saved by older versions
+        // of the plugin retain their default values.
+        Parameter *parameter = nullptr;
+        if(record < (int)parameters.size() && parameters[record]->getSafeName() == name.toStdString()) {
+            parameter = parameters[record];
+        }
+        for(size_t i = 0; parameter == nullptr && i < parameters.size(); ++i) {
+            if(parameters[i]->getSafeName() == name.toStdString()) {
+                parameter = parameters[i];
+            }
+        }
+
+        if(parameter != nullptr && type == getStateRecordType(parameter)) {
+            if(type == kStateRecordData) {
+                const char *bytes = static_cast<const char *>(stream.getData()) + stream.getPosition();
+                parameters.setData(parameter, bytes, (const size_t)size);
+            }
+            else if(type == kStateRecordInteger && size == sizeof(int)) {
+                parameters.set(parameter, stream.readInt());
+            }
+            else if(type == kStateRecordDouble && size == sizeof(double)) {
+                parameters.set(parameter, stream.readDouble());
+            }
+        }
+        stream.setPosition(next);
+    }
+
+    // Force parameters to be applied immediately
+    parameters.processRealtimeEvents();
+}
+
+void TeragonPluginBase::setXmlStateInformation(const void *data, int sizeInBytes) {
     // Restore parameter values from serialized XML state
     ScopedPointer<XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
     if(xmlState != 0 && xmlState->hasTagName(getName())) {
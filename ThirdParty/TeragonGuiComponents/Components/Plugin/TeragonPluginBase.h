@@ -69,11 +69,17 @@ public:
     virtual void changeProgramName(int index, const String &newName) {}
 
     // State save/restore //////////////////////////////////////////////////////////
+    // State is saved in a versioned binary format, state saved as XML by older
+    // versions is still restored.
     virtual void getStateInformation(MemoryBlock &destData);
     virtual void setStateInformation(const void *data, int sizeInBytes);
 
 protected:
     ConcurrentParameterSet parameters;
+
+private:
+    void setBinaryStateInformation(MemoryInputStream &stream);
+    void setXmlStateInformation(const void *data, int sizeInBytes);
 };
 
 } // namespace teragon
@@ -156,7 +156,7 @@ public:
      */
     virtual void set(Parameter *parameter, const ParameterValue value,
                      ParameterObserver *sender = NULL) {
-        scheduleEvent(new Event(parameter, value, true, sender));
+        scheduleEvent(eventPool.createEvent(parameter, value, false, true, sender));
     }
 
     /**
@@ -224,7 +224,7 @@ public:
      */
     virtual void setScaled(Parameter *parameter, const ParameterValue value,
                            ParameterObserver *sender = NULL) {
-        scheduleEvent(new ScaledEvent(parameter, value, true, sender));
+        scheduleEvent(eventPool.createEvent(parameter, value, true, true, sender));
     }
 
     /**
@@ -332,9 +332,11 @@ public:
 protected:
     virtual void scheduleEvent(Event *event) {
         if(!asyncDispatcher.isStarted()) {
+            releaseEvent(event);
             return;
         }
         else if(asyncDispatcher.isKilled()) {
+            releaseEvent(event);
             return;
         }
 
@@ -351,7 +353,13 @@ protected:
         }
     }
 
+    virtual void releaseEvent(Event *event) {
+        eventPool.releaseEvent(event);
+    }
+
 private:
+    // Declared first, events are released to it until the dispatchers are gone
+    EventPool eventPool;
     EventDispatcher asyncDispatcher;
     EventDispatcher realtimeDispatcher;
     EventDispatcherThread asyncDispatcherThread;
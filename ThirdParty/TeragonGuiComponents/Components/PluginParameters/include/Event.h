@@ -29,6 +29,12 @@
 #include "Parameter.h"
 #include "StringParameter.h"
 
+#if PLUGINPARAMETERS_MULTITHREADED
+#include <atomic>
+#include <new>
+#include <type_traits>
+#endif
+
 namespace teragon {
 
 class Event {
@@ -95,6 +101,68 @@ public:
     const size_t dataSize;
 };
 
+#if PLUGINPARAMETERS_MULTITHREADED
+/**
+ * Fixed-capacity storage for value events, so that setting a parameter does
+ * not allocate. Any thread can create events and any thread can release them,
+ * slots are claimed with an atomic flag. When all slots are taken, events are
+ * allocated on the heap as before, releaseEvent() tells them apart.
+ */
+class EventPool {
+public:
+    static const size_t kCapacity = 1024;
+
+    EventPool() : next(0) {
+        for(size_t i = 0; i < kCapacity; ++i) {
+            used[i].store(false);
+        }
+    }
+
+    Event *createEvent(Parameter *parameter, const ParameterValue value, bool scaled,
+                       bool realtime, const ParameterObserver *sender) {
+        for(size_t n = 0; n < kCapacity; ++n) {
+            const size_t i = next.fetch_add(1, std::memory_order_relaxed) % kCapacity;
+            bool expected = false;
+            if(used[i].compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                void *slot = &slots[i];
+                if(scaled) {
+                    return new(slot) ScaledEvent(parameter, value, realtime, sender);
+                }
+                return new(slot) Event(parameter, value, realtime, sender);
+            }
+        }
+
+        if(scaled) {
+            return new ScaledEvent(parameter, value, realtime, sender);
+        }
+        return new Event(parameter, value, realtime, sender);
+    }
+
+    void releaseEvent(Event *event) {
+        const char *address = reinterpret_cast<const char *>(event);
+        const char *begin = reinterpret_cast<const char *>(slots);
+        if(address >= begin && address < begin + sizeof(slots)) {
+            event->~Event();
+            used[(address - begin) / sizeof(Slot)].store(false, std::memory_order_release);
+        }
+        else {
+            delete event;
+        }
+    }
+
+private:
+    static_assert(sizeof(Event) <= sizeof(ScaledEvent), "Slots are sized for ScaledEvent");
+    typedef std::aligned_storage<sizeof(ScaledEvent), alignof(ScaledEvent)>::type Slot;
+
+    Slot slots[kCapacity];
+    std::atomic<bool> used[kCapacity];
+    std::atomic<size_t> next;
+
+    EventPool(const EventPool &);
+    EventPool &operator = (const EventPool &);
+};
+#endif // PLUGINPARAMETERS_MULTITHREADED
+
 } // namespace teragon
 
 #endif // __PluginParameters_Event_h__
@@ -52,6 +52,13 @@ public:
     virtual ~EventScheduler() {}
 
     virtual void scheduleEvent(Event *event) = 0;
+
+    /**
+     * Free an event after all observers were notified of it.
+     */
+    virtual void releaseEvent(Event *event) {
+        delete event;
+    }
 };
 
 class EventDispatcher {
@@ -67,6 +74,11 @@ public:
     }
 
     void process() {
+        if(isRealtime) {
+            processRealtime();
+            return;
+        }
+
         Event *event = NULL;
         while(eventQueue.try_dequeue(event)) {
             if(event != NULL) {
@@ -93,7 +105,7 @@ public:
                 else {
                     // If this is the async thread, then all observers know about the
                     // parameter change and this event can be deleted.
-                    delete event;
+                    scheduler->releaseEvent(event);
                 }
             }
             event = NULL;
@@ -127,6 +139,71 @@ public:
     }
 
 private:
+    static const size_t kRealtimeBatchSize = 256;
+
+    /**
+     * Drain the realtime queue a batch at a time. All events of a batch are
+     * applied in order, then realtime observers are notified once for each
+     * parameter, with its last value. An observer is skipped only if it sent
+     * all of the parameter's events of the batch. Every event is passed on to
+     * the async thread, which notifies of each one.
+     */
+    void processRealtime() {
+        Event *batch[kRealtimeBatchSize];
+        Parameter *updated[kRealtimeBatchSize];
+        const ParameterObserver *senders[kRealtimeBatchSize];
+
+        size_t numEvents = 0;
+        while(eventQueue.try_dequeue(batch[numEvents])) {
+            if(batch[numEvents] != NULL && ++numEvents == kRealtimeBatchSize) {
+                dispatchRealtime(batch, numEvents, updated, senders);
+                numEvents = 0;
+            }
+        }
+        if(numEvents > 0) {
+            dispatchRealtime(batch, numEvents, updated, senders);
+        }
+    }
+
+    void dispatchRealtime(Event **batch, size_t numEvents, Parameter **updated,
+                          const ParameterObserver **senders) {
+        for(size_t i = 0; i < numEvents; ++i) {
+            batch[i]->apply();
+        }
+
+        // Collect updated parameters, latest event first
+        size_t numUpdated = 0;
+        for(size_t i = numEvents; i-- > 0;) {
+            size_t u = 0;
+            while(u < numUpdated && updated[u] != batch[i]->parameter) {
+                ++u;
+            }
+            if(u == numUpdated) {
+                updated[numUpdated] = batch[i]->parameter;
+                senders[numUpdated++] = batch[i]->sender;
+            }
+            else if(senders[u] != batch[i]->sender) {
+                senders[u] = NULL;
+            }
+        }
+
+        // Notify in the order parameters were last set
+        for(size_t u = numUpdated; u-- > 0;) {
+            for(size_t i = 0; i < updated[u]->getNumObservers(); ++i) {
+                ParameterObserver *observer = updated[u]->getObserver(i);
+                if(observer != NULL && observer->isRealtimePriority() && observer != senders[u]) {
+                    observer->onParameterUpdated(updated[u]);
+                }
+            }
+        }
+
+        // Re-dispatch the events to the async thread
+        for(size_t i = 0; i < numEvents; ++i) {
+            batch[i]->isRealtime = false;
+            scheduler->scheduleEvent(batch[i]);
+        }
+    }
+
     std::condition_variable waitLock;
     EventDispatcherMutex mutex;
     moodycamel::ReaderWriterQueue<Event *> eventQueue;
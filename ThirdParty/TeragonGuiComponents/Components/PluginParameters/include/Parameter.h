@@ -64,7 +64,7 @@ public:
      */
     Parameter(const ParameterString &inName) :
     name(inName), unit(""), minValue(0.0), maxValue(1.0), defaultValue(0.0), value(0.0),
-    precision(kDefaultDisplayPrecision), description("") {}
+    precision(kDefaultDisplayPrecision), description(""), parameterIndex(-1) {}
 
     /**
       * Create a new floating point parameter. This is probably the most common
@@ -89,7 +89,7 @@ public:
               ParameterValue inMaxValue,
               ParameterValue inDefaultValue) :
     name(inName), unit(""), minValue(inMinValue), maxValue(inMaxValue), defaultValue(inDefaultValue),
-    value(inDefaultValue), precision(kDefaultDisplayPrecision), description("") {}
+    value(inDefaultValue), precision(kDefaultDisplayPrecision), description(""), parameterIndex(-1) {}
 
     virtual ~Parameter() {}
 
@@ -111,6 +111,17 @@ public:
         return makeSafeName(name);
     }
 
+    /**
+     * Get the parameter's position in the ParameterSet it was added to. Unlike
+     * the name, it can be compared without touching strings, for example when
+     * observers dispatch updates of several parameters.
+     *
+     * @return The parameter's index in its set, or -1 if it was not added to one
+     */
+    const int getIndex() const {
+        return parameterIndex;
+    }
+
     /**
      * Get the serialized version of a string
      *
@@ -328,6 +339,9 @@ private:
     }
 
 private:
+    // Sets parameterIndex when the parameter is added to a set
+    friend class ParameterSet;
+
     const ParameterString name;
     ParameterString unit;
     const ParameterValue minValue;
@@ -336,6 +350,7 @@ private:
     ParameterValue value;
     unsigned int precision;
     ParameterString description;
+    int parameterIndex;
 
     ParameterObserverMap observers;
 };
@@ -66,6 +66,7 @@ public:
         if(parameter == NULL || get(parameter->getName()) != NULL) {
             return NULL;
         }
+        parameter->parameterIndex = (int)parameterList.size();
         parameterMap.insert(std::make_pair(parameter->getSafeName(), parameter));
         parameterList.push_back(parameter);
         return parameter;
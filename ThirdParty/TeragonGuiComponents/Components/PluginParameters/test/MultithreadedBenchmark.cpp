@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013 Teragon Audio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+// Force multi-threaded build
+#define PLUGINPARAMETERS_MULTITHREADED 1
+#include "PluginParameters.h"
+
+// Simulate a host calling the plugin every 512 samples at 44100Hz, while the
+// GUI or automation sets parameters from another thread. Usage:
+//
+//   multithreadedbenchmark [seconds] [events per second] [parameters]
+//
+// 0 events per second sets parameters as fast as possible.
+#define DEFAULT_SECONDS 5
+#define DEFAULT_EVENTS_PER_SECOND 20000
+#define DEFAULT_NUM_PARAMETERS 64
+#define BLOCK_TIME_US 11610
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocation counting
+////////////////////////////////////////////////////////////////////////////////
+
+static std::atomic<long> gNumAllocations(0);
+static thread_local long gThreadAllocations = 0;
+
+void *operator new(size_t size) {
+    gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+    ++gThreadAllocations;
+    void *p = malloc(size > 0 ? size : 1);
+    if(p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+namespace teragon {
+
+////////////////////////////////////////////////////////////////////////////////
+// Observers
+////////////////////////////////////////////////////////////////////////////////
+
+class BenchmarkObserver : public ParameterObserver {
+public:
+    BenchmarkObserver(bool isRealtime) : ParameterObserver(),
+    realtime(isRealtime), count(0) {}
+
+    virtual ~BenchmarkObserver() {}
+
+    bool isRealtimePriority() const {
+        return realtime;
+    }
+
+    virtual void onParameterUpdated(const Parameter *parameter) {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const bool realtime;
+    std::atomic<long> count;
+};
+
+} // namespace teragon
+
+using namespace teragon;
+typedef std::chrono::steady_clock Clock;
+
+static long elapsedUs(Clock::time_point start, Clock::time_point end) {
+    return (long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[]) {
+    const int seconds = argc > 1 ? atoi(argv[1]) : DEFAULT_SECONDS;
+    const int eventsPerSecond = argc > 2 ? atoi(argv[2]) : DEFAULT_EVENTS_PER_SECOND;
+    const int numParameters = argc > 3 ? atoi(argv[3]) : DEFAULT_NUM_PARAMETERS;
+    if(seconds <= 0 || eventsPerSecond < 0 || numParameters <= 0) {
+        printf("Usage: %s [seconds] [events per second] [parameters]\n", argv[0]);
+        return 1;
+    }
+
+    ConcurrentParameterSet s;
+    BenchmarkObserver realtimeObserver(true);
+    BenchmarkObserver asyncObserver(false);
+    char name[32];
+    for(int i = 0; i < numParameters; i++) {
+        snprintf(name, sizeof(name), "parameter %d", i);
+        Parameter *p = s.add(new FloatParameter(name, 0.0, 1.0, 0.0));
+        p->addObserver(&realtimeObserver);
+        p->addObserver(&asyncObserver);
+    }
+
+    std::atomic<bool> running(true);
+    std::atomic<long> numSet(0);
+    std::atomic<long> writerAllocations(0);
+
+    // Automation thread, events are spread evenly over each millisecond
+    std::thread writer([&]() {
+        const long startAllocations = gThreadAllocations;
+        const int eventsPerMs = eventsPerSecond / 1000 > 0 ? eventsPerSecond / 1000 : 1;
+        Clock::time_point next = Clock::now();
+        long n = 0;
+        while(running.load()) {
+            for(int i = 0; i < eventsPerMs || eventsPerSecond == 0; i++) {
+                s.set((size_t)(n % numParameters), (n % 1000) / 1000.0);
+                ++n;
+                if(eventsPerSecond == 0 && (n & 1023) == 0 && !running.load()) {
+                    break;
+                }
+            }
+            numSet.store(n);
+            if(eventsPerSecond > 0) {
+                next += std::chrono::milliseconds(1);
+                std::this_thread::sleep_until(next);
+            }
+        }
+        writerAllocations.store(gThreadAllocations - startAllocations);
+    });
+
+    // Audio thread, drains the realtime events once per block
+    long numBlocks = 0, totalDrainUs = 0, worstDrainUs = 0, realtimeAllocations = 0;
+    long blocksWithAllocations = 0;
+    const Clock::time_point start = Clock::now();
+    Clock::time_point nextBlock = start;
+    while(elapsedUs(start, Clock::now()) < seconds * 1000000L) {
+        const long allocationsBefore = gThreadAllocations;
+        const Clock::time_point drainStart = Clock::now();
+        s.processRealtimeEvents();
+        const long drainUs = elapsedUs(drainStart, Clock::now());
+        const long allocations = gThreadAllocations - allocationsBefore;
+
+        ++numBlocks;
+        totalDrainUs += drainUs;
+        worstDrainUs = drainUs > worstDrainUs ? drainUs : worstDrainUs;
+        realtimeAllocations += allocations;
+        blocksWithAllocations += allocations > 0 ? 1 : 0;
+
+        nextBlock += std::chrono::microseconds(BLOCK_TIME_US);
+        std::this_thread::sleep_until(nextBlock);
+    }
+    running.store(false);
+    writer.join();
+    const double elapsed = elapsedUs(start, Clock::now()) / 1000000.0;
+
+    // Let the async thread catch up with the last events
+    s.processRealtimeEvents();
+    for(int i = 0; i < 100 && asyncObserver.count.load() < numSet.load(); i++) {
+        ConcurrentParameterSet::sleep(10);
+    }
+
+    printf("%d parameters, %ld blocks of %.2fms in %.2fs\n",
+           numParameters, numBlocks, BLOCK_TIME_US / 1000.0, elapsed);
+    printf("Events set:                %ld (%.0f events/sec)\n",
+           numSet.load(), numSet.load() / elapsed);
+    printf("Realtime notifications:    %ld (%.0f/sec, coalesced)\n",
+           realtimeObserver.count.load(), realtimeObserver.count.load() / elapsed);
+    printf("Async notifications:       %ld\n", asyncObserver.count.load());
+    printf("Drain time per block:      %.1fus average, %ldus worst\n",
+           numBlocks > 0 ? (double)totalDrainUs / numBlocks : 0.0, worstDrainUs);
+    printf("Allocations while setting: %ld\n", writerAllocations.load());
+    printf("Allocations while draining: %ld in %ld blocks\n",
+           realtimeAllocations, blocksWithAllocations);
+    printf("Allocations in total:      %ld\n", gNumAllocations.load());
+
+    return 0;
+}
@@ -322,6 +322,49 @@ public:
         ASSERT_INT_EQUALS(0, asyncObserver.count);
         return true;
     }
+
+    static bool testThreadsafeSetParameterCoalescedRealtime() {
+        ConcurrentParameterSet s;
+        TestCacheValueObserver realtimeObserver(true);
+        TestCounterObserver asyncObserver(false);
+        Parameter *p = s.add(new FloatParameter("test", 0.0, 100.0, 0.0));
+        ASSERT_NOT_NULL(p);
+        p->addObserver(&realtimeObserver);
+        p->addObserver(&asyncObserver);
+        for(int i = 1; i <= 10; i++) {
+            s.set(p, i);
+        }
+        s.processRealtimeEvents();
+        // Realtime observers are notified once per block, with the last value
+        ASSERT_INT_EQUALS(1, realtimeObserver.count);
+        ASSERT_EQUALS(10.0, realtimeObserver.value);
+        for(int i = 0; i < TEST_NUM_BLOCKS_TO_PROCESS; i++) {
+            s.processRealtimeEvents();
+            ConcurrentParameterSet::sleep(SLEEP_TIME_PER_BLOCK_MS);
+        }
+        // Async observers are still notified of each event
+        ASSERT_INT_EQUALS(10, asyncObserver.count);
+        return true;
+    }
+
+    static bool testThreadsafeSetParameterBeyondEventPool() {
+        ConcurrentParameterSet s;
+        TestCounterObserver asyncObserver(false);
+        Parameter *p = s.add(new FloatParameter("test", 0.0, 10000.0, 0.0));
+        ASSERT_NOT_NULL(p);
+        p->addObserver(&asyncObserver);
+        const int numEvents = (int)EventPool::kCapacity + 100;
+        for(int i = 1; i <= numEvents; i++) {
+            s.set(p, i);
+        }
+        for(int i = 0; i < TEST_NUM_BLOCKS_TO_PROCESS; i++) {
+            s.processRealtimeEvents();
+            ConcurrentParameterSet::sleep(SLEEP_TIME_PER_BLOCK_MS);
+        }
+        ASSERT_EQUALS((ParameterValue)numEvents, p->getValue());
+        ASSERT_INT_EQUALS(numEvents, asyncObserver.count);
+        return true;
+    }
 };
 
 } // namespace teragon
@@ -357,6 +400,8 @@ int main(int argc, char *argv[]) {
         ADD_TEST(_Tests::testThreadsafeSetParameterBothThreadsFromAsync());
         ADD_TEST(_Tests::testThreadsafeSetParameterBothThreadsFromRealtime());
         ADD_TEST(_Tests::testThreadsafeSetParameterWithSender());
+        ADD_TEST(_Tests::testThreadsafeSetParameterCoalescedRealtime());
+        ADD_TEST(_Tests::testThreadsafeSetParameterBeyondEventPool());
     }
 
     if(gNumFailedTests > 0) {
@@ -33,6 +33,7 @@ PluginParameterComponent(parameters, name, resources, imageName) {
     knobArea.setY(0);
     knobArea.setWidth(knobWidth);
     knobArea.setHeight(knobWidth);
+    frameScale = 0.0f;
 
     setRange(0.0, 1.0);
     setValue(parameter->getScaledValue(), NotificationType::dontSendNotification);
@@ -52,11 +53,29 @@ void ImageKnob::paint(Graphics &g) {
         onMouseOver();
     }
 
-    const int y = (int)(filmstripImageCount * getValue()) * knobWidth;
-    knobArea.setY(y);
-    const Image knobFrame = imageStates->normal.getClippedImage(knobArea);
-    const Image resizedKnobFrame = knobFrame.rescaled(knobWidth, knobWidth, Graphics::highResamplingQuality);
-    g.drawImageAt(resizedKnobFrame, 0, 0);
+    // frames are drawn pixel for pixel, the context does not resample them again
+    const Image &knobFrame = getFrame((int)(filmstripImageCount * getValue()),
+                                      g.getInternalContext().getPhysicalPixelScaleFactor());
+    g.drawImage(knobFrame, 0, 0, knobWidth, knobWidth,
+                0, 0, knobFrame.getWidth(), knobFrame.getHeight());
+}
+
+const Image& ImageKnob::getFrame(int index, float scale) {
+    if(scale != frameScale) {
+        // first paint, or the window moved to a display of another scale
+        frames.clearQuick();
+        frames.insertMultiple(0, Image::null, (int)filmstripImageCount + 1);
+        frameScale = scale;
+    }
+
+    index = jlimit(0, frames.size() - 1, index);
+    Image &frame = frames.getReference(index);
+    if(frame.isNull()) {
+        const int size = roundToInt(knobWidth * scale);
+        knobArea.setY(index * knobWidth);
+        frame = imageStates->normal.getClippedImage(knobArea).rescaled(size, size, Graphics::highResamplingQuality);
+    }
+    return frame;
 }
 
 } // namespace teragon
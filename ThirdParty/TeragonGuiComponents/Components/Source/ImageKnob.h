@@ -61,10 +61,19 @@ public:
     virtual void valueChanged();
     virtual void paint(Graphics &g);
 
+private:
+    /**
+    * @return Frame of the filmstrip rescaled to the physical pixels of the
+    * display, rescaled when it is drawn first and kept for later repaints.
+    */
+    const Image& getFrame(int index, float scale);
+
 private:
     juce::Rectangle<int> knobArea;
     int knobWidth;
     double filmstripImageCount;
+    juce::Array<Image> frames; // prescaled frames, null until drawn
+    float frameScale;          // physical pixel scale the frames are prescaled for
 };
 
 } // namespace teragon
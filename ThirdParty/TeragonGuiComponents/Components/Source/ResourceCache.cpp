@@ -27,28 +27,23 @@ namespace teragon {
 void ResourceCache::add(String name, const char* normalImage, const int normalImageSize,
                         const char* alternateImage, const int alternateImageSize,
                         const char* backgroundImage, const int backgroundImageSize) {
-    Image normalImageCached = ImageCache::getFromMemory(normalImage, normalImageSize);
-
-    Image alternateImageCached = Image::null;
-    if(alternateImage != nullptr && alternateImageSize > 0) {
-        alternateImageCached = ImageCache::getFromMemory(alternateImage, alternateImageSize);
-    }
-
-    Image backgroundImageCached = Image::null;
-    if(backgroundImage != nullptr && backgroundImageSize != 0) {
-        backgroundImageCached = ImageCache::getFromMemory(backgroundImage, backgroundImageSize);
-    }
-
-    ImageStates *imageStates = new ImageStates(normalImageCached,
-                                               alternateImageCached,
-                                               backgroundImageCached);
+    Resource *resource = new Resource { normalImage, normalImageSize,
+                                        alternateImage, alternateImageSize,
+                                        backgroundImage, backgroundImageSize,
+                                        nullptr };
     String keyName = Parameter::makeSafeName(name.toStdString());
-    resources.set(keyName, imageStates);
+    const ScopedLock sl(lock);
+    if(resources.contains(keyName)) {
+        delete resources[keyName]->images;
+        delete resources[keyName];
+    }
+    resources.set(keyName, resource);
 }
 
 ResourceCache::~ResourceCache() {
     ResourceMap::Iterator i(resources);
     while(i.next()) {
+        delete i.getValue()->images;
         delete i.getValue();
     }
     resources.clear();
@@ -57,7 +52,30 @@ ResourceCache::~ResourceCache() {
 
 ResourceCache::ImageStates* ResourceCache::get(const String& name) const {
     String safeName = Parameter::makeSafeName(name.toStdString());
-    return resources.contains(safeName) ? resources[safeName] : nullptr;
+    const ScopedLock sl(lock);
+    if(!resources.contains(safeName)) {
+        return nullptr;
+    }
+
+    Resource *resource = resources[safeName];
+    if(resource->images == nullptr) {
+        Image normalImageCached = ImageCache::getFromMemory(resource->normalImage, resource->normalImageSize);
+
+        Image alternateImageCached = Image::null;
+        if(resource->alternateImage != nullptr && resource->alternateImageSize > 0) {
+            alternateImageCached = ImageCache::getFromMemory(resource->alternateImage, resource->alternateImageSize);
+        }
+
+        Image backgroundImageCached = Image::null;
+        if(resource->backgroundImage != nullptr && resource->backgroundImageSize != 0) {
+            backgroundImageCached = ImageCache::getFromMemory(resource->backgroundImage, resource->backgroundImageSize);
+        }
+
+        resource->images = new ImageStates(normalImageCached,
+                                           alternateImageCached,
+                                           backgroundImageCached);
+    }
+    return resource->images;
 }
 
 } // namespace teragon
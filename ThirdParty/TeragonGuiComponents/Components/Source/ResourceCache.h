@@ -30,12 +30,14 @@ namespace teragon {
 * This class provides storage for image resources. In order to make editing
 * plugins efficient in Introjucer, all graphics are saved as resources in
 * the Resources class and cached here. Each image can have three states:
-* normal, alternate, and background.
+* normal, alternate, and background. Images are decoded when they are
+* fetched first, so a cache costs nothing until a GUI draws with it, and one
+* cache can be shared by many GUIs.
 *
 * Usually you want to create a ResourceCache with the Resources::getCache()
 * method, and passing the associated pointer to the GUI Component. Note that
-* you must delete the ResourceCache created from this call when the GUI
-* is destructed or closed, otherwise memory will be leaked.
+* you must delete the ResourceCache created from this call when it is not
+* used by any GUI any more, otherwise memory will be leaked.
 */
 class ResourceCache {
 public:
@@ -56,16 +58,35 @@ public:
     ResourceCache() {}
     virtual ~ResourceCache();
 
+    /**
+    * Register images of a resource. The data is not copied, it must outlive
+    * the cache (like binary data compiled into the plugin does).
+    */
     virtual void add(String name, const char* normalImage, const int normalImageSize,
                      const char* alternateImage = nullptr, const int alternateImageSize = 0,
                      const char* backgroundImage = nullptr, const int backgroundImageSize = 0);
 
+    /**
+    * @return Images of a resource, decoded by the first call, or nullptr if
+    * there is no resource of that name.
+    */
     virtual ImageStates* get(const String &name) const;
     virtual ImageStates* operator[](const String &name) const { return get(name); }
 
 private:
-    typedef juce::HashMap<String, ImageStates*> ResourceMap;
+    struct Resource {
+        const char* normalImage;
+        int normalImageSize;
+        const char* alternateImage;
+        int alternateImageSize;
+        const char* backgroundImage;
+        int backgroundImageSize;
+        ImageStates* images; // nullptr until the resource is fetched
+    };
+
+    typedef juce::HashMap<String, Resource*> ResourceMap;
     ResourceMap resources;
+    CriticalSection lock; // images of a shared cache may be fetched from any GUI
 };
 
 } // namespace teragon
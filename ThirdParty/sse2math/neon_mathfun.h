@@ -0,0 +1,155 @@
+/* NEON (AArch64) implementation of cos and sincos, the NEON counterpart
+ of cos_ps and sincos_ps in sse_mathfun.h, used on ARM where SSE is not
+ available.
+
+ Based on the corresponding algorithms of the cephes math library, the
+ operations are done in the same order as in sse_mathfun.h so that both
+ give the same results.
+ */
+/* Copyright (C) 2007  Julien Pommier
+
+ This software is provided 'as-is', without any express or implied
+ warranty.  In no event will the authors be held liable for any damages
+ arising from the use of this software.
+
+ Permission is granted to anyone to use this software for any purpose,
+ including commercial applications, and to alter it and redistribute it
+ freely, subject to the following restrictions:
+
+ 1. The origin of this software must not be misrepresented; you must not
+ claim that you wrote the original software. If you use this software
+ in a product, an acknowledgment in the product documentation would be
+ appreciated but is not required.
+ 2. Altered source versions must be plainly marked as such, and must not be
+ misrepresented as being the original software.
+ 3. This notice may not be removed or altered from any source distribution.
+
+ (this is the zlib license)
+
+ This file is an altered version (NEON port of cos_ps and sincos_ps).
+ */
+
+#ifndef Paraphrasis_neon_mathfun_h
+#define Paraphrasis_neon_mathfun_h
+#include <arm_neon.h>
+
+typedef float32x4_t v4sf;  // vector of 4 float
+typedef int32x4_t v4si;    // vector of 4 int
+typedef uint32x4_t v4su;   // vector of 4 unsigned int (masks)
+
+#define c_minus_cephes_DP1 -0.78515625f
+#define c_minus_cephes_DP2 -2.4187564849853515625e-4f
+#define c_minus_cephes_DP3 -3.77489497744594108e-8f
+#define c_sincof_p0 -1.9515295891E-4f
+#define c_sincof_p1  8.3321608736E-3f
+#define c_sincof_p2 -1.6666654611E-1f
+#define c_coscof_p0  2.443315711809948E-005f
+#define c_coscof_p1 -1.388731625493765E-003f
+#define c_coscof_p2  4.166664568298827E-002f
+#define c_cephes_FOPI 1.27323954473516f // 4 / M_PI
+
+/* reduce x (positive) to [-Pi/4, Pi/4], return j (see the cephes sources) */
+static inline v4sf neon_reduce_ps(v4sf x, v4si *j) {
+    /* scale by 4/Pi */
+    v4sf y = vmulq_f32(x, vdupq_n_f32(c_cephes_FOPI));
+
+    /* store the integer part of y in emm2 */
+    v4si emm2 = vcvtq_s32_f32(y);
+    /* j=(j+1) & (~1) (see the cephes sources) */
+    emm2 = vaddq_s32(emm2, vdupq_n_s32(1));
+    emm2 = vandq_s32(emm2, vdupq_n_s32(~1));
+    y = vcvtq_f32_s32(emm2);
+    *j = emm2;
+
+    /* The magic pass: "Extended precision modular arithmetic"
+     x = ((x - y * DP1) - y * DP2) - y * DP3; */
+    x = vaddq_f32(x, vmulq_f32(y, vdupq_n_f32(c_minus_cephes_DP1)));
+    x = vaddq_f32(x, vmulq_f32(y, vdupq_n_f32(c_minus_cephes_DP2)));
+    x = vaddq_f32(x, vmulq_f32(y, vdupq_n_f32(c_minus_cephes_DP3)));
+    return x;
+}
+
+/* the first polynom (0 <= x <= Pi/4) */
+static inline v4sf neon_cos_poly_ps(v4sf z) {
+    v4sf y = vdupq_n_f32(c_coscof_p0);
+    y = vmulq_f32(y, z);
+    y = vaddq_f32(y, vdupq_n_f32(c_coscof_p1));
+    y = vmulq_f32(y, z);
+    y = vaddq_f32(y, vdupq_n_f32(c_coscof_p2));
+    y = vmulq_f32(y, z);
+    y = vmulq_f32(y, z);
+    y = vsubq_f32(y, vmulq_f32(z, vdupq_n_f32(0.5f)));
+    y = vaddq_f32(y, vdupq_n_f32(1.f));
+    return y;
+}
+
+/* the second polynom (Pi/4 <= x <= 0) */
+static inline v4sf neon_sin_poly_ps(v4sf x, v4sf z) {
+    v4sf y2 = vdupq_n_f32(c_sincof_p0);
+    y2 = vmulq_f32(y2, z);
+    y2 = vaddq_f32(y2, vdupq_n_f32(c_sincof_p1));
+    y2 = vmulq_f32(y2, z);
+    y2 = vaddq_f32(y2, vdupq_n_f32(c_sincof_p2));
+    y2 = vmulq_f32(y2, z);
+    y2 = vmulq_f32(y2, x);
+    y2 = vaddq_f32(y2, x);
+    return y2;
+}
+
+static inline v4sf cos_ps(v4sf x) { // any x
+    v4si emm2;
+
+    /* take the absolute value */
+    x = vabsq_f32(x);
+    x = neon_reduce_ps(x, &emm2);
+
+    emm2 = vsubq_s32(emm2, vdupq_n_s32(2));
+
+    /* get the swap sign flag */
+    v4su sign_bit = vshlq_n_u32(vreinterpretq_u32_s32(vbicq_s32(vdupq_n_s32(4), emm2)), 29);
+    /* get the polynom selection mask */
+    v4su poly_mask = vceqq_s32(vandq_s32(emm2, vdupq_n_s32(2)), vdupq_n_s32(0));
+
+    v4sf z = vmulq_f32(x, x);
+    v4sf y = neon_cos_poly_ps(z);
+    v4sf y2 = neon_sin_poly_ps(x, z);
+
+    /* select the correct result from the two polynoms */
+    y = vbslq_f32(poly_mask, y2, y);
+    /* update the sign */
+    return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(y), sign_bit));
+}
+
+static inline void sincos_ps(v4sf x, v4sf *s, v4sf *c) {
+    v4si emm2;
+
+    /* extract the sign bit (upper one) */
+    v4su sign_bit_sin = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000u));
+    /* take the absolute value */
+    x = vabsq_f32(x);
+    x = neon_reduce_ps(x, &emm2);
+
+    /* get the swap sign flag for the sine */
+    v4su swap_sign_bit_sin = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(emm2, vdupq_n_s32(4))), 29);
+    /* get the polynom selection mask for the sine */
+    v4su poly_mask = vceqq_s32(vandq_s32(emm2, vdupq_n_s32(2)), vdupq_n_s32(0));
+    /* get the sign flag for the cosine */
+    v4si emm4 = vsubq_s32(emm2, vdupq_n_s32(2));
+    v4su sign_bit_cos = vshlq_n_u32(vreinterpretq_u32_s32(vbicq_s32(vdupq_n_s32(4), emm4)), 29);
+
+    sign_bit_sin = veorq_u32(sign_bit_sin, swap_sign_bit_sin);
+
+    v4sf z = vmulq_f32(x, x);
+    v4sf y = neon_cos_poly_ps(z);
+    v4sf y2 = neon_sin_poly_ps(x, z);
+
+    /* select the correct result from the two polynoms */
+    v4sf ysin = vbslq_f32(poly_mask, y2, y);
+    v4sf ycos = vbslq_f32(poly_mask, y, y2);
+
+    /* update the sign */
+    *s = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(ysin), sign_bit_sin));
+    *c = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(ycos), sign_bit_cos));
+}
+
+#endif